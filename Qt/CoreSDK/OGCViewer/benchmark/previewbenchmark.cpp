@@ -0,0 +1,367 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include <string.h>
+#include <iostream>
+
+#include <QAbstractItemModel>
+#include <QCoreApplication>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+
+#include "previewbenchmark.h"
+#include "ui/drawingsurfacewidget.h"
+#include "services/servicelist.h"
+#include "services/servicelayerpreview.h"
+#include "services/wms/wmsservice.h"
+#include "services/wmts/wmtsservice.h"
+
+#include "MapLink.h"
+#include "MapLinkDrawing.h"
+
+using namespace Services;
+
+// How often the user interface thread is checked, and the gap between checks counted as a long stall
+static const int g_heartbeatInterval = 5;
+static const int g_longStall = 50;
+
+// The coordinate system chosen when a service offers more than one
+static const char *g_preferredCRS = "EPSG:3857";
+
+// Size of the preview, the same as the preview pane in the service wizard
+static const int g_previewSize = 256;
+
+PreviewBenchmark::Settings::Settings()
+  : m_serviceType( ServiceTypeWMS )
+  , m_numClicks( 100 )
+  , m_clickInterval( 50 )
+  , m_debouncePeriod( -1 )
+  , m_timeout( 60000 )
+{
+}
+
+PreviewBenchmark::PreviewBenchmark( ServiceList *services, QObject *parent )
+  : QObject( parent )
+  , m_services( services )
+  , m_service( NULL )
+  , m_layersModel( NULL )
+  , m_layerInfoModel( NULL )
+  , m_layerStylesModel( NULL )
+  , m_preview( NULL )
+  , m_previewWidget( NULL )
+  , m_clicks( 0 )
+  , m_lastClick( 0 )
+  , m_shownAtLastClick( 0 )
+  , m_totalClickTime( 0 )
+  , m_maxClickTime( 0 )
+  , m_lastHeartbeat( 0 )
+  , m_maxStall( 0 )
+  , m_longStalls( 0 )
+  , m_finalPreviewTime( -1 )
+  , m_finished( false )
+{
+  // The service callbacks are made from the loading thread, so these connections are queued
+  connect( this, SIGNAL(signalNextSequenceAction()), this, SLOT(nextSequenceAction()), Qt::QueuedConnection );
+  connect( this, SIGNAL(signalChooseCoordinateSystem()), this, SLOT(chooseCoordinateSystem()), Qt::QueuedConnection );
+  connect( this, SIGNAL(signalShowError(const QString&)), this, SLOT(showError(const QString&)), Qt::QueuedConnection );
+
+  connect( &m_clickTimer, SIGNAL(timeout()), this, SLOT(click()) );
+  connect( &m_heartbeatTimer, SIGNAL(timeout()), this, SLOT(heartbeat()) );
+  connect( &m_timeoutTimer, SIGNAL(timeout()), this, SLOT(timedOut()) );
+  connect( &m_network, SIGNAL(finished(QNetworkReply*)), this, SLOT(statisticsReceived(QNetworkReply*)) );
+  m_timeoutTimer.setSingleShot( true );
+}
+
+PreviewBenchmark::~PreviewBenchmark()
+{
+  // The preview is deleted before its widget, as the service wizard's layer selection page does
+  delete m_preview;
+  delete m_previewWidget;
+  delete m_layerInfoModel;
+  delete m_layerStylesModel;
+  delete m_layersModel;
+  if( m_service )
+  {
+    m_service->cancelSequence();
+    delete m_service;
+  }
+}
+
+void PreviewBenchmark::start( const Settings &settings )
+{
+  m_settings = settings;
+
+  // Statistics are read from the same server as the service
+  m_statisticsURL = QUrl( m_settings.m_serviceURL );
+  m_statisticsURL.setPath( "/stats" );
+  m_statisticsURL.setQuery( QString() );
+
+  switch( m_settings.m_serviceType )
+  {
+  case ServiceTypeWMTS:
+    m_service = new WMTSService();
+    break;
+
+  case ServiceTypeWMS:
+  default:
+    m_service = new WMSService();
+    break;
+  }
+
+  m_service->setLoader( m_services->getCommonLoader(), ServiceList::loadCallback, m_services,
+                        ServiceList::allLoadedCallback, m_services );
+  m_service->pushCallbackObject( this );
+
+  std::cout << "Benchmarking layer previews of " << m_settings.m_serviceURL.toUtf8().constData() << std::endl;
+
+  m_service->loadService( m_settings.m_serviceURL.toUtf8().constData() );
+}
+
+void PreviewBenchmark::onError( const std::string &message )
+{
+  emit signalShowError( QString::fromUtf8( message.c_str() ) );
+}
+
+void PreviewBenchmark::onNextSequenceAction()
+{
+  emit signalNextSequenceAction();
+}
+
+void PreviewBenchmark::coordinateSystemChoiceRequired()
+{
+  emit signalChooseCoordinateSystem();
+}
+
+void PreviewBenchmark::nextSequenceAction()
+{
+  if( m_layersModel )
+  {
+    return;
+  }
+
+  // The capabilities have been loaded, which is as far as the service wizard goes before showing previews
+  findLayers();
+  if( m_layers.empty() )
+  {
+    std::cout << "The service has no layers to preview" << std::endl;
+    finish( 1 );
+    return;
+  }
+
+  m_previewWidget = new DrawingSurfaceWidget();
+  m_previewWidget->setWindowTitle( "Layer preview" );
+  m_previewWidget->resize( g_previewSize, g_previewSize );
+  m_previewWidget->show();
+
+  m_preview = m_service->getLayerPreviewHelper();
+  m_preview->setSurfaceWidget( m_previewWidget );
+  if( m_settings.m_debouncePeriod >= 0 )
+  {
+    m_preview->setDebouncePeriod( m_settings.m_debouncePeriod );
+  }
+  connect( m_preview, SIGNAL(previewLoaded()), this, SLOT(previewLoaded()), Qt::QueuedConnection );
+
+  m_network.get( QNetworkRequest( m_statisticsURL ) );
+}
+
+void PreviewBenchmark::chooseCoordinateSystem()
+{
+  int choice = 0;
+  const char **choices = m_service->coodinateSystemChoices();
+  size_t numChoices = m_service->numCoordSystemChoices();
+  for( size_t i = 0; i < numChoices; ++i )
+  {
+    if( choices[i] && strcmp( choices[i], g_preferredCRS ) == 0 )
+    {
+      choice = (int)i;
+      break;
+    }
+  }
+
+  m_service->setCoordinateSystemChoice( choice );
+  m_service->advanceConnectionSequence();
+}
+
+void PreviewBenchmark::showError( const QString &message )
+{
+  std::cout << "Service error: " << message.toUtf8().constData() << std::endl;
+  if( !m_layersModel )
+  {
+    // The capabilities could not be loaded, so there is nothing to preview
+    finish( 1 );
+  }
+}
+
+void PreviewBenchmark::findLayers()
+{
+  m_layersModel = m_service->getServiceLayerModel();
+  m_layerInfoModel = m_service->getServiceLayerInfoModel();
+  m_layerStylesModel = m_service->getServiceLayerStyleModel();
+
+  // Layers without sub-layers are the ones a user would preview
+  std::vector< QModelIndex > pending;
+  pending.push_back( QModelIndex() );
+  while( !pending.empty() )
+  {
+    QModelIndex parent = pending.front();
+    pending.erase( pending.begin() );
+
+    int numRows = m_layersModel->rowCount( parent );
+    for( int row = 0; row < numRows; ++row )
+    {
+      QModelIndex index = m_layersModel->index( row, 0, parent );
+      if( m_layersModel->rowCount( index ) > 0 )
+      {
+        pending.push_back( index );
+      }
+      else
+      {
+        m_layers.push_back( index );
+      }
+    }
+  }
+}
+
+void PreviewBenchmark::statisticsReceived( QNetworkReply *reply )
+{
+  QMap< QByteArray, qint64 > statistics;
+  if( reply->error() == QNetworkReply::NoError )
+  {
+    QList< QByteArray > lines = reply->readAll().split( '\n' );
+    for( int i = 0; i < lines.size(); ++i )
+    {
+      int separator = lines[i].indexOf( '=' );
+      if( separator > 0 )
+      {
+        statistics[ lines[i].left( separator ) ] = lines[i].mid( separator + 1 ).toLongLong();
+      }
+    }
+  }
+  reply->deleteLater();
+
+  if( !m_finished )
+  {
+    m_statisticsBefore = statistics;
+    startClicking();
+  }
+  else
+  {
+    m_statisticsAfter = statistics;
+    report();
+  }
+}
+
+void PreviewBenchmark::startClicking()
+{
+  std::cout << "Selecting " << m_settings.m_numClicks << " layers, " << m_settings.m_clickInterval
+            << " ms apart, from the " << m_layers.size() << " offered" << std::endl;
+
+  m_clock.start();
+  m_lastHeartbeat = 0;
+  m_heartbeatTimer.start( g_heartbeatInterval );
+  m_clickTimer.start( m_settings.m_clickInterval );
+  click();
+}
+
+void PreviewBenchmark::click()
+{
+  if( m_clicks >= m_settings.m_numClicks )
+  {
+    return;
+  }
+
+  // Do what the layer selection page does when a layer is selected
+  qint64 clickStart = m_clock.nsecsElapsed();
+  const QModelIndex &layer = m_layers[m_clicks % m_layers.size()];
+  m_layerInfoModel->setSelectedLayer( layer );
+  m_layerStylesModel->setSelectedLayer( layer );
+  m_preview->showLayerPreview( layer, m_layerStylesModel->currentStyle() );
+  qint64 clickTime = m_clock.nsecsElapsed() - clickStart;
+
+  m_totalClickTime += clickTime;
+  m_maxClickTime = qMax( m_maxClickTime, clickTime );
+  m_lastClick = m_clock.elapsed();
+
+  ++m_clicks;
+  if( m_clicks >= m_settings.m_numClicks )
+  {
+    m_clickTimer.stop();
+    m_shownAtLastClick = m_preview->statistics().m_shown;
+    m_timeoutTimer.start( m_settings.m_timeout );
+  }
+}
+
+void PreviewBenchmark::heartbeat()
+{
+  qint64 now = m_clock.elapsed();
+  qint64 stall = now - m_lastHeartbeat - g_heartbeatInterval;
+  m_lastHeartbeat = now;
+
+  m_maxStall = qMax( m_maxStall, stall );
+  if( stall >= g_longStall )
+  {
+    ++m_longStalls;
+  }
+}
+
+void PreviewBenchmark::previewLoaded()
+{
+  // Loads started for earlier layers may complete while the last layer's preview is waiting to be loaded
+  if( m_finished || m_clicks < m_settings.m_numClicks || m_preview->statistics().m_shown <= m_shownAtLastClick )
+  {
+    return;
+  }
+
+  m_finalPreviewTime = m_clock.elapsed() - m_lastClick;
+  m_finished = true;
+  m_heartbeatTimer.stop();
+  m_timeoutTimer.stop();
+  m_network.get( QNetworkRequest( m_statisticsURL ) );
+}
+
+void PreviewBenchmark::timedOut()
+{
+  if( m_finished )
+  {
+    return;
+  }
+  m_finished = true;
+  m_heartbeatTimer.stop();
+  std::cout << "The last preview did not load within " << m_settings.m_timeout << " ms" << std::endl;
+  m_network.get( QNetworkRequest( m_statisticsURL ) );
+}
+
+void PreviewBenchmark::report()
+{
+  const ServiceLayerPreview::Statistics &previewStatistics = m_preview->statistics();
+  int numClicks = qMax( m_clicks, 1 );
+
+  std::cout << "Selection handling: mean " << m_totalClickTime / numClicks / 1000 << " us"
+            << "  max " << m_maxClickTime / 1000 << " us" << std::endl;
+  std::cout << "User interface stalls: max " << m_maxStall << " ms"
+            << "  over " << g_longStall << " ms " << m_longStalls << std::endl;
+  std::cout << "Previews: requested " << previewStatistics.m_requested
+            << "  loaded " << previewStatistics.m_shown
+            << "  data layers created " << previewStatistics.m_dataLayersCreated << std::endl;
+  if( m_finalPreviewTime >= 0 )
+  {
+    std::cout << "Last preview loaded " << m_finalPreviewTime << " ms after the last click" << std::endl;
+  }
+
+  if( !m_statisticsBefore.isEmpty() && !m_statisticsAfter.isEmpty() )
+  {
+    std::cout << "Server: capabilities " << m_statisticsAfter.value( "capabilities" ) - m_statisticsBefore.value( "capabilities" )
+              << "  getmap " << m_statisticsAfter.value( "getmap" ) - m_statisticsBefore.value( "getmap" )
+              << "  gettile " << m_statisticsAfter.value( "gettile" ) - m_statisticsBefore.value( "gettile" )
+              << "  bytes " << m_statisticsAfter.value( "bytes" ) - m_statisticsBefore.value( "bytes" ) << std::endl;
+  }
+
+  finish( m_finalPreviewTime >= 0 ? 0 : 1 );
+}
+
+void PreviewBenchmark::finish( int exitCode )
+{
+  std::cout << (exitCode == 0 ? "Benchmark complete" : "Benchmark failed") << std::endl;
+  QCoreApplication::exit( exitCode );
+}
@@ -0,0 +1,141 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef PREVIEWBENCHMARK_H
+#define PREVIEWBENCHMARK_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QModelIndex>
+#include <QNetworkAccessManager>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QUrl>
+
+#include "services/service.h"
+
+namespace Services
+{
+  class ServiceList;
+  class ServiceLayerPreview;
+};
+class DrawingSurfaceWidget;
+class QAbstractItemModel;
+class QNetworkReply;
+
+// Loads a service's capabilities and clicks through its layers as a user would in the service
+// wizard's layer selection page, measuring how responsive the user interface stays while the
+// layer previews are loaded.
+//
+// A layer is selected every click interval, cycling through the layers if the service has fewer
+// than the number of clicks. The user interface thread is checked every few milliseconds, and any
+// longer gap between checks is reported as a stall. Once the clicks end, the benchmark waits for
+// the preview of the last layer to load.
+//
+// When the service is the mock OGC server, the capabilities and map requests made for the
+// previews are reported as well.
+
+class PreviewBenchmark : public QObject, public Services::Service::ServiceActionCallback
+{
+  Q_OBJECT
+public:
+  struct Settings
+  {
+    Settings();
+
+    QString m_serviceURL;
+    ServiceTypeEnum m_serviceType;
+
+    // The number of layer selections, and the milliseconds between them
+    int m_numClicks;
+    int m_clickInterval;
+
+    // Overrides the time a preview request waits for a later one when not negative
+    int m_debouncePeriod;
+
+    // Milliseconds after the last click after which the benchmark is abandoned
+    int m_timeout;
+  };
+
+  PreviewBenchmark( Services::ServiceList *services, QObject *parent = NULL );
+  virtual ~PreviewBenchmark();
+
+  // Starts loading the service. The application exits once the benchmark ends, with a non-zero
+  // exit code if the service could not be loaded or the last preview did not load.
+  void start( const Settings &settings );
+
+signals:
+  void signalNextSequenceAction();
+  void signalChooseCoordinateSystem();
+  void signalShowError( const QString &message );
+
+private slots:
+  void nextSequenceAction();
+  void chooseCoordinateSystem();
+  void showError( const QString &message );
+  void click();
+  void heartbeat();
+  void previewLoaded();
+  void timedOut();
+  void statisticsReceived( QNetworkReply *reply );
+
+private:
+  // Callbacks made from the data layer while the service is loading. These are made from a separate
+  // thread so are passed on to the user interface thread through signals.
+  virtual void onError( const std::string &message );
+  virtual void onNextSequenceAction();
+  virtual void coordinateSystemChoiceRequired();
+
+  // Lists the layers of the service that can be selected, in the order they appear in the model
+  void findLayers();
+
+  void startClicking();
+  void report();
+  void finish( int exitCode );
+
+  Services::ServiceList *m_services;
+  Settings m_settings;
+
+  Services::Service *m_service;
+  QAbstractItemModel *m_layersModel;
+  Services::Service::ServiceLayerInfoModel *m_layerInfoModel;
+  Services::Service::ServiceLayerStylesModel *m_layerStylesModel;
+  Services::ServiceLayerPreview *m_preview;
+  DrawingSurfaceWidget *m_previewWidget;
+  std::vector< QModelIndex > m_layers;
+
+  QTimer m_clickTimer;
+  int m_clicks;
+  QElapsedTimer m_clock;
+  qint64 m_lastClick;
+
+  // Previews loaded when the last layer was selected, so the next one loaded is that layer's
+  int m_shownAtLastClick;
+
+  // Time spent handling each selection on the user interface thread
+  qint64 m_totalClickTime;
+  qint64 m_maxClickTime;
+
+  // Gaps in the user interface thread's processing of events beyond the heartbeat interval
+  QTimer m_heartbeatTimer;
+  qint64 m_lastHeartbeat;
+  qint64 m_maxStall;
+  int m_longStalls;
+
+  QTimer m_timeoutTimer;
+  qint64 m_finalPreviewTime;
+  bool m_finished;
+
+  // Statistics from the mock server, which are not available from other services
+  QNetworkAccessManager m_network;
+  QUrl m_statisticsURL;
+  QMap< QByteArray, qint64 > m_statisticsBefore;
+  QMap< QByteArray, qint64 > m_statisticsAfter;
+};
+
+#endif // PREVIEWBENCHMARK_H
@@ -0,0 +1,832 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMimeData>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTextStream>
+
+#include "viewbenchmark.h"
+#include "ui/drawingsurfacewidget.h"
+#include "services/servicelist.h"
+#include "services/servicelistmodel.h"
+#include "services/wms/wmsanimation.h"
+#include "services/wms/wmsservice.h"
+#include "services/wmts/wmtsservice.h"
+
+#include "MapLink.h"
+#include "MapLinkDrawing.h"
+
+using namespace Services;
+
+// How often the current step is checked for completion
+static const int g_completionCheckInterval = 20;
+
+// The coordinate system chosen when a service offers more than one
+static const char *g_preferredCRS = "EPSG:3857";
+
+ViewBenchmark::Settings::Settings()
+  : m_serviceType( ServiceTypeWMS )
+  , m_numLayers( 1 )
+  , m_quietPeriod( 1000 )
+  , m_stepTimeout( 60000 )
+  , m_useTileStore( true )
+  , m_clearTileStore( false )
+  , m_prefetchRing( -1 )
+  , m_prefetchBudget( -1 )
+  , m_prioritise( true )
+  , m_serverConnections( -1 )
+  , m_burstInterval( 100 )
+{
+}
+
+ViewBenchmark::ViewBenchmark( ServiceList *services, DrawingSurfaceWidget *surfaceWidget, QObject *parent )
+  : QObject( parent )
+  , m_services( services )
+  , m_surfaceWidget( surfaceWidget )
+  , m_service( NULL )
+  , m_loadStage( LoadingCapabilities )
+  , m_currentStep( 0 )
+  , m_stepRunning( false )
+  , m_burstApplied( 0 )
+  , m_applyTime( 0 )
+  , m_lastActivity( 0 )
+  , m_redraws( 0 )
+  , m_blankFrames( 0 )
+  , m_loading( false )
+  , m_failed( false )
+  , m_animationFrames( 0 )
+  , m_framesShown( 0 )
+  , m_droppedFrames( 0 )
+  , m_frameDrawn( false )
+  , m_statisticsAvailable( true )
+  , m_serviceProxy( NULL )
+{
+  // The service callbacks are made from the loading thread, so these connections are queued
+  connect( this, SIGNAL(signalNextSequenceAction()), this, SLOT(nextSequenceAction()), Qt::QueuedConnection );
+  connect( this, SIGNAL(signalChooseCoordinateSystem()), this, SLOT(chooseCoordinateSystem()), Qt::QueuedConnection );
+  connect( this, SIGNAL(signalShowError(const QString&)), this, SLOT(showError(const QString&)), Qt::QueuedConnection );
+
+  connect( m_surfaceWidget, SIGNAL(mapDrawn()), this, SLOT(mapDrawn()) );
+  connect( &m_completionTimer, SIGNAL(timeout()), this, SLOT(checkStepComplete()) );
+  connect( &m_burstTimer, SIGNAL(timeout()), this, SLOT(nextBurstCommand()) );
+  m_burstTimer.setSingleShot( true );
+  connect( &m_network, SIGNAL(finished(QNetworkReply*)), this, SLOT(statisticsReceived(QNetworkReply*)) );
+}
+
+ViewBenchmark::~ViewBenchmark()
+{
+  if( m_service && m_loadStage != ServiceAdded )
+  {
+    m_service->cancelSequence();
+    delete m_service;
+  }
+}
+
+bool ViewBenchmark::start( const Settings &settings, QString &error )
+{
+  m_settings = settings;
+
+  QFile scriptFile( m_settings.m_scriptFile );
+  if( !scriptFile.open( QIODevice::ReadOnly | QIODevice::Text ) )
+  {
+    error = "Unable to open benchmark script " + m_settings.m_scriptFile;
+    return false;
+  }
+
+  m_steps.clear();
+  m_steps.append( "load" );
+
+  QTextStream script( &scriptFile );
+  int lineNumber = 0;
+  while( !script.atEnd() )
+  {
+    QString line = script.readLine().trimmed();
+    ++lineNumber;
+    if( line.isEmpty() || line.startsWith( '#' ) )
+    {
+      continue;
+    }
+
+    QStringList commands = line.split( ';' );
+    bool valid = true;
+    for( int i = 0; i < commands.size() && valid; ++i )
+    {
+      valid = validCommand( commands[i].trimmed() );
+    }
+
+    if( !valid )
+    {
+      error = QString( "Invalid command on line %1 of %2: %3" ).arg( lineNumber ).arg( m_settings.m_scriptFile ).arg( line );
+      return false;
+    }
+    m_steps.append( line );
+  }
+
+  // Statistics are read from the same server as the service
+  m_statisticsURL = QUrl( m_settings.m_serviceURL );
+  m_statisticsURL.setPath( "/stats" );
+  m_statisticsURL.setQuery( QString() );
+
+  switch( m_settings.m_serviceType )
+  {
+  case ServiceTypeWMTS:
+    m_service = new WMTSService();
+    if( m_settings.m_useTileStore )
+    {
+      m_serviceProxy = m_services->getServiceProxy();
+      if( m_serviceProxy && m_settings.m_clearTileStore )
+      {
+        m_serviceProxy->clear();
+      }
+      if( m_serviceProxy && (m_settings.m_prefetchRing >= 0 || m_settings.m_prefetchBudget >= 0) )
+      {
+        // Only for this run, so the general options are left as they were
+        int ring = m_settings.m_prefetchRing >= 0 ? m_settings.m_prefetchRing : m_services->tilePrefetchRing();
+        int budget = m_settings.m_prefetchBudget >= 0 ? m_settings.m_prefetchBudget : m_services->tilePrefetchBudget();
+        m_serviceProxy->setPrefetch( ring, (qint64)budget * 1024 );
+      }
+      if( m_serviceProxy )
+      {
+        m_serviceProxy->setPrioritise( m_settings.m_prioritise );
+        if( m_settings.m_serverConnections > 0 )
+        {
+          m_serviceProxy->setHostLimits( m_settings.m_serverConnections, QVariantMap() );
+        }
+      }
+      ((WMTSService*)m_service)->setServiceProxy( m_serviceProxy );
+    }
+    break;
+
+  case ServiceTypeWMS:
+  default:
+    m_service = new WMSService();
+    if( m_settings.m_useTileStore )
+    {
+      // Animation frames are held and fetched ahead by the proxy
+      m_serviceProxy = m_services->getServiceProxy();
+      ((WMSService*)m_service)->setServiceProxy( m_serviceProxy );
+    }
+    break;
+  }
+
+  TSLDrawingSurface *surface = m_surfaceWidget->drawingSurface();
+  m_service->useTransformParametersFromLayer( surface ? surface->getCoordinateProvidingLayer() : NULL );
+  m_service->setLoader( m_services->getCommonLoader(), ServiceList::loadCallback, m_services,
+                        ServiceList::allLoadedCallback, m_services );
+  m_service->pushCallbackObject( this );
+
+  std::cout << "Benchmarking " << m_settings.m_serviceURL.toUtf8().constData() << " with "
+            << m_settings.m_scriptFile.toUtf8().constData() << std::endl;
+
+  m_currentStep = 0;
+  requestStatistics();
+  return true;
+}
+
+bool ViewBenchmark::validCommand( const QString &command )
+{
+  QStringList arguments = command.split( ' ', QString::SkipEmptyParts );
+  if( arguments.isEmpty() )
+  {
+    return false;
+  }
+
+  QString name = arguments[0].toLower();
+  bool valid = false;
+  if( name == "zoom" && arguments.size() == 2 )
+  {
+    arguments[1].toDouble( &valid );
+  }
+  else if( name == "pan" && arguments.size() == 3 )
+  {
+    bool validY = false;
+    arguments[1].toDouble( &valid );
+    arguments[2].toDouble( &validY );
+    valid = valid && validY;
+  }
+  else if( name == "reset" )
+  {
+    valid = arguments.size() == 1;
+  }
+  else if( name == "show" || name == "hide" )
+  {
+    valid = arguments.size() > 1;
+  }
+  else if( name == "reorder" && arguments.size() == 3 )
+  {
+    bool validTo = false;
+    int from = arguments[1].toInt( &valid );
+    int to = arguments[2].toInt( &validTo );
+    valid = valid && validTo && from >= 0 && to >= 0;
+  }
+  else if( name == "animate" && arguments.size() == 4 )
+  {
+    bool validRate = false, validFrames = false;
+    double frameRate = arguments[2].toDouble( &validRate );
+    int numFrames = arguments[3].toInt( &validFrames );
+    valid = validRate && validFrames && frameRate > 0.0 && numFrames > 0;
+  }
+  return valid;
+}
+
+void ViewBenchmark::loadingStateChanged( bool loading )
+{
+  m_loading = loading;
+  m_lastActivity = m_stepClock.elapsed();
+}
+
+void ViewBenchmark::onError( const std::string &message )
+{
+  emit signalShowError( QString::fromUtf8( message.c_str() ) );
+}
+
+void ViewBenchmark::onNextSequenceAction()
+{
+  emit signalNextSequenceAction();
+}
+
+void ViewBenchmark::coordinateSystemChoiceRequired()
+{
+  emit signalChooseCoordinateSystem();
+}
+
+void ViewBenchmark::nextSequenceAction()
+{
+  switch( m_loadStage )
+  {
+  case LoadingCapabilities:
+    // The capabilities have been loaded - choose the layers to show and let the service continue
+    selectLayers();
+    m_loadStage = ConfiguringService;
+    m_service->advanceConnectionSequence();
+    break;
+
+  case ConfiguringService:
+    // The service settings are complete, so it can be displayed. The service list takes ownership of it.
+    m_service->popCallbackObject();
+    m_loadStage = ServiceAdded;
+    m_services->addService( m_service );
+    m_lastActivity = m_stepClock.elapsed();
+    break;
+
+  default:
+    break;
+  }
+}
+
+void ViewBenchmark::chooseCoordinateSystem()
+{
+  int choice = 0;
+  const char **choices = m_service->coodinateSystemChoices();
+  size_t numChoices = m_service->numCoordSystemChoices();
+  for( size_t i = 0; i < numChoices; ++i )
+  {
+    if( choices[i] && strcmp( choices[i], g_preferredCRS ) == 0 )
+    {
+      choice = (int)i;
+      break;
+    }
+  }
+
+  m_service->setCoordinateSystemChoice( choice );
+  m_service->advanceConnectionSequence();
+}
+
+void ViewBenchmark::showError( const QString &message )
+{
+  std::cout << "Service error: " << message.toUtf8().constData() << std::endl;
+  if( m_loadStage != ServiceAdded )
+  {
+    // The service cannot be loaded, so there is nothing to measure
+    m_completionTimer.stop();
+    finish( 1 );
+  }
+}
+
+void ViewBenchmark::mapDrawn()
+{
+  ++m_redraws;
+  if( m_loading )
+  {
+    ++m_blankFrames;
+  }
+  else
+  {
+    m_frameDrawn = true;
+  }
+  m_lastActivity = m_stepClock.elapsed();
+}
+
+void ViewBenchmark::animationFrameChanged( int /*frame*/, const QString& /*value*/ )
+{
+  if( m_framesShown > 0 && !m_frameDrawn )
+  {
+    // The previous frame was replaced before it had been drawn with all of its images
+    ++m_droppedFrames;
+  }
+
+  m_frameDrawn = false;
+  m_lastActivity = m_stepClock.elapsed();
+  if( ++m_framesShown >= m_animationFrames )
+  {
+    // The last frame is left to load, and the animation is removed once the step completes
+    WMSAnimation *animation = m_services->getAnimation();
+    if( animation )
+    {
+      animation->stop();
+    }
+  }
+}
+
+void ViewBenchmark::selectLayers()
+{
+  QAbstractItemModel *layersModel = m_service->getServiceLayerModel();
+
+  // Check the first layers that can be checked and have no sub-layers, in the order they appear in the model
+  int numChecked = 0;
+  std::vector< QModelIndex > pending;
+  pending.push_back( QModelIndex() );
+  while( !pending.empty() && numChecked < m_settings.m_numLayers )
+  {
+    QModelIndex parent = pending.front();
+    pending.erase( pending.begin() );
+
+    int numRows = layersModel->rowCount( parent );
+    for( int row = 0; row < numRows && numChecked < m_settings.m_numLayers; ++row )
+    {
+      QModelIndex index = layersModel->index( row, 0, parent );
+      if( layersModel->rowCount( index ) > 0 )
+      {
+        pending.push_back( index );
+      }
+      else if( layersModel->flags( index ) & Qt::ItemIsUserCheckable )
+      {
+        layersModel->setData( index, Qt::Checked, Qt::CheckStateRole );
+        ++numChecked;
+      }
+    }
+  }
+
+  delete layersModel;
+}
+
+void ViewBenchmark::requestStatistics()
+{
+  if( !m_statisticsAvailable )
+  {
+    // The service is not the mock server, so continue without statistics
+    QMap< QByteArray, qint64 > noStatistics;
+    if( m_stepRunning )
+    {
+      m_statisticsAfter = noStatistics;
+      finishStep( false );
+    }
+    else
+    {
+      m_statisticsBefore = noStatistics;
+      runStep();
+    }
+    return;
+  }
+
+  m_network.get( QNetworkRequest( m_statisticsURL ) );
+}
+
+void ViewBenchmark::statisticsReceived( QNetworkReply *reply )
+{
+  QMap< QByteArray, qint64 > statistics;
+  if( reply->error() == QNetworkReply::NoError )
+  {
+    QList< QByteArray > lines = reply->readAll().split( '\n' );
+    for( int i = 0; i < lines.size(); ++i )
+    {
+      int separator = lines[i].indexOf( '=' );
+      if( separator > 0 )
+      {
+        statistics[ lines[i].left( separator ) ] = lines[i].mid( separator + 1 ).toLongLong();
+      }
+    }
+  }
+
+  if( statistics.isEmpty() )
+  {
+    // Don't ask again for the rest of the benchmark
+    m_statisticsAvailable = false;
+  }
+  reply->deleteLater();
+
+  if( m_stepRunning )
+  {
+    m_statisticsAfter = statistics;
+    finishStep( false );
+  }
+  else
+  {
+    m_statisticsBefore = statistics;
+    runStep();
+  }
+}
+
+void ViewBenchmark::runStep()
+{
+  m_stepRunning = true;
+  m_redraws = 0;
+  m_blankFrames = 0;
+  m_lastActivity = 0;
+  m_animationFrames = 0;
+  m_framesShown = 0;
+  m_droppedFrames = 0;
+  m_applyTime = 0;
+  if( m_serviceProxy )
+  {
+    m_storeStatisticsBefore = m_serviceProxy->statistics();
+  }
+  m_stepClock.start();
+
+  m_burstCommands = m_steps[m_currentStep].split( ';' );
+  m_burstApplied = 0;
+  nextBurstCommand();
+  m_completionTimer.start( g_completionCheckInterval );
+}
+
+void ViewBenchmark::nextBurstCommand()
+{
+  QElapsedTimer applyClock;
+  applyClock.start();
+  applyCommand( m_burstCommands[m_burstApplied].trimmed() );
+  m_applyTime += applyClock.nsecsElapsed();
+  ++m_burstApplied;
+  m_lastActivity = m_stepClock.elapsed();
+
+  if( m_burstApplied < m_burstCommands.size() )
+  {
+    m_burstTimer.start( m_settings.m_burstInterval );
+  }
+}
+
+void ViewBenchmark::applyCommand( const QString &command )
+{
+  QStringList arguments = command.split( ' ', QString::SkipEmptyParts );
+  QString name = arguments[0].toLower();
+
+  if( name == "load" )
+  {
+    m_service->loadService( m_settings.m_serviceURL.toUtf8().constData() );
+    return;
+  }
+
+  TSLDrawingSurface *surface = m_surfaceWidget->drawingSurface();
+  if( name == "reset" )
+  {
+    m_surfaceWidget->resetView();
+  }
+  else if( name == "zoom" || name == "pan" )
+  {
+    double x1 = 0.0, y1 = 0.0, x2 = 0.0, y2 = 0.0;
+    surface->getUUExtent( &x1, &y1, &x2, &y2 );
+
+    double centreX = (x1 + x2) / 2.0, centreY = (y1 + y2) / 2.0;
+    double halfWidth = (x2 - x1) / 2.0, halfHeight = (y2 - y1) / 2.0;
+    if( name == "zoom" )
+    {
+      double factor = arguments[1].toDouble();
+      halfWidth /= factor;
+      halfHeight /= factor;
+    }
+    else
+    {
+      centreX += arguments[1].toDouble() * (x2 - x1);
+      centreY += arguments[2].toDouble() * (y2 - y1);
+    }
+
+    surface->resize( centreX - halfWidth, centreY - halfHeight, centreX + halfWidth, centreY + halfHeight, false, true );
+    m_surfaceWidget->update();
+  }
+  else if( name == "show" || name == "hide" )
+  {
+    // Layers are named by the rest of the line, as names and titles may contain spaces
+    QString layerName = command.section( ' ', 1, -1, QString::SectionSkipEmpty );
+
+    // Go through the service list's model so the loaded services tree stays up to date
+    ServiceListModel *model = m_services->getDisplayModel();
+    QModelIndex serviceIndex = findServiceIndex( model );
+    if( !serviceIndex.isValid() )
+    {
+      return;
+    }
+
+    if( name == "show" )
+    {
+      model->setLayerVisibility( model->data( serviceIndex, Qt::UserRole ), layerName, true );
+    }
+    else
+    {
+      for( int layerRow = 0; layerRow < model->rowCount( serviceIndex ); ++layerRow )
+      {
+        QModelIndex layerIndex = model->index( layerRow, 0, serviceIndex );
+        if( model->data( layerIndex, Qt::DisplayRole ).toString() == layerName )
+        {
+          model->removeItem( model->data( layerIndex, Qt::UserRole ) );
+          break;
+        }
+      }
+    }
+  }
+  else if( name == "reorder" )
+  {
+    // Move the layer as the loaded services tree does when a layer is dragged within its service
+    ServiceListModel *model = m_services->getDisplayModel();
+    QModelIndex serviceIndex = findServiceIndex( model );
+    int from = arguments[1].toInt(), to = arguments[2].toInt();
+    if( !serviceIndex.isValid() || from >= model->rowCount( serviceIndex ) )
+    {
+      std::cout << "Unable to reorder layer " << from << std::endl;
+      return;
+    }
+
+    QMimeData *data = model->mimeData( QModelIndexList() << model->index( from, 0, serviceIndex ) );
+    model->dropMimeData( data, Qt::MoveAction, std::min( to, model->rowCount( serviceIndex ) ), 0, serviceIndex );
+    delete data;
+  }
+  else if( name == "animate" )
+  {
+    WMSAnimation *animation = m_services->startAnimation( m_service, arguments[1].toUtf8().constData() );
+    if( !animation )
+    {
+      std::cout << "Unable to animate " << arguments[1].toUtf8().constData() << std::endl;
+      return;
+    }
+
+    m_animationFrames = arguments[3].toInt();
+    connect( animation, SIGNAL(frameChanged(int, const QString&)), this, SLOT(animationFrameChanged(int, const QString&)) );
+    animation->setFrameRate( arguments[2].toDouble() );
+
+    // The first frame was shown as the animation started
+    animationFrameChanged( animation->currentFrame(), QString() );
+  }
+}
+
+QModelIndex ViewBenchmark::findServiceIndex( ServiceListModel *model ) const
+{
+  for( int row = 0; row < model->rowCount(); ++row )
+  {
+    QModelIndex serviceIndex = model->index( row, 0 );
+    if( model->getService( model->data( serviceIndex, Qt::UserRole ) ) == m_service )
+    {
+      return serviceIndex;
+    }
+  }
+  return QModelIndex();
+}
+
+void ViewBenchmark::checkStepComplete()
+{
+  qint64 elapsed = m_stepClock.elapsed();
+  if( elapsed > m_settings.m_stepTimeout )
+  {
+    m_completionTimer.stop();
+    m_burstTimer.stop();
+    m_lastActivity = elapsed;
+    finishStep( true );
+    return;
+  }
+
+  // The view cannot be complete until the service has been added to the view and drawn, and
+  // every command of the step has been applied
+  if( m_loadStage != ServiceAdded || m_redraws == 0 || m_loading || m_burstApplied < m_burstCommands.size() )
+  {
+    return;
+  }
+
+  // An animation step lasts until every frame has been shown
+  WMSAnimation *animation = m_services->getAnimation();
+  if( animation && animation->playing() )
+  {
+    return;
+  }
+
+  if( elapsed - m_lastActivity >= m_settings.m_quietPeriod )
+  {
+    m_completionTimer.stop();
+    requestStatistics();
+  }
+}
+
+void ViewBenchmark::finishStep( bool timedOut )
+{
+  if( !m_stepRunning )
+  {
+    return;
+  }
+  m_stepRunning = false;
+
+  StepResult result;
+  result.m_command = m_steps[m_currentStep];
+  result.m_timeToComplete = m_lastActivity;
+  result.m_applyTime = m_applyTime / 1000;
+  result.m_redraws = m_redraws;
+  result.m_blankFrames = m_blankFrames;
+  result.m_requests = -1;
+  result.m_bytes = -1;
+  result.m_errors = -1;
+  result.m_timedOut = timedOut;
+  result.m_storeHits = -1;
+  result.m_storeRevalidated = -1;
+  result.m_storeOffline = -1;
+  result.m_storeMisses = -1;
+  result.m_prefetched = -1;
+  result.m_cancelled = -1;
+  result.m_framesShown = -1;
+  result.m_droppedFrames = -1;
+  result.m_frameRequests = -1;
+  result.m_frameHits = -1;
+  result.m_framesPrefetched = -1;
+  if( m_animationFrames > 0 )
+  {
+    m_services->stopAnimation();
+    result.m_framesShown = m_framesShown;
+    result.m_droppedFrames = m_droppedFrames;
+  }
+  if( m_serviceProxy )
+  {
+    OGCServiceProxy::Statistics storeStatistics = m_serviceProxy->statistics();
+    result.m_storeHits = storeStatistics.m_hits - m_storeStatisticsBefore.m_hits;
+    result.m_storeRevalidated = storeStatistics.m_revalidated - m_storeStatisticsBefore.m_revalidated;
+    result.m_storeOffline = storeStatistics.m_offline - m_storeStatisticsBefore.m_offline;
+    result.m_storeMisses = storeStatistics.m_misses - m_storeStatisticsBefore.m_misses;
+    result.m_prefetched = storeStatistics.m_prefetched - m_storeStatisticsBefore.m_prefetched;
+    result.m_cancelled = storeStatistics.m_cancelled - m_storeStatisticsBefore.m_cancelled;
+    if( m_animationFrames > 0 )
+    {
+      result.m_frameRequests = storeStatistics.m_frameRequests - m_storeStatisticsBefore.m_frameRequests;
+      result.m_frameHits = storeStatistics.m_frameHits - m_storeStatisticsBefore.m_frameHits;
+      result.m_framesPrefetched = storeStatistics.m_framesPrefetched - m_storeStatisticsBefore.m_framesPrefetched;
+    }
+  }
+  if( !timedOut && !m_statisticsBefore.isEmpty() && !m_statisticsAfter.isEmpty() )
+  {
+    result.m_requests = m_statisticsAfter.value( "requests" ) - m_statisticsBefore.value( "requests" );
+    result.m_bytes = m_statisticsAfter.value( "bytes" ) - m_statisticsBefore.value( "bytes" );
+    result.m_errors = m_statisticsAfter.value( "errors" ) - m_statisticsBefore.value( "errors" );
+  }
+
+  m_results.push_back( result );
+  reportStep( result );
+
+  if( timedOut )
+  {
+    m_failed = true;
+  }
+
+  if( timedOut && m_loadStage != ServiceAdded )
+  {
+    // The service never loaded, so the remaining steps cannot be run
+    finish( 1 );
+    return;
+  }
+
+  ++m_currentStep;
+  if( m_currentStep >= m_steps.size() )
+  {
+    reportSummary();
+    finish( m_failed ? 1 : 0 );
+    return;
+  }
+  requestStatistics();
+}
+
+void ViewBenchmark::reportStep( const StepResult &result )
+{
+  std::cout << std::setw( 3 ) << m_results.size() << "  " << std::left << std::setw( 20 ) << result.m_command.toUtf8().constData()
+            << std::right << "  time " << std::setw( 6 ) << result.m_timeToComplete << " ms"
+            << "  apply " << std::setw( 7 ) << result.m_applyTime << " us"
+            << "  redraws " << std::setw( 3 ) << result.m_redraws
+            << "  blank " << std::setw( 3 ) << result.m_blankFrames;
+  if( result.m_requests >= 0 )
+  {
+    std::cout << "  requests " << std::setw( 4 ) << result.m_requests
+              << "  bytes " << std::setw( 9 ) << result.m_bytes
+              << "  errors " << result.m_errors;
+  }
+  if( result.m_framesShown >= 0 )
+  {
+    std::cout << "  frames " << std::setw( 4 ) << result.m_framesShown
+              << "  dropped " << std::setw( 4 ) << result.m_droppedFrames;
+  }
+  if( result.m_frameRequests >= 0 )
+  {
+    std::cout << "  frame requests " << std::setw( 4 ) << result.m_frameRequests
+              << "  frame hits " << std::setw( 4 ) << result.m_frameHits
+              << "  frames prefetched " << std::setw( 4 ) << result.m_framesPrefetched;
+  }
+  if( result.m_storeHits >= 0 && m_service->type() == ServiceTypeWMTS )
+  {
+    std::cout << "  store hits " << std::setw( 4 ) << result.m_storeHits
+              << "  revalidated " << std::setw( 4 ) << result.m_storeRevalidated
+              << "  offline " << std::setw( 4 ) << result.m_storeOffline
+              << "  misses " << std::setw( 4 ) << result.m_storeMisses
+              << "  prefetched " << std::setw( 4 ) << result.m_prefetched
+              << "  cancelled " << std::setw( 4 ) << result.m_cancelled;
+  }
+  if( result.m_timedOut )
+  {
+    std::cout << "  TIMED OUT";
+  }
+  std::cout << std::endl;
+}
+
+void ViewBenchmark::reportSummary()
+{
+  // The first step loads the service, so is reported separately from the view changes
+  qint64 totalTime = 0, totalApplyTime = 0, totalRequests = 0, totalBytes = 0;
+  int totalRedraws = 0, totalBlankFrames = 0, numViews = 0;
+  bool haveStatistics = true;
+  for( size_t i = 1; i < m_results.size(); ++i )
+  {
+    const StepResult &result = m_results[i];
+    totalTime += result.m_timeToComplete;
+    totalApplyTime += result.m_applyTime;
+    totalRedraws += result.m_redraws;
+    totalBlankFrames += result.m_blankFrames;
+    if( result.m_requests >= 0 )
+    {
+      totalRequests += result.m_requests;
+      totalBytes += result.m_bytes;
+    }
+    else
+    {
+      haveStatistics = false;
+    }
+    ++numViews;
+  }
+
+  std::cout << "Service load: " << m_results[0].m_timeToComplete << " ms" << std::endl;
+
+  if( m_serviceProxy && m_service->type() == ServiceTypeWMTS )
+  {
+    // Include the service load, as a warm start is where the store makes the most difference
+    int storeAnswered = 0, storeTotal = 0;
+    for( size_t i = 0; i < m_results.size(); ++i )
+    {
+      const StepResult &result = m_results[i];
+      storeAnswered += result.m_storeHits + result.m_storeRevalidated + result.m_storeOffline;
+      storeTotal += result.m_storeHits + result.m_storeRevalidated + result.m_storeOffline + result.m_storeMisses;
+    }
+    std::cout << "Tile store: " << storeAnswered << " of " << storeTotal << " tiles answered from the store";
+    if( storeTotal > 0 )
+    {
+      std::cout << " (hit rate " << std::fixed << std::setprecision( 1 ) << 100.0 * storeAnswered / storeTotal << "%)";
+      std::cout.unsetf( std::ios_base::floatfield );
+    }
+    std::cout << std::endl;
+  }
+
+  // Animation steps are summarised separately, as their time depends on the frame rate rather than the service
+  int totalFrames = 0, totalDroppedFrames = 0;
+  for( size_t i = 1; i < m_results.size(); ++i )
+  {
+    if( m_results[i].m_framesShown >= 0 )
+    {
+      totalFrames += m_results[i].m_framesShown;
+      totalDroppedFrames += m_results[i].m_droppedFrames;
+    }
+  }
+  if( totalFrames > 0 )
+  {
+    std::cout << "Animation: " << totalDroppedFrames << " of " << totalFrames << " frames dropped" << std::endl;
+  }
+
+  if( numViews == 0 )
+  {
+    return;
+  }
+
+  std::cout << "Views: " << numViews
+            << "  total time " << totalTime << " ms"
+            << "  mean time-to-complete-view " << totalTime / numViews << " ms"
+            << "  mean apply time " << totalApplyTime / numViews << " us"
+            << "  mean redraws per view " << (double)totalRedraws / numViews
+            << "  total blank frames " << totalBlankFrames;
+  if( haveStatistics )
+  {
+    std::cout << "  total requests " << totalRequests
+              << "  total bytes " << totalBytes
+              << "  mean bytes per view " << totalBytes / numViews;
+  }
+  std::cout << std::endl;
+}
+
+void ViewBenchmark::finish( int exitCode )
+{
+  std::cout << (exitCode == 0 ? "Benchmark complete" : "Benchmark failed") << std::endl;
+  QCoreApplication::exit( exitCode );
+}
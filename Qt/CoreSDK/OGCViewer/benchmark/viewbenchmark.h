@@ -0,0 +1,249 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef VIEWBENCHMARK_H
+#define VIEWBENCHMARK_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QModelIndex>
+#include <QNetworkAccessManager>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QUrl>
+
+#include "services/service.h"
+#include "services/ogcserviceproxy.h"
+
+namespace Services
+{
+  class ServiceList;
+  class ServiceListModel;
+};
+class DrawingSurfaceWidget;
+class QNetworkReply;
+
+// Loads a service without the service wizard and runs a script of view changes against it,
+// measuring for each step how long the view takes to complete, how many times it is drawn
+// and, when the service is the mock OGC server, the requests and bytes the server sent.
+//
+// Scripts contain one command per line. Blank lines and lines starting with '#' are ignored.
+//   zoom <factor>      Zoom about the centre of the view. Factors above 1 zoom in.
+//   pan <dx> <dy>      Move the view by the given fractions of its width and height
+//   reset              Show the full extent of the loaded layers
+//   show <layer>       Make the named layer visible
+//   hide <layer>       Hide the named layer
+//   reorder <from> <to>
+//                      Drag the service's visible layer at row <from> of the loaded services tree
+//                      so that it is dropped before the layer at row <to>
+//   animate <dimension> <fps> <frames>
+//                      Play the named dimension of a WMS service for the given number of frames
+//
+// Several commands on one line, separated by ';', make a single step. They are applied one after
+// another at the burst interval without waiting for the view to complete, as a user zooming
+// quickly with the mouse wheel would, and the step is timed from the first until the view is stable.
+//
+// A view is complete once the file loader reports that all requests have finished and nothing
+// has been drawn or loaded for the quiet period, which must be longer than the service's latency.
+//
+// WMTS services are loaded through the tile store unless told otherwise, in which case each step
+// also reports how many tiles came from the store, how many were fetched from the server, how
+// many were prefetched and how many requests were cancelled as the view had moved on.
+//
+// Each step also reports how long its commands took to apply on the user interface thread, which
+// for show, hide and reorder is the cost of updating the service's layers and choosing the data
+// layer to display them, without any drawing or loading.
+//
+// WMS services are loaded through the service proxy too, so an animation step reports how many frames
+// were dropped, meaning the next frame was due before the view had been drawn with nothing left to
+// load, and how many images were answered from the proxy's frame cache or fetched into it ahead.
+
+class ViewBenchmark : public QObject, public Services::Service::ServiceActionCallback
+{
+  Q_OBJECT
+public:
+  struct Settings
+  {
+    Settings();
+
+    QString m_serviceURL;
+    ServiceTypeEnum m_serviceType;
+    QString m_scriptFile;
+
+    // The number of layers made visible when the service is loaded
+    int m_numLayers;
+
+    // Milliseconds without drawing or loading after which a view is considered complete
+    int m_quietPeriod;
+
+    // Milliseconds after which a step is abandoned
+    int m_stepTimeout;
+
+    // Whether a WMTS service is loaded through the tile store, and whether the store is
+    // emptied first to measure a cold start
+    bool m_useTileStore;
+    bool m_clearTileStore;
+
+    // Overrides the tile prefetch ring and budget (KB/s) from the general options when not negative
+    int m_prefetchRing;
+    int m_prefetchBudget;
+
+    // Whether the service proxy sends requests nearest the view's centre first and cancels obsolete
+    // ones, and overrides the requests it sends to each server at once when not negative
+    bool m_prioritise;
+    int m_serverConnections;
+
+    // Milliseconds between the commands of a step
+    int m_burstInterval;
+  };
+
+  ViewBenchmark( Services::ServiceList *services, DrawingSurfaceWidget *surfaceWidget, QObject *parent = NULL );
+  virtual ~ViewBenchmark();
+
+  // Reads the script and starts loading the service. Returns false, with a description of the
+  // problem in error, if the script cannot be used. The application exits once the benchmark ends,
+  // with a non-zero exit code if the service could not be loaded or a step timed out.
+  bool start( const Settings &settings, QString &error );
+
+signals:
+  void signalNextSequenceAction();
+  void signalChooseCoordinateSystem();
+  void signalShowError( const QString &message );
+
+public slots:
+  // Connected to the main window's loading state so the benchmark knows when requests are outstanding
+  void loadingStateChanged( bool loading );
+
+private slots:
+  void nextSequenceAction();
+  void chooseCoordinateSystem();
+  void showError( const QString &message );
+  void mapDrawn();
+  void nextBurstCommand();
+  void checkStepComplete();
+  void animationFrameChanged( int frame, const QString &value );
+  void statisticsReceived( QNetworkReply *reply );
+
+private:
+  // Callbacks made from the data layer while the service is loading. These are made from a separate
+  // thread so are passed on to the user interface thread through signals.
+  virtual void onError( const std::string &message );
+  virtual void onNextSequenceAction();
+  virtual void coordinateSystemChoiceRequired();
+
+  struct StepResult
+  {
+    QString m_command;
+    qint64 m_timeToComplete;
+
+    // Microseconds spent applying the step's commands
+    qint64 m_applyTime;
+    int m_redraws;
+
+    // Redraws made while requests were outstanding, which show the view with tiles missing
+    int m_blankFrames;
+    qint64 m_requests;
+    qint64 m_bytes;
+    qint64 m_errors;
+    bool m_timedOut;
+
+    // Tiles answered by the tile store, or -1 if the service is not loaded through it
+    int m_storeHits;
+    int m_storeRevalidated;
+    int m_storeOffline;
+    int m_storeMisses;
+    int m_prefetched;
+    int m_cancelled;
+
+    // Frames of an animation step shown and dropped, and the map requests answered from the frame cache
+    // or fetched into it, or -1 if the step did not animate
+    int m_framesShown;
+    int m_droppedFrames;
+    int m_frameRequests;
+    int m_frameHits;
+    int m_framesPrefetched;
+  };
+
+  // Checks the first m_numLayers layers of the service that can be selected
+  void selectLayers();
+
+  // Fetches the mock server's statistics, either before or after the current step
+  void requestStatistics();
+
+  // Checks a single command from the script
+  static bool validCommand( const QString &command );
+
+  // Applies the current step's first command and starts timing it
+  void runStep();
+  void applyCommand( const QString &command );
+
+  // Finds the service being benchmarked in the service list's model
+  QModelIndex findServiceIndex( Services::ServiceListModel *model ) const;
+
+  void finishStep( bool timedOut );
+  void reportStep( const StepResult &result );
+  void reportSummary();
+  void finish( int exitCode );
+
+  enum LoadStage
+  {
+    LoadingCapabilities,
+    ConfiguringService,
+    ServiceAdded
+  };
+
+  Services::ServiceList *m_services;
+  DrawingSurfaceWidget *m_surfaceWidget;
+  Settings m_settings;
+
+  // The service being benchmarked. This is owned by the service list once it has been added.
+  Services::Service *m_service;
+  LoadStage m_loadStage;
+
+  // The first step is loading the service, which is followed by the steps from the script
+  QStringList m_steps;
+  int m_currentStep;
+  bool m_stepRunning;
+
+  // The current step's commands, and the number applied so far
+  QStringList m_burstCommands;
+  int m_burstApplied;
+  QTimer m_burstTimer;
+
+  QElapsedTimer m_stepClock;
+  QTimer m_completionTimer;
+  qint64 m_applyTime;
+  qint64 m_lastActivity;
+  int m_redraws;
+  int m_blankFrames;
+  bool m_loading;
+  bool m_failed;
+
+  // The frames the current animation step plays, those shown so far and those dropped, and whether the
+  // frame shown has been drawn complete
+  int m_animationFrames;
+  int m_framesShown;
+  int m_droppedFrames;
+  bool m_frameDrawn;
+
+  // Statistics from the mock server, which are not available from other services
+  QNetworkAccessManager m_network;
+  QUrl m_statisticsURL;
+  bool m_statisticsAvailable;
+  QMap< QByteArray, qint64 > m_statisticsBefore;
+  QMap< QByteArray, qint64 > m_statisticsAfter;
+
+  // The tile store's statistics when the current step started, if the service is loaded through it
+  Services::OGCServiceProxy *m_serviceProxy;
+  Services::OGCServiceProxy::Statistics m_storeStatisticsBefore;
+
+  std::vector< StepResult > m_results;
+};
+
+#endif // VIEWBENCHMARK_H
@@ -5,6 +5,7 @@
 #include <QApplication>
 #include <QMessageBox>
 #include <stdlib.h>
+#include <iostream>
 #ifdef WIN32
 # include <direct.h>
 #else
@@ -58,6 +59,8 @@ int main(int argc, char *argv[])
   //application.setAttribute( Qt::AA_NativeWindows );
 
   // Parse the application's command line arguments
+  ViewBenchmark::Settings benchmarkSettings;
+  PreviewBenchmark::Settings previewBenchmarkSettings;
   QStringList argumentList = application.arguments();
   for( int i = 1; i < argumentList.size(); ++i )
   {
@@ -65,7 +68,23 @@ int main(int argc, char *argv[])
         argumentList[i].compare( "-help", Qt::CaseInsensitive ) == 0 )
     {
       QMessageBox::information( NULL, "Help",
-                                "Help:\n  OGCServiceViewer /home path_to_install\t(The directory containing the config directory)" );
+                                "Help:\n  OGCServiceViewer /home path_to_install\t(The directory containing the config directory)"
+                                "\n  OGCServiceViewer /benchmark service_url script_file\t(Load the WMS at service_url and time the view changes in script_file)"
+                                "\n    /wmts\t(The service is a WMTS)"
+                                "\n    /benchmarklayers n\t(The number of layers to show, default 1)"
+                                "\n    /quietperiod ms\t(Time without drawing or loading after which a view is complete, default 1000)"
+                                "\n    /cleartilestore\t(Empty the WMTS tile store before loading the service)"
+                                "\n    /notilestore\t(Load the service directly rather than through the service proxy)"
+                                "\n    /prefetchring n\t(Tiles around the view to prefetch, 0 to disable)"
+                                "\n    /prefetchbudget kb\t(Most KB per second to prefetch, 0 for no limit)"
+                                "\n    /noprioritise\t(Send WMTS requests in the order they are made, without cancelling any)"
+                                "\n    /serverconnections n\t(Most WMTS requests sent to the server at once)"
+                                "\n    /burstinterval ms\t(Time between the commands of a step separated by ';', default 100)"
+                                "\n  OGCServiceViewer /previewbenchmark service_url\t(Load the WMS at service_url and time previewing its layers)"
+                                "\n    /wmts\t(The service is a WMTS)"
+                                "\n    /previewclicks n\t(The number of layers to select, default 100)"
+                                "\n    /clickinterval ms\t(Time between selections, default 50)"
+                                "\n    /previewdelay ms\t(Time a preview waits for a later selection before loading)" );
       return 0;
     }
     else if( (argumentList[i].compare( "/home", Qt::CaseInsensitive ) == 0 ||
@@ -80,6 +99,105 @@ int main(int argc, char *argv[])
       TSLUtilityFunctions::setMapLinkHome( homePath.toUtf8(), true );
       ++i;
     }
+    else if( (argumentList[i].compare( "/benchmark", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-benchmark", Qt::CaseInsensitive ) == 0)
+             && i+2 < argumentList.size() )
+    {
+      benchmarkSettings.m_serviceURL = argumentList[i+1];
+      benchmarkSettings.m_scriptFile = argumentList[i+2];
+      i += 2;
+    }
+    else if( (argumentList[i].compare( "/previewbenchmark", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-previewbenchmark", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      previewBenchmarkSettings.m_serviceURL = argumentList[i+1];
+      ++i;
+    }
+    else if( argumentList[i].compare( "/wmts", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-wmts", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkSettings.m_serviceType = ServiceTypeWMTS;
+      previewBenchmarkSettings.m_serviceType = ServiceTypeWMTS;
+    }
+    else if( (argumentList[i].compare( "/benchmarklayers", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-benchmarklayers", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      benchmarkSettings.m_numLayers = qMax( 1, argumentList[i+1].toInt() );
+      ++i;
+    }
+    else if( (argumentList[i].compare( "/quietperiod", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-quietperiod", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      benchmarkSettings.m_quietPeriod = qMax( 0, argumentList[i+1].toInt() );
+      ++i;
+    }
+    else if( argumentList[i].compare( "/cleartilestore", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-cleartilestore", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkSettings.m_clearTileStore = true;
+    }
+    else if( argumentList[i].compare( "/notilestore", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-notilestore", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkSettings.m_useTileStore = false;
+    }
+    else if( (argumentList[i].compare( "/prefetchring", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-prefetchring", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      benchmarkSettings.m_prefetchRing = qMax( 0, argumentList[i+1].toInt() );
+      ++i;
+    }
+    else if( (argumentList[i].compare( "/prefetchbudget", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-prefetchbudget", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      benchmarkSettings.m_prefetchBudget = qMax( 0, argumentList[i+1].toInt() );
+      ++i;
+    }
+    else if( (argumentList[i].compare( "/previewclicks", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-previewclicks", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      previewBenchmarkSettings.m_numClicks = qMax( 1, argumentList[i+1].toInt() );
+      ++i;
+    }
+    else if( (argumentList[i].compare( "/clickinterval", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-clickinterval", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      previewBenchmarkSettings.m_clickInterval = qMax( 0, argumentList[i+1].toInt() );
+      ++i;
+    }
+    else if( (argumentList[i].compare( "/previewdelay", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-previewdelay", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      previewBenchmarkSettings.m_debouncePeriod = qMax( 0, argumentList[i+1].toInt() );
+      ++i;
+    }
+    else if( argumentList[i].compare( "/noprioritise", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-noprioritise", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkSettings.m_prioritise = false;
+    }
+    else if( (argumentList[i].compare( "/serverconnections", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-serverconnections", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      benchmarkSettings.m_serverConnections = qMax( 1, argumentList[i+1].toInt() );
+      ++i;
+    }
+    else if( (argumentList[i].compare( "/burstinterval", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-burstinterval", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      benchmarkSettings.m_burstInterval = qMax( 0, argumentList[i+1].toInt() );
+      ++i;
+    }
   }
 
   // Load the standard MapLink configuration files
@@ -90,5 +208,19 @@ int main(int argc, char *argv[])
   MainWindow window;
   window.show();
 
+  if( !benchmarkSettings.m_serviceURL.isEmpty() )
+  {
+    QString error;
+    if( !window.runBenchmark( benchmarkSettings, error ) )
+    {
+      std::cerr << error.toUtf8().constData() << std::endl;
+      return 1;
+    }
+  }
+  else if( !previewBenchmarkSettings.m_serviceURL.isEmpty() )
+  {
+    window.runPreviewBenchmark( previewBenchmarkSettings );
+  }
+
   return application.exec();
 }
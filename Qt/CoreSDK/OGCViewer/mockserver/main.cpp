@@ -0,0 +1,136 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include <iostream>
+
+#include <QCoreApplication>
+#include <QStringList>
+
+#include "mockogcserver.h"
+
+// This file contains the mock server's entry point.
+
+static void showUsage()
+{
+  std::cout << "Usage: MockOGCServer [options]\n"
+               "  -port n           Port to listen on (default 8080)\n"
+               "  -latency ms       Delay before each response is sent (default 0)\n"
+               "  -bandwidth kb     Kilobytes per second sent on each connection, 0 for no limit (default 0)\n"
+               "  -errorrate r      Fraction of GetMap/GetTile requests that fail, 0 to 1 (default 0)\n"
+               "  -maxconcurrent n  Requests processed at once, others are queued. 0 for no limit (default 0)\n"
+               "  -seed n           Seed for choosing which requests fail (default 1)\n"
+               "  -layers n         Number of layers offered (default 4)\n"
+               "  -levels n         Number of WMTS tile matrix levels (default 19)\n"
+               "  -times n          Number of hourly values of a WMS time dimension, 0 for none (default 0)\n"
+               "  -groupsize n      Number of WMS layers in each group layer, 0 for no groups (default 0)\n"
+               "  -maxage s         Seconds capabilities and tiles may be cached for (default 3600)\n"
+               "  -verbose          Print a line for each request\n"
+               "\n"
+               "The WMS is at http://localhost:<port>/wms and the WMTS at http://localhost:<port>/wmts.\n"
+               "http://localhost:<port>/stats returns the requests and bytes served, /reset clears them.\n";
+}
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication application(argc, argv);
+
+  MockOGCServer::Settings settings;
+
+  QStringList argumentList = application.arguments();
+  for( int i = 1; i < argumentList.size(); ++i )
+  {
+    QString option = argumentList[i].toLower();
+    if( option.startsWith( '/' ) )
+    {
+      option[0] = '-';
+    }
+
+    if( option == "-verbose" )
+    {
+      settings.m_verbose = true;
+      continue;
+    }
+
+    if( option == "-help" || i + 1 >= argumentList.size() )
+    {
+      showUsage();
+      return option == "-help" ? 0 : 1;
+    }
+
+    bool valid = false;
+    QString value = argumentList[++i];
+    if( option == "-port" )
+    {
+      settings.m_port = (quint16)value.toUShort( &valid );
+    }
+    else if( option == "-latency" )
+    {
+      settings.m_latency = value.toInt( &valid );
+    }
+    else if( option == "-bandwidth" )
+    {
+      settings.m_bandwidth = value.toInt( &valid ) * 1024;
+    }
+    else if( option == "-errorrate" )
+    {
+      settings.m_errorRate = value.toDouble( &valid );
+    }
+    else if( option == "-maxconcurrent" )
+    {
+      settings.m_maxConcurrent = value.toInt( &valid );
+    }
+    else if( option == "-seed" )
+    {
+      settings.m_seed = value.toUInt( &valid );
+    }
+    else if( option == "-layers" )
+    {
+      settings.m_numLayers = value.toInt( &valid );
+      valid = valid && settings.m_numLayers > 0;
+    }
+    else if( option == "-levels" )
+    {
+      settings.m_numLevels = value.toInt( &valid );
+      valid = valid && settings.m_numLevels > 0 && settings.m_numLevels <= 30;
+    }
+    else if( option == "-times" )
+    {
+      settings.m_numTimes = value.toInt( &valid );
+      valid = valid && settings.m_numTimes >= 0;
+    }
+    else if( option == "-groupsize" )
+    {
+      settings.m_groupSize = value.toInt( &valid );
+      valid = valid && settings.m_groupSize >= 0;
+    }
+    else if( option == "-maxage" )
+    {
+      settings.m_maxAge = value.toInt( &valid );
+      valid = valid && settings.m_maxAge >= 0;
+    }
+
+    if( !valid )
+    {
+      std::cout << "Invalid option " << argumentList[i-1].toLocal8Bit().constData() << " "
+                << value.toLocal8Bit().constData() << "\n\n";
+      showUsage();
+      return 1;
+    }
+  }
+
+  MockOGCServer server( settings );
+  if( !server.start() )
+  {
+    std::cout << "Unable to listen on port " << settings.m_port << ": "
+              << server.errorString().toLocal8Bit().constData() << std::endl;
+    return 1;
+  }
+
+  std::cout << "Serving " << settings.m_numLayers << " layers on port " << settings.m_port
+            << " (latency " << settings.m_latency << "ms, bandwidth " << settings.m_bandwidth / 1024
+            << "KB/s, error rate " << settings.m_errorRate << ", max concurrent " << settings.m_maxConcurrent
+            << ", seed " << settings.m_seed << ")" << std::endl;
+
+  return application.exec();
+}
@@ -0,0 +1,285 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include <math.h>
+#include <vector>
+
+#include <QBuffer>
+#include <QColor>
+#include <QDateTime>
+#include <QImage>
+#include <QImageWriter>
+
+#include "mockimagery.h"
+
+// Extent of the GoogleMapsCompatible tile matrix set in EPSG:3857 map units
+static const double g_worldHalfWidth = 20037508.3427892;
+static const double g_level0ScaleDenominator = 559082264.0287178;
+static const int g_tileSize = 256;
+
+// Used for all generated layers
+static const char *g_wgs84Extent[4] = { "-180", "-85.0511287798", "180", "85.0511287798" };
+
+QByteArray MockImagery::layerName( int layerIndex )
+{
+  return "layer" + QByteArray::number( layerIndex );
+}
+
+int MockImagery::layerIndex( const QByteArray &name, int numLayers )
+{
+  if( !name.startsWith( "layer" ) )
+  {
+    return -1;
+  }
+
+  bool valid = false;
+  int index = name.mid( 5 ).toInt( &valid );
+  if( !valid || index < 0 || index >= numLayers )
+  {
+    return -1;
+  }
+  return index;
+}
+
+QByteArray MockImagery::timeValue( int timeIndex )
+{
+  QDateTime time( QDate( 2017, 1, 1 ), QTime( 0, 0 ), Qt::UTC );
+  return time.addSecs( timeIndex * 3600 ).toString( "yyyy-MM-ddTHH:mm:ssZ" ).toLatin1();
+}
+
+int MockImagery::timeIndex( const QByteArray &value, int numTimes )
+{
+  QDateTime time( QDateTime::fromString( QString::fromLatin1( value ), "yyyy-MM-ddTHH:mm:ssZ" ) );
+  if( !time.isValid() )
+  {
+    return -1;
+  }
+  time.setTimeSpec( Qt::UTC );
+
+  QDateTime first( QDate( 2017, 1, 1 ), QTime( 0, 0 ), Qt::UTC );
+  qint64 seconds = first.secsTo( time );
+  if( seconds < 0 || seconds % 3600 != 0 || seconds / 3600 >= numTimes )
+  {
+    return -1;
+  }
+  return (int)(seconds / 3600);
+}
+
+QByteArray MockImagery::wmsCapabilities( const QByteArray &baseURL, int numLayers, int numTimes, int groupSize )
+{
+  QByteArray onlineResource = "<OnlineResource xlink:type=\"simple\" xlink:href=\"" + baseURL + "\"/>";
+  QByteArray dcpType = "<DCPType><HTTP><Get>" + onlineResource + "</Get></HTTP></DCPType>";
+
+  QByteArray document;
+  document += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+              "<WMS_Capabilities version=\"1.3.0\" xmlns=\"http://www.opengis.net/wms\" xmlns:xlink=\"http://www.w3.org/1999/xlink\">\n"
+              "<Service><Name>WMS</Name><Title>Mock WMS</Title>" + onlineResource + "</Service>\n"
+              "<Capability>\n"
+              "<Request>\n"
+              "<GetCapabilities><Format>text/xml</Format>" + dcpType + "</GetCapabilities>\n"
+              "<GetMap><Format>image/png</Format><Format>image/jpeg</Format>" + dcpType + "</GetMap>\n"
+              "</Request>\n"
+              "<Exception><Format>XML</Format></Exception>\n"
+              "<Layer>\n"
+              "<Title>Mock layers</Title>\n"
+              "<CRS>EPSG:3857</CRS><CRS>EPSG:4326</CRS><CRS>CRS:84</CRS>\n";
+  document += QByteArray( "<EX_GeographicBoundingBox><westBoundLongitude>" ) + g_wgs84Extent[0] + "</westBoundLongitude>"
+              "<eastBoundLongitude>" + g_wgs84Extent[2] + "</eastBoundLongitude>"
+              "<southBoundLatitude>" + g_wgs84Extent[1] + "</southBoundLatitude>"
+              "<northBoundLatitude>" + g_wgs84Extent[3] + "</northBoundLatitude></EX_GeographicBoundingBox>\n";
+  document += "<BoundingBox CRS=\"EPSG:3857\" minx=\"-20037508.3427892\" miny=\"-20037508.3427892\" maxx=\"20037508.3427892\" maxy=\"20037508.3427892\"/>\n";
+  // EPSG:4326 uses latitude/longitude axis order in WMS 1.3.0
+  document += QByteArray( "<BoundingBox CRS=\"EPSG:4326\" minx=\"" ) + g_wgs84Extent[1] + "\" miny=\"" + g_wgs84Extent[0] +
+              "\" maxx=\"" + g_wgs84Extent[3] + "\" maxy=\"" + g_wgs84Extent[2] + "\"/>\n";
+  document += QByteArray( "<BoundingBox CRS=\"CRS:84\" minx=\"" ) + g_wgs84Extent[0] + "\" miny=\"" + g_wgs84Extent[1] +
+              "\" maxx=\"" + g_wgs84Extent[2] + "\" maxy=\"" + g_wgs84Extent[3] + "\"/>\n";
+
+  if( numTimes > 0 )
+  {
+    // Declared on the root layer, so every layer inherits it
+    document += "<Dimension name=\"time\" units=\"ISO8601\" default=\"" + timeValue( 0 ) + "\">";
+    for( int i = 0; i < numTimes; ++i )
+    {
+      if( i > 0 )
+      {
+        document += ",";
+      }
+      document += timeValue( i );
+    }
+    document += "</Dimension>\n";
+  }
+
+  for( int i = 0; i < numLayers; ++i )
+  {
+    if( groupSize > 0 && i % groupSize == 0 )
+    {
+      // Groups have no name, so cannot be requested themselves
+      if( i > 0 )
+      {
+        document += "</Layer>\n";
+      }
+      document += "<Layer><Title>Group " + QByteArray::number( i / groupSize ) + "</Title>\n";
+    }
+
+    document += "<Layer queryable=\"0\" opaque=\"0\"><Name>" + layerName( i ) + "</Name>"
+                "<Title>Layer " + QByteArray::number( i ) + "</Title>"
+                "<Style><Name>default</Name><Title>Default</Title></Style></Layer>\n";
+  }
+
+  if( groupSize > 0 && numLayers > 0 )
+  {
+    document += "</Layer>\n";
+  }
+
+  document += "</Layer>\n"
+              "</Capability>\n"
+              "</WMS_Capabilities>\n";
+  return document;
+}
+
+QByteArray MockImagery::wmtsCapabilities( const QByteArray &baseURL, int numLayers, int numLevels )
+{
+  QByteArray dcp = "<ows:DCP><ows:HTTP><ows:Get xlink:href=\"" + baseURL + "\">"
+                   "<ows:Constraint name=\"GetEncoding\"><ows:AllowedValues><ows:Value>KVP</ows:Value></ows:AllowedValues></ows:Constraint>"
+                   "</ows:Get></ows:HTTP></ows:DCP>";
+
+  QByteArray document;
+  document += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+              "<Capabilities xmlns=\"http://www.opengis.net/wmts/1.0\" xmlns:ows=\"http://www.opengis.net/ows/1.1\" "
+              "xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.0.0\">\n"
+              "<ows:ServiceIdentification><ows:Title>Mock WMTS</ows:Title><ows:ServiceType>OGC WMTS</ows:ServiceType>"
+              "<ows:ServiceTypeVersion>1.0.0</ows:ServiceTypeVersion></ows:ServiceIdentification>\n"
+              "<ows:OperationsMetadata>\n"
+              "<ows:Operation name=\"GetCapabilities\">" + dcp + "</ows:Operation>\n"
+              "<ows:Operation name=\"GetTile\">" + dcp + "</ows:Operation>\n"
+              "</ows:OperationsMetadata>\n"
+              "<Contents>\n";
+
+  for( int i = 0; i < numLayers; ++i )
+  {
+    document += "<Layer><ows:Title>Layer " + QByteArray::number( i ) + "</ows:Title>"
+                "<ows:WGS84BoundingBox><ows:LowerCorner>" + g_wgs84Extent[0] + " " + g_wgs84Extent[1] + "</ows:LowerCorner>"
+                "<ows:UpperCorner>" + g_wgs84Extent[2] + " " + g_wgs84Extent[3] + "</ows:UpperCorner></ows:WGS84BoundingBox>"
+                "<ows:Identifier>" + layerName( i ) + "</ows:Identifier>"
+                "<Style isDefault=\"true\"><ows:Identifier>default</ows:Identifier></Style>"
+                "<Format>image/png</Format>"
+                "<TileMatrixSetLink><TileMatrixSet>GoogleMapsCompatible</TileMatrixSet></TileMatrixSetLink></Layer>\n";
+  }
+
+  document += "<TileMatrixSet><ows:Identifier>GoogleMapsCompatible</ows:Identifier>"
+              "<ows:SupportedCRS>urn:ogc:def:crs:EPSG::3857</ows:SupportedCRS>"
+              "<WellKnownScaleSet>urn:ogc:def:wkss:OGC:1.0:GoogleMapsCompatible</WellKnownScaleSet>\n";
+  for( int level = 0; level < numLevels; ++level )
+  {
+    QByteArray matrixSize = QByteArray::number( 1 << level );
+    document += "<TileMatrix><ows:Identifier>" + QByteArray::number( level ) + "</ows:Identifier>"
+                "<ScaleDenominator>" + QByteArray::number( g_level0ScaleDenominator / (1 << level), 'f', 10 ) + "</ScaleDenominator>"
+                "<TopLeftCorner>-20037508.3427892 20037508.3427892</TopLeftCorner>"
+                "<TileWidth>" + QByteArray::number( g_tileSize ) + "</TileWidth>"
+                "<TileHeight>" + QByteArray::number( g_tileSize ) + "</TileHeight>"
+                "<MatrixWidth>" + matrixSize + "</MatrixWidth><MatrixHeight>" + matrixSize + "</MatrixHeight></TileMatrix>\n";
+  }
+  document += "</TileMatrixSet>\n"
+              "</Contents>\n"
+              "</Capabilities>\n";
+  return document;
+}
+
+QByteArray MockImagery::wmsException( const char *code, const QByteArray &message )
+{
+  return QByteArray( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                     "<ServiceExceptionReport version=\"1.3.0\" xmlns=\"http://www.opengis.net/ogc\">"
+                     "<ServiceException code=\"" ) + code + "\">" + message + "</ServiceException></ServiceExceptionReport>\n";
+}
+
+QByteArray MockImagery::wmtsException( const char *code, const QByteArray &message )
+{
+  return QByteArray( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                     "<ows:ExceptionReport xmlns:ows=\"http://www.opengis.net/ows/1.1\" version=\"1.0.0\">"
+                     "<ows:Exception exceptionCode=\"" ) + code + "\"><ows:ExceptionText>" + message +
+                     "</ows:ExceptionText></ows:Exception></ows:ExceptionReport>\n";
+}
+
+bool MockImagery::tileExtent( int level, int row, int column, double &x1, double &y1, double &x2, double &y2 )
+{
+  if( level < 0 || level > 30 )
+  {
+    return false;
+  }
+
+  int matrixSize = 1 << level;
+  if( row < 0 || row >= matrixSize || column < 0 || column >= matrixSize )
+  {
+    return false;
+  }
+
+  double tileWidth = 2.0 * g_worldHalfWidth / matrixSize;
+  x1 = -g_worldHalfWidth + column * tileWidth;
+  x2 = x1 + tileWidth;
+  y2 = g_worldHalfWidth - row * tileWidth;
+  y1 = y2 - tileWidth;
+  return true;
+}
+
+QByteArray MockImagery::renderImage( int layerIndex, int frame, double x1, double y1, double x2, double y2,
+                                     int width, int height, const QByteArray &format, bool transparent )
+{
+  const char *writerFormat = NULL;
+  if( format == "image/png" )
+  {
+    writerFormat = "png";
+  }
+  else if( format == "image/jpeg" )
+  {
+    // JPEG has no alpha channel
+    writerFormat = "jpeg";
+    transparent = false;
+  }
+  else
+  {
+    return QByteArray();
+  }
+
+  // Chequers are a power of two map units in size, about a quarter of the requested width, and
+  // aligned to multiples of their size so that images of neighbouring areas join up.
+  double requestWidth = fabs( x2 - x1 );
+  double cellSize = pow( 2.0, floor( log( requestWidth > 0.0 ? requestWidth / 4.0 : 1.0 ) / log( 2.0 ) ) );
+
+  int hue = (layerIndex * 67) % 360;
+  QRgb light = QColor::fromHsv( hue, 80, 255 ).rgba();
+  QRgb dark = transparent ? qRgba( 0, 0, 0, 0 ) : QColor::fromHsv( hue, 200, 190 ).rgba();
+
+  // Which chequer column each pixel column falls into. Each frame moves the columns an eighth of a
+  // chequer, which keeps images of neighbouring areas of the same frame joined up.
+  double frameShift = (frame % 8) * cellSize / 8.0;
+  std::vector< int > columnCells( width );
+  for( int px = 0; px < width; ++px )
+  {
+    double x = x1 + (px + 0.5) * (x2 - x1) / width;
+    columnCells[px] = (int)floor( (x + frameShift) / cellSize );
+  }
+
+  QImage image( width, height, transparent ? QImage::Format_ARGB32 : QImage::Format_RGB32 );
+  for( int py = 0; py < height; ++py )
+  {
+    double y = y2 - (py + 0.5) * (y2 - y1) / height;
+    int rowCell = (int)floor( y / cellSize );
+
+    QRgb *line = reinterpret_cast< QRgb* >( image.scanLine( py ) );
+    for( int px = 0; px < width; ++px )
+    {
+      line[px] = ((columnCells[px] + rowCell) & 1) ? dark : light;
+    }
+  }
+
+  QByteArray encoded;
+  QBuffer buffer( &encoded );
+  buffer.open( QIODevice::WriteOnly );
+  QImageWriter writer( &buffer, writerFormat );
+  if( !writer.write( image ) )
+  {
+    return QByteArray();
+  }
+  return encoded;
+}
@@ -0,0 +1,54 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef MOCKIMAGERY_H
+#define MOCKIMAGERY_H
+
+#include <QByteArray>
+
+// Generates the documents and imagery served by the mock WMS/WMTS server.
+// The imagery is a chequerboard aligned to map units, coloured by layer, so
+// that adjacent images and tiles line up and the layer and level being shown
+// can be told apart in the viewer. Content is a pure function of the request,
+// which keeps the number of bytes sent for a given view repeatable.
+
+class MockImagery
+{
+public:
+  // The names of the layers offered by both services are "layer0" to "layer<numLayers-1>".
+  static QByteArray layerName( int layerIndex );
+
+  // Returns the index of the named layer, or -1 if it is not one of the generated layers
+  static int layerIndex( const QByteArray &name, int numLayers );
+
+  // The values of the WMS time dimension, hourly from the start of 2017
+  static QByteArray timeValue( int timeIndex );
+
+  // Returns the index of a time value, or -1 if it is not one of the first numTimes values
+  static int timeIndex( const QByteArray &value, int numTimes );
+
+  // Capabilities documents. baseURL is the address requests should be sent back to, and
+  // must end with '?'. The WMS layers have a time dimension when numTimes is above 0, and
+  // are nested in untitled groups of groupSize layers, "Group 0" onwards, when groupSize
+  // is above 0, as a large catalogue would arrange them.
+  static QByteArray wmsCapabilities( const QByteArray &baseURL, int numLayers, int numTimes, int groupSize );
+  static QByteArray wmtsCapabilities( const QByteArray &baseURL, int numLayers, int numLevels );
+
+  // Service exception documents for reporting request errors
+  static QByteArray wmsException( const char *code, const QByteArray &message );
+  static QByteArray wmtsException( const char *code, const QByteArray &message );
+
+  // Calculates the extent in EPSG:3857 map units of a tile in the GoogleMapsCompatible tile matrix set.
+  // Returns false if the tile is outside the matrix.
+  static bool tileExtent( int level, int row, int column, double &x1, double &y1, double &x2, double &y2 );
+
+  // Draws the given extent of a layer into an image of the given size and encodes it in the
+  // requested format ("image/png" or "image/jpeg"). Returns an empty array if the format is not
+  // supported. The chequerboard moves a little with each frame, the index of the time value asked
+  // for, so that an animation can be seen to play.
+  static QByteArray renderImage( int layerIndex, int frame, double x1, double y1, double x2, double y2,
+                                 int width, int height, const QByteArray &format, bool transparent );
+};
+
+#endif // MOCKIMAGERY_H
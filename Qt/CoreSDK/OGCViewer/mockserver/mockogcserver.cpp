@@ -0,0 +1,578 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QList>
+#include <QTcpSocket>
+
+#include "mockogcserver.h"
+#include "mockimagery.h"
+
+// How often the latency and bandwidth simulation is advanced
+static const int g_processInterval = 5;
+
+// Sending stops while the socket has more than this many bytes waiting to be written, so that
+// the bandwidth limit is applied by this server rather than hidden by the operating system's buffers
+static const qint64 g_maxUnwrittenBytes = 16 * 1024;
+
+// The largest image a GetMap request may ask for
+static const int g_maxImageSize = 4096;
+
+MockOGCServer::Settings::Settings()
+  : m_port( 8080 )
+  , m_latency( 0 )
+  , m_bandwidth( 0 )
+  , m_errorRate( 0.0 )
+  , m_maxConcurrent( 0 )
+  , m_seed( 1 )
+  , m_numLayers( 4 )
+  , m_numLevels( 19 )
+  , m_numTimes( 0 )
+  , m_groupSize( 0 )
+  , m_maxAge( 3600 )
+  , m_verbose( false )
+{
+}
+
+MockOGCServer::Statistics::Statistics()
+  : m_requests( 0 )
+  , m_capabilitiesRequests( 0 )
+  , m_mapRequests( 0 )
+  , m_tileRequests( 0 )
+  , m_errors( 0 )
+  , m_notModified( 0 )
+  , m_bytesSent( 0 )
+  , m_peakActive( 0 )
+  , m_peakQueued( 0 )
+{
+}
+
+MockOGCServer::Connection::Connection()
+  : m_state( ConnectionIdle )
+  , m_closeAfterResponse( false )
+  , m_responseWritten( 0 )
+  , m_responseDue( 0 )
+  , m_lastSendTime( 0 )
+{
+}
+
+MockOGCServer::MockOGCServer( const Settings &settings, QObject *parent )
+  : QTcpServer( parent )
+  , m_settings( settings )
+  , m_activeRequests( 0 )
+  , m_randomState( settings.m_seed )
+{
+  connect( &m_processTimer, SIGNAL(timeout()), this, SLOT(processConnections()) );
+}
+
+MockOGCServer::~MockOGCServer()
+{
+}
+
+bool MockOGCServer::start()
+{
+  if( !listen( QHostAddress::Any, m_settings.m_port ) )
+  {
+    return false;
+  }
+
+  m_clock.start();
+  m_processTimer.start( g_processInterval );
+  return true;
+}
+
+void MockOGCServer::incomingConnection( qintptr socketDescriptor )
+{
+  QTcpSocket *socket = new QTcpSocket( this );
+  if( !socket->setSocketDescriptor( socketDescriptor ) )
+  {
+    delete socket;
+    return;
+  }
+
+  m_connections[socket] = Connection();
+  connect( socket, SIGNAL(readyRead()), this, SLOT(readRequests()) );
+  connect( socket, SIGNAL(disconnected()), this, SLOT(connectionClosed()) );
+}
+
+void MockOGCServer::readRequests()
+{
+  QTcpSocket *socket = qobject_cast< QTcpSocket* >( sender() );
+  std::map< QTcpSocket*, Connection >::iterator it = m_connections.find( socket );
+  if( it == m_connections.end() )
+  {
+    return;
+  }
+
+  it->second.m_received += socket->readAll();
+  handleReceivedRequests( socket, it->second );
+}
+
+void MockOGCServer::connectionClosed()
+{
+  QTcpSocket *socket = qobject_cast< QTcpSocket* >( sender() );
+  std::map< QTcpSocket*, Connection >::iterator it = m_connections.find( socket );
+  if( it == m_connections.end() )
+  {
+    return;
+  }
+
+  // A request being processed frees its slot. Queued requests for the connection are skipped
+  // when they reach the front of the queue.
+  if( it->second.m_state == ConnectionDelayed || it->second.m_state == ConnectionSending )
+  {
+    --m_activeRequests;
+  }
+  m_connections.erase( it );
+  socket->deleteLater();
+
+  startQueuedRequests();
+}
+
+void MockOGCServer::handleReceivedRequests( QTcpSocket *socket, Connection &connection )
+{
+  // Requests on a connection are answered in the order they arrive, so a request pipelined
+  // behind one that is still being processed waits in the received data
+  while( connection.m_state == ConnectionIdle && parseRequest( connection ) )
+  {
+    if( connection.m_path == "/stats" )
+    {
+      QByteArray body;
+      body += "requests=" + QByteArray::number( m_statistics.m_requests ) + "\n";
+      body += "capabilities=" + QByteArray::number( m_statistics.m_capabilitiesRequests ) + "\n";
+      body += "getmap=" + QByteArray::number( m_statistics.m_mapRequests ) + "\n";
+      body += "gettile=" + QByteArray::number( m_statistics.m_tileRequests ) + "\n";
+      body += "errors=" + QByteArray::number( m_statistics.m_errors ) + "\n";
+      body += "notmodified=" + QByteArray::number( m_statistics.m_notModified ) + "\n";
+      body += "bytes=" + QByteArray::number( m_statistics.m_bytesSent ) + "\n";
+      body += "peakactive=" + QByteArray::number( m_statistics.m_peakActive ) + "\n";
+      body += "peakqueued=" + QByteArray::number( m_statistics.m_peakQueued ) + "\n";
+      socket->write( httpResponse( 200, "OK", "text/plain", body, connection.m_closeAfterResponse ) );
+    }
+    else if( connection.m_path == "/reset" )
+    {
+      m_statistics = Statistics();
+      socket->write( httpResponse( 200, "OK", "text/plain", "reset\n", connection.m_closeAfterResponse ) );
+    }
+    else
+    {
+      connection.m_state = ConnectionQueued;
+      m_queuedRequests.push_back( socket );
+      if( (int)m_queuedRequests.size() > m_statistics.m_peakQueued )
+      {
+        m_statistics.m_peakQueued = (int)m_queuedRequests.size();
+      }
+      startQueuedRequests();
+      return;
+    }
+
+    if( connection.m_closeAfterResponse )
+    {
+      socket->disconnectFromHost();
+      return;
+    }
+  }
+}
+
+bool MockOGCServer::parseRequest( Connection &connection )
+{
+  // Only GET requests are supported, so a request ends with the blank line after the headers
+  int headerEnd = connection.m_received.indexOf( "\r\n\r\n" );
+  if( headerEnd < 0 )
+  {
+    return false;
+  }
+
+  QList< QByteArray > headerLines = connection.m_received.left( headerEnd ).split( '\n' );
+  connection.m_received.remove( 0, headerEnd + 4 );
+
+  QList< QByteArray > requestLine = headerLines[0].trimmed().split( ' ' );
+  QByteArray target = requestLine.size() > 1 ? requestLine[1] : QByteArray( "/" );
+  QByteArray version = requestLine.size() > 2 ? requestLine[2] : QByteArray( "HTTP/1.0" );
+
+  connection.m_closeAfterResponse = version == "HTTP/1.0";
+  connection.m_host.clear();
+  connection.m_ifNoneMatch.clear();
+  for( int i = 1; i < headerLines.size(); ++i )
+  {
+    int separator = headerLines[i].indexOf( ':' );
+    if( separator < 0 )
+    {
+      continue;
+    }
+
+    QByteArray name = headerLines[i].left( separator ).trimmed().toLower();
+    QByteArray value = headerLines[i].mid( separator + 1 ).trimmed();
+    if( name == "host" )
+    {
+      connection.m_host = value;
+    }
+    else if( name == "if-none-match" )
+    {
+      connection.m_ifNoneMatch = value;
+    }
+    else if( name == "connection" )
+    {
+      connection.m_closeAfterResponse = value.toLower() == "close";
+    }
+  }
+
+  // Split the query into parameters. OGC parameter names are not case sensitive.
+  int queryStart = target.indexOf( '?' );
+  connection.m_path = target.left( queryStart );
+  connection.m_parameters.clear();
+  if( queryStart >= 0 )
+  {
+    QList< QByteArray > parameters = target.mid( queryStart + 1 ).split( '&' );
+    for( int i = 0; i < parameters.size(); ++i )
+    {
+      int separator = parameters[i].indexOf( '=' );
+      QByteArray name = parameters[i].left( separator ).replace( '+', ' ' );
+      QByteArray value = separator < 0 ? QByteArray() : parameters[i].mid( separator + 1 ).replace( '+', ' ' );
+      connection.m_parameters[ QByteArray::fromPercentEncoding( name ).toUpper() ] = QByteArray::fromPercentEncoding( value );
+    }
+  }
+  return true;
+}
+
+void MockOGCServer::startQueuedRequests()
+{
+  while( !m_queuedRequests.empty() &&
+         (m_settings.m_maxConcurrent <= 0 || m_activeRequests < m_settings.m_maxConcurrent) )
+  {
+    QTcpSocket *socket = m_queuedRequests.front();
+    m_queuedRequests.pop_front();
+
+    std::map< QTcpSocket*, Connection >::iterator it = m_connections.find( socket );
+    if( it == m_connections.end() )
+    {
+      // The connection was closed while the request was queued
+      continue;
+    }
+
+    it->second.m_state = ConnectionDelayed;
+    it->second.m_responseDue = m_clock.elapsed() + m_settings.m_latency;
+
+    ++m_activeRequests;
+    if( m_activeRequests > m_statistics.m_peakActive )
+    {
+      m_statistics.m_peakActive = m_activeRequests;
+    }
+  }
+}
+
+void MockOGCServer::processConnections()
+{
+  qint64 now = m_clock.elapsed();
+
+  // Sockets may be closed while responses are written, so take a copy of the open ones first
+  std::vector< QTcpSocket* > sockets;
+  sockets.reserve( m_connections.size() );
+  std::map< QTcpSocket*, Connection >::iterator it( m_connections.begin() );
+  std::map< QTcpSocket*, Connection >::iterator itE( m_connections.end() );
+  for( ; it != itE; ++it )
+  {
+    sockets.push_back( it->first );
+  }
+
+  for( size_t i = 0; i < sockets.size(); ++i )
+  {
+    it = m_connections.find( sockets[i] );
+    if( it == m_connections.end() )
+    {
+      continue;
+    }
+
+    QTcpSocket *socket = it->first;
+    Connection &connection = it->second;
+    if( connection.m_state == ConnectionDelayed && now >= connection.m_responseDue )
+    {
+      connection.m_response = buildResponse( connection );
+      connection.m_responseWritten = 0;
+      connection.m_lastSendTime = now;
+      connection.m_state = ConnectionSending;
+    }
+
+    if( connection.m_state != ConnectionSending || socket->bytesToWrite() > g_maxUnwrittenBytes )
+    {
+      continue;
+    }
+
+    qint64 remaining = connection.m_response.size() - connection.m_responseWritten;
+    qint64 allowed = remaining;
+    if( m_settings.m_bandwidth > 0 )
+    {
+      // Send what the bandwidth allows for the time since the last chunk. Anything less than a byte
+      // is carried over to the next interval by not moving the last send time on.
+      allowed = qMin( remaining, (now - connection.m_lastSendTime) * m_settings.m_bandwidth / 1000 );
+      if( allowed <= 0 )
+      {
+        continue;
+      }
+    }
+
+    qint64 written = socket->write( connection.m_response.constData() + connection.m_responseWritten, allowed );
+    if( written > 0 )
+    {
+      connection.m_responseWritten += (int)written;
+      connection.m_lastSendTime = now;
+    }
+
+    if( connection.m_responseWritten >= connection.m_response.size() )
+    {
+      finishResponse( socket, connection );
+    }
+  }
+}
+
+void MockOGCServer::finishResponse( QTcpSocket *socket, Connection &connection )
+{
+  m_statistics.m_bytesSent += connection.m_response.size();
+  connection.m_response.clear();
+  connection.m_responseWritten = 0;
+  connection.m_state = ConnectionIdle;
+  --m_activeRequests;
+
+  bool close = connection.m_closeAfterResponse;
+  startQueuedRequests();
+
+  if( close )
+  {
+    // This may close the socket immediately, which removes the connection
+    socket->disconnectFromHost();
+  }
+  else
+  {
+    handleReceivedRequests( socket, connection );
+  }
+}
+
+QByteArray MockOGCServer::buildResponse( const Connection &connection )
+{
+  ++m_statistics.m_requests;
+
+  QByteArray host = connection.m_host;
+  if( host.isEmpty() )
+  {
+    host = "localhost:" + QByteArray::number( serverPort() );
+  }
+  QByteArray baseURL = "http://" + host + connection.m_path + "?";
+
+  QByteArray response;
+  if( connection.m_path == "/wms" )
+  {
+    response = buildWMSResponse( baseURL, connection );
+  }
+  else if( connection.m_path == "/wmts" )
+  {
+    response = buildWMTSResponse( baseURL, connection );
+  }
+  else
+  {
+    ++m_statistics.m_errors;
+    response = httpResponse( 404, "Not Found", "text/plain", "Use /wms or /wmts\n", connection.m_closeAfterResponse );
+  }
+
+  if( m_settings.m_verbose )
+  {
+    std::cout << connection.m_path.constData() << " " << connection.m_parameters.value( "REQUEST" ).constData()
+              << " -> " << response.left( response.indexOf( '\r' ) ).constData() << ", "
+              << response.size() << " bytes" << std::endl;
+  }
+  return response;
+}
+
+QByteArray MockOGCServer::buildWMSResponse( const QByteArray &baseURL, const Connection &connection )
+{
+  const QMap< QByteArray, QByteArray > &parameters = connection.m_parameters;
+  bool close = connection.m_closeAfterResponse;
+  QByteArray request = parameters.value( "REQUEST" ).toLower();
+
+  if( request == "getcapabilities" )
+  {
+    ++m_statistics.m_capabilitiesRequests;
+    return httpResponse( 200, "OK", "text/xml", MockImagery::wmsCapabilities( baseURL, m_settings.m_numLayers, m_settings.m_numTimes, m_settings.m_groupSize ), close,
+                         "Cache-Control: max-age=" + QByteArray::number( m_settings.m_maxAge ) + "\r\n" );
+  }
+
+  if( request != "getmap" )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 400, "Bad Request", "text/xml",
+                         MockImagery::wmsException( "OperationNotSupported", "Unsupported request " + request ), close );
+  }
+
+  ++m_statistics.m_mapRequests;
+
+  // The layer listed last is drawn on top, so an opaque image only shows that layer
+  QList< QByteArray > layers = parameters.value( "LAYERS" ).split( ',' );
+  int topLayer = -1;
+  for( int i = 0; i < layers.size(); ++i )
+  {
+    topLayer = MockImagery::layerIndex( layers[i], m_settings.m_numLayers );
+    if( topLayer < 0 )
+    {
+      ++m_statistics.m_errors;
+      return httpResponse( 200, "OK", "text/xml", MockImagery::wmsException( "LayerNotDefined", "Unknown layer " + layers[i] ), close );
+    }
+  }
+
+  QList< QByteArray > bbox = parameters.value( "BBOX" ).split( ',' );
+  int width = parameters.value( "WIDTH" ).toInt();
+  int height = parameters.value( "HEIGHT" ).toInt();
+  if( bbox.size() != 4 || width <= 0 || height <= 0 || width > g_maxImageSize || height > g_maxImageSize )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 200, "OK", "text/xml", MockImagery::wmsException( "InvalidParameterValue", "Invalid BBOX, WIDTH or HEIGHT" ), close );
+  }
+
+  double x1 = bbox[0].toDouble(), y1 = bbox[1].toDouble(), x2 = bbox[2].toDouble(), y2 = bbox[3].toDouble();
+  if( parameters.value( "CRS" ) == "EPSG:4326" && parameters.value( "VERSION" ) != "1.1.1" )
+  {
+    // WMS 1.3.0 gives EPSG:4326 extents in latitude/longitude order
+    std::swap( x1, y1 );
+    std::swap( x2, y2 );
+  }
+
+  // Without a time the dimension's default, the first value, is drawn
+  int frame = 0;
+  if( m_settings.m_numTimes > 0 && parameters.contains( "TIME" ) )
+  {
+    frame = MockImagery::timeIndex( parameters.value( "TIME" ), m_settings.m_numTimes );
+    if( frame < 0 )
+    {
+      ++m_statistics.m_errors;
+      return httpResponse( 200, "OK", "text/xml",
+                           MockImagery::wmsException( "InvalidDimensionValue", "Invalid TIME " + parameters.value( "TIME" ) ), close );
+    }
+  }
+
+  if( injectError() )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 500, "Internal Server Error", "text/xml", MockImagery::wmsException( "NoApplicableCode", "Injected failure" ), close );
+  }
+
+  QByteArray format = parameters.value( "FORMAT" );
+  bool transparent = parameters.value( "TRANSPARENT" ).toUpper() == "TRUE";
+  QByteArray image = MockImagery::renderImage( topLayer, frame, x1, y1, x2, y2, width, height, format, transparent );
+  if( image.isEmpty() )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 200, "OK", "text/xml", MockImagery::wmsException( "InvalidFormat", "Unsupported format " + format ), close );
+  }
+  return httpResponse( 200, "OK", format.constData(), image, close );
+}
+
+QByteArray MockOGCServer::buildWMTSResponse( const QByteArray &baseURL, const Connection &connection )
+{
+  const QMap< QByteArray, QByteArray > &parameters = connection.m_parameters;
+  bool close = connection.m_closeAfterResponse;
+  QByteArray request = parameters.value( "REQUEST" ).toLower();
+
+  if( request == "getcapabilities" )
+  {
+    ++m_statistics.m_capabilitiesRequests;
+    return httpResponse( 200, "OK", "text/xml",
+                         MockImagery::wmtsCapabilities( baseURL, m_settings.m_numLayers, m_settings.m_numLevels ), close,
+                         "Cache-Control: max-age=" + QByteArray::number( m_settings.m_maxAge ) + "\r\n" );
+  }
+
+  if( request != "gettile" )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 400, "Bad Request", "text/xml",
+                         MockImagery::wmtsException( "OperationNotSupported", "Unsupported request " + request ), close );
+  }
+
+  ++m_statistics.m_tileRequests;
+
+  int layer = MockImagery::layerIndex( parameters.value( "LAYER" ), m_settings.m_numLayers );
+  if( layer < 0 )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 400, "Bad Request", "text/xml",
+                         MockImagery::wmtsException( "InvalidParameterValue", "Unknown layer " + parameters.value( "LAYER" ) ), close );
+  }
+
+  // Tile matrix identifiers may be given prefixed with the tile matrix set name
+  QByteArray tileMatrix = parameters.value( "TILEMATRIX" );
+  tileMatrix = tileMatrix.mid( tileMatrix.lastIndexOf( ':' ) + 1 );
+
+  double x1 = 0.0, y1 = 0.0, x2 = 0.0, y2 = 0.0;
+  int level = tileMatrix.toInt();
+  if( level >= m_settings.m_numLevels ||
+      !MockImagery::tileExtent( level, parameters.value( "TILEROW" ).toInt(), parameters.value( "TILECOL" ).toInt(), x1, y1, x2, y2 ) )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 400, "Bad Request", "text/xml",
+                         MockImagery::wmtsException( "TileOutOfRange", "Tile is outside the tile matrix set" ), close );
+  }
+
+  if( injectError() )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 500, "Internal Server Error", "text/xml",
+                         MockImagery::wmtsException( "NoApplicableCode", "Injected failure" ), close );
+  }
+
+  // The generated imagery never changes, so the ETag only depends on the request. The parameters
+  // are held sorted by name, so the same tile always gives the same tag.
+  QByteArray tagSource = connection.m_path;
+  QMap< QByteArray, QByteArray >::const_iterator it( parameters.begin() );
+  QMap< QByteArray, QByteArray >::const_iterator itE( parameters.end() );
+  for( ; it != itE; ++it )
+  {
+    tagSource += "&" + it.key() + "=" + it.value();
+  }
+  QByteArray etag = "\"" + QCryptographicHash::hash( tagSource, QCryptographicHash::Md5 ).toHex() + "\"";
+  QByteArray cacheHeaders = "ETag: " + etag + "\r\nCache-Control: max-age=" + QByteArray::number( m_settings.m_maxAge ) + "\r\n";
+
+  if( !connection.m_ifNoneMatch.isEmpty() &&
+      (connection.m_ifNoneMatch == etag || connection.m_ifNoneMatch == "W/" + etag || connection.m_ifNoneMatch == "*") )
+  {
+    ++m_statistics.m_notModified;
+    return httpResponse( 304, "Not Modified", "image/png", QByteArray(), close, cacheHeaders );
+  }
+
+  QByteArray format = parameters.value( "FORMAT", "image/png" );
+  QByteArray image = MockImagery::renderImage( layer, 0, x1, y1, x2, y2, 256, 256, format, true );
+  if( image.isEmpty() )
+  {
+    ++m_statistics.m_errors;
+    return httpResponse( 400, "Bad Request", "text/xml",
+                         MockImagery::wmtsException( "InvalidParameterValue", "Unsupported format " + format ), close );
+  }
+  return httpResponse( 200, "OK", format.constData(), image, close, cacheHeaders );
+}
+
+bool MockOGCServer::injectError()
+{
+  if( m_settings.m_errorRate <= 0.0 )
+  {
+    return false;
+  }
+
+  // A linear congruential generator gives the same sequence of failures on every platform for a given seed
+  m_randomState = m_randomState * 1103515245u + 12345u;
+  double sample = ((m_randomState >> 16) & 0x7fff) / 32768.0;
+  return sample < m_settings.m_errorRate;
+}
+
+QByteArray MockOGCServer::httpResponse( int status, const char *reason, const char *contentType,
+                                        const QByteArray &body, bool close, const QByteArray &extraHeaders )
+{
+  QByteArray response = "HTTP/1.1 " + QByteArray::number( status ) + " " + reason + "\r\n";
+  response += QByteArray( "Content-Type: " ) + contentType + "\r\n";
+  response += "Content-Length: " + QByteArray::number( body.size() ) + "\r\n";
+  response += extraHeaders;
+  response += close ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+  response += "\r\n";
+  response += body;
+  return response;
+}
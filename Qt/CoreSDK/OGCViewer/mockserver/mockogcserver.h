@@ -0,0 +1,194 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef MOCKOGCSERVER_H
+#define MOCKOGCSERVER_H
+
+#include <deque>
+#include <map>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QTcpServer>
+#include <QTimer>
+
+class QTcpSocket;
+
+// A minimal HTTP/1.1 server that behaves as both a WMS (at /wms) and a WMTS (at /wmts),
+// serving generated imagery. Latency, bandwidth, error rate and the number of requests
+// processed at once can be configured so that the viewer's loading behaviour can be measured
+// repeatably without a remote service.
+//
+// Capabilities and tiles are sent with a Cache-Control max-age, and tiles with an ETag that
+// depends only on the request, so that clients that keep tiles can revalidate them.
+//
+// Two further paths are provided for benchmarks to use. /stats returns the counts of requests
+// and bytes served so far as 'name=value' lines, and /reset sets them back to zero. Neither is
+// delayed or counted.
+
+class MockOGCServer : public QTcpServer
+{
+  Q_OBJECT
+public:
+  struct Settings
+  {
+    Settings();
+
+    quint16 m_port;
+
+    // Delay before a response starts to be sent, in milliseconds
+    int m_latency;
+
+    // Bytes per second sent on each connection, or 0 for no limit
+    int m_bandwidth;
+
+    // Fraction (0 to 1) of GetMap and GetTile requests that fail with an HTTP 500 response
+    double m_errorRate;
+
+    // The number of requests that are processed at the same time, or 0 for no limit.
+    // Further requests wait in a queue until one completes.
+    int m_maxConcurrent;
+
+    // Seed for the generator used to decide which requests fail
+    unsigned int m_seed;
+
+    // The number of layers offered, and the number of levels in the WMTS tile matrix set
+    int m_numLayers;
+    int m_numLevels;
+
+    // The number of hourly values of the WMS layers' time dimension, or 0 for no time dimension
+    int m_numTimes;
+
+    // The number of WMS layers in each group layer, or 0 for all layers to sit directly under the root
+    int m_groupSize;
+
+    // Seconds that capabilities and tiles may be cached for, sent as Cache-Control max-age.
+    // Tiles also carry an ETag, and a request repeating it is answered with 304 Not Modified.
+    int m_maxAge;
+
+    // Write a line for each request handled
+    bool m_verbose;
+  };
+
+  struct Statistics
+  {
+    Statistics();
+
+    int m_requests;
+    int m_capabilitiesRequests;
+    int m_mapRequests;
+    int m_tileRequests;
+    int m_errors;
+
+    // Tile requests answered with 304 Not Modified
+    int m_notModified;
+    qint64 m_bytesSent;
+
+    // The most requests that were being processed, or waiting, at the same time
+    int m_peakActive;
+    int m_peakQueued;
+  };
+
+  explicit MockOGCServer( const Settings &settings, QObject *parent = NULL );
+  virtual ~MockOGCServer();
+
+  // Starts listening on the configured port
+  bool start();
+
+  const Settings& settings() const;
+  const Statistics& statistics() const;
+
+protected:
+  virtual void incomingConnection( qintptr socketDescriptor );
+
+private slots:
+  void readRequests();
+  void connectionClosed();
+  void processConnections();
+
+private:
+  enum ConnectionState
+  {
+    // Waiting for a complete request to arrive
+    ConnectionIdle,
+    // A request has been received and is waiting for a free processing slot
+    ConnectionQueued,
+    // The request is being processed, and its response is delayed by the configured latency
+    ConnectionDelayed,
+    // The response is being written to the socket
+    ConnectionSending
+  };
+
+  struct Connection
+  {
+    Connection();
+
+    ConnectionState m_state;
+    QByteArray m_received;
+
+    // The request being processed
+    QByteArray m_path;
+    QMap< QByteArray, QByteArray > m_parameters;
+    QByteArray m_host;
+    QByteArray m_ifNoneMatch;
+    bool m_closeAfterResponse;
+
+    // The response, and how much of it has been written
+    QByteArray m_response;
+    int m_responseWritten;
+
+    // When the response may be sent, and when the last chunk was sent
+    qint64 m_responseDue;
+    qint64 m_lastSendTime;
+  };
+
+  // Takes the next complete request from the connection's received data, if there is one
+  bool parseRequest( Connection &connection );
+
+  // Handles any complete requests received on an idle connection
+  void handleReceivedRequests( QTcpSocket *socket, Connection &connection );
+
+  // Starts processing queued requests while there are free processing slots
+  void startQueuedRequests();
+
+  // Builds the response to the connection's current request
+  QByteArray buildResponse( const Connection &connection );
+  QByteArray buildWMSResponse( const QByteArray &baseURL, const Connection &connection );
+  QByteArray buildWMTSResponse( const QByteArray &baseURL, const Connection &connection );
+
+  // Whether the next map or tile request should fail, according to the configured error rate
+  bool injectError();
+
+  void finishResponse( QTcpSocket *socket, Connection &connection );
+
+  // extraHeaders holds any further complete header lines
+  static QByteArray httpResponse( int status, const char *reason, const char *contentType,
+                                  const QByteArray &body, bool close, const QByteArray &extraHeaders = QByteArray() );
+
+  Settings m_settings;
+  Statistics m_statistics;
+
+  std::map< QTcpSocket*, Connection > m_connections;
+  std::deque< QTcpSocket* > m_queuedRequests;
+  int m_activeRequests;
+
+  // Drives the latency and bandwidth simulation for all connections
+  QTimer m_processTimer;
+  QElapsedTimer m_clock;
+
+  unsigned int m_randomState;
+};
+
+inline const MockOGCServer::Settings& MockOGCServer::settings() const
+{
+  return m_settings;
+}
+
+inline const MockOGCServer::Statistics& MockOGCServer::statistics() const
+{
+  return m_statistics;
+}
+
+#endif // MOCKOGCSERVER_H
@@ -0,0 +1,25 @@
+#****************************************************************************
+#                Copyright (c) 2017 by Envitia Group PLC.
+#****************************************************************************
+
+# A local WMS/WMTS server serving generated imagery, used to measure the performance
+# of the OGC service viewer against a service with known, repeatable behaviour.
+# This does not use MapLink and so does not include maplinkqtdefs.pri.
+CONFIG -=  debug_and_release release debug
+CONFIG += qt thread release console
+
+TARGET = MockOGCServer
+QT = core gui network
+TEMPLATE = app
+
+win32 {
+  CONFIG -= app_bundle
+  DEFINES += _CRT_SECURE_NO_WARNINGS
+}
+
+HEADERS = mockogcserver.h \
+		  mockimagery.h
+
+SOURCES = main.cpp \
+		  mockogcserver.cpp \
+		  mockimagery.cpp
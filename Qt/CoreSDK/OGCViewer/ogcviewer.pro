@@ -17,7 +17,7 @@ dev {
 }
 
 TARGET = OGCServiceViewer
-QT += widgets 
+QT += widgets network
 
 win32 {
   message("Windows build")
@@ -80,6 +80,7 @@ HEADERS = services/service.h \
 		  services/servicelist.h \
 		  services/servicelistmodel.h \
 		  services/servicelayerpreview.h \
+		  services/ogcserviceproxy.h \
 		  services/wms/wmsservice.h \
 		  services/wms/wmsservicelayermodel.h \
 		  services/wms/wmsservicelayerstylesmodel.h \
@@ -87,6 +88,9 @@ HEADERS = services/service.h \
 		  services/wms/wmsservicedimensionsmodel.h \
 		  services/wms/wmsservicedimensioninfomodel.h \
 		  services/wms/wmslayerpreview.h \
+		  services/wms/wmslayerindex.h \
+		  services/wms/wmsframecache.h \
+		  services/wms/wmsanimation.h \
 		  services/wmts/wmtsservice.h \
 		  services/wmts/wmtsservicelayermodel.h \
 		  services/wmts/wmtsservicelayerinfomodel.h \
@@ -94,6 +98,9 @@ HEADERS = services/service.h \
 		  services/wmts/wmtsservicedimensionsmodel.h \
 		  services/wmts/wmtsservicedimensioninfomodel.h \
 		  services/wmts/wmtslayerpreview.h \
+		  services/wmts/wmtstilestore.h \
+		  services/wmts/wmtstileprefetcher.h \
+		  services/wmts/wmtsrequestscheduler.h \
           ui/mainwindow.h \
 		  ui/drawingsurfacewidget.h \
 		  ui/drawingsurfaceinteractions.h \
@@ -113,13 +120,16 @@ HEADERS = services/service.h \
 		  ui/pages/selectcoordsyspage.h \
 		  ui/pages/selectlayerspage.h \
 		  ui/pages/wmsserviceoptionspage.h \
-		  ui/pages/wmtsserviceoptionspage.h
+		  ui/pages/wmtsserviceoptionspage.h \
+		  benchmark/viewbenchmark.h \
+		  benchmark/previewbenchmark.h
 		  
 SOURCES = main.cpp \
           services/service.cpp \
 		  services/servicelist.cpp \
 		  services/servicelistmodel.cpp \
 		  services/servicelayerpreview.cpp \
+		  services/ogcserviceproxy.cpp \
 		  services/wms/wmsservice.cpp \
 		  services/wms/wmsservicelayermodel.cpp \
 		  services/wms/wmsservicelayerstylesmodel.cpp \
@@ -127,6 +137,9 @@ SOURCES = main.cpp \
 		  services/wms/wmsservicedimensionsmodel.cpp \
 		  services/wms/wmsservicedimensioninfomodel.cpp \
 		  services/wms/wmslayerpreview.cpp \
+		  services/wms/wmslayerindex.cpp \
+		  services/wms/wmsframecache.cpp \
+		  services/wms/wmsanimation.cpp \
 		  services/wmts/wmtsservice.cpp \
 		  services/wmts/wmtsservicelayermodel.cpp \
 		  services/wmts/wmtsservicelayerinfomodel.cpp \
@@ -134,6 +147,9 @@ SOURCES = main.cpp \
 		  services/wmts/wmtsservicedimensionsmodel.cpp \
 		  services/wmts/wmtsservicedimensioninfomodel.cpp \
 		  services/wmts/wmtslayerpreview.cpp \
+		  services/wmts/wmtstilestore.cpp \
+		  services/wmts/wmtstileprefetcher.cpp \
+		  services/wmts/wmtsrequestscheduler.cpp \
           ui/mainwindow.cpp \
 		  ui/drawingsurfacewidget.cpp \
 		  ui/drawingsurfaceinteractions.cpp \
@@ -152,7 +168,9 @@ SOURCES = main.cpp \
 		  ui/pages/selectcoordsyspage.cpp \
 		  ui/pages/selectlayerspage.cpp \
 		  ui/pages/wmsserviceoptionspage.cpp \
-		  ui/pages/wmtsserviceoptionspage.cpp
+		  ui/pages/wmtsserviceoptionspage.cpp \
+		  benchmark/viewbenchmark.cpp \
+		  benchmark/previewbenchmark.cpp
 		 
 #win32 {
 #  QT += webkitwidgets
@@ -0,0 +1,1230 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+#include <set>
+
+#include <QDateTime>
+#include <QHostAddress>
+#include <QLocale>
+#include <QMutexLocker>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QRegularExpression>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+
+#include "ogcserviceproxy.h"
+
+namespace Services
+{
+  // How long a response is kept without revalidation when the server gives no caching headers
+  static const qint64 g_defaultFreshness = 24 * 60 * 60 * 1000;
+
+  // Requests to the server that take longer than this are treated as the server being unreachable
+  static const int g_upstreamTimeout = 30000;
+
+  // How often the store's index is written while the proxy is running
+  static const int g_saveInterval = 30000;
+
+  // Proxied addresses are of the form http://127.0.0.1:<port>/u/<server address>/<rest of path>?<query>,
+  // with the server address (up to any query or template parameter) encoded so that it forms a single path segment
+  static const char *g_proxyPathPrefix = "/u/";
+
+  // How long after the data layer's last tile request the view is taken to be settled
+  static const int g_viewSettleDelay = 150;
+
+  // The most prefetches made at the same time, so they do not hold up the data layer's next requests
+  static const size_t g_maxPrefetchRequests = 2;
+
+  // The most prefetches made at the same time while frames of an animation are being fetched. Each frame
+  // needs all the images of the view, and is needed within a frame's time.
+  static const size_t g_maxFramePrefetchRequests = 4;
+
+  // How long to wait before prefetching again once the bandwidth budget has been used
+  static const int g_budgetRetryInterval = 100;
+
+  OGCServiceProxy::Statistics::Statistics()
+    : m_requests( 0 )
+    , m_hits( 0 )
+    , m_revalidated( 0 )
+    , m_offline( 0 )
+    , m_misses( 0 )
+    , m_failures( 0 )
+    , m_prefetched( 0 )
+    , m_prefetchBytes( 0 )
+    , m_prefetchCancelled( 0 )
+    , m_cancelled( 0 )
+    , m_frameRequests( 0 )
+    , m_frameHits( 0 )
+    , m_framesPrefetched( 0 )
+  {
+  }
+
+  OGCServiceProxy::OGCServiceProxy( const QString &directory, qint64 maximumSize )
+    : m_server( new OGCServiceProxyServer( directory, maximumSize ) )
+    , m_port( 0 )
+  {
+    // The server is deleted in its own thread once the thread stops
+    m_server->moveToThread( &m_thread );
+    connect( &m_thread, SIGNAL(finished()), m_server, SLOT(deleteLater()) );
+    m_thread.start();
+
+    QMetaObject::invokeMethod( m_server, "start", Qt::BlockingQueuedConnection, Q_RETURN_ARG( int, m_port ) );
+  }
+
+  OGCServiceProxy::~OGCServiceProxy()
+  {
+    m_thread.quit();
+    m_thread.wait();
+  }
+
+  std::string OGCServiceProxy::proxyURL( const char *serviceURL ) const
+  {
+    return OGCServiceProxyServer::proxyURL( serviceURL, m_port ).constData();
+  }
+
+  std::string OGCServiceProxy::upstreamURL( const char *proxiedURL ) const
+  {
+    QByteArray url( proxiedURL );
+    QByteArray host = "http://127.0.0.1:" + QByteArray::number( m_port );
+    if( !isRunning() || !url.startsWith( host + g_proxyPathPrefix ) )
+    {
+      return std::string();
+    }
+    return OGCServiceProxyServer::upstreamURL( url.mid( host.size() ) ).constData();
+  }
+
+  std::string OGCServiceProxy::proxiedServiceURL( const char *proxiedURL ) const
+  {
+    QByteArray url( proxiedURL );
+    QByteArray prefix = "http://127.0.0.1:" + QByteArray::number( m_port ) + g_proxyPathPrefix;
+    if( !isRunning() || !url.startsWith( prefix ) )
+    {
+      return std::string();
+    }
+    int addressEnd = url.indexOf( '/', prefix.size() );
+    return url.left( addressEnd ).constData();
+  }
+
+  void OGCServiceProxy::setCredentials( const char *proxiedURL, const char *username, const char *password )
+  {
+    std::string upstream = upstreamURL( proxiedURL );
+    if( upstream.empty() )
+    {
+      return;
+    }
+
+    QByteArray user( username ), pass( password );
+    QByteArray authorization;
+    if( !user.isEmpty() || !pass.isEmpty() )
+    {
+      authorization = "Basic " + (user + ":" + pass).toBase64();
+    }
+    // Wait for the proxy to have the credentials, so the loader's retry is sent with them
+    QMetaObject::invokeMethod( m_server, "setCredentials", Qt::BlockingQueuedConnection,
+                               Q_ARG( QByteArray, OGCServiceProxyServer::origin( upstream.c_str() ) ),
+                               Q_ARG( QByteArray, authorization ) );
+  }
+
+  void OGCServiceProxy::clearCredentials()
+  {
+    QMetaObject::invokeMethod( m_server, "clearCredentials", Qt::QueuedConnection );
+  }
+
+  void OGCServiceProxy::setMaximumSize( qint64 maximumSize )
+  {
+    QMetaObject::invokeMethod( m_server, "setMaximumSize", Qt::QueuedConnection, Q_ARG( qint64, maximumSize ) );
+  }
+
+  void OGCServiceProxy::setPrefetch( int ring, qint64 budget )
+  {
+    QMetaObject::invokeMethod( m_server, "setPrefetch", Qt::QueuedConnection, Q_ARG( int, ring ), Q_ARG( qint64, budget ) );
+  }
+
+  void OGCServiceProxy::setHostLimits( int defaultLimit, const QVariantMap &hostLimits )
+  {
+    QMetaObject::invokeMethod( m_server, "setHostLimits", Qt::QueuedConnection,
+                               Q_ARG( int, defaultLimit ), Q_ARG( QVariantMap, hostLimits ) );
+  }
+
+  void OGCServiceProxy::setPrioritise( bool prioritise )
+  {
+    QMetaObject::invokeMethod( m_server, "setPrioritise", Qt::QueuedConnection, Q_ARG( bool, prioritise ) );
+  }
+
+  void OGCServiceProxy::setAnimation( const QString &parameter, const QStringList &values, int framesAhead )
+  {
+    QMetaObject::invokeMethod( m_server, "setAnimation", Qt::QueuedConnection, Q_ARG( QString, parameter ),
+                               Q_ARG( QStringList, values ), Q_ARG( int, framesAhead ) );
+  }
+
+  void OGCServiceProxy::setFrameCacheSize( qint64 maximumSize )
+  {
+    QMetaObject::invokeMethod( m_server, "setFrameCacheSize", Qt::QueuedConnection, Q_ARG( qint64, maximumSize ) );
+  }
+
+  void OGCServiceProxy::clear()
+  {
+    QMetaObject::invokeMethod( m_server, "clear", Qt::BlockingQueuedConnection );
+  }
+
+  OGCServiceProxy::Statistics OGCServiceProxy::statistics() const
+  {
+    return m_server->statistics();
+  }
+
+  OGCServiceProxyServer::OGCServiceProxyServer( const QString &directory, qint64 maximumSize )
+    : m_store( directory, maximumSize )
+    , m_network( NULL )
+    , m_saveTimer( NULL )
+    , m_foregroundRequests( 0 )
+    , m_nextRequestID( 0 )
+    , m_viewTimer( NULL )
+    , m_viewSettled( true )
+    , m_prefetchBudget( 0 )
+    , m_prefetchAllowance( 0.0 )
+    , m_lastAllowanceUpdate( 0 )
+    , m_budgetTimer( NULL )
+  {
+  }
+
+  OGCServiceProxyServer::~OGCServiceProxyServer()
+  {
+    // Don't answer requests for replies that are aborted as the network access manager is destroyed
+    if( m_network )
+    {
+      disconnect( m_network, 0, this, 0 );
+    }
+    m_store.save();
+  }
+
+  OGCServiceProxy::Statistics OGCServiceProxyServer::statistics() const
+  {
+    QMutexLocker lock( &m_statisticsMutex );
+    return m_statistics;
+  }
+
+  QByteArray OGCServiceProxyServer::proxyURL( const QByteArray &serviceURL, int port )
+  {
+    int queryStart = serviceURL.indexOf( '?' );
+    QByteArray address = serviceURL.left( queryStart );
+
+    QByteArray url = "http://127.0.0.1:" + QByteArray::number( port ) + g_proxyPathPrefix +
+                     address.toBase64( QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals ) + "/";
+    if( queryStart >= 0 )
+    {
+      url += serviceURL.mid( queryStart );
+    }
+    return url;
+  }
+
+  QByteArray OGCServiceProxyServer::upstreamURL( const QByteArray &target )
+  {
+    QByteArray upstream, key;
+    RequestType type;
+    QMap< QByteArray, QByteArray > parameters;
+    if( !decodeRequest( target, upstream, type, key, parameters ) )
+    {
+      return QByteArray();
+    }
+    return upstream;
+  }
+
+  QByteArray OGCServiceProxyServer::origin( const QByteArray &url )
+  {
+    QUrl parsed = QUrl::fromEncoded( url );
+    QString scheme = parsed.scheme().toLower();
+    int port = parsed.port( scheme == "https" ? 443 : 80 );
+    return (scheme + "://" + parsed.host().toLower() + ":" + QString::number( port )).toUtf8();
+  }
+
+  int OGCServiceProxyServer::start()
+  {
+    m_store.open();
+
+    m_network = new QNetworkAccessManager( this );
+    connect( m_network, SIGNAL(finished(QNetworkReply*)), this, SLOT(upstreamFinished(QNetworkReply*)) );
+
+    m_saveTimer = new QTimer( this );
+    connect( m_saveTimer, SIGNAL(timeout()), this, SLOT(saveStore()) );
+    m_saveTimer->start( g_saveInterval );
+
+    m_viewTimer = new QTimer( this );
+    m_viewTimer->setSingleShot( true );
+    connect( m_viewTimer, SIGNAL(timeout()), this, SLOT(viewSettled()) );
+
+    m_budgetTimer = new QTimer( this );
+    m_budgetTimer->setSingleShot( true );
+    connect( m_budgetTimer, SIGNAL(timeout()), this, SLOT(dispatchPrefetches()) );
+    m_allowanceClock.start();
+
+    // Only accept requests from this machine
+    if( !listen( QHostAddress::LocalHost, 0 ) )
+    {
+      return 0;
+    }
+    return serverPort();
+  }
+
+  void OGCServiceProxyServer::setMaximumSize( qint64 maximumSize )
+  {
+    m_store.setMaximumSize( maximumSize );
+  }
+
+  void OGCServiceProxyServer::setPrefetch( int ring, qint64 budget )
+  {
+    m_prefetcher.setRing( ring );
+    m_prefetchBudget = std::max( budget, (qint64)0 );
+    if( ring <= 0 )
+    {
+      cancelQueuedPrefetches();
+    }
+  }
+
+  void OGCServiceProxyServer::setHostLimits( int defaultLimit, const QVariantMap &hostLimits )
+  {
+    QMap< QString, int > limits;
+    QVariantMap::const_iterator it( hostLimits.constBegin() );
+    QVariantMap::const_iterator itE( hostLimits.constEnd() );
+    for( ; it != itE; ++it )
+    {
+      limits[it.key()] = it.value().toInt();
+    }
+    m_scheduler.setHostLimits( defaultLimit, limits );
+
+    // A higher limit may let waiting requests be sent
+    sendScheduledRequests();
+  }
+
+  void OGCServiceProxyServer::setPrioritise( bool prioritise )
+  {
+    m_scheduler.setPrioritise( prioritise );
+  }
+
+  void OGCServiceProxyServer::setAnimation( const QString &parameter, const QStringList &values, int framesAhead )
+  {
+    std::vector< QByteArray > frameValues;
+    frameValues.reserve( values.size() );
+    for( int i = 0; i < values.size(); ++i )
+    {
+      frameValues.push_back( values[i].toUtf8() );
+    }
+    m_frames.setAnimation( parameter.toUtf8().toUpper(), frameValues, framesAhead );
+    planFrames();
+  }
+
+  void OGCServiceProxyServer::setFrameCacheSize( qint64 maximumSize )
+  {
+    m_frames.setMaximumSize( maximumSize );
+  }
+
+  void OGCServiceProxyServer::setCredentials( const QByteArray &origin, const QByteArray &authorization )
+  {
+    if( authorization.isEmpty() )
+    {
+      m_credentials.erase( origin );
+    }
+    else
+    {
+      m_credentials[origin] = authorization;
+    }
+  }
+
+  void OGCServiceProxyServer::clearCredentials()
+  {
+    m_credentials.clear();
+  }
+
+  void OGCServiceProxyServer::clear()
+  {
+    m_store.clear();
+
+    QMutexLocker lock( &m_statisticsMutex );
+    m_statistics = OGCServiceProxy::Statistics();
+  }
+
+  void OGCServiceProxyServer::saveStore()
+  {
+    m_store.save();
+  }
+
+  void OGCServiceProxyServer::incomingConnection( qintptr socketDescriptor )
+  {
+    QTcpSocket *socket = new QTcpSocket( this );
+    if( !socket->setSocketDescriptor( socketDescriptor ) )
+    {
+      delete socket;
+      return;
+    }
+
+    m_received[socket] = QByteArray();
+    connect( socket, SIGNAL(readyRead()), this, SLOT(readRequest()) );
+    connect( socket, SIGNAL(disconnected()), this, SLOT(connectionClosed()) );
+  }
+
+  void OGCServiceProxyServer::connectionClosed()
+  {
+    QTcpSocket *socket = qobject_cast< QTcpSocket* >( sender() );
+    m_received.erase( socket );
+    socket->deleteLater();
+  }
+
+  void OGCServiceProxyServer::readRequest()
+  {
+    QTcpSocket *socket = qobject_cast< QTcpSocket* >( sender() );
+    std::map< QTcpSocket*, QByteArray >::iterator received = m_received.find( socket );
+    if( received == m_received.end() )
+    {
+      return;
+    }
+    received->second += socket->readAll();
+
+    // The remote loader only sends GET requests, which end with the blank line after the headers
+    int headerEnd;
+    while( (headerEnd = received->second.indexOf( "\r\n\r\n" )) >= 0 )
+    {
+      QList< QByteArray > headerLines = received->second.left( headerEnd ).split( '\n' );
+      received->second.remove( 0, headerEnd + 4 );
+
+      QList< QByteArray > requestLine = headerLines[0].trimmed().split( ' ' );
+      if( requestLine.size() < 2 || requestLine[0] != "GET" )
+      {
+        sendResponse( socket, 405, "Method Not Allowed", "text/plain", "Only GET requests are supported\n" );
+        continue;
+      }
+
+      // Any credentials the loader sends are not passed on, as it sends the same ones to every
+      // proxied address. The proxy adds those entered for the server itself.
+      handleRequest( socket, requestLine[1] );
+    }
+  }
+
+  void OGCServiceProxyServer::handleRequest( QTcpSocket *socket, const QByteArray &target )
+  {
+    PendingRequest request;
+    request.m_socket = socket;
+    request.m_prefetch = false;
+    request.m_authorized = false;
+    request.m_haveStored = false;
+
+    QByteArray upstreamURL;
+    QMap< QByteArray, QByteArray > parameters;
+    if( !decodeRequest( target, upstreamURL, request.m_type, request.m_key, parameters ) )
+    {
+      sendResponse( socket, 400, "Bad Request", "text/plain", "Not a proxied address\n" );
+      return;
+    }
+    request.m_host = QUrl::fromEncoded( upstreamURL ).host().toUtf8();
+    if( request.m_type == RequestMap )
+    {
+      request.m_host = WMTSRequestScheduler::mapHost( request.m_host );
+    }
+
+    std::map< QByteArray, QByteArray >::const_iterator credentials = m_credentials.find( origin( upstreamURL ) );
+    QByteArray authorization = credentials != m_credentials.end() ? credentials->second : QByteArray();
+
+    if( request.m_type == RequestTile )
+    {
+      {
+        QMutexLocker lock( &m_statisticsMutex );
+        ++m_statistics.m_requests;
+      }
+
+      // The first tile asked for after the view settled belongs to a new view, so the prefetches
+      // planned for the old one are no longer wanted
+      if( m_viewSettled )
+      {
+        m_viewSettled = false;
+        m_prefetcher.beginView();
+        cancelQueuedPrefetches();
+      }
+      m_prefetcher.tileRequested( target, parameters, authorization );
+      m_viewTimer->start( g_viewSettleDelay );
+    }
+    else if( request.m_type == RequestMap && m_frames.animating() )
+    {
+      {
+        QMutexLocker lock( &m_statisticsMutex );
+        ++m_statistics.m_frameRequests;
+      }
+
+      m_frames.mapRequested( target, upstreamURL.left( upstreamURL.indexOf( '?' ) ), parameters, authorization );
+
+      QByteArray contentType, data;
+      if( m_frames.find( request.m_key, contentType, data ) )
+      {
+        {
+          QMutexLocker lock( &m_statisticsMutex );
+          ++m_statistics.m_frameHits;
+        }
+        sendResponse( socket, 200, "OK", contentType, data );
+        planFrames();
+        return;
+      }
+    }
+
+    if( (request.m_type == RequestCapabilities || request.m_type == RequestTile) &&
+        m_store.find( request.m_key, request.m_storedEntry, request.m_storedData ) )
+    {
+      if( request.m_storedEntry.m_expiry > QDateTime::currentMSecsSinceEpoch() )
+      {
+        if( request.m_type == RequestTile )
+        {
+          recordTileResult( TileHit );
+        }
+        sendStored( request, request.m_storedEntry, request.m_storedData );
+        return;
+      }
+
+      // The stored response has expired, so ask the server whether it is still current
+      request.m_haveStored = true;
+    }
+
+    // If the tile or frame is already being prefetched, answer the data layer when the prefetch completes
+    std::map< QByteArray, QNetworkReply* >::iterator prefetch = m_prefetchReplies.find( request.m_key );
+    if( (request.m_type == RequestTile || request.m_type == RequestMap) && prefetch != m_prefetchReplies.end() )
+    {
+      PendingRequest &pending = m_pendingRequests[prefetch->second];
+      pending.m_socket = socket;
+      pending.m_prefetch = false;
+
+      // A prefetch that is revalidating a tile does not read it, but the data layer needs it if it is unchanged
+      if( request.m_haveStored )
+      {
+        pending.m_haveStored = true;
+        pending.m_storedEntry = request.m_storedEntry;
+        pending.m_storedData = request.m_storedData;
+      }
+      m_prefetchReplies.erase( prefetch );
+      ++m_foregroundRequests;
+      return;
+    }
+
+    scheduleUpstream( request, upstreamURL, authorization, target, parameters );
+  }
+
+  void OGCServiceProxyServer::scheduleUpstream( const PendingRequest &request, const QByteArray &upstreamURL, const QByteArray &authorization,
+                                                const QByteArray &target, const QMap< QByteArray, QByteArray > &parameters )
+  {
+    quint64 id = m_nextRequestID++;
+    ScheduledRequest &scheduled = m_scheduledRequests[id];
+    scheduled.m_request = request;
+    scheduled.m_upstreamURL = upstreamURL;
+    scheduled.m_authorization = authorization;
+    ++m_foregroundRequests;
+
+    // Only key-value-pair tile requests give their position in the tile matrix
+    bool validRow = false, validCol = false;
+    int row = parameters.value( "TILEROW" ).toInt( &validRow );
+    int col = parameters.value( "TILECOL" ).toInt( &validCol );
+    if( request.m_type != RequestTile || !validRow || !validCol )
+    {
+      m_scheduler.add( id, request.m_host );
+      sendScheduledRequests();
+      return;
+    }
+
+    std::vector< quint64 > obsolete;
+    m_scheduler.addTile( id, request.m_host, WMTSTilePrefetcher::tileTarget( target, QByteArray(), 0, 0 ),
+                         parameters.value( "TILEMATRIX" ), row, col, obsolete );
+
+    cancelScheduledRequests( obsolete );
+
+    sendScheduledRequests();
+  }
+
+  void OGCServiceProxyServer::cancelScheduledRequests( const std::vector< quint64 > &obsolete )
+  {
+    // Answer the obsolete requests straight away. The data layer no longer shows these tiles, and
+    // will ask again if it needs them.
+    for( size_t i = 0; i < obsolete.size(); ++i )
+    {
+      std::map< quint64, ScheduledRequest >::iterator cancelled = m_scheduledRequests.find( obsolete[i] );
+      if( cancelled == m_scheduledRequests.end() )
+      {
+        continue;
+      }
+
+      sendResponse( cancelled->second.m_request.m_socket, 503, "Service Unavailable", "text/plain",
+                    "Cancelled as the view has changed\n", "Retry-After: 0\r\n" );
+      m_scheduledRequests.erase( cancelled );
+      --m_foregroundRequests;
+
+      QMutexLocker lock( &m_statisticsMutex );
+      ++m_statistics.m_cancelled;
+    }
+  }
+
+  void OGCServiceProxyServer::sendScheduledRequests()
+  {
+    // Layers that have stayed at a new tile matrix may have made waiting requests obsolete
+    std::vector< quint64 > obsolete;
+    m_scheduler.takeObsolete( obsolete );
+    cancelScheduledRequests( obsolete );
+
+    quint64 id = 0;
+    while( m_scheduler.next( id ) )
+    {
+      std::map< quint64, ScheduledRequest >::iterator scheduled = m_scheduledRequests.find( id );
+      if( scheduled == m_scheduledRequests.end() )
+      {
+        continue;
+      }
+      ScheduledRequest request = scheduled->second;
+      m_scheduledRequests.erase( scheduled );
+
+      if( !request.m_request.m_socket )
+      {
+        // The data layer closed the connection while the request was waiting
+        m_scheduler.finished( request.m_request.m_host );
+        --m_foregroundRequests;
+        continue;
+      }
+
+      fetchUpstream( request.m_request, request.m_upstreamURL, request.m_authorization );
+    }
+  }
+
+  void OGCServiceProxyServer::fetchUpstream( const PendingRequest &request, const QByteArray &upstreamURL, const QByteArray &authorization )
+  {
+    QNetworkRequest upstreamRequest( QUrl::fromEncoded( upstreamURL ) );
+    if( !authorization.isEmpty() )
+    {
+      upstreamRequest.setRawHeader( "Authorization", authorization );
+    }
+    if( request.m_haveStored )
+    {
+      if( !request.m_storedEntry.m_etag.isEmpty() )
+      {
+        upstreamRequest.setRawHeader( "If-None-Match", request.m_storedEntry.m_etag );
+      }
+      if( !request.m_storedEntry.m_lastModified.isEmpty() )
+      {
+        upstreamRequest.setRawHeader( "If-Modified-Since", request.m_storedEntry.m_lastModified );
+      }
+    }
+    if( request.m_prefetch )
+    {
+      // Let the data layer's requests to the same server go first
+      upstreamRequest.setPriority( QNetworkRequest::LowPriority );
+    }
+
+    QNetworkReply *reply = m_network->get( upstreamRequest );
+    PendingRequest &pending = m_pendingRequests[reply];
+    pending = request;
+    pending.m_authorized = !authorization.isEmpty();
+    if( request.m_prefetch )
+    {
+      m_prefetchReplies[request.m_key] = reply;
+    }
+
+    // Aborting the request reports it as failed, so an unresponsive server is treated as unreachable
+    QTimer *timeout = new QTimer( reply );
+    timeout->setSingleShot( true );
+    connect( timeout, SIGNAL(timeout()), reply, SLOT(abort()) );
+    timeout->start( g_upstreamTimeout );
+  }
+
+  void OGCServiceProxyServer::upstreamFinished( QNetworkReply *reply )
+  {
+    reply->deleteLater();
+
+    std::map< QNetworkReply*, PendingRequest >::iterator pending = m_pendingRequests.find( reply );
+    if( pending == m_pendingRequests.end() )
+    {
+      return;
+    }
+    PendingRequest request = pending->second;
+    m_pendingRequests.erase( pending );
+
+    // The server can take another request
+    m_scheduler.finished( request.m_host );
+    sendScheduledRequests();
+
+    if( request.m_prefetch )
+    {
+      prefetchFinished( reply, request );
+      return;
+    }
+    --m_foregroundRequests;
+
+    bool isTile = request.m_type == RequestTile;
+    int status = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+    QByteArray reason = reply->attribute( QNetworkRequest::HttpReasonPhraseAttribute ).toByteArray();
+
+    if( status == 0 || status >= 500 )
+    {
+      // The server could not be reached or failed. An expired response is better than none.
+      if( request.m_haveStored )
+      {
+        if( isTile )
+        {
+          recordTileResult( TileOffline );
+        }
+        sendStored( request, request.m_storedEntry, request.m_storedData );
+      }
+      else
+      {
+        if( isTile )
+        {
+          recordTileResult( TileFailure );
+        }
+
+        if( status == 0 )
+        {
+          sendResponse( request.m_socket, 504, "Gateway Timeout", "text/plain", reply->errorString().toUtf8() + "\n" );
+        }
+        else
+        {
+          sendResponse( request.m_socket, status, reason, reply->header( QNetworkRequest::ContentTypeHeader ).toByteArray(),
+                        reply->readAll() );
+        }
+      }
+      return;
+    }
+
+    qint64 expiry = 0;
+    bool storable = (request.m_type == RequestCapabilities || request.m_type == RequestTile) &&
+                    responseExpiry( reply, request.m_authorized, expiry );
+
+    if( status == 304 && request.m_haveStored )
+    {
+      if( storable )
+      {
+        m_store.refresh( request.m_key, expiry );
+      }
+      if( isTile )
+      {
+        recordTileResult( TileRevalidated );
+      }
+      sendStored( request, request.m_storedEntry, request.m_storedData );
+      return;
+    }
+
+    QByteArray body = reply->readAll();
+    QByteArray contentType = reply->header( QNetworkRequest::ContentTypeHeader ).toByteArray();
+    if( status == 200 && storable )
+    {
+      // The unmodified response is stored, as the proxy's address may be different in later sessions
+      WMTSTileStore::Entry entry;
+      entry.m_contentType = contentType;
+      entry.m_etag = reply->rawHeader( "ETag" );
+      entry.m_lastModified = reply->rawHeader( "Last-Modified" );
+      entry.m_expiry = expiry;
+      m_store.store( request.m_key, body, entry );
+    }
+
+    if( isTile )
+    {
+      recordTileResult( status == 200 ? TileMiss : TileFailure );
+    }
+
+    if( status == 200 && request.m_type == RequestCapabilities )
+    {
+      m_prefetcher.addCapabilities( body );
+      body = rewriteCapabilities( body );
+    }
+    else if( request.m_type == RequestMap && m_frames.animating() )
+    {
+      if( status == 200 )
+      {
+        m_frames.store( request.m_key, contentType, body );
+      }
+
+      // The data layer has what it asked for, so the frames ahead can be fetched
+      planFrames();
+    }
+
+    // Let the remote loader see authentication challenges so it can ask for credentials
+    QByteArray extraHeaders;
+    if( reply->hasRawHeader( "WWW-Authenticate" ) )
+    {
+      extraHeaders += "WWW-Authenticate: " + reply->rawHeader( "WWW-Authenticate" ) + "\r\n";
+    }
+    if( reply->hasRawHeader( "Location" ) )
+    {
+      extraHeaders += "Location: " + reply->rawHeader( "Location" ) + "\r\n";
+    }
+    sendResponse( request.m_socket, status, reason, contentType, body, extraHeaders );
+  }
+
+  void OGCServiceProxyServer::prefetchFinished( QNetworkReply *reply, const PendingRequest &request )
+  {
+    std::map< QByteArray, QNetworkReply* >::iterator prefetch = m_prefetchReplies.find( request.m_key );
+    if( prefetch != m_prefetchReplies.end() && prefetch->second == reply )
+    {
+      m_prefetchReplies.erase( prefetch );
+    }
+
+    int status = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+    qint64 expiry = 0;
+    if( request.m_type == RequestMap )
+    {
+      // Frames are not counted against the prefetch budget, as the animation the user asked for needs them
+      if( status == 200 && m_frames.animating() )
+      {
+        m_frames.store( request.m_key, reply->header( QNetworkRequest::ContentTypeHeader ).toByteArray(), reply->readAll() );
+
+        QMutexLocker lock( &m_statisticsMutex );
+        ++m_statistics.m_framesPrefetched;
+      }
+    }
+    else if( status == 304 && request.m_haveStored )
+    {
+      if( responseExpiry( reply, request.m_authorized, expiry ) )
+      {
+        m_store.refresh( request.m_key, expiry );
+      }
+
+      QMutexLocker lock( &m_statisticsMutex );
+      ++m_statistics.m_prefetched;
+    }
+    else if( status == 200 )
+    {
+      QByteArray body = reply->readAll();
+      if( responseExpiry( reply, request.m_authorized, expiry ) )
+      {
+        WMTSTileStore::Entry entry;
+        entry.m_contentType = reply->header( QNetworkRequest::ContentTypeHeader ).toByteArray();
+        entry.m_etag = reply->rawHeader( "ETag" );
+        entry.m_lastModified = reply->rawHeader( "Last-Modified" );
+        entry.m_expiry = expiry;
+        m_store.store( request.m_key, body, entry );
+      }
+      m_prefetchAllowance -= body.size();
+
+      QMutexLocker lock( &m_statisticsMutex );
+      ++m_statistics.m_prefetched;
+      m_statistics.m_prefetchBytes += body.size();
+    }
+
+    // Failed and cancelled prefetches are dropped; the data layer will ask for the tile if it needs it
+    dispatchPrefetches();
+  }
+
+  void OGCServiceProxyServer::viewSettled()
+  {
+    if( m_foregroundRequests > 0 )
+    {
+      // Don't compete with the data layer while its requests are outstanding
+      m_viewTimer->start( g_viewSettleDelay );
+      return;
+    }
+    m_viewSettled = true;
+    m_scheduler.beginView();
+
+    std::vector< WMTSTilePrefetcher::Tile > tiles;
+    if( m_store.maximumSize() > 0 )
+    {
+      m_prefetcher.plan( tiles );
+    }
+
+    // Queue the planned tiles that are not already stored or being fetched
+    std::set< QByteArray > plannedKeys;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for( size_t i = 0; i < tiles.size(); ++i )
+    {
+      QByteArray upstreamURL, key;
+      RequestType type;
+      QMap< QByteArray, QByteArray > parameters;
+      if( !decodeRequest( tiles[i].m_target, upstreamURL, type, key, parameters ) || type != RequestTile ||
+          !plannedKeys.insert( key ).second )
+      {
+        continue;
+      }
+
+      WMTSTileStore::Entry entry;
+      if( m_prefetchReplies.find( key ) == m_prefetchReplies.end() &&
+          (!m_store.findEntry( key, entry ) || entry.m_expiry <= now) )
+      {
+        Prefetch prefetch;
+        prefetch.m_target = tiles[i].m_target;
+        prefetch.m_authorization = tiles[i].m_authorization;
+        m_prefetchQueue.push_back( prefetch );
+      }
+    }
+
+    // Cancel the prefetches under way that the view no longer needs. Aborting a reply finishes it
+    // straight away, so collect them first.
+    std::vector< QNetworkReply* > unwanted;
+    std::map< QByteArray, QNetworkReply* >::const_iterator it( m_prefetchReplies.begin() );
+    std::map< QByteArray, QNetworkReply* >::const_iterator itE( m_prefetchReplies.end() );
+    for( ; it != itE; ++it )
+    {
+      // Frames of an animation are planned separately, and are still wanted
+      if( plannedKeys.find( it->first ) == plannedKeys.end() && !WMSFrameCache::isRequestKey( it->first ) )
+      {
+        unwanted.push_back( it->second );
+      }
+    }
+
+    if( !unwanted.empty() )
+    {
+      QMutexLocker lock( &m_statisticsMutex );
+      m_statistics.m_prefetchCancelled += (int)unwanted.size();
+    }
+    for( size_t i = 0; i < unwanted.size(); ++i )
+    {
+      unwanted[i]->abort();
+    }
+
+    dispatchPrefetches();
+  }
+
+  void OGCServiceProxyServer::dispatchPrefetches()
+  {
+    if( !m_viewSettled || m_foregroundRequests > 0 )
+    {
+      return;
+    }
+
+    // Top up the allowance for the time since it was last used, up to one second's budget
+    qint64 elapsed = m_allowanceClock.elapsed();
+    m_prefetchAllowance = std::min( m_prefetchAllowance + (elapsed - m_lastAllowanceUpdate) * m_prefetchBudget / 1000.0,
+                                    (double)m_prefetchBudget );
+    m_lastAllowanceUpdate = elapsed;
+
+    while( !m_prefetchQueue.empty() )
+    {
+      Prefetch queued = m_prefetchQueue.front();
+
+      PendingRequest request;
+      request.m_prefetch = true;
+      request.m_authorized = false;
+      QByteArray upstreamURL;
+      QMap< QByteArray, QByteArray > parameters;
+      if( !decodeRequest( queued.m_target, upstreamURL, request.m_type, request.m_key, parameters ) ||
+          m_prefetchReplies.find( request.m_key ) != m_prefetchReplies.end() )
+      {
+        m_prefetchQueue.pop_front();
+        continue;
+      }
+
+      bool isFrame = request.m_type == RequestMap;
+      if( m_prefetchReplies.size() >= (isFrame ? g_maxFramePrefetchRequests : g_maxPrefetchRequests) )
+      {
+        return;
+      }
+      if( !isFrame && m_prefetchBudget > 0 && m_prefetchAllowance <= 0.0 )
+      {
+        m_budgetTimer->start( g_budgetRetryInterval );
+        return;
+      }
+      m_prefetchQueue.pop_front();
+
+      // The data layer may have asked for the tile or frame since it was queued. An expired tile only
+      // needs revalidating, which doesn't need its data.
+      if( isFrame )
+      {
+        request.m_haveStored = false;
+        if( m_frames.contains( request.m_key ) )
+        {
+          continue;
+        }
+      }
+      else
+      {
+        request.m_haveStored = m_store.findEntry( request.m_key, request.m_storedEntry );
+        if( request.m_haveStored && request.m_storedEntry.m_expiry > QDateTime::currentMSecsSinceEpoch() )
+        {
+          continue;
+        }
+      }
+
+      // Prefetches share the server's limit with the data layer's requests. One finishing dispatches again.
+      request.m_host = QUrl::fromEncoded( upstreamURL ).host().toUtf8();
+      if( isFrame )
+      {
+        request.m_host = WMTSRequestScheduler::mapHost( request.m_host );
+      }
+      if( !m_scheduler.start( request.m_host ) )
+      {
+        m_prefetchQueue.push_front( queued );
+        return;
+      }
+
+      fetchUpstream( request, upstreamURL, queued.m_authorization );
+    }
+  }
+
+  void OGCServiceProxyServer::planFrames()
+  {
+    // Drop the frames planned before, which may be for frames that have since been shown
+    std::deque< Prefetch >::iterator it( m_prefetchQueue.begin() );
+    while( it != m_prefetchQueue.end() )
+    {
+      QByteArray upstreamURL, key;
+      RequestType type;
+      QMap< QByteArray, QByteArray > parameters;
+      if( decodeRequest( it->m_target, upstreamURL, type, key, parameters ) && type == RequestMap )
+      {
+        it = m_prefetchQueue.erase( it );
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    std::vector< WMSFrameCache::Frame > frames;
+    m_frames.plan( frames );
+    for( size_t i = 0; i < frames.size(); ++i )
+    {
+      Prefetch prefetch;
+      prefetch.m_target = frames[i].m_target;
+      prefetch.m_authorization = frames[i].m_authorization;
+      m_prefetchQueue.push_back( prefetch );
+    }
+
+    dispatchPrefetches();
+  }
+
+  void OGCServiceProxyServer::cancelQueuedPrefetches()
+  {
+    if( m_prefetchQueue.empty() )
+    {
+      return;
+    }
+
+    QMutexLocker lock( &m_statisticsMutex );
+    m_statistics.m_prefetchCancelled += (int)m_prefetchQueue.size();
+    m_prefetchQueue.clear();
+  }
+
+  bool OGCServiceProxyServer::decodeRequest( const QByteArray &target, QByteArray &upstreamURL, RequestType &type, QByteArray &key,
+                                             QMap< QByteArray, QByteArray > &parameters )
+  {
+    int queryStart = target.indexOf( '?' );
+    QByteArray path = target.left( queryStart );
+    QByteArray query = queryStart >= 0 ? target.mid( queryStart + 1 ) : QByteArray();
+
+    if( !path.startsWith( g_proxyPathPrefix ) )
+    {
+      return false;
+    }
+
+    // Separate the encoded server address from any path that follows it, such as a filled in resource template
+    QByteArray encodedPath = path.mid( (int)strlen( g_proxyPathPrefix ) );
+    int addressEnd = encodedPath.indexOf( '/' );
+    QByteArray address = QByteArray::fromBase64( encodedPath.left( addressEnd ), QByteArray::Base64UrlEncoding );
+    QByteArray resourcePath = addressEnd >= 0 ? encodedPath.mid( addressEnd + 1 ) : QByteArray();
+    if( !address.startsWith( "http://" ) && !address.startsWith( "https://" ) )
+    {
+      return false;
+    }
+
+    upstreamURL = address + resourcePath;
+    if( queryStart >= 0 )
+    {
+      upstreamURL += "?" + query;
+    }
+
+    // OGC parameter names are not case sensitive
+    parameters.clear();
+    QList< QByteArray > queryItems = query.split( '&' );
+    for( int i = 0; i < queryItems.size(); ++i )
+    {
+      int separator = queryItems[i].indexOf( '=' );
+      if( separator > 0 )
+      {
+        parameters[ QByteArray::fromPercentEncoding( queryItems[i].left( separator ) ).toUpper() ] =
+          QByteArray::fromPercentEncoding( queryItems[i].mid( separator + 1 ) );
+      }
+    }
+
+    QByteArray request = parameters.value( "REQUEST" ).toLower();
+    if( request == "getcapabilities" || (request.isEmpty() && upstreamURL.toLower().contains( "capabilities" )) )
+    {
+      type = RequestCapabilities;
+      key = "capabilities\n" + upstreamURL;
+    }
+    else if( request == "gettile" )
+    {
+      // Tiles are identified by the layer, style, tile matrix set and position in the matrix. Any other
+      // parameters, such as dimension values, are included so that different values are kept apart.
+      static const char *tileParameters[] = { "LAYER", "STYLE", "TILEMATRIXSET", "TILEMATRIX", "TILEROW", "TILECOL", "FORMAT" };
+      static const size_t numTileParameters = sizeof( tileParameters ) / sizeof( tileParameters[0] );
+
+      type = RequestTile;
+      key = "tile\n" + address;
+      QMap< QByteArray, QByteArray > otherParameters( parameters );
+      for( size_t i = 0; i < numTileParameters; ++i )
+      {
+        key += "\n" + parameters.value( tileParameters[i] );
+        otherParameters.remove( tileParameters[i] );
+      }
+
+      otherParameters.remove( "SERVICE" );
+      otherParameters.remove( "REQUEST" );
+      otherParameters.remove( "VERSION" );
+      QMap< QByteArray, QByteArray >::const_iterator it( otherParameters.constBegin() );
+      QMap< QByteArray, QByteArray >::const_iterator itE( otherParameters.constEnd() );
+      for( ; it != itE; ++it )
+      {
+        key += "\n" + it.key() + "=" + it.value();
+      }
+    }
+    else if( request == "getmap" )
+    {
+      // Images of the same view with different dimension values are kept apart by their parameters
+      type = RequestMap;
+      key = WMSFrameCache::requestKey( address + resourcePath, parameters );
+    }
+    else if( !resourcePath.isEmpty() )
+    {
+      // A request made from a resource URL template, where the path identifies the tile
+      type = RequestTile;
+      key = "tile\n" + upstreamURL;
+    }
+    else
+    {
+      type = RequestOther;
+      key.clear();
+    }
+    return true;
+  }
+
+  QByteArray OGCServiceProxyServer::rewriteCapabilities( const QByteArray &document ) const
+  {
+    // Operation addresses for key-value-pair requests, and resource URL templates for RESTful requests.
+    // WMS capabilities give operation addresses in an OnlineResource element inside each Get element.
+    static const QRegularExpression operationAddress( "(<(?:\\w+:)?Get\\b[^>]*?\\bxlink:href=\")([^\"]*)\"" );
+    static const QRegularExpression resourceTemplate( "(<(?:\\w+:)?ResourceURL\\b[^>]*?\\btemplate=\")([^\"]*)\"" );
+    static const QRegularExpression wmsOperationAddress( "(<(?:\\w+:)?Get>\\s*<(?:\\w+:)?OnlineResource\\b[^>]*?\\bxlink:href=\")([^\"]*)\"" );
+
+    QString text = QString::fromUtf8( document );
+    const QRegularExpression *expressions[] = { &operationAddress, &resourceTemplate, &wmsOperationAddress };
+    for( int e = 0; e < 3; ++e )
+    {
+      QString rewritten;
+      int copiedTo = 0;
+      QRegularExpressionMatchIterator matches = expressions[e]->globalMatch( text );
+      while( matches.hasNext() )
+      {
+        QRegularExpressionMatch match = matches.next();
+        QByteArray address = match.captured( 2 ).toUtf8().replace( "&amp;", "&" );
+
+        // Only the part of a template before its first parameter identifies the server
+        int parametersStart = address.indexOf( '{' );
+        QByteArray templateParameters = parametersStart >= 0 ? address.mid( parametersStart ) : QByteArray();
+        QByteArray proxied = proxyURL( address.left( parametersStart ), serverPort() ) + templateParameters;
+
+        rewritten += text.mid( copiedTo, match.capturedStart( 2 ) - copiedTo );
+        rewritten += QString::fromUtf8( proxied.replace( "&", "&amp;" ) );
+        copiedTo = match.capturedEnd( 2 );
+      }
+      rewritten += text.mid( copiedTo );
+      text = rewritten;
+    }
+    return text.toUtf8();
+  }
+
+  bool OGCServiceProxyServer::responseExpiry( QNetworkReply *reply, bool authorized, qint64 &expiry )
+  {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QByteArray cacheControl = reply->rawHeader( "Cache-Control" ).toLower();
+    if( cacheControl.contains( "no-store" ) || cacheControl.contains( "private" ) )
+    {
+      return false;
+    }
+
+    // The store is read without credentials, even when the server cannot be reached, so a response
+    // to a request made with them is only stored if the server says anyone may see it
+    if( authorized && !cacheControl.contains( "public" ) )
+    {
+      return false;
+    }
+
+    if( cacheControl.contains( "no-cache" ) )
+    {
+      // May be stored, but must be revalidated every time it is used
+      expiry = now;
+      return true;
+    }
+
+    static const QRegularExpression maxAge( "max-age\\s*=\\s*(\\d+)" );
+    QRegularExpressionMatch maxAgeMatch = maxAge.match( QString::fromLatin1( cacheControl ) );
+    if( maxAgeMatch.hasMatch() )
+    {
+      expiry = now + maxAgeMatch.captured( 1 ).toLongLong() * 1000;
+      return true;
+    }
+
+    if( reply->hasRawHeader( "Expires" ) )
+    {
+      QDateTime expires = QLocale::c().toDateTime( QString::fromLatin1( reply->rawHeader( "Expires" ) ),
+                                                  "ddd, dd MMM yyyy hh:mm:ss 'GMT'" );
+      expires.setTimeSpec( Qt::UTC );
+
+      // An invalid date means the response has already expired
+      expiry = expires.isValid() ? expires.toMSecsSinceEpoch() : now;
+      return true;
+    }
+
+    expiry = now + g_defaultFreshness;
+    return true;
+  }
+
+  void OGCServiceProxyServer::sendResponse( QTcpSocket *socket, int status, const QByteArray &reason, const QByteArray &contentType,
+                                            const QByteArray &body, const QByteArray &extraHeaders )
+  {
+    if( !socket )
+    {
+      // The connection was closed while the server was being contacted
+      return;
+    }
+
+    QByteArray response = "HTTP/1.1 " + QByteArray::number( status ) + " " + (reason.isEmpty() ? QByteArray( "Status" ) : reason) + "\r\n";
+    if( !contentType.isEmpty() )
+    {
+      response += "Content-Type: " + contentType + "\r\n";
+    }
+    response += "Content-Length: " + QByteArray::number( body.size() ) + "\r\n";
+    response += extraHeaders;
+    response += "\r\n";
+    response += body;
+    socket->write( response );
+  }
+
+  void OGCServiceProxyServer::sendStored( const PendingRequest &request, const WMTSTileStore::Entry &entry, const QByteArray &data )
+  {
+    if( request.m_type == RequestCapabilities )
+    {
+      m_prefetcher.addCapabilities( data );
+    }
+    sendResponse( request.m_socket, 200, "OK", entry.m_contentType,
+                  request.m_type == RequestCapabilities ? rewriteCapabilities( data ) : data );
+  }
+
+  void OGCServiceProxyServer::recordTileResult( TileResult result )
+  {
+    QMutexLocker lock( &m_statisticsMutex );
+    switch( result )
+    {
+      case TileHit:
+        ++m_statistics.m_hits;
+        break;
+
+      case TileRevalidated:
+        ++m_statistics.m_revalidated;
+        break;
+
+      case TileOffline:
+        ++m_statistics.m_offline;
+        break;
+
+      case TileMiss:
+        ++m_statistics.m_misses;
+        break;
+
+      case TileFailure:
+        ++m_statistics.m_failures;
+        break;
+    }
+  }
+};
@@ -0,0 +1,358 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#ifndef OGCSERVICEPROXY_H
+#define OGCSERVICEPROXY_H
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QTcpServer>
+#include <QThread>
+#include <QVariantMap>
+
+#include "wmts/wmtstilestore.h"
+#include "wmts/wmtstileprefetcher.h"
+#include "wmts/wmtsrequestscheduler.h"
+#include "wms/wmsframecache.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+class QTcpSocket;
+
+// WMS and WMTS data layers load their capabilities and images through MapLink's remote loader,
+// which only keeps images in memory. Both kinds of service are loaded through this proxy instead,
+// which runs a small HTTP server on the local machine in its own thread.
+//
+// The capabilities document is rewritten so that the data layer sends its requests to the proxy
+// too. WMTS tiles are kept between sessions: they are answered from a WMTSTileStore on disk while
+// they are fresh, revalidated with the server using their ETag or modification time once they
+// expire, and still answered from the store when the server cannot be reached.
+//
+// Once the data layer has stopped asking for tiles for a view and all its requests have been
+// answered, the proxy fetches the tiles around the view into the store at low priority, as planned
+// by a WMTSTilePrefetcher, so that panning and zooming find them there. Prefetching stops as soon as
+// the data layer asks for another tile, prefetches the new view does not need are cancelled, and
+// the bytes prefetched each second are limited by a budget.
+//
+// Requests to each server are limited, and those waiting are sent in the order a WMTSRequestScheduler
+// chooses, so the tiles nearest the centre of the current view arrive first. When the view zooms,
+// waiting requests for the previous zoom level are answered straight away as unavailable, which
+// frees the data layer's connections for the tiles it now needs.
+//
+// WMS services are loaded through the proxy too. Their GetMap requests are passed on to the server
+// without being stored on disk, except while the service is animated, when they are held in a
+// WMSFrameCache in memory and the frames after the one shown are fetched ahead of the data layer.
+
+namespace Services
+{
+  class OGCServiceProxyServer;
+
+  class OGCServiceProxy : public QObject
+  {
+    Q_OBJECT
+    public:
+      // Counts of the tile requests answered by the proxy
+      struct Statistics
+      {
+        Statistics();
+
+        int m_requests;
+
+        // Answered from the store without contacting the server
+        int m_hits;
+
+        // Answered from the store after the server confirmed the tile was unchanged
+        int m_revalidated;
+
+        // Answered from the store because the server could not be reached
+        int m_offline;
+
+        // Fetched from the server
+        int m_misses;
+
+        // Could not be answered
+        int m_failures;
+
+        // Tiles fetched into the store ahead of the data layer, and the bytes fetched for them
+        int m_prefetched;
+        qint64 m_prefetchBytes;
+
+        // Prefetches dropped because the view changed before they completed
+        int m_prefetchCancelled;
+
+        // Requests from the data layer that were cancelled before being sent because the view zoomed
+        int m_cancelled;
+
+        // GetMap requests made while a WMS service is animated, those answered from the frame cache,
+        // and the images fetched into it ahead of the data layer
+        int m_frameRequests;
+        int m_frameHits;
+        int m_framesPrefetched;
+      };
+
+      // Starts the proxy, with a store in the given directory of the given maximum size in bytes
+      OGCServiceProxy( const QString &directory, qint64 maximumSize );
+      virtual ~OGCServiceProxy();
+
+      // Returns false if the proxy could not start listening for requests, in which case services
+      // should be loaded directly
+      bool isRunning() const;
+
+      // Returns the address to load the service at serviceURL through the proxy
+      std::string proxyURL( const char *serviceURL ) const;
+
+      // Returns the address on the server that a proxied address is for, or an empty string if the
+      // address is not one of this proxy's
+      std::string upstreamURL( const char *proxiedURL ) const;
+
+      // Returns the start of a proxied address that is the same for every request to its service,
+      // up to and including the encoded server address
+      std::string proxiedServiceURL( const char *proxiedURL ) const;
+
+      // Sets the credentials for the server of a proxied address. Every proxied address is on this
+      // machine, so the credentials the data layer sends are not passed on; instead the proxy sends
+      // these credentials to the server's scheme, host and port, and to no other. Empty credentials
+      // remove those of the server.
+      void setCredentials( const char *proxiedURL, const char *username, const char *password );
+
+      // Removes the credentials of every server
+      void clearCredentials();
+
+      // Changes the maximum size of the store. A size of 0 stops tiles being stored.
+      void setMaximumSize( qint64 maximumSize );
+
+      // Sets the number of tiles around the view to prefetch, 0 to disable prefetching, and the most
+      // bytes to prefetch each second, 0 for no limit
+      void setPrefetch( int ring, qint64 budget );
+
+      // Sets the most requests sent to each server at once, and the limits for particular servers
+      // keyed by host name with integer values
+      void setHostLimits( int defaultLimit, const QVariantMap &hostLimits );
+
+      // Turns prioritisation and cancellation of waiting requests on or off
+      void setPrioritise( bool prioritise );
+
+      // Sets the WMS GetMap parameter being animated, such as TIME, the values it steps through and the
+      // number of frames after the one shown to fetch ahead. No values ends the animation.
+      void setAnimation( const QString &parameter, const QStringList &values, int framesAhead );
+
+      // Sets the most bytes of animation frames held in memory
+      void setFrameCacheSize( qint64 maximumSize );
+
+      // Removes all stored tiles. This waits for the proxy's thread to finish doing so.
+      void clear();
+
+      Statistics statistics() const;
+
+    private:
+      QThread m_thread;
+      OGCServiceProxyServer *m_server;
+      int m_port;
+  };
+
+  // The HTTP server used by OGCServiceProxy, which lives in the proxy's thread
+  class OGCServiceProxyServer : public QTcpServer
+  {
+    Q_OBJECT
+    public:
+      OGCServiceProxyServer( const QString &directory, qint64 maximumSize );
+      virtual ~OGCServiceProxyServer();
+
+      OGCServiceProxy::Statistics statistics() const;
+
+      // Builds the proxied form of an address on the server, for a proxy listening on the given port
+      static QByteArray proxyURL( const QByteArray &serviceURL, int port );
+
+      // Decodes the address on the server from a proxied path and query, returning an empty array if
+      // the path is not a proxied one
+      static QByteArray upstreamURL( const QByteArray &target );
+
+      // The scheme, host and port of an address, which credentials are kept for
+      static QByteArray origin( const QByteArray &url );
+
+    public slots:
+      // Starts listening, returning the port used or 0 on failure
+      int start();
+      void setMaximumSize( qint64 maximumSize );
+      void setPrefetch( int ring, qint64 budget );
+      void setHostLimits( int defaultLimit, const QVariantMap &hostLimits );
+      void setPrioritise( bool prioritise );
+      void setAnimation( const QString &parameter, const QStringList &values, int framesAhead );
+      void setFrameCacheSize( qint64 maximumSize );
+      void setCredentials( const QByteArray &origin, const QByteArray &authorization );
+      void clearCredentials();
+      void clear();
+
+    protected:
+      virtual void incomingConnection( qintptr socketDescriptor );
+
+    private slots:
+      void readRequest();
+      void connectionClosed();
+      void upstreamFinished( QNetworkReply *reply );
+      void saveStore();
+
+      // Called once the data layer has stopped asking for tiles for the current view
+      void viewSettled();
+      void dispatchPrefetches();
+
+    private:
+      enum TileResult
+      {
+        TileHit,
+        TileRevalidated,
+        TileOffline,
+        TileMiss,
+        TileFailure
+      };
+
+      enum RequestType
+      {
+        RequestCapabilities,
+        RequestTile,
+        RequestMap,
+        RequestOther
+      };
+
+      struct PendingRequest
+      {
+        QPointer< QTcpSocket > m_socket;
+        RequestType m_type;
+        QByteArray m_key;
+
+        // The server the request is sent to, which limits the requests it is sent at once. GetMap
+        // requests are limited separately, under WMTSRequestScheduler::mapHost.
+        QByteArray m_host;
+
+        // Set for prefetches the data layer has not asked for yet, which have no socket
+        bool m_prefetch;
+
+        // Set if the request was sent with credentials
+        bool m_authorized;
+
+        // Set if the store holds an expired response for the request
+        bool m_haveStored;
+        WMTSTileStore::Entry m_storedEntry;
+        QByteArray m_storedData;
+      };
+
+      // A tile or frame waiting to be prefetched
+      struct Prefetch
+      {
+        // The proxied path and query, as the data layer would have requested it
+        QByteArray m_target;
+        QByteArray m_authorization;
+      };
+
+      void handleRequest( QTcpSocket *socket, const QByteArray &target );
+
+      // A request waiting in the scheduler to be sent to its server
+      struct ScheduledRequest
+      {
+        PendingRequest m_request;
+        QByteArray m_upstreamURL;
+        QByteArray m_authorization;
+      };
+
+      // Passes a request to the scheduler, cancelling the requests it makes obsolete
+      void scheduleUpstream( const PendingRequest &request, const QByteArray &upstreamURL, const QByteArray &authorization,
+                             const QByteArray &target, const QMap< QByteArray, QByteArray > &parameters );
+
+      // Sends the requests the scheduler chooses while their servers are below their limits
+      void sendScheduledRequests();
+
+      // Answers requests the scheduler found obsolete without sending them
+      void cancelScheduledRequests( const std::vector< quint64 > &obsolete );
+
+      // Sends a request to the server, at low priority for prefetches
+      void fetchUpstream( const PendingRequest &request, const QByteArray &upstreamURL, const QByteArray &authorization );
+      void prefetchFinished( QNetworkReply *reply, const PendingRequest &request );
+
+      // Drops the prefetches that have not been started
+      void cancelQueuedPrefetches();
+
+      // Replaces the frames waiting to be prefetched with those the animation needs next, and starts fetching them
+      void planFrames();
+
+      // Decodes the server address from the proxied path and query, and works out what is being requested
+      // and the key it is stored under. parameters receives the query's parameters, with upper case names.
+      static bool decodeRequest( const QByteArray &target, QByteArray &upstreamURL, RequestType &type, QByteArray &key,
+                                 QMap< QByteArray, QByteArray > &parameters );
+
+      // Replaces the server addresses in a capabilities document with proxied addresses
+      QByteArray rewriteCapabilities( const QByteArray &document ) const;
+
+      // Calculates when a response expires from its caching headers. Returns false if the
+      // response must not be stored. The store is shared, so responses marked private are not
+      // stored, nor are responses to requests sent with credentials unless they are marked public.
+      static bool responseExpiry( QNetworkReply *reply, bool authorized, qint64 &expiry );
+
+      // Writes a response to the data layer. extraHeaders holds any further complete header lines.
+      void sendResponse( QTcpSocket *socket, int status, const QByteArray &reason, const QByteArray &contentType,
+                         const QByteArray &body, const QByteArray &extraHeaders = QByteArray() );
+      void sendStored( const PendingRequest &request, const WMTSTileStore::Entry &entry, const QByteArray &data );
+
+      void recordTileResult( TileResult result );
+
+      WMTSTileStore m_store;
+      QNetworkAccessManager *m_network;
+
+      // The Authorization header sent to each server, keyed by origin
+      std::map< QByteArray, QByteArray > m_credentials;
+
+      // Periodically writes the store's index, so little is lost if the application does not exit normally
+      QTimer *m_saveTimer;
+
+      // Data received on each connection that does not yet form a complete request
+      std::map< QTcpSocket*, QByteArray > m_received;
+
+      std::map< QNetworkReply*, PendingRequest > m_pendingRequests;
+
+      // Requests made for the data layer that the server has not answered yet, including those waiting to be sent
+      int m_foregroundRequests;
+
+      WMTSRequestScheduler m_scheduler;
+      std::map< quint64, ScheduledRequest > m_scheduledRequests;
+      quint64 m_nextRequestID;
+
+      WMTSTilePrefetcher m_prefetcher;
+
+      // Started by each tile the data layer asks for, so the view is settled when it times out
+      QTimer *m_viewTimer;
+      bool m_viewSettled;
+
+      WMSFrameCache m_frames;
+
+      // Tiles and frames waiting to be prefetched, and the prefetches under way by key
+      std::deque< Prefetch > m_prefetchQueue;
+      std::map< QByteArray, QNetworkReply* > m_prefetchReplies;
+
+      // Bytes per second that may be prefetched, and the bytes that may be prefetched now. The
+      // allowance grows with time up to one second's budget, and retries wait on the budget timer.
+      qint64 m_prefetchBudget;
+      double m_prefetchAllowance;
+      QElapsedTimer m_allowanceClock;
+      qint64 m_lastAllowanceUpdate;
+      QTimer *m_budgetTimer;
+
+      mutable QMutex m_statisticsMutex;
+      OGCServiceProxy::Statistics m_statistics;
+  };
+
+  inline bool OGCServiceProxy::isRunning() const
+  {
+    return m_port != 0;
+  }
+};
+#endif
@@ -27,6 +27,11 @@ namespace Services
       , m_muShiftY( 0.0 )
       , m_tmcPerMU( 0.0 )
       , m_useFixedTransformParameters( false )
+      , m_loader( NULL )
+      , m_loadCallback( NULL )
+      , m_loadCallbackArg( NULL )
+      , m_allLoadedCallback( NULL )
+      , m_allLoadedCallbackArg( NULL )
       , m_loadCancelled( false )
   {
   }
@@ -73,6 +78,22 @@ namespace Services
     }
   }
 
+  void Service::setLoader( TSLFileLoader *loader, TSLLoaderAppCallback loadCallback, void *loadCallbackArg,
+                           TSLAllLoadedCallback allLoadedCallback, void *allLoadedCallbackArg )
+  {
+    m_loader = loader;
+    m_loadCallback = loadCallback;
+    m_loadCallbackArg = loadCallbackArg;
+    m_allLoadedCallback = allLoadedCallback;
+    m_allLoadedCallbackArg = allLoadedCallbackArg;
+
+    dataLayer()->addLoader( loader, loadCallback, loadCallbackArg, allLoadedCallback, allLoadedCallbackArg );
+  }
+
+  void Service::addedToView()
+  {
+  }
+
   void Service::setDrawingSurfaceName( const char *name )
   {
     m_drawingSurfaceName = name;
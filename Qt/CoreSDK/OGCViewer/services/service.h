@@ -17,8 +17,11 @@
 #include "tgmapidll.h"
 #include "tslsimplestring.h"
 #include "tslatomic.h"
+#include "tslloaderappcallback.h"
+#include "tslallloadedcallback.h"
 
 class TSLDataLayer;
+class TSLFileLoader;
 class TSLDrawingSurface;
 class QAbstractItemView;
 
@@ -219,6 +222,15 @@ namespace Services
       // so that the two data layers will appear correctly aligned in the view.
       void useTransformParametersFromLayer( TSLDataLayer *coordinateProvidingLayer );
 
+      // Makes this service's data layer load through the given loader, which is shared with other services.
+      // Any data layers the service creates later to display the same service use the loader too.
+      void setLoader( TSLFileLoader *loader, TSLLoaderAppCallback loadCallback, void *loadCallbackArg,
+                      TSLAllLoadedCallback allLoadedCallback, void *allLoadedCallbackArg );
+
+      // Called by the service list once the data layer of the service has been added to the drawing surface.
+      // The default implementation does nothing.
+      virtual void addedToView();
+
       // Returns service-specific adapters for mapping information about the service to the UI.
       virtual ServiceLayerModel* getServiceLayerModel() = 0;
       virtual ServiceLayerInfoModel* getServiceLayerInfoModel() = 0;
@@ -291,6 +303,13 @@ namespace Services
       double m_tmcPerMU;
       bool m_useFixedTransformParameters;
 
+      // The loader shared between services and the callbacks it reports progress to
+      TSLFileLoader *m_loader;
+      TSLLoaderAppCallback m_loadCallback;
+      void *m_loadCallbackArg;
+      TSLAllLoadedCallback m_allLoadedCallback;
+      void *m_allLoadedCallbackArg;
+
       // Use Qt threading primitives so this code will compile with compilers that do not support
       // C++11 threads.
       QMutex m_mutex;
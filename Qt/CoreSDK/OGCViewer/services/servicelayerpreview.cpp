@@ -8,6 +8,17 @@
 namespace Services
 {
   static const char *g_loadMessageLayerName = "messageLayer";
+  static const char *g_previewLayerName = "preview";
+
+  // Default time a preview request waits for a later one, long enough to cover key repeat in the layer tree
+  static const int g_defaultDebouncePeriod = 150;
+
+  ServiceLayerPreview::Statistics::Statistics()
+    : m_requested( 0 )
+    , m_shown( 0 )
+    , m_dataLayersCreated( 0 )
+  {
+  }
 
   ServiceLayerPreview::ServiceLayerPreview( const std::string &serviceURL )
     : m_surfaceWidget( NULL )
@@ -16,8 +27,13 @@ namespace Services
       , m_loadFailed( false )
       , m_customLayer( new TSLCustomDataLayer() )
       , m_messageLayer( new PreviewLoadingLayer() )
+      , m_settingsComplete( false )
   {
     m_customLayer->setClientCustomDataLayer( m_messageLayer );
+
+    m_debounceTimer.setSingleShot( true );
+    m_debounceTimer.setInterval( g_defaultDebouncePeriod );
+    connect( &m_debounceTimer, SIGNAL(timeout()), this, SLOT(showPendingPreview()) );
   }
 
   ServiceLayerPreview::~ServiceLayerPreview()
@@ -37,6 +53,46 @@ namespace Services
     m_surfaceWidget->drawingSurface()->setDataLayerProps( g_loadMessageLayerName, TSLPropertyVisible, 0 );
   }
 
+  void ServiceLayerPreview::showLayerPreview( const QModelIndex &layerIndex, const char *styleName )
+  {
+    ++m_statistics.m_requested;
+    if( !layerIndex.isValid() )
+    {
+      return;
+    }
+
+    // Replace any request that has not been loaded yet
+    m_pendingLayer = layerIndex;
+    m_pendingStyle = styleName ? styleName : "";
+    m_debounceTimer.start();
+  }
+
+  void ServiceLayerPreview::setDebouncePeriod( int period )
+  {
+    m_debounceTimer.setInterval( period );
+  }
+
+  void ServiceLayerPreview::showPendingPreview()
+  {
+    if( !m_pendingLayer.isValid() )
+    {
+      // The layer tree has been cleared since the preview was asked for
+      return;
+    }
+
+    ++m_statistics.m_shown;
+    loadLayerPreview( m_pendingLayer, m_pendingStyle.c_str() );
+  }
+
+  void ServiceLayerPreview::discardDataLayer( TSLDataLayer *layer )
+  {
+    m_surfaceWidget->drawingSurface()->removeDataLayer( g_previewLayerName );
+
+    // Delete the layer in another thread to avoid blocking the UI
+    DeletionThread *deleter = new DeletionThread( layer );
+    deleter->start();
+  }
+
   void ServiceLayerPreview::showLoadMessageLayer()
   {
     m_messageLayer->setLoadFailStatus( false );
@@ -62,6 +118,7 @@ namespace Services
     ServiceLayerPreview *preview = reinterpret_cast< ServiceLayerPreview* >( arg );
     preview->m_surfaceWidget->drawingSurface()->setDataLayerProps( g_loadMessageLayerName, TSLPropertyVisible, 0 );
     emit preview->m_surfaceWidget->signalRefreshView();
+    emit preview->previewLoaded();
   }
 
   ServiceLayerPreview::DeletionThread::DeletionThread( TSLDataLayer *layer )
@@ -5,8 +5,12 @@
 #ifndef SERVICELAYERPREVIEW_H
 #define SERVICELAYERPREVIEW_H
 
+#include <atomic>
 #include <string>
+#include <QObject>
+#include <QPersistentModelIndex>
 #include <QThread>
+#include <QTimer>
 
 #include "MapLink.h"
 #include "MapLinkDrawing.h"
@@ -17,27 +21,67 @@ class TSLDataLayer;
 
 // Abstract class for use by the SelectLayersPage in order to hide implementation details
 // for showing the appearance of a WMS or WMTS layer in the layer preview pane.
+//
+// Requests for previews are held for a short time before being acted on, so that moving quickly
+// through the layer tree only loads the layer the user stops on. Once a preview's data layer has
+// loaded the service's capabilities it is kept, and later previews change which of its layers is
+// visible rather than creating a new data layer and loading the capabilities again.
 namespace Services
 {
-  class ServiceLayerPreview
+  class ServiceLayerPreview : public QObject
   {
+    Q_OBJECT
     public:
+      // Counts of the work done for previews, used by the preview benchmark
+      struct Statistics
+      {
+        Statistics();
+
+        // Calls to showLayerPreview
+        int m_requested;
+
+        // Previews loaded, after requests replaced by later ones were dropped
+        int m_shown;
+
+        // Previews that needed a new data layer, which loads the capabilities again
+        int m_dataLayersCreated;
+      };
+
       ServiceLayerPreview( const std::string &serviceURL );
       virtual ~ServiceLayerPreview();
 
       void setSurfaceWidget( DrawingSurfaceWidget *previewWidget );
       void cancelLoad();
 
-      // Tells the preview helper to show a preview for the given layer using the named style
-      virtual void showLayerPreview( const QModelIndex &layerIndex, const char *styleName ) = 0;
+      // Tells the preview helper to show a preview for the given layer using the named style. The
+      // preview is loaded once no other preview has been asked for within the debounce period.
+      void showLayerPreview( const QModelIndex &layerIndex, const char *styleName );
+
+      // Sets the time in milliseconds a preview request waits for a later one before being loaded
+      void setDebouncePeriod( int period );
+
+      const Statistics& statistics() const;
 
       // File loader callbacks
       static TSLLoaderCallbackReturn loadCallback( void* arg, const char* filename, TSLEnvelope extent, TSLLoaderStatus status, int percentDone );
       static void allLoadedCallback( void *arg );
 
+    signals:
+      // Emitted from the loading thread once all of a preview's requests have completed
+      void previewLoaded();
+
+    private slots:
+      void showPendingPreview();
+
     protected:
+      // Loads the preview for the given layer, reusing the existing data layer if possible
+      virtual void loadLayerPreview( const QModelIndex &layerIndex, const char *styleName ) = 0;
+
       void showLoadMessageLayer();
 
+      // Removes the data layer from the preview surface and deletes it without blocking
+      void discardDataLayer( TSLDataLayer *layer );
+
       // Utility class to move data layer deletion to another thread. This avoids blocking
       // the UI thread when changing between layers faster than the preview can update
       // as deleting the preview data layer will block the calling thread until background tasks
@@ -83,11 +127,27 @@ namespace Services
 
       TSLCustomDataLayer *m_customLayer;
       PreviewLoadingLayer *m_messageLayer;
+
+      // Set from the loading thread once the data layer's service settings are complete, after
+      // which its layers' visibility can be changed to show other previews. Read by the GUI thread.
+      std::atomic< bool > m_settingsComplete;
+
+      Statistics m_statistics;
+
+    private:
+      QTimer m_debounceTimer;
+      QPersistentModelIndex m_pendingLayer;
+      std::string m_pendingStyle;
   };
 
   inline void ServiceLayerPreview::cancelLoad()
   {
     m_loadCancelled = true;
   }
+
+  inline const ServiceLayerPreview::Statistics& ServiceLayerPreview::statistics() const
+  {
+    return m_statistics;
+  }
 };
 #endif
@@ -5,32 +5,93 @@
 #include "ui/drawingsurfacewidget.h"
 
 #include "servicelistmodel.h"
+#include "wms/wmsanimation.h"
+#include "wms/wmsservice.h"
+#include "ogcserviceproxy.h"
 
 #include "servicelist.h"
 
 #include "MapLink.h"
 #include "MapLinkDrawing.h"
 
+#include <QSettings>
+#include <QStandardPaths>
+
 namespace Services
 {
   static uint32_t g_dataLayerCounter = 0;
 
+  // Default maximum size of the WMTS tile store in MB
+  static const int g_defaultTileStoreSize = 512;
+
+  // Default number of tiles prefetched around the view, and the default prefetch budget in KB per second
+  static const int g_defaultTilePrefetchRing = 1;
+  static const int g_defaultTilePrefetchBudget = 512;
+
+  // Default number of WMTS requests sent to each server at once
+  static const int g_defaultConnectionsPerServer = 4;
+
+  // Default frames per second of an animation, frames fetched ahead of the one shown, and MB of frames held
+  static const double g_defaultAnimationFrameRate = 5.0;
+  static const int g_defaultAnimationFramesAhead = 10;
+  static const int g_defaultAnimationFrameCacheSize = 256;
+
+  // Reads the limits for particular servers from the application's settings
+  static QVariantMap serverConnections()
+  {
+    QSettings settings;
+    settings.beginGroup( "network/serverconnections" );
+
+    QVariantMap limits;
+    QStringList hosts( settings.childKeys() );
+    for( int i = 0; i < hosts.size(); ++i )
+    {
+      limits[hosts[i]] = settings.value( hosts[i] ).toInt();
+    }
+    return limits;
+  }
+
   ServiceList::ServiceList()
     : m_serviceListModel( new ServiceListModel( this ) )
       , m_surfaceWidget( NULL )
       , m_commonLoader( new TSLFileLoaderRemote( 8 ) ) // Default to 8 simultaneous connections
       , m_credentialsCallback( NULL )
       , m_serviceCacheSize( 128 ) // Default cache size is 128Mb
+      , m_serviceProxy( NULL )
+      , m_tileStoreSize( QSettings().value( "tilestore/size", g_defaultTileStoreSize ).toInt() )
+      , m_tilePrefetchRing( QSettings().value( "tilestore/prefetchring", g_defaultTilePrefetchRing ).toInt() )
+      , m_tilePrefetchBudget( QSettings().value( "tilestore/prefetchbudget", g_defaultTilePrefetchBudget ).toInt() )
+      , m_connectionsPerServer( QSettings().value( "network/connectionsperserver", g_defaultConnectionsPerServer ).toInt() )
+      , m_animation( NULL )
+      , m_animationFrameRate( QSettings().value( "animation/framerate", g_defaultAnimationFrameRate ).toDouble() )
+      , m_animationFramesAhead( QSettings().value( "animation/framesahead", g_defaultAnimationFramesAhead ).toInt() )
+      , m_animationFrameCacheSize( QSettings().value( "animation/framecachesize", g_defaultAnimationFrameCacheSize ).toInt() )
       , m_loadCallbackForward( NULL )
       , m_loadCallbackArg( NULL )
       , m_allLoadedCallbackForward( NULL )
       , m_allLoadedCallbackArg( NULL )
   {
     m_commonLoader->remoteAuthenticationCallback( (TSLRemoteAuthenticationCallback*)this );
+
+    QString tileStoreDirectory = QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + "/wmtstiles";
+    m_serviceProxy = new OGCServiceProxy( tileStoreDirectory, (qint64)m_tileStoreSize * 1024 * 1024 );
+    if( !m_serviceProxy->isRunning() )
+    {
+      delete m_serviceProxy;
+      m_serviceProxy = NULL;
+    }
+    else
+    {
+      m_serviceProxy->setPrefetch( m_tilePrefetchRing, (qint64)m_tilePrefetchBudget * 1024 );
+      m_serviceProxy->setHostLimits( m_connectionsPerServer, serverConnections() );
+      m_serviceProxy->setFrameCacheSize( (qint64)m_animationFrameCacheSize * 1024 * 1024 );
+    }
   }
 
   ServiceList::~ServiceList()
   {
+    stopAnimation();
+
     // Clean up all services that were created
     std::vector< Service* >::iterator servicesIt( m_connectedServices.begin() );
     std::vector< Service* >::iterator servicesItE( m_connectedServices.end() );
@@ -44,6 +105,9 @@ namespace Services
       m_commonLoader->destroy();
     }
 
+    // The store's index is written as the proxy stops
+    delete m_serviceProxy;
+
     delete m_serviceListModel;
   }
 
@@ -67,6 +131,7 @@ namespace Services
       surface->addDataLayer( newService->dataLayer(), layerIdentifier );
       newService->setDrawingSurfaceName( layerIdentifier );
       surface->reset( false );
+      newService->addedToView();
 
       // Request a redraw
       emit m_surfaceWidget->signalRefreshView();
@@ -79,6 +144,11 @@ namespace Services
     std::vector< Service* >::iterator serviceEntry( find( m_connectedServices.begin(), m_connectedServices.end(), removedService ) );
     if( serviceEntry != m_connectedServices.end() )
     {
+      if( m_animation && m_animation->service() == removedService )
+      {
+        stopAnimation();
+      }
+
       m_connectedServices.erase( serviceEntry );
       delete removedService;
 
@@ -146,6 +216,48 @@ namespace Services
     }
   }
 
+  void ServiceList::serviceLayersChanged( Service *service )
+  {
+    if( m_surfaceWidget && m_surfaceWidget->drawingSurface() )
+    {
+      TSLDrawingSurface *surface = m_surfaceWidget->drawingSurface();
+
+      // Find where the service is currently drawn
+      const char *serviceLayerName = service->drawingSurfaceName().c_str();
+      int numDataLayers = surface->getNumDataLayers();
+      for( int i = 0; i < numDataLayers; ++i )
+      {
+        TSLDataLayer *currentLayer = NULL;
+        const char *currentLayerName = NULL;
+        if( !surface->getDataLayerInfo( i, &currentLayer, &currentLayerName ) || strcmp( currentLayerName, serviceLayerName ) != 0 )
+        {
+          continue;
+        }
+
+        if( currentLayer != service->dataLayer() )
+        {
+          TSLPropertyValue transparencyValue = 255;
+          surface->getDataLayerProps( serviceLayerName, TSLPropertyTransparency, &transparencyValue );
+
+          // The replacement is added on top of the other layers, so move it back behind the layer that
+          // was in front of the one it replaces
+          surface->removeDataLayer( serviceLayerName );
+          surface->addDataLayer( service->dataLayer(), serviceLayerName );
+          TSLDataLayer *targetLayer = NULL;
+          const char *targetLayerName = NULL;
+          if( i < numDataLayers - 1 && surface->getDataLayerInfo( i, &targetLayer, &targetLayerName ) )
+          {
+            surface->sendToBackOf( serviceLayerName, targetLayerName );
+          }
+          surface->setDataLayerProps( serviceLayerName, TSLPropertyTransparency, transparencyValue );
+        }
+        break;
+      }
+    }
+
+    redrawAttachedSurface();
+  }
+
   void ServiceList::setViewedExtent( TSLTMC x1, TSLTMC y1, TSLTMC x2, TSLTMC y2 )
   {
     if( !m_surfaceWidget )
@@ -227,6 +339,100 @@ namespace Services
     return m_serviceCacheSize;
   }
 
+  void ServiceList::setTileStoreSize( int size )
+  {
+    m_tileStoreSize = size;
+    QSettings().setValue( "tilestore/size", size );
+
+    if( m_serviceProxy )
+    {
+      m_serviceProxy->setMaximumSize( (qint64)size * 1024 * 1024 );
+    }
+  }
+
+  void ServiceList::clearTileStore()
+  {
+    if( m_serviceProxy )
+    {
+      m_serviceProxy->clear();
+    }
+  }
+
+  void ServiceList::setTilePrefetch( int ring, int budget )
+  {
+    m_tilePrefetchRing = ring;
+    m_tilePrefetchBudget = budget;
+
+    QSettings settings;
+    settings.setValue( "tilestore/prefetchring", ring );
+    settings.setValue( "tilestore/prefetchbudget", budget );
+
+    if( m_serviceProxy )
+    {
+      m_serviceProxy->setPrefetch( ring, (qint64)budget * 1024 );
+    }
+  }
+
+  void ServiceList::setConnectionsPerServer( int connections )
+  {
+    m_connectionsPerServer = connections;
+    QSettings().setValue( "network/connectionsperserver", connections );
+
+    if( m_serviceProxy )
+    {
+      m_serviceProxy->setHostLimits( connections, serverConnections() );
+    }
+  }
+
+  WMSAnimation* ServiceList::startAnimation( Service *service, const char *dimensionName )
+  {
+    stopAnimation();
+    if( !service || service->type() != ServiceTypeWMS )
+    {
+      return NULL;
+    }
+
+    m_animation = new WMSAnimation( this, (WMSService*)service, dimensionName, m_animationFramesAhead );
+    if( !m_animation->isValid() )
+    {
+      stopAnimation();
+      return NULL;
+    }
+
+    m_animation->setFrameRate( m_animationFrameRate );
+    m_animation->play();
+    return m_animation;
+  }
+
+  void ServiceList::stopAnimation()
+  {
+    // The service is left showing the frame the animation stopped on
+    delete m_animation;
+    m_animation = NULL;
+  }
+
+  void ServiceList::setAnimationSettings( double frameRate, int framesAhead, int frameCacheSize )
+  {
+    m_animationFrameRate = frameRate;
+    m_animationFramesAhead = framesAhead;
+    m_animationFrameCacheSize = frameCacheSize;
+
+    QSettings settings;
+    settings.setValue( "animation/framerate", frameRate );
+    settings.setValue( "animation/framesahead", framesAhead );
+    settings.setValue( "animation/framecachesize", frameCacheSize );
+
+    if( m_animation )
+    {
+      m_animation->setFrameRate( frameRate );
+    }
+
+    if( m_serviceProxy )
+    {
+      m_serviceProxy->setFrameCacheSize( (qint64)frameCacheSize * 1024 * 1024 );
+    }
+  }
+
   void ServiceList::setLoadCallbackForwards( TSLLoaderAppCallback loadCallback, void *arg, TSLAllLoadedCallback allLoadedCallback, void *arg2 )
   {
     m_loadCallbackForward = loadCallback;
@@ -275,9 +481,19 @@ namespace Services
       m_credentialsCallback->onCredentialsRequired( username, password );
       std::string domain( url );
 
-      size_t lastDot = domain.find_last_of('.');
-      size_t firstSlash = domain.find_first_of('/', lastDot );
-      domain = domain.substr( 0, firstSlash );
+      if( m_serviceProxy && !m_serviceProxy->upstreamURL( url ).empty() )
+      {
+        // Every proxied address is on this machine, so the loader is only given the credentials for the
+        // proxied addresses of this service, and the proxy sends them on to this service's server alone
+        m_serviceProxy->setCredentials( url, username.c_str(), password.c_str() );
+        domain = m_serviceProxy->proxiedServiceURL( url );
+      }
+      else
+      {
+        size_t lastDot = domain.find_last_of('.');
+        size_t firstSlash = domain.find_first_of('/', lastDot );
+        domain = domain.substr( 0, firstSlash );
+      }
 
       loader->addCredentials( username.c_str(), password.c_str(), domain.c_str() );
     }
@@ -286,6 +502,10 @@ namespace Services
   void ServiceList::clearCachedCredentials()
   {
     m_commonLoader->clearCachedCredentials();
+    if( m_serviceProxy )
+    {
+      m_serviceProxy->clearCredentials();
+    }
   }
 
   void ServiceList::setCredentialsCallback( Service::ServiceCredentialsCallback* callback )
@@ -31,6 +31,8 @@ class TSLFileLoaderRemote;
 namespace Services
 {
   class ServiceListModel;
+  class WMSAnimation;
+  class OGCServiceProxy;
 
   class ServiceList: public TSLRemoteAuthenticationCallback
   {
@@ -61,6 +63,11 @@ namespace Services
       // This function causes a redraw to occur in the drawing thread for the attached drawing surface
       void redrawAttachedSurface();
 
+      // Called after the layers shown by a service have been changed. If the service now displays through
+      // a different data layer, that layer replaces the previous one in the attached drawing surface, keeping
+      // its position and transparency. The attached drawing surface is then redrawn.
+      void serviceLayersChanged( Service *service );
+
       // Changes the view in the attached drawing surface to cover the given extent (preserving aspect ratio)
       void setViewedExtent( TSLTMC x1, TSLTMC y1, TSLTMC x2, TSLTMC y2 );
 
@@ -76,6 +83,46 @@ namespace Services
       void setCacheSizes( int size );
       int cacheSizes() const;
 
+      // Returns the proxy that WMTS services load through to keep their tiles on disk between sessions,
+      // or NULL if the proxy could not be started
+      OGCServiceProxy* getServiceProxy();
+
+      // Sets/returns the maximum size in MB of the WMTS tile store on disk. This is kept in the application's
+      // settings. A size of 0 stops tiles being stored.
+      void setTileStoreSize( int size );
+      int tileStoreSize() const;
+
+      // Removes all tiles from the WMTS tile store
+      void clearTileStore();
+
+      // Sets/returns the number of tiles around the view that are fetched into the WMTS tile store ahead
+      // of being shown, 0 to disable prefetching, and the most KB per second to prefetch, 0 for no limit.
+      // These are kept in the application's settings.
+      void setTilePrefetch( int ring, int budget );
+      int tilePrefetchRing() const;
+      int tilePrefetchBudget() const;
+
+      // Sets/returns the most WMTS requests sent to each server at once. Requests beyond this wait in the
+      // service proxy, which sends those most useful to the current view first. Limits for particular servers
+      // can be given in the application's settings under network/serverconnections, keyed by host name.
+      void setConnectionsPerServer( int connections );
+      int connectionsPerServer() const;
+
+      // Starts animating a dimension of a WMS service's visible layers, stopping any other animation. Returns
+      // NULL if the service is not a WMS service or its visible layers do not list values for the dimension.
+      // The animation is owned by the service list.
+      WMSAnimation* startAnimation( Service *service, const char *dimensionName );
+      void stopAnimation();
+      WMSAnimation* getAnimation();
+
+      // Sets/returns the frames per second animations play at, the number of frames fetched ahead of the one
+      // shown, and the most MB of frames the service proxy holds in memory. These are kept in the application's
+      // settings. The number of frames ahead applies from the next animation started.
+      void setAnimationSettings( double frameRate, int framesAhead, int frameCacheSize );
+      double animationFrameRate() const;
+      int animationFramesAhead() const;
+      int animationFrameCacheSize() const;
+
       // Additional call forwards to make on file load callbacks in order to update the user interface
       void setLoadCallbackForwards( TSLLoaderAppCallback loadCallback, void *arg, TSLAllLoadedCallback allLoadedCallback, void *arg2 );
 
@@ -102,6 +149,19 @@ namespace Services
 
       int m_serviceCacheSize;
 
+      // Local proxy holding the WMTS tile store, shared between all WMTS services
+      OGCServiceProxy *m_serviceProxy;
+      int m_tileStoreSize;
+      int m_tilePrefetchRing;
+      int m_tilePrefetchBudget;
+      int m_connectionsPerServer;
+
+      // The animation being played, if any
+      WMSAnimation *m_animation;
+      double m_animationFrameRate;
+      int m_animationFramesAhead;
+      int m_animationFrameCacheSize;
+
       TSLLoaderAppCallback m_loadCallbackForward;
       void *m_loadCallbackArg;
       TSLAllLoadedCallback m_allLoadedCallbackForward;
@@ -119,5 +179,50 @@ namespace Services
     return m_serviceListModel;
   }
 
+  inline OGCServiceProxy* ServiceList::getServiceProxy()
+  {
+    return m_serviceProxy;
+  }
+
+  inline int ServiceList::tileStoreSize() const
+  {
+    return m_tileStoreSize;
+  }
+
+  inline int ServiceList::tilePrefetchRing() const
+  {
+    return m_tilePrefetchRing;
+  }
+
+  inline int ServiceList::tilePrefetchBudget() const
+  {
+    return m_tilePrefetchBudget;
+  }
+
+  inline int ServiceList::connectionsPerServer() const
+  {
+    return m_connectionsPerServer;
+  }
+
+  inline WMSAnimation* ServiceList::getAnimation()
+  {
+    return m_animation;
+  }
+
+  inline double ServiceList::animationFrameRate() const
+  {
+    return m_animationFrameRate;
+  }
+
+  inline int ServiceList::animationFramesAhead() const
+  {
+    return m_animationFramesAhead;
+  }
+
+  inline int ServiceList::animationFrameCacheSize() const
+  {
+    return m_animationFrameCacheSize;
+  }
+
 };
 #endif
@@ -225,7 +225,7 @@ namespace Services
       service->setLayerVisibility( layerInfo, false );
 
       // Changing the layer visibility requires any attached drawing surfaces to be redrawn
-      m_services->redrawAttachedSurface();
+      m_services->serviceLayersChanged( service );
     }
 
     // Delete the node
@@ -300,7 +300,7 @@ namespace Services
 
     endInsertRows();
     // Changing the layer visibility requires a redraw
-    m_services->redrawAttachedSurface();
+    m_services->serviceLayersChanged( service );
   }
 
   void ServiceListModel::setLayerStyle( const QVariant &nodeVariant, const QString &styleName )
@@ -321,7 +321,7 @@ namespace Services
     layerInfo->setStyle( styleName.toUtf8() );
 
     // Changing the layer style requires a redraw
-    m_services->redrawAttachedSurface();
+    m_services->serviceLayersChanged( reinterpret_cast< Service* >( node->m_parent->m_data ) );
   }
 
   Service* ServiceListModel::getService( const QVariant &nodeVariant )
@@ -697,7 +697,7 @@ namespace Services
           destinationParentNode->m_children.size() - node->m_index - 1 );
 
       // Request that the drawing surface containing the data layers is redrawn
-      m_services->redrawAttachedSurface();
+      m_services->serviceLayersChanged( service );
 
       return true;
     }
@@ -0,0 +1,125 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#include <algorithm>
+
+#include <QStringList>
+
+#include "services/servicelist.h"
+#include "services/ogcserviceproxy.h"
+
+#include "wmsanimation.h"
+#include "wmsservice.h"
+
+namespace Services
+{
+  WMSAnimation::WMSAnimation( ServiceList *services, WMSService *service, const char *dimensionName, int framesAhead, QObject *parent )
+    : QObject( parent )
+      , m_services( services )
+      , m_service( service )
+      , m_dimensionName( dimensionName )
+      , m_currentFrame( 0 )
+      , m_keepDataLayer( false )
+      , m_frameRate( 1.0 )
+  {
+    std::string currentValue;
+    m_service->getDimensionValues( dimensionName, m_values, currentValue );
+
+    // Continue from the value shown if it is one of the frames
+    std::vector< std::string >::const_iterator currentIt( std::find( m_values.begin(), m_values.end(), currentValue ) );
+    if( currentIt != m_values.end() )
+    {
+      m_currentFrame = (int)(currentIt - m_values.begin());
+    }
+
+    // Cycling through more frames than the service has data layers would replace the least recently used
+    // data layer on every frame, so each would be shown without its images and swapped into the view. The
+    // displayed data layer shows every frame instead.
+    m_keepDataLayer = m_values.size() > WMSService::maxDataLayers();
+
+    connect( &m_frameTimer, SIGNAL(timeout()), this, SLOT(nextFrame()) );
+
+    OGCServiceProxy *proxy = m_service->serviceProxy();
+    if( proxy && isValid() )
+    {
+      QStringList values;
+      for( size_t i = 0; i < m_values.size(); ++i )
+      {
+        values.append( QString::fromUtf8( m_values[i].c_str() ) );
+      }
+      proxy->setAnimation( requestParameter( dimensionName ), values, framesAhead );
+    }
+  }
+
+  WMSAnimation::~WMSAnimation()
+  {
+    // The frames held by the proxy are of no further use
+    OGCServiceProxy *proxy = m_service->serviceProxy();
+    if( proxy && isValid() )
+    {
+      proxy->setAnimation( QString(), QStringList(), 0 );
+    }
+  }
+
+  bool WMSAnimation::isValid() const
+  {
+    return m_values.size() > 1;
+  }
+
+  void WMSAnimation::setFrameRate( double framesPerSecond )
+  {
+    m_frameRate = std::max( framesPerSecond, 0.1 );
+    m_frameTimer.setInterval( (int)(1000.0 / m_frameRate) );
+  }
+
+  QString WMSAnimation::requestParameter( const char *dimensionName )
+  {
+    // WMS 1.3.0 sends time and elevation under their own names, and every other dimension prefixed with DIM_
+    QString name( QString::fromUtf8( dimensionName ).toUpper() );
+    if( name == "TIME" || name == "ELEVATION" )
+    {
+      return name;
+    }
+    return "DIM_" + name;
+  }
+
+  void WMSAnimation::play()
+  {
+    if( !isValid() )
+    {
+      return;
+    }
+
+    m_frameTimer.setInterval( (int)(1000.0 / m_frameRate) );
+    m_frameTimer.start();
+    showFrame( m_currentFrame );
+  }
+
+  void WMSAnimation::stop()
+  {
+    m_frameTimer.stop();
+  }
+
+  void WMSAnimation::showFrame( int frame )
+  {
+    if( frame < 0 || frame >= (int)m_values.size() )
+    {
+      return;
+    }
+
+    m_currentFrame = frame;
+    if( m_service->setDimensionValue( m_dimensionName.c_str(), m_values[frame].c_str(), m_keepDataLayer ) )
+    {
+      // The frame may be shown by a different data layer, which the service list swaps into the view
+      m_services->serviceLayersChanged( m_service );
+    }
+
+    emit frameChanged( frame, QString::fromUtf8( m_values[frame].c_str() ) );
+  }
+
+  void WMSAnimation::nextFrame()
+  {
+    showFrame( (m_currentFrame + 1) % (int)m_values.size() );
+  }
+};
@@ -0,0 +1,110 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#ifndef WMSANIMATION_H
+#define WMSANIMATION_H
+
+#include <string>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+// Plays a dimension of a WMS service, such as time, by stepping the visible layers through the
+// values of the dimension at a fixed frame rate.
+//
+// Each frame sets the dimension's value on the service. When there are no more frames than the
+// service has data layers, each frame is displayed through the data layer that last showed it, which
+// still holds its images. Otherwise the displayed data layer shows every frame.
+//
+// When the service is loaded through the service proxy the proxy is told about the animation, so
+// that it holds the images of each frame in memory and fetches the frames after the one shown before
+// the data layer asks for them. A frame the displayed data layer requests again is then answered
+// from memory.
+namespace Services
+{
+  class ServiceList;
+  class WMSService;
+
+  class WMSAnimation : public QObject
+  {
+    Q_OBJECT
+    public:
+      // Prepares to animate the named dimension of the service's visible layers, fetching the given
+      // number of frames ahead of the one shown
+      WMSAnimation( ServiceList *services, WMSService *service, const char *dimensionName, int framesAhead, QObject *parent = NULL );
+      virtual ~WMSAnimation();
+
+      // Returns false if the visible layers do not list at least two values for the dimension
+      bool isValid() const;
+
+      WMSService* service() const;
+      const std::string& dimensionName() const;
+      const std::vector< std::string >& values() const;
+      int currentFrame() const;
+      bool playing() const;
+
+      void setFrameRate( double framesPerSecond );
+      double frameRate() const;
+
+      // Returns the GetMap parameter a dimension is sent as
+      static QString requestParameter( const char *dimensionName );
+
+    public slots:
+      void play();
+      void stop();
+      void showFrame( int frame );
+
+    signals:
+      void frameChanged( int frame, const QString &value );
+
+    private slots:
+      void nextFrame();
+
+    private:
+      ServiceList *m_services;
+      WMSService *m_service;
+      std::string m_dimensionName;
+      std::vector< std::string > m_values;
+      int m_currentFrame;
+
+      // Whether the frames are all shown by the displayed data layer
+      bool m_keepDataLayer;
+
+      double m_frameRate;
+      QTimer m_frameTimer;
+  };
+
+  inline WMSService* WMSAnimation::service() const
+  {
+    return m_service;
+  }
+
+  inline const std::string& WMSAnimation::dimensionName() const
+  {
+    return m_dimensionName;
+  }
+
+  inline const std::vector< std::string >& WMSAnimation::values() const
+  {
+    return m_values;
+  }
+
+  inline int WMSAnimation::currentFrame() const
+  {
+    return m_currentFrame;
+  }
+
+  inline bool WMSAnimation::playing() const
+  {
+    return m_frameTimer.isActive();
+  }
+
+  inline double WMSAnimation::frameRate() const
+  {
+    return m_frameRate;
+  }
+};
+#endif
@@ -0,0 +1,257 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#include <algorithm>
+
+#include <QList>
+
+#include "wmsframecache.h"
+
+namespace Services
+{
+  // How long after the data layer's last image request a request for an image not in the view starts a new view
+  static const qint64 g_viewSettleDelay = 150;
+
+  // Default most bytes of frames held
+  static const qint64 g_defaultMaximumSize = 256 * 1024 * 1024;
+
+  WMSFrameCache::WMSFrameCache()
+    : m_maximumSize( g_defaultMaximumSize )
+    , m_size( 0 )
+    , m_framesAhead( 0 )
+    , m_shownValue( -1 )
+    , m_lastRequest( 0 )
+  {
+    m_clock.start();
+  }
+
+  void WMSFrameCache::setMaximumSize( qint64 maximumSize )
+  {
+    m_maximumSize = std::max( maximumSize, (qint64)0 );
+    evict( m_maximumSize );
+  }
+
+  void WMSFrameCache::setAnimation( const QByteArray &parameter, const std::vector< QByteArray > &values, int framesAhead )
+  {
+    if( parameter != m_parameter || values != m_values )
+    {
+      // The frames held belong to another animation
+      m_responses.clear();
+      m_recentUse.clear();
+      m_size = 0;
+      m_view.clear();
+      m_shownValue = -1;
+    }
+
+    m_parameter = parameter;
+    m_values = values;
+    m_framesAhead = std::max( framesAhead, 0 );
+  }
+
+  bool WMSFrameCache::find( const QByteArray &key, QByteArray &contentType, QByteArray &data )
+  {
+    std::map< QByteArray, Response >::iterator response = m_responses.find( key );
+    if( response == m_responses.end() )
+    {
+      return false;
+    }
+
+    m_recentUse.splice( m_recentUse.begin(), m_recentUse, response->second.m_recentUse );
+    contentType = response->second.m_contentType;
+    data = response->second.m_data;
+    return true;
+  }
+
+  bool WMSFrameCache::contains( const QByteArray &key ) const
+  {
+    return m_responses.find( key ) != m_responses.end();
+  }
+
+  void WMSFrameCache::store( const QByteArray &key, const QByteArray &contentType, const QByteArray &data )
+  {
+    if( data.size() > m_maximumSize )
+    {
+      return;
+    }
+
+    std::map< QByteArray, Response >::iterator existing = m_responses.find( key );
+    if( existing != m_responses.end() )
+    {
+      m_size -= existing->second.m_data.size();
+      m_recentUse.erase( existing->second.m_recentUse );
+      m_responses.erase( existing );
+    }
+
+    evict( m_maximumSize - data.size() );
+
+    m_recentUse.push_front( key );
+    Response &response = m_responses[key];
+    response.m_contentType = contentType;
+    response.m_data = data;
+    response.m_recentUse = m_recentUse.begin();
+    m_size += data.size();
+  }
+
+  void WMSFrameCache::evict( qint64 maximumSize )
+  {
+    while( m_size > maximumSize && !m_recentUse.empty() )
+    {
+      std::map< QByteArray, Response >::iterator oldest = m_responses.find( m_recentUse.back() );
+      m_size -= oldest->second.m_data.size();
+      m_responses.erase( oldest );
+      m_recentUse.pop_back();
+    }
+  }
+
+  void WMSFrameCache::mapRequested( const QByteArray &target, const QByteArray &address, const QMap< QByteArray, QByteArray > &parameters,
+                                    const QByteArray &authorization )
+  {
+    if( m_values.empty() )
+    {
+      return;
+    }
+
+    QMap< QByteArray, QByteArray > viewParameters( parameters );
+    QByteArray value = viewParameters.take( m_parameter );
+    std::vector< QByteArray >::const_iterator valueIt = std::find( m_values.begin(), m_values.end(), value );
+    int valueIndex = valueIt != m_values.end() ? (int)(valueIt - m_values.begin()) : -1;
+
+    // The view changes when an image not in it is asked for after the data layer has been idle. While the
+    // animation plays the data layer is never idle for long, but the images of an old view are not asked
+    // for with the new value, so are dropped as the frames move on.
+    QByteArray viewKey = requestKey( address, viewParameters );
+    qint64 now = m_clock.elapsed();
+    if( now - m_lastRequest > g_viewSettleDelay && m_view.find( viewKey ) == m_view.end() )
+    {
+      m_view.clear();
+    }
+    m_lastRequest = now;
+
+    if( valueIndex >= 0 && valueIndex != m_shownValue )
+    {
+      // Keep the images asked for with the value shown before, as they will be asked for again with this one
+      std::map< QByteArray, ViewedMap >::iterator it( m_view.begin() );
+      std::map< QByteArray, ViewedMap >::iterator itE( m_view.end() );
+      while( it != itE )
+      {
+        if( it->second.m_valueIndex != m_shownValue && it->second.m_valueIndex != valueIndex )
+        {
+          m_view.erase( it++ );
+        }
+        else
+        {
+          ++it;
+        }
+      }
+      m_shownValue = valueIndex;
+    }
+
+    ViewedMap &viewed = m_view[viewKey];
+    viewed.m_target = target;
+    viewed.m_address = address;
+    viewed.m_parameters = parameters;
+    viewed.m_authorization = authorization;
+    viewed.m_valueIndex = valueIndex;
+  }
+
+  void WMSFrameCache::plan( std::vector< Frame > &frames ) const
+  {
+    if( m_values.size() < 2 || m_shownValue < 0 || m_framesAhead <= 0 || m_view.empty() )
+    {
+      return;
+    }
+
+    // Leave room for the frame shown as well as those ahead of it. Until an image has been held the
+    // size of a frame is not known, so the number asked for is planned.
+    int numFrames = std::min( m_framesAhead, (int)m_values.size() - 1 );
+    if( !m_responses.empty() )
+    {
+      qint64 frameSize = (m_size / (qint64)m_responses.size()) * (qint64)m_view.size();
+      if( frameSize > 0 )
+      {
+        numFrames = std::min( numFrames, (int)(m_maximumSize / frameSize) - 1 );
+      }
+    }
+
+    for( int frame = 1; frame <= numFrames; ++frame )
+    {
+      const QByteArray &value = m_values[ (m_shownValue + frame) % m_values.size() ];
+
+      std::map< QByteArray, ViewedMap >::const_iterator it( m_view.begin() );
+      std::map< QByteArray, ViewedMap >::const_iterator itE( m_view.end() );
+      for( ; it != itE; ++it )
+      {
+        QMap< QByteArray, QByteArray > frameParameters( it->second.m_parameters );
+        frameParameters[m_parameter] = value;
+        if( contains( requestKey( it->second.m_address, frameParameters ) ) )
+        {
+          continue;
+        }
+
+        Frame request;
+        request.m_target = frameTarget( it->second.m_target, m_parameter, value );
+        request.m_authorization = it->second.m_authorization;
+        frames.push_back( request );
+      }
+    }
+  }
+
+  QByteArray WMSFrameCache::requestKey( const QByteArray &address, const QMap< QByteArray, QByteArray > &parameters )
+  {
+    // QMap keeps the parameters in order of name
+    QByteArray key = "map\n" + address;
+    QMap< QByteArray, QByteArray >::const_iterator it( parameters.constBegin() );
+    QMap< QByteArray, QByteArray >::const_iterator itE( parameters.constEnd() );
+    for( ; it != itE; ++it )
+    {
+      key += "\n" + it.key() + "=" + it.value();
+    }
+    return key;
+  }
+
+  bool WMSFrameCache::isRequestKey( const QByteArray &key )
+  {
+    return key.startsWith( "map\n" );
+  }
+
+  QByteArray WMSFrameCache::frameTarget( const QByteArray &target, const QByteArray &parameter, const QByteArray &value )
+  {
+    int queryStart = target.indexOf( '?' );
+    if( queryStart < 0 )
+    {
+      return target + "?" + parameter + "=" + value.toPercentEncoding();
+    }
+
+    // Replace the parameter's value, leaving the other parameters as the data layer sent them
+    QList< QByteArray > queryItems = target.mid( queryStart + 1 ).split( '&' );
+    bool replaced = false;
+    for( int i = 0; i < queryItems.size(); ++i )
+    {
+      int separator = queryItems[i].indexOf( '=' );
+      QByteArray name = queryItems[i].left( separator );
+      if( QByteArray::fromPercentEncoding( name ).toUpper() == parameter )
+      {
+        queryItems[i] = name + "=" + value.toPercentEncoding();
+        replaced = true;
+      }
+    }
+
+    // The data layer leaves out the parameter when the layer's default value is shown
+    if( !replaced )
+    {
+      queryItems.append( parameter + "=" + value.toPercentEncoding() );
+    }
+
+    QByteArray result = target.left( queryStart + 1 );
+    for( int i = 0; i < queryItems.size(); ++i )
+    {
+      if( i > 0 )
+      {
+        result += "&";
+      }
+      result += queryItems[i];
+    }
+    return result;
+  }
+};
@@ -0,0 +1,142 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#ifndef WMSFRAMECACHE_H
+#define WMSFRAMECACHE_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMap>
+
+// Holds the images of an animated WMS service in memory, so that each frame of the animation can
+// be shown without waiting for the server, and works out which frames the service proxy should fetch
+// ahead of the data layer.
+//
+// An animation steps one GetMap parameter, such as TIME, through a list of values. The data layer
+// asks for the images of a view together, and asks for them again with the next value each time
+// the animation steps. The cache records the requests made for the view, and plans the same
+// requests with each of the values that follow the one shown, the next frame first, so that frames
+// are fetched in the order they will be needed.
+//
+// Responses are held until the cache reaches its maximum size, when the least recently used are
+// dropped. The frames planned ahead are limited both by the number asked for and by the number of
+// frames of the view the maximum size can hold, so that prefetching does not push out the frames
+// about to be shown.
+//
+// The cache is not thread safe; it is only used from the service proxy's thread.
+
+namespace Services
+{
+  class WMSFrameCache
+  {
+    public:
+      // A request for a frame planned ahead
+      struct Frame
+      {
+        // The proxied path and query for the frame, as the data layer would have requested it
+        QByteArray m_target;
+        QByteArray m_authorization;
+      };
+
+      WMSFrameCache();
+
+      // Sets the most bytes held. 0 stops responses being held.
+      void setMaximumSize( qint64 maximumSize );
+      qint64 maximumSize() const;
+      qint64 size() const;
+
+      // Sets the GetMap parameter being animated, with its name in upper case, the values it steps
+      // through and the number of frames after the one shown to fetch ahead. No values ends the
+      // animation, which drops the responses held.
+      void setAnimation( const QByteArray &parameter, const std::vector< QByteArray > &values, int framesAhead );
+      bool animating() const;
+
+      // Returns a held response, making it the most recently used
+      bool find( const QByteArray &key, QByteArray &contentType, QByteArray &data );
+      bool contains( const QByteArray &key ) const;
+
+      // Holds a response, dropping the least recently used to keep within the maximum size
+      void store( const QByteArray &key, const QByteArray &contentType, const QByteArray &data );
+
+      // Records a GetMap request made by the data layer. Parameter names must be in upper case.
+      void mapRequested( const QByteArray &target, const QByteArray &address, const QMap< QByteArray, QByteArray > &parameters,
+                         const QByteArray &authorization );
+
+      // Lists the requests for the frames after the one shown that are not held, next frame first
+      void plan( std::vector< Frame > &frames ) const;
+
+      // Builds the key a GetMap response is held under from the server address and the request's parameters.
+      // This does not depend on the order or encoding of the parameters, which may differ between the
+      // data layer's requests and those planned here.
+      static QByteArray requestKey( const QByteArray &address, const QMap< QByteArray, QByteArray > &parameters );
+
+      // Returns whether a key was built by requestKey, as the service proxy keeps other responses under keys of its own
+      static bool isRequestKey( const QByteArray &key );
+
+      // Builds the target for the same request with another value of a parameter
+      static QByteArray frameTarget( const QByteArray &target, const QByteArray &parameter, const QByteArray &value );
+
+    private:
+      struct Response
+      {
+        QByteArray m_contentType;
+        QByteArray m_data;
+        std::list< QByteArray >::iterator m_recentUse;
+      };
+
+      // A request made for the view, which is repeated with each value of the animated parameter
+      struct ViewedMap
+      {
+        QByteArray m_target;
+        QByteArray m_address;
+        QMap< QByteArray, QByteArray > m_parameters;
+        QByteArray m_authorization;
+
+        // The index of the value the request was last made with, or -1 if it is not one of the animated values
+        int m_valueIndex;
+      };
+
+      void evict( qint64 maximumSize );
+
+      qint64 m_maximumSize;
+      qint64 m_size;
+
+      // Held responses by key, and their keys from the most to the least recently used
+      std::map< QByteArray, Response > m_responses;
+      std::list< QByteArray > m_recentUse;
+
+      QByteArray m_parameter;
+      std::vector< QByteArray > m_values;
+      int m_framesAhead;
+
+      // The requests made for the view, keyed by everything in the request except the animated parameter,
+      // and the index of the value shown most recently
+      std::map< QByteArray, ViewedMap > m_view;
+      int m_shownValue;
+
+      // When the data layer last asked for an image, so a request that follows a pause belongs to a new view
+      QElapsedTimer m_clock;
+      qint64 m_lastRequest;
+  };
+
+  inline qint64 WMSFrameCache::maximumSize() const
+  {
+    return m_maximumSize;
+  }
+
+  inline qint64 WMSFrameCache::size() const
+  {
+    return m_size;
+  }
+
+  inline bool WMSFrameCache::animating() const
+  {
+    return !m_values.empty();
+  }
+};
+#endif
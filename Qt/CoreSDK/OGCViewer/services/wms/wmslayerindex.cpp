@@ -0,0 +1,86 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#include "wmslayerindex.h"
+
+#include "MapLink.h"
+#include "tsltmsapi.h"
+
+namespace Services
+{
+  static const char* stringOrEmpty( const char *value )
+  {
+    return value ? value : "";
+  }
+
+  WMSLayerIndex::WMSLayerIndex()
+    : m_rootLayer( NULL )
+  {
+  }
+
+  void WMSLayerIndex::build( TSLWMSServiceLayer *rootLayer )
+  {
+    m_rootLayer = rootLayer;
+    m_layers.clear();
+    m_positions.clear();
+    m_byNameOrTitle.clear();
+    m_byNameAndTitle.clear();
+
+    if( rootLayer )
+    {
+      addLayer( rootLayer );
+    }
+  }
+
+  void WMSLayerIndex::addLayer( TSLWMSServiceLayer *layer )
+  {
+    size_t position = m_layers.size();
+    m_layers.push_back( layer );
+
+    // Layers earlier in the tree take precedence, so existing entries are not replaced
+    if( layer->title() )
+    {
+      m_byNameOrTitle.insert( std::make_pair( std::string( layer->title() ), layer ) );
+    }
+    if( layer->name() )
+    {
+      m_byNameOrTitle.insert( std::make_pair( std::string( layer->name() ), layer ) );
+    }
+    m_byNameAndTitle.insert( std::make_pair( std::make_pair( std::string( stringOrEmpty( layer->name() ) ),
+                                                             std::string( stringOrEmpty( layer->title() ) ) ), layer ) );
+
+    int numChildLayers = layer->noOfSubLayers();
+    for( int i = 0; i < numChildLayers; ++i )
+    {
+      addLayer( layer->getSubLayerAt(i) );
+    }
+
+    m_positions[layer] = std::make_pair( position, m_layers.size() );
+  }
+
+  TSLWMSServiceLayer* WMSLayerIndex::findLayer( const char *name ) const
+  {
+    std::map< std::string, TSLWMSServiceLayer* >::const_iterator layerIt( m_byNameOrTitle.find( name ) );
+    return layerIt != m_byNameOrTitle.end() ? layerIt->second : NULL;
+  }
+
+  TSLWMSServiceLayer* WMSLayerIndex::findLayer( const std::string &name, const std::string &title ) const
+  {
+    std::map< std::pair< std::string, std::string >, TSLWMSServiceLayer* >::const_iterator layerIt( m_byNameAndTitle.find( std::make_pair( name, title ) ) );
+    return layerIt != m_byNameAndTitle.end() ? layerIt->second : NULL;
+  }
+
+  bool WMSLayerIndex::subtree( const TSLWMSServiceLayer *layer, size_t &begin, size_t &end ) const
+  {
+    std::map< const TSLWMSServiceLayer*, std::pair< size_t, size_t > >::const_iterator positionIt( m_positions.find( layer ) );
+    if( positionIt == m_positions.end() )
+    {
+      return false;
+    }
+
+    begin = positionIt->second.first;
+    end = positionIt->second.second;
+    return true;
+  }
+};
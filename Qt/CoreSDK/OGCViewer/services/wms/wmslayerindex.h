@@ -0,0 +1,72 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#ifndef WMSLAYERINDEX_H
+#define WMSLAYERINDEX_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class TSLWMSServiceLayer;
+
+// An index of the layers in one data layer's copy of a WMS layer tree, so that layers can be
+// found by name without walking the tree. Catalogue servers can publish thousands of layers,
+// and the service looks layers up each time the layers shown change.
+//
+// The index is built with a single walk of the tree once the capabilities have loaded, and
+// holds the layers in tree order along with the range of the order each layer's sub-layers
+// occupy. Where several layers share a name, lookups return the first in tree order, as a
+// walk of the tree would.
+
+namespace Services
+{
+  class WMSLayerIndex
+  {
+    public:
+      WMSLayerIndex();
+
+      // Indexes the layers of a tree, replacing any previous contents. A NULL root empties the index.
+      void build( TSLWMSServiceLayer *rootLayer );
+
+      TSLWMSServiceLayer* rootLayer() const;
+
+      // Finds the first layer whose title or name is the given name
+      TSLWMSServiceLayer* findLayer( const char *name ) const;
+
+      // Finds the first layer with the given name and title, each empty if the layer has none
+      TSLWMSServiceLayer* findLayer( const std::string &name, const std::string &title ) const;
+
+      // All layers of the tree, in tree order
+      const std::vector< TSLWMSServiceLayer* >& layers() const;
+
+      // Gives the range of layers() holding a layer and its sub-layers. Returns false if the layer
+      // is not in the tree.
+      bool subtree( const TSLWMSServiceLayer *layer, size_t &begin, size_t &end ) const;
+
+    private:
+      void addLayer( TSLWMSServiceLayer *layer );
+
+      TSLWMSServiceLayer *m_rootLayer;
+      std::vector< TSLWMSServiceLayer* > m_layers;
+
+      // For each layer, its position in m_layers and the position after its last sub-layer
+      std::map< const TSLWMSServiceLayer*, std::pair< size_t, size_t > > m_positions;
+
+      std::map< std::string, TSLWMSServiceLayer* > m_byNameOrTitle;
+      std::map< std::pair< std::string, std::string >, TSLWMSServiceLayer* > m_byNameAndTitle;
+  };
+
+  inline TSLWMSServiceLayer* WMSLayerIndex::rootLayer() const
+  {
+    return m_rootLayer;
+  }
+
+  inline const std::vector< TSLWMSServiceLayer* >& WMSLayerIndex::layers() const
+  {
+    return m_layers;
+  }
+};
+#endif
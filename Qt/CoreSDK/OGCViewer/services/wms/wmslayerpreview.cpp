@@ -26,22 +26,49 @@ namespace Services
     }
   }
 
-  void WMSLayerPreview::showLayerPreview( const QModelIndex &layerIndex, const char *styleName )
+  void WMSLayerPreview::loadLayerPreview( const QModelIndex &layerIndex, const char *styleName )
   {
     if( !layerIndex.isValid() )
     {
       return;
     }
 
-    if( m_dataLayer )
+    WMSServiceLayerModel::WMSLayerNodeInfo *layerNode = reinterpret_cast< WMSServiceLayerModel::WMSLayerNodeInfo* >( layerIndex.internalPointer() );
+    if( layerNode->m_layer->name() )
+    {
+      m_layerName = layerNode->m_layer->name();
+    }
+    else
+    {
+      m_layerName.clear();
+    }
+
+    if( styleName )
+    {
+      m_layerStyle = styleName;
+    }
+    else
     {
-      m_surfaceWidget->drawingSurface()->removeDataLayer( "preview" );
+      m_layerStyle.clear();
+    }
 
-      // Delete the layer in another thread to avoid blocking the UI
-      DeletionThread *deleter = new DeletionThread( m_dataLayer );
-      deleter->start();
+    if( m_dataLayer && m_settingsComplete && !m_layerName.empty() && showLoadedLayer( m_dataLayer->rootServiceLayer() ) )
+    {
+      // The images held by the data layer are of the previous layer
+      m_dataLayer->clearCache();
+      m_dataLayer->notifyChanged();
+      showLoadMessageLayer();
+      m_surfaceWidget->signalResetView();
+      return;
     }
 
+    if( m_dataLayer )
+    {
+      discardDataLayer( m_dataLayer );
+    }
+
+    m_settingsComplete = false;
+    ++m_statistics.m_dataLayersCreated;
     m_dataLayer = new TSLWMSDataLayer( this );
     m_dataLayer->setDefaultLoaderCallbacks( &ServiceLayerPreview::loadCallback, this,
         &ServiceLayerPreview::allLoadedCallback, this );
@@ -55,27 +82,31 @@ namespace Services
 
     m_surfaceWidget->drawingSurface()->addDataLayer( m_dataLayer, "preview" );
 
-    WMSServiceLayerModel::WMSLayerNodeInfo *layerNode = reinterpret_cast< WMSServiceLayerModel::WMSLayerNodeInfo* >( layerIndex.internalPointer() );
-    if( layerNode->m_layer->name() )
+    m_dataLayer->loadData( m_serviceURL.c_str() );
+    showLoadMessageLayer();
+  }
+
+  bool WMSLayerPreview::showLoadedLayer( TSLWMSServiceLayer *layer )
+  {
+    // Hide every layer except the one to preview, as the data layer was showing another
+    bool found = false;
+    if( layer->name() && m_layerName.compare( layer->name() ) == 0 )
     {
-      m_layerName = layerNode->m_layer->name();
+      layer->setVisibility( true );
+      layer->setStyleValue( m_layerStyle.c_str() );
+      found = true;
     }
     else
     {
-      m_layerName.clear();
+      layer->setVisibility( false );
     }
 
-    if( styleName )
-    {
-      m_layerStyle = styleName;
-    }
-    else
+    int numChildLayers = layer->noOfSubLayers();
+    for( int i = 0; i < numChildLayers; ++i )
     {
-      m_layerStyle.clear();
+      found = showLoadedLayer( layer->getSubLayerAt(i) ) || found;
     }
-
-    m_dataLayer->loadData( m_serviceURL.c_str() );
-    showLoadMessageLayer();
+    return found;
   }
 
   // Data layer callbacks
@@ -153,6 +184,7 @@ namespace Services
 
   bool WMSLayerPreview::onServiceSettingsComplete()
   {
+    m_settingsComplete = !m_loadCancelled;
     m_messageLayer->setLoadFailStatus( false );
     m_surfaceWidget->signalResetView();
     return !m_loadCancelled;
@@ -22,8 +22,6 @@ namespace Services
       WMSLayerPreview( const std::string &serviceURL );
       virtual ~WMSLayerPreview();
 
-      virtual void showLayerPreview( const QModelIndex &layerIndex, const char *styleName );
-
       // Data layer callbacks
       virtual bool onCapabilitiesLoaded (TSLWMSServiceLayer *rootLayerInfo);
       virtual void onCapabilitiesLoadFailure (TSLWMSServiceSettingsCallbacks::CapabilitiesLoadFailureReason reason);
@@ -36,7 +34,14 @@ namespace Services
       virtual bool onUserLinearTransformInvalid();
       virtual bool onServiceSettingsComplete();
 
+    protected:
+      virtual void loadLayerPreview( const QModelIndex &layerIndex, const char *styleName );
+
     private:
+      // Makes the named layer the only visible layer of the loaded service. Returns false if the
+      // layer could not be found.
+      bool showLoadedLayer( TSLWMSServiceLayer *layer );
+
       TSLWMSDataLayer *m_dataLayer;
   };
 
@@ -10,16 +10,50 @@
 #include "wmsservicelayermodel.h"
 #include "wmsservicelayerstylesmodel.h"
 
+#include "services/ogcserviceproxy.h"
+
 #include "MapLink.h"
 #include "MapLinkDrawing.h"
 
+#include <algorithm>
+
+#include <QString>
+
 namespace Services
 {
 
   static const char *g_unnamedLayerString = "[Unnamed Layer]";
 
-  WMSService::WMSServiceLayer::WMSServiceLayer( TSLWMSServiceLayer *layer )
-    : m_layer( layer )
+  // The most data layers a service keeps to display the combinations of layers it has recently shown,
+  // including the one displayed. Each caches up to the configured cache size of images.
+  static const size_t g_maxDataLayers = 4;
+
+  // Separates the fields of a layer combination key. This cannot appear in layer names or dimension values.
+  static const char g_keySeparator = '\x1f';
+
+  static const char* stringOrEmpty( const char *value )
+  {
+    return value ? value : "";
+  }
+
+  // Returns the index of a layer's dimension, or -1. Dimension names are not case sensitive.
+  static int findDimension( const TSLWMSServiceLayer *layer, const char *dimensionName )
+  {
+    QString name( QString::fromUtf8( dimensionName ) );
+    int numDimensions = layer->noOfDimensions();
+    for( int i = 0; i < numDimensions; ++i )
+    {
+      if( name.compare( QString::fromUtf8( layer->getDimensionAt( i )->name() ), Qt::CaseInsensitive ) == 0 )
+      {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  WMSService::WMSServiceLayer::WMSServiceLayer( WMSService *service, TSLWMSServiceLayer *layer )
+    : m_service( service )
+      , m_layer( layer )
   {
     if( layer )
     {
@@ -129,11 +163,149 @@ namespace Services
       return false;
     }
 
-    return m_layer->setStyleValue( styleName );
+    // The style is one of the parameters of the images requested, so let the service decide which
+    // data layer displays the new style
+    return m_service->setLayerStyle( m_layer, styleName );
+  }
+
+  WMSService::AlternateLayerCallbacks::AlternateLayerCallbacks()
+    : m_finished( false )
+      , m_failed( false )
+  {
+  }
+
+  WMSService::AlternateLayerCallbacks::~AlternateLayerCallbacks()
+  {
+  }
+
+  void WMSService::AlternateLayerCallbacks::prepare( const LayerCombination &combination, const std::string &crs, const std::string &format )
+  {
+    m_mutex.lock();
+    m_combination = combination;
+    m_crs = crs;
+    m_format = format;
+    m_finished = false;
+    m_failed = false;
+    m_mutex.unlock();
+  }
+
+  bool WMSService::AlternateLayerCallbacks::finished( bool &failed )
+  {
+    m_mutex.lock();
+    bool finished = m_finished;
+    failed = m_failed;
+    m_mutex.unlock();
+    return finished;
+  }
+
+  void WMSService::AlternateLayerCallbacks::setFinished( bool failed )
+  {
+    m_mutex.lock();
+    m_finished = true;
+    m_failed = failed;
+    m_mutex.unlock();
+  }
+
+  bool WMSService::AlternateLayerCallbacks::onCapabilitiesLoaded (TSLWMSServiceLayer *rootLayerInfo)
+  {
+    // Show the layers the service showed when loading started, so the data layer has something to display
+    m_mutex.lock();
+    WMSLayerIndex index;
+    index.build( rootLayerInfo );
+    LayerCombination currentCombination;
+    getLayerCombination( index, currentCombination );
+    applyLayerCombination( m_combination, currentCombination, index );
+    m_mutex.unlock();
+    return true;
+  }
+
+  void WMSService::AlternateLayerCallbacks::onCapabilitiesLoadFailure (TSLWMSServiceSettingsCallbacks::CapabilitiesLoadFailureReason /*reason*/)
+  {
+    setFinished( true );
+  }
+
+  bool WMSService::AlternateLayerCallbacks::onNoVisibleLayers (TSLWMSServiceLayer* /*rootLayer*/)
+  {
+    setFinished( true );
+    return false;
+  }
+
+  bool WMSService::AlternateLayerCallbacks::onRequiredDimensionValueNotSet (TSLWMSServiceLayer* /*rootLayerInfo*/, TSLWMSServiceLayer* /*dimensionLayer*/,
+      const char* /*dimensionName*/)
+  {
+    setFinished( true );
+    return false;
+  }
+
+  bool WMSService::AlternateLayerCallbacks::onNoCommonCRSinVisibleLayers (TSLWMSServiceLayer* /*rootLayer*/)
+  {
+    setFinished( true );
+    return false;
+  }
+
+  bool WMSService::AlternateLayerCallbacks::onNoSupportedCRSinVisibleLayers (TSLWMSServiceLayer* /*rootLayer*/)
+  {
+    setFinished( true );
+    return false;
+  }
+
+  int WMSService::AlternateLayerCallbacks::onChoiceOfRequestFormats (const char **formatChoices, int noOfFormatChoices)
+  {
+    // Use the format the displayed data layer requests
+    m_mutex.lock();
+    int choice = 0;
+    for( int i = 0; i < noOfFormatChoices; ++i )
+    {
+      if( m_format.compare( formatChoices[i] ) == 0 )
+      {
+        choice = i;
+        break;
+      }
+    }
+    m_mutex.unlock();
+    return choice;
+  }
+
+  int WMSService::AlternateLayerCallbacks::onChoiceOfServiceCRSs (const char **crsChoices, int noOfCRSChoices)
+  {
+    // Use the coordinate system the user chose for the service
+    m_mutex.lock();
+    int choice = 0;
+    for( int i = 0; i < noOfCRSChoices; ++i )
+    {
+      if( m_crs.compare( crsChoices[i] ) == 0 )
+      {
+        choice = i;
+        break;
+      }
+    }
+    m_mutex.unlock();
+    return choice;
+  }
+
+  bool WMSService::AlternateLayerCallbacks::onUserLinearTransformInvalid()
+  {
+    setFinished( true );
+    return false;
+  }
+
+  bool WMSService::AlternateLayerCallbacks::onServiceSettingsComplete()
+  {
+    setFinished( false );
+    return true;
   }
 
   WMSService::WMSService()
     : Service()
+      , m_alternateLayer( NULL )
+      , m_alternateLayerFailed( false )
+      , m_serviceProxy( NULL )
+      , m_cacheSize( 128 * 1024 )
+      , m_transparentRequests( false )
+      // These match the first choices of the service options page
+      , m_tileLevelStrategy( TSLWMSDataLayer::TileLevelStrategyDetect )
+      , m_tileLoadOrder( TSLWMSDataLayer::ClockwiseSpiral_CentreStart )
+      , m_sortedLayerVisibilityValid( false )
       , m_serviceRootLayer( NULL )
       , m_crsChoices( NULL )
       , m_numCRSChoices( 0 )
@@ -141,8 +313,12 @@ namespace Services
   {
     m_type = ServiceTypeWMS;
 
+    m_layerCacheStatistics.m_hits = 0;
+    m_layerCacheStatistics.m_misses = 0;
+    m_layerCacheStatistics.m_cleared = 0;
+
     m_dataLayer = new TSLWMSDataLayer( this );
-    m_dataLayer->cacheSize( 128 * 1024 );
+    m_dataLayer->cacheSize( m_cacheSize );
 
     // In order to keep the UI responsive we want all connections to occur in a background thread
     // instead of the UI thread
@@ -157,6 +333,18 @@ namespace Services
     {
       m_dataLayer->destroy();
     }
+
+    std::list< CachedDataLayer >::iterator cachedIt( m_cachedLayers.begin() );
+    std::list< CachedDataLayer >::iterator cachedItE( m_cachedLayers.end() );
+    for( ; cachedIt != cachedItE; ++cachedIt )
+    {
+      cachedIt->m_layer->destroy();
+    }
+
+    if( m_alternateLayer )
+    {
+      m_alternateLayer->destroy();
+    }
   }
 
   void WMSService::loadService( const char *address )
@@ -169,17 +357,27 @@ namespace Services
     // Start loading the service metadata in a background thread.
     m_url = address;
     m_loadCancelled = false;
-    m_dataLayer->loadData( address );
+    if( m_serviceProxy && m_serviceProxy->isRunning() )
+    {
+      // The data layers fetch the capabilities and all images through the proxy, while the service
+      // keeps the real address for display and layer previews
+      m_loadAddress = m_serviceProxy->proxyURL( address );
+    }
+    else
+    {
+      m_loadAddress = address;
+    }
+    m_dataLayer->loadData( m_loadAddress.c_str() );
   }
 
   Service::ServiceLayerModel* WMSService::getServiceLayerModel()
   {
-    return new WMSServiceLayerModel( this, m_serviceRootLayer ? m_serviceRootLayer : m_dataLayer->rootServiceLayer() );
+    return new WMSServiceLayerModel( this, rootServiceLayer() );
   }
 
   Service::ServiceDimensionsModel* WMSService::getDimensionsModel()
   {
-    return new WMSServiceDimensionsModel( m_serviceRootLayer ? m_serviceRootLayer : m_dataLayer->rootServiceLayer() );
+    return new WMSServiceDimensionsModel( this, rootServiceLayer() );
   }
 
   Service::ServiceDimensionInfoModel* WMSService::getDimensionInfoModel()
@@ -210,11 +408,7 @@ namespace Services
 
   void WMSService::getVisibleLayers( std::vector< Service::ServiceLayer* > &layers )
   {
-    if( m_sortedLayerVisibility.empty() && m_dataLayer && m_dataLayer->rootServiceLayer() )
-    {
-      // Build the list of visible layers in the order they are drawn on first use
-      buildSortedLayerVisibilityList( m_dataLayer->rootServiceLayer() );
-    }
+    ensureVisibilityOrder();
 
     layers.reserve( m_sortedLayerVisibility.size() );
 
@@ -222,19 +416,25 @@ namespace Services
     std::map< int, TSLWMSServiceLayer* >::iterator layerItE( m_sortedLayerVisibility.end() );
     for( ; layerIt != layerItE; ++layerIt )
     {
-      layers.push_back( new WMSServiceLayer( layerIt->second ) );
+      layers.push_back( new WMSServiceLayer( this, layerIt->second ) );
     }
   }
 
   void WMSService::getPotentialLayersForDisplay( std::vector< std::string > &layerNames )
   {
-    layerNames.reserve( m_invisibleLayers.size() );
+    const std::vector< TSLWMSServiceLayer* > &allLayers = layerIndex( m_dataLayer ).layers();
+    layerNames.reserve( allLayers.size() );
 
-    std::set< const TSLWMSServiceLayer* >::iterator layerIt( m_invisibleLayers.begin() );
-    std::set< const TSLWMSServiceLayer* >::iterator layerItE( m_invisibleLayers.end() );
+    std::vector< TSLWMSServiceLayer* >::const_iterator layerIt( allLayers.begin() );
+    std::vector< TSLWMSServiceLayer* >::const_iterator layerItE( allLayers.end() );
     for( ; layerIt != layerItE; ++layerIt )
     {
-      const TSLWMSServiceLayer *invisibleLayer = *layerIt;
+      TSLWMSServiceLayer *invisibleLayer = *layerIt;
+      if( explicitlyVisible( invisibleLayer ) )
+      {
+        continue;
+      }
+
       if( invisibleLayer->supportsCRS( m_activeCRS.c_str() ) )
       {
         if( invisibleLayer->title() )
@@ -253,7 +453,7 @@ namespace Services
 
   Service::ServiceLayer* WMSService::getLayerForToken( void* token )
   {
-    return new WMSServiceLayer( (TSLWMSServiceLayer*)token );
+    return new WMSServiceLayer( this, (TSLWMSServiceLayer*)token );
   }
 
   TSLDataLayer* WMSService::dataLayer()
@@ -289,62 +489,215 @@ namespace Services
 
   void WMSService::updateLayerVisibilityOrder( int originalIndex, int newIndex )
   {
+    ensureVisibilityOrder();
+
     std::map< int, TSLWMSServiceLayer* >::iterator changedLayerIt( m_sortedLayerVisibility.find( originalIndex ) );
     if( changedLayerIt != m_sortedLayerVisibility.end() )
     {
-      changedLayerIt->second->setVisibility( true, newIndex );
+      LayerCombination previousCombination;
+      getDisplayedCombination( previousCombination );
 
-      // Rebuild the layer visibility index since the order has now changed
-      m_sortedLayerVisibility.clear();
-      m_invisibleLayers.clear();
-      buildSortedLayerVisibilityList( m_dataLayer->rootServiceLayer() );
-      m_dataLayer->clearCache();
+      TSLWMSServiceLayer *changedLayer = changedLayerIt->second;
+      changedLayer->setVisibility( true, newIndex );
 
-      // Since the layer has now been modified, set the changed flag so it will be updated next draw
-      m_dataLayer->notifyChanged();
+      layerCombinationChanged( previousCombination, changedLayer );
     }
   }
 
   void* WMSService::setLayerVisibility( const char *layerName, bool visible )
   {
-    TSLWMSServiceLayer *matchedLayer = findLayer( m_dataLayer->rootServiceLayer(), layerName );
+    TSLWMSServiceLayer *matchedLayer = layerIndex( m_dataLayer ).findLayer( layerName );
     if( !matchedLayer )
     {
       return NULL;
     }
 
+    LayerCombination previousCombination;
+    getDisplayedCombination( previousCombination );
+
     // Change the layer visibility as requested
     matchedLayer->setVisibility( visible );
 
-    m_sortedLayerVisibility.clear();
-    m_invisibleLayers.clear();
-    buildSortedLayerVisibilityList( m_dataLayer->rootServiceLayer() );
-    m_dataLayer->clearCache();
+    layerCombinationChanged( previousCombination, matchedLayer );
 
-    // Since the layer has now been modified, set the changed flag so it will be updated next draw
-    m_dataLayer->notifyChanged();
-
-    return matchedLayer;
+    // The layer may now be displayed by another data layer
+    return displayedLayer( matchedLayer );
   }
 
   void WMSService::setLayerVisibility( ServiceLayer *layer, bool visible )
   {
     WMSServiceLayer *wmsLayer = reinterpret_cast< WMSServiceLayer* >( layer );
-    wmsLayer->layer()->setVisibility( visible );
+    TSLWMSServiceLayer *changedLayer = displayedLayer( wmsLayer->layer() );
+    if( !changedLayer )
+    {
+      return;
+    }
 
-    m_sortedLayerVisibility.clear();
-    m_invisibleLayers.clear();
-    buildSortedLayerVisibilityList( m_dataLayer->rootServiceLayer() );
-    m_dataLayer->clearCache();
+    LayerCombination previousCombination;
+    getDisplayedCombination( previousCombination );
 
-    // Since the layer has now been modified, set the changed flag so it will be updated next draw
-    m_dataLayer->notifyChanged();
+    changedLayer->setVisibility( visible );
+
+    layerCombinationChanged( previousCombination, changedLayer );
+  }
+
+  bool WMSService::setLayerStyle( TSLWMSServiceLayer *layer, const char *styleName )
+  {
+    TSLWMSServiceLayer *changedLayer = displayedLayer( layer );
+    if( !changedLayer )
+    {
+      return false;
+    }
+
+    LayerCombination previousCombination;
+    getDisplayedCombination( previousCombination );
+
+    bool styleSet = changedLayer->setStyleValue( styleName );
+
+    layerCombinationChanged( previousCombination, NULL );
+
+    return styleSet;
+  }
+
+  bool WMSService::getDimensionValues( const char *dimensionName, std::vector< std::string > &values, std::string &currentValue )
+  {
+    values.clear();
+    currentValue.clear();
+    ensureVisibilityOrder();
+
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerIt( m_sortedLayerVisibility.begin() );
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerItE( m_sortedLayerVisibility.end() );
+    for( ; layerIt != layerItE; ++layerIt )
+    {
+      int dimensionIndex = findDimension( layerIt->second, dimensionName );
+      if( dimensionIndex < 0 )
+      {
+        continue;
+      }
+
+      const TSLWMSServiceLayerDimension *dimension = layerIt->second->getDimensionAt( dimensionIndex );
+      int numPossibleValues = dimension->noOfPossibleValues();
+      values.reserve( numPossibleValues );
+      for( int i = 0; i < numPossibleValues; ++i )
+      {
+        values.push_back( stringOrEmpty( dimension->getPossibleValue( i ) ) );
+      }
+      currentValue = stringOrEmpty( layerIt->second->getDimensionValue( dimension->name() ) );
+      return true;
+    }
+
+    return false;
+  }
+
+  size_t WMSService::maxDataLayers()
+  {
+    return g_maxDataLayers;
+  }
+
+  bool WMSService::setDimensionValue( const char *dimensionName, const char *value, bool keepDataLayer )
+  {
+    ensureVisibilityOrder();
+
+    // The layers of the displayed tree are changed, so take a copy of the list before it is rebuilt
+    std::vector< TSLWMSServiceLayer* > dimensionLayers;
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerIt( m_sortedLayerVisibility.begin() );
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerItE( m_sortedLayerVisibility.end() );
+    for( ; layerIt != layerItE; ++layerIt )
+    {
+      if( findDimension( layerIt->second, dimensionName ) >= 0 )
+      {
+        dimensionLayers.push_back( layerIt->second );
+      }
+    }
+
+    if( dimensionLayers.empty() )
+    {
+      return false;
+    }
+
+    LayerCombination previousCombination;
+    if( !keepDataLayer )
+    {
+      getDisplayedCombination( previousCombination );
+    }
+
+    for( size_t i = 0; i < dimensionLayers.size(); ++i )
+    {
+      TSLWMSServiceLayer *layer = dimensionLayers[i];
+      layer->setDimensionValue( layer->getDimensionAt( findDimension( layer, dimensionName ) )->name(), value );
+    }
+
+    if( keepDataLayer )
+    {
+      // Only the images of the displayed data layer are discarded. The other data layers keep theirs,
+      // and no data layer is loaded for the value.
+      m_dataLayer->clearCache();
+      m_dataLayer->notifyChanged();
+      ++m_layerCacheStatistics.m_cleared;
+      return true;
+    }
+
+    // Each value is a new combination of layers, so a recently shown value is displayed by the data
+    // layer that still holds its images
+    layerCombinationChanged( previousCombination, NULL );
+
+    return true;
+  }
+
+  bool WMSService::setLayerDimensionValue( TSLWMSServiceLayer *layer, const char *dimensionName, const char *value )
+  {
+    TSLWMSServiceLayer *changedLayer = displayedLayer( layer );
+    if( !changedLayer )
+    {
+      // The service isn't displayed yet, so there are no images to keep
+      return layer->setDimensionValue( dimensionName, value );
+    }
+
+    LayerCombination previousCombination;
+    getDisplayedCombination( previousCombination );
+
+    bool valueSet = changedLayer->setDimensionValue( dimensionName, value );
+
+    // The previous value stays with the data layer that holds its images, as in setDimensionValue()
+    layerCombinationChanged( previousCombination, NULL );
+
+    return valueSet;
+  }
+
+  TSLWMSServiceLayer* WMSService::rootServiceLayer()
+  {
+    return m_serviceRootLayer ? m_serviceRootLayer : m_dataLayer->rootServiceLayer();
   }
 
   void WMSService::setCacheSize( int size )
   {
     // We are given the size in MB, the data layer takes the size in Kb.
-    m_dataLayer->cacheSize( size * 1024 );
+    m_cacheSize = size * 1024;
+    applyCacheSizes();
+  }
+
+  void WMSService::addedToView()
+  {
+    // Prepare a data layer now, so the first change to the layers shown keeps the images already loaded
+    loadAlternateLayer();
+  }
+
+  void WMSService::setTransparentRequests( bool transparent )
+  {
+    m_transparentRequests = transparent;
+    m_dataLayer->setTransparent( transparent );
+  }
+
+  void WMSService::setTileLevelStrategy( TSLWMSDataLayer::TileLevelStrategy strategy )
+  {
+    m_tileLevelStrategy = strategy;
+    m_dataLayer->tileLevelStrategy( strategy );
+  }
+
+  void WMSService::setTileLoadOrder( TSLWMSDataLayer::TileLoadOrderStrategy order )
+  {
+    m_tileLoadOrder = order;
+    m_dataLayer->tileLoadOrder( order );
   }
 
   void WMSService::layerVisiblityChanged( TSLWMSServiceLayer *layer )
@@ -358,6 +711,9 @@ namespace Services
     {
       m_visibleLayers.erase( layer );
     }
+
+    // The layer was changed directly, so the visibility order is built again when next used
+    m_sortedLayerVisibilityValid = false;
   }
 
   bool WMSService::onCapabilitiesLoaded (TSLWMSServiceLayer *rootLayerInfo)
@@ -529,50 +885,407 @@ namespace Services
     return !m_loadCancelled;
   }
 
-  void WMSService::buildSortedLayerVisibilityList( TSLWMSServiceLayer *layer )
+  const WMSLayerIndex& WMSService::layerIndex( TSLWMSDataLayer *dataLayer )
+  {
+    // The tree is created when the data layer loads the capabilities, and does not change after that
+    WMSLayerIndex &index = m_layerIndexes[dataLayer];
+    if( index.rootLayer() != dataLayer->rootServiceLayer() )
+    {
+      index.build( dataLayer->rootServiceLayer() );
+    }
+    return index;
+  }
+
+  bool WMSService::explicitlyVisible( TSLWMSServiceLayer *layer )
   {
     bool derivedVisibility = false;
-    if( layer->getVisibility( &derivedVisibility ) && !derivedVisibility )
+    return layer->getVisibility( &derivedVisibility ) && !derivedVisibility;
+  }
+
+  void WMSService::ensureVisibilityOrder()
+  {
+    if( !m_sortedLayerVisibilityValid )
     {
-      m_sortedLayerVisibility.insert( std::make_pair( layer->getVisibilityOrderIndex(), layer ) );
+      rebuildVisibilityOrder();
     }
-    else
+  }
+
+  void WMSService::rebuildVisibilityOrder()
+  {
+    m_sortedLayerVisibility.clear();
+
+    const std::vector< TSLWMSServiceLayer* > &allLayers = layerIndex( m_dataLayer ).layers();
+    for( size_t i = 0; i < allLayers.size(); ++i )
+    {
+      if( explicitlyVisible( allLayers[i] ) )
+      {
+        m_sortedLayerVisibility.insert( std::make_pair( allLayers[i]->getVisibilityOrderIndex(), allLayers[i] ) );
+      }
+    }
+
+    m_sortedLayerVisibilityValid = !allLayers.empty();
+  }
+
+  void WMSService::updateVisibilityOrder( TSLWMSServiceLayer *changedLayer )
+  {
+    if( !m_sortedLayerVisibilityValid )
+    {
+      rebuildVisibilityOrder();
+      return;
+    }
+
+    // Showing or moving a layer renumbers the other visible layers, and showing or hiding a layer may change
+    // whether its sub-layers are shown in their own right, so these are all checked again
+    std::vector< TSLWMSServiceLayer* > candidates;
+    candidates.reserve( m_sortedLayerVisibility.size() + 1 );
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerIt( m_sortedLayerVisibility.begin() );
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerItE( m_sortedLayerVisibility.end() );
+    for( ; layerIt != layerItE; ++layerIt )
+    {
+      candidates.push_back( layerIt->second );
+    }
+
+    if( changedLayer )
+    {
+      const WMSLayerIndex &index = layerIndex( m_dataLayer );
+      size_t begin = 0, end = 0;
+      if( index.subtree( changedLayer, begin, end ) )
+      {
+        candidates.insert( candidates.end(), index.layers().begin() + begin, index.layers().begin() + end );
+      }
+      else
+      {
+        candidates.push_back( changedLayer );
+      }
+    }
+
+    m_sortedLayerVisibility.clear();
+    for( size_t i = 0; i < candidates.size(); ++i )
+    {
+      if( explicitlyVisible( candidates[i] ) )
+      {
+        m_sortedLayerVisibility.insert( std::make_pair( candidates[i]->getVisibilityOrderIndex(), candidates[i] ) );
+      }
+    }
+  }
+
+  void WMSService::setVisibilityOrder( const LayerCombination &combination )
+  {
+    m_sortedLayerVisibility.clear();
+
+    const WMSLayerIndex &index = layerIndex( m_dataLayer );
+    for( size_t i = 0; i < combination.size(); ++i )
+    {
+      TSLWMSServiceLayer *layer = index.findLayer( combination[i].m_name, combination[i].m_title );
+      if( layer && explicitlyVisible( layer ) )
+      {
+        m_sortedLayerVisibility.insert( std::make_pair( layer->getVisibilityOrderIndex(), layer ) );
+      }
+    }
+
+    m_sortedLayerVisibilityValid = true;
+  }
+
+  TSLWMSServiceLayer* WMSService::displayedLayer( TSLWMSServiceLayer *layer )
+  {
+    if( !layer || !m_dataLayer->rootServiceLayer() )
+    {
+      return NULL;
+    }
+
+    return layerIndex( m_dataLayer ).findLayer( stringOrEmpty( layer->name() ), stringOrEmpty( layer->title() ) );
+  }
+
+  void WMSService::captureLayerSettings( TSLWMSServiceLayer *layer, VisibleLayerSettings &settings )
+  {
+    settings.m_name = stringOrEmpty( layer->name() );
+    settings.m_title = stringOrEmpty( layer->title() );
+    settings.m_hasStyle = layer->getStyleValue() != NULL;
+    settings.m_style = stringOrEmpty( layer->getStyleValue() );
+
+    int numDimensions = layer->noOfDimensions();
+    for( int i = 0; i < numDimensions; ++i )
+    {
+      const char *dimensionName = layer->getDimensionAt( i )->name();
+      const char *dimensionValue = layer->getDimensionValue( dimensionName );
+      if( dimensionValue )
+      {
+        settings.m_dimensionValues.push_back( std::make_pair( std::string( dimensionName ), std::string( dimensionValue ) ) );
+      }
+    }
+  }
+
+  void WMSService::getLayerCombination( const WMSLayerIndex &index, LayerCombination &combination )
+  {
+    combination.clear();
+
+    std::map< int, TSLWMSServiceLayer* > visibleLayers;
+    const std::vector< TSLWMSServiceLayer* > &allLayers = index.layers();
+    for( size_t i = 0; i < allLayers.size(); ++i )
     {
-      m_invisibleLayers.insert( layer );
+      if( explicitlyVisible( allLayers[i] ) )
+      {
+        visibleLayers.insert( std::make_pair( allLayers[i]->getVisibilityOrderIndex(), allLayers[i] ) );
+      }
     }
 
-    int numChildLayers = layer->noOfSubLayers();
-    for( int i = 0; i < numChildLayers; ++i )
+    combination.resize( visibleLayers.size() );
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerIt( visibleLayers.begin() );
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerItE( visibleLayers.end() );
+    for( size_t i = 0; layerIt != layerItE; ++layerIt, ++i )
     {
-      buildSortedLayerVisibilityList( layer->getSubLayerAt(i) );
+      captureLayerSettings( layerIt->second, combination[i] );
     }
   }
 
-  TSLWMSServiceLayer* WMSService::findLayer( TSLWMSServiceLayer *layer, const char *name )
+  void WMSService::getDisplayedCombination( LayerCombination &combination )
   {
-    // The name we have might be either the layer's name or title, so check both to see if the
-    // layer matches
-    if( layer->title() && strcmp( layer->title(), name ) == 0 )
+    ensureVisibilityOrder();
+
+    combination.clear();
+    combination.resize( m_sortedLayerVisibility.size() );
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerIt( m_sortedLayerVisibility.begin() );
+    std::map< int, TSLWMSServiceLayer* >::const_iterator layerItE( m_sortedLayerVisibility.end() );
+    for( size_t i = 0; layerIt != layerItE; ++layerIt, ++i )
     {
-      return layer;
+      captureLayerSettings( layerIt->second, combination[i] );
     }
-    else if( layer->name() && strcmp( layer->name(), name ) == 0 )
+  }
+
+  void WMSService::applyLayerCombination( const LayerCombination &combination, const LayerCombination &currentCombination,
+                                          const WMSLayerIndex &index )
+  {
+    if( !index.rootLayer() )
     {
-      return layer;
+      return;
     }
 
-    // This layer didn't match, check the child layers for a match
-    int numChildLayers = layer->noOfSubLayers();
-    for( int i = 0; i < numChildLayers; ++i )
+    // Hide the layers that are not part of the combination
+    for( size_t i = 0; i < currentCombination.size(); ++i )
     {
-      TSLWMSServiceLayer *matchedLayer = findLayer( layer->getSubLayerAt(i), name );
-      if( matchedLayer )
+      const VisibleLayerSettings &current = currentCombination[i];
+      bool keep = false;
+      for( size_t j = 0; j < combination.size() && !keep; ++j )
+      {
+        keep = combination[j].m_name == current.m_name && combination[j].m_title == current.m_title;
+      }
+
+      TSLWMSServiceLayer *layer = keep ? NULL : index.findLayer( current.m_name, current.m_title );
+      if( layer )
+      {
+        layer->setVisibility( false );
+      }
+    }
+
+    // Show the layers of the combination in draw order, with the same parameters
+    int visibilityIndex = 0;
+    for( size_t i = 0; i < combination.size(); ++i )
+    {
+      const VisibleLayerSettings &settings = combination[i];
+      TSLWMSServiceLayer *layer = index.findLayer( settings.m_name, settings.m_title );
+      if( !layer )
+      {
+        continue;
+      }
+
+      layer->setVisibility( true, visibilityIndex++ );
+      layer->setStyleValue( settings.m_hasStyle ? settings.m_style.c_str() : NULL );
+      for( size_t j = 0; j < settings.m_dimensionValues.size(); ++j )
+      {
+        layer->setDimensionValue( settings.m_dimensionValues[j].first.c_str(), settings.m_dimensionValues[j].second.c_str() );
+      }
+    }
+  }
+
+  std::string WMSService::layerCombinationKey( const LayerCombination &combination )
+  {
+    // The canonical form of the layer parameters of a GetMap request: the layers in draw order, each with
+    // its style and dimension values. The request extent is not part of the key as each data layer caches
+    // its images by extent.
+    std::string key;
+    for( size_t i = 0; i < combination.size(); ++i )
+    {
+      const VisibleLayerSettings &settings = combination[i];
+      key += settings.m_name;
+      key += g_keySeparator;
+      key += settings.m_title;
+      key += g_keySeparator;
+      key += settings.m_hasStyle ? settings.m_style : std::string();
+      key += g_keySeparator;
+
+      // The order the dimensions are listed in does not change the request
+      std::vector< std::pair< std::string, std::string > > dimensionValues( settings.m_dimensionValues );
+      std::sort( dimensionValues.begin(), dimensionValues.end() );
+      for( size_t j = 0; j < dimensionValues.size(); ++j )
+      {
+        key += dimensionValues[j].first;
+        key += '=';
+        key += dimensionValues[j].second;
+        key += g_keySeparator;
+      }
+      key += '\n';
+    }
+    return key;
+  }
+
+  void WMSService::layerCombinationChanged( const LayerCombination &previousCombination, TSLWMSServiceLayer *changedLayer )
+  {
+    updateVisibilityOrder( changedLayer );
+
+    LayerCombination combination;
+    getDisplayedCombination( combination );
+
+    std::string previousKey( layerCombinationKey( previousCombination ) );
+    std::string key( layerCombinationKey( combination ) );
+    if( key != previousKey )
+    {
+      TSLWMSDataLayer *replacementLayer = NULL;
+
+      // Use the data layer that displayed the combination before, if it is still kept
+      std::list< CachedDataLayer >::iterator cachedIt( m_cachedLayers.begin() );
+      std::list< CachedDataLayer >::iterator cachedItE( m_cachedLayers.end() );
+      for( ; cachedIt != cachedItE; ++cachedIt )
+      {
+        if( cachedIt->m_key == key )
+        {
+          replacementLayer = cachedIt->m_layer;
+          m_cachedLayers.erase( cachedIt );
+          ++m_layerCacheStatistics.m_hits;
+          break;
+        }
+      }
+
+      if( !replacementLayer )
+      {
+        // Otherwise use the data layer loaded in advance, or the least recently displayed one
+        LayerCombination replacementCombination;
+        bool alternateLayerFailed = false;
+        if( m_alternateLayer && m_alternateLayerCallbacks.finished( alternateLayerFailed ) )
+        {
+          if( alternateLayerFailed )
+          {
+            // Don't try again, the service is unlikely to load any better next time
+            m_layerIndexes.erase( m_alternateLayer );
+            m_alternateLayer->destroy();
+            m_alternateLayerFailed = true;
+          }
+          else
+          {
+            replacementLayer = m_alternateLayer;
+            replacementCombination.swap( m_alternateCombination );
+          }
+          m_alternateLayer = NULL;
+        }
+        else if( !m_cachedLayers.empty() )
+        {
+          replacementLayer = m_cachedLayers.back().m_layer;
+          replacementCombination.swap( m_cachedLayers.back().m_combination );
+          m_cachedLayers.pop_back();
+          replacementLayer->clearCache();
+        }
+
+        if( replacementLayer )
+        {
+          applyLayerCombination( combination, replacementCombination, layerIndex( replacementLayer ) );
+          ++m_layerCacheStatistics.m_misses;
+        }
+      }
+
+      if( replacementLayer )
+      {
+        // Keep the images of the previous combination with the data layer that displayed it. The service list
+        // swaps the data layers in the drawing surface.
+        applyLayerCombination( previousCombination, combination, layerIndex( m_dataLayer ) );
+        CachedDataLayer cachedLayer;
+        cachedLayer.m_key = previousKey;
+        cachedLayer.m_combination = previousCombination;
+        cachedLayer.m_layer = m_dataLayer;
+        m_cachedLayers.push_front( cachedLayer );
+        m_dataLayer = replacementLayer;
+
+        // The replacement's tree now shows the combination, so its visibility order is known without a walk
+        setVisibilityOrder( combination );
+      }
+      else
       {
-        return matchedLayer;
+        // No other data layer is available, so the images displayed no longer match the layers
+        m_dataLayer->clearCache();
+        ++m_layerCacheStatistics.m_cleared;
       }
     }
 
-    return NULL;
+    // Since the layer has now been modified, set the changed flag so it will be updated next draw
+    m_dataLayer->notifyChanged();
+
+    loadAlternateLayer();
+
+    // The displayed data layer may have changed
+    applyCacheSizes();
+  }
+
+  void WMSService::loadAlternateLayer()
+  {
+    if( m_alternateLayer || m_alternateLayerFailed || !m_loader || m_cachedLayers.size() + 2 > g_maxDataLayers )
+    {
+      return;
+    }
+
+    getDisplayedCombination( m_alternateCombination );
+    m_alternateLayerCallbacks.prepare( m_alternateCombination, m_activeCRS, stringOrEmpty( m_dataLayer->getCurrentImageRequestFormat() ) );
+
+    m_alternateLayer = new TSLWMSDataLayer( &m_alternateLayerCallbacks );
+    applyRequestSettings( m_alternateLayer );
+    m_alternateLayer->addLoader( m_loader, m_loadCallback, m_loadCallbackArg, m_allLoadedCallback, m_allLoadedCallbackArg );
+
+    // Position the data layer in the same way as the displayed one, so they can be swapped in the drawing surface
+    useTransformParametersFromLayer( m_dataLayer );
+    m_alternateLayer->setLinearTransformParameters( !m_useFixedTransformParameters, m_muShiftX, m_muShiftY, m_tmcPerMU );
+
+    // Start loading the service metadata in a background thread.
+    m_alternateLayer->loadData( m_loadAddress.c_str() );
+
+    applyCacheSizes();
+  }
+
+  void WMSService::applyRequestSettings( TSLWMSDataLayer *dataLayer )
+  {
+    dataLayer->cacheSize( spareLayerCacheSize() );
+    dataLayer->setSynchronousLoading( false );
+    dataLayer->synchronousLoadStrategy( false );
+    dataLayer->validateGetMapRequest( true );
+    dataLayer->tileLevelStrategy( m_tileLevelStrategy );
+    dataLayer->tileLoadOrder( m_tileLoadOrder );
+    dataLayer->setTransparent( m_transparentRequests );
+
+    unsigned char r, g, b;
+    if( m_dataLayer->getBackgroundColour( r, g, b ) )
+    {
+      dataLayer->setBackgroundColour( r, g, b );
+    }
+  }
+
+  void WMSService::applyCacheSizes()
+  {
+    int spareCacheSize = spareLayerCacheSize();
+    int numSpareLayers = (int)m_cachedLayers.size() + (m_alternateLayer ? 1 : 0);
+    m_dataLayer->cacheSize( m_cacheSize - numSpareLayers * spareCacheSize );
+
+    std::list< CachedDataLayer >::iterator cachedIt( m_cachedLayers.begin() );
+    std::list< CachedDataLayer >::iterator cachedItE( m_cachedLayers.end() );
+    for( ; cachedIt != cachedItE; ++cachedIt )
+    {
+      cachedIt->m_layer->cacheSize( spareCacheSize );
+    }
+
+    if( m_alternateLayer )
+    {
+      m_alternateLayer->cacheSize( spareCacheSize );
+    }
+  }
+
+  int WMSService::spareLayerCacheSize() const
+  {
+    return m_cacheSize / (2 * (int)(g_maxDataLayers - 1));
   }
 
 };
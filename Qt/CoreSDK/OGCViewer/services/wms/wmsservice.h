@@ -5,20 +5,30 @@
 #ifndef WMSSERVICE_H
 #define WMSSERVICE_H
 
+#include <list>
 #include <set>
 #include <map>
+#include <string>
+#include <vector>
 
+#include "wmslayerindex.h"
 #include "wmsservicelayermodel.h"
 #include "wmsservicelayerinfomodel.h"
 
 #include "services/service.h"
 
+#include "MapLink.h"
 #include "tsltmsapi.h"
 #include "tslwmsservicesettingscallbacks.h"
 
 class TSLWMSDataLayer;
 class TSLWMSServiceLayer;
 
+namespace Services
+{
+  class OGCServiceProxy;
+};
+
 // An implementation of the Service interface that connects to OGC Web Map Services.
 namespace Services
 {
@@ -28,7 +38,7 @@ namespace Services
       class WMSServiceLayer : public Service::ServiceLayer
     {
       public:
-        WMSServiceLayer( TSLWMSServiceLayer *layer );
+        WMSServiceLayer( WMSService *service, TSLWMSServiceLayer *layer );
         virtual ~WMSServiceLayer();
 
         virtual const char* displayName() const;
@@ -42,16 +52,34 @@ namespace Services
         TSLWMSServiceLayer *layer();
 
       private:
+        WMSService *m_service;
         TSLWMSServiceLayer *m_layer;
         std::map< std::string, int > m_dimensionsLookup;
     };
 
+      // Counts of how layer changes were displayed, since the service was created
+      struct LayerCacheStatistics
+      {
+        // The layers shown were shown recently, so the images already loaded for them were used
+        size_t m_hits;
+        // A data layer without images was available to show the layers
+        size_t m_misses;
+        // The displayed images were discarded, as no other data layer was available or an animation frame was
+        // shown in place
+        size_t m_cleared;
+      };
+
       WMSService();
       virtual ~WMSService();
 
       virtual void loadService( const char *address );
       void advanceConnectionSequence();
 
+      // Sets the proxy to load the service through, so that the frames of an animation can be fetched
+      // ahead of the data layer. This must be set before the service is loaded.
+      void setServiceProxy( OGCServiceProxy *proxy );
+      OGCServiceProxy* serviceProxy() const;
+
       virtual ServiceLayerModel* getServiceLayerModel();
       virtual ServiceLayerInfoModel* getServiceLayerInfoModel();
       virtual ServiceDimensionsModel* getDimensionsModel();
@@ -73,9 +101,42 @@ namespace Services
       virtual void* setLayerVisibility( const char *layerName, bool visible );
       virtual void setLayerVisibility( ServiceLayer *layer, bool visible );
 
-      // Changes the cache size of the enclosed data layer in the service
+      // Changes the cache size of the enclosed data layers in the service
       virtual void setCacheSize( int size );
 
+      // Starts loading a data layer to show the next combination of layers with
+      virtual void addedToView();
+
+      // Changes the style of a layer shown by the service
+      bool setLayerStyle( TSLWMSServiceLayer *layer, const char *styleName );
+
+      // Sets the value of a dimension of one layer, which may be of the tree of any of the service's data
+      // layers. Returns false if the value couldn't be set.
+      bool setLayerDimensionValue( TSLWMSServiceLayer *layer, const char *dimensionName, const char *value );
+
+      // The root of the layer tree shown by the models of the service
+      TSLWMSServiceLayer* rootServiceLayer();
+
+      // Request settings applied to every data layer of the service
+      void setTransparentRequests( bool transparent );
+      void setTileLevelStrategy( TSLWMSDataLayer::TileLevelStrategy strategy );
+      void setTileLoadOrder( TSLWMSDataLayer::TileLoadOrderStrategy order );
+
+      LayerCacheStatistics layerCacheStatistics() const;
+
+      // Lists the values of a dimension of the visible layers, taken from the first visible layer that
+      // has the dimension, and returns the value currently requested for it
+      bool getDimensionValues( const char *dimensionName, std::vector< std::string > &values, std::string &currentValue );
+
+      // Sets the value of a dimension on every visible layer that has it. Returns false if no visible
+      // layer has the dimension. Normally a recently shown value is displayed by the data layer that still
+      // holds its images. With keepDataLayer the value is shown by the displayed data layer, which
+      // requests its images again, and the data layers holding other combinations are left alone.
+      bool setDimensionValue( const char *dimensionName, const char *value, bool keepDataLayer = false );
+
+      // The most data layers a service uses to hold the images of recently shown combinations of layers
+      static size_t maxDataLayers();
+
       // This function is used to record which layers are visible to avoid having to continuously
       // parse the layer tree to find visible layers
       void layerVisiblityChanged( TSLWMSServiceLayer *layer );
@@ -94,16 +155,154 @@ namespace Services
       virtual bool onServiceSettingsComplete();
 
     private:
-      void buildSortedLayerVisibilityList( TSLWMSServiceLayer *layer );
-      TSLWMSServiceLayer* findLayer( TSLWMSServiceLayer *layer, const char *name );
+      // The settings of a visible layer that are sent in GetMap requests
+      struct VisibleLayerSettings
+      {
+        // The name and title of the layer, which identify it in each data layer's copy of the layer tree
+        std::string m_name;
+        std::string m_title;
+        bool m_hasStyle;
+        std::string m_style;
+        std::vector< std::pair< std::string, std::string > > m_dimensionValues;
+      };
+
+      // The visible layers of a data layer in draw order, which determine the content of its images
+      typedef std::vector< VisibleLayerSettings > LayerCombination;
+
+      // A data layer that is not displayed, holding the images of the layers it was last displayed with
+      struct CachedDataLayer
+      {
+        std::string m_key;
+        LayerCombination m_combination;
+        TSLWMSDataLayer *m_layer;
+      };
+
+      // Answers the loading sequence of the additional data layers, so they use the coordinate system and
+      // request format the user chose for the service. The callbacks are made from a background thread.
+      class AlternateLayerCallbacks : public TSLWMSServiceSettingsCallbacks
+      {
+        public:
+          AlternateLayerCallbacks();
+          virtual ~AlternateLayerCallbacks();
+
+          // Sets what to answer for the next data layer loaded
+          void prepare( const LayerCombination &combination, const std::string &crs, const std::string &format );
+
+          // Returns true once the data layer has loaded, or has failed to load
+          bool finished( bool &failed );
+
+          virtual bool onCapabilitiesLoaded (TSLWMSServiceLayer *rootLayerInfo);
+          virtual void onCapabilitiesLoadFailure (TSLWMSServiceSettingsCallbacks::CapabilitiesLoadFailureReason reason);
+          virtual bool onNoVisibleLayers (TSLWMSServiceLayer *rootLayer);
+          virtual bool onRequiredDimensionValueNotSet (TSLWMSServiceLayer *rootLayerInfo, TSLWMSServiceLayer *dimensionLayer, const char *dimensionName);
+          virtual bool onNoCommonCRSinVisibleLayers (TSLWMSServiceLayer *rootLayer);
+          virtual bool onNoSupportedCRSinVisibleLayers (TSLWMSServiceLayer *rootLayer);
+          virtual int onChoiceOfRequestFormats (const char **formatChoices, int noOfFormatChoices);
+          virtual int onChoiceOfServiceCRSs (const char **crsChoices, int noOfCRSChoices);
+          virtual bool onUserLinearTransformInvalid();
+          virtual bool onServiceSettingsComplete();
+
+        private:
+          void setFinished( bool failed );
+
+          QMutex m_mutex;
+          LayerCombination m_combination;
+          std::string m_crs;
+          std::string m_format;
+          bool m_finished;
+          bool m_failed;
+      };
+
+      // Returns the index of a data layer's layer tree, building it once the data layer has loaded its capabilities
+      const WMSLayerIndex& layerIndex( TSLWMSDataLayer *dataLayer );
+
+      // Returns whether a layer is shown because it was made visible, rather than because its parent was
+      static bool explicitlyVisible( TSLWMSServiceLayer *layer );
+
+      // The visible layers of the displayed data layer are held in draw order in m_sortedLayerVisibility. This
+      // is built from the whole tree when first used, and afterwards only the layers that can have changed are
+      // checked.
+      void ensureVisibilityOrder();
+      void rebuildVisibilityOrder();
 
-      // The MapLink data layer used to display the service
+      // Updates the visibility order after a layer of the displayed tree has been shown, hidden or moved. Only
+      // the layers already visible and the changed layer with its sub-layers are checked. changedLayer may be
+      // NULL if no layer's visibility changed.
+      void updateVisibilityOrder( TSLWMSServiceLayer *changedLayer );
+
+      // Sets the visibility order to the layers of a combination, once the data layer showing it is displayed
+      void setVisibilityOrder( const LayerCombination &combination );
+
+      // Returns the copy of a layer in the tree of the displayed data layer. Layers handed to the user
+      // interface may belong to a data layer that has since been replaced.
+      TSLWMSServiceLayer* displayedLayer( TSLWMSServiceLayer *layer );
+
+      static void captureLayerSettings( TSLWMSServiceLayer *layer, VisibleLayerSettings &settings );
+
+      // Captures the visible layers of any indexed tree by checking every layer
+      static void getLayerCombination( const WMSLayerIndex &index, LayerCombination &combination );
+
+      // Captures the visible layers of the displayed data layer from the visibility order
+      void getDisplayedCombination( LayerCombination &combination );
+
+      // Shows the layers of a combination in an indexed tree, given the combination the tree currently shows
+      static void applyLayerCombination( const LayerCombination &combination, const LayerCombination &currentCombination,
+                                         const WMSLayerIndex &index );
+      static std::string layerCombinationKey( const LayerCombination &combination );
+
+      // Displays the layers as changed in the tree of the displayed data layer since the previous combination
+      // was captured. If the new combination was displayed recently, the data layer that displayed it replaces the
+      // current one, which is kept with the images of the previous combination. Otherwise an unused or the least
+      // recently used data layer is given the new combination, or as a last resort the images of the current data
+      // layer are discarded. changedLayer is the layer shown, hidden or moved, if any.
+      void layerCombinationChanged( const LayerCombination &previousCombination, TSLWMSServiceLayer *changedLayer );
+
+      // Starts loading another data layer if the limit on data layers allows it
+      void loadAlternateLayer();
+
+      // Applies the request settings of the service to a data layer
+      void applyRequestSettings( TSLWMSDataLayer *dataLayer );
+
+      // Shares the cache size between the data layers. The displayed data layer is given at least half of
+      // it, and every other data layer an equal part of the rest, so the images held by all of them never
+      // take more than the cache size.
+      void applyCacheSizes();
+      int spareLayerCacheSize() const;
+
+      // The MapLink data layer used to display the service. This is replaced when the layers shown change
+      // to a combination another data layer holds the images of.
       TSLWMSDataLayer *m_dataLayer;
 
-      // List of the layers that are shown and not shown
+      // Data layers holding the images of recently displayed combinations of layers, most recently displayed first
+      std::list< CachedDataLayer > m_cachedLayers;
+
+      // A data layer being loaded, or loaded and not yet used, to display the next new combination of layers,
+      // and the combination it was given to show
+      TSLWMSDataLayer *m_alternateLayer;
+      LayerCombination m_alternateCombination;
+      AlternateLayerCallbacks m_alternateLayerCallbacks;
+      bool m_alternateLayerFailed;
+
+      LayerCacheStatistics m_layerCacheStatistics;
+
+      // The proxy the service is loaded through, if any, and the address the data layers load from
+      OGCServiceProxy *m_serviceProxy;
+      std::string m_loadAddress;
+
+      // Request settings
+      int m_cacheSize;
+      bool m_transparentRequests;
+      TSLWMSDataLayer::TileLevelStrategy m_tileLevelStrategy;
+      TSLWMSDataLayer::TileLoadOrderStrategy m_tileLoadOrder;
+
+      // The index of each data layer's layer tree
+      std::map< const TSLWMSDataLayer*, WMSLayerIndex > m_layerIndexes;
+
+      // The layers made visible while the service is configured, and the visible layers of the displayed
+      // data layer in draw order
       std::set< const TSLWMSServiceLayer* > m_visibleLayers;
       std::map< int, TSLWMSServiceLayer* > m_sortedLayerVisibility;
-      std::set< const TSLWMSServiceLayer* > m_invisibleLayers;
+      bool m_sortedLayerVisibilityValid;
 
       // Storage for information that is only valid for the duration of specific callbacks in the loading sequence
       TSLWMSServiceLayer *m_serviceRootLayer;
@@ -117,9 +316,24 @@ namespace Services
     return m_layer;
   }
 
+  inline void WMSService::setServiceProxy( OGCServiceProxy *proxy )
+  {
+    m_serviceProxy = proxy;
+  }
+
+  inline OGCServiceProxy* WMSService::serviceProxy() const
+  {
+    return m_serviceProxy;
+  }
+
   inline bool WMSService::anyLayersVisible() const
   {
     return !m_visibleLayers.empty();
   }
+
+  inline WMSService::LayerCacheStatistics WMSService::layerCacheStatistics() const
+  {
+    return m_layerCacheStatistics;
+  }
 };
 #endif
@@ -3,6 +3,7 @@
  ****************************************************************************/
 
 #include "wmsservicedimensionsmodel.h"
+#include "wmsservice.h"
 #include <QAbstractItemView>
 #include <QComboBox>
 
@@ -12,8 +13,9 @@
 namespace Services
 {
 
-  WMSServiceDimensionsModel::WMSServiceDimensionsModel( TSLWMSServiceLayer *rootLayer )
-    : m_rootLayer( rootLayer )
+  WMSServiceDimensionsModel::WMSServiceDimensionsModel( WMSService *service, TSLWMSServiceLayer *rootLayer )
+    : m_service( service )
+    , m_rootLayer( rootLayer )
   {
     // Build up a list of dimensions that apply to the visible layers and store
     // accessors to them so we don't have to traverse the layer tree each time
@@ -183,9 +185,19 @@ namespace Services
       return false;
     }
 
+    // Set the value through the service, so the images of the previous value are kept by the data layer
+    // that displayed them
     std::pair< int, TSLWMSServiceLayer* > &dimension = m_dimensions[index.row()];
-    if( dimension.second->setDimensionValue( dimension.first, value.toString().toUtf8() ) )
+    std::string dimensionName( dimension.second->getDimensionAt( dimension.first )->name() );
+    if( m_service->setLayerDimensionValue( dimension.second, dimensionName.c_str(), value.toString().toUtf8() ) )
     {
+      // Another data layer may now display the layers, so take the dimensions from its tree
+      m_rootLayer = m_service->rootServiceLayer();
+      m_dimensions.clear();
+      if( m_rootLayer )
+      {
+        extractVisibleLayerDimensions( m_rootLayer );
+      }
       emit dataChanged( index, index );
     }
 
@@ -20,12 +20,13 @@ class QAbstractItemView;
 
 namespace Services
 {
+  class WMSService;
 
   class WMSServiceDimensionsModel : public Service::ServiceDimensionsModel
   {
     Q_OBJECT
     public:
-      WMSServiceDimensionsModel( TSLWMSServiceLayer *rootLayer );
+      WMSServiceDimensionsModel( WMSService *service, TSLWMSServiceLayer *rootLayer );
       virtual ~WMSServiceDimensionsModel();
 
       virtual bool configurationValid() const;
@@ -45,6 +46,7 @@ namespace Services
     private:
       void extractVisibleLayerDimensions( TSLWMSServiceLayer *layer );
 
+      WMSService *m_service;
       TSLWMSServiceLayer *m_rootLayer;
 
       // Stores the set of dimensions that are applicable to selected layers in the service. The first part of the
@@ -23,22 +23,48 @@ namespace Services
     }
   }
 
-  void WMTSLayerPreview::showLayerPreview( const QModelIndex &layerIndex, const char *styleName )
+  void WMTSLayerPreview::loadLayerPreview( const QModelIndex &layerIndex, const char *styleName )
   {
     if( !layerIndex.isValid() )
     {
       return;
     }
 
-    if( m_dataLayer )
+    WMTSServiceLayerModel::WMTSLayerNodeInfo *layerNode = reinterpret_cast< WMTSServiceLayerModel::WMTSLayerNodeInfo* >( layerIndex.internalPointer() );
+    if( layerNode->m_layer->identifier() )
+    {
+      m_layerName = layerNode->m_layer->identifier();
+    }
+    else
     {
-      m_surfaceWidget->drawingSurface()->removeDataLayer( "preview" );
+      m_layerName.clear();
+    }
 
-      // Delete the layer in another thread to avoid blocking the UI
-      DeletionThread *deleter = new DeletionThread( m_dataLayer );
-      deleter->start();
+    if( styleName )
+    {
+      m_layerStyle = styleName;
+    }
+    else
+    {
+      m_layerStyle.clear();
+    }
+
+    if( m_dataLayer && m_settingsComplete && showLoadedLayer() )
+    {
+      // Each layer's tiles are held separately, so the data layer's cache is still valid
+      m_dataLayer->notifyChanged();
+      showLoadMessageLayer();
+      m_surfaceWidget->signalResetView();
+      return;
+    }
+
+    if( m_dataLayer )
+    {
+      discardDataLayer( m_dataLayer );
     }
 
+    m_settingsComplete = false;
+    ++m_statistics.m_dataLayersCreated;
     m_dataLayer = new TSLWMTSDataLayer( this );
     m_dataLayer->setDefaultLoaderCallbacks( &ServiceLayerPreview::loadCallback, this,
         &ServiceLayerPreview::allLoadedCallback, this );
@@ -50,27 +76,43 @@ namespace Services
 
     m_surfaceWidget->drawingSurface()->addDataLayer( m_dataLayer, "preview" );
 
-    WMTSServiceLayerModel::WMTSLayerNodeInfo *layerNode = reinterpret_cast< WMTSServiceLayerModel::WMTSLayerNodeInfo* >( layerIndex.internalPointer() );
-    if( layerNode->m_layer->identifier() )
-    {
-      m_layerName = layerNode->m_layer->identifier();
-    }
-    else
+    m_dataLayer->loadData( m_serviceURL.c_str() );
+    showLoadMessageLayer();
+  }
+
+  bool WMTSLayerPreview::showLoadedLayer()
+  {
+    TSLWMTSServiceInfo *serviceInfo = m_dataLayer->serviceInformation();
+    if( !serviceInfo )
     {
-      m_layerName.clear();
+      return false;
     }
 
-    if( styleName )
+    // Dimension values are chosen while the service settings are made, so layers with dimensions
+    // are loaded from scratch, as are layers without a tile matrix set in the data layer's coordinate system
+    TSLWMTSServiceLayer *previewLayer = NULL;
+    int numLayers = serviceInfo->numLayers();
+    for( int i = 0; i < numLayers; ++i )
     {
-      m_layerStyle = styleName;
+      TSLWMTSServiceLayer *layer = serviceInfo->getLayerAt(i);
+      if( layer->identifier() && m_layerName.compare( layer->identifier() ) == 0 )
+      {
+        previewLayer = layer;
+        break;
+      }
     }
-    else
+    if( !previewLayer || previewLayer->numDimensions() > 0 || !previewLayer->supportsCRS( m_dataLayer->activeCRS() ) )
     {
-      m_layerStyle.clear();
+      return false;
     }
 
-    m_dataLayer->loadData( m_serviceURL.c_str() );
-    showLoadMessageLayer();
+    for( int i = 0; i < numLayers; ++i )
+    {
+      TSLWMTSServiceLayer *layer = serviceInfo->getLayerAt(i);
+      layer->setVisibility( layer == previewLayer );
+    }
+    previewLayer->setStyleValue( m_layerStyle.c_str() );
+    return true;
   }
 
   // Data layer callbacks
@@ -146,6 +188,7 @@ namespace Services
 
   bool WMTSLayerPreview::onServiceSettingsComplete()
   {
+    m_settingsComplete = !m_loadCancelled;
     m_messageLayer->setLoadFailStatus( false );
     m_surfaceWidget->signalResetView();
     return !m_loadCancelled;
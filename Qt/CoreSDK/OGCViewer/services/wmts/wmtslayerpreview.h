@@ -18,8 +18,6 @@ namespace Services
       WMTSLayerPreview( const std::string &serviceURL );
       virtual ~WMTSLayerPreview();
 
-      virtual void showLayerPreview( const QModelIndex &layerIndex, const char *styleName );
-
       // Data layer callbacks
       virtual bool onCapabilitiesLoaded (TSLWMTSServiceInfo *rootLayerInfo);
       virtual void onCapabilitiesLoadFailure (TSLWMTSServiceSettingsCallbacks::CapabilitiesLoadFailureReason reason);
@@ -32,7 +30,14 @@ namespace Services
       virtual bool onUserLinearTransformInvalid();
       virtual bool onServiceSettingsComplete();
 
+    protected:
+      virtual void loadLayerPreview( const QModelIndex &layerIndex, const char *styleName );
+
     private:
+      // Makes the named layer the only visible layer of the loaded service. Returns false if the
+      // layer could not be found or cannot be shown in the data layer's coordinate system.
+      bool showLoadedLayer();
+
       TSLWMTSDataLayer *m_dataLayer;
   };
 };
@@ -0,0 +1,297 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#include <algorithm>
+
+#include "wmtsrequestscheduler.h"
+
+namespace Services
+{
+  // Added to the priority of tiles that are not at their layer's current tile matrix, so they are
+  // sent after all tiles that are
+  static const double g_otherTileMatrixPenalty = 1.0e9;
+
+  // Time in milliseconds a layer must stay at a new tile matrix before the requests waiting for its
+  // other tile matrices are cancelled
+  static const qint64 g_obsoleteDelay = 500;
+
+  // The most WMS GetMap requests sent to each server at once, unless the server has a limit set.
+  // This is the number of connections the remote loader opens.
+  static const int g_mapLimit = 8;
+
+  // Added to a host name to limit its GetMap requests separately
+  static const char *g_mapHostSuffix = "\nmap";
+
+  WMTSRequestScheduler::WMTSRequestScheduler()
+    : m_defaultLimit( 4 )
+    , m_prioritise( true )
+    , m_prioritiesChanged( false )
+  {
+    m_clock.start();
+  }
+
+  void WMTSRequestScheduler::setHostLimits( int defaultLimit, const QMap< QString, int > &hostLimits )
+  {
+    m_defaultLimit = std::max( defaultLimit, 1 );
+    m_hostLimits = hostLimits;
+  }
+
+  QByteArray WMTSRequestScheduler::mapHost( const QByteArray &host )
+  {
+    return host + g_mapHostSuffix;
+  }
+
+  void WMTSRequestScheduler::setPrioritise( bool prioritise )
+  {
+    m_prioritiesChanged = m_prioritiesChanged || prioritise != m_prioritise;
+    m_prioritise = prioritise;
+  }
+
+  void WMTSRequestScheduler::add( quint64 id, const QByteArray &host )
+  {
+    QueuedRequest request;
+    request.m_host = host;
+    request.m_isTile = false;
+    request.m_row = 0;
+    request.m_col = 0;
+    enqueue( id, request );
+  }
+
+  void WMTSRequestScheduler::addTile( quint64 id, const QByteArray &host, const QByteArray &layer, const QByteArray &tileMatrix,
+                                      int row, int col, std::vector< quint64 > &obsolete )
+  {
+    std::map< QByteArray, LayerView >::iterator view = m_layers.find( layer );
+    if( view != m_layers.end() && view->second.m_tileMatrix == tileMatrix )
+    {
+      LayerView &tiles = view->second;
+      if( tiles.m_restart )
+      {
+        tiles.m_minRow = tiles.m_maxRow = row;
+        tiles.m_minCol = tiles.m_maxCol = col;
+        tiles.m_restart = false;
+        m_prioritiesChanged = true;
+      }
+      else if( row < tiles.m_minRow || row > tiles.m_maxRow || col < tiles.m_minCol || col > tiles.m_maxCol )
+      {
+        tiles.m_minRow = std::min( tiles.m_minRow, row );
+        tiles.m_maxRow = std::max( tiles.m_maxRow, row );
+        tiles.m_minCol = std::min( tiles.m_minCol, col );
+        tiles.m_maxCol = std::max( tiles.m_maxCol, col );
+        m_prioritiesChanged = true;
+      }
+    }
+    else
+    {
+      // The layer has zoomed, or this is its first tile
+      LayerView tiles;
+      tiles.m_tileMatrix = tileMatrix;
+      tiles.m_minRow = tiles.m_maxRow = row;
+      tiles.m_minCol = tiles.m_maxCol = col;
+      tiles.m_restart = false;
+      tiles.m_since = m_clock.elapsed();
+      tiles.m_obsoleteRemoved = view == m_layers.end();
+      m_layers[layer] = tiles;
+      m_prioritiesChanged = true;
+    }
+
+    QueuedRequest request;
+    request.m_host = host;
+    request.m_isTile = true;
+    request.m_layer = layer;
+    request.m_tileMatrix = tileMatrix;
+    request.m_row = row;
+    request.m_col = col;
+    enqueue( id, request );
+
+    takeObsolete( obsolete );
+  }
+
+  void WMTSRequestScheduler::takeObsolete( std::vector< quint64 > &obsolete )
+  {
+    if( !m_prioritise )
+    {
+      return;
+    }
+
+    // The layers that have stayed at their tile matrix long enough for the change to be kept
+    std::set< QByteArray > changedLayers;
+    qint64 now = m_clock.elapsed();
+    std::map< QByteArray, LayerView >::iterator view( m_layers.begin() );
+    std::map< QByteArray, LayerView >::iterator viewE( m_layers.end() );
+    for( ; view != viewE; ++view )
+    {
+      if( !view->second.m_obsoleteRemoved && now - view->second.m_since >= g_obsoleteDelay )
+      {
+        view->second.m_obsoleteRemoved = true;
+        changedLayers.insert( view->first );
+      }
+    }
+    if( changedLayers.empty() )
+    {
+      return;
+    }
+
+    std::map< quint64, QueuedRequest >::iterator it( m_queue.begin() );
+    std::map< quint64, QueuedRequest >::iterator itE( m_queue.end() );
+    while( it != itE )
+    {
+      const QueuedRequest &request = it->second;
+      if( request.m_isTile && changedLayers.find( request.m_layer ) != changedLayers.end() &&
+          request.m_tileMatrix != m_layers[request.m_layer].m_tileMatrix )
+      {
+        std::map< QByteArray, HostQueue >::iterator hostQueue = m_hostQueues.find( request.m_host );
+        if( hostQueue != m_hostQueues.end() )
+        {
+          hostQueue->second.erase( std::make_pair( request.m_priority, it->first ) );
+        }
+        obsolete.push_back( it->first );
+        m_queue.erase( it++ );
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  bool WMTSRequestScheduler::next( quint64 &id )
+  {
+    // Only reorder the requests when one of them can be sent
+    bool canSend = false;
+    std::map< QByteArray, HostQueue >::iterator hostQueue( m_hostQueues.begin() );
+    std::map< QByteArray, HostQueue >::iterator hostQueueE( m_hostQueues.end() );
+    for( ; hostQueue != hostQueueE && !canSend; ++hostQueue )
+    {
+      std::map< QByteArray, int >::const_iterator active = m_active.find( hostQueue->first );
+      canSend = !hostQueue->second.empty() && (active == m_active.end() || active->second < hostLimit( hostQueue->first ));
+    }
+    if( !canSend )
+    {
+      return false;
+    }
+
+    if( m_prioritiesChanged )
+    {
+      reprioritise();
+    }
+
+    // The most useful request of the servers below their limit. Requests of equal priority are sent in
+    // the order they arrived.
+    std::map< QByteArray, HostQueue >::iterator best( m_hostQueues.end() );
+    for( hostQueue = m_hostQueues.begin(); hostQueue != hostQueueE; ++hostQueue )
+    {
+      std::map< QByteArray, int >::const_iterator active = m_active.find( hostQueue->first );
+      if( hostQueue->second.empty() || (active != m_active.end() && active->second >= hostLimit( hostQueue->first )) )
+      {
+        continue;
+      }
+
+      if( best == m_hostQueues.end() || *hostQueue->second.begin() < *best->second.begin() )
+      {
+        best = hostQueue;
+      }
+    }
+
+    id = best->second.begin()->second;
+    ++m_active[best->first];
+    best->second.erase( best->second.begin() );
+    if( best->second.empty() )
+    {
+      m_hostQueues.erase( best );
+    }
+    m_queue.erase( id );
+    return true;
+  }
+
+  bool WMTSRequestScheduler::start( const QByteArray &host )
+  {
+    int &active = m_active[host];
+    if( active >= hostLimit( host ) )
+    {
+      return false;
+    }
+    ++active;
+    return true;
+  }
+
+  void WMTSRequestScheduler::finished( const QByteArray &host )
+  {
+    std::map< QByteArray, int >::iterator active = m_active.find( host );
+    if( active != m_active.end() && --active->second <= 0 )
+    {
+      m_active.erase( active );
+    }
+  }
+
+  void WMTSRequestScheduler::beginView()
+  {
+    // Keep each layer's tile matrix, so requests for the previous one are still found obsolete
+    std::map< QByteArray, LayerView >::iterator it( m_layers.begin() );
+    std::map< QByteArray, LayerView >::iterator itE( m_layers.end() );
+    for( ; it != itE; ++it )
+    {
+      it->second.m_restart = true;
+    }
+  }
+
+  void WMTSRequestScheduler::enqueue( quint64 id, QueuedRequest &request )
+  {
+    request.m_priority = priority( request );
+    m_hostQueues[request.m_host].insert( std::make_pair( request.m_priority, id ) );
+    m_queue[id] = request;
+  }
+
+  void WMTSRequestScheduler::reprioritise()
+  {
+    m_hostQueues.clear();
+    std::map< quint64, QueuedRequest >::iterator it( m_queue.begin() );
+    std::map< quint64, QueuedRequest >::iterator itE( m_queue.end() );
+    for( ; it != itE; ++it )
+    {
+      it->second.m_priority = priority( it->second );
+      m_hostQueues[it->second.m_host].insert( std::make_pair( it->second.m_priority, it->first ) );
+    }
+    m_prioritiesChanged = false;
+  }
+
+  int WMTSRequestScheduler::hostLimit( const QByteArray &host ) const
+  {
+    if( host.endsWith( g_mapHostSuffix ) )
+    {
+      QByteArray server = host.left( host.size() - (int)qstrlen( g_mapHostSuffix ) );
+      return m_hostLimits.value( QString::fromUtf8( server ), g_mapLimit );
+    }
+    return m_hostLimits.value( QString::fromUtf8( host ), m_defaultLimit );
+  }
+
+  double WMTSRequestScheduler::priority( const QueuedRequest &request ) const
+  {
+    // Without prioritisation every request is equal, so they are sent in the order they arrived
+    if( !m_prioritise )
+    {
+      return 0.0;
+    }
+
+    // Capabilities and other requests are needed before any tiles can be shown
+    if( !request.m_isTile )
+    {
+      return -1.0;
+    }
+
+    std::map< QByteArray, LayerView >::const_iterator view = m_layers.find( request.m_layer );
+    if( view == m_layers.end() )
+    {
+      return 0.0;
+    }
+
+    // The centre of the tiles requested for the view is the centre of the screen. The distance
+    // is measured in tiles.
+    const LayerView &tiles = view->second;
+    double rowOffset = request.m_row - (tiles.m_minRow + tiles.m_maxRow) / 2.0;
+    double colOffset = request.m_col - (tiles.m_minCol + tiles.m_maxCol) / 2.0;
+    double distance = rowOffset * rowOffset + colOffset * colOffset;
+
+    return request.m_tileMatrix == tiles.m_tileMatrix ? distance : distance + g_otherTileMatrixPenalty;
+  }
+};
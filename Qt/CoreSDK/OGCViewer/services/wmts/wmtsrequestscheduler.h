@@ -0,0 +1,164 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#ifndef WMTSREQUESTSCHEDULER_H
+#define WMTSREQUESTSCHEDULER_H
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QString>
+
+// Decides the order the service proxy sends the data layer's requests to servers in.
+//
+// Each server has a limit on the requests sent to it at once, and requests beyond the limit wait
+// in the scheduler. When a request can be sent, the one chosen is the most useful for the current
+// view: requests that are not for tiles first, then tiles at the tile matrix the layer is currently
+// using, nearest the centre of the tiles requested at that matrix first.
+//
+// The data layer asks for tiles from a single tile matrix for each view, so when a layer's requests
+// move to another tile matrix, because the view has zoomed, the requests still waiting for the old
+// one are obsolete. They are removed for the proxy to cancel once the layer has stayed at the new
+// tile matrix for a while, so a view that zooms back, or requests of two matrices arriving
+// interleaved, don't cancel tiles that are still wanted. Until then they are sent after the tiles
+// of the current matrix.
+//
+// The waiting requests are kept ordered by priority for each server, so choosing the next request
+// only looks at the first request of each server. The order is rebuilt when the tiles requested
+// at a layer's current tile matrix change, which happens a few times as each view is requested.
+//
+// The scheduler is not thread safe; it is only used from the service proxy's thread.
+
+namespace Services
+{
+  class WMTSRequestScheduler
+  {
+    public:
+      WMTSRequestScheduler();
+
+      // Sets the most requests sent to each server at once, and the limits for particular servers
+      // keyed by host name
+      void setHostLimits( int defaultLimit, const QMap< QString, int > &hostLimits );
+
+      // Returns the name WMS GetMap requests to a host are limited under. These have a limit of their
+      // own for each server, the one WMS services had when they were loaded directly, so they don't
+      // take the places of the server's tile requests. A limit set for the host applies to both.
+      static QByteArray mapHost( const QByteArray &host );
+
+      // Turns prioritisation and cancellation on or off. When off, requests are sent in the order
+      // they arrive and none are cancelled.
+      void setPrioritise( bool prioritise );
+      bool prioritise() const;
+
+      // Queues a request that is not for a tile, which is sent before any tiles
+      void add( quint64 id, const QByteArray &host );
+
+      // Queues a tile request. layer identifies the server, layer, style, tile matrix set and dimension
+      // values. Requests that have become obsolete are removed from the queue and added to obsolete.
+      void addTile( quint64 id, const QByteArray &host, const QByteArray &layer, const QByteArray &tileMatrix,
+                    int row, int col, std::vector< quint64 > &obsolete );
+
+      // Removes the requests that have become obsolete since the layers changed tile matrix, and adds
+      // them to obsolete
+      void takeObsolete( std::vector< quint64 > &obsolete );
+
+      // Takes the most useful request that can be sent now, counting it against its server's limit.
+      // Returns false if there is none.
+      bool next( quint64 &id );
+
+      // Counts a request sent outside the scheduler, such as a prefetch, against its server's limit,
+      // if the server is below it. Returns false if it is not.
+      bool start( const QByteArray &host );
+
+      // Releases a request's place in its server's limit once it has completed
+      void finished( const QByteArray &host );
+
+      // Called once the view has settled, so the next tiles requested describe a new view
+      void beginView();
+
+      size_t numQueued() const;
+
+    private:
+      struct QueuedRequest
+      {
+        QByteArray m_host;
+        bool m_isTile;
+        QByteArray m_layer;
+        QByteArray m_tileMatrix;
+        int m_row;
+        int m_col;
+
+        // The priority the request is ordered by in its server's queue
+        double m_priority;
+      };
+
+      // The requests waiting for a server, by priority and then arrival
+      typedef std::set< std::pair< double, quint64 > > HostQueue;
+
+      // The tiles requested at a layer's current tile matrix
+      struct LayerView
+      {
+        QByteArray m_tileMatrix;
+        int m_minRow;
+        int m_maxRow;
+        int m_minCol;
+        int m_maxCol;
+
+        // Set when the view has settled, so the next tile at the same tile matrix starts a new range
+        bool m_restart;
+
+        // When the layer moved to the tile matrix, on m_clock, and whether the requests waiting for
+        // its other tile matrices have been removed since
+        qint64 m_since;
+        bool m_obsoleteRemoved;
+      };
+
+      int hostLimit( const QByteArray &host ) const;
+
+      // Lower values are sent first
+      double priority( const QueuedRequest &request ) const;
+
+      // Adds a request to the queue of its server
+      void enqueue( quint64 id, QueuedRequest &request );
+
+      // Orders the waiting requests again after the priorities have changed
+      void reprioritise();
+
+      int m_defaultLimit;
+      QMap< QString, int > m_hostLimits;
+      bool m_prioritise;
+
+      // Requests waiting to be sent, in the order they arrived
+      std::map< quint64, QueuedRequest > m_queue;
+
+      // The requests waiting for each server, most useful first
+      std::map< QByteArray, HostQueue > m_hostQueues;
+
+      // Set when the priorities of waiting requests have changed since they were ordered
+      bool m_prioritiesChanged;
+
+      // Requests sent to each server and not yet completed
+      std::map< QByteArray, int > m_active;
+
+      std::map< QByteArray, LayerView > m_layers;
+
+      QElapsedTimer m_clock;
+  };
+
+  inline bool WMTSRequestScheduler::prioritise() const
+  {
+    return m_prioritise;
+  }
+
+  inline size_t WMTSRequestScheduler::numQueued() const
+  {
+    return m_queue.size();
+  }
+};
+#endif
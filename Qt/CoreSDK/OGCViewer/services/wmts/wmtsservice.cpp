@@ -10,6 +10,7 @@
 #include "wmtsservicelayerstylesmodel.h"
 #include "wmtsservicedimensioninfomodel.h"
 #include "wmtslayerpreview.h"
+#include "services/ogcserviceproxy.h"
 
 namespace Services
 {
@@ -128,6 +129,7 @@ namespace Services
 
   WMTSService::WMTSService()
     : Service()
+      , m_serviceProxy( NULL )
       , m_serviceInfo( NULL )
       , m_crsChoices( NULL )
       , m_numCRSChoices( 0 )
@@ -162,7 +164,16 @@ namespace Services
     // Start loading the service metadata in a background thread.
     m_url = address;
     m_loadCancelled = false;
-    m_dataLayer->loadData( address );
+    if( m_serviceProxy && m_serviceProxy->isRunning() )
+    {
+      // The data layer fetches the capabilities and all tiles through the proxy, while the service
+      // keeps the real address for display and layer previews
+      m_dataLayer->loadData( m_serviceProxy->proxyURL( address ).c_str() );
+    }
+    else
+    {
+      m_dataLayer->loadData( address );
+    }
   }
 
   Service::ServiceLayerModel* WMTSService::getServiceLayerModel()
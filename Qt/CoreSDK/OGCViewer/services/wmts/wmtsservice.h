@@ -17,6 +17,8 @@
 // An implementation of the Service interface that connects to OGC Web Map Tile Services.
 namespace Services
 {
+  class OGCServiceProxy;
+
   class WMTSService : public Service, public TSLWMTSServiceSettingsCallbacks
   {
     public:
@@ -47,6 +49,10 @@ namespace Services
       virtual void loadService( const char *address );
       void advanceConnectionSequence();
 
+      // Sets the proxy to load the service through, so that its tiles are kept on disk between sessions.
+      // This must be set before the service is loaded.
+      void setServiceProxy( OGCServiceProxy *proxy );
+
       virtual ServiceLayerModel* getServiceLayerModel();
       virtual ServiceLayerInfoModel* getServiceLayerInfoModel();
       virtual ServiceDimensionsModel* getDimensionsModel();
@@ -94,6 +100,8 @@ namespace Services
       // The MapLink data layer used to display the service
       TSLWMTSDataLayer *m_dataLayer;
 
+      OGCServiceProxy *m_serviceProxy;
+
       // Storage for information that is only valid for the duration of specific callbacks in the loading sequence
       std::set< TSLWMTSServiceLayer* > m_visibleLayers;
       std::map< int, TSLWMTSServiceLayer* > m_sortedLayerVisibility;
@@ -111,6 +119,11 @@ namespace Services
     return m_layer;
   }
 
+  inline void WMTSService::setServiceProxy( OGCServiceProxy *proxy )
+  {
+    m_serviceProxy = proxy;
+  }
+
   inline bool WMTSService::anyLayersVisible() const
   {
     return !m_visibleLayers.empty();
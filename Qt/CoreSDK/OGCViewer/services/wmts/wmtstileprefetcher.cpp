@@ -0,0 +1,401 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#include <math.h>
+#include <algorithm>
+
+#include <QList>
+#include <QStringList>
+#include <QXmlStreamReader>
+
+#include "wmtstileprefetcher.h"
+
+namespace Services
+{
+  // The most tiles planned at each of the coarser and finer tile matrices, per layer
+  static const size_t g_maxLevelTiles = 64;
+
+  // WMTS scale denominators assume pixels of 0.28mm
+  static const double g_pixelSize = 0.00028;
+
+  // Metres per degree at the equator, for tile matrix sets in geographic coordinate systems
+  static const double g_metresPerDegree = 6378137.0 * 2.0 * M_PI / 360.0;
+
+  // Orders planned tiles by their distance from the centre of the view
+  struct TileDistance
+  {
+    double m_distance;
+    int m_row;
+    int m_col;
+
+    bool operator<( const TileDistance &other ) const
+    {
+      return m_distance < other.m_distance;
+    }
+  };
+
+  WMTSTilePrefetcher::WMTSTilePrefetcher()
+    : m_ring( 1 )
+  {
+  }
+
+  void WMTSTilePrefetcher::setRing( int ring )
+  {
+    m_ring = std::max( ring, 0 );
+  }
+
+  void WMTSTilePrefetcher::addCapabilities( const QByteArray &document )
+  {
+    QXmlStreamReader reader( document );
+    QStringList openElements;
+    while( !reader.atEnd() )
+    {
+      reader.readNext();
+      if( reader.isEndElement() )
+      {
+        if( !openElements.isEmpty() )
+        {
+          openElements.removeLast();
+        }
+        continue;
+      }
+      if( !reader.isStartElement() )
+      {
+        continue;
+      }
+
+      // Layers refer to tile matrix sets by an element of the same name, so only read the sets
+      // defined in the service's contents
+      if( reader.name() == "TileMatrixSet" && !openElements.isEmpty() && openElements.last() == "Contents" )
+      {
+        readTileMatrixSet( reader );
+        continue;
+      }
+      openElements.append( reader.name().toString() );
+    }
+  }
+
+  void WMTSTilePrefetcher::readTileMatrixSet( QXmlStreamReader &reader )
+  {
+    QByteArray identifier;
+    QString crs;
+    TileMatrixSet tileMatrixSet;
+    std::vector< double > scaleDenominators;
+    std::vector< int > tileWidths, tileHeights;
+    std::vector< QStringList > topLeftCorners;
+
+    while( reader.readNextStartElement() )
+    {
+      if( reader.name() == "Identifier" )
+      {
+        identifier = reader.readElementText().trimmed().toUtf8();
+      }
+      else if( reader.name() == "SupportedCRS" )
+      {
+        crs = reader.readElementText().trimmed();
+      }
+      else if( reader.name() == "TileMatrix" )
+      {
+        TileMatrix tileMatrix;
+        tileMatrix.m_matrixWidth = 0;
+        tileMatrix.m_matrixHeight = 0;
+        double scaleDenominator = 0.0;
+        int tileWidth = 256, tileHeight = 256;
+        QStringList topLeftCorner;
+        while( reader.readNextStartElement() )
+        {
+          if( reader.name() == "Identifier" )
+          {
+            tileMatrix.m_identifier = reader.readElementText().trimmed().toUtf8();
+          }
+          else if( reader.name() == "ScaleDenominator" )
+          {
+            scaleDenominator = reader.readElementText().toDouble();
+          }
+          else if( reader.name() == "TopLeftCorner" )
+          {
+            topLeftCorner = reader.readElementText().split( ' ', QString::SkipEmptyParts );
+          }
+          else if( reader.name() == "TileWidth" )
+          {
+            tileWidth = reader.readElementText().toInt();
+          }
+          else if( reader.name() == "TileHeight" )
+          {
+            tileHeight = reader.readElementText().toInt();
+          }
+          else if( reader.name() == "MatrixWidth" )
+          {
+            tileMatrix.m_matrixWidth = reader.readElementText().toInt();
+          }
+          else if( reader.name() == "MatrixHeight" )
+          {
+            tileMatrix.m_matrixHeight = reader.readElementText().toInt();
+          }
+          else
+          {
+            reader.skipCurrentElement();
+          }
+        }
+
+        if( !tileMatrix.m_identifier.isEmpty() && scaleDenominator > 0.0 && topLeftCorner.size() == 2 &&
+            tileMatrix.m_matrixWidth > 0 && tileMatrix.m_matrixHeight > 0 )
+        {
+          tileMatrixSet.push_back( tileMatrix );
+          scaleDenominators.push_back( scaleDenominator );
+          tileWidths.push_back( tileWidth );
+          tileHeights.push_back( tileHeight );
+          topLeftCorners.push_back( topLeftCorner );
+        }
+      }
+      else
+      {
+        reader.skipCurrentElement();
+      }
+    }
+
+    if( identifier.isEmpty() || tileMatrixSet.empty() )
+    {
+      return;
+    }
+
+    // The coordinate system is only needed for its units and axis order. EPSG geographic systems
+    // give the top left corner as latitude then longitude.
+    bool geographic = crs.contains( "4326" ) || crs.contains( "4258" ) || crs.contains( "CRS84" );
+    bool latitudeFirst = geographic && !crs.contains( "CRS84" );
+    double metresPerUnit = geographic ? g_metresPerDegree : 1.0;
+
+    for( size_t i = 0; i < tileMatrixSet.size(); ++i )
+    {
+      TileMatrix &tileMatrix = tileMatrixSet[i];
+      tileMatrix.m_tileSpanX = tileWidths[i] * scaleDenominators[i] * g_pixelSize / metresPerUnit;
+      tileMatrix.m_tileSpanY = tileHeights[i] * scaleDenominators[i] * g_pixelSize / metresPerUnit;
+      tileMatrix.m_left = topLeftCorners[i][latitudeFirst ? 1 : 0].toDouble();
+      tileMatrix.m_top = topLeftCorners[i][latitudeFirst ? 0 : 1].toDouble();
+    }
+
+    // Order the matrices from coarsest to finest, as capabilities are not required to list them in order
+    for( size_t i = 1; i < tileMatrixSet.size(); ++i )
+    {
+      for( size_t j = i; j > 0 && tileMatrixSet[j-1].m_tileSpanX < tileMatrixSet[j].m_tileSpanX; --j )
+      {
+        std::swap( tileMatrixSet[j-1], tileMatrixSet[j] );
+      }
+    }
+
+    m_tileMatrixSets[identifier] = tileMatrixSet;
+  }
+
+  void WMTSTilePrefetcher::beginView()
+  {
+    m_view.clear();
+  }
+
+  void WMTSTilePrefetcher::tileRequested( const QByteArray &target, const QMap< QByteArray, QByteArray > &parameters,
+                                          const QByteArray &authorization )
+  {
+    if( m_ring <= 0 )
+    {
+      return;
+    }
+
+    bool validRow = false, validCol = false;
+    int row = parameters.value( "TILEROW" ).toInt( &validRow );
+    int col = parameters.value( "TILECOL" ).toInt( &validCol );
+    QByteArray tileMatrix = parameters.value( "TILEMATRIX" );
+    if( !validRow || !validCol || tileMatrix.isEmpty() )
+    {
+      return;
+    }
+
+    // Requests for the same layer only differ in the tile's position
+    QByteArray tileSet = tileTarget( target, QByteArray(), 0, 0 );
+    std::map< QByteArray, ViewedTiles >::iterator viewed = m_view.find( tileSet );
+    if( viewed != m_view.end() && viewed->second.m_tileMatrix == tileMatrix )
+    {
+      ViewedTiles &tiles = viewed->second;
+      tiles.m_minRow = std::min( tiles.m_minRow, row );
+      tiles.m_maxRow = std::max( tiles.m_maxRow, row );
+      tiles.m_minCol = std::min( tiles.m_minCol, col );
+      tiles.m_maxCol = std::max( tiles.m_maxCol, col );
+      return;
+    }
+
+    // The first tile of the layer in this view, or the layer has moved to another tile matrix
+    ViewedTiles tiles;
+    tiles.m_target = target;
+    tiles.m_authorization = authorization;
+    tiles.m_tileMatrixSet = parameters.value( "TILEMATRIXSET" );
+    tiles.m_tileMatrix = tileMatrix;
+    tiles.m_minRow = tiles.m_maxRow = row;
+    tiles.m_minCol = tiles.m_maxCol = col;
+    m_view[tileSet] = tiles;
+  }
+
+  void WMTSTilePrefetcher::plan( std::vector< Tile > &tiles ) const
+  {
+    if( m_ring <= 0 )
+    {
+      return;
+    }
+
+    // Find each layer's tile matrix. Without it the edges of the matrix and its neighbours are unknown.
+    std::vector< std::pair< const ViewedTiles*, const TileMatrixSet* > > layers;
+    std::vector< int > levels;
+    std::map< QByteArray, ViewedTiles >::const_iterator it( m_view.begin() );
+    std::map< QByteArray, ViewedTiles >::const_iterator itE( m_view.end() );
+    for( ; it != itE; ++it )
+    {
+      std::map< QByteArray, TileMatrixSet >::const_iterator tileMatrixSet = m_tileMatrixSets.find( it->second.m_tileMatrixSet );
+      if( tileMatrixSet == m_tileMatrixSets.end() )
+      {
+        continue;
+      }
+
+      int level = findTileMatrix( tileMatrixSet->second, it->second.m_tileMatrix );
+      if( level >= 0 )
+      {
+        layers.push_back( std::make_pair( &it->second, &tileMatrixSet->second ) );
+        levels.push_back( level );
+      }
+    }
+
+    // The rings around the view come first, nearest first, for all layers, as they are what a pan shows next
+    for( int ring = 1; ring <= m_ring; ++ring )
+    {
+      for( size_t i = 0; i < layers.size(); ++i )
+      {
+        const ViewedTiles &viewed = *layers[i].first;
+        const TileMatrix &tileMatrix = (*layers[i].second)[levels[i]];
+
+        int minRow = viewed.m_minRow - ring, maxRow = viewed.m_maxRow + ring;
+        int minCol = viewed.m_minCol - ring, maxCol = viewed.m_maxCol + ring;
+        for( int row = std::max( minRow, 0 ); row <= std::min( maxRow, tileMatrix.m_matrixHeight - 1 ); ++row )
+        {
+          // Rows at the top and bottom of the ring are complete, others only have their ends
+          bool edgeRow = row == minRow || row == maxRow;
+          for( int col = std::max( minCol, 0 ); col <= std::min( maxCol, tileMatrix.m_matrixWidth - 1 ); ++col )
+          {
+            if( edgeRow || col == minCol || col == maxCol )
+            {
+              Tile tile;
+              tile.m_target = tileTarget( viewed.m_target, tileMatrix.m_identifier, row, col );
+              tile.m_authorization = viewed.m_authorization;
+              tiles.push_back( tile );
+            }
+          }
+        }
+      }
+    }
+
+    // Then the view at the coarser matrix, which is few tiles and is shown first when zooming out,
+    // and the view at the finer matrix
+    for( int direction = -1; direction <= 1; direction += 2 )
+    {
+      for( size_t i = 0; i < layers.size(); ++i )
+      {
+        const TileMatrixSet &tileMatrixSet = *layers[i].second;
+        int level = levels[i] + direction;
+        if( level >= 0 && level < (int)tileMatrixSet.size() )
+        {
+          planLevel( *layers[i].first, tileMatrixSet[levels[i]], tileMatrixSet[level], g_maxLevelTiles, tiles );
+        }
+      }
+    }
+  }
+
+  int WMTSTilePrefetcher::findTileMatrix( const TileMatrixSet &tileMatrixSet, const QByteArray &identifier ) const
+  {
+    for( size_t i = 0; i < tileMatrixSet.size(); ++i )
+    {
+      if( tileMatrixSet[i].m_identifier == identifier )
+      {
+        return (int)i;
+      }
+    }
+    return -1;
+  }
+
+  void WMTSTilePrefetcher::planLevel( const ViewedTiles &viewed, const TileMatrix &from, const TileMatrix &to,
+                                      size_t maxTiles, std::vector< Tile > &tiles ) const
+  {
+    // The area of the view in the tile matrix set's coordinate system
+    double x1 = from.m_left + viewed.m_minCol * from.m_tileSpanX;
+    double x2 = from.m_left + (viewed.m_maxCol + 1) * from.m_tileSpanX;
+    double y1 = from.m_top - viewed.m_minRow * from.m_tileSpanY;
+    double y2 = from.m_top - (viewed.m_maxRow + 1) * from.m_tileSpanY;
+
+    // Shrink the area slightly so tiles that only share an edge with it are not included
+    double marginX = to.m_tileSpanX * 1e-6, marginY = to.m_tileSpanY * 1e-6;
+    int minCol = std::max( (int)floor( (x1 + marginX - to.m_left) / to.m_tileSpanX ), 0 );
+    int maxCol = std::min( (int)floor( (x2 - marginX - to.m_left) / to.m_tileSpanX ), to.m_matrixWidth - 1 );
+    int minRow = std::max( (int)floor( (to.m_top - y1 + marginY) / to.m_tileSpanY ), 0 );
+    int maxRow = std::min( (int)floor( (to.m_top - y2 - marginY) / to.m_tileSpanY ), to.m_matrixHeight - 1 );
+
+    // Keep the tiles nearest the centre of the view if there are too many
+    double centreRow = (minRow + maxRow) / 2.0, centreCol = (minCol + maxCol) / 2.0;
+    std::vector< TileDistance > levelTiles;
+    for( int row = minRow; row <= maxRow; ++row )
+    {
+      for( int col = minCol; col <= maxCol; ++col )
+      {
+        TileDistance tile;
+        tile.m_distance = (row - centreRow) * (row - centreRow) + (col - centreCol) * (col - centreCol);
+        tile.m_row = row;
+        tile.m_col = col;
+        levelTiles.push_back( tile );
+      }
+    }
+    std::sort( levelTiles.begin(), levelTiles.end() );
+
+    for( size_t i = 0; i < levelTiles.size() && i < maxTiles; ++i )
+    {
+      Tile tile;
+      tile.m_target = tileTarget( viewed.m_target, to.m_identifier, levelTiles[i].m_row, levelTiles[i].m_col );
+      tile.m_authorization = viewed.m_authorization;
+      tiles.push_back( tile );
+    }
+  }
+
+  QByteArray WMTSTilePrefetcher::tileTarget( const QByteArray &target, const QByteArray &tileMatrix, int row, int col )
+  {
+    int queryStart = target.indexOf( '?' );
+    if( queryStart < 0 )
+    {
+      return target;
+    }
+
+    // Replace the tile's position, leaving the other parameters as the data layer sent them
+    QList< QByteArray > queryItems = target.mid( queryStart + 1 ).split( '&' );
+    for( int i = 0; i < queryItems.size(); ++i )
+    {
+      int separator = queryItems[i].indexOf( '=' );
+      QByteArray name = queryItems[i].left( separator );
+      QByteArray upperName = QByteArray::fromPercentEncoding( name ).toUpper();
+      if( upperName == "TILEMATRIX" )
+      {
+        queryItems[i] = name + "=" + tileMatrix.toPercentEncoding();
+      }
+      else if( upperName == "TILEROW" )
+      {
+        queryItems[i] = name + "=" + QByteArray::number( row );
+      }
+      else if( upperName == "TILECOL" )
+      {
+        queryItems[i] = name + "=" + QByteArray::number( col );
+      }
+    }
+
+    QByteArray result = target.left( queryStart + 1 );
+    for( int i = 0; i < queryItems.size(); ++i )
+    {
+      if( i > 0 )
+      {
+        result += "&";
+      }
+      result += queryItems[i];
+    }
+    return result;
+  }
+};
@@ -0,0 +1,122 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#ifndef WMTSTILEPREFETCHER_H
+#define WMTSTILEPREFETCHER_H
+
+#include <map>
+#include <vector>
+
+#include <QByteArray>
+#include <QMap>
+
+class QXmlStreamReader;
+
+// Works out which tiles the service proxy should fetch ahead of the data layer.
+//
+// The proxy does not know the extent of the view, but the data layer asks for the tiles it needs
+// to draw a view together. The prefetcher records the range of tiles asked for since the view last
+// changed, for each combination of server, layer, style, tile matrix set and dimension values, and
+// plans the tiles in a ring around that range, nearest first, followed by the tiles covering the
+// range at the next coarser and next finer tile matrices.
+//
+// Tile matrices are read from the capabilities documents that pass through the proxy. Only
+// key-value-pair GetTile requests are planned, as RESTful tile addresses cannot be modified
+// without knowing their template.
+//
+// The prefetcher is not thread safe; it is only used from the service proxy's thread.
+
+namespace Services
+{
+  class WMTSTilePrefetcher
+  {
+    public:
+      // A tile to prefetch
+      struct Tile
+      {
+        // The proxied path and query for the tile, as the data layer would have requested it
+        QByteArray m_target;
+        QByteArray m_authorization;
+      };
+
+      WMTSTilePrefetcher();
+
+      // The number of tiles around the view to prefetch at its tile matrix. 0 disables prefetching.
+      void setRing( int ring );
+      int ring() const;
+
+      // Reads the tile matrix sets from a capabilities document
+      void addCapabilities( const QByteArray &document );
+
+      // Forgets the tiles of the previous view
+      void beginView();
+
+      // Records a GetTile request made by the data layer. Parameter names must be in upper case.
+      void tileRequested( const QByteArray &target, const QMap< QByteArray, QByteArray > &parameters,
+                          const QByteArray &authorization );
+
+      // Lists the tiles to prefetch for the tiles recorded since beginView, in the order they should be fetched
+      void plan( std::vector< Tile > &tiles ) const;
+
+      // Builds the target for another tile from the target of a requested one. With an empty tile
+      // matrix this identifies the layer a tile belongs to.
+      static QByteArray tileTarget( const QByteArray &target, const QByteArray &tileMatrix, int row, int col );
+
+    private:
+      struct TileMatrix
+      {
+        QByteArray m_identifier;
+
+        // Size of a tile in the units of the tile matrix set's coordinate system
+        double m_tileSpanX;
+        double m_tileSpanY;
+
+        double m_left;
+        double m_top;
+        int m_matrixWidth;
+        int m_matrixHeight;
+      };
+
+      // Tile matrices ordered from coarsest to finest
+      typedef std::vector< TileMatrix > TileMatrixSet;
+
+      // The range of tiles requested at one tile matrix
+      struct ViewedTiles
+      {
+        QByteArray m_target;
+        QByteArray m_authorization;
+        QByteArray m_tileMatrixSet;
+        QByteArray m_tileMatrix;
+        int m_minRow;
+        int m_maxRow;
+        int m_minCol;
+        int m_maxCol;
+      };
+
+      // Reads a TileMatrixSet element from the service's contents
+      void readTileMatrixSet( QXmlStreamReader &reader );
+
+      // Finds a tile matrix, returning its index or -1
+      int findTileMatrix( const TileMatrixSet &tileMatrixSet, const QByteArray &identifier ) const;
+
+      // Adds the tiles covering a range of another tile matrix of the same set
+      void planLevel( const ViewedTiles &viewed, const TileMatrix &from, const TileMatrix &to,
+                      size_t maxTiles, std::vector< Tile > &tiles ) const;
+
+      int m_ring;
+
+      // Tile matrix sets by identifier. Sets from different servers with the same identifier are expected
+      // to be the same well known set.
+      std::map< QByteArray, TileMatrixSet > m_tileMatrixSets;
+
+      // Tiles requested since the view changed, keyed by everything in the request except the tile's position
+      std::map< QByteArray, ViewedTiles > m_view;
+  };
+
+  inline int WMTSTilePrefetcher::ring() const
+  {
+    return m_ring;
+  }
+};
+#endif
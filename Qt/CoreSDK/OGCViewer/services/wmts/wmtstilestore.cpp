@@ -0,0 +1,280 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#include <set>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "wmtstilestore.h"
+
+namespace Services
+{
+  // Identifies the index file format
+  static const quint32 g_indexMagic = 0x574d5453;
+  static const quint32 g_indexVersion = 1;
+  static const char *g_indexFileName = "index.dat";
+
+  WMTSTileStore::Entry::Entry()
+    : m_expiry( 0 )
+    , m_size( 0 )
+  {
+  }
+
+  WMTSTileStore::WMTSTileStore( const QString &directory, qint64 maximumSize )
+    : m_directory( directory )
+    , m_maximumSize( maximumSize )
+    , m_size( 0 )
+    , m_indexChanged( false )
+    , m_usageChanged( false )
+  {
+  }
+
+  WMTSTileStore::~WMTSTileStore()
+  {
+    // Keep the order the responses were used in for the next session
+    m_indexChanged = m_indexChanged || m_usageChanged;
+    save();
+  }
+
+  void WMTSTileStore::open()
+  {
+    QDir().mkpath( m_directory );
+
+    m_index.clear();
+    m_usage.clear();
+    m_size = 0;
+
+    QFile indexFile( m_directory + "/" + g_indexFileName );
+    bool indexValid = false;
+    if( indexFile.open( QIODevice::ReadOnly ) )
+    {
+      QDataStream stream( &indexFile );
+      quint32 magic = 0, version = 0, numEntries = 0;
+      stream >> magic >> version >> numEntries;
+      if( magic == g_indexMagic && version == g_indexVersion )
+      {
+        // Entries are written from most to least recently used
+        for( quint32 i = 0; i < numEntries && stream.status() == QDataStream::Ok; ++i )
+        {
+          QByteArray key;
+          IndexEntry indexEntry;
+          stream >> key >> indexEntry.m_entry.m_contentType >> indexEntry.m_entry.m_etag >> indexEntry.m_entry.m_lastModified
+                 >> indexEntry.m_entry.m_expiry >> indexEntry.m_entry.m_size;
+          if( stream.status() != QDataStream::Ok || m_index.find( key ) != m_index.end() )
+          {
+            break;
+          }
+
+          indexEntry.m_usage = m_usage.insert( m_usage.end(), key );
+          m_index.insert( std::make_pair( key, indexEntry ) );
+          m_size += indexEntry.m_entry.m_size;
+        }
+        indexValid = stream.status() == QDataStream::Ok && m_index.size() == numEntries;
+      }
+    }
+
+    if( !indexValid )
+    {
+      // Without an index the files in the store cannot be used
+      m_index.clear();
+      m_usage.clear();
+      m_size = 0;
+      removeFiles();
+      m_indexChanged = true;
+      return;
+    }
+
+    // Remove files written after the index was last saved, for example if the application did not
+    // exit normally, as they are not accounted for in the size of the store
+    std::set< QString > indexedFiles;
+    Index::iterator it( m_index.begin() );
+    Index::iterator itE( m_index.end() );
+    for( ; it != itE; ++it )
+    {
+      indexedFiles.insert( QFileInfo( filePath( it->first ) ).fileName() );
+    }
+
+    QDirIterator files( m_directory, QStringList() << "*.tile", QDir::Files, QDirIterator::Subdirectories );
+    while( files.hasNext() )
+    {
+      files.next();
+      if( indexedFiles.find( files.fileName() ) == indexedFiles.end() )
+      {
+        QFile::remove( files.filePath() );
+      }
+    }
+
+    // The maximum size may have been reduced since the last session
+    evict();
+  }
+
+  void WMTSTileStore::save()
+  {
+    if( !m_indexChanged )
+    {
+      return;
+    }
+
+    QSaveFile indexFile( m_directory + "/" + g_indexFileName );
+    if( !indexFile.open( QIODevice::WriteOnly ) )
+    {
+      return;
+    }
+
+    QDataStream stream( &indexFile );
+    stream << g_indexMagic << g_indexVersion << (quint32)m_index.size();
+
+    std::list< QByteArray >::const_iterator it( m_usage.begin() );
+    std::list< QByteArray >::const_iterator itE( m_usage.end() );
+    for( ; it != itE; ++it )
+    {
+      const Entry &entry = m_index[*it].m_entry;
+      stream << *it << entry.m_contentType << entry.m_etag << entry.m_lastModified << entry.m_expiry << entry.m_size;
+    }
+
+    if( indexFile.commit() )
+    {
+      m_indexChanged = false;
+      m_usageChanged = false;
+    }
+  }
+
+  bool WMTSTileStore::find( const QByteArray &key, Entry &entry, QByteArray &data )
+  {
+    Index::iterator it = m_index.find( key );
+    if( it == m_index.end() )
+    {
+      return false;
+    }
+
+    QFile file( filePath( key ) );
+    if( !file.open( QIODevice::ReadOnly ) || file.size() != it->second.m_entry.m_size )
+    {
+      // The file has been removed or damaged outside of the store
+      remove( it );
+      return false;
+    }
+    data = file.readAll();
+
+    // Make this the most recently used entry. Only the order changes, which is written with the next
+    // change to the responses stored, or when the store is closed.
+    m_usage.splice( m_usage.begin(), m_usage, it->second.m_usage );
+    m_usageChanged = true;
+
+    entry = it->second.m_entry;
+    return true;
+  }
+
+  bool WMTSTileStore::findEntry( const QByteArray &key, Entry &entry ) const
+  {
+    Index::const_iterator it = m_index.find( key );
+    if( it == m_index.end() )
+    {
+      return false;
+    }
+
+    entry = it->second.m_entry;
+    return true;
+  }
+
+  void WMTSTileStore::store( const QByteArray &key, const QByteArray &data, const Entry &entry )
+  {
+    Index::iterator existing = m_index.find( key );
+    if( existing != m_index.end() )
+    {
+      remove( existing );
+    }
+
+    if( data.size() > m_maximumSize )
+    {
+      return;
+    }
+
+    QString path = filePath( key );
+    QDir().mkpath( QFileInfo( path ).path() );
+
+    QSaveFile file( path );
+    if( !file.open( QIODevice::WriteOnly ) || file.write( data ) != data.size() || !file.commit() )
+    {
+      return;
+    }
+
+    IndexEntry indexEntry;
+    indexEntry.m_entry = entry;
+    indexEntry.m_entry.m_size = data.size();
+    indexEntry.m_usage = m_usage.insert( m_usage.begin(), key );
+    m_index.insert( std::make_pair( key, indexEntry ) );
+    m_size += data.size();
+    m_indexChanged = true;
+
+    evict();
+  }
+
+  void WMTSTileStore::refresh( const QByteArray &key, qint64 expiry )
+  {
+    Index::iterator it = m_index.find( key );
+    if( it != m_index.end() )
+    {
+      it->second.m_entry.m_expiry = expiry;
+      m_indexChanged = true;
+    }
+  }
+
+  void WMTSTileStore::clear()
+  {
+    m_index.clear();
+    m_usage.clear();
+    m_size = 0;
+    removeFiles();
+
+    m_indexChanged = true;
+    save();
+  }
+
+  void WMTSTileStore::setMaximumSize( qint64 maximumSize )
+  {
+    m_maximumSize = maximumSize;
+    evict();
+  }
+
+  QString WMTSTileStore::filePath( const QByteArray &key ) const
+  {
+    // Spread the files over subdirectories to keep the size of each directory reasonable
+    QByteArray hash = QCryptographicHash::hash( key, QCryptographicHash::Sha1 ).toHex();
+    return m_directory + "/" + QString::fromLatin1( hash.left( 2 ) ) + "/" + QString::fromLatin1( hash ) + ".tile";
+  }
+
+  void WMTSTileStore::remove( Index::iterator entry )
+  {
+    QFile::remove( filePath( entry->first ) );
+    m_size -= entry->second.m_entry.m_size;
+    m_usage.erase( entry->second.m_usage );
+    m_index.erase( entry );
+    m_indexChanged = true;
+  }
+
+  void WMTSTileStore::evict()
+  {
+    while( m_size > m_maximumSize && !m_usage.empty() )
+    {
+      remove( m_index.find( m_usage.back() ) );
+    }
+  }
+
+  void WMTSTileStore::removeFiles()
+  {
+    QDirIterator files( m_directory, QStringList() << "*.tile", QDir::Files, QDirIterator::Subdirectories );
+    while( files.hasNext() )
+    {
+      QFile::remove( files.next() );
+    }
+    QFile::remove( m_directory + "/" + g_indexFileName );
+  }
+};
@@ -0,0 +1,120 @@
+/****************************************************************************
+  Copyright (c) 2017 by Envitia Group PLC.
+ ****************************************************************************/
+
+#ifndef WMTSTILESTORE_H
+#define WMTSTILESTORE_H
+
+#include <list>
+#include <map>
+
+#include <QByteArray>
+#include <QString>
+
+// A size limited store of WMTS responses on disk that persists between sessions.
+// Each response is kept in its own file, named from a hash of its key. An index of the
+// keys, in least recently used order, and the information needed to revalidate each
+// response with the server is written to the store directory when the store is saved.
+// When the store is larger than its maximum size, the least recently used responses
+// are removed.
+//
+// The store is not thread safe; it is only used from the service proxy's thread.
+
+namespace Services
+{
+  class WMTSTileStore
+  {
+    public:
+      struct Entry
+      {
+        Entry();
+
+        QByteArray m_contentType;
+
+        // Validators to send to the server when the entry has expired
+        QByteArray m_etag;
+        QByteArray m_lastModified;
+
+        // When the entry expires, in milliseconds since the epoch
+        qint64 m_expiry;
+
+        qint64 m_size;
+      };
+
+      WMTSTileStore( const QString &directory, qint64 maximumSize );
+      ~WMTSTileStore();
+
+      // Reads the index of a previous session. If there is no usable index, any files left
+      // in the store directory are removed.
+      void open();
+
+      // Writes the index if a response has been stored, removed or refreshed since it was last written.
+      // A change in the order the responses were used in alone is only written when the store is destroyed.
+      void save();
+
+      // Looks up the response stored under key, marking it as the most recently used. Returns false
+      // if there is no response, or its file can no longer be read.
+      bool find( const QByteArray &key, Entry &entry, QByteArray &data );
+
+      // Looks up the information for the response stored under key, without reading it or changing
+      // its use. Returns false if there is no response.
+      bool findEntry( const QByteArray &key, Entry &entry ) const;
+
+      // Stores a response, replacing any previous response with the same key
+      void store( const QByteArray &key, const QByteArray &data, const Entry &entry );
+
+      // Updates the expiry of a stored response after the server confirmed it is unchanged
+      void refresh( const QByteArray &key, qint64 expiry );
+
+      // Removes all stored responses
+      void clear();
+
+      // Changes the maximum size of the store in bytes, removing responses if necessary. A size
+      // of 0 disables the store.
+      void setMaximumSize( qint64 maximumSize );
+      qint64 maximumSize() const;
+
+      qint64 size() const;
+      size_t numEntries() const;
+
+    private:
+      struct IndexEntry
+      {
+        Entry m_entry;
+        std::list< QByteArray >::iterator m_usage;
+      };
+      typedef std::map< QByteArray, IndexEntry > Index;
+
+      QString filePath( const QByteArray &key ) const;
+      void remove( Index::iterator entry );
+      void evict();
+      void removeFiles();
+
+      QString m_directory;
+      qint64 m_maximumSize;
+      qint64 m_size;
+      bool m_indexChanged;
+      bool m_usageChanged;
+
+      Index m_index;
+
+      // Keys ordered from most to least recently used
+      std::list< QByteArray > m_usage;
+  };
+
+  inline qint64 WMTSTileStore::maximumSize() const
+  {
+    return m_maximumSize;
+  }
+
+  inline qint64 WMTSTileStore::size() const
+  {
+    return m_size;
+  }
+
+  inline size_t WMTSTileStore::numEntries() const
+  {
+    return m_index.size();
+  }
+};
+#endif
@@ -114,6 +114,9 @@ void EditDimensionDialog::accept()
     m_dimensionModel->setData( m_dimensionModelIndex, m_comboEdit->currentText(), Qt::EditRole );
   }
 
+  // The new value may be shown by a different data layer of the service, which the service list swaps into the view
+  m_serviceList->serviceLayersChanged( m_service );
+
   // Since we've changed the value of a dimension, ask for a redraw of the relevant drawing surfaces
   m_serviceList->redrawAttachedSurface();
 
@@ -18,9 +18,27 @@ GeneralOptionsDialog::GeneralOptionsDialog( ServiceList *serviceList, QWidget *p
   setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
 
   connect(pushButtonClearCredentials, SIGNAL(clicked(bool)), this, SLOT(clearCredentials()));
+  connect(pushButtonClearTileStore, SIGNAL(clicked(bool)), this, SLOT(clearTileStore()));
 
   numConnections->setValue( m_serviceList->numConnections() );
+  connectionsPerServer->setValue( m_serviceList->connectionsPerServer() );
   cacheSize->setValue( m_serviceList->cacheSizes() );
+  tileStoreSize->setValue( m_serviceList->tileStoreSize() );
+  prefetchRing->setValue( m_serviceList->tilePrefetchRing() );
+  prefetchBudget->setValue( m_serviceList->tilePrefetchBudget() );
+  frameRate->setValue( (int)m_serviceList->animationFrameRate() );
+  framesAhead->setValue( m_serviceList->animationFramesAhead() );
+  frameCacheSize->setValue( m_serviceList->animationFrameCacheSize() );
+
+  // Without the service proxy WMTS services are loaded directly, so nothing is stored or scheduled
+  bool tileStoreAvailable = m_serviceList->getServiceProxy() != NULL;
+  tileStoreSize->setEnabled( tileStoreAvailable );
+  pushButtonClearTileStore->setEnabled( tileStoreAvailable );
+  prefetchRing->setEnabled( tileStoreAvailable );
+  prefetchBudget->setEnabled( tileStoreAvailable );
+  connectionsPerServer->setEnabled( tileStoreAvailable );
+  framesAhead->setEnabled( tileStoreAvailable );
+  frameCacheSize->setEnabled( tileStoreAvailable );
 }
 
 GeneralOptionsDialog::~GeneralOptionsDialog()
@@ -31,6 +49,25 @@ void GeneralOptionsDialog::accept()
 {
   m_serviceList->setNumConnections( numConnections->value() );
   m_serviceList->setCacheSizes( cacheSize->value() );
+  if( connectionsPerServer->value() != m_serviceList->connectionsPerServer() )
+  {
+    m_serviceList->setConnectionsPerServer( connectionsPerServer->value() );
+  }
+  if( tileStoreSize->value() != m_serviceList->tileStoreSize() )
+  {
+    m_serviceList->setTileStoreSize( tileStoreSize->value() );
+  }
+  if( prefetchRing->value() != m_serviceList->tilePrefetchRing() ||
+      prefetchBudget->value() != m_serviceList->tilePrefetchBudget() )
+  {
+    m_serviceList->setTilePrefetch( prefetchRing->value(), prefetchBudget->value() );
+  }
+  if( frameRate->value() != (int)m_serviceList->animationFrameRate() ||
+      framesAhead->value() != m_serviceList->animationFramesAhead() ||
+      frameCacheSize->value() != m_serviceList->animationFrameCacheSize() )
+  {
+    m_serviceList->setAnimationSettings( frameRate->value(), framesAhead->value(), frameCacheSize->value() );
+  }
 
   QDialog::accept();
 }
@@ -42,3 +79,11 @@ void GeneralOptionsDialog::clearCredentials()
   msgBox.setText("The credentials cache has been cleared.");
   msgBox.exec();
 }
+
+void GeneralOptionsDialog::clearTileStore()
+{
+  m_serviceList->clearTileStore();
+  QMessageBox msgBox;
+  msgBox.setText("The tile store has been cleared.");
+  msgBox.exec();
+}
@@ -26,6 +26,7 @@ public:
     
 private slots:
   void clearCredentials();
+  void clearTileStore();
 
 private:
   Services::ServiceList *m_serviceList;
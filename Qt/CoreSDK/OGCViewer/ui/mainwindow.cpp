@@ -260,3 +260,18 @@ QMainWindow* MainWindow::mainWindowInstance()
 {
   return g_mainWindowInstance;
 }
+
+bool MainWindow::runBenchmark( const ViewBenchmark::Settings &settings, QString &error )
+{
+  // The benchmark is deleted along with the window
+  ViewBenchmark *benchmark = new ViewBenchmark( m_services, maplinkSurface, this );
+  connect( this, SIGNAL(signalSetLoadingAnimationState(bool)), benchmark, SLOT(loadingStateChanged(bool)) );
+  return benchmark->start( settings, error );
+}
+
+void MainWindow::runPreviewBenchmark( const PreviewBenchmark::Settings &settings )
+{
+  // The benchmark is deleted along with the window
+  PreviewBenchmark *benchmark = new PreviewBenchmark( m_services, this );
+  benchmark->start( settings );
+}
@@ -8,6 +8,8 @@
 #include <QMainWindow>
 #include <QMovie>
 #include "ui_mainwindow.h"
+#include "benchmark/viewbenchmark.h"
+#include "benchmark/previewbenchmark.h"
 
 #include "tslloaderstatus.h"
 #include "tslloadercallbackreturn.h"
@@ -43,6 +45,15 @@ public:
     // as their parent.
     static QMainWindow* mainWindowInstance();
 
+    // Loads a service and runs a scripted benchmark against it, exiting the application when
+    // the benchmark finishes. Returns false, with a description of the problem in error, if the
+    // benchmark cannot be started.
+    bool runBenchmark( const ViewBenchmark::Settings &settings, QString &error );
+
+    // Loads a service's capabilities and times previewing its layers, exiting the application
+    // when the benchmark finishes
+    void runPreviewBenchmark( const PreviewBenchmark::Settings &settings );
+
 signals:
     void signalSetLoadingAnimationState( bool running );
 
@@ -70,7 +70,7 @@ void WMSServiceOptionsPage::initializePage()
   }
 
   // Ensure the default setting for transparency in the data layer matches the UI state
-  wmsLayer->setTransparent( useTransparentImages->checkState() == Qt::Checked );
+  m_service->setTransparentRequests( useTransparentImages->checkState() == Qt::Checked );
 
   // Create the list of supported image formats for this service
   QString currentImageFormat( QString::fromUtf8( wmsLayer->getCurrentImageRequestFormat() ) );
@@ -93,14 +93,12 @@ int WMSServiceOptionsPage::nextId() const
 
 void WMSServiceOptionsPage::tileLevelSettingChanged( int newIndex )
 {
-  TSLWMSDataLayer *wmsLayer = reinterpret_cast< TSLWMSDataLayer* >( m_service->dataLayer() );
-  wmsLayer->tileLevelStrategy( (TSLWMSDataLayer::TileLevelStrategy)tileLevels->itemData( newIndex ).toInt() );
+  m_service->setTileLevelStrategy( (TSLWMSDataLayer::TileLevelStrategy)tileLevels->itemData( newIndex ).toInt() );
 }
 
 void WMSServiceOptionsPage::tileLoadOrderSettingChanged( int newIndex )
 {
-  TSLWMSDataLayer *wmsLayer = reinterpret_cast< TSLWMSDataLayer* >( m_service->dataLayer() );
-  wmsLayer->tileLoadOrder( (TSLWMSDataLayer::TileLoadOrderStrategy)tileRequestOrder->itemData( newIndex ).toInt() );
+  m_service->setTileLoadOrder( (TSLWMSDataLayer::TileLoadOrderStrategy)tileRequestOrder->itemData( newIndex ).toInt() );
 }
 
 void WMSServiceOptionsPage::setBackgroundColourButtonState( int enabled )
@@ -125,8 +123,7 @@ void WMSServiceOptionsPage::setBackgroundColour()
 
 void WMSServiceOptionsPage::setTransparentRequests( int enabled )
 {
-  TSLWMSDataLayer *wmsLayer = reinterpret_cast< TSLWMSDataLayer* >( m_service->dataLayer() );
-  wmsLayer->setTransparent( enabled == Qt::Checked );
+  m_service->setTransparentRequests( enabled == Qt::Checked );
 }
 
 void WMSServiceOptionsPage::setNewBackgroundColour( const QColor &newColour )
@@ -12,6 +12,7 @@
 #include "layerpropertiesdialog.h"
 #include "services/servicelistmodel.h"
 #include "services/servicelist.h"
+#include "services/wms/wmsanimation.h"
 
 using namespace Services;
 
@@ -198,6 +199,33 @@ void ServiceTreeView::setServiceProperties()
   }
 }
 
+void ServiceTreeView::animateDimension()
+{
+  QObject *activatedItem = sender();
+  if( activatedItem )
+  {
+    QAction *sourceAction = qobject_cast< QAction* >( activatedItem );
+    if( sourceAction )
+    {
+      ServiceListModel *serviceModel = reinterpret_cast< ServiceListModel* >( model() );
+      Service *service = serviceModel->getService( sourceAction->data() );
+      if( !service )
+      {
+        return;
+      }
+
+      // The name of the dimension to animate is contained in the text of the action that triggered this slot
+      serviceModel->serviceList()->startAnimation( service, sourceAction->text().toUtf8().constData() );
+    }
+  }
+}
+
+void ServiceTreeView::stopAnimation()
+{
+  ServiceListModel *serviceModel = reinterpret_cast< ServiceListModel* >( model() );
+  serviceModel->serviceList()->stopAnimation();
+}
+
 void ServiceTreeView::showContextMenuForService( ServiceListModel *model, const QModelIndex &serviceIndex, const QPoint &menuLocation )
 {
   QMenu *contextMenu = new QMenu( this );
@@ -234,6 +262,12 @@ void ServiceTreeView::showContextMenuForService( ServiceListModel *model, const
   QAction *propertiesAction = contextMenu->addAction( "Properties", this, SLOT(setServiceProperties()) );
   propertiesAction->setData( nodeData );
 
+  WMSAnimation *animation = model->serviceList()->getAnimation();
+  if( animation && animation->service() == model->getService( nodeData ) )
+  {
+    contextMenu->addAction( "Stop animation", this, SLOT(stopAnimation()) );
+  }
+
   contextMenu->popup( menuLocation );
 }
 
@@ -259,6 +293,27 @@ void ServiceTreeView::showContextMenuForLayer( ServiceListModel *model, const QM
     }
   }
 
+  // Dimensions of WMS layers can be played through their values. The animation steps every visible layer of
+  // the service that has the dimension.
+  Service *service = model->getService( nodeData );
+  if( !layerDimensions.empty() && service && service->type() == ServiceTypeWMS )
+  {
+    QMenu *animateSubMenu = contextMenu->addMenu( "Animate Dimension" );
+    size_t numDimensions = layerDimensions.size();
+
+    for( size_t i = 0; i < numDimensions; ++i )
+    {
+      QAction *animateAction = animateSubMenu->addAction( layerDimensions[i].c_str(), this, SLOT(animateDimension()) );
+      animateAction->setData( nodeData );
+    }
+  }
+
+  WMSAnimation *animation = model->serviceList()->getAnimation();
+  if( animation && animation->service() == service )
+  {
+    contextMenu->addAction( "Stop Animation", this, SLOT(stopAnimation()) );
+  }
+
   // Offer a submenu offering the ability to change the current style of the layer
   std::vector< std::string > layerStyles;
   model->getLayerStyleNames( layerIndex, layerStyles );
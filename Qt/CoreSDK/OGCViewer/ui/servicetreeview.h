@@ -28,6 +28,8 @@ private slots:
   void changeStyleValue();
   void zoomToSelection();
   void setServiceProperties();
+  void animateDimension();
+  void stopAnimation();
 
 protected:
   virtual void contextMenuEvent(QContextMenuEvent * event);
@@ -46,9 +46,8 @@ void ServiceWizard::setService( Service *newService )
   newService->useTransformParametersFromLayer( m_coordinateProvidingLayer );
 
   // Tell the service's data layer to use the common remote loader we share between all data layers
-  TSLDataLayer *serviceLayer = m_connectedService->dataLayer();
-  serviceLayer->addLoader( m_serviceList->getCommonLoader(), ServiceList::loadCallback, m_serviceList,
-                           ServiceList::allLoadedCallback, m_serviceList );
+  m_connectedService->setLoader( m_serviceList->getCommonLoader(), ServiceList::loadCallback, m_serviceList,
+                                 ServiceList::allLoadedCallback, m_serviceList );
 
   // Inform the subsequent pages of the wizard of the service option they need to
   // use when configuring the service setup
@@ -60,6 +59,8 @@ void ServiceWizard::setService( Service *newService )
   switch( newService->type() )
   {
   case ServiceTypeWMS:
+    // Load the service through the service proxy so that the frames of an animation can be fetched ahead
+    ((WMSService*)newService)->setServiceProxy( m_serviceList->getServiceProxy() );
     addWMSServicePage->setService( (WMSService*)newService );
     wmsServiceOptionsPage->setService( (WMSService*)newService );
     addWMTSServicePage->setService( NULL );
@@ -67,6 +68,8 @@ void ServiceWizard::setService( Service *newService )
     break;
 
   case ServiceTypeWMTS:
+    // Load the service through the service proxy so that its tiles are kept between sessions
+    ((WMTSService*)newService)->setServiceProxy( m_serviceList->getServiceProxy() );
     addWMTSServicePage->setService( (WMTSService*)newService );
     wmtsServiceOptionsPage->setService( (WMTSService*)newService );
     addWMSServicePage->setService( NULL );
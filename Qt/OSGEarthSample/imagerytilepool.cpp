@@ -0,0 +1,500 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "imagerytilepool.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include <QAtomicInt>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <osg/Timer>
+#include <osgDB/Registry>
+#include <osgEarth/Progress>
+#include <osgEarth/TileKey>
+
+#define MAPLINK_NO_DRAWING_SURFACE
+#include <osgEarthMapLink/DataLayerTileSource.h>
+
+#include "osgearthsampleconfig.h"
+
+// Number of tiles requested between reports of the statistics
+static const size_t reportInterval = 100;
+
+// Format the tiles are stored in in the disk cache
+static const char* cacheImageFormat = "png";
+
+// Draws the tiles of a list, sharing it with the other workers
+class TileDrawWorker : public QThread
+{
+public:
+  TileDrawWorker(ImageryTilePool* pool, const std::vector<osgEarth::TileKey>& keys, QAtomicInt& next)
+    : m_pool( pool )
+    , m_keys( keys )
+    , m_next( next )
+  {
+  }
+
+protected:
+  virtual void run()
+  {
+    int index;
+    while( (index = m_next.fetchAndAddOrdered(1)) < (int)m_keys.size() )
+    {
+      osg::ref_ptr<osg::Image> image = m_pool->createImage( m_keys[index], NULL );
+    }
+  }
+
+private:
+  ImageryTilePool* m_pool;
+  const std::vector<osgEarth::TileKey>& m_keys;
+  QAtomicInt& m_next;
+};
+
+ImageryTilePool::ImageryTilePool(const osgEarth::TileSourceOptions& options, Factory* factory, unsigned int maxRenderers)
+  : osgEarth::TileSource( options )
+  , m_factory( factory )
+  , m_maxRenderers( maxRenderers < 1 ? 1 : maxRenderers )
+  , m_baseTileSize( options.tileSize().value() )
+  , m_foregroundWaiting( 0 )
+  , m_backgroundBusy( 0 )
+  , m_requests( 0 )
+  , m_cache( NULL )
+{
+  resetStatistics();
+
+  Renderer renderer;
+  renderer.m_source = m_factory->createRenderer( m_baseTileSize );
+  renderer.m_tileSize = m_baseTileSize;
+  renderer.m_busy = false;
+  if( renderer.m_source.valid() )
+  {
+    m_renderers.push_back( renderer );
+    m_statistics.m_renderers = 1;
+  }
+}
+
+ImageryTilePool::~ImageryTilePool()
+{
+  delete m_cache;
+}
+
+bool ImageryTilePool::valid() const
+{
+  return !m_renderers.empty();
+}
+
+int ImageryTilePool::tileSizeForLevel(unsigned int level)
+{
+  if( level < IMAGERY_COARSELEVELS )
+  {
+    return IMAGERY_COARSETILESIZE;
+  }
+  if( level >= IMAGERY_DETAILLEVEL )
+  {
+    return IMAGERY_DETAILTILESIZE;
+  }
+  return IMAGERY_TILESIZE;
+}
+
+void ImageryTilePool::setCache(TileDiskCache* cache)
+{
+  delete m_cache;
+  m_cache = cache;
+}
+
+TileDiskCache* ImageryTilePool::cache() const
+{
+  return m_cache;
+}
+
+void ImageryTilePool::tilesCovering(const osgEarth::GeoExtent& extent, unsigned int minLevel, unsigned int maxLevel,
+                                    std::vector<osgEarth::TileKey>& keys) const
+{
+  for( unsigned int level = minLevel; level <= maxLevel; ++level )
+  {
+    std::vector<osgEarth::TileKey> levelKeys;
+    getProfile()->getIntersectingTiles( extent, level, levelKeys );
+    keys.insert( keys.end(), levelKeys.begin(), levelKeys.end() );
+  }
+}
+
+double ImageryTilePool::drawTiles(const std::vector<osgEarth::TileKey>& keys, unsigned int numThreads)
+{
+  // Tiles already cached don't need drawing
+  std::vector<osgEarth::TileKey> toDraw;
+  for( std::vector<osgEarth::TileKey>::const_iterator key = keys.begin(); key != keys.end(); ++key )
+  {
+    if( !isCached(*key) )
+    {
+      toDraw.push_back( *key );
+    }
+  }
+
+  QAtomicInt next( 0 );
+  std::vector<TileDrawWorker*> workers;
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+  for( unsigned int i = 0; i < numThreads; ++i )
+  {
+    workers.push_back( new TileDrawWorker( this, toDraw, next ) );
+    workers.back()->start();
+  }
+  for( unsigned int i = 0; i < numThreads; ++i )
+  {
+    workers[i]->wait();
+    delete workers[i];
+  }
+  return osg::Timer::instance()->delta_m( startTick, osg::Timer::instance()->tick() );
+}
+
+osgEarth::TileSource::Status ImageryTilePool::initialize(const osgDB::Options* dbOptions)
+{
+  if( m_renderers.empty() )
+  {
+    return Status::Error( "No MapLink renderer could be created" );
+  }
+
+  // Every renderer draws the same data, so they share the profile and extents of the first
+  envitia::MapLink::DataLayerTileSource* first = m_renderers.front().m_source.get();
+  setProfile( first->getProfile() );
+  getDataExtents() = first->getDataExtents();
+  return STATUS_OK;
+}
+
+osg::Image* ImageryTilePool::createImage(const osgEarth::TileKey& key, osgEarth::ProgressCallback* progress)
+{
+  osg::Image* image = NULL;
+  if( !m_cache )
+  {
+    image = drawImage( key, progress, false );
+  }
+  else
+  {
+    osgDB::ReaderWriter* readerWriter = osgDB::Registry::instance()->getReaderWriterForExtension( cacheImageFormat );
+    std::string tileKey( cacheKey(key) );
+    std::string data;
+    if( m_cache->read( tileKey, data ) )
+    {
+      if( !data.empty() && readerWriter )
+      {
+        std::istringstream stream( data );
+        image = readerWriter->readImage( stream ).takeImage();
+      }
+    }
+    else
+    {
+      image = drawImage( key, progress, false );
+
+      // A cancelled tile may be incomplete, and a tile that failed to draw may draw next time,
+      // so neither is cached
+      if( image && (!progress || !progress->isCanceled()) )
+      {
+        cacheImage( tileKey, image );
+      }
+    }
+  }
+
+  bool report = false;
+  {
+    QMutexLocker lock( &m_mutex );
+    report = ++m_requests % reportInterval == 0;
+  }
+  if( report )
+  {
+    reportStatistics();
+  }
+  return image;
+}
+
+bool ImageryTilePool::isCached(const osgEarth::TileKey& key) const
+{
+  return m_cache && m_cache->contains( cacheKey(key) );
+}
+
+bool ImageryTilePool::prefetch(const osgEarth::TileKey& key)
+{
+  std::string tileKey( cacheKey(key) );
+  if( !m_cache || m_cache->contains( tileKey ) )
+  {
+    return false;
+  }
+
+  osg::ref_ptr<osg::Image> image = drawImage( key, NULL, true );
+  if( !image.valid() )
+  {
+    return false;
+  }
+  cacheImage( tileKey, image.get() );
+
+  QMutexLocker lock( &m_mutex );
+  ++m_statistics.m_prefetched;
+  return true;
+}
+
+unsigned int ImageryTilePool::createRenderers(int tileSize)
+{
+  QMutexLocker lock( &m_mutex );
+  while( std::find( m_failedSizes.begin(), m_failedSizes.end(), tileSize ) == m_failedSizes.end() )
+  {
+    unsigned int numAllRenderers = 0;
+    for( std::deque<Renderer>::const_iterator it = m_renderers.begin(); it != m_renderers.end(); ++it )
+    {
+      numAllRenderers += it->m_tileSize != 0 ? 1 : 0;
+    }
+    if( numAllRenderers >= m_maxRenderers )
+    {
+      break;
+    }
+
+    // Add a busy renderer, so other threads count it, and create it without holding the lock
+    Renderer placeholder;
+    placeholder.m_tileSize = tileSize;
+    placeholder.m_busy = true;
+    m_renderers.push_back( placeholder );
+    Renderer* renderer = &m_renderers.back();
+    lock.unlock();
+    envitia::MapLink::DataLayerTileSource* source = m_factory->createRenderer( tileSize );
+    lock.relock();
+
+    if( source )
+    {
+      renderer->m_source = source;
+      renderer->m_busy = false;
+      ++m_statistics.m_renderers;
+    }
+    else
+    {
+      renderer->m_tileSize = 0;
+      m_failedSizes.push_back( tileSize );
+    }
+    m_released.wakeAll();
+  }
+
+  unsigned int numRenderers = 0;
+  for( std::deque<Renderer>::const_iterator it = m_renderers.begin(); it != m_renderers.end(); ++it )
+  {
+    numRenderers += it->m_tileSize == tileSize ? 1 : 0;
+  }
+  return numRenderers;
+}
+
+ImageryTilePool::Statistics ImageryTilePool::statistics() const
+{
+  QMutexLocker lock( &m_mutex );
+  return m_statistics;
+}
+
+void ImageryTilePool::resetStatistics()
+{
+  QMutexLocker lock( &m_mutex );
+  m_statistics.m_tiles = 0;
+  m_statistics.m_prefetched = 0;
+  m_statistics.m_drawTime = 0.0;
+  m_statistics.m_waitTime = 0.0;
+  m_statistics.m_renderers = m_renderers.size();
+  lock.unlock();
+
+  if( m_cache )
+  {
+    m_cache->resetStatistics();
+  }
+}
+
+std::string ImageryTilePool::cacheKey(const osgEarth::TileKey& key)
+{
+  // The tile size is part of the key, so changing the sizes doesn't use tiles of the old size
+  std::ostringstream tileKey;
+  tileKey << key.str() << "_" << tileSizeForLevel( key.getLevelOfDetail() );
+  return tileKey.str();
+}
+
+void ImageryTilePool::cacheImage(const std::string& tileKey, const osg::Image* image)
+{
+  osgDB::ReaderWriter* readerWriter = osgDB::Registry::instance()->getReaderWriterForExtension( cacheImageFormat );
+  std::ostringstream stream;
+  if( readerWriter && readerWriter->writeImage( *image, stream ).success() )
+  {
+    m_cache->write( tileKey, stream.str() );
+  }
+}
+
+osg::Image* ImageryTilePool::drawImage(const osgEarth::TileKey& key, osgEarth::ProgressCallback* progress, bool background)
+{
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+  Renderer* renderer = acquire( tileSizeForLevel( key.getLevelOfDetail() ), background );
+  if( !renderer )
+  {
+    return NULL;
+  }
+  osg::Timer_t drawTick = osg::Timer::instance()->tick();
+
+  osg::Image* image = renderer->m_source->createImage( key, progress );
+
+  osg::Timer_t endTick = osg::Timer::instance()->tick();
+  release( renderer, background );
+
+  QMutexLocker lock( &m_mutex );
+  m_statistics.m_waitTime += osg::Timer::instance()->delta_m( startTick, drawTick );
+  m_statistics.m_drawTime += osg::Timer::instance()->delta_m( drawTick, endTick );
+  ++m_statistics.m_tiles;
+  return image;
+}
+
+void ImageryTilePool::reportStatistics()
+{
+  Statistics statistics = this->statistics();
+  if( statistics.m_tiles > 0 )
+  {
+    OSG_INFO << "MapLink imagery: " << statistics.m_tiles << " tiles drawn by "
+             << statistics.m_renderers << " renderers, "
+             << statistics.m_drawTime / statistics.m_tiles << " ms drawing and "
+             << statistics.m_waitTime / statistics.m_tiles << " ms waiting per tile, "
+             << statistics.m_prefetched << " prefetched" << std::endl;
+  }
+  if( m_cache )
+  {
+    TileDiskCache::Statistics cacheStatistics = m_cache->statistics();
+    size_t reads = cacheStatistics.m_hits + cacheStatistics.m_misses;
+    OSG_INFO << "MapLink imagery cache: " << cacheStatistics.m_hits << " hits and "
+             << cacheStatistics.m_misses << " misses, "
+             << (reads > 0 ? cacheStatistics.m_readTime / reads : 0.0) << " ms per read, "
+             << (cacheStatistics.m_writes > 0 ? cacheStatistics.m_writeTime / cacheStatistics.m_writes : 0.0) << " ms per write, "
+             << cacheStatistics.m_tiles << " tiles in " << cacheStatistics.m_diskBytes / (1024 * 1024) << " MB, "
+             << cacheStatistics.m_evictedPacks << " packs evicted" << std::endl;
+  }
+}
+
+ImageryTilePool::Renderer* ImageryTilePool::acquire(int tileSize, bool background)
+{
+  QMutexLocker lock( &m_mutex );
+  if( m_renderers.empty() )
+  {
+    return NULL;
+  }
+
+  while( true )
+  {
+    // Background requests give way to every request the pager is waiting on
+    if( background && (m_foregroundWaiting > 0 || m_backgroundBusy >= IMAGERY_PREFETCHTHREADS) )
+    {
+      m_released.wait( &m_mutex );
+      continue;
+    }
+
+    // The base size always keeps at least one renderer, as the last one is never replaced by
+    // another size, so no more of it are created once one fails
+    bool failed = std::find( m_failedSizes.begin(), m_failedSizes.end(), tileSize ) != m_failedSizes.end();
+    if( failed && tileSize != m_baseTileSize )
+    {
+      tileSize = m_baseTileSize;
+      continue;
+    }
+
+    // Renderers that failed to be created have no size, and hold no data
+    unsigned int numRenderers = 0;
+    unsigned int numAllRenderers = 0;
+    unsigned int numBaseRenderers = 0;
+    Renderer* idleOther = NULL;
+    Renderer* idleBase = NULL;
+    for( std::deque<Renderer>::iterator it = m_renderers.begin(); it != m_renderers.end(); ++it )
+    {
+      if( it->m_tileSize == 0 )
+      {
+        continue;
+      }
+      ++numAllRenderers;
+      numBaseRenderers += it->m_tileSize == m_baseTileSize ? 1 : 0;
+      if( it->m_tileSize != tileSize )
+      {
+        if( !it->m_busy )
+        {
+          if( it->m_tileSize == m_baseTileSize )
+          {
+            idleBase = &(*it);
+          }
+          else
+          {
+            idleOther = &(*it);
+          }
+        }
+        continue;
+      }
+      if( !it->m_busy )
+      {
+        it->m_busy = true;
+        m_backgroundBusy += background ? 1 : 0;
+        return &(*it);
+      }
+      ++numRenderers;
+    }
+
+    // The last renderer of the base size isn't replaced, so requests falling back to the base size
+    // always have a renderer to wait for
+    if( !idleOther && numBaseRenderers > 1 )
+    {
+      idleOther = idleBase;
+    }
+
+    // Renderers of another size are only replaced when there are none of the size, so the pool
+    // doesn't keep swapping the data of its renderers while levels of different sizes are drawn
+    Renderer* renderer = NULL;
+    osg::ref_ptr<envitia::MapLink::DataLayerTileSource> replaced;
+    if( !failed && numAllRenderers < m_maxRenderers )
+    {
+      // Add a busy renderer, so other threads count it
+      Renderer placeholder;
+      placeholder.m_tileSize = tileSize;
+      placeholder.m_busy = true;
+      m_renderers.push_back( placeholder );
+      renderer = &m_renderers.back();
+    }
+    else if( !failed && numRenderers == 0 && idleOther )
+    {
+      renderer = idleOther;
+      renderer->m_tileSize = tileSize;
+      renderer->m_busy = true;
+      replaced.swap( renderer->m_source );
+    }
+    else
+    {
+      m_foregroundWaiting += background ? 0 : 1;
+      m_released.wait( &m_mutex );
+      m_foregroundWaiting -= background ? 0 : 1;
+      continue;
+    }
+
+    // Release the data of a replaced renderer before loading it again, and create the renderer
+    // without holding the lock, as it loads the data
+    lock.unlock();
+    replaced = NULL;
+    envitia::MapLink::DataLayerTileSource* source = m_factory->createRenderer( tileSize );
+    lock.relock();
+
+    if( source )
+    {
+      renderer->m_source = source;
+      ++m_statistics.m_renderers;
+      m_backgroundBusy += background ? 1 : 0;
+      return renderer;
+    }
+
+    // The renderer can't be drawn with: leave it busy and of no size, and use the base size from now on.
+    // The entry is kept, as erasing it would move the renderers taken by other threads.
+    OSG_NOTICE << "MapLink imagery: failed to create a renderer for " << tileSize
+               << " pixel tiles, using " << m_baseTileSize << " pixel tiles instead" << std::endl;
+    renderer->m_tileSize = 0;
+    m_failedSizes.push_back( tileSize );
+    m_released.wakeAll();
+  }
+}
+
+void ImageryTilePool::release(Renderer* renderer, bool background)
+{
+  QMutexLocker lock( &m_mutex );
+  renderer->m_busy = false;
+  m_backgroundBusy -= background ? 1 : 0;
+  m_released.wakeAll();
+}
@@ -0,0 +1,170 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef IMAGERYTILEPOOL_H
+#define IMAGERYTILEPOOL_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <osgEarth/TileSource>
+
+#include "tilediskcache.h"
+
+namespace envitia
+{
+  namespace MapLink
+  {
+    class DataLayerTileSource;
+  }
+}
+
+// Draws the tiles of a MapLink imagery layer with a pool of renderers.
+//
+// A DataLayerTileSource draws its tiles one at a time through its single drawing surface, so
+// the osgEarth pager threads queue behind each other waiting for it. This tile source holds
+// several DataLayerTileSources, each with its own drawing surface and copy of the data layer,
+// and hands each tile request to an idle one, so tiles are drawn concurrently.
+//
+// The size of the tiles depends on their level: the coarse levels, which cover the most data
+// and are the slowest to draw, are drawn smaller, and the finest levels larger. Renderers are
+// created for a tile size the first time it is needed.
+//
+// Every renderer holds a full copy of the data layer, so the memory used by the pool is that of
+// the data times the number of renderers. The number of renderers of all sizes is bounded: once
+// the pool has its maximum, a tile size without a renderer takes over an idle renderer of another
+// size, whose copy of the data is released first. The last renderer of the base tile size is never
+// taken over, as it is the one the other sizes fall back to.
+class ImageryTilePool : public osgEarth::TileSource
+{
+public:
+  // Creates the renderers of a pool
+  class Factory : public osg::Referenced
+  {
+  public:
+    // Create a renderer drawing tiles of the given size, opened and ready to draw.
+    // Returns NULL on failure. Called from the osgEarth pager threads.
+    virtual envitia::MapLink::DataLayerTileSource* createRenderer(int tileSize) = 0;
+  };
+
+  // Counts and timings of the tiles drawn since the last call to resetStatistics()
+  struct Statistics
+  {
+    // Tiles drawn, not including those read from the disk cache
+    size_t m_tiles;
+    // Total time spent drawing tiles, in milliseconds
+    double m_drawTime;
+    // Total time spent waiting for an idle renderer, in milliseconds
+    double m_waitTime;
+    // Number of renderers created, including those replacing a renderer of another tile size
+    size_t m_renderers;
+    // Tiles drawn into the disk cache ahead of being requested
+    size_t m_prefetched;
+  };
+
+  // maxRenderers is the number of renderers of all tile sizes. The first renderer is created
+  // here, for the tile size of the options; check valid() before using the pool.
+  ImageryTilePool(const osgEarth::TileSourceOptions& options, Factory* factory, unsigned int maxRenderers);
+
+  // Check the first renderer was created
+  bool valid() const;
+
+  // Tile size used for the tiles of a level
+  static int tileSizeForLevel(unsigned int level);
+
+  // Keep the drawn tiles in a disk cache, which the pool takes ownership of.
+  // Must be set before the pool is used.
+  void setCache(TileDiskCache* cache);
+  TileDiskCache* cache() const;
+
+  // Get the keys of the tiles covering an extent, from minLevel to maxLevel, coarsest first
+  void tilesCovering(const osgEarth::GeoExtent& extent, unsigned int minLevel, unsigned int maxLevel,
+                     std::vector<osgEarth::TileKey>& keys) const;
+
+  // Draw tiles with the given number of threads, waiting until they are done.
+  // With a disk cache, tiles already cached are skipped, so this warms the cache.
+  // Returns the time taken in milliseconds.
+  double drawTiles(const std::vector<osgEarth::TileKey>& keys, unsigned int numThreads);
+
+  // Create renderers of a tile size until the pool has its maximum number of renderers, so tiles
+  // of the size are drawn without waiting for the data to load. Returns the number of renderers of the size.
+  unsigned int createRenderers(int tileSize);
+
+  // Check if a tile is in the disk cache
+  bool isCached(const osgEarth::TileKey& key) const;
+
+  // Draw a tile into the disk cache ahead of it being requested, unless it is already cached.
+  // Prefetches wait while any tile requested by the pager is waiting for a renderer, and take at
+  // most IMAGERY_PREFETCHTHREADS renderers. Returns true if the tile was drawn.
+  bool prefetch(const osgEarth::TileKey& key);
+
+  // osgEarth::TileSource
+  virtual Status initialize(const osgDB::Options* dbOptions);
+  virtual osg::Image* createImage(const osgEarth::TileKey& key, osgEarth::ProgressCallback* progress);
+
+  Statistics statistics() const;
+  void resetStatistics();
+
+protected:
+  virtual ~ImageryTilePool();
+
+private:
+  struct Renderer
+  {
+    osg::ref_ptr<envitia::MapLink::DataLayerTileSource> m_source;
+    int m_tileSize;
+    bool m_busy;
+  };
+
+  // Take an idle renderer of the tile size, creating one if there are fewer than the maximum,
+  // replacing an idle renderer of another size if there is none of the size, or wait for one. Falls back to the base tile size if a renderer of the size can't be created.
+  // Background requests wait for the foreground ones. Returns NULL if there is no renderer at all.
+  Renderer* acquire(int tileSize, bool background);
+
+  // Return a renderer taken by acquire()
+  void release(Renderer* renderer, bool background);
+
+  // Key of a tile in the disk cache
+  static std::string cacheKey(const osgEarth::TileKey& key);
+
+  // Draw a tile with an idle renderer
+  osg::Image* drawImage(const osgEarth::TileKey& key, osgEarth::ProgressCallback* progress, bool background);
+
+  // Write a drawn tile to the disk cache
+  void cacheImage(const std::string& tileKey, const osg::Image* image);
+
+  // Report the statistics of the pool and cache at the OSG info notify level
+  void reportStatistics();
+
+  osg::ref_ptr<Factory> m_factory;
+  unsigned int m_maxRenderers;
+  int m_baseTileSize;
+
+  // Guards the members below
+  mutable QMutex m_mutex;
+  // Signalled when a renderer is released or created
+  QWaitCondition m_released;
+
+  // Renderers of all sizes. A deque, so the renderers taken keep their address as others are added.
+  std::deque<Renderer> m_renderers;
+  // Tile sizes the factory failed to create a renderer for
+  std::vector<int> m_failedSizes;
+  // Number of foreground requests waiting for a renderer
+  unsigned int m_foregroundWaiting;
+  // Number of renderers taken by background requests
+  unsigned int m_backgroundBusy;
+
+  Statistics m_statistics;
+  // Tiles requested, drawn or read from the cache, counted for the reports
+  size_t m_requests;
+
+  // Disk cache of the drawn tiles, or NULL
+  TileDiskCache* m_cache;
+};
+
+#endif
@@ -2,13 +2,17 @@
                 Copyright (c) 2017 by Envitia Group PLC.
 ****************************************************************************/
 #include <QApplication>
+#include <QDir>
 #include <QMainWindow>
 #include <QMessageBox>
+#include <QScopedPointer>
+#include <QTemporaryDir>
 
 #include <osgViewer/Viewer>
 #include <osgEarthQt/ViewerWidget>
 
 #include "mainwindow.h"
+#include "tilecommands.h"
 
 #include "MapLink.h"
 
@@ -62,6 +66,17 @@ int main(int argc, char** argv)
   QApplication application(argc, argv);
     
   // Parse the application's command line arguments
+  QString benchmarkFile;
+  QString warmCacheFile;
+  QString testCacheDirectory;
+  bool benchmarkPrefetch = false;
+  int benchmarkLayoutTracks = 0;
+  bool benchmarkUpdate = false;
+  int benchmarkLabelTracks = 0;
+  int benchmarkInsertionTracks = 0;
+  unsigned int warmCacheLevels[2] = { 0, 0 };
+  double warmCacheRegion[4];
+  bool warmCacheRegionSet = false;
   QStringList argumentList = application.arguments();
   for( int i = 1; i < argumentList.size(); ++i )
   {
@@ -69,7 +84,20 @@ int main(int argc, char** argv)
         argumentList[i].compare( "-help", Qt::CaseInsensitive ) == 0 )
     {
       QMessageBox::information( NULL, "Help",
-                                "Help:\n  osgearthsample /home path_to_install\t(The directory containing the config directory)" );
+                                "Help:\n  osgearthsample /home path_to_install\t(The directory containing the config directory)"
+                                "\n  osgearthsample /benchmarktiles map_file\t(Measure the rate MapLink imagery tiles are drawn at)"
+                                "\n  osgearthsample /warmcache map_file min_level max_level [west south east north]"
+                                "\t(Draw the MapLink imagery tiles of a region into the disk cache)"
+                                "\n  osgearthsample /testcache directory"
+                                "\t(Check the imagery disk cache stays within its size as it is filled, using the directory)"
+                                "\n  osgearthsample /benchmarkprefetch\t(Fly a scripted path with and without imagery prefetching)"
+                                "\n  osgearthsample /benchmarklayout [num_tracks]"
+                                "\t(Check choosing the tracks for the layout stays within its budget, 100000 tracks by default)"
+                                "\n  osgearthsample /benchmarkupdate\t(Measure the time taken to move 10000, 50000 and 100000 tracks)"
+                                "\n  osgearthsample /benchmarklabels [num_tracks]"
+                                "\t(Measure the time taken to label the tracks with and without scheduling, 50000 tracks by default)"
+                                "\n  osgearthsample /benchmarkinsert [num_tracks]"
+                                "\t(Measure the worst frame while adding and removing tracks, 50000 tracks by default)" );
       return 0;
     }
     else if( (argumentList[i].compare( "/home", Qt::CaseInsensitive ) == 0 ||
@@ -84,11 +112,148 @@ int main(int argc, char** argv)
       TSLUtilityFunctions::setMapLinkHome( homePath.toUtf8(), true );
       ++i;
     }
+    else if( (argumentList[i].compare( "/benchmarktiles", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-benchmarktiles", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      benchmarkFile = argumentList[i+1];
+      ++i;
+    }
+    else if( (argumentList[i].compare( "/testcache", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-testcache", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      testCacheDirectory = argumentList[i+1];
+      ++i;
+    }
+    else if( argumentList[i].compare( "/benchmarkprefetch", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-benchmarkprefetch", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkPrefetch = true;
+    }
+    else if( argumentList[i].compare( "/benchmarkupdate", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-benchmarkupdate", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkUpdate = true;
+    }
+    else if( argumentList[i].compare( "/benchmarklabels", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-benchmarklabels", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkLabelTracks = 50000;
+
+      // The number of tracks is optional
+      bool valid = false;
+      int numTracks = i+1 < argumentList.size() ? argumentList[i+1].toInt( &valid ) : 0;
+      if( valid && numTracks > 0 )
+      {
+        benchmarkLabelTracks = numTracks;
+        ++i;
+      }
+    }
+    else if( argumentList[i].compare( "/benchmarkinsert", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-benchmarkinsert", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkInsertionTracks = 50000;
+
+      // The number of tracks is optional
+      bool valid = false;
+      int numTracks = i+1 < argumentList.size() ? argumentList[i+1].toInt( &valid ) : 0;
+      if( valid && numTracks > 0 )
+      {
+        benchmarkInsertionTracks = numTracks;
+        ++i;
+      }
+    }
+    else if( argumentList[i].compare( "/benchmarklayout", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-benchmarklayout", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmarkLayoutTracks = 100000;
+
+      // The number of tracks is optional
+      bool valid = false;
+      int numTracks = i+1 < argumentList.size() ? argumentList[i+1].toInt( &valid ) : 0;
+      if( valid && numTracks > 0 )
+      {
+        benchmarkLayoutTracks = numTracks;
+        ++i;
+      }
+    }
+    else if( (argumentList[i].compare( "/warmcache", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-warmcache", Qt::CaseInsensitive ) == 0)
+             && i+3 < argumentList.size() )
+    {
+      warmCacheFile = argumentList[i+1];
+      warmCacheLevels[0] = argumentList[i+2].toUInt();
+      warmCacheLevels[1] = argumentList[i+3].toUInt();
+      i += 3;
+
+      // The region is optional
+      if( i+4 < argumentList.size() )
+      {
+        bool valid = true;
+        for( int edge = 0; edge < 4 && valid; ++edge )
+        {
+          warmCacheRegion[edge] = argumentList[i+1+edge].toDouble( &valid );
+        }
+        if( valid )
+        {
+          warmCacheRegionSet = true;
+          i += 4;
+        }
+      }
+    }
+  }
+
+  // Exercise the tile disk cache, which doesn't need MapLink
+  if( !testCacheDirectory.isEmpty() )
+  {
+    if( !QDir().mkpath( testCacheDirectory ) )
+    {
+      return 1;
+    }
+    return runCacheTest( testCacheDirectory.toUtf8() );
+  }
+
+  // Draw the tiles of a map without showing the window
+  if( !benchmarkFile.isEmpty() )
+  {
+    TSLErrorStack::clear();
+    if( !MainWindow::initMapLink() )
+    {
+      return 1;
+    }
+    return runTileBenchmark( benchmarkFile.toUtf8() );
+  }
+  if( !warmCacheFile.isEmpty() )
+  {
+    TSLErrorStack::clear();
+    if( !MainWindow::initMapLink() )
+    {
+      return 1;
+    }
+    return runCacheWarming( warmCacheFile.toUtf8(), warmCacheLevels[0], warmCacheLevels[1],
+                            warmCacheRegionSet ? warmCacheRegion : NULL );
   }
   
+  // The prefetch benchmark empties the imagery caches, so it is given caches of its own,
+  // removed when the application exits
+  QScopedPointer<QTemporaryDir> benchmarkCache;
+  if( benchmarkPrefetch )
+  {
+    benchmarkCache.reset( new QTemporaryDir() );
+    if( !benchmarkCache->isValid() )
+    {
+      return 1;
+    }
+  }
+
   // Display the window, and start the application
   MainWindow window;
   window.show();
+  if( benchmarkPrefetch )
+  {
+    window.imageryCacheRoot( benchmarkCache->path().toStdString() );
+  }
 
   TSLErrorStack::clear();
   if( !window.initMapLink() )
@@ -101,6 +266,27 @@ int main(int argc, char** argv)
   {
     return 1;
   }
+
+  if( benchmarkPrefetch )
+  {
+    return window.runPrefetchBenchmark();
+  }
+  if( benchmarkLayoutTracks > 0 )
+  {
+    return window.runLayoutBenchmark( benchmarkLayoutTracks );
+  }
+  if( benchmarkUpdate )
+  {
+    return window.runUpdateBenchmark();
+  }
+  if( benchmarkLabelTracks > 0 )
+  {
+    return window.runLabelBenchmark( benchmarkLabelTracks );
+  }
+  if( benchmarkInsertionTracks > 0 )
+  {
+    return window.runInsertionBenchmark( benchmarkInsertionTracks );
+  }
   
   return application.exec();
 }
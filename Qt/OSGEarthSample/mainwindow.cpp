@@ -3,13 +3,21 @@
 ****************************************************************************/
 
 
+#include <stdio.h>
+#include <math.h>
+#include <functional>
+#include <iostream>
+
 #include <QtGui>
+#include <QApplication>
 #include <QMainWindow>
 #include <QWidget>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QProgressDialog>
 
+#include <osg/AnimationPath>
+#include <osgGA/AnimationPathManipulator>
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarthUtil/ExampleResources>
 #include <osgEarthUtil/EarthManipulator>
@@ -23,19 +31,18 @@
 #define MAPLINK_NO_DRAWING_SURFACE
 #include <osgEarthMapLink/MilitarySymbols.h>
 #include <osgEarthMapLink/Symbols.h>
-#include <osgEarthMapLink/DataLayerTileSource.h>
 #include <osgEarthMapLink/TerrainTileSource.h>
 
 #include "mainwindow.h"
 #include "viewereventfilter.h"
+#include "imagerytilepool.h"
+#include "maplinkimageryfactory.h"
+#include "tileprefetcher.h"
 
 #include <MapLink.h>
 #include <MapLinkDrawing.h>
 #include "maplinktrackmanager.h"
 #include <MapLinkTerrain.h>
-#ifdef MAPLINK_HAVE_KML
-# include <tslkmldatalayer.h>
-#endif
 
 using namespace osgEarth;
 
@@ -47,6 +54,7 @@ MainWindow::MainWindow(QWidget *parent)
   , m_mapNode( NULL )
   , m_rootNode( NULL )
   , m_trackManager( NULL )
+  , m_prefetcher( NULL )
   , m_skyNode( NULL )
   , m_skyBoxMoonEnabled( false )
   , m_skyBoxAnimationEnabled( false )
@@ -126,6 +134,40 @@ bool MainWindow::initMapLink()
   return true;
 }
 
+std::string MainWindow::imageryCacheDirectory(const char* fileName, const std::string& cacheRoot)
+{
+  // Each data file has its own directory, named from a hash of its path
+  std::string cacheDir = cacheRoot;
+  if( cacheDir.empty() )
+  {
+    cacheDir = TSLUtilityFunctions::getMapLinkUserHome();
+    cacheDir += "/osgEarthSampleCache";
+  }
+  if( !TSLFileHelper::createDirectory( cacheDir.c_str() ) )
+  {
+    return std::string();
+  }
+  cacheDir += "/imagery";
+  if( !TSLFileHelper::createDirectory( cacheDir.c_str() ) )
+  {
+    return std::string();
+  }
+
+  char hash[32];
+  snprintf( hash, sizeof(hash), "/%016llx", (unsigned long long)std::hash<std::string>()( fileName ) );
+  cacheDir += hash;
+  if( !TSLFileHelper::createDirectory( cacheDir.c_str() ) )
+  {
+    return std::string();
+  }
+  return cacheDir;
+}
+
+void MainWindow::imageryCacheRoot(const std::string& directory)
+{
+  m_imageryCacheRoot = directory;
+}
+
 bool MainWindow::initOsgEarth(osg::ArgumentParser& args)
 {
 #ifdef _DEBUG
@@ -153,6 +195,9 @@ bool MainWindow::initOsgEarth(osg::ArgumentParser& args)
   osgDB::Registry::instance()->loadLibrary( osgDB::Registry::instance()->createLibraryNameForExtension("jpeg") );
 #endif
 
+  // The MapLink imagery layers draw their tiles concurrently, so the pager needs a thread for each renderer
+  osg::DisplaySettings::instance()->setNumOfDatabaseThreadsHint( IMAGERY_RENDERERS + 1 );
+
   m_osgViewer = new osgViewer::Viewer( args );
 
   // Need to render continuously for the track simulation
@@ -198,7 +243,7 @@ bool MainWindow::initOsgEarth(osg::ArgumentParser& args)
   // Initialise the osg node and views
   Drivers::TerrainOptions terrainOptions;
   // bring in the tiles earlier the higher the value
-  terrainOptions.minTileRangeFactor() = 6;
+  terrainOptions.minTileRangeFactor() = TERRAIN_MINTILERANGEFACTOR;
 
   terrainOptions.verticalScale() = TERRAIN_VERTICALSCALE;
   terrainOptions.lodTransitionTime() = 0.25;
@@ -273,6 +318,10 @@ bool MainWindow::initOsgEarth(osg::ArgumentParser& args)
   m_trackManager = new MaplinkTrackManager( TRACKS_INITIALNUMBER, m_rootNode, m_mapNode, true, this );
   m_osgViewer->addUpdateOperation( m_trackManager );
 
+  // Draw the MapLink imagery ahead of the camera
+  m_prefetcher = new TilePrefetcher( m_mapNode );
+  m_osgViewer->addUpdateOperation( m_prefetcher );
+
   // Add the background MapLink map
   std::string naturalEarthRasterMap = TSLUtilityFunctions::getMapLinkHome();
   naturalEarthRasterMap += "/maps/NaturalEarthRaster/NaturalEarthRaster.map";
@@ -287,6 +336,305 @@ bool MainWindow::initOsgEarth(osg::ArgumentParser& args)
   return true;
 }
 
+int MainWindow::runPrefetchBenchmark()
+{
+  // A straight flight at a low altitude, looking down, from London to Rome
+  const double startLongitude = -0.13, startLatitude = 51.5;
+  const double endLongitude = 12.5, endLatitude = 41.9;
+  const double altitude = 150000.0;
+  const double duration = 60.0;
+  const int numControlPoints = 60;
+
+  osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath;
+  path->setLoopMode( osg::AnimationPath::NO_LOOPING );
+  const SpatialReference* geoSRS = m_mapNode->getMapSRS()->getGeographicSRS();
+  for( int i = 0; i <= numControlPoints; ++i )
+  {
+    double fraction = (double)i / numControlPoints;
+    GeoPoint point( geoSRS, startLongitude + fraction * (endLongitude - startLongitude),
+                    startLatitude + fraction * (endLatitude - startLatitude), altitude, ALTMODE_ABSOLUTE );
+
+    // The camera looks along its local -Z axis, which is down in the local frame of the point
+    osg::Matrixd localToWorld;
+    point.createLocalToWorld( localToWorld );
+    path->insert( fraction * duration, osg::AnimationPath::ControlPoint( localToWorld.getTrans(), localToWorld.getRotate() ) );
+  }
+
+  for( int run = 0; run < 2; ++run )
+  {
+    bool prefetch = run == 1;
+    m_prefetcher->enabled( prefetch );
+    m_prefetcher->resetStatistics();
+
+    // Start each run with empty caches and no tiles loaded. The caches are in the temporary
+    // directory given to imageryCacheRoot(), not those the sample normally uses.
+    for( size_t i = 0; i < m_imageryPools.size(); ++i )
+    {
+      if( m_imageryPools[i]->cache() )
+      {
+        m_imageryPools[i]->cache()->clear();
+      }
+      m_imageryPools[i]->resetStatistics();
+    }
+    m_mapNode->getTerrainEngine()->dirtyTerrain();
+    m_osgViewer->setCameraManipulator( new osgGA::AnimationPathManipulator( path.get() ) );
+
+    // Let the viewer widget draw the frames until the flight is over
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    unsigned int startFrame = m_osgViewer->getFrameStamp()->getFrameNumber();
+    while( osg::Timer::instance()->delta_s( startTick, osg::Timer::instance()->tick() ) < duration + 1.0 )
+    {
+      QApplication::processEvents( QEventLoop::AllEvents, 10 );
+    }
+    unsigned int numFrames = m_osgViewer->getFrameStamp()->getFrameNumber() - startFrame;
+
+    // A cache miss is a tile the terrain asked for that had to be drawn while it waited
+    size_t misses = 0, hits = 0, drawn = 0;
+    for( size_t i = 0; i < m_imageryPools.size(); ++i )
+    {
+      if( m_imageryPools[i]->cache() )
+      {
+        TileDiskCache::Statistics cacheStatistics = m_imageryPools[i]->cache()->statistics();
+        misses += cacheStatistics.m_misses;
+        hits += cacheStatistics.m_hits;
+      }
+      drawn += m_imageryPools[i]->statistics().m_tiles;
+    }
+    TilePrefetcher::Statistics prefetchStatistics = m_prefetcher->statistics();
+    std::cout << "Prefetch " << (prefetch ? "on" : "off") << ": " << numFrames << " frames, "
+              << misses << " on demand misses, " << hits << " hits, " << drawn << " tiles drawn, "
+              << prefetchStatistics.m_prefetched << " prefetched, "
+              << prefetchStatistics.m_cancelled << " cancelled" << std::endl;
+  }
+
+  m_prefetcher->enabled( true );
+  m_osgViewer->setCameraManipulator( new Util::EarthManipulator() );
+  return 0;
+}
+
+int MainWindow::runLayoutBenchmark(int numTracks)
+{
+  // From above the whole of Europe and Africa down to a low altitude over the Alps
+  const double startLongitude = 10.0, startLatitude = 20.0, startAltitude = 20000000.0;
+  const double endLongitude = 10.0, endLatitude = 46.0, endAltitude = 300000.0;
+  const double duration = 30.0;
+  const int numControlPoints = 60;
+  const double maxFractionOverBudget = 0.01;
+
+  m_trackManager->decluttering( true );
+  if( !setBenchmarkTracks( numTracks, "Layout" ) )
+  {
+    return 1;
+  }
+
+  // The altitude falls geometrically, so as much of the flight is spent close to the ground as far from it
+  osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath;
+  path->setLoopMode( osg::AnimationPath::NO_LOOPING );
+  const SpatialReference* geoSRS = m_mapNode->getMapSRS()->getGeographicSRS();
+  for( int i = 0; i <= numControlPoints; ++i )
+  {
+    double fraction = (double)i / numControlPoints;
+    GeoPoint point( geoSRS, startLongitude + fraction * (endLongitude - startLongitude),
+                    startLatitude + fraction * (endLatitude - startLatitude),
+                    startAltitude * pow( endAltitude / startAltitude, fraction ), ALTMODE_ABSOLUTE );
+
+    osg::Matrixd localToWorld;
+    point.createLocalToWorld( localToWorld );
+    path->insert( fraction * duration, osg::AnimationPath::ControlPoint( localToWorld.getTrans(), localToWorld.getRotate() ) );
+  }
+  m_osgViewer->setCameraManipulator( new osgGA::AnimationPathManipulator( path.get() ) );
+  m_trackManager->resetLayoutStatistics();
+
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+  while( osg::Timer::instance()->delta_s( startTick, osg::Timer::instance()->tick() ) < duration + 1.0 )
+  {
+    QApplication::processEvents( QEventLoop::AllEvents, 10 );
+  }
+
+  const MaplinkTrackManager::LayoutStatistics& statistics = m_trackManager->layoutStatistics();
+  if( statistics.m_frames == 0 )
+  {
+    std::cout << "Layout: no frames were drawn" << std::endl;
+    return 1;
+  }
+  double fractionOverBudget = (double)statistics.m_framesOverBudget / statistics.m_frames;
+  bool withinBudget = fractionOverBudget <= maxFractionOverBudget;
+  std::cout << "Layout: " << statistics.m_frames << " frames, up to " << statistics.m_mostOnScreen
+            << " tracks on screen, " << statistics.m_totalTime / statistics.m_frames << " ms per frame, worst "
+            << statistics.m_worstTime << " ms, " << statistics.m_framesOverBudget << " frames over the budget of "
+            << TRACKS_LAYOUTBUDGET_MS << " ms - " << (withinBudget ? "passed" : "failed") << std::endl;
+
+  m_osgViewer->setCameraManipulator( new Util::EarthManipulator() );
+  return withinBudget ? 0 : 1;
+}
+
+int MainWindow::runUpdateBenchmark()
+{
+  const double duration = 10.0;
+  const int trackCounts[] = { 10000, 50000, 100000 };
+
+  // Every run moves the tracks under the same camera
+  setBenchmarkCamera();
+  for( size_t run = 0; run < sizeof(trackCounts) / sizeof(trackCounts[0]); ++run )
+  {
+    if( !setBenchmarkTracks( trackCounts[run], "Update" ) )
+    {
+      return 1;
+    }
+    m_trackManager->resetUpdateStatistics();
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    while( osg::Timer::instance()->delta_s( startTick, osg::Timer::instance()->tick() ) < duration )
+    {
+      QApplication::processEvents( QEventLoop::AllEvents, 10 );
+    }
+
+    const MaplinkTrackManager::UpdateStatistics& statistics = m_trackManager->updateStatistics();
+    if( statistics.m_frames == 0 )
+    {
+      std::cout << "Update: no frames were drawn" << std::endl;
+      return 1;
+    }
+    std::cout << "Update: " << trackCounts[run] << " tracks, " << statistics.m_frames << " frames, "
+              << statistics.m_totalTime / statistics.m_frames << " ms per frame, worst "
+              << statistics.m_worstTime << " ms, " << statistics.m_totalMoved / statistics.m_frames
+              << " tracks moved per frame" << std::endl;
+  }
+
+  m_osgViewer->setCameraManipulator( new Util::EarthManipulator() );
+  return 0;
+}
+
+int MainWindow::runLabelBenchmark(int numTracks)
+{
+  const double duration = 10.0;
+  const MaplinkTrackObject::PositionFormat formats[] =
+    { MaplinkTrackObject::FORMAT_GARS, MaplinkTrackObject::FORMAT_MGRS, MaplinkTrackObject::FORMAT_LATLON };
+  const char* formatNames[] = { "GARS", "MGRS", "lat/lon" };
+
+  if( !setBenchmarkTracks( numTracks, "Labels" ) )
+  {
+    return 1;
+  }
+  setBenchmarkCamera();
+
+  for( size_t format = 0; format < sizeof(formats) / sizeof(formats[0]); ++format )
+  {
+    for( int run = 0; run < 2; ++run )
+    {
+      // Each run starts with every label out of date, as it is when the format is changed
+      bool scheduling = run == 1;
+      m_trackManager->labelScheduling( scheduling );
+      m_trackManager->positionFormat( MaplinkTrackObject::FORMAT_NONE );
+      m_trackManager->positionFormat( formats[format] );
+      m_trackManager->resetUpdateStatistics();
+
+      osg::Timer_t startTick = osg::Timer::instance()->tick();
+      while( osg::Timer::instance()->delta_s( startTick, osg::Timer::instance()->tick() ) < duration )
+      {
+        QApplication::processEvents( QEventLoop::AllEvents, 10 );
+      }
+
+      const MaplinkTrackManager::UpdateStatistics& statistics = m_trackManager->updateStatistics();
+      if( statistics.m_frames == 0 )
+      {
+        std::cout << "Labels: no frames were drawn" << std::endl;
+        return 1;
+      }
+      std::cout << "Labels: " << formatNames[format] << (scheduling ? " with" : " without") << " the scheduler, "
+                << statistics.m_frames << " frames, "
+                << (statistics.m_totalTime + statistics.m_totalLabelTime) / statistics.m_frames
+                << " ms per frame moving and labelling the tracks, worst " << statistics.m_worstLabelledTime
+                << " ms, " << statistics.m_totalFormatted / statistics.m_frames << " labels formatted per frame"
+                << std::endl;
+    }
+  }
+
+  m_trackManager->labelScheduling( true );
+  m_osgViewer->setCameraManipulator( new Util::EarthManipulator() );
+  return 0;
+}
+
+int MainWindow::runInsertionBenchmark(int numTracks)
+{
+  const double timeout = 600.0;
+
+  // Start from an empty scene under a fixed camera
+  if( !setBenchmarkTracks( 0, "Insertion" ) )
+  {
+    return 1;
+  }
+  setBenchmarkCamera();
+
+  // Add the tracks, then remove them again
+  const int targets[] = { numTracks, 0 };
+  for( int run = 0; run < 2; ++run )
+  {
+    m_trackManager->resetInsertionStatistics();
+    m_trackManager->numTracks( targets[run] );
+
+    // The change is recorded on the frame after the number of tracks is reached
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    while( m_trackManager->insertionStatistics().m_frames == 0 ||
+           m_trackManager->insertionStatistics().m_endTracks != (size_t)targets[run] )
+    {
+      if( osg::Timer::instance()->delta_s( startTick, osg::Timer::instance()->tick() ) > timeout )
+      {
+        std::cout << "Insertion: " << m_trackManager->numTracks() << " tracks instead of " << targets[run]
+                  << " after " << timeout << " s" << std::endl;
+        return 1;
+      }
+      QApplication::processEvents( QEventLoop::AllEvents, 10 );
+    }
+
+    const MaplinkTrackManager::InsertionStatistics& statistics = m_trackManager->insertionStatistics();
+    std::cout << "Insertion: tracks changed from " << statistics.m_startTracks << " to " << statistics.m_endTracks
+              << " in " << statistics.m_time << " s over " << statistics.m_frames << " frames, worst frame "
+              << statistics.m_worstFrame << " ms" << std::endl;
+  }
+
+  m_osgViewer->setCameraManipulator( new Util::EarthManipulator() );
+  return 0;
+}
+
+void MainWindow::setBenchmarkCamera()
+{
+  // A fixed view of Europe, looking down
+  const double longitude = 10.0, latitude = 46.0, altitude = 2000000.0;
+
+  const SpatialReference* geoSRS = m_mapNode->getMapSRS()->getGeographicSRS();
+  GeoPoint point( geoSRS, longitude, latitude, altitude, ALTMODE_ABSOLUTE );
+  osg::Matrixd localToWorld;
+  point.createLocalToWorld( localToWorld );
+  osg::ref_ptr<osg::AnimationPath> path = new osg::AnimationPath;
+  path->setLoopMode( osg::AnimationPath::NO_LOOPING );
+  path->insert( 0.0, osg::AnimationPath::ControlPoint( localToWorld.getTrans(), localToWorld.getRotate() ) );
+  path->insert( 1.0, osg::AnimationPath::ControlPoint( localToWorld.getTrans(), localToWorld.getRotate() ) );
+  m_osgViewer->setCameraManipulator( new osgGA::AnimationPathManipulator( path.get() ) );
+}
+
+bool MainWindow::setBenchmarkTracks( int numTracks, const char* benchmark )
+{
+  const double buildTimeout = 600.0;
+
+  // Wait for the tracks to be built and added to the scene, or the surplus ones removed
+  m_trackManager->numTracks( numTracks );
+  osg::Timer_t buildTick = osg::Timer::instance()->tick();
+  while( m_trackManager->numTracks() != (size_t)numTracks )
+  {
+    if( osg::Timer::instance()->delta_s( buildTick, osg::Timer::instance()->tick() ) > buildTimeout )
+    {
+      std::cout << benchmark << ": " << m_trackManager->numTracks() << " tracks instead of " << numTracks
+                << " after " << buildTimeout << " s" << std::endl;
+      return false;
+    }
+    QApplication::processEvents( QEventLoop::AllEvents, 10 );
+  }
+  std::cout << benchmark << ": " << numTracks << " tracks in the scene after "
+            << osg::Timer::instance()->delta_s( buildTick, osg::Timer::instance()->tick() ) << " s" << std::endl;
+  return true;
+}
+
 bool MainWindow::addMapLinkData( const char* fileName, TSLDataLayerTypeEnum layerType, bool limitZoomDisplay )
 {
   // To keep things simple this sample creates a new OSGEarth imagery layer for each Maplink datalayer.
@@ -303,116 +651,41 @@ bool MainWindow::addMapLinkData( const char* fileName, TSLDataLayerTypeEnum laye
 
   progress.setValue(1);
 
-  // Create a new Maplink tile source
-  envitia::MapLink::DataLayerTileSourceOptions options;
-  // Set the tile size used by the maplink drawing surface
-  //
-  // This will affect the percieved quality of the drawn map
-  // and the scaling of any maplink entity that was specified in
-  // points or pixels.
-  //
-  // This may also heavily affect performance, if a lot of data
-  // has been loaded via maplink
-  //
-  // The value used will always be odd, to support LOD blending.
+  // Create a pool of Maplink tile sources, drawing the tiles concurrently.
+  // Each tile source draws tiles of one size, and loads its own copy of the data,
+  // so the data is loaded here for the tile source of the default tile size
+  // and as the other tile sizes and concurrent requests need it.
+  osgEarth::TileSourceOptions options;
   options.tileSize() = IMAGERY_TILESIZE;
-  
-  envitia::MapLink::DataLayerTileSource *imagery =
-    new envitia::MapLink::DataLayerTileSource(options);
-
-  TSLDataLayer *dataLayer = NULL;
-  switch( layerType )
-  {
-    case TSLDataLayerTypeMapDataLayer:
-      dataLayer = new TSLMapDataLayer;
-      break;
-#ifdef MAPLINK_HAVE_KML
-    case TSLDataLayerTypeKMLDataLayer:
-      {
-        // The KML DataLayer doesn't provide its own coordinate system.
-        // One must be created as its being displayed in its own OSGEarth layer
-        TSLKMLDataLayer* kmlLayer = new TSLKMLDataLayer;
-        kmlLayer->setCoordinateSystem( TSLCoordinateSystem::findByName("Dynamic ARC Grid (Greenwich)") );
 
-        dataLayer = (TSLDataLayer*)kmlLayer;
-      }
-      break;
-#endif
-    case TSLDataLayerTypeCADRGDataLayer:
-      dataLayer = new TSLCADRGDataLayer;
-      break;
-    default:
-      return false;
-      break;
-  }
-  
   progress.setValue(2);
 
-  if( !dataLayer->loadData( fileName ) )
+  osg::ref_ptr<ImageryTilePool> imagery =
+    new ImageryTilePool( options, new MapLinkImageryFactory( fileName, layerType, limitZoomDisplay ), IMAGERY_RENDERERS );
+  if( !imagery->valid() )
   {
     return false;
   }
 
-  // Add the MapLink map to the TileSource.
-  if( !imagery->addDataLayer(fileName, dataLayer) )
+  // Keep the drawn tiles in a size limited disk cache, so they aren't drawn again.
+  // The osgEarth cache isn't used for the layer, as it has no size limit.
+  std::string cacheDirectory = imageryCacheDirectory( fileName, m_imageryCacheRoot );
+  if( !cacheDirectory.empty() )
   {
-    return false;
+    imagery->setCache( new TileDiskCache( cacheDirectory, IMAGERY_CACHESIZE_MB * 1024ULL * 1024ULL ) );
+
+    // Tiles can only be prefetched into the cache
+    m_prefetcher->addPool( imagery.get() );
   }
+  m_imageryPools.push_back( imagery );
 
   progress.setValue(3);
 
   // Initialise the TileSource
-  // This should be called after adding datalayers to the TileSource
-  // to ensure the coordinate system and extent provided to osgEarth
-  // are correct
+  // This takes the coordinate system and extent provided to osgEarth
+  // from the first tile source of the pool
   imagery->open();
 
-  // Set the properties for the datalayer such that it will only display once 
-  // the view has been zoomed in a defined amount.
-  
-  // When the maps extent(in pixels) is greater than tileSize * mapScaleFraction
-  // the map will be displayed.
-  if( limitZoomDisplay )
-  {
-    double mapScaleFraction = MAPLINKIMAGERY_MINIMUMZOOMFACTOR;
-    int tileSize = IMAGERY_TILESIZE; //TODO: Define in header etc
-    
-    TSLTMC x1 = 0;
-    TSLTMC x2 = 0;
-    TSLTMC y1 = 0;
-    TSLTMC y2 = 0;
-
-    bool validExtent = false;
-#ifdef MAPLINK_HAVE_KML
-    // For the KML DataLayer, use the extent of the vector data
-    if( layerType == TSLDataLayerTypeKMLDataLayer )
-    {
-      TSLKMLDataLayer* kmlLayer = (TSLKMLDataLayer*)dataLayer;
-      validExtent = kmlLayer->getLayer(0)->getTMCExtent( &x1, &y1, &x2, &y2 );
-    }
-    else
-#endif
-    {
-      validExtent = dataLayer->getTMCExtent(&x1, &y1, &x2, &y2);
-    }
-
-    if( validExtent )
-    {
-      int width  = x2 - x1;
-      int height = y2 - y1;
-      int mapSizeTMCs = width > height ? width : height;
-
-      // As the view is zoomed in, the TMCs per pixel value decreases, as such we must set
-      // the TSLPropertyMaxZoomDisplay, to define the minimum zoom that the map is displayed for
-      int maxZoomDisplay = mapSizeTMCs / (mapScaleFraction * tileSize);
-
-      // Set the calculated factor on the datalayer, via the tilesource's drawing surface
-      imagery->lock();
-      imagery->drawingSurface()->setDataLayerProps(fileName, TSLPropertyMaxZoomDisplay, maxZoomDisplay );
-      imagery->unlock();  
-    }
-  }
-  
   // Create an osgEarth ImageLayer.
   Drivers::Config layerDriverConf;
   layerDriverConf.add( "default_tile_size", IMAGERY_TILESIZE_STR );
@@ -430,7 +703,7 @@ bool MainWindow::addMapLinkData( const char* fileName, TSLDataLayerTypeEnum laye
   opacity = 1.0;
 
   // Attach the MapLink 2D TileSource to the ImageLayer
-  ImageLayer *maplinkImageLayer = new ImageLayer(maplinkImageLayerOptions, imagery);
+  ImageLayer *maplinkImageLayer = new ImageLayer(maplinkImageLayerOptions, imagery.get());
 
   // Add the ImageLayer to the Scene Graph.
   m_osgEarthMap->addImageLayer( maplinkImageLayer );
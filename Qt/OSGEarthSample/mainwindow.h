@@ -12,6 +12,9 @@
 #include "ui_osgearthsample.h"
 #include "osgearthsampleconfig.h"
 
+#include <string>
+#include <vector>
+
 #include <QMainWindow>
 #include <QActionGroup>
 #include <QLabel>
@@ -28,6 +31,8 @@
 #include <tsldatalayertypeenum.h>
 
 class MaplinkTrackManager;
+class ImageryTilePool;
+class TilePrefetcher;
 
 class MainWindow : public QMainWindow, private Ui_MainWindow
 {
@@ -37,9 +42,42 @@ public:
     ~MainWindow();
 
 
-    bool initMapLink();
+    static bool initMapLink();
+
+    // Create the directory of the disk cache of the imagery of a MapLink data file, under cacheRoot,
+    // or the osgEarthSampleCache directory of the MapLink user home if it is empty.
+    // Returns the path of the directory, or an empty string on failure.
+    static std::string imageryCacheDirectory(const char* fileName, const std::string& cacheRoot = std::string());
+
+    // Keep the imagery disk caches under another directory. Must be called before initOsgEarth().
+    void imageryCacheRoot(const std::string& directory);
     bool initOsgEarth(osg::ArgumentParser& args);
 
+    // Fly the camera along a scripted path over the background map, without and then with
+    // prefetching, and write the number of tiles the terrain had to wait for to the standard output.
+    // The imagery caches are emptied before each run, so they should be given a temporary
+    // directory with imageryCacheRoot(). Returns the exit code of the application.
+    int runPrefetchBenchmark();
+
+    // Add numTracks tracks, then fly the camera from a view of the whole globe down to a low
+    // altitude and write the time taken each frame to choose the tracks for the screen space
+    // layout to the standard output. Returns the exit code of the application, which is 1 if
+    // more than 1% of the frames took longer than TRACKS_LAYOUTBUDGET_MS.
+    int runLayoutBenchmark(int numTracks);
+
+    // Show 10000, 50000 and then 100000 tracks from a fixed view, and write the time taken each
+    // frame to move them to the standard output. Returns the exit code of the application.
+    int runUpdateBenchmark();
+
+    // Add numTracks tracks, and show them from a fixed view with each of the position formats,
+    // without and then with the scheduling of the labels. Writes the time taken each frame to move
+    // the tracks and format their labels to the standard output. Returns the exit code of the application.
+    int runLabelBenchmark(int numTracks);
+
+    // Add numTracks tracks to an empty scene and then remove them, writing the worst frame time
+    // while they were being added or removed to the standard output. Returns the exit code of the application.
+    int runInsertionBenchmark(int numTracks);
+
 
 private slots:
     void openMapLinkData();
@@ -52,6 +90,12 @@ private slots:
     void showSimulationOptions();
 
 private:
+  // Fix the camera of a benchmark over Europe
+  void setBenchmarkCamera();
+
+  // Set the number of tracks for a benchmark and wait until they are all in the scene.
+  // Returns false, having written the benchmark's name and the reason, if they weren't added in time.
+  bool setBenchmarkTracks( int numTracks, const char* benchmark );
   bool addMapLinkData( const char* fileName, TSLDataLayerTypeEnum layerType, bool limitZoomDisplay = true ); 
   bool addMapLinkTerrainData( const char* fileName );
 
@@ -62,6 +106,10 @@ private:
   osg::ref_ptr<osg::Group> m_rootNode;
 
   MaplinkTrackManager* m_trackManager;
+  osg::ref_ptr<TilePrefetcher> m_prefetcher;
+  std::vector< osg::ref_ptr<ImageryTilePool> > m_imageryPools;
+  // Directory holding the imagery disk caches, or empty for the default one
+  std::string m_imageryCacheRoot;
   osg::ref_ptr<osgEarth::Util::SkyNode> m_skyNode;
   bool m_skyBoxMoonEnabled;
   bool m_skyBoxAnimationEnabled;
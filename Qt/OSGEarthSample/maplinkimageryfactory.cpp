@@ -0,0 +1,140 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "maplinkimageryfactory.h"
+
+// Avoid including the MapLink drawing surface and X11 headers
+// before the osgEarth MapLink headers
+#define MAPLINK_NO_DRAWING_SURFACE
+#include <osgEarthMapLink/DataLayerTileSource.h>
+
+#include "osgearthsampleconfig.h"
+
+#include <MapLink.h>
+#include <MapLinkDrawing.h>
+#ifdef MAPLINK_HAVE_KML
+# include <tslkmldatalayer.h>
+#endif
+
+MapLinkImageryFactory::MapLinkImageryFactory(const char* fileName, TSLDataLayerTypeEnum layerType, bool limitZoomDisplay)
+  : m_fileName( fileName )
+  , m_layerType( layerType )
+  , m_limitZoomDisplay( limitZoomDisplay )
+{
+}
+
+envitia::MapLink::DataLayerTileSource* MapLinkImageryFactory::createRenderer(int tileSize)
+{
+  const char* fileName = m_fileName.c_str();
+
+  // Create a new Maplink tile source
+  envitia::MapLink::DataLayerTileSourceOptions options;
+  // Set the tile size used by the maplink drawing surface
+  //
+  // This will affect the percieved quality of the drawn map
+  // and the scaling of any maplink entity that was specified in
+  // points or pixels.
+  //
+  // This may also heavily affect performance, if a lot of data
+  // has been loaded via maplink
+  //
+  // The value used will always be odd, to support LOD blending.
+  options.tileSize() = tileSize;
+
+  osg::ref_ptr<envitia::MapLink::DataLayerTileSource> imagery =
+    new envitia::MapLink::DataLayerTileSource(options);
+
+  TSLDataLayer *dataLayer = NULL;
+  switch( m_layerType )
+  {
+    case TSLDataLayerTypeMapDataLayer:
+      dataLayer = new TSLMapDataLayer;
+      break;
+#ifdef MAPLINK_HAVE_KML
+    case TSLDataLayerTypeKMLDataLayer:
+      {
+        // The KML DataLayer doesn't provide its own coordinate system.
+        // One must be created as its being displayed in its own OSGEarth layer
+        TSLKMLDataLayer* kmlLayer = new TSLKMLDataLayer;
+        kmlLayer->setCoordinateSystem( TSLCoordinateSystem::findByName("Dynamic ARC Grid (Greenwich)") );
+
+        dataLayer = (TSLDataLayer*)kmlLayer;
+      }
+      break;
+#endif
+    case TSLDataLayerTypeCADRGDataLayer:
+      dataLayer = new TSLCADRGDataLayer;
+      break;
+    default:
+      return NULL;
+      break;
+  }
+
+  if( !dataLayer->loadData( fileName ) )
+  {
+    dataLayer->destroy();
+    return NULL;
+  }
+
+  // Add the MapLink map to the TileSource.
+  if( !imagery->addDataLayer(fileName, dataLayer) )
+  {
+    dataLayer->destroy();
+    return NULL;
+  }
+
+  // Initialise the TileSource
+  // This should be called after adding datalayers to the TileSource
+  // to ensure the coordinate system and extent provided to osgEarth
+  // are correct
+  imagery->open();
+
+  // Set the properties for the datalayer such that it will only display once
+  // the view has been zoomed in a defined amount.
+
+  // When the maps extent(in pixels) is greater than tileSize * mapScaleFraction
+  // the map will be displayed.
+  if( m_limitZoomDisplay )
+  {
+    double mapScaleFraction = MAPLINKIMAGERY_MINIMUMZOOMFACTOR;
+
+    TSLTMC x1 = 0;
+    TSLTMC x2 = 0;
+    TSLTMC y1 = 0;
+    TSLTMC y2 = 0;
+
+    bool validExtent = false;
+#ifdef MAPLINK_HAVE_KML
+    // For the KML DataLayer, use the extent of the vector data
+    if( m_layerType == TSLDataLayerTypeKMLDataLayer )
+    {
+      TSLKMLDataLayer* kmlLayer = (TSLKMLDataLayer*)dataLayer;
+      validExtent = kmlLayer->getLayer(0)->getTMCExtent( &x1, &y1, &x2, &y2 );
+    }
+    else
+#endif
+    {
+      validExtent = dataLayer->getTMCExtent(&x1, &y1, &x2, &y2);
+    }
+
+    if( validExtent )
+    {
+      int width  = x2 - x1;
+      int height = y2 - y1;
+      int mapSizeTMCs = width > height ? width : height;
+
+      // As the view is zoomed in, the TMCs per pixel value decreases, as such we must set
+      // the TSLPropertyMaxZoomDisplay, to define the minimum zoom that the map is displayed for.
+      // The tiles of this renderer are drawn at its own tile size, so the limit is worked out for it.
+      int maxZoomDisplay = mapSizeTMCs / (mapScaleFraction * tileSize);
+
+      // Set the calculated factor on the datalayer, via the tilesource's drawing surface
+      imagery->lock();
+      imagery->drawingSurface()->setDataLayerProps(fileName, TSLPropertyMaxZoomDisplay, maxZoomDisplay );
+      imagery->unlock();
+    }
+  }
+
+  return imagery.release();
+}
@@ -0,0 +1,33 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef MAPLINKIMAGERYFACTORY_H
+#define MAPLINKIMAGERYFACTORY_H
+
+#include <string>
+
+#include <tsldatalayertypeenum.h>
+
+#include "imagerytilepool.h"
+
+// Creates the renderers of an imagery tile pool for a MapLink data file.
+//
+// Each renderer loads its own copy of the data layer, so renderers never share MapLink state
+// and can draw at the same time.
+class MapLinkImageryFactory : public ImageryTilePool::Factory
+{
+public:
+  // If limitZoomDisplay is set the data is only drawn once the view has been zoomed in far
+  // enough for it to cover a fraction of a tile, see MAPLINKIMAGERY_MINIMUMZOOMFACTOR.
+  MapLinkImageryFactory(const char* fileName, TSLDataLayerTypeEnum layerType, bool limitZoomDisplay);
+
+  virtual envitia::MapLink::DataLayerTileSource* createRenderer(int tileSize);
+
+private:
+  std::string m_fileName;
+  TSLDataLayerTypeEnum m_layerType;
+  bool m_limitZoomDisplay;
+};
+
+#endif
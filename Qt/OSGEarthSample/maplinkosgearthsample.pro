@@ -100,6 +100,6 @@ unix {
 
 # Input files
 FORMS = osgearthsample.ui simulationOptions.ui
-HEADERS = mainwindow.h maplinktrackobject.h maplinktrackmanager.h simulationoptionsdialog.h osgearthsampleconfig.h viewereventfilter.h
-SOURCES = main.cpp mainwindow.cpp maplinktrackobject.cpp maplinktrackmanager.cpp simulationoptionsdialog.cpp viewereventfilter.cpp
+HEADERS = mainwindow.h maplinktrackobject.h maplinktrackmanager.h trackmotion.h tracklabelscheduler.h trackbuilder.h tracklayoutbudget.h imagerytilepool.h maplinkimageryfactory.h tilediskcache.h tilecommands.h tileprefetcher.h simulationoptionsdialog.h osgearthsampleconfig.h viewereventfilter.h
+SOURCES = main.cpp mainwindow.cpp maplinktrackobject.cpp maplinktrackmanager.cpp trackmotion.cpp tracklabelscheduler.cpp trackbuilder.cpp tracklayoutbudget.cpp imagerytilepool.cpp maplinkimageryfactory.cpp tilediskcache.cpp tilecommands.cpp tileprefetcher.cpp simulationoptionsdialog.cpp viewereventfilter.cpp
 RESOURCES = MapLink.qrc
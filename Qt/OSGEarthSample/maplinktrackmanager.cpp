@@ -3,10 +3,14 @@
 ****************************************************************************/
 #include "simulationoptionsdialog.h"
 #include "maplinktrackmanager.h"
+#include "osgearthsampleconfig.h"
 
-#include <QProgressDialog>
-
+#include <osg/Math>
 #include <osg/OperationThread>
+#include <osg/Timer>
+#include <osg/Notify>
+#include <osg/View>
+#include <osg/Viewport>
 
 #include <osgEarth/MapNode>
 #include <osgEarthAnnotation/TrackNode>
@@ -17,10 +21,26 @@ using namespace osgEarth;
 MaplinkTrackManager::MaplinkTrackManager(int numTracks, osg::Group* rootNode, osgEarth::MapNode* mapNode, bool declutter, QWidget* mainWindow)
   : osg::Operation( "trackmanager", true ) // Set this operations name, and set it to repeat
   , m_simulationSpeed(1)
+  , m_labelScheduler( TRACKS_LABELBUDGET_MS, TRACKS_LABELCACHESIZE )
+  , m_layoutBudget( TRACKS_LAYOUTMAXTRACKS )
   , m_mapNode( mapNode )
-  , m_positionFormat( MaplinkTrackObject::FORMAT_GARS )
+  , m_builder( NULL )
+  , m_targetNumberOfTracks( 0 )
   , m_mainWindow( mainWindow )
-  , m_skipUpdate( false )
+  , m_inserting( false )
+  , m_insertionStartTick( 0 )
+  , m_lastFrameTick( 0 )
+  , m_worstInsertionFrame( 0.0 )
+  , m_insertionFrames( 0 )
+  , m_insertionStartTracks( 0 )
+  , m_accumulatedUpdateTime( 0.0 )
+  , m_accumulatedLabelTime( 0.0 )
+  , m_accumulatedMoved( 0 )
+  , m_accumulatedLayoutTime( 0.0 )
+  , m_worstLayoutTime( 0.0 )
+  , m_accumulatedOnScreen( 0 )
+  , m_layoutFramesOverBudget( 0 )
+  , m_accumulatedFrames( 0 )
 {
   // Setup the track schema
   // draw the track name above the icon:
@@ -39,10 +59,15 @@ MaplinkTrackManager::MaplinkTrackManager(int numTracks, osg::Group* rootNode, os
   posSymbol->size() = posSymbol->size()->eval() - 2.0f;
   m_trackNodeSchema[SCHEMAFIELD_POSITION] = Annotation::TrackNodeField(posSymbol, true);
 
-  srand(time(NULL));
+  resetLayoutStatistics();
+  resetUpdateStatistics();
+  resetInsertionStatistics();
+
+  m_labelScheduler.positionFormat( MaplinkTrackObject::FORMAT_GARS );
 
   // Initialise the tracks
   m_tracksGroup = new osg::Group();
+  m_builder = new TrackBuilder( m_mapNode, m_tracksGroup.get(), m_trackNodeSchema );
   addOrRemoveTracks(numTracks);
 
   rootNode->addChild( m_tracksGroup );
@@ -58,71 +83,297 @@ MaplinkTrackManager::MaplinkTrackManager(int numTracks, osg::Group* rootNode, os
   osgEarth::ScreenSpaceLayout::setOptions( declutterOptions );
 
   osgEarth::ScreenSpaceLayout::setDeclutteringEnabled(declutter);
+  m_layoutBudget.decluttering(declutter);
 }
 
 MaplinkTrackManager::~MaplinkTrackManager()
 {
+  // Stop building tracks before the tracks group and schema go
+  delete m_builder;
   m_tracks.clear();
 }
 
 void MaplinkTrackManager::operator()(osg::Object* obj)
 {
-  if( m_skipUpdate )
-  {
-    return;
-  }
+  // Add the tracks built since the last frame, or remove surplus tracks
+  absorbTracks();
+
   osg::View* view = dynamic_cast<osg::View*>(obj);
   // Time in seconds since the start of the simulation
   double time = view->getFrameStamp()->getSimulationTime();
-  MaplinkTracks::iterator it( m_tracks.begin() );
-  MaplinkTracks::iterator end( m_tracks.end() );
-  while( it != end )
+
+  // Tracks that have moved less than a pixel are left where they are
+  double pixelAnglePerMetre = 0.0;
+  double eyeAltitude = 0.0;
+  pixelSize(view, pixelAnglePerMetre, eyeAltitude);
+
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+  size_t formattedBefore = m_labelScheduler.statistics().m_formatted;
+  size_t numMoved = 0;
+  const size_t numTracks = m_tracks.size();
+  for( size_t index = 0; index < numTracks; ++index )
   {
-    it->get()->update(time, m_simulationSpeed, m_positionFormat);
-    ++it;
+    if( m_tracks[index]->update(time, m_simulationSpeed, pixelAnglePerMetre, eyeAltitude) )
+    {
+      // The label is only formatted if the track has moved into a different label cell
+      m_labelScheduler.trackMoved(m_tracks, index);
+      ++numMoved;
+    }
   }
+  osg::Timer_t labelTick = osg::Timer::instance()->tick();
+
+  // Format the labels that weren't cached, within the time budget
+  m_labelScheduler.process(m_tracks);
+
+  osg::Timer_t endTick = osg::Timer::instance()->tick();
+
+  // Hide the tracks off screen, and the least important ones past the layout budget
+  m_layoutBudget.update(view, m_tracks);
+
+  reportUpdateTime( osg::Timer::instance()->delta_m(startTick, labelTick),
+                    osg::Timer::instance()->delta_m(labelTick, endTick), numMoved,
+                    m_labelScheduler.statistics().m_formatted - formattedBefore );
 }
 
-void MaplinkTrackManager::addOrRemoveTracks(int targetNumber)
+bool MaplinkTrackManager::pixelSize(osg::View* view, double& pixelAnglePerMetre, double& eyeAltitude) const
+{
+  osg::Camera* camera = view->getCamera();
+  double fovy, aspectRatio, zNear, zFar;
+  if( !camera || !camera->getViewport() || camera->getViewport()->height() <= 0.0 ||
+      !camera->getProjectionMatrixAsPerspective(fovy, aspectRatio, zNear, zFar) )
+  {
+    return false;
+  }
+
+  // A pixel at a distance d from the camera covers 2 d tan(fovy / 2) / height metres,
+  // which is turned into an angle at the centre of the Earth
+  double metresPerPixelPerMetre = 2.0 * tan( osg::DegreesToRadians(fovy) * 0.5 ) / camera->getViewport()->height();
+  pixelAnglePerMetre = metresPerPixelPerMetre / TrackMotion::earthRadius;
+
+  osg::Vec3d eye = osg::Vec3d(0.0, 0.0, 0.0) * camera->getInverseViewMatrix();
+  eyeAltitude = eye.length() - TrackMotion::earthRadius;
+  return true;
+}
+
+void MaplinkTrackManager::reportUpdateTime(double updateTime, double labelTime, size_t numMoved, size_t numFormatted)
 {
-  int numberOfOperations = 0;
-  if( m_tracks.size() < targetNumber )
+  const TrackLayoutBudget::Statistics& layoutStatistics = m_layoutBudget.statistics();
+  m_accumulatedUpdateTime += updateTime;
+  m_accumulatedLabelTime += labelTime;
+  m_accumulatedMoved += numMoved;
+  m_accumulatedLayoutTime += layoutStatistics.m_time;
+  m_accumulatedOnScreen += layoutStatistics.m_onScreen;
+  m_worstLayoutTime = osg::maximum( m_worstLayoutTime, layoutStatistics.m_time );
+  if( layoutStatistics.m_time > TRACKS_LAYOUTBUDGET_MS )
+  {
+    ++m_layoutFramesOverBudget;
+    ++m_layoutStatistics.m_framesOverBudget;
+  }
+  ++m_layoutStatistics.m_frames;
+  m_layoutStatistics.m_totalTime += layoutStatistics.m_time;
+  m_layoutStatistics.m_worstTime = osg::maximum( m_layoutStatistics.m_worstTime, layoutStatistics.m_time );
+  m_layoutStatistics.m_mostOnScreen = osg::maximum( m_layoutStatistics.m_mostOnScreen, layoutStatistics.m_onScreen );
+  ++m_updateStatistics.m_frames;
+  m_updateStatistics.m_totalTime += updateTime;
+  m_updateStatistics.m_worstTime = osg::maximum( m_updateStatistics.m_worstTime, updateTime );
+  m_updateStatistics.m_totalMoved += numMoved;
+  m_updateStatistics.m_totalLabelTime += labelTime;
+  m_updateStatistics.m_worstLabelledTime = osg::maximum( m_updateStatistics.m_worstLabelledTime, updateTime + labelTime );
+  m_updateStatistics.m_totalFormatted += numFormatted;
+  if( ++m_accumulatedFrames < 100 )
   {
-    numberOfOperations = targetNumber - m_tracks.size();
-    m_tracks.reserve(numberOfOperations);
+    return;
   }
-  else if( m_tracks.size() > targetNumber )
+
+  const TrackLabelScheduler::Statistics& labelStatistics = m_labelScheduler.statistics();
+  OSG_INFO << "Track update: " << m_tracks.size() << " tracks, "
+           << m_accumulatedUpdateTime / m_accumulatedFrames << " ms per frame, "
+           << m_accumulatedMoved / m_accumulatedFrames << " tracks moved per frame" << std::endl;
+  OSG_INFO << "Track labels: " << m_accumulatedLabelTime / m_accumulatedFrames << " ms per frame, "
+           << (double)labelStatistics.m_formatted / m_accumulatedFrames << " formatted and "
+           << (double)labelStatistics.m_cacheHits / m_accumulatedFrames << " cached per frame, "
+           << labelStatistics.m_queued << " queued" << std::endl;
+  OSG_INFO << "Track layout: " << m_accumulatedOnScreen / m_accumulatedFrames << " tracks on screen, "
+           << layoutStatistics.m_inLayout << " in the layout, "
+           << m_accumulatedLayoutTime / m_accumulatedFrames << " ms per frame, worst "
+           << m_worstLayoutTime << " ms" << std::endl;
+  if( m_layoutFramesOverBudget > 0 )
   {
-    numberOfOperations = m_tracks.size() - targetNumber;
+    OSG_NOTICE << "Track layout: " << m_layoutFramesOverBudget << " of the last " << m_accumulatedFrames
+               << " frames took longer than the budget of " << TRACKS_LAYOUTBUDGET_MS << " ms" << std::endl;
   }
 
-  QProgressDialog progress("Modifying Tracks...", "Cancel",m_tracks.size(), numberOfOperations, m_mainWindow);
-  progress.setWindowModality(Qt::WindowModal);
+  m_labelScheduler.resetStatistics();
+  m_accumulatedUpdateTime = 0.0;
+  m_accumulatedLabelTime = 0.0;
+  m_accumulatedMoved = 0;
+  m_accumulatedLayoutTime = 0.0;
+  m_worstLayoutTime = 0.0;
+  m_accumulatedOnScreen = 0;
+  m_layoutFramesOverBudget = 0;
+  m_accumulatedFrames = 0;
+}
 
-  while(m_tracks.size() < targetNumber)
+void MaplinkTrackManager::addOrRemoveTracks(int targetNumber)
+{
+  m_targetNumberOfTracks = targetNumber > 0 ? targetNumber : 0;
+
+  size_t requested = m_tracks.size() + m_builder->pending();
+  if( requested > m_targetNumberOfTracks )
+  {
+    // Drop the tracks still to be added. Surplus tracks in the scene are removed by absorbTracks()
+    m_builder->cancel();
+    requested = m_tracks.size();
+  }
+  if( requested < m_targetNumberOfTracks )
   {
-    m_tracks.push_back( new MaplinkTrackObject(m_mapNode, m_tracksGroup, m_tracks.size(), m_trackNodeSchema, m_maplinkSymbols) );
-    progress.setValue(m_tracks.size());
-    if( progress.wasCanceled() )
+    m_builder->build( (int)requested, (int)(m_targetNumberOfTracks - requested) );
+  }
+}
+
+void MaplinkTrackManager::absorbTracks()
+{
+  size_t numTracks = m_tracks.size();
+  if( numTracks < m_targetNumberOfTracks )
+  {
+    if( m_builder->takeBuilt( TRACKS_ATTACHBATCH, m_tracks ) > 0 )
     {
-      return;
+      for( size_t index = numTracks; index < m_tracks.size(); ++index )
+      {
+        m_tracks[index]->attach();
+      }
     }
   }
-  while(m_tracks.size() > targetNumber)
+  else if( numTracks > m_targetNumberOfTracks )
   {
-    m_tracks.pop_back();
+    size_t numRemoved = osg::minimum( numTracks - m_targetNumberOfTracks, (size_t)TRACKS_ATTACHBATCH );
 
-    progress.setValue(m_tracks.size());
-    if( progress.wasCanceled() )
+    // The track nodes are in the tracks group in the same order as the tracks,
+    // so the nodes of the last tracks can be removed together. If the group holds
+    // other nodes they are removed one by one, so none are left in the scene.
+    if( m_tracksGroup->getNumChildren() == numTracks )
     {
-      return;
+      m_tracksGroup->removeChildren( numTracks - numRemoved, numRemoved );
     }
+    else
+    {
+      for( size_t index = numTracks - numRemoved; index < numTracks; ++index )
+      {
+        m_tracks[index]->detach();
+      }
+    }
+    m_tracks.resize( numTracks - numRemoved );
+  }
+
+  if( m_tracks.size() != numTracks )
+  {
+    m_labelScheduler.numTracks( m_tracks.size() );
   }
+  recordInsertionFrame( m_tracks.size() != m_targetNumberOfTracks );
+}
+
+void MaplinkTrackManager::recordInsertionFrame(bool inserting)
+{
+  osg::Timer_t tick = osg::Timer::instance()->tick();
+  if( inserting && !m_inserting )
+  {
+    m_inserting = true;
+    m_insertionStartTick = tick;
+    m_worstInsertionFrame = 0.0;
+    m_insertionFrames = 0;
+    m_insertionStartTracks = m_tracks.size();
+  }
+  else if( m_inserting )
+  {
+    // The time since the last update is the time taken by the last frame
+    double frameTime = osg::Timer::instance()->delta_m( m_lastFrameTick, tick );
+    m_worstInsertionFrame = osg::maximum( m_worstInsertionFrame, frameTime );
+    ++m_insertionFrames;
+
+    if( !inserting )
+    {
+      m_inserting = false;
+      m_insertionStatistics.m_startTracks = m_insertionStartTracks;
+      m_insertionStatistics.m_endTracks = m_tracks.size();
+      m_insertionStatistics.m_frames = m_insertionFrames;
+      m_insertionStatistics.m_worstFrame = m_worstInsertionFrame;
+      m_insertionStatistics.m_time = osg::Timer::instance()->delta_s( m_insertionStartTick, tick );
+      OSG_INFO << "Tracks changed from " << m_insertionStartTracks << " to " << m_tracks.size()
+               << " in " << osg::Timer::instance()->delta_s( m_insertionStartTick, tick ) << " s over "
+               << m_insertionFrames << " frames, worst frame " << m_worstInsertionFrame << " ms" << std::endl;
+    }
+  }
+  m_lastFrameTick = tick;
 }
 
 void MaplinkTrackManager::decluttering(bool enabled)
 {
   osgEarth::ScreenSpaceLayout::setDeclutteringEnabled(enabled);
+  m_layoutBudget.decluttering(enabled);
+}
+
+void MaplinkTrackManager::numTracks(int numTracks)
+{
+  addOrRemoveTracks(numTracks);
+}
+
+size_t MaplinkTrackManager::numTracks() const
+{
+  return m_tracks.size();
+}
+
+const MaplinkTrackManager::LayoutStatistics& MaplinkTrackManager::layoutStatistics() const
+{
+  return m_layoutStatistics;
+}
+
+void MaplinkTrackManager::resetLayoutStatistics()
+{
+  m_layoutStatistics.m_frames = 0;
+  m_layoutStatistics.m_framesOverBudget = 0;
+  m_layoutStatistics.m_totalTime = 0.0;
+  m_layoutStatistics.m_worstTime = 0.0;
+  m_layoutStatistics.m_mostOnScreen = 0;
+}
+
+const MaplinkTrackManager::UpdateStatistics& MaplinkTrackManager::updateStatistics() const
+{
+  return m_updateStatistics;
+}
+
+void MaplinkTrackManager::resetUpdateStatistics()
+{
+  m_updateStatistics.m_frames = 0;
+  m_updateStatistics.m_totalTime = 0.0;
+  m_updateStatistics.m_worstTime = 0.0;
+  m_updateStatistics.m_totalMoved = 0;
+  m_updateStatistics.m_totalLabelTime = 0.0;
+  m_updateStatistics.m_worstLabelledTime = 0.0;
+  m_updateStatistics.m_totalFormatted = 0;
+}
+
+const MaplinkTrackManager::InsertionStatistics& MaplinkTrackManager::insertionStatistics() const
+{
+  return m_insertionStatistics;
+}
+
+void MaplinkTrackManager::resetInsertionStatistics()
+{
+  m_insertionStatistics.m_startTracks = 0;
+  m_insertionStatistics.m_endTracks = 0;
+  m_insertionStatistics.m_frames = 0;
+  m_insertionStatistics.m_worstFrame = 0.0;
+  m_insertionStatistics.m_time = 0.0;
+}
+
+void MaplinkTrackManager::positionFormat(MaplinkTrackObject::PositionFormat format)
+{
+  m_labelScheduler.positionFormat(format);
+}
+
+void MaplinkTrackManager::labelScheduling(bool enabled)
+{
+  m_labelScheduler.scheduling(enabled);
 }
 
 void MaplinkTrackManager::showSimulationOptions()
@@ -130,16 +381,14 @@ void MaplinkTrackManager::showSimulationOptions()
   // Create the options dialog, and make it modal to the main window
   SimulationOptionsDialog options(m_mainWindow);
   options.simulationSpeed(m_simulationSpeed);
-  options.numTracks(m_tracks.size());
-  options.positionFormat(m_positionFormat);
+  // Show the number of tracks asked for, including any still being added or removed
+  options.numTracks((int)m_targetNumberOfTracks);
+  options.positionFormat(m_labelScheduler.positionFormat());
   options.exec();
 
-  // While tracks are being added, don't perform any update operations
-  // This isn't necesarry, but makes the addition of tracks faster
-  m_skipUpdate = true;
+  // The tracks are added or removed over the following frames
   addOrRemoveTracks(options.numTracks());
-  m_skipUpdate = false;
 
   m_simulationSpeed = options.simulationSpeed();
-  m_positionFormat = options.positionFormat();
+  m_labelScheduler.positionFormat(options.positionFormat());
 }
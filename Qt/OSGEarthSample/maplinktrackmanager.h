@@ -5,10 +5,11 @@
 ****************************************************************************/
 #include <QWidget>
 
-#include <osgEarthMapLink/MilitarySymbols.h>
+#include <osg/Timer>
 #include "maplinktrackobject.h"
-
-typedef std::vector< osg::ref_ptr<MaplinkTrackObject> > MaplinkTracks;
+#include "tracklabelscheduler.h"
+#include "trackbuilder.h"
+#include "tracklayoutbudget.h"
 
 class MaplinkTrackManager : public osg::Operation
 {
@@ -21,14 +22,100 @@ public:
   void decluttering(bool enabled);
   void showSimulationOptions();
 
+  // Set the format of the track position labels
+  void positionFormat(MaplinkTrackObject::PositionFormat format);
+
+  // Enable or disable the scheduling of the position labels. While disabled, the label of a
+  // track is formatted every time the track is moved.
+  void labelScheduling(bool enabled);
+
+  // Set the number of tracks to simulate. The tracks are added or removed over the following frames.
+  void numTracks(int numTracks);
+
+  // Number of tracks in the scene
+  size_t numTracks() const;
+
+  // Timings of the tracks chosen for the screen space layout, since the last reset
+  struct LayoutStatistics
+  {
+    unsigned int m_frames;
+    // Frames where choosing the tracks took longer than TRACKS_LAYOUTBUDGET_MS
+    unsigned int m_framesOverBudget;
+    // In milliseconds
+    double m_totalTime;
+    double m_worstTime;
+    // Most tracks on screen in one frame
+    size_t m_mostOnScreen;
+  };
+
+  const LayoutStatistics& layoutStatistics() const;
+  void resetLayoutStatistics();
+
+  // Timings of moving the tracks, since the last reset
+  struct UpdateStatistics
+  {
+    unsigned int m_frames;
+    // In milliseconds. Includes formatting the labels of the moved tracks while the labels aren't scheduled.
+    double m_totalTime;
+    double m_worstTime;
+    // Tracks whose node was moved, over all the frames
+    size_t m_totalMoved;
+    // Time formatting the queued labels, in milliseconds
+    double m_totalLabelTime;
+    // Worst time moving the tracks and formatting their labels in one frame, in milliseconds
+    double m_worstLabelledTime;
+    // Labels formatted, over all the frames
+    size_t m_totalFormatted;
+  };
+
+  const UpdateStatistics& updateStatistics() const;
+  void resetUpdateStatistics();
+
+  // Frame timings of the last time tracks were added or removed, once the number of tracks was reached
+  struct InsertionStatistics
+  {
+    size_t m_startTracks;
+    size_t m_endTracks;
+    // Zero until tracks have been added or removed since the last reset
+    unsigned int m_frames;
+    // In milliseconds
+    double m_worstFrame;
+    // In seconds
+    double m_time;
+  };
+
+  const InsertionStatistics& insertionStatistics() const;
+  void resetInsertionStatistics();
+
 private:
+  // Set the number of tracks. Tracks are built in the background and added, or removed,
+  // a batch at a time by the update operation.
   void addOrRemoveTracks(int targetNumber);
 
+  // Add a batch of the built tracks to the scene, or remove a batch of surplus tracks
+  void absorbTracks();
+
+  // Record the frame times while tracks are being added or removed, and report the worst
+  // one at the OSG info notify level once the number of tracks has been reached
+  void recordInsertionFrame(bool inserting);
+
+  // Work out the size of a pixel for the current view, as an angle in radians per metre of distance
+  // from the camera, and the altitude of the camera. Returns false if the view isn't a perspective view.
+  bool pixelSize(osg::View* view, double& pixelAnglePerMetre, double& eyeAltitude) const;
+
+  // Report the average time taken to update the tracks, their labels and the layout, at the OSG info notify level.
+  // Frames where choosing the tracks for the layout took longer than its budget are reported as notices.
+  void reportUpdateTime(double updateTime, double labelTime, size_t numMoved, size_t numFormatted);
+
   osgEarth::Annotation::TrackNodeFieldSchema m_trackNodeSchema;
   MaplinkTracks m_tracks;
-  int m_numberOfTracks;
   int m_simulationSpeed;
-  MaplinkTrackObject::PositionFormat m_positionFormat;
+
+  // Formats the position labels of the tracks, in the selected position format
+  TrackLabelScheduler m_labelScheduler;
+
+  // Chooses the tracks given to the screen space layout
+  TrackLayoutBudget m_layoutBudget;
 
   // A pointer to the map node. Only used for creating the tracks group
   osgEarth::MapNode* m_mapNode;
@@ -36,16 +123,36 @@ private:
   // This is a ref_ptr to ensure the group isn't deleted before we have removed all the tracks
   osg::ref_ptr<osg::Group> m_tracksGroup;
 
-  // Used to convert MapLink APP6A symbols to 
-  // an osg::Image
-  envitia::MapLink::MilitarySymbols m_maplinkSymbols;
+  // Builds the tracks being added in the background
+  TrackBuilder* m_builder;
+
+  // Number of tracks requested
+  size_t m_targetNumberOfTracks;
 
   // Used for constructing modal dialogs
   QWidget* m_mainWindow;
 
-  // This should be set while performing expensive operations, 
-  // such as adding/removing tracks.
-  bool m_skipUpdate;
+  // Frame timings while tracks are being added or removed
+  bool m_inserting;
+  osg::Timer_t m_insertionStartTick;
+  osg::Timer_t m_lastFrameTick;
+  double m_worstInsertionFrame;
+  unsigned int m_insertionFrames;
+  size_t m_insertionStartTracks;
+
+  // Update timings accumulated since they were last reported
+  double m_accumulatedUpdateTime;
+  double m_accumulatedLabelTime;
+  size_t m_accumulatedMoved;
+  double m_accumulatedLayoutTime;
+  double m_worstLayoutTime;
+  size_t m_accumulatedOnScreen;
+  unsigned int m_layoutFramesOverBudget;
+  unsigned int m_accumulatedFrames;
+
+  LayoutStatistics m_layoutStatistics;
+  UpdateStatistics m_updateStatistics;
+  InsertionStatistics m_insertionStatistics;
 };
 
 #endif
@@ -4,8 +4,8 @@
 
 #include "maplinktrackobject.h"
 
+#include <osg/Math>
 #include <osgEarth/Units>
-#include <osgEarth/GeoMath>
 #include <osgEarthAnnotation/AnnotationData>
 
 using namespace osgEarth;
@@ -30,12 +30,14 @@ static const size_t possibleMaplinkTrackObjectsSize = sizeof(possibleMaplinkTrac
 
 const MaplinkTrackObjectProperties& MaplinkTrackObject::getRandomPossibleObject()
 {
-  return possibleMaplinkTrackObjects[rand() % possibleMaplinkTrackObjectsSize];
+  std::uniform_int_distribution<size_t> index(0, possibleMaplinkTrackObjectsSize - 1);
+  return possibleMaplinkTrackObjects[index(m_random)];
 }
 
-const TSLAPP6ASymbol::HostilityEnum MaplinkTrackObject::getRandomPossibleHostility()
+TSLAPP6ASymbol::HostilityEnum MaplinkTrackObject::getRandomPossibleHostility()
 {
-  switch(rand() % 7)
+  std::uniform_int_distribution<int> hostility(0, 6);
+  switch(hostility(m_random))
   {
     case 0:
       return TSLAPP6ASymbol::HostilityAssumedFriend;
@@ -56,15 +58,35 @@ const TSLAPP6ASymbol::HostilityEnum MaplinkTrackObject::getRandomPossibleHostili
   }
 }
 
-const double MaplinkTrackObject::random(double min, double max)
+// Declutter ranks of the hostilities, threats first
+static int hostilityRankOf(TSLAPP6ASymbol::HostilityEnum hostility)
 {
-  return ((max - min) * ( (double)rand() / (double)RAND_MAX ) + min);
+  switch(hostility)
+  {
+    case TSLAPP6ASymbol::HostilityHostile:
+      return 3;
+    case TSLAPP6ASymbol::HostilitySuspect:
+    case TSLAPP6ASymbol::HostilityJoker:
+    case TSLAPP6ASymbol::HostilityFaker:
+      return 2;
+    case TSLAPP6ASymbol::HostilityNeutral:
+      return 1;
+    case TSLAPP6ASymbol::HostilityAssumedFriend:
+    case TSLAPP6ASymbol::HostilityFriend:
+    default:
+      return 0;
+  }
+}
+
+double MaplinkTrackObject::random(double min, double max)
+{
+  return std::uniform_real_distribution<double>(min, max)(m_random);
 }
 
-MaplinkTrackObject::MaplinkTrackObject(MapNode* mapNode, osg::Group* parent, int trackIndex, osgEarth::Annotation::TrackNodeFieldSchema& schema, envitia::MapLink::MilitarySymbols& maplinkSymbols)
-  : m_startTime(0.0)
-  , m_greatCircleDistance(0.0)
+MaplinkTrackObject::MaplinkTrackObject(MapNode* mapNode, osg::Group* parent, int trackIndex, unsigned int seed, osgEarth::Annotation::TrackNodeFieldSchema& schema, envitia::MapLink::MilitarySymbols& maplinkSymbols)
+  : m_random(seed)
   , m_parent(parent)
+  , m_inLayout(true)
 {
   // Setup the maplink APP6a symbol
   m_app6aSymbol.textColour(216); //white
@@ -86,25 +108,23 @@ MaplinkTrackObject::MaplinkTrackObject(MapNode* mapNode, osg::Group* parent, int
   //Generate a symbol using one of the possible ids, and a random hostility value
   MaplinkTrackObjectProperties properties = getRandomPossibleObject();
   m_app6aSymbol.id( properties.id );
-  m_app6aSymbol.hostility( getRandomPossibleHostility() );
+  TSLAPP6ASymbol::HostilityEnum hostility = getRandomPossibleHostility();
+  m_app6aSymbol.hostility( hostility );
+  m_hostilityRank = hostilityRankOf( hostility );
 
   // set lat/lon to random values
-  m_startLatitude  = random(-90.0, 90.0);
+  double startLatitude  = random(-90.0, 90.0);
+  double startLongitude = random(-180.0, 180.0);
   m_endLatitude    = random(-90.0, 90.0);
-  m_startLongitude = random(-180.0, 180.0);
   m_endLongitude   = random(-180.0, 180.0);
   const SpatialReference* geoSRS = mapNode->getMapSRS()->getGeographicSRS();
-  GeoPoint pos(geoSRS, m_startLongitude.as(Units::DEGREES), m_startLatitude.as(Units::DEGREES));
+  GeoPoint pos(geoSRS, startLongitude, startLatitude);
+  pos.toWorld(m_worldPosition);
 
-  // Use preset speed and positions to calculate time to target point
+  // Use preset speed and positions to set up the first leg
   m_speed = properties.speed;
   m_altitude = properties.altitude;
-  m_greatCircleDistance = TSLCoordinateConverter::greatCircleDistance(m_startLatitude.as(Units::DEGREES), 
-                                                                m_startLongitude.as(Units::DEGREES), 
-                                                                m_endLatitude.as(Units::DEGREES), 
-                                                                m_endLongitude.as(Units::DEGREES));
-
-  m_eta = m_greatCircleDistance / m_speed;
+  m_motion.setLeg(startLatitude, startLongitude, m_endLatitude, m_endLongitude, m_speed, 0.0);
 
 
   // Convert the Maplink APP6A Symbol to an osgEarth track
@@ -117,83 +137,94 @@ MaplinkTrackObject::MaplinkTrackObject(MapNode* mapNode, osg::Group* parent, int
 
 
   m_trackNode->setPriority( (float)m_altitude );
-
-  m_parent->addChild( m_trackNode );
 }
 
 MaplinkTrackObject::~MaplinkTrackObject()
 {
-  m_parent->removeChild((osg::Node*)m_trackNode);
+  detach();
 }
 
-void MaplinkTrackObject::update(const double& time, const int& simulationSpeed, const PositionFormat& positionFormat)
+void MaplinkTrackObject::attach()
 {
-  // Calculate how far along the path the track should be
-  double routeProgress = ((time - m_startTime)*simulationSpeed) / m_eta;
-
-  osg::Vec3d pos;
-  GeoMath::interpolate( m_startLatitude.as(Units::RADIANS),
-                        m_startLongitude.as(Units::RADIANS),
-                        m_endLatitude.as(Units::RADIANS),
-                        m_endLongitude.as(Units::RADIANS),
-                        routeProgress,
-                        pos.y(), pos.x() );
-
-  double x(osg::RadiansToDegrees(pos.x()));
-  double y(osg::RadiansToDegrees(pos.y()));
+  m_parent->addChild( m_trackNode );
+}
 
-  GeoPoint geo( m_trackNode->getMapNode()->getMapSRS(),
-                x,
-                y,
-                m_altitude,
-                ALTMODE_ABSOLUTE);
+void MaplinkTrackObject::detach()
+{
+  // The node isn't in the parent if it was never attached, or if the track manager
+  // has already removed it with a batch of other tracks
+  if( m_trackNode->getNumParents() > 0 )
+  {
+    m_parent->removeChild((osg::Node*)m_trackNode);
+  }
+}
 
-  m_trackNode->setPosition(geo);
+bool MaplinkTrackObject::update(const double& time, const int& simulationSpeed,
+                                const double& pixelAnglePerMetre, const double& eyeAltitude)
+{
+  // Calculate how far along the path the track should be
+  double routeProgress = m_motion.evaluate(time, simulationSpeed);
 
+  // Only move the track node once the track has moved by a pixel. The pixel size is taken directly
+  // below the camera, where it is smallest, so tracks elsewhere in the view are moved a little
+  // more often than needed.
+  double pixelAngle = pixelAnglePerMetre * osg::maximum(eyeAltitude - m_altitude, 1.0);
+  bool moved = m_motion.movedFurtherThan(pixelAngle);
 
-  switch(positionFormat)
+  if( moved )
   {
-    case FORMAT_GARS:
-      {
-        const char* garsStr = TSLCoordinateConverter::latLongToGARS(y, x);
-        if( garsStr )
-        {
-          m_trackNode->setFieldValue( SCHEMAFIELD_POSITION, garsStr);
-        }
-      }
-      break;
-    case FORMAT_MGRS:
-      {
-        const char* mgrsStr = TSLCoordinateConverter::latLongToMGRS(y, x);
-        if( mgrsStr )
-        {
-          m_trackNode->setFieldValue( SCHEMAFIELD_POSITION, mgrsStr);
-        }
-        break;
-      }
-    case FORMAT_LATLON:
-      m_trackNode->setFieldValue( SCHEMAFIELD_POSITION, Stringify() << y << " : " << x );
-      break;
-    case FORMAT_NONE:
-    default:
-      m_trackNode->setFieldValue( SCHEMAFIELD_POSITION, "" );
-      break;
+    double x, y;
+    m_motion.position(y, x);
+
+    GeoPoint geo( m_trackNode->getMapNode()->getMapSRS(),
+                  x,
+                  y,
+                  m_altitude,
+                  ALTMODE_ABSOLUTE);
+
+    m_trackNode->setPosition(geo);
+    geo.toWorld(m_worldPosition);
+    m_motion.markPlaced();
   }
-  
+
   // If the end point has been reached, set a new target
   if( routeProgress >= 1.0 )
   {
-    m_startLatitude = geo.y();
-    m_startLongitude = geo.x();
-    m_endLatitude = random(-90.0, 90.0);
-    m_endLongitude = random(-180.0, 180.0);
-
-    double distance = TSLCoordinateConverter::greatCircleDistance(m_startLatitude.as(Units::DEGREES), 
-                                                                  m_startLongitude.as(Units::DEGREES), 
-                                                                  m_endLatitude.as(Units::DEGREES), 
-                                                                  m_endLongitude.as(Units::DEGREES));
-
-    m_eta = distance / m_speed;
-    m_startTime = time;
+    double nextLatitude = random(-90.0, 90.0);
+    double nextLongitude = random(-180.0, 180.0);
+    m_motion.setLeg(m_endLatitude, m_endLongitude, nextLatitude, nextLongitude, m_speed, time);
+    m_endLatitude = nextLatitude;
+    m_endLongitude = nextLongitude;
+  }
+
+  return moved;
+}
+
+void MaplinkTrackObject::placedPosition(double& lat, double& lon) const
+{
+  m_motion.placedPosition(lat, lon);
+}
+
+void MaplinkTrackObject::positionLabel(const std::string& label)
+{
+  m_trackNode->setFieldValue( SCHEMAFIELD_POSITION, label );
+}
+
+const osg::Vec3d& MaplinkTrackObject::worldPosition() const
+{
+  return m_worldPosition;
+}
+
+int MaplinkTrackObject::hostilityRank() const
+{
+  return m_hostilityRank;
+}
+
+void MaplinkTrackObject::inLayout(bool inLayout)
+{
+  if( inLayout != m_inLayout )
+  {
+    m_trackNode->setNodeMask( inLayout ? ~0u : 0u );
+    m_inLayout = inLayout;
   }
 }
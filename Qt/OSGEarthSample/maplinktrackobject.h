@@ -4,6 +4,8 @@
                 Copyright (c) 2017 by Envitia Group PLC.
 ****************************************************************************/
 
+#include <random>
+
 #include <osg/ref_ptr>
 #include <osgEarth/Units>
 #include <osgEarth/MapNode>
@@ -11,6 +13,8 @@
 #include <osgEarthMapLink/MilitarySymbols.h>
 #include <MapLink.h>
 
+#include "trackmotion.h"
+
 #define ICONSIZE 50
 #define SCHEMAFIELD_NAME     "name"
 #define SCHEMAFIELD_POSITION "position"
@@ -35,32 +39,72 @@ public:
     FORMAT_LATLON
   };
 
-  MaplinkTrackObject(osgEarth::MapNode* mapNode, osg::Group* parent, int trackIndex, osgEarth::Annotation::TrackNodeFieldSchema& schema, envitia::MapLink::MilitarySymbols& maplinkSymbols);
+  // Create the track and its track node. The node isn't added to the parent until attach() is called,
+  // so tracks can be created away from the thread updating the scene. The track's symbol, hostility
+  // and waypoints are drawn from its own random number generator, started from seed.
+  MaplinkTrackObject(osgEarth::MapNode* mapNode, osg::Group* parent, int trackIndex, unsigned int seed, osgEarth::Annotation::TrackNodeFieldSchema& schema, envitia::MapLink::MilitarySymbols& maplinkSymbols);
   ~MaplinkTrackObject();
 
-  void update(const double& time, const int& simulationSpeed, const PositionFormat& positionFormat);
+  // Add the track node to the parent
+  void attach();
+
+  // Remove the track node from the parent, if it is in it
+  void detach();
+
+  // Move the track to its position at the given time.
+  // The track node is only moved once the track has moved by a pixel, which is given as an angle
+  // in radians per metre of distance from the camera. eyeAltitude is the altitude of the camera.
+  // Returns true if the track node was moved.
+  bool update(const double& time, const int& simulationSpeed,
+              const double& pixelAnglePerMetre, const double& eyeAltitude);
+
+  // Position of the track node, in degrees
+  void placedPosition(double& lat, double& lon) const;
+
+  // Set the position label of the track node
+  void positionLabel(const std::string& label);
+
+  // Position of the track node in world coordinates
+  const osg::Vec3d& worldPosition() const;
+
+  // Rank of the hostility of the track for decluttering, higher is more important
+  int hostilityRank() const;
+
+  // Show or hide the track node. Hidden tracks are left out of the scene traversals,
+  // including the screen space layout.
+  void inLayout(bool inLayout);
 
 private:
-  static const MaplinkTrackObjectProperties& getRandomPossibleObject();
-  static const TSLAPP6ASymbol::HostilityEnum getRandomPossibleHostility();
-  static const double random(double min, double max);
+  const MaplinkTrackObjectProperties& getRandomPossibleObject();
+  TSLAPP6ASymbol::HostilityEnum getRandomPossibleHostility();
+  double random(double min, double max);
+
+  // Only used by the thread creating or updating the track, so tracks can be built on one thread
+  // while others are updated on another
+  std::minstd_rand m_random;
 
-  osgEarth::Angular m_startLatitude;
-  osgEarth::Angular m_startLongitude;
-  osgEarth::Angular m_endLatitude;
-  osgEarth::Angular m_endLongitude;
+  // Motion along the current leg, set up once per waypoint
+  TrackMotion m_motion;
+
+  // Waypoint at the end of the current leg, in degrees
+  double m_endLatitude;
+  double m_endLongitude;
 
   osg::ref_ptr<osgEarth::Annotation::TrackNode> m_trackNode;
   osg::ref_ptr<osg::Group> m_parent;
 
   TSLAPP6ASymbol m_app6aSymbol;
 
-  double m_greatCircleDistance;
-
   unsigned int m_speed;
-  unsigned int m_eta;
   unsigned int m_altitude;
-  double m_startTime;
+
+  // World position of the track node, updated when the node is moved
+  osg::Vec3d m_worldPosition;
+
+  int m_hostilityRank;
+  bool m_inLayout;
 };
 
+typedef std::vector< osg::ref_ptr<MaplinkTrackObject> > MaplinkTracks;
+
 #endif
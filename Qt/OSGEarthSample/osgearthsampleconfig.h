@@ -13,6 +13,10 @@
 // This is the resolution of the tile in pixels
 #define TERRAIN_TILESIZE                   1024
 
+// Tiles are shown once the camera is within this many times their radius
+// The higher the value, the earlier the tiles are brought in
+#define TERRAIN_MINTILERANGEFACTOR         6
+
 // This is the number of levels that OSGEarth goes down requesting smaller tile extents
 // So the higher the number the smaller the tile extents but the more often it will request tiles and terrain data
 // So this is a tradeoff between resolution and performance
@@ -20,8 +24,59 @@
 
 #define TRACKS_INITIALNUMBER               10
 
+// Maximum number of tracks added to, or removed from, the scene in one frame
+// Tracks are built in the background, so this only bounds the cost of attaching them
+#define TRACKS_ATTACHBATCH                 500
+
+// Maximum number of on screen tracks given to the screen space layout while decluttering
+// The most important tracks are kept: threats first, then the nearest
+#define TRACKS_LAYOUTMAXTRACKS             2000
+
+// Time in milliseconds choosing the tracks for the screen space layout is expected to take each frame
+#define TRACKS_LAYOUTBUDGET_MS             2.0
+
+// Time in milliseconds allowed each frame for formatting track position labels
+// Labels that don't fit in the budget are formatted in the following frames
+#define TRACKS_LABELBUDGET_MS              2.0
+
+// Number of formatted position labels cached by label cell
+#define TRACKS_LABELCACHESIZE              65536
+
 #define IMAGERY_TILESIZE                   256
 #define IMAGERY_TILESIZE_STR              "256"
+
+// Tile sizes of the coarsest and finest levels of MapLink imagery
+// Tiles of the levels below IMAGERY_COARSELEVELS cover the most data, so are the slowest to draw, and are drawn smaller
+// Tiles of IMAGERY_DETAILLEVEL and finer are drawn larger, as they are seen close up
+#define IMAGERY_COARSETILESIZE             128
+#define IMAGERY_COARSELEVELS               4
+#define IMAGERY_DETAILTILESIZE             512
+#define IMAGERY_DETAILLEVEL                12
+
+// Maximum number of MapLink renderers drawing the tiles of an imagery layer at the same time, of all tile sizes
+// Each renderer loads its own copy of the data layer and has its own drawing surface, so a layer holds up to
+// this many copies of its data in memory. A renderer of another tile size is replaced, not added, once the
+// layer has this many.
+#define IMAGERY_RENDERERS                  4
+
+// Maximum size in megabytes of the disk cache of each MapLink imagery layer
+// The least recently used tiles are evicted when the cache grows past it
+#define IMAGERY_CACHESIZE_MB               512
+
+// Prefetching of the MapLink imagery tiles along the path of the camera
+// Number of threads, and of the renderers of each imagery layer, drawing tiles ahead of the camera
+#define IMAGERY_PREFETCHTHREADS            2
+// Time in seconds the camera movement is extrapolated ahead
+#define IMAGERY_PREFETCHSECONDS            3.0
+// Time in seconds between predictions of the camera path
+#define IMAGERY_PREFETCHINTERVAL           0.25
+// Turn in degrees of the camera path that cancels the tiles queued
+#define IMAGERY_PREFETCHTURN               30.0
+// Maximum number of tiles queued. The tiles of earlier predictions are dropped first, then the farthest.
+#define IMAGERY_PREFETCHQUEUE              256
+
+// Number of tiles drawn by the -benchmarktiles command line option
+#define IMAGERY_BENCHMARKTILES             200
 #define MAPLINKIMAGERY_MINIMUMZOOMFACTOR   0.4
 
 #endif
@@ -0,0 +1,250 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "tilecommands.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <QDir>
+#include <QFileInfo>
+
+#include <osg/Timer>
+#include <osgEarth/TileKey>
+
+#include "imagerytilepool.h"
+#include "maplinkimageryfactory.h"
+#include "mainwindow.h"
+#include "osgearthsampleconfig.h"
+#include "tilediskcache.h"
+
+// Create a tile pool for a map, opened and ready to draw. Returns NULL on failure.
+static ImageryTilePool* createPool(const char* fileName, unsigned int numRenderers)
+{
+  osgEarth::TileSourceOptions options;
+  options.tileSize() = IMAGERY_TILESIZE;
+  osg::ref_ptr<ImageryTilePool> pool =
+    new ImageryTilePool( options, new MapLinkImageryFactory( fileName, TSLDataLayerTypeMapDataLayer, false ), numRenderers );
+  if( !pool->valid() || !pool->open().isOK() )
+  {
+    std::cerr << "Failed to load " << fileName << std::endl;
+    return NULL;
+  }
+  return pool.release();
+}
+
+int runTileBenchmark(const char* fileName)
+{
+  static const unsigned int workerCounts[] = { 1, 2, 4, 8 };
+
+  std::vector<osgEarth::TileKey> keys;
+  for( size_t run = 0; run < sizeof(workerCounts) / sizeof(workerCounts[0]); ++run )
+  {
+    unsigned int numWorkers = workerCounts[run];
+    osg::ref_ptr<ImageryTilePool> pool = createPool( fileName, numWorkers );
+    if( !pool.valid() )
+    {
+      return 1;
+    }
+
+    // The tiles covering the data from the first level drawn at the base tile size down, in the order
+    // the pager would ask for them. Tiles of one size are drawn, so no renderer is replaced while timing.
+    if( keys.empty() )
+    {
+      for( unsigned int level = IMAGERY_COARSELEVELS; level < IMAGERY_DETAILLEVEL && keys.size() < IMAGERY_BENCHMARKTILES; ++level )
+      {
+        for( osgEarth::DataExtentList::const_iterator extent = pool->getDataExtents().begin();
+             extent != pool->getDataExtents().end(); ++extent )
+        {
+          pool->tilesCovering( *extent, level, level, keys );
+        }
+      }
+      if( keys.size() > IMAGERY_BENCHMARKTILES )
+      {
+        keys.resize( IMAGERY_BENCHMARKTILES );
+      }
+      if( keys.empty() )
+      {
+        std::cerr << "No tiles cover the data of " << fileName << std::endl;
+        return 1;
+      }
+    }
+
+    // Every renderer loads its own copy of the data, so they are all created before timing
+    unsigned int numRenderers = pool->createRenderers( IMAGERY_TILESIZE );
+    pool->resetStatistics();
+    size_t renderersBefore = pool->statistics().m_renderers;
+    double time = pool->drawTiles( keys, numWorkers );
+
+    ImageryTilePool::Statistics statistics = pool->statistics();
+    std::cout << numWorkers << " workers: " << keys.size() << " tiles in " << time << " ms, "
+              << keys.size() * 1000.0 / time << " tiles/s, "
+              << statistics.m_drawTime / statistics.m_tiles << " ms drawing and "
+              << statistics.m_waitTime / statistics.m_tiles << " ms waiting per tile, "
+              << numRenderers << " renderers" << std::endl;
+    if( statistics.m_renderers != renderersBefore )
+    {
+      std::cout << "  " << statistics.m_renderers - renderersBefore << " renderers were created while timing" << std::endl;
+    }
+  }
+
+  return 0;
+}
+
+int runCacheWarming(const char* fileName, unsigned int minLevel, unsigned int maxLevel, const double* region)
+{
+  std::string cacheDirectory = MainWindow::imageryCacheDirectory( fileName );
+  if( cacheDirectory.empty() )
+  {
+    std::cerr << "Failed to create the cache directory for " << fileName << std::endl;
+    return 1;
+  }
+
+  osg::ref_ptr<ImageryTilePool> pool = createPool( fileName, IMAGERY_RENDERERS );
+  if( !pool.valid() )
+  {
+    return 1;
+  }
+  pool->setCache( new TileDiskCache( cacheDirectory, IMAGERY_CACHESIZE_MB * 1024ULL * 1024ULL ) );
+
+  std::vector<osgEarth::TileKey> keys;
+  if( region )
+  {
+    osgEarth::GeoExtent extent( pool->getProfile()->getSRS()->getGeographicSRS(),
+                                region[0], region[1], region[2], region[3] );
+    pool->tilesCovering( extent, minLevel, maxLevel, keys );
+  }
+  else
+  {
+    for( osgEarth::DataExtentList::const_iterator extent = pool->getDataExtents().begin();
+         extent != pool->getDataExtents().end(); ++extent )
+    {
+      pool->tilesCovering( *extent, minLevel, maxLevel, keys );
+    }
+  }
+
+  // The keys are coarsest first. If there are more tiles than the cache holds, the coarse levels
+  // are the first evicted, as they were written first.
+  double time = pool->drawTiles( keys, IMAGERY_RENDERERS );
+
+  ImageryTilePool::Statistics statistics = pool->statistics();
+  TileDiskCache::Statistics cacheStatistics = pool->cache()->statistics();
+  std::cout << keys.size() << " tiles covering levels " << minLevel << " to " << maxLevel << ", "
+            << statistics.m_tiles << " drawn in " << time << " ms, "
+            << cacheStatistics.m_tiles << " tiles in the cache using "
+            << cacheStatistics.m_diskBytes / (1024 * 1024) << " MB" << std::endl;
+  return 0;
+}
+
+// Key of a generated tile
+static std::string testTileKey(size_t index)
+{
+  std::ostringstream key;
+  key << "test_" << index;
+  return key.str();
+}
+
+// Data of a generated tile, of between 1 and 7 KB, different for every tile
+static std::string testTileData(size_t index)
+{
+  std::string data( 1024 + (index * 7919) % 6144, '\0' );
+  for( size_t i = 0; i < data.size(); ++i )
+  {
+    data[i] = (char)((index * 31 + i) & 0xff);
+  }
+  return data;
+}
+
+// Total size of the packs in the directory, in bytes
+static unsigned long long packBytesOnDisk(const char* directory)
+{
+  unsigned long long bytes = 0;
+  QFileInfoList packs = QDir( directory ).entryInfoList( QStringList() << "*.pack", QDir::Files );
+  for( QFileInfoList::const_iterator pack = packs.begin(); pack != packs.end(); ++pack )
+  {
+    bytes += pack->size();
+  }
+  return bytes;
+}
+
+int runCacheTest(const char* directory)
+{
+  const unsigned long long maxBytes = 4 * 1024 * 1024;
+  const size_t numTiles = 3000;
+  // Tiles read back all the time, which must survive every eviction
+  const size_t numHotTiles = 50;
+
+  TileDiskCache* cache = new TileDiskCache( directory, maxBytes );
+  cache->clear();
+  cache->resetStatistics();
+
+  bool passed = true;
+  unsigned long long mostBytes = 0;
+  std::string data;
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+  for( size_t index = 0; index < numTiles && passed; ++index )
+  {
+    cache->write( testTileKey(index), testTileData(index) );
+
+    unsigned long long diskBytes = packBytesOnDisk( directory );
+    mostBytes = diskBytes > mostBytes ? diskBytes : mostBytes;
+    if( diskBytes > maxBytes || cache->statistics().m_diskBytes > maxBytes )
+    {
+      std::cout << "Cache test: the packs take " << diskBytes << " bytes after writing tile " << index
+                << ", more than the maximum of " << maxBytes << std::endl;
+      passed = false;
+    }
+
+    if( index >= numHotTiles )
+    {
+      size_t hotIndex = index % numHotTiles;
+      if( !cache->read( testTileKey(hotIndex), data ) || data != testTileData(hotIndex) )
+      {
+        std::cout << "Cache test: tile " << hotIndex << " was evicted or damaged after writing tile " << index << std::endl;
+        passed = false;
+      }
+    }
+  }
+  double time = osg::Timer::instance()->delta_m( startTick, osg::Timer::instance()->tick() );
+  TileDiskCache::Statistics statistics = cache->statistics();
+
+  // The cache must hold the same tiles when opened again, with the same data. Reading the tiles
+  // rewrites some of them, which may evict others, so they are counted before any are read.
+  delete cache;
+  cache = new TileDiskCache( directory, maxBytes );
+  std::vector<size_t> reopened;
+  for( size_t index = 0; index < numTiles; ++index )
+  {
+    if( cache->contains( testTileKey(index) ) )
+    {
+      reopened.push_back( index );
+    }
+  }
+  if( passed && reopened.size() != statistics.m_tiles )
+  {
+    std::cout << "Cache test: " << reopened.size() << " tiles after opening the cache again, "
+              << statistics.m_tiles << " before" << std::endl;
+    passed = false;
+  }
+  for( size_t i = 0; i < reopened.size() && passed; ++i )
+  {
+    if( cache->contains( testTileKey(reopened[i]) ) &&
+        (!cache->read( testTileKey(reopened[i]), data ) || data != testTileData(reopened[i])) )
+    {
+      std::cout << "Cache test: tile " << reopened[i] << " is damaged after opening the cache again" << std::endl;
+      passed = false;
+    }
+  }
+  cache->clear();
+  delete cache;
+
+  std::cout << "Cache test: " << numTiles << " tiles written in " << time << " ms, "
+            << (statistics.m_writes > 0 ? statistics.m_writeTime / statistics.m_writes : 0.0) << " ms per write, "
+            << (statistics.m_hits > 0 ? statistics.m_readTime / statistics.m_hits : 0.0) << " ms per read, "
+            << statistics.m_rewrites << " rewrites, " << statistics.m_evictedPacks << " packs evicted, "
+            << statistics.m_tiles << " tiles kept, at most " << mostBytes << " of " << maxBytes << " bytes on disk - "
+            << (passed ? "passed" : "failed") << std::endl;
+  return passed ? 0 : 1;
+}
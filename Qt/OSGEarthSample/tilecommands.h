@@ -0,0 +1,29 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef TILECOMMANDS_H
+#define TILECOMMANDS_H
+
+// Command line operations on the imagery tiles of a MapLink map, run without a viewer.
+// MapLink must have been initialised. The results are written to the standard output,
+// and the functions return the exit code of the application.
+
+// Measure the rate the imagery tiles of a MapLink map are drawn at with 1, 2, 4 and 8 renderers.
+// The same tiles, those covering the data at the first levels drawn at the base tile size, are
+// drawn by each pool of renderers, once the renderers have been created. The disk cache isn't used.
+int runTileBenchmark(const char* fileName);
+
+// Draw the imagery tiles of a MapLink map covering a region into the disk cache, from minLevel
+// to maxLevel, so they are already cached when the map is viewed. The region is given as the
+// west, south, east and north edges in degrees, or NULL for the extent of the data.
+int runCacheWarming(const char* fileName, unsigned int minLevel, unsigned int maxLevel, const double* region);
+
+// Fill a disk cache in a directory to three times its maximum size with generated tiles, reading
+// a few of them back after each write, and check that the packs never take more than the maximum
+// size on disk, the tiles being read are never evicted, every tile read has the data it was
+// written with, and the cache holds the same tiles when opened again. The cache in the directory
+// is cleared first. MapLink isn't needed.
+int runCacheTest(const char* directory);
+
+#endif
@@ -0,0 +1,381 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "tilediskcache.h"
+
+#include <stdint.h>
+
+#include <QMutexLocker>
+
+// Number of packs the cache is split into. Eviction frees about this fraction of the cache.
+static const unsigned long long packsPerCache = 32;
+static const unsigned long long minPackBytes = 4096;
+
+// Time in seconds after a failed write before another pack is started
+static const double writeRetrySeconds = 10.0;
+
+// Marks the start of each tile in a pack
+static const uint32_t recordMagic = 0x454c4954; // "TILE"
+
+struct RecordHeader
+{
+  uint32_t m_magic;
+  uint32_t m_keySize;
+  uint32_t m_dataSize;
+};
+
+TileDiskCache::TileDiskCache(const std::string& directory, unsigned long long maxBytes)
+  : m_directory( directory )
+  , m_maxBytes( maxBytes )
+  , m_packBytes( maxBytes / packsPerCache < minPackBytes ? minPackBytes : maxBytes / packsPerCache )
+  , m_diskBytes( 0 )
+  , m_writeFile( NULL )
+  , m_writeFailedTick( 0 )
+  , m_writeFailed( false )
+  , m_readFile( NULL )
+  , m_readPack( 0 )
+{
+  resetStatistics();
+  open();
+}
+
+TileDiskCache::~TileDiskCache()
+{
+  if( m_writeFile )
+  {
+    fclose( m_writeFile );
+  }
+  if( m_readFile )
+  {
+    fclose( m_readFile );
+  }
+}
+
+bool TileDiskCache::read(const std::string& key, std::string& data)
+{
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+  QMutexLocker lock( &m_mutex );
+
+  std::unordered_map<std::string, Entry>::iterator it( m_index.find(key) );
+  if( it == m_index.end() )
+  {
+    ++m_statistics.m_misses;
+    return false;
+  }
+  Entry entry = it->second;
+
+  // Read the tile without holding up the other threads. The packs are only ever appended to, so
+  // the tile can't change while it is read, though its pack may be evicted.
+  lock.unlock();
+  bool valid = readEntry( entry, data );
+  lock.relock();
+
+  // The tile may have been written again or evicted while it was read
+  it = m_index.find(key);
+  bool current = it != m_index.end() && it->second.m_pack == entry.m_pack && it->second.m_offset == entry.m_offset;
+  if( !valid )
+  {
+    // The pack has been damaged or removed outside the cache
+    if( current )
+    {
+      m_index.erase( it );
+    }
+    ++m_statistics.m_misses;
+    return false;
+  }
+  ++m_statistics.m_hits;
+
+  // Keep the tiles in use out of the packs next in line for eviction
+  size_t packPosition = entry.m_pack - m_packs.front().m_number;
+  if( current && packPosition < m_packs.size() / 2 )
+  {
+    append( key, data.data(), entry.m_size );
+    ++m_statistics.m_rewrites;
+    while( m_diskBytes > m_maxBytes && m_packs.size() > 1 )
+    {
+      evictOldest();
+    }
+  }
+
+  m_statistics.m_readTime += osg::Timer::instance()->delta_m( startTick, osg::Timer::instance()->tick() );
+  return true;
+}
+
+bool TileDiskCache::readEntry(const Entry& entry, std::string& data)
+{
+  QMutexLocker lock( &m_readMutex );
+  if( !m_readFile || m_readPack != entry.m_pack )
+  {
+    if( m_readFile )
+    {
+      fclose( m_readFile );
+    }
+    m_readFile = fopen( packPath(entry.m_pack).c_str(), "rb" );
+    m_readPack = entry.m_pack;
+  }
+
+  data.resize( entry.m_size );
+  return m_readFile && fseek( m_readFile, (long)entry.m_offset, SEEK_SET ) == 0 &&
+         (entry.m_size == 0 || fread( &data[0], 1, entry.m_size, m_readFile ) == entry.m_size);
+}
+
+void TileDiskCache::write(const std::string& key, const std::string& data)
+{
+  QMutexLocker lock( &m_mutex );
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+  append( key, data.data(), (unsigned int)data.size() );
+  ++m_statistics.m_writes;
+  while( m_diskBytes > m_maxBytes && m_packs.size() > 1 )
+  {
+    evictOldest();
+  }
+
+  m_statistics.m_writeTime += osg::Timer::instance()->delta_m( startTick, osg::Timer::instance()->tick() );
+}
+
+bool TileDiskCache::contains(const std::string& key) const
+{
+  QMutexLocker lock( &m_mutex );
+  return m_index.find(key) != m_index.end();
+}
+
+void TileDiskCache::clear()
+{
+  QMutexLocker lock( &m_mutex );
+  if( m_writeFile )
+  {
+    fclose( m_writeFile );
+    m_writeFile = NULL;
+  }
+  {
+    QMutexLocker readLock( &m_readMutex );
+    if( m_readFile )
+    {
+      fclose( m_readFile );
+      m_readFile = NULL;
+    }
+  }
+
+  unsigned int next = m_packs.back().m_number + 1;
+  for( std::vector<Pack>::const_iterator pack = m_packs.begin(); pack != m_packs.end(); ++pack )
+  {
+    remove( packPath(pack->m_number).c_str() );
+  }
+  m_packs.clear();
+  m_index.clear();
+  m_diskBytes = 0;
+
+  startPack( next );
+}
+
+TileDiskCache::Statistics TileDiskCache::statistics() const
+{
+  QMutexLocker lock( &m_mutex );
+  Statistics statistics = m_statistics;
+  statistics.m_diskBytes = m_diskBytes;
+  statistics.m_tiles = m_index.size();
+  return statistics;
+}
+
+void TileDiskCache::resetStatistics()
+{
+  QMutexLocker lock( &m_mutex );
+  m_statistics.m_hits = 0;
+  m_statistics.m_misses = 0;
+  m_statistics.m_writes = 0;
+  m_statistics.m_rewrites = 0;
+  m_statistics.m_evictedPacks = 0;
+  m_statistics.m_readTime = 0.0;
+  m_statistics.m_writeTime = 0.0;
+  m_statistics.m_diskBytes = 0;
+  m_statistics.m_tiles = 0;
+}
+
+std::string TileDiskCache::packPath(unsigned int number) const
+{
+  char name[32];
+  snprintf( name, sizeof(name), "/tiles%08u.pack", number );
+  return m_directory + name;
+}
+
+void TileDiskCache::open()
+{
+  unsigned int first = 0;
+  unsigned int next = 0;
+  FILE* info = fopen( (m_directory + "/cache.info").c_str(), "r" );
+  if( info )
+  {
+    if( fscanf( info, "%u %u", &first, &next ) != 2 || next < first )
+    {
+      first = next = 0;
+    }
+    fclose( info );
+  }
+
+  // Index the tiles of each pack, oldest first, so a tile written again replaces its older copy
+  for( unsigned int number = first; number < next; ++number )
+  {
+    FILE* file = fopen( packPath(number).c_str(), "rb" );
+    if( !file )
+    {
+      continue;
+    }
+
+    Pack pack;
+    pack.m_number = number;
+    pack.m_bytes = 0;
+
+    RecordHeader header;
+    std::string key;
+    while( fread( &header, sizeof(header), 1, file ) == 1 && header.m_magic == recordMagic )
+    {
+      key.resize( header.m_keySize );
+      if( header.m_keySize > 0 && fread( &key[0], 1, header.m_keySize, file ) != header.m_keySize )
+      {
+        break;
+      }
+      Entry entry;
+      entry.m_pack = number;
+      entry.m_offset = pack.m_bytes + sizeof(header) + header.m_keySize;
+      entry.m_size = header.m_dataSize;
+      if( fseek( file, (long)header.m_dataSize, SEEK_CUR ) != 0 )
+      {
+        break;
+      }
+      pack.m_bytes = entry.m_offset + header.m_dataSize;
+      m_index[key] = entry;
+      pack.m_keys.push_back( key );
+    }
+
+    // Count the whole file, including anything after a damaged tile
+    fseek( file, 0, SEEK_END );
+    long fileBytes = ftell( file );
+    fclose( file );
+    if( fileBytes > 0 && (unsigned long long)fileBytes > pack.m_bytes )
+    {
+      pack.m_bytes = fileBytes;
+    }
+
+    m_diskBytes += pack.m_bytes;
+    m_packs.push_back( pack );
+  }
+
+  // Start a new pack for this session
+  startPack( next );
+
+  // The maximum size may have been lowered since the cache was last used
+  while( m_diskBytes > m_maxBytes && m_packs.size() > 1 )
+  {
+    evictOldest();
+  }
+}
+
+void TileDiskCache::startPack(unsigned int number)
+{
+  if( m_writeFile )
+  {
+    fclose( m_writeFile );
+  }
+  Pack pack;
+  pack.m_number = number;
+  pack.m_bytes = 0;
+  m_packs.push_back( pack );
+  m_writeFile = fopen( packPath(number).c_str(), "wb" );
+  m_writeFailed = !m_writeFile;
+  m_writeFailedTick = osg::Timer::instance()->tick();
+  writeInfo();
+}
+
+void TileDiskCache::writeInfo() const
+{
+  FILE* info = fopen( (m_directory + "/cache.info").c_str(), "w" );
+  if( info )
+  {
+    fprintf( info, "%u %u\n", m_packs.front().m_number, m_packs.back().m_number + 1 );
+    fclose( info );
+  }
+}
+
+void TileDiskCache::append(const std::string& key, const char* data, unsigned int size)
+{
+  if( m_packs.back().m_bytes >= m_packBytes )
+  {
+    // The newest pack is full: start another
+    startPack( m_packs.back().m_number + 1 );
+  }
+  else if( !m_writeFile && m_writeFailed &&
+           osg::Timer::instance()->delta_s( m_writeFailedTick, osg::Timer::instance()->tick() ) >= writeRetrySeconds )
+  {
+    // Writing to the newest pack failed a while ago: try a new one, as space may have been freed
+    startPack( m_packs.back().m_number + 1 );
+  }
+  if( !m_writeFile )
+  {
+    return;
+  }
+
+  Pack& pack = m_packs.back();
+  RecordHeader header;
+  header.m_magic = recordMagic;
+  header.m_keySize = (uint32_t)key.size();
+  header.m_dataSize = size;
+  bool written = fwrite( &header, sizeof(header), 1, m_writeFile ) == 1 &&
+                 fwrite( key.data(), 1, key.size(), m_writeFile ) == key.size() &&
+                 (size == 0 || fwrite( data, 1, size, m_writeFile ) == size) &&
+                 fflush( m_writeFile ) == 0;
+
+  // A failed record may have been partly written, so it is counted either way
+  unsigned long long recordBytes = sizeof(header) + key.size() + size;
+  unsigned long long offset = pack.m_bytes + sizeof(header) + key.size();
+  pack.m_bytes += recordBytes;
+  m_diskBytes += recordBytes;
+  if( !written )
+  {
+    // Out of disk space or similar: leave the pack, which ends in a damaged record, and start
+    // a new one once writeRetrySeconds have passed
+    fclose( m_writeFile );
+    m_writeFile = NULL;
+    m_writeFailed = true;
+    m_writeFailedTick = osg::Timer::instance()->tick();
+    return;
+  }
+
+  Entry entry;
+  entry.m_pack = pack.m_number;
+  entry.m_offset = offset;
+  entry.m_size = size;
+  m_index[key] = entry;
+  pack.m_keys.push_back( key );
+}
+
+void TileDiskCache::evictOldest()
+{
+  Pack& pack = m_packs.front();
+
+  // Drop the tiles whose newest copy is in the pack
+  for( std::vector<std::string>::const_iterator key = pack.m_keys.begin(); key != pack.m_keys.end(); ++key )
+  {
+    std::unordered_map<std::string, Entry>::iterator it( m_index.find(*key) );
+    if( it != m_index.end() && it->second.m_pack == pack.m_number )
+    {
+      m_index.erase( it );
+    }
+  }
+
+  {
+    QMutexLocker readLock( &m_readMutex );
+    if( m_readFile && m_readPack == pack.m_number )
+    {
+      fclose( m_readFile );
+      m_readFile = NULL;
+    }
+  }
+  remove( packPath(pack.m_number).c_str() );
+
+  m_diskBytes -= pack.m_bytes;
+  ++m_statistics.m_evictedPacks;
+  m_packs.erase( m_packs.begin() );
+  writeInfo();
+}
@@ -0,0 +1,140 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef TILEDISKCACHE_H
+#define TILEDISKCACHE_H
+
+#include <stdio.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <QMutex>
+
+#include <osg/Timer>
+
+// A size limited disk cache of encoded tiles.
+//
+// Tiles are appended to pack files, many tiles to a file, each stored as a small header, its
+// key and its data. When the cache grows past its maximum size the oldest pack is deleted, with
+// every tile in it. Tiles read from the older half of the packs are written again to the newest
+// pack, so the tiles still in use survive and the packs are evicted in least recently used order.
+// The disk usage, including the space left behind by rewritten tiles, never exceeds the maximum
+// size once a write has finished.
+//
+// The packs are numbered in the order they were started. The index of the tiles is held in
+// memory, and rebuilt from the packs when the cache is opened; a new pack is started for each
+// session, so a pack cut short by a crash is never appended to. A pack that fails to be written
+// to is likewise left, and a new pack started for the next write.
+//
+// The index is guarded by one lock, held only to look up and record tiles. The tiles are read
+// from the packs outside it, so reads don't hold up the lookups and writes of other threads.
+class TileDiskCache
+{
+public:
+  // Counts and timings since the last call to resetStatistics()
+  struct Statistics
+  {
+    size_t m_hits;
+    size_t m_misses;
+    size_t m_writes;
+    // Tiles written again to the newest pack when read
+    size_t m_rewrites;
+    size_t m_evictedPacks;
+    // Total time spent reading and writing, in milliseconds
+    double m_readTime;
+    double m_writeTime;
+    // Size of the packs on disk, in bytes
+    unsigned long long m_diskBytes;
+    size_t m_tiles;
+  };
+
+  // The directory must exist. The size of a pack is a fraction of the maximum size.
+  TileDiskCache(const std::string& directory, unsigned long long maxBytes);
+  ~TileDiskCache();
+
+  // Read the data of a tile. Returns false if the tile isn't cached.
+  bool read(const std::string& key, std::string& data);
+
+  // Write the data of a tile, replacing any cached data of the key. Evicts the oldest packs
+  // while the cache is larger than its maximum size.
+  void write(const std::string& key, const std::string& data);
+
+  // Check if a tile is cached, without counting a hit or miss
+  bool contains(const std::string& key) const;
+
+  // Remove every tile, deleting the packs
+  void clear();
+
+  Statistics statistics() const;
+  void resetStatistics();
+
+private:
+  // Location of a tile in the packs
+  struct Entry
+  {
+    unsigned int m_pack;
+    // Offset of the data of the tile in the pack
+    unsigned long long m_offset;
+    unsigned int m_size;
+  };
+
+  // A pack file, and the keys of the tiles written to it
+  struct Pack
+  {
+    unsigned int m_number;
+    unsigned long long m_bytes;
+    std::vector<std::string> m_keys;
+  };
+
+  std::string packPath(unsigned int number) const;
+
+  // Read the tiles of the packs listed in the cache information, and start a new pack
+  void open();
+
+  // Start a new pack and make it the one written to. The lock must be held, except when opening.
+  void startPack(unsigned int number);
+
+  // Record the numbers of the packs, so they can be found when the cache is opened again
+  void writeInfo() const;
+
+  // Append a tile to the newest pack. The lock must be held.
+  void append(const std::string& key, const char* data, unsigned int size);
+
+  // Read the data of a tile from its pack. Only the read lock is taken.
+  bool readEntry(const Entry& entry, std::string& data);
+
+  // Delete the oldest pack. The lock must be held.
+  void evictOldest();
+
+  std::string m_directory;
+  unsigned long long m_maxBytes;
+  unsigned long long m_packBytes;
+
+  // Guards the members below
+  mutable QMutex m_mutex;
+
+  std::unordered_map<std::string, Entry> m_index;
+
+  // Packs, oldest first. The last is the one written to.
+  std::vector<Pack> m_packs;
+  unsigned long long m_diskBytes;
+
+  // Handle of the newest pack, open for appending, or NULL if writing to it failed
+  FILE* m_writeFile;
+  // Time of the last failed write. A new pack isn't started for a while after a failure, as the
+  // disk is likely full.
+  osg::Timer_t m_writeFailedTick;
+  bool m_writeFailed;
+
+  Statistics m_statistics;
+
+  // Guards the handle of the pack last read from. Taken after m_mutex when both are held.
+  mutable QMutex m_readMutex;
+  FILE* m_readFile;
+  unsigned int m_readPack;
+};
+
+#endif
@@ -0,0 +1,318 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "tileprefetcher.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include <QMutexLocker>
+
+#include <osg/View>
+#include <osgEarth/GeoData>
+
+#include "osgearthsampleconfig.h"
+#include "trackmotion.h"
+
+// Weight of the latest frame in the smoothed camera velocity
+static const double velocitySmoothing = 0.3;
+
+// Slowest camera movement prefetched for, as a fraction of the altitude per second.
+// Slower movement stays within the tiles already loaded around the view.
+static const double minRelativeSpeed = 0.05;
+
+// Number of positions the camera path is sampled at over the prefetch time
+static const int numPredictions = 3;
+
+// Metres per degree of latitude
+static const double metresPerDegree = 111320.0;
+
+// Finest level prefetched
+static const unsigned int maxPrefetchLevel = 20;
+
+TilePrefetcher::TilePrefetcher(osgEarth::MapNode* mapNode)
+  : osg::Operation( "tileprefetcher", true ) // Set this operations name, and set it to repeat
+  , m_mapNode( mapNode )
+  , m_tracking( false )
+  , m_lastTime( 0.0 )
+  , m_lastPlanTime( 0.0 )
+  , m_pass( 0 )
+  , m_enabled( true )
+  , m_stop( false )
+{
+  resetStatistics();
+  for( int i = 0; i < IMAGERY_PREFETCHTHREADS; ++i )
+  {
+    m_workers.push_back( new Worker( this ) );
+    m_workers.back()->start( QThread::LowPriority );
+  }
+}
+
+TilePrefetcher::~TilePrefetcher()
+{
+  stop();
+}
+
+void TilePrefetcher::addPool(ImageryTilePool* pool)
+{
+  QMutexLocker lock( &m_mutex );
+  m_pools.push_back( pool );
+}
+
+void TilePrefetcher::enabled(bool enabled)
+{
+  {
+    QMutexLocker lock( &m_mutex );
+    m_enabled = enabled;
+  }
+  if( !enabled )
+  {
+    cancel();
+  }
+}
+
+bool TilePrefetcher::enabled() const
+{
+  QMutexLocker lock( &m_mutex );
+  return m_enabled;
+}
+
+void TilePrefetcher::cancel()
+{
+  QMutexLocker lock( &m_mutex );
+  m_statistics.m_cancelled += m_queue.size();
+  for( std::vector<Request>::const_iterator request = m_queue.begin(); request != m_queue.end(); ++request )
+  {
+    m_queuedKeys.erase( std::make_pair( request->m_pool.get(), request->m_key.str() ) );
+  }
+  m_queue.clear();
+}
+
+TilePrefetcher::Statistics TilePrefetcher::statistics() const
+{
+  QMutexLocker lock( &m_mutex );
+  Statistics statistics = m_statistics;
+  statistics.m_pending = m_queue.size();
+  return statistics;
+}
+
+void TilePrefetcher::resetStatistics()
+{
+  QMutexLocker lock( &m_mutex );
+  m_statistics.m_queued = 0;
+  m_statistics.m_prefetched = 0;
+  m_statistics.m_cancelled = 0;
+  m_statistics.m_pending = 0;
+}
+
+void TilePrefetcher::stop()
+{
+  {
+    QMutexLocker lock( &m_mutex );
+    m_stop = true;
+    m_queue.clear();
+    m_queuedKeys.clear();
+    m_requested.wakeAll();
+  }
+  for( size_t i = 0; i < m_workers.size(); ++i )
+  {
+    m_workers[i]->wait();
+    delete m_workers[i];
+  }
+  m_workers.clear();
+}
+
+void TilePrefetcher::operator()(osg::Object* obj)
+{
+  osg::View* view = dynamic_cast<osg::View*>(obj);
+  if( !view || !view->getCamera() || !view->getFrameStamp() )
+  {
+    return;
+  }
+  osg::Camera* camera = view->getCamera();
+  double time = view->getFrameStamp()->getReferenceTime();
+  osg::Vec3d eye = osg::Vec3d(0.0, 0.0, 0.0) * camera->getInverseViewMatrix();
+
+  if( !m_tracking || time <= m_lastTime )
+  {
+    m_tracking = true;
+    m_lastEye = eye;
+    m_lastTime = time;
+    m_velocity.set( 0.0, 0.0, 0.0 );
+    return;
+  }
+
+  m_velocity = m_velocity * (1.0 - velocitySmoothing) + (eye - m_lastEye) * (velocitySmoothing / (time - m_lastTime));
+  m_lastEye = eye;
+  m_lastTime = time;
+
+  if( time - m_lastPlanTime < IMAGERY_PREFETCHINTERVAL || !enabled() )
+  {
+    return;
+  }
+  m_lastPlanTime = time;
+
+  double speed = m_velocity.length();
+  double altitude = eye.length() - TrackMotion::earthRadius;
+  if( speed < minRelativeSpeed * (altitude > 1.0 ? altitude : 1.0) )
+  {
+    // Hovering, or turning on the spot: the tiles ahead are no longer needed
+    if( m_plannedDirection.length2() > 0.0 )
+    {
+      cancel();
+      m_plannedDirection.set( 0.0, 0.0, 0.0 );
+    }
+    return;
+  }
+
+  osg::Vec3d direction = m_velocity / speed;
+  if( m_plannedDirection.length2() > 0.0 &&
+      direction * m_plannedDirection < cos( osg::DegreesToRadians( IMAGERY_PREFETCHTURN ) ) )
+  {
+    cancel();
+  }
+  m_plannedDirection = direction;
+
+  // The tiles of this prediction are drawn before those of earlier ones, which the camera may have passed
+  ++m_pass;
+  for( int i = 1; i <= numPredictions; ++i )
+  {
+    plan( eye + m_velocity * (IMAGERY_PREFETCHSECONDS * i / numPredictions), eye, m_pass );
+  }
+}
+
+void TilePrefetcher::work()
+{
+  QMutexLocker lock( &m_mutex );
+  while( !m_stop )
+  {
+    if( m_queue.empty() )
+    {
+      m_requested.wait( &m_mutex );
+      continue;
+    }
+
+    Request request = m_queue.back();
+    m_queue.pop_back();
+
+    // Draw the tile without holding the lock, so more tiles can be queued
+    lock.unlock();
+    bool drawn = request.m_pool->prefetch( request.m_key );
+    lock.relock();
+
+    m_queuedKeys.erase( std::make_pair( request.m_pool.get(), request.m_key.str() ) );
+    m_statistics.m_prefetched += drawn ? 1 : 0;
+  }
+}
+
+void TilePrefetcher::plan(const osg::Vec3d& eye, const osg::Vec3d& currentEye, unsigned int pass)
+{
+  osgEarth::GeoPoint point;
+  if( !point.fromWorld( m_mapNode->getMapSRS(), eye ) )
+  {
+    return;
+  }
+  point = point.transform( m_mapNode->getMapSRS()->getGeographicSRS() );
+  double altitude = point.z() > 1.0 ? point.z() : 1.0;
+
+  // The terrain under a camera looking down covers about the altitude in each direction
+  double latitude = point.y();
+  double longitude = point.x();
+  double halfHeight = altitude / metresPerDegree;
+  double cosLatitude = cos( osg::DegreesToRadians( latitude ) );
+  double halfWidth = cosLatitude > 0.01 ? halfHeight / cosLatitude : 180.0;
+  double south = osg::maximum( latitude - halfHeight, -90.0 );
+  double north = osg::minimum( latitude + halfHeight, 90.0 );
+  double west = longitude - halfWidth;
+  double east = longitude + halfWidth;
+
+  // Longitude wraps around, so an area across the dateline is split into the parts either side of it
+  const osgEarth::SpatialReference* geoSRS = m_mapNode->getMapSRS()->getGeographicSRS();
+  std::vector<osgEarth::GeoExtent> extents;
+  if( east - west >= 360.0 )
+  {
+    extents.push_back( osgEarth::GeoExtent( geoSRS, -180.0, south, 180.0, north ) );
+  }
+  else if( west < -180.0 )
+  {
+    extents.push_back( osgEarth::GeoExtent( geoSRS, west + 360.0, south, 180.0, north ) );
+    extents.push_back( osgEarth::GeoExtent( geoSRS, -180.0, south, east, north ) );
+  }
+  else if( east > 180.0 )
+  {
+    extents.push_back( osgEarth::GeoExtent( geoSRS, west, south, 180.0, north ) );
+    extents.push_back( osgEarth::GeoExtent( geoSRS, -180.0, south, east - 360.0, north ) );
+  }
+  else
+  {
+    extents.push_back( osgEarth::GeoExtent( geoSRS, west, south, east, north ) );
+  }
+
+  QMutexLocker lock( &m_mutex );
+  for( size_t i = 0; i < m_pools.size(); ++i )
+  {
+    ImageryTilePool* pool = m_pools[i].get();
+    unsigned int level = levelForAltitude( pool->getProfile(), altitude );
+
+    std::vector<osgEarth::TileKey> keys;
+    for( size_t part = 0; part < extents.size(); ++part )
+    {
+      pool->tilesCovering( extents[part], level > 0 ? level - 1 : 0, level, keys );
+    }
+    for( std::vector<osgEarth::TileKey>::const_iterator key = keys.begin(); key != keys.end(); ++key )
+    {
+      if( pool->isCached( *key ) ||
+          !m_queuedKeys.insert( std::make_pair( (const ImageryTilePool*)pool, key->str() ) ).second )
+      {
+        continue;
+      }
+      // Distance from the camera to the centre of the tile on the ground
+      double x, y;
+      key->getExtent().getCentroid( x, y );
+      osg::Vec3d centre;
+      osgEarth::GeoPoint( key->getProfile()->getSRS(), x, y, 0.0, osgEarth::ALTMODE_ABSOLUTE ).toWorld( centre );
+
+      Request request;
+      request.m_pool = pool;
+      request.m_key = *key;
+      request.m_pass = pass;
+      request.m_distance2 = (centre - currentEye).length2();
+      m_queue.push_back( request );
+      ++m_statistics.m_queued;
+    }
+  }
+
+  // The requests of earlier predictions are for positions the camera may have passed, so they are
+  // dropped first, then the farthest of this prediction
+  std::stable_sort( m_queue.begin(), m_queue.end() );
+  size_t numDropped = m_queue.size() > IMAGERY_PREFETCHQUEUE ? m_queue.size() - IMAGERY_PREFETCHQUEUE : 0;
+  for( size_t i = 0; i < numDropped; ++i )
+  {
+    m_queuedKeys.erase( std::make_pair( m_queue[i].m_pool.get(), m_queue[i].m_key.str() ) );
+  }
+  m_queue.erase( m_queue.begin(), m_queue.begin() + numDropped );
+  m_statistics.m_cancelled += numDropped;
+  m_requested.wakeAll();
+}
+
+unsigned int TilePrefetcher::levelForAltitude(const osgEarth::Profile* profile, double altitude)
+{
+  // The terrain shows a tile once the camera is within TERRAIN_MINTILERANGEFACTOR times its radius,
+  // so from the altitude, the finest level shown is the finest one whose tiles are that large
+  bool geographic = profile->getSRS()->isGeographic();
+  unsigned int level = 0;
+  while( level < maxPrefetchLevel )
+  {
+    double tileWidth, tileHeight;
+    profile->getTileDimensions( level + 1, tileWidth, tileHeight );
+    double tileRadius = 0.5 * sqrt( tileWidth * tileWidth + tileHeight * tileHeight ) * (geographic ? metresPerDegree : 1.0);
+    if( tileRadius * TERRAIN_MINTILERANGEFACTOR < altitude )
+    {
+      break;
+    }
+    ++level;
+  }
+  return level;
+}
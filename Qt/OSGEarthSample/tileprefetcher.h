@@ -0,0 +1,145 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef TILEPREFETCHER_H
+#define TILEPREFETCHER_H
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <osg/OperationThread>
+#include <osgEarth/MapNode>
+#include <osgEarth/TileKey>
+
+#include "imagerytilepool.h"
+
+// Draws the MapLink imagery tiles the camera is heading towards into the disk cache.
+//
+// Each frame the movement of the camera is measured, and a few times a second its position is
+// extrapolated a few seconds ahead. The tiles the terrain would show from the predicted positions,
+// at the level chosen for the predicted altitude and the one above, are queued and drawn by
+// background threads. The pools only give background draws the renderers the pager isn't waiting
+// for, so prefetching doesn't delay the tiles in view. When the camera turns sharply or stops,
+// the queue is cancelled, as the tiles in it are no longer on the way.
+//
+// The tiles of the latest prediction are drawn first, nearest to the camera first. When the queue
+// is full, the tiles of earlier predictions are dropped first, then the farthest of the latest.
+class TilePrefetcher : public osg::Operation
+{
+public:
+  // Counts since the last call to resetStatistics()
+  struct Statistics
+  {
+    size_t m_queued;
+    // Tiles drawn, not including those already cached when they were reached
+    size_t m_prefetched;
+    // Tiles dropped from the queue by a change of direction or a full queue
+    size_t m_cancelled;
+    // Tiles in the queue
+    size_t m_pending;
+  };
+
+  explicit TilePrefetcher(osgEarth::MapNode* mapNode);
+  ~TilePrefetcher();
+
+  // Prefetch the tiles of an imagery layer. The pool must have a disk cache.
+  void addPool(ImageryTilePool* pool);
+
+  // Enable or disable prefetching. Disabling it cancels the queue.
+  void enabled(bool enabled);
+  bool enabled() const;
+
+  // Drop the tiles waiting to be drawn. Tiles being drawn are finished.
+  void cancel();
+
+  Statistics statistics() const;
+  void resetStatistics();
+
+  // Stop the threads, dropping any tiles not yet drawn
+  void stop();
+
+  // osg::Operation, run as an update operation of the viewer
+  virtual void operator()(osg::Object* obj);
+
+private:
+  class Worker : public QThread
+  {
+  public:
+    explicit Worker(TilePrefetcher* prefetcher)
+      : m_prefetcher( prefetcher )
+    {
+    }
+
+  protected:
+    virtual void run()
+    {
+      m_prefetcher->work();
+    }
+
+  private:
+    TilePrefetcher* m_prefetcher;
+  };
+
+  // A tile to draw, and the pool to draw it with
+  struct Request
+  {
+    osg::ref_ptr<ImageryTilePool> m_pool;
+    osgEarth::TileKey m_key;
+    // Prediction the tile was queued by, numbered in order
+    unsigned int m_pass;
+    // Square of the distance from the camera to the centre of the tile when it was queued
+    double m_distance2;
+
+    // Order requests from the least urgent to the most
+    bool operator<(const Request& other) const
+    {
+      return m_pass != other.m_pass ? m_pass < other.m_pass : m_distance2 > other.m_distance2;
+    }
+  };
+
+  // Draw the queued tiles until stopped. Run by the worker threads.
+  void work();
+
+  // Queue the tiles seen from a predicted camera position, in world coordinates, as part of a
+  // prediction. The tiles are ordered by their distance from the current camera position.
+  void plan(const osg::Vec3d& eye, const osg::Vec3d& currentEye, unsigned int pass);
+
+  // Finest level of a profile the terrain shows from the given altitude
+  static unsigned int levelForAltitude(const osgEarth::Profile* profile, double altitude);
+
+  osgEarth::MapNode* m_mapNode;
+
+  // Camera movement, used by the update operation only
+  bool m_tracking;
+  osg::Vec3d m_lastEye;
+  double m_lastTime;
+  double m_lastPlanTime;
+  osg::Vec3d m_velocity;
+  osg::Vec3d m_plannedDirection;
+  unsigned int m_pass;
+
+  // Guards the members below
+  mutable QMutex m_mutex;
+  // Signalled when tiles are queued or the threads are stopped
+  QWaitCondition m_requested;
+
+  std::vector< osg::ref_ptr<ImageryTilePool> > m_pools;
+  // Tiles to draw, sorted from the least urgent to the most. The workers take them from the back.
+  std::vector<Request> m_queue;
+  // Pool and key of the tiles queued or being drawn, so a tile is only queued once
+  std::set< std::pair<const ImageryTilePool*, std::string> > m_queuedKeys;
+  std::vector<Worker*> m_workers;
+  bool m_enabled;
+  bool m_stop;
+
+  Statistics m_statistics;
+};
+
+#endif
@@ -0,0 +1,114 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "trackbuilder.h"
+
+#include <ctime>
+
+#include <QMutexLocker>
+
+TrackBuilder::TrackBuilder(osgEarth::MapNode* mapNode, osg::Group* parent, osgEarth::Annotation::TrackNodeFieldSchema& schema)
+  : m_mapNode( mapNode )
+  , m_parent( parent )
+  , m_schema( schema )
+  , m_random( (unsigned int)time( NULL ) )
+  , m_nextIndex( 0 )
+  , m_remaining( 0 )
+  , m_generation( 0 )
+  , m_stop( false )
+{
+}
+
+TrackBuilder::~TrackBuilder()
+{
+  stop();
+}
+
+void TrackBuilder::build(int firstIndex, int numTracks)
+{
+  if( numTracks <= 0 )
+  {
+    return;
+  }
+
+  QMutexLocker lock( &m_mutex );
+  if( m_remaining == 0 )
+  {
+    m_nextIndex = firstIndex;
+  }
+  m_remaining += numTracks;
+  m_requested.wakeOne();
+
+  if( !isRunning() && !m_stop )
+  {
+    start( QThread::LowPriority );
+  }
+}
+
+void TrackBuilder::cancel()
+{
+  QMutexLocker lock( &m_mutex );
+  m_remaining = 0;
+  m_built.clear();
+  ++m_generation;
+}
+
+size_t TrackBuilder::takeBuilt(size_t maxTracks, MaplinkTracks& tracks)
+{
+  QMutexLocker lock( &m_mutex );
+  size_t numTaken = 0;
+  while( numTaken < maxTracks && !m_built.empty() )
+  {
+    tracks.push_back( m_built.front() );
+    m_built.pop_front();
+    ++numTaken;
+  }
+  return numTaken;
+}
+
+size_t TrackBuilder::pending() const
+{
+  QMutexLocker lock( &m_mutex );
+  return m_remaining + m_built.size();
+}
+
+void TrackBuilder::stop()
+{
+  {
+    QMutexLocker lock( &m_mutex );
+    m_stop = true;
+    m_remaining = 0;
+    m_built.clear();
+    ++m_generation;
+    m_requested.wakeAll();
+  }
+  wait();
+}
+
+void TrackBuilder::run()
+{
+  QMutexLocker lock( &m_mutex );
+  while( !m_stop )
+  {
+    if( m_remaining == 0 )
+    {
+      m_requested.wait( &m_mutex );
+      continue;
+    }
+
+    int trackIndex = m_nextIndex++;
+    --m_remaining;
+    unsigned int generation = m_generation;
+
+    // Build the track without holding the lock, so the track manager can take the tracks already built
+    lock.unlock();
+    osg::ref_ptr<MaplinkTrackObject> track = new MaplinkTrackObject( m_mapNode, m_parent.get(), trackIndex, m_random(), m_schema, m_maplinkSymbols );
+    lock.relock();
+
+    if( generation == m_generation )
+    {
+      m_built.push_back( track );
+    }
+  }
+}
@@ -0,0 +1,79 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef TRACKBUILDER_H
+#define TRACKBUILDER_H
+
+#include <deque>
+#include <random>
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <osgEarthMapLink/MilitarySymbols.h>
+#include "maplinktrackobject.h"
+
+// Builds tracks in a background thread.
+//
+// Drawing the MapLink symbol of a track and creating its track node are the expensive parts of
+// adding a track, and neither needs the scene graph, so they are done here. The built tracks
+// aren't attached to the scene: the track manager takes them in small batches each frame and
+// attaches them from its update operation, so adding a large number of tracks doesn't stall
+// rendering or interaction.
+class TrackBuilder : public QThread
+{
+public:
+  TrackBuilder(osgEarth::MapNode* mapNode, osg::Group* parent, osgEarth::Annotation::TrackNodeFieldSchema& schema);
+  ~TrackBuilder();
+
+  // Build more tracks. The tracks are numbered from firstIndex onwards.
+  void build(int firstIndex, int numTracks);
+
+  // Drop the tracks not yet built, and the built tracks not yet taken
+  void cancel();
+
+  // Move up to maxTracks built tracks to the end of tracks, in the order they were requested.
+  // Returns the number of tracks moved.
+  size_t takeBuilt(size_t maxTracks, MaplinkTracks& tracks);
+
+  // Number of tracks requested and not yet taken
+  size_t pending() const;
+
+  // Stop the thread, dropping any tracks not yet built
+  void stop();
+
+protected:
+  virtual void run();
+
+private:
+  osgEarth::MapNode* m_mapNode;
+  osg::ref_ptr<osg::Group> m_parent;
+  osgEarth::Annotation::TrackNodeFieldSchema& m_schema;
+
+  // Used to convert MapLink APP6A symbols to an osg::Image
+  // Only used by the builder thread
+  envitia::MapLink::MilitarySymbols m_maplinkSymbols;
+
+  // Seeds the random number generator of each track built
+  // Only used by the builder thread
+  std::mt19937 m_random;
+
+  // Guards the members below
+  mutable QMutex m_mutex;
+  // Signalled when tracks are requested or the thread is stopped
+  QWaitCondition m_requested;
+
+  // Index of the next track to build
+  int m_nextIndex;
+  // Number of tracks left to build
+  int m_remaining;
+  // Tracks built and not yet taken
+  std::deque< osg::ref_ptr<MaplinkTrackObject> > m_built;
+  // Changed by cancel(), so a track being built when the requests were cancelled is dropped
+  unsigned int m_generation;
+  bool m_stop;
+};
+
+#endif
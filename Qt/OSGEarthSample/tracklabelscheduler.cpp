@@ -0,0 +1,250 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "tracklabelscheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <osg/Timer>
+
+const unsigned long long TrackLabelScheduler::noCell = ~0ULL;
+
+// GARS labels are given to the 5 minute cell, 12 cells to the degree
+static const double garsCellsPerDegree = 12.0;
+
+// MGRS labels are shown to the metre
+static const double mgrsPrecisionMetres = 1.0;
+
+// Latitude/longitude labels are shown to 6 significant digits, the default precision of a stream
+static const int latLonSignificantDigits = 6;
+
+// Metres per degree of latitude, used to size the MGRS cells
+static const double metresPerDegree = 111320.0;
+
+// Number of labels formatted between checks of the time budget
+static const size_t budgetCheckInterval = 16;
+
+// Key of the value a latitude or longitude is shown as: the number of decimal places,
+// the sign and the significant digits, in 25 bits
+static unsigned long long shownValueKey(double value)
+{
+  if( value == 0.0 )
+  {
+    return 0;
+  }
+  double magnitude = fabs(value);
+  int exponent = (int)floor(log10(magnitude));
+  exponent = exponent < -10 ? -10 : exponent;
+  int decimals = latLonSignificantDigits - 1 - exponent;
+  unsigned long long digits = (unsigned long long)floor(magnitude * pow(10.0, decimals) + 0.5);
+  return ((unsigned long long)decimals << 21) | ((value < 0.0 ? 1ULL : 0ULL) << 20) | digits;
+}
+
+TrackLabelScheduler::TrackLabelScheduler(double budgetMs, size_t cacheSize)
+  : m_format( MaplinkTrackObject::FORMAT_NONE )
+  , m_budgetMs( budgetMs )
+  , m_cacheSize( cacheSize )
+  , m_scheduling( true )
+{
+  resetStatistics();
+  m_statistics.m_queued = 0;
+}
+
+void TrackLabelScheduler::positionFormat(MaplinkTrackObject::PositionFormat format)
+{
+  if( format == m_format )
+  {
+    return;
+  }
+  m_format = format;
+  m_cache.clear();
+
+  // Every label is out of date: queue all the tracks
+  m_queue.clear();
+  for( size_t index = 0; index < m_trackCells.size(); ++index )
+  {
+    m_trackCells[index] = noCell;
+    m_trackQueued[index] = 1;
+    m_queue.push_back(index);
+  }
+}
+
+MaplinkTrackObject::PositionFormat TrackLabelScheduler::positionFormat() const
+{
+  return m_format;
+}
+
+void TrackLabelScheduler::scheduling(bool enabled)
+{
+  m_scheduling = enabled;
+}
+
+bool TrackLabelScheduler::scheduling() const
+{
+  return m_scheduling;
+}
+
+void TrackLabelScheduler::numTracks(size_t numTracks)
+{
+  // Tracks past the end are dropped from the queue when they are reached
+  m_trackCells.resize(numTracks, noCell);
+  m_trackQueued.resize(numTracks, 0);
+}
+
+void TrackLabelScheduler::trackMoved(MaplinkTracks& tracks, size_t index)
+{
+  if( m_trackQueued[index] )
+  {
+    // The label will be formatted at the position the track has when it is reached
+    return;
+  }
+
+  double lat, lon;
+  tracks[index]->placedPosition(lat, lon);
+  if( !m_scheduling )
+  {
+    // Formatted every time the track moves, as if there were no scheduler
+    tracks[index]->positionLabel(formatLabel(lat, lon));
+    m_trackCells[index] = noCell;
+    ++m_statistics.m_formatted;
+    return;
+  }
+  unsigned long long key = cellKey(lat, lon);
+  if( key == m_trackCells[index] || applyCachedLabel(tracks[index].get(), index, key) )
+  {
+    return;
+  }
+
+  m_trackQueued[index] = 1;
+  m_queue.push_back(index);
+}
+
+void TrackLabelScheduler::process(MaplinkTracks& tracks)
+{
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+  size_t processed = 0;
+  while( !m_queue.empty() )
+  {
+    if( m_scheduling && ++processed % budgetCheckInterval == 0 &&
+        osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick()) >= m_budgetMs )
+    {
+      break;
+    }
+
+    size_t index = m_queue.front();
+    m_queue.pop_front();
+    if( index >= tracks.size() || index >= m_trackQueued.size() || !m_trackQueued[index] )
+    {
+      // The track was removed while it was queued
+      continue;
+    }
+    m_trackQueued[index] = 0;
+
+    double lat, lon;
+    tracks[index]->placedPosition(lat, lon);
+    unsigned long long key = cellKey(lat, lon);
+    if( key == m_trackCells[index] || (m_scheduling && applyCachedLabel(tracks[index].get(), index, key)) )
+    {
+      continue;
+    }
+    if( !m_scheduling )
+    {
+      tracks[index]->positionLabel(formatLabel(lat, lon));
+      m_trackCells[index] = key;
+      ++m_statistics.m_formatted;
+      continue;
+    }
+
+    if( m_cache.size() >= m_cacheSize )
+    {
+      m_cache.clear();
+    }
+    std::string& label = m_cache[key];
+    label = formatLabel(lat, lon);
+    ++m_statistics.m_formatted;
+
+    tracks[index]->positionLabel(label);
+    m_trackCells[index] = key;
+  }
+  m_statistics.m_queued = m_queue.size();
+}
+
+const TrackLabelScheduler::Statistics& TrackLabelScheduler::statistics() const
+{
+  return m_statistics;
+}
+
+void TrackLabelScheduler::resetStatistics()
+{
+  m_statistics.m_formatted = 0;
+  m_statistics.m_cacheHits = 0;
+}
+
+unsigned long long TrackLabelScheduler::cellKey(double lat, double lon) const
+{
+  double cellsPerDegree;
+  switch( m_format )
+  {
+    case MaplinkTrackObject::FORMAT_GARS:
+      cellsPerDegree = garsCellsPerDegree;
+      break;
+    case MaplinkTrackObject::FORMAT_MGRS:
+      // Cells of half the displayed precision. A degree of longitude is never longer than
+      // a degree of latitude, so the cells are square or narrower in metres.
+      cellsPerDegree = 2.0 * metresPerDegree / mgrsPrecisionMetres;
+      break;
+    case MaplinkTrackObject::FORMAT_LATLON:
+      // The values shown, which have more decimal places the nearer they are to zero
+      return (shownValueKey(lat) << 25) | shownValueKey(lon);
+    case MaplinkTrackObject::FORMAT_NONE:
+    default:
+      // One empty label for every position
+      return 0;
+  }
+
+  unsigned long long columns = (unsigned long long)(360.0 * cellsPerDegree) + 2;
+  unsigned long long row = (unsigned long long)floor((lat + 90.0) * cellsPerDegree);
+  unsigned long long column = (unsigned long long)floor((lon + 180.0) * cellsPerDegree);
+  return row * columns + column;
+}
+
+std::string TrackLabelScheduler::formatLabel(double lat, double lon) const
+{
+  switch( m_format )
+  {
+    case MaplinkTrackObject::FORMAT_GARS:
+      {
+        const char* garsStr = TSLCoordinateConverter::latLongToGARS(lat, lon);
+        return garsStr ? std::string(garsStr) : std::string();
+      }
+    case MaplinkTrackObject::FORMAT_MGRS:
+      {
+        const char* mgrsStr = TSLCoordinateConverter::latLongToMGRS(lat, lon);
+        return mgrsStr ? std::string(mgrsStr) : std::string();
+      }
+    case MaplinkTrackObject::FORMAT_LATLON:
+      {
+        char latLonStr[64];
+        snprintf(latLonStr, sizeof(latLonStr), "%g : %g", lat, lon);
+        return std::string(latLonStr);
+      }
+    case MaplinkTrackObject::FORMAT_NONE:
+    default:
+      return std::string();
+  }
+}
+
+bool TrackLabelScheduler::applyCachedLabel(MaplinkTrackObject* track, size_t index, unsigned long long key)
+{
+  std::unordered_map<unsigned long long, std::string>::const_iterator it( m_cache.find(key) );
+  if( it == m_cache.end() )
+  {
+    return false;
+  }
+  track->positionLabel(it->second);
+  m_trackCells[index] = key;
+  ++m_statistics.m_cacheHits;
+  return true;
+}
@@ -0,0 +1,102 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef TRACKLABELSCHEDULER_H
+#define TRACKLABELSCHEDULER_H
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "maplinktrackobject.h"
+
+// Schedules the formatting of the track position labels.
+//
+// A label is only formatted when the track moves into a different cell of the displayed
+// precision: the 5 minute cells of GARS and the values shown of latitude/longitude.
+// MGRS squares aren't aligned with latitude/longitude, so MGRS labels use cells of half a
+// metre, and are never out by more than the metre they show. Formatted labels are cached
+// by cell, so a track entering a cell another track has already been through reuses its label.
+// The labels are shown to the same precision whether they are scheduled or not.
+//
+// Labels that aren't cached are queued, and the queue is worked through under a time budget
+// each frame, so formatting a large number of labels, such as when the format changes, is
+// spread over several frames instead of stalling one.
+class TrackLabelScheduler
+{
+public:
+  // Counts of the label work of the frames since the last call to resetStatistics()
+  struct Statistics
+  {
+    // Labels formatted through the coordinate converter
+    size_t m_formatted;
+    // Labels taken from the cache
+    size_t m_cacheHits;
+    // Labels requested and not yet formatted, at the end of the last frame
+    size_t m_queued;
+  };
+
+  TrackLabelScheduler(double budgetMs, size_t cacheSize);
+
+  // Set the position format. All the labels are formatted again.
+  void positionFormat(MaplinkTrackObject::PositionFormat format);
+  MaplinkTrackObject::PositionFormat positionFormat() const;
+
+  // Enable or disable the label cells, the cache and the time budget. While disabled, the label
+  // of a track is formatted every time it moves, as if there were no scheduler.
+  void scheduling(bool enabled);
+  bool scheduling() const;
+
+  // Set the number of tracks. Tracks added are labelled on their first move.
+  void numTracks(size_t numTracks);
+
+  // Let the scheduler know a track has been moved, so its label may need updating
+  void trackMoved(MaplinkTracks& tracks, size_t index);
+
+  // Format queued labels until the time budget for the frame is used up
+  void process(MaplinkTracks& tracks);
+
+  const Statistics& statistics() const;
+  void resetStatistics();
+
+private:
+  // Key of the label cell containing a position, for the current format
+  unsigned long long cellKey(double lat, double lon) const;
+
+  // Format the label of a position. Uses the coordinate converter.
+  std::string formatLabel(double lat, double lon) const;
+
+  // Set the label of a track from the cache if possible. Returns false if the label needs formatting.
+  bool applyCachedLabel(MaplinkTrackObject* track, size_t index, unsigned long long key);
+
+  MaplinkTrackObject::PositionFormat m_format;
+
+  // Time allowed for formatting labels per frame, in milliseconds
+  double m_budgetMs;
+
+  // Number of entries the cache holds before it is emptied
+  size_t m_cacheSize;
+
+  // Set unless the labels are formatted as soon as they are needed
+  bool m_scheduling;
+
+  // Formatted labels by cell
+  std::unordered_map<unsigned long long, std::string> m_cache;
+
+  // Cell of the label shown by each track, or noCell
+  std::vector<unsigned long long> m_trackCells;
+
+  // Set for the tracks in the queue
+  std::vector<char> m_trackQueued;
+
+  // Tracks waiting for their label to be formatted, oldest first
+  std::deque<size_t> m_queue;
+
+  Statistics m_statistics;
+
+  static const unsigned long long noCell;
+};
+
+#endif
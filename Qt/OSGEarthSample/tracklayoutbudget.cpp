@@ -0,0 +1,108 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "tracklayoutbudget.h"
+
+#include <algorithm>
+#include <math.h>
+
+#include <osg/Camera>
+#include <osg/Timer>
+
+// Fraction of the view added around each edge, so symbols straddling the edge are kept
+static const double viewMargin = 0.1;
+
+TrackLayoutBudget::TrackLayoutBudget(size_t maxTracks)
+  : m_maxTracks( maxTracks )
+  , m_decluttering( true )
+{
+  m_statistics.m_tracks = 0;
+  m_statistics.m_onScreen = 0;
+  m_statistics.m_inLayout = 0;
+  m_statistics.m_time = 0.0;
+}
+
+void TrackLayoutBudget::maxTracks(size_t maxTracks)
+{
+  m_maxTracks = maxTracks;
+}
+
+size_t TrackLayoutBudget::maxTracks() const
+{
+  return m_maxTracks;
+}
+
+void TrackLayoutBudget::decluttering(bool enabled)
+{
+  m_decluttering = enabled;
+}
+
+void TrackLayoutBudget::update(osg::View* view, MaplinkTracks& tracks)
+{
+  osg::Timer_t startTick = osg::Timer::instance()->tick();
+  const size_t numTracks = tracks.size();
+
+  osg::Camera* camera = view->getCamera();
+  osg::Matrixd viewProjection = camera->getViewMatrix() * camera->getProjectionMatrix();
+  osg::Vec3d eye = osg::Vec3d(0.0, 0.0, 0.0) * camera->getInverseViewMatrix();
+  const double clipLimit = 1.0 + viewMargin;
+
+  // Find the tracks on screen
+  m_candidates.clear();
+  for( size_t index = 0; index < numTracks; ++index )
+  {
+    const osg::Vec3d& position = tracks[index]->worldPosition();
+
+    // A point on the globe is behind the horizon if the eye is below its horizontal plane
+    osg::Vec3d toEye = eye - position;
+    if( toEye * position <= 0.0 )
+    {
+      continue;
+    }
+
+    // Clip against the view frustum, without the near and far planes
+    osg::Vec4d clip = osg::Vec4d(position, 1.0) * viewProjection;
+    if( clip.w() <= 0.0 ||
+        fabs(clip.x()) > clipLimit * clip.w() ||
+        fabs(clip.y()) > clipLimit * clip.w() )
+    {
+      continue;
+    }
+
+    Candidate candidate;
+    candidate.m_rank = tracks[index]->hostilityRank();
+    candidate.m_distance2 = toEye.length2();
+    candidate.m_index = index;
+    m_candidates.push_back(candidate);
+  }
+
+  // Keep the most important of them. Only the split is needed, not the order.
+  size_t numShown = m_candidates.size();
+  if( m_decluttering && numShown > m_maxTracks )
+  {
+    std::nth_element( m_candidates.begin(), m_candidates.begin() + m_maxTracks, m_candidates.end() );
+    numShown = m_maxTracks;
+  }
+
+  // Show the chosen tracks and hide the others. The tracks only touch their node when their state changes.
+  m_shown.assign( numTracks, 0 );
+  for( size_t i = 0; i < numShown; ++i )
+  {
+    m_shown[m_candidates[i].m_index] = 1;
+  }
+  for( size_t index = 0; index < numTracks; ++index )
+  {
+    tracks[index]->inLayout( m_shown[index] != 0 );
+  }
+
+  m_statistics.m_tracks = numTracks;
+  m_statistics.m_onScreen = m_candidates.size();
+  m_statistics.m_inLayout = numShown;
+  m_statistics.m_time = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+}
+
+const TrackLayoutBudget::Statistics& TrackLayoutBudget::statistics() const
+{
+  return m_statistics;
+}
@@ -0,0 +1,76 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef TRACKLAYOUTBUDGET_H
+#define TRACKLAYOUTBUDGET_H
+
+#include <vector>
+
+#include <osg/View>
+
+#include "maplinktrackobject.h"
+
+// Chooses the tracks that take part in the screen space layout.
+//
+// The cost of osgEarth's ScreenSpaceLayout grows with every track node in the scene, not only
+// with the ones on screen. Before the scene is traversed, the tracks behind the horizon or
+// outside the view are hidden, and while decluttering is enabled, at most a fixed number of the
+// remaining tracks are kept. The tracks kept are the most important ones: threats first, then
+// the nearest to the camera. Decluttering would hide the others anyway.
+class TrackLayoutBudget
+{
+public:
+  // Counts and timings of the last frame
+  struct Statistics
+  {
+    size_t m_tracks;
+    // Tracks in front of the horizon and inside the view
+    size_t m_onScreen;
+    // Tracks given to the screen space layout
+    size_t m_inLayout;
+    // Time taken to choose the tracks, in milliseconds
+    double m_time;
+  };
+
+  explicit TrackLayoutBudget(size_t maxTracks);
+
+  // Set the maximum number of tracks given to the screen space layout while decluttering
+  void maxTracks(size_t maxTracks);
+  size_t maxTracks() const;
+
+  // Cap the number of tracks in the layout. The off screen tracks are hidden either way.
+  void decluttering(bool enabled);
+
+  // Choose the tracks to show for the view, and show or hide them
+  void update(osg::View* view, MaplinkTracks& tracks);
+
+  const Statistics& statistics() const;
+
+private:
+  // A track on screen, ordered by importance
+  struct Candidate
+  {
+    int m_rank;
+    double m_distance2;
+    size_t m_index;
+
+    bool operator<(const Candidate& other) const
+    {
+      return m_rank != other.m_rank ? m_rank > other.m_rank : m_distance2 < other.m_distance2;
+    }
+  };
+
+  size_t m_maxTracks;
+  bool m_decluttering;
+
+  // Whether each track is shown in the current frame, by index
+  std::vector<char> m_shown;
+
+  // Tracks on screen in the current frame
+  std::vector<Candidate> m_candidates;
+
+  Statistics m_statistics;
+};
+
+#endif
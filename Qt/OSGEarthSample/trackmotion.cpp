@@ -0,0 +1,153 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "trackmotion.h"
+
+#include <math.h>
+
+const double TrackMotion::earthRadius = 6371008.8;
+
+static const double degreesToRadians = 0.017453292519943295;
+static const double radiansToDegrees = 57.295779513082323;
+
+static void toUnitVector(double lat, double lon, double* v)
+{
+  double latRad = lat * degreesToRadians;
+  double lonRad = lon * degreesToRadians;
+  double cosLat = cos(latRad);
+  v[0] = cosLat * cos(lonRad);
+  v[1] = cosLat * sin(lonRad);
+  v[2] = sin(latRad);
+}
+
+TrackMotion::TrackMotion()
+  : m_legAngle(0.0)
+  , m_angularSpeed(0.0)
+  , m_startTime(0.0)
+  , m_unplaced(true)
+{
+  for( int i = 0; i < 3; ++i )
+  {
+    m_start[i] = m_direction[i] = m_position[i] = m_placed[i] = 0.0;
+  }
+  m_start[0] = m_position[0] = 1.0;
+}
+
+void TrackMotion::setLeg(double startLat, double startLon, double endLat, double endLon, double speed, double startTime)
+{
+  double end[3];
+  toUnitVector(startLat, startLon, m_start);
+  toUnitVector(endLat, endLon, end);
+
+  // The direction of travel is the part of the end vector orthogonal to the start vector
+  double cosAngle = m_start[0]*end[0] + m_start[1]*end[1] + m_start[2]*end[2];
+  double length = 0.0;
+  for( int i = 0; i < 3; ++i )
+  {
+    m_direction[i] = end[i] - cosAngle * m_start[i];
+    length += m_direction[i] * m_direction[i];
+  }
+  length = sqrt(length);
+
+  if( length > 1e-12 )
+  {
+    for( int i = 0; i < 3; ++i )
+    {
+      m_direction[i] /= length;
+    }
+  }
+  else if( cosAngle < 0.0 )
+  {
+    // The end is opposite the start, so every great circle through the start reaches it.
+    // Head north, or east from a pole.
+    if( fabs(m_start[2]) < 0.999 )
+    {
+      m_direction[0] = -m_start[2] * m_start[0];
+      m_direction[1] = -m_start[2] * m_start[1];
+      m_direction[2] = 1.0 - m_start[2] * m_start[2];
+    }
+    else
+    {
+      m_direction[0] = 0.0;
+      m_direction[1] = 1.0;
+      m_direction[2] = 0.0;
+    }
+    double directionLength = sqrt(m_direction[0]*m_direction[0] + m_direction[1]*m_direction[1] + m_direction[2]*m_direction[2]);
+    for( int i = 0; i < 3; ++i )
+    {
+      m_direction[i] /= directionLength;
+    }
+  }
+
+  m_legAngle = atan2(length, cosAngle);
+  m_angularSpeed = speed / earthRadius;
+  m_startTime = startTime;
+  for( int i = 0; i < 3; ++i )
+  {
+    m_position[i] = m_start[i];
+  }
+}
+
+double TrackMotion::evaluate(double time, int simulationSpeed)
+{
+  double angle = (time - m_startTime) * simulationSpeed * m_angularSpeed;
+  if( angle >= m_legAngle )
+  {
+    angle = m_legAngle;
+  }
+  else if( angle < 0.0 )
+  {
+    angle = 0.0;
+  }
+
+  double c = cos(angle);
+  double s = sin(angle);
+  for( int i = 0; i < 3; ++i )
+  {
+    m_position[i] = c * m_start[i] + s * m_direction[i];
+  }
+
+  return (m_legAngle > 0.0) ? angle / m_legAngle : 1.0;
+}
+
+void TrackMotion::position(double& lat, double& lon) const
+{
+  toLatLon(m_position, lat, lon);
+}
+
+bool TrackMotion::movedFurtherThan(double angle) const
+{
+  if( m_unplaced )
+  {
+    return true;
+  }
+
+  // For the small angles of interest the chord between the unit vectors is the angle
+  double dx = m_position[0] - m_placed[0];
+  double dy = m_position[1] - m_placed[1];
+  double dz = m_position[2] - m_placed[2];
+  return dx*dx + dy*dy + dz*dz > angle*angle;
+}
+
+void TrackMotion::markPlaced()
+{
+  for( int i = 0; i < 3; ++i )
+  {
+    m_placed[i] = m_position[i];
+  }
+  m_unplaced = false;
+}
+
+void TrackMotion::placedPosition(double& lat, double& lon) const
+{
+  toLatLon(m_placed, lat, lon);
+}
+
+void TrackMotion::toLatLon(const double* v, double& lat, double& lon)
+{
+  double z = v[2];
+  z = (z > 1.0) ? 1.0 : ((z < -1.0) ? -1.0 : z);
+  lat = asin(z) * radiansToDegrees;
+  lon = atan2(v[1], v[0]) * radiansToDegrees;
+}
@@ -0,0 +1,69 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef TRACKMOTION_H
+#define TRACKMOTION_H
+
+// Motion of a track along a great circle leg between two waypoints.
+//
+// The leg is set up once per waypoint: the start position and the direction of travel are
+// held as orthogonal unit vectors, so the position at any time is a rotation in their plane,
+// needing only a sine and cosine per evaluation. The length of the leg and the rate of turn
+// are also computed once, so no distance calculation is needed until the next waypoint.
+//
+// Positions are on a sphere of the mean Earth radius, which is accurate enough for the
+// simulated tracks and places them exactly on their waypoints.
+class TrackMotion
+{
+public:
+  TrackMotion();
+
+  // Start a leg from the start to the end position, in degrees, at a speed in metres per second.
+  // The leg is started at the given simulation time.
+  void setLeg(double startLat, double startLon, double endLat, double endLon, double speed, double startTime);
+
+  // Move the track to its position at the given simulation time.
+  // Returns the progress along the leg, which is 1 once the end position has been reached.
+  double evaluate(double time, int simulationSpeed);
+
+  // Position of the last evaluation, in degrees.
+  void position(double& lat, double& lon) const;
+
+  // Check if the track has moved further than the given angle, in radians, since the last call
+  // to markPlaced(), i.e. since its position was last given to the scene.
+  bool movedFurtherThan(double angle) const;
+
+  // Record the position of the last evaluation as the one given to the scene.
+  void markPlaced();
+
+  // Position last given to the scene, in degrees.
+  void placedPosition(double& lat, double& lon) const;
+
+  // Mean radius of the Earth in metres.
+  static const double earthRadius;
+
+private:
+  // Latitude and longitude of a unit vector, in degrees.
+  static void toLatLon(const double* v, double& lat, double& lon);
+
+  // Unit vector of the start position.
+  double m_start[3];
+  // Unit vector at the start position along the direction of travel.
+  double m_direction[3];
+  // Unit vector of the position of the last evaluation.
+  double m_position[3];
+  // Unit vector of the position last given to the scene.
+  double m_placed[3];
+
+  // Angle subtended by the leg, in radians.
+  double m_legAngle;
+  // Rate of turn along the leg, in radians per second of simulation time.
+  double m_angularSpeed;
+  // Simulation time at which the leg was started.
+  double m_startTime;
+  // Set until the track is first placed.
+  bool m_unplaced;
+};
+
+#endif
@@ -2,12 +2,15 @@
                 Copyright (c) 2017 by Envitia Group PLC.
 ****************************************************************************/
 
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <time.h>
 #include <QtGui>
 #include <QMessageBox>
+#include <QDir>
+#include <QStandardPaths>
 
 #include "application.h"
 #include "maplinkwidget.h"
@@ -15,6 +18,8 @@
 #include "tslkmldatalayer.h"
 
 #include "attributetreewidget.h"
+#include "kmldatalayerloader.h"
+#include "kmlfeaturecache.h"
 
 // Interaction mode IDs - these can be any numbers
 #define ID_TOOLS_ZOOM                   1
@@ -29,6 +34,34 @@ const char * Application::m_mapLayerName = "map";
 // Controls how far the drawing surface rotates in one key press - this value is in radians
 static const double rotationIncrement = M_PI / 360.0;
 
+// The name of the layer showing the placemarks read while a KML file loads
+static const char *kmlPreviewLayerName = "kmlpreview";
+
+// Feature codes of the placemark geometry shown while a KML file loads
+#define KML_PREVIEW_POINT               1
+#define KML_PREVIEW_LINE                2
+#define KML_PREVIEW_POLYGON             3
+
+// The most placemarks added to the view each time a KML load is updated. Creating the entities is done
+// on the user interface thread, so this keeps it responsive while large files load.
+static const size_t kmlPlacemarksPerUpdate = 5000;
+
+// Where the features read from KML files, and MapLink's KML cache, are kept between sessions
+static QString kmlCacheLocation()
+{
+  return QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + "/kml";
+}
+
+KMLLoadStatistics::KMLLoadStatistics()
+  : m_timeToFirstFeature( -1 )
+  , m_previewTime( -1 )
+  , m_loadTime( -1 )
+  , m_numPlacemarks( 0 )
+  , m_placemarksFromCache( false )
+  , m_longestStall( 0 )
+{
+}
+
 Application::Application( QWidget *parent )
   : m_mapDataLayer(NULL)
   , m_drawingSurface(NULL)
@@ -45,6 +78,14 @@ Application::Application( QWidget *parent )
   , m_parentWidget( parent )
   , m_kmlLayer(NULL)
   , m_attributeTree(NULL)
+  , m_kmlLoader(NULL)
+  , m_kmlReader(NULL)
+  , m_kmlPreview(true)
+  , m_kmlCacheDirectory( kmlCacheLocation() )
+  , m_kmlPreviewLayer(NULL)
+  , m_lastKMLUpdate(0)
+  , m_kmlPreviewDrawPending(false)
+  , m_kmlLayerDrawPending(false)
 {
   // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
   // Clear the error stack so that we can get the errors that occurred here.
@@ -89,10 +130,12 @@ Application::Application( QWidget *parent )
 
 Application::~Application()
 {
-  // Clean up by destroying the objects we created
-  if (m_kmlLayer)
+  // Clean up by destroying the objects we created. Loading can't be interrupted, so this waits
+  // for any KML file still loading.
+  cancelKMLLoad();
+  for( size_t i = 0; i < m_abandonedKMLLoaders.size(); ++i )
   {
-    m_kmlLayer->destroy();
+    delete m_abandonedKMLLoaders[i];
   }
 
   if( m_mapDataLayer )
@@ -126,6 +169,15 @@ bool Application::loadMap(const char *mapFilename)
 
   if( mapFilename )
   {
+    // KML is loaded in the coordinate system of the map, so any KML shown or loading is dropped
+    // along with the map it was loaded for
+    cancelKMLLoad();
+    if( m_attributeTree )
+    {
+      m_attributeTree->clear();
+      m_attributeTree->m_initialised = false;
+    }
+
     // load the map
     if( !m_mapDataLayer->loadData( mapFilename ) )
     {
@@ -163,10 +215,7 @@ bool Application::loadMap(const char *mapFilename)
 
 bool Application::loadKML(const char* kmlFilename, AttributeTreeWidget* attributeTree)
 {
-  if (m_kmlLayer)
-  {
-    m_kmlLayer->destroy();
-  }
+  cancelKMLLoad();
 
   // Attribute tree passed in from main window
   if( attributeTree )
@@ -180,75 +229,300 @@ bool Application::loadKML(const char* kmlFilename, AttributeTreeWidget* attribut
     m_attributeTree->m_initialised = false;
   }
 
-  if( m_mapDataLayer && m_mapDataLayer->queryCoordinateSystem() )
+  if( !m_mapDataLayer || !m_mapDataLayer->queryCoordinateSystem() )
   {
-    m_kmlLayer = new TSLKMLDataLayer();
-    if( !m_kmlLayer )
+    return false;
+  }
+
+  m_kmlLoadStatistics = KMLLoadStatistics();
+  m_kmlLoadClock.start();
+  m_lastKMLUpdate = 0;
+
+  // The KML data is loaded in the map's coordinate system, and isn't reprojected if the map
+  // coordinate system changes
+  m_kmlLoader = new KMLDataLayerLoader();
+  m_kmlLoader->load( QString::fromUtf8( kmlFilename ), m_mapDataLayer->queryCoordinateSystem(),
+                     m_kmlCacheDirectory.isEmpty() ? QString() : m_kmlCacheDirectory + "/maplink" );
+
+  // KMZ files are zip archives, which the reader can't read
+  if( m_kmlPreview && !QString::fromUtf8( kmlFilename ).endsWith( ".kmz", Qt::CaseInsensitive ) )
+  {
+    m_kmlPreviewLayer = new TSLStandardDataLayer();
+
+    TSLStyleID yellow = TSLComposeRGB( 255, 255, 0 );
+    TSLStyleID black = TSLComposeRGB( 0, 0, 0 );
+    m_kmlPreviewLayer->addFeatureRendering( "Point", KML_PREVIEW_POINT );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POINT, TSLRenderingAttributeSymbolStyle, 6003 );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POINT, TSLRenderingAttributeSymbolColour, yellow );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POINT, TSLRenderingAttributeSymbolSizeFactor, 10.0 );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POINT, TSLRenderingAttributeSymbolSizeFactorUnits, TSLDimensionUnitsPixels );
+    m_kmlPreviewLayer->addFeatureRendering( "Line", KML_PREVIEW_LINE );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_LINE, TSLRenderingAttributeEdgeStyle, 1 );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_LINE, TSLRenderingAttributeEdgeColour, yellow );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_LINE, TSLRenderingAttributeEdgeThickness, 2.0 );
+    m_kmlPreviewLayer->addFeatureRendering( "Polygon", KML_PREVIEW_POLYGON );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POLYGON, TSLRenderingAttributeFillStyle, 1 );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POLYGON, TSLRenderingAttributeFillColour, yellow );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POLYGON, TSLRenderingAttributeEdgeStyle, 1 );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POLYGON, TSLRenderingAttributeEdgeColour, black );
+    m_kmlPreviewLayer->setFeatureRendering( 0, KML_PREVIEW_POLYGON, TSLRenderingAttributeEdgeThickness, 1.0 );
+
+    m_drawingSurface->addDataLayer( m_kmlPreviewLayer, kmlPreviewLayerName );
+    m_drawingSurface->setDataLayerProps( kmlPreviewLayerName, TSLPropertyVisible, true );
+    m_drawingSurface->bringToFront( kmlPreviewLayerName );
+
+    m_kmlReader = new KMLFeatureReader();
+    m_kmlReader->setCacheDirectory( m_kmlCacheDirectory );
+    m_kmlReader->read( QString::fromUtf8( kmlFilename ) );
+  }
+
+  return true;
+}
+
+void Application::setKMLPreview(bool preview)
+{
+  m_kmlPreview = preview;
+}
+
+void Application::setKMLCache(bool cache)
+{
+  m_kmlCacheDirectory = cache ? kmlCacheLocation() : QString();
+}
+
+void Application::clearKMLCache()
+{
+  QString cacheDirectory = kmlCacheLocation();
+  ::clearKMLCache( cacheDirectory );
+  QDir( cacheDirectory + "/maplink" ).removeRecursively();
+}
+
+bool Application::kmlLoading() const
+{
+  return m_kmlLoader || m_kmlReader || m_kmlPreviewDrawPending || m_kmlLayerDrawPending;
+}
+
+bool Application::updateKMLLoad(int& progress)
+{
+  qint64 now = m_kmlLoadClock.isValid() ? m_kmlLoadClock.elapsed() : 0;
+  if( kmlLoading() )
+  {
+    m_kmlLoadStatistics.m_longestStall = std::max( m_kmlLoadStatistics.m_longestStall, now - m_lastKMLUpdate );
+  }
+  m_lastKMLUpdate = now;
+
+  // Delete the loaders of files no longer wanted once they have finished
+  std::vector< KMLDataLayerLoader* >::iterator loaderIt( m_abandonedKMLLoaders.begin() );
+  while( loaderIt != m_abandonedKMLLoaders.end() )
+  {
+    if( (*loaderIt)->isFinished() )
     {
-      return false;
+      delete *loaderIt;
+      loaderIt = m_abandonedKMLLoaders.erase( loaderIt );
     }
-    // If the coordinate system is set manually, data will be loaded 
-    // immediately.
-    //
-    // Otherwise the data will be loaded on the first redraw.
-    //
-    // If you set a coordinate system then the KML data will not be reprojected if
-    // the map coordinate system changes.
-    //
-    //m_kmlLayer->setCoordinateSystem( m_mapDataLayer->queryCoordinateSystem() );
-
-    //
-    // Set the location for the KML Cache if required.
-    //
-    //m_kmlLayer->setCacheDirectory( "CustomCacheFolder" );
-    //m_kmlLayer->clearCache();
-
-    if( !m_kmlLayer->loadData( kmlFilename ) )
+    else
     {
-      QMessageBox::critical( m_parentWidget, "Failed to load kml file.", QString::fromUtf8( kmlFilename ) );
-      return false;
+      ++loaderIt;
     }
- 
-    m_drawingSurface->removeDataLayer("kml");
-    m_drawingSurface->addDataLayer( m_kmlLayer, "kml");
-
-    // Enable if there is a drawing issue with lots of transparent lines - this is a performance hit.
-    // m_drawingSurface->setLayerTransparencyHint( "kml", TSLOpenGLTransparencyHintFlushOpaque );
-    m_drawingSurface->setDataLayerProps( "kml", TSLPropertyVisible, true ) ;
-    m_drawingSurface->setDataLayerProps( "kml", TSLPropertyDetect, true ) ;
-    m_drawingSurface->setDataLayerProps( "kml", TSLPropertySelect, true ) ;
-    m_drawingSurface->setDataLayerProps( "kml", TSLPropertyBuffered, true ) ;
-    m_drawingSurface->bringToFront( "kml" );
-    
-    
-    if( m_attributeTree && m_kmlLayer && !m_attributeTree->m_initialised)
+  }
+
+  progress = -1;
+  bool redraw = false;
+  if( m_kmlReader )
+  {
+    std::vector< KMLFolder > folders;
+    std::vector< KMLPlacemark > placemarks;
+    m_kmlReader->takeRead( kmlPlacemarksPerUpdate, folders, placemarks );
+    if( !folders.empty() || !placemarks.empty() )
+    {
+      showKMLPlacemarks( folders, placemarks );
+      redraw = !placemarks.empty();
+    }
+
+    progress = m_kmlReader->progress();
+    if( m_kmlReader->done() )
+    {
+      // Problems with the document are reported by the KML data layer
+      m_kmlLoadStatistics.m_placemarksFromCache = m_kmlReader->readFromCache();
+      delete m_kmlReader;
+      m_kmlReader = NULL;
+      m_kmlPreviewDrawPending = true;
+      redraw = true;
+    }
+  }
+
+  TSLKMLDataLayer* layer = NULL;
+  QString error;
+  if( m_kmlLoader && m_kmlLoader->takeLoaded( layer, error ) )
+  {
+    delete m_kmlLoader;
+    m_kmlLoader = NULL;
+    if( layer )
+    {
+      showKMLLayer( layer );
+    }
+    else
+    {
+      cancelKMLLoad();
+      QMessageBox::critical( m_parentWidget, "Failed to load kml file.", error );
+    }
+    redraw = true;
+  }
+
+  return redraw;
+}
+
+void Application::cancelKMLLoad()
+{
+  if( m_kmlLoader )
+  {
+    m_kmlLoader->abandon();
+    m_abandonedKMLLoaders.push_back( m_kmlLoader );
+    m_kmlLoader = NULL;
+  }
+
+  if( m_kmlReader )
+  {
+    delete m_kmlReader;
+    m_kmlReader = NULL;
+  }
+
+  if( m_kmlPreviewLayer )
+  {
+    m_drawingSurface->removeDataLayer( kmlPreviewLayerName );
+    m_kmlPreviewLayer->destroy();
+    m_kmlPreviewLayer = NULL;
+  }
+  m_kmlPreviewFolders.clear();
+
+  if( m_kmlLayer )
+  {
+    m_drawingSurface->removeDataLayer( "kml" );
+    m_kmlLayer->destroy();
+    m_kmlLayer = NULL;
+  }
+
+  m_kmlPreviewDrawPending = false;
+  m_kmlLayerDrawPending = false;
+}
+
+void Application::showKMLPlacemarks(const std::vector< KMLFolder >& folders, const std::vector< KMLPlacemark >& placemarks)
+{
+  TSLEntitySet* layerSet = m_kmlPreviewLayer->entitySet();
+  for( size_t i = 0; i < folders.size(); ++i )
+  {
+    // Folders start before those they hold, so the parent is already known
+    TSLEntitySet* parentSet = folders[i].m_parent >= 0 ? m_kmlPreviewFolders[folders[i].m_parent] : layerSet;
+    TSLEntitySet* folderSet = parentSet->createEntitySet();
+    if( folderSet )
     {
-      // This can only be called after m_kmlLayer->loadData( filename ), 
-      // if we previously set a coordinate system on the layer.
-      //
-      // If the layer has no coordinate system, data isn't loaded
-      // until the first draw, so this will return NULL
-
-      TSLDataLayer* layer = m_kmlLayer->getLayer(0);
-      if( layer->layerType() == TSLDataLayerTypeStandardDataLayer )
+      folderSet->name( folders[i].m_name.toUtf8() );
+    }
+    m_kmlPreviewFolders.push_back( folderSet ? folderSet : parentSet );
+  }
+
+  const TSLCoordinateSystem* coordinateSystem = m_mapDataLayer->queryCoordinateSystem();
+  for( size_t i = 0; i < placemarks.size(); ++i )
+  {
+    const KMLPlacemark& placemark = placemarks[i];
+    TSLEntitySet* folderSet = placemark.m_folder >= 0 ? m_kmlPreviewFolders[placemark.m_folder] : layerSet;
+    QByteArray name = placemark.m_name.toUtf8();
+
+    for( size_t j = 0; j < placemark.m_geometries.size(); ++j )
+    {
+      const KMLPlacemark::Geometry& geometry = placemark.m_geometries[j];
+      TSLEntity* entity = NULL;
+      if( geometry.m_type == KMLPlacemark::Point )
       {
-        TSLStandardDataLayer* standardLayer = (TSLStandardDataLayer*)layer;
-        TSLEntitySet* es = standardLayer->entitySet();
-        if( es->size() )
+        TSLTMC x = 0, y = 0;
+        if( coordinateSystem->latLongToTMC( geometry.m_coordinates[1], geometry.m_coordinates[0], &x, &y ) )
         {
-          m_attributeTree->AddEntitySet( es );
-          m_attributeTree->m_initialised = true;
-          m_kmlLayer->notifyChanged();
+          entity = folderSet->createSymbol( KML_PREVIEW_POINT, x, y );
         }
       }
+      else
+      {
+        TSLCoordSet* coords = new TSLCoordSet();
+        for( size_t k = 0; k + 1 < geometry.m_coordinates.size(); k += 2 )
+        {
+          TSLTMC x = 0, y = 0;
+          if( coordinateSystem->latLongToTMC( geometry.m_coordinates[k+1], geometry.m_coordinates[k], &x, &y ) )
+          {
+            coords->add( x, y );
+          }
+        }
+
+        // Hand ownership of the coordset to the new entity
+        if( geometry.m_type == KMLPlacemark::LineString && coords->length() > 1 )
+        {
+          entity = folderSet->createPolyline( KML_PREVIEW_LINE, coords, true );
+        }
+        else if( geometry.m_type == KMLPlacemark::Polygon && coords->length() > 2 )
+        {
+          entity = folderSet->createPolygon( KML_PREVIEW_POLYGON, coords, true );
+        }
+        else
+        {
+          coords->destroy();
+        }
+      }
+
+      if( entity )
+      {
+        entity->name( name.constData() );
+      }
     }
   }
-  else
+
+  m_kmlLoadStatistics.m_numPlacemarks += (int)placemarks.size();
+  m_kmlPreviewLayer->notifyChanged( true );
+}
+
+void Application::showKMLLayer(TSLKMLDataLayer* layer)
+{
+  // The placemarks read were only needed until the KML data layer loaded
+  if( m_kmlReader )
   {
-    return false;
+    delete m_kmlReader;
+    m_kmlReader = NULL;
+  }
+  if( m_kmlPreviewLayer )
+  {
+    m_drawingSurface->removeDataLayer( kmlPreviewLayerName );
+    m_kmlPreviewLayer->destroy();
+    m_kmlPreviewLayer = NULL;
   }
+  m_kmlPreviewFolders.clear();
+  m_kmlPreviewDrawPending = false;
 
-  return true;
+  m_kmlLayer = layer;
+  m_drawingSurface->addDataLayer( m_kmlLayer, "kml");
+
+  // Enable if there is a drawing issue with lots of transparent lines - this is a performance hit.
+  // m_drawingSurface->setLayerTransparencyHint( "kml", TSLOpenGLTransparencyHintFlushOpaque );
+  m_drawingSurface->setDataLayerProps( "kml", TSLPropertyVisible, true ) ;
+  m_drawingSurface->setDataLayerProps( "kml", TSLPropertyDetect, true ) ;
+  m_drawingSurface->setDataLayerProps( "kml", TSLPropertySelect, true ) ;
+  m_drawingSurface->setDataLayerProps( "kml", TSLPropertyBuffered, true ) ;
+  m_drawingSurface->bringToFront( "kml" );
+
+  if( m_attributeTree && !m_attributeTree->m_initialised )
+  {
+    // The data layer was given a coordinate system, so its data has already been loaded
+    TSLDataLayer* kmlDataLayer = m_kmlLayer->getLayer(0);
+    if( kmlDataLayer && kmlDataLayer->layerType() == TSLDataLayerTypeStandardDataLayer )
+    {
+      TSLStandardDataLayer* standardLayer = (TSLStandardDataLayer*)kmlDataLayer;
+      TSLEntitySet* es = standardLayer->entitySet();
+      if( es->size() )
+      {
+        m_attributeTree->AddEntitySet( es );
+        m_attributeTree->m_initialised = true;
+        m_kmlLayer->notifyChanged();
+      }
+    }
+  }
+
+  m_kmlLayerDrawPending = true;
 }
 
 void Application::create()
@@ -335,16 +609,34 @@ void Application::redraw()
       m_modeManager->onDraw( 0, 0, m_widgetWidth, m_widgetHeight );
     }
 
+    // Record how far a KML load had got when it was first drawn
+    if( m_kmlLoadClock.isValid() )
+    {
+      qint64 elapsed = m_kmlLoadClock.elapsed();
+      if( m_kmlLoadStatistics.m_timeToFirstFeature < 0 && (m_kmlLoadStatistics.m_numPlacemarks > 0 || m_kmlLayerDrawPending) )
+      {
+        m_kmlLoadStatistics.m_timeToFirstFeature = elapsed;
+      }
+      if( m_kmlPreviewDrawPending )
+      {
+        m_kmlLoadStatistics.m_previewTime = elapsed;
+        m_kmlPreviewDrawPending = false;
+      }
+      if( m_kmlLayerDrawPending )
+      {
+        m_kmlLoadStatistics.m_loadTime = elapsed;
+        m_kmlLayerDrawPending = false;
+      }
+    }
+
     // We have to wait until we have loaded data into the layer
     // which may happen on first draw if a coordinate system was
     // not set on the KML data-layer.
     if( m_attributeTree && m_kmlLayer && !m_attributeTree->m_initialised)
     {
-      // This can only be called after m_kmlLayer->loadData( filename ), 
-      // if we previously set a coordinate system on the layer.
-      //
-      // If the layer has no coordinate system, data isn't loaded
-      // until the first draw, so this will return NULL
+      // The KML data layer is loaded with a coordinate system, so its data is normally
+      // available as soon as it is shown. If the layer has no coordinate system, data
+      // isn't loaded until the first draw.
 
       TSLDataLayer* layer = m_kmlLayer->getLayer(0); // First layer is the vector data-layer.
       if( layer->layerType() == TSLDataLayerTypeStandardDataLayer ) // Always check the layer type.
@@ -454,7 +746,8 @@ bool Application::onRButtonUp(bool shiftPressed, bool controlPressed, int mx, in
   // In the case of this sample, the right mouse button is unused
   // - mapped to perform a pick operation on the kml layer and 
   //   display the results in the attribute widget.
-  if( m_attributeTree )
+  // Placemarks shown while the KML data layer loads can't be picked
+  if( m_attributeTree && m_kmlLayer )
   {
     TSLPickResultSet* pickResults = m_drawingSurface->pick( "kml", mx, my, 0, 1 );
 
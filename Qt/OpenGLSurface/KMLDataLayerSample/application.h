@@ -5,6 +5,9 @@
 #ifndef _APPLICATION_H_
 #define _APPLICATION_H_
 
+#include <vector>
+
+#include <QElapsedTimer>
 #include <QGLWidget>
 
 /////////////////////////////////////////////////////////////////////
@@ -35,10 +38,38 @@
 #include "MapLinkOpenGLSurface.h"
 
 #include "attributetreewidget.h"
+#include "kmlfeaturereader.h"
 
+class KMLDataLayerLoader;
 class TSLKMLDataLayer;
 /////////////////////////////////////////////////////////////////////
 
+// Timings of the last KML load in milliseconds from when it started, or -1 where the load
+// didn't get that far
+struct KMLLoadStatistics
+{
+  KMLLoadStatistics();
+
+  // The first draw showing any of the document
+  qint64 m_timeToFirstFeature;
+
+  // The first draw showing every placemark read while the KML data layer loaded
+  qint64 m_previewTime;
+
+  // The first draw of the loaded KML data layer
+  qint64 m_loadTime;
+
+  // The placemarks shown while the KML data layer loaded
+  int m_numPlacemarks;
+
+  // Whether the placemarks shown were read from the feature cache rather than parsed
+  bool m_placemarksFromCache;
+
+  // The longest time between updates of the load, which is how long the user interface was
+  // unresponsive for
+  qint64 m_longestStall;
+};
+
 ////////////////////////////////////////////////////////////////
 // Main Application class.
 //
@@ -86,9 +117,30 @@ public:
   // load map and create layers
   bool loadMap(const char *mapFilename);
 
-  // load map and populate KML attribute tree
+  // Start loading a KML file in the background, showing its placemarks as they are read. The KML
+  // attribute tree is populated once the file has loaded.
   bool loadKML(const char* kmlFilename, AttributeTreeWidget* attributeTree);
 
+  // Called periodically while a KML file loads to show the placemarks read since the last call, and
+  // to show the KML data layer in their place once it has loaded. Returns true if the view needs
+  // to be redrawn. progress is set to the percentage of the file read, or -1 if it isn't known.
+  bool updateKMLLoad(int& progress);
+
+  // Returns true until the loaded KML data layer has been drawn
+  bool kmlLoading() const;
+
+  const KMLLoadStatistics& kmlLoadStatistics() const;
+
+  // Whether placemarks are shown while the KML data layer loads
+  void setKMLPreview(bool preview);
+
+  // Whether the features read from KML files, and the contents of KMZ files, are cached on disk
+  // so that files load more quickly when they are loaded again
+  void setKMLCache(bool cache);
+
+  // Remove everything cached from the KML files loaded before
+  void clearKMLCache();
+
   // Information to enable Drawing surface to draw.
 #ifdef X11_BUILD
   void drawingInfo(Display *display, Screen *screen);
@@ -97,6 +149,15 @@ public:
 #endif
 
 private:
+  // Stop any KML load in progress and remove the KML data from the view
+  void cancelKMLLoad();
+
+  // Add placemarks read from the KML file to the preview layer
+  void showKMLPlacemarks(const std::vector< KMLFolder >& folders, const std::vector< KMLPlacemark >& placemarks);
+
+  // Replace the preview layer with the loaded KML data layer
+  void showKMLLayer(TSLKMLDataLayer* layer);
+
   // The data layer containing the map
   TSLMapDataLayer *m_mapDataLayer;
 
@@ -134,6 +195,32 @@ private:
 
   TSLKMLDataLayer *m_kmlLayer;
   AttributeTreeWidget* m_attributeTree;
+
+  // Loads the KML data layer being loaded, and reads the placemarks shown until it has loaded.
+  // Loaders of files no longer wanted are kept until they finish.
+  KMLDataLayerLoader* m_kmlLoader;
+  std::vector< KMLDataLayerLoader* > m_abandonedKMLLoaders;
+  KMLFeatureReader* m_kmlReader;
+  bool m_kmlPreview;
+
+  // Where the features read from KML files and MapLink's KML cache are kept, or an empty string
+  // if nothing is cached
+  QString m_kmlCacheDirectory;
+
+  // Shows the placemarks read while the KML data layer loads, with an entity set for each folder read
+  TSLStandardDataLayer* m_kmlPreviewLayer;
+  std::vector< TSLEntitySet* > m_kmlPreviewFolders;
+
+  QElapsedTimer m_kmlLoadClock;
+  qint64 m_lastKMLUpdate;
+  bool m_kmlPreviewDrawPending;
+  bool m_kmlLayerDrawPending;
+  KMLLoadStatistics m_kmlLoadStatistics;
 };
 
+inline const KMLLoadStatistics& Application::kmlLoadStatistics() const
+{
+  return m_kmlLoadStatistics;
+}
+
 #endif
@@ -0,0 +1,134 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "kmldatalayerloader.h"
+
+#include <QDir>
+#include <QMutexLocker>
+
+#include "MapLink.h"
+#include "tslkmldatalayer.h"
+
+KMLDataLayerLoader::KMLDataLayerLoader()
+  : m_coordinateSystem( NULL )
+  , m_layer( NULL )
+  , m_finished( false )
+  , m_abandoned( false )
+{
+}
+
+KMLDataLayerLoader::~KMLDataLayerLoader()
+{
+  abandon();
+  wait();
+
+  if( m_coordinateSystem )
+  {
+    m_coordinateSystem->destroy();
+  }
+}
+
+void KMLDataLayerLoader::load(const QString& filename, const TSLCoordinateSystem* coordinateSystem, const QString& cacheDirectory)
+{
+  m_filename = filename;
+
+  // The map's coordinate system is replaced if another map is loaded while the file loads, so the
+  // thread uses its own copy. The data layer keeps a copy of the one it is given.
+  m_coordinateSystem = coordinateSystem ? coordinateSystem->clone( 1000 ) : NULL;
+  m_cacheDirectory = cacheDirectory;
+  start();
+}
+
+bool KMLDataLayerLoader::takeLoaded(TSLKMLDataLayer*& layer, QString& error)
+{
+  QMutexLocker lock( &m_mutex );
+  if( !m_finished )
+  {
+    return false;
+  }
+
+  layer = m_layer;
+  error = m_error;
+  m_layer = NULL;
+  return true;
+}
+
+void KMLDataLayerLoader::abandon()
+{
+  QMutexLocker lock( &m_mutex );
+  m_abandoned = true;
+  if( m_layer )
+  {
+    m_layer->destroy();
+    m_layer = NULL;
+  }
+}
+
+void KMLDataLayerLoader::run()
+{
+  // A file replaced before the thread got going isn't parsed
+  if( abandoned() )
+  {
+    finish( NULL, QString() );
+    return;
+  }
+
+  // Errors are recorded for the thread that raised them
+  TSLThreadedErrorStack::clear();
+
+  TSLKMLDataLayer* layer = new TSLKMLDataLayer();
+
+  // With a coordinate system set the data is loaded straight away, rather than on the first draw.
+  // The KML data will not be reprojected if the map coordinate system changes.
+  layer->setCoordinateSystem( m_coordinateSystem );
+
+  //
+  // Set the location for the KML Cache, so that the contents of KMZ files and linked files
+  // are kept between sessions rather than extracted every time the file is loaded.
+  //
+  if( !m_cacheDirectory.isEmpty() && QDir().mkpath( m_cacheDirectory ) )
+  {
+    layer->setCacheDirectory( m_cacheDirectory.toUtf8() );
+  }
+
+  // Check again before the file is parsed, as that can't be interrupted
+  if( abandoned() )
+  {
+    layer->destroy();
+    finish( NULL, QString() );
+    return;
+  }
+
+  QString error;
+  if( !layer->loadData( m_filename.toUtf8() ) )
+  {
+    TSLSimpleString message;
+    TSLThreadedErrorStack::errorString( message );
+    error = message.empty() ? m_filename : QString::fromUtf8( message.c_str() );
+    TSLThreadedErrorStack::clear();
+    layer->destroy();
+    layer = NULL;
+  }
+
+  finish( layer, error );
+}
+
+bool KMLDataLayerLoader::abandoned()
+{
+  QMutexLocker lock( &m_mutex );
+  return m_abandoned;
+}
+
+void KMLDataLayerLoader::finish(TSLKMLDataLayer* layer, const QString& error)
+{
+  QMutexLocker lock( &m_mutex );
+  if( m_abandoned && layer )
+  {
+    layer->destroy();
+    layer = NULL;
+  }
+  m_layer = layer;
+  m_error = error;
+  m_finished = true;
+}
@@ -0,0 +1,60 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef KMLDATALAYERLOADER_H
+#define KMLDATALAYERLOADER_H
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+class TSLCoordinateSystem;
+class TSLKMLDataLayer;
+
+// Loads a TSLKMLDataLayer in a background thread.
+//
+// The data layer loads the whole document as soon as it is given a coordinate system, so it is
+// created and loaded here rather than on first draw. It isn't attached to a drawing surface until
+// it has been taken, so no other thread uses it while it loads. A loader abandoned before the data
+// layer starts loading doesn't load the file at all. Once started, loading can't be interrupted, so
+// a loader abandoned then is left to finish, and destroys its data layer when it does.
+class KMLDataLayerLoader : public QThread
+{
+public:
+  KMLDataLayerLoader();
+  ~KMLDataLayerLoader();
+
+  // Start loading the file into a data layer using a copy of the given coordinate system. MapLink's
+  // KML cache is kept in cacheDirectory, unless it is an empty string.
+  void load(const QString& filename, const TSLCoordinateSystem* coordinateSystem, const QString& cacheDirectory);
+
+  // Returns true once loading has finished. The loaded data layer, which the caller then owns,
+  // is returned in layer - or NULL with a description of the problem in error if loading failed.
+  bool takeLoaded(TSLKMLDataLayer*& layer, QString& error);
+
+  // The data layer will not be taken, so destroy it once it has loaded
+  void abandon();
+
+protected:
+  virtual void run();
+
+private:
+  bool abandoned();
+
+  // Hand the loaded data layer, or the reason loading failed, to the application
+  void finish(TSLKMLDataLayer* layer, const QString& error);
+
+  QString m_filename;
+  TSLCoordinateSystem* m_coordinateSystem;
+  QString m_cacheDirectory;
+
+  // Guards the members below
+  QMutex m_mutex;
+  TSLKMLDataLayer* m_layer;
+  QString m_error;
+  bool m_finished;
+  bool m_abandoned;
+};
+
+#endif
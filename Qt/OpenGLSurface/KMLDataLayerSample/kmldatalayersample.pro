@@ -69,6 +69,6 @@ unix {
 
 # Common Input
 FORMS = kmldatalayersample.ui
-HEADERS = maplinkwidget.h mainwindow.h application.h attributetreewidget.h
-SOURCES = main.cpp mainwindow.cpp maplinkwidget.cpp application.cpp attributetreewidget.cpp
+HEADERS = maplinkwidget.h mainwindow.h application.h attributetreewidget.h kmlfeaturereader.h kmldatalayerloader.h kmlgenerator.h kmlfeaturecache.h
+SOURCES = main.cpp mainwindow.cpp maplinkwidget.cpp application.cpp attributetreewidget.cpp kmlfeaturereader.cpp kmldatalayerloader.cpp kmlgenerator.cpp kmlfeaturecache.cpp
 RESOURCES = MapLink.qrc
@@ -0,0 +1,553 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "kmlfeaturecache.h"
+
+#include <limits>
+#include <string.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+// Identifies the cache file format. The version must change whenever the layout below does.
+static const quint32 cacheMagic = 0x4b4d4c43;
+static const quint32 cacheVersion = 1;
+
+// Written as a number so that a cache file from a machine of a different byte order isn't used
+static const quint32 cacheByteOrder = 0x01020304;
+
+// Cache files start with a header of the magic number, version, byte order, the SHA-1 hash of
+// the KML file, the number of folders and placemarks, the offset of the folders and the size of
+// the cache file. The placemarks follow the header and the folders come last, as they are only
+// complete once the whole KML file has been read.
+static const int hashSize = 20;
+static const qint64 hashOffset = 3 * sizeof(quint32);
+static const qint64 headerSize = 3 * sizeof(quint32) + hashSize + 2 * sizeof(quint32) + 2 * sizeof(quint64);
+
+static const char* cacheFileSuffix = ".kmlcache";
+
+// The number of cache files kept - the least recently written are removed
+static const int maxCacheFiles = 16;
+
+// The amount written to a cache file at a time
+static const int writeBufferSize = 1024 * 1024;
+
+static QString cacheFilename(const QString& directory, const QByteArray& sourceStamp)
+{
+  return directory + "/" + QString::fromLatin1( sourceStamp.toHex() ) + cacheFileSuffix;
+}
+
+template< typename T >
+static void appendValue(QByteArray& buffer, T value)
+{
+  buffer.append( reinterpret_cast< const char* >( &value ), sizeof(value) );
+}
+
+QByteArray stampKMLFile(const QFileInfo& file)
+{
+  QByteArray properties;
+  appendValue( properties, (qint64)file.size() );
+  appendValue( properties, (qint64)file.lastModified().toMSecsSinceEpoch() );
+
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  hash.addData( file.absoluteFilePath().toUtf8() );
+  hash.addData( properties );
+  return hash.result();
+}
+
+QByteArray hashKMLFile(QIODevice& file)
+{
+  QCryptographicHash hash( QCryptographicHash::Sha1 );
+  hash.addData( &file );
+  return hash.result();
+}
+
+void clearKMLCache(const QString& directory)
+{
+  QDir cacheDirectory( directory );
+  QStringList cacheFiles = cacheDirectory.entryList( QStringList( QString( "*" ) + cacheFileSuffix ), QDir::Files );
+  for( int i = 0; i < cacheFiles.size(); ++i )
+  {
+    cacheDirectory.remove( cacheFiles[i] );
+  }
+}
+
+KMLFeatureCacheWriter::KMLFeatureCacheWriter()
+  : m_numPlacemarks( 0 )
+{
+}
+
+bool KMLFeatureCacheWriter::open(const QString& directory, const QByteArray& sourceStamp, const QByteArray& sourceHash)
+{
+  if( sourceStamp.isEmpty() || sourceHash.size() != hashSize || !QDir().mkpath( directory ) )
+  {
+    return false;
+  }
+
+  m_directory = directory;
+  m_sourceHash = sourceHash;
+  m_numPlacemarks = 0;
+  m_file.setFileName( cacheFilename( directory, sourceStamp ) );
+  if( !m_file.open( QIODevice::WriteOnly ) )
+  {
+    return false;
+  }
+
+  // The header is written once the folders are known
+  m_buffer.fill( 0, (int)headerSize );
+  return true;
+}
+
+void KMLFeatureCacheWriter::writePlacemark(const KMLPlacemark& placemark)
+{
+  writeString( placemark.m_name );
+  appendValue( m_buffer, (qint32)placemark.m_folder );
+
+  appendValue( m_buffer, (quint32)placemark.m_geometries.size() );
+  for( size_t i = 0; i < placemark.m_geometries.size(); ++i )
+  {
+    const KMLPlacemark::Geometry& geometry = placemark.m_geometries[i];
+    appendValue( m_buffer, (quint32)geometry.m_type );
+    appendValue( m_buffer, (quint32)geometry.m_coordinates.size() );
+    if( !geometry.m_coordinates.empty() )
+    {
+      m_buffer.append( reinterpret_cast< const char* >( &geometry.m_coordinates[0] ), (int)(geometry.m_coordinates.size() * sizeof(double)) );
+    }
+  }
+
+  appendValue( m_buffer, (quint32)placemark.m_attributes.size() );
+  for( size_t i = 0; i < placemark.m_attributes.size(); ++i )
+  {
+    writeString( placemark.m_attributes[i].first );
+    writeString( placemark.m_attributes[i].second );
+  }
+
+  ++m_numPlacemarks;
+  if( m_buffer.size() >= writeBufferSize )
+  {
+    flushBuffer();
+  }
+}
+
+bool KMLFeatureCacheWriter::commit(const std::vector< KMLFolder >& folders)
+{
+  flushBuffer();
+  quint64 foldersOffset = (quint64)m_file.pos();
+
+  for( size_t i = 0; i < folders.size(); ++i )
+  {
+    writeString( folders[i].m_name );
+    appendValue( m_buffer, (qint32)folders[i].m_parent );
+  }
+  flushBuffer();
+  quint64 fileSize = (quint64)m_file.pos();
+
+  appendValue( m_buffer, cacheMagic );
+  appendValue( m_buffer, cacheVersion );
+  appendValue( m_buffer, cacheByteOrder );
+  m_buffer.append( m_sourceHash );
+  appendValue( m_buffer, (quint32)folders.size() );
+  appendValue( m_buffer, m_numPlacemarks );
+  appendValue( m_buffer, foldersOffset );
+  appendValue( m_buffer, fileSize );
+  if( !m_file.seek( 0 ) )
+  {
+    m_file.cancelWriting();
+    return false;
+  }
+  flushBuffer();
+
+  if( !m_file.commit() )
+  {
+    return false;
+  }
+
+  // Keep the cache directory from growing without limit
+  QDir cacheDirectory( m_directory );
+  QStringList cacheFiles = cacheDirectory.entryList( QStringList( QString( "*" ) + cacheFileSuffix ), QDir::Files, QDir::Time );
+  for( int i = maxCacheFiles; i < cacheFiles.size(); ++i )
+  {
+    cacheDirectory.remove( cacheFiles[i] );
+  }
+  return true;
+}
+
+void KMLFeatureCacheWriter::writeString(const QString& value)
+{
+  // UTF-16, so that the string can be copied straight out of the cache file
+  appendValue( m_buffer, (quint32)value.size() );
+  m_buffer.append( reinterpret_cast< const char* >( value.constData() ), value.size() * (int)sizeof(QChar) );
+}
+
+void KMLFeatureCacheWriter::flushBuffer()
+{
+  if( !m_buffer.isEmpty() )
+  {
+    // A failed write is remembered by the file, and stops it being committed
+    m_file.write( m_buffer );
+    m_buffer.clear();
+  }
+}
+
+KMLFeatureCacheReader::KMLFeatureCacheReader()
+  : m_data( NULL )
+  , m_size( 0 )
+  , m_position( 0 )
+  , m_limit( 0 )
+  , m_numPlacemarks( 0 )
+  , m_numPlacemarksRead( 0 )
+{
+}
+
+KMLFeatureCacheReader::~KMLFeatureCacheReader()
+{
+  if( m_data )
+  {
+    m_file.unmap( const_cast< uchar* >( m_data ) );
+  }
+}
+
+bool KMLFeatureCacheReader::open(const QString& directory, const QByteArray& sourceStamp)
+{
+  m_file.setFileName( cacheFilename( directory, sourceStamp ) );
+  if( !m_file.open( QIODevice::ReadOnly ) )
+  {
+    return false;
+  }
+
+  m_size = m_file.size();
+  m_limit = m_size;
+  if( m_size < headerSize )
+  {
+    return false;
+  }
+  m_data = m_file.map( 0, m_size );
+  if( !m_data )
+  {
+    return false;
+  }
+
+  quint32 magic = 0, version = 0, byteOrder = 0, numFolders = 0;
+  quint64 foldersOffset = 0, fileSize = 0;
+  char hash[hashSize];
+  readBytes( &magic, sizeof(magic) );
+  readBytes( &version, sizeof(version) );
+  readBytes( &byteOrder, sizeof(byteOrder) );
+  // The hash of the contents is only needed to find the cache file of a copy of the KML file
+  readBytes( hash, hashSize );
+  readBytes( &numFolders, sizeof(numFolders) );
+  readBytes( &m_numPlacemarks, sizeof(m_numPlacemarks) );
+  readBytes( &foldersOffset, sizeof(foldersOffset) );
+  readBytes( &fileSize, sizeof(fileSize) );
+
+  // A cache file whose header doesn't match was written by another version of the sample, or
+  // was never completed
+  if( magic != cacheMagic || version != cacheVersion || byteOrder != cacheByteOrder ||
+      fileSize != (quint64)m_size || foldersOffset < (quint64)headerSize || foldersOffset > fileSize ||
+      (quint64)numFolders * 2 * sizeof(quint32) > fileSize - foldersOffset )
+  {
+    return false;
+  }
+
+  // Read the folders, so that they can be handed over before the placemarks in them
+  qint64 placemarksStart = m_position;
+  m_position = (qint64)foldersOffset;
+  m_folders.resize( numFolders );
+  for( quint32 i = 0; i < numFolders; ++i )
+  {
+    qint32 parent = -1;
+    if( !readString( m_folders[i].m_name ) || !readBytes( &parent, sizeof(parent) ) || parent < -1 || parent >= (qint32)i )
+    {
+      m_folders.clear();
+      return false;
+    }
+    m_folders[i].m_parent = parent;
+  }
+
+  // Placemarks can't run into the folders that follow them
+  m_limit = (qint64)foldersOffset;
+  m_position = placemarksStart;
+  return true;
+}
+
+bool KMLFeatureCacheReader::openMatching(const QString& directory, const QByteArray& sourceStamp, const QByteArray& sourceHash)
+{
+  if( sourceHash.size() != hashSize )
+  {
+    return false;
+  }
+
+  // Only the headers are read, and there are never more than a few cache files
+  QDir cacheDirectory( directory );
+  QStringList cacheFiles = cacheDirectory.entryList( QStringList( QString( "*" ) + cacheFileSuffix ), QDir::Files );
+  for( int i = 0; i < cacheFiles.size(); ++i )
+  {
+    QFile candidate( cacheDirectory.filePath( cacheFiles[i] ) );
+    if( !candidate.open( QIODevice::ReadOnly ) )
+    {
+      continue;
+    }
+    QByteArray header = candidate.read( headerSize );
+    candidate.close();
+
+    quint32 magic = 0, version = 0;
+    if( header.size() != headerSize )
+    {
+      continue;
+    }
+    memcpy( &magic, header.constData(), sizeof(magic) );
+    memcpy( &version, header.constData() + sizeof(magic), sizeof(version) );
+    if( magic != cacheMagic || version != cacheVersion || header.mid( (int)hashOffset, hashSize ) != sourceHash )
+    {
+      continue;
+    }
+
+    // The cache file is now found from this KML file's stamp. Another copy of the file finds it again the same way.
+    QString filename = cacheFilename( directory, sourceStamp );
+    if( candidate.fileName() != filename )
+    {
+      QFile::remove( filename );
+      if( !candidate.rename( filename ) )
+      {
+        return false;
+      }
+    }
+    return open( directory, sourceStamp );
+  }
+  return false;
+}
+
+const std::vector< KMLFolder >& KMLFeatureCacheReader::folders() const
+{
+  return m_folders;
+}
+
+bool KMLFeatureCacheReader::readPlacemark(KMLPlacemark& placemark)
+{
+  if( atEnd() )
+  {
+    return false;
+  }
+
+  qint32 folder = -1;
+  quint32 numGeometries = 0;
+  if( !readString( placemark.m_name ) || !readBytes( &folder, sizeof(folder) ) || folder < -1 || folder >= (qint32)m_folders.size() ||
+      !readBytes( &numGeometries, sizeof(numGeometries) ) || (quint64)numGeometries * 2 * sizeof(quint32) > (quint64)(m_limit - m_position) )
+  {
+    return false;
+  }
+  placemark.m_folder = folder;
+
+  placemark.m_geometries.resize( numGeometries );
+  for( quint32 i = 0; i < numGeometries; ++i )
+  {
+    KMLPlacemark::Geometry& geometry = placemark.m_geometries[i];
+    quint32 type = 0, numCoordinates = 0;
+    if( !readBytes( &type, sizeof(type) ) || type > KMLPlacemark::Polygon || !readBytes( &numCoordinates, sizeof(numCoordinates) ) ||
+        (quint64)numCoordinates * sizeof(double) > (quint64)(m_limit - m_position) )
+    {
+      return false;
+    }
+    geometry.m_type = (KMLPlacemark::GeometryType)type;
+    geometry.m_coordinates.resize( numCoordinates );
+    if( numCoordinates > 0 )
+    {
+      readBytes( &geometry.m_coordinates[0], numCoordinates * sizeof(double) );
+    }
+  }
+
+  quint32 numAttributes = 0;
+  if( !readBytes( &numAttributes, sizeof(numAttributes) ) || (quint64)numAttributes * 2 * sizeof(quint32) > (quint64)(m_limit - m_position) )
+  {
+    return false;
+  }
+  placemark.m_attributes.resize( numAttributes );
+  for( quint32 i = 0; i < numAttributes; ++i )
+  {
+    if( !readString( placemark.m_attributes[i].first ) || !readString( placemark.m_attributes[i].second ) )
+    {
+      return false;
+    }
+  }
+
+  ++m_numPlacemarksRead;
+  return true;
+}
+
+bool KMLFeatureCacheReader::atEnd() const
+{
+  return m_numPlacemarksRead >= m_numPlacemarks;
+}
+
+int KMLFeatureCacheReader::progress() const
+{
+  return m_size > 0 ? (int)(m_position * 100 / m_size) : 100;
+}
+
+void KMLFeatureCacheReader::remove()
+{
+  if( m_data )
+  {
+    m_file.unmap( const_cast< uchar* >( m_data ) );
+    m_data = NULL;
+  }
+  m_file.close();
+  m_file.remove();
+}
+
+bool KMLFeatureCacheReader::readBytes(void* value, size_t size)
+{
+  if( (qint64)size > m_limit - m_position )
+  {
+    return false;
+  }
+
+  // Copied, as values in the cache file are not aligned
+  memcpy( value, m_data + m_position, size );
+  m_position += (qint64)size;
+  return true;
+}
+
+bool KMLFeatureCacheReader::readString(QString& value)
+{
+  quint32 length = 0;
+  if( !readBytes( &length, sizeof(length) ) || (quint64)length * sizeof(QChar) > (quint64)(m_limit - m_position) )
+  {
+    return false;
+  }
+
+  value.resize( (int)length );
+  return length == 0 || readBytes( value.data(), length * sizeof(QChar) );
+}
+
+// Reads the whole of a KML file, through the cache if a directory is given
+static bool readAllFeatures(const QString& filename, const QString& cacheDirectory, std::vector< KMLFolder >& folders,
+                            std::vector< KMLPlacemark >& placemarks, bool& fromCache, qint64& readTime, QString& error)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  KMLFeatureReader reader;
+  reader.setCacheDirectory( cacheDirectory );
+  reader.read( filename );
+  reader.wait();
+  readTime = timer.elapsed();
+
+  reader.takeRead( std::numeric_limits< size_t >::max(), folders, placemarks );
+  fromCache = reader.readFromCache();
+  error = reader.errorString();
+  return error.isEmpty();
+}
+
+static QString describePlacemark(size_t index, const KMLPlacemark& placemark)
+{
+  return QString( "placemark %1 (%2)" ).arg( index ).arg( placemark.m_name );
+}
+
+// Describes the first difference between two sets of features, if there is one
+static bool compareFeatures(const std::vector< KMLFolder >& expectedFolders, const std::vector< KMLPlacemark >& expectedPlacemarks,
+                            const std::vector< KMLFolder >& folders, const std::vector< KMLPlacemark >& placemarks, QString& difference)
+{
+  if( folders.size() != expectedFolders.size() )
+  {
+    difference = QString( "%1 folders instead of %2" ).arg( folders.size() ).arg( expectedFolders.size() );
+    return false;
+  }
+  for( size_t i = 0; i < folders.size(); ++i )
+  {
+    if( folders[i].m_name != expectedFolders[i].m_name || folders[i].m_parent != expectedFolders[i].m_parent )
+    {
+      difference = QString( "folder %1 (%2) differs" ).arg( i ).arg( expectedFolders[i].m_name );
+      return false;
+    }
+  }
+
+  if( placemarks.size() != expectedPlacemarks.size() )
+  {
+    difference = QString( "%1 placemarks instead of %2" ).arg( placemarks.size() ).arg( expectedPlacemarks.size() );
+    return false;
+  }
+  for( size_t i = 0; i < placemarks.size(); ++i )
+  {
+    const KMLPlacemark& placemark = placemarks[i];
+    const KMLPlacemark& expected = expectedPlacemarks[i];
+    if( placemark.m_name != expected.m_name || placemark.m_folder != expected.m_folder )
+    {
+      difference = describePlacemark( i, expected ) + " has a different name or folder";
+      return false;
+    }
+    if( placemark.m_attributes != expected.m_attributes )
+    {
+      difference = describePlacemark( i, expected ) + " has different attributes";
+      return false;
+    }
+    if( placemark.m_geometries.size() != expected.m_geometries.size() )
+    {
+      difference = describePlacemark( i, expected ) + " has a different number of geometries";
+      return false;
+    }
+    for( size_t j = 0; j < placemark.m_geometries.size(); ++j )
+    {
+      // Coordinates are stored as they were read, so they must be identical
+      if( placemark.m_geometries[j].m_type != expected.m_geometries[j].m_type ||
+          placemark.m_geometries[j].m_coordinates != expected.m_geometries[j].m_coordinates )
+      {
+        difference = describePlacemark( i, expected ) + QString( " geometry %1 differs" ).arg( j );
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool verifyKMLCache(const QString& filename, QString& report)
+{
+  QTemporaryDir cacheDirectory;
+  if( !cacheDirectory.isValid() )
+  {
+    report = "Unable to create a temporary cache directory";
+    return false;
+  }
+
+  std::vector< KMLFolder > freshFolders, writtenFolders, cachedFolders;
+  std::vector< KMLPlacemark > freshPlacemarks, writtenPlacemarks, cachedPlacemarks;
+  bool fromCache = false;
+  qint64 freshTime = 0, writeTime = 0, cachedTime = 0;
+  QString error;
+
+  if( !readAllFeatures( filename, QString(), freshFolders, freshPlacemarks, fromCache, freshTime, error ) )
+  {
+    report = QString( "Failed to read %1: %2" ).arg( filename ).arg( error );
+    return false;
+  }
+  report = QString( "Read %1 placemarks in %2 folders without the cache in %3 ms\n" )
+    .arg( freshPlacemarks.size() ).arg( freshFolders.size() ).arg( freshTime );
+
+  // The cache is empty, so this parses the file and writes the cache
+  readAllFeatures( filename, cacheDirectory.path(), writtenFolders, writtenPlacemarks, fromCache, writeTime, error );
+  report += QString( "Read and cached in %1 ms\n" ).arg( writeTime );
+  writtenFolders.clear();
+  writtenPlacemarks.clear();
+
+  readAllFeatures( filename, cacheDirectory.path(), cachedFolders, cachedPlacemarks, fromCache, cachedTime, error );
+  if( !fromCache )
+  {
+    report += "The cache was not used when the file was read again";
+    return false;
+  }
+  report += QString( "Read from the cache in %1 ms\n" ).arg( cachedTime );
+
+  QString difference;
+  if( !compareFeatures( freshFolders, freshPlacemarks, cachedFolders, cachedPlacemarks, difference ) )
+  {
+    report += "The cached features differ: " + difference;
+    return false;
+  }
+  report += "The cached features are identical";
+  return true;
+}
@@ -0,0 +1,121 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef KMLFEATURECACHE_H
+#define KMLFEATURECACHE_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+
+#include "kmlfeaturereader.h"
+
+class QFileInfo;
+class QIODevice;
+
+// A cache on disk of the folders and placemarks read from KML files, so that the placemarks shown
+// while a file's KML data layer loads don't need its XML to be parsed again. The cache only feeds
+// the preview: the KML data layer always parses the file itself.
+//
+// Each file's features are kept in their own cache file, named from a stamp of the KML file's path,
+// size and modification time, so a file that has been read before is found without reading it. The
+// cache file also holds a SHA-1 hash of the contents it was written from. When no cache file has the
+// stamp, the file is hashed, and a cache file written from the same contents under another stamp -
+// a copy of the file, or one that has only been touched - is taken over rather than parsing the file.
+// A file rewritten without changing its size or modification time isn't noticed.
+//
+// Cache files are written in the byte order of the machine and start with a version number - a file
+// of another version is not used, and is replaced the next time its KML file is read. Only the most
+// recently written cache files are kept.
+
+// Returns the stamp identifying a KML file by its path, size and modification time
+QByteArray stampKMLFile(const QFileInfo& file);
+
+// Returns the hash identifying the contents of a KML file, reading it from the current position to the end
+QByteArray hashKMLFile(QIODevice& file);
+
+// Removes every cache file in the directory
+void clearKMLCache(const QString& directory);
+
+// Reads the KML file without the cache, then writes and reads its cache in a temporary directory,
+// and compares the features from each. The timing of each read and any difference is described
+// in report. Returns true if the cached features are identical to the ones read from the file.
+bool verifyKMLCache(const QString& filename, QString& report);
+
+// Writes the features of a KML file to a new cache file as they are read
+class KMLFeatureCacheWriter
+{
+public:
+  KMLFeatureCacheWriter();
+
+  // Start a cache file for the KML file with the given stamp and hash. Returns false if it can't be created.
+  bool open(const QString& directory, const QByteArray& sourceStamp, const QByteArray& sourceHash);
+
+  void writePlacemark(const KMLPlacemark& placemark);
+
+  // Write the folders and replace any previous cache file for the same KML file. If this isn't
+  // called the new cache file is discarded.
+  bool commit(const std::vector< KMLFolder >& folders);
+
+private:
+  void writeString(const QString& value);
+  void flushBuffer();
+
+  QString m_directory;
+  QByteArray m_sourceHash;
+  QSaveFile m_file;
+  QByteArray m_buffer;
+  quint32 m_numPlacemarks;
+};
+
+// Reads the features of a KML file from its cache file, which is memory mapped rather than read
+class KMLFeatureCacheReader
+{
+public:
+  KMLFeatureCacheReader();
+  ~KMLFeatureCacheReader();
+
+  // Map the cache file of the KML file with the given stamp and read its folders. Returns false
+  // if there is no cache file, or it is of a different version or incomplete.
+  bool open(const QString& directory, const QByteArray& sourceStamp);
+
+  // Find a cache file written from the same contents as the KML file with the given stamp and hash,
+  // and open it, renamed to the stamp. Returns false if there is none.
+  bool openMatching(const QString& directory, const QByteArray& sourceStamp, const QByteArray& sourceHash);
+
+  const std::vector< KMLFolder >& folders() const;
+
+  // Read the next placemark. Returns false once all the placemarks have been read, or if the
+  // rest of the cache file can't be read.
+  bool readPlacemark(KMLPlacemark& placemark);
+
+  // Returns true once every placemark has been read
+  bool atEnd() const;
+
+  // The percentage of the cache file read so far
+  int progress() const;
+
+  // Removes the cache file, when it has been found to be damaged
+  void remove();
+
+private:
+  bool readBytes(void* value, size_t size);
+  bool readString(QString& value);
+
+  QFile m_file;
+  const uchar* m_data;
+  qint64 m_size;
+  qint64 m_position;
+
+  // The end of the part of the file being read
+  qint64 m_limit;
+  quint32 m_numPlacemarks;
+  quint32 m_numPlacemarksRead;
+  std::vector< KMLFolder > m_folders;
+};
+
+#endif
@@ -0,0 +1,411 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "kmlfeaturereader.h"
+#include "kmlfeaturecache.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QXmlStreamReader>
+
+// The number of placemarks read before they are handed to the application, unless a folder ends first
+static const size_t publishBatch = 500;
+
+KMLFeatureReader::KMLFeatureReader()
+  : m_numFoldersPublished( 0 )
+  , m_progress( 0 )
+  , m_finished( false )
+  , m_fromCache( false )
+  , m_stop( false )
+{
+}
+
+KMLFeatureReader::~KMLFeatureReader()
+{
+  stop();
+}
+
+void KMLFeatureReader::setCacheDirectory(const QString& directory)
+{
+  m_cacheDirectory = directory;
+}
+
+void KMLFeatureReader::read(const QString& filename)
+{
+  m_filename = filename;
+  start( QThread::LowPriority );
+}
+
+size_t KMLFeatureReader::takeRead(size_t maxPlacemarks, std::vector< KMLFolder >& folders, std::vector< KMLPlacemark >& placemarks)
+{
+  QMutexLocker lock( &m_mutex );
+  folders.insert( folders.end(), m_readFolders.begin(), m_readFolders.end() );
+  m_readFolders.clear();
+
+  size_t numTaken = 0;
+  while( numTaken < maxPlacemarks && !m_readPlacemarks.empty() )
+  {
+    placemarks.push_back( KMLPlacemark() );
+    placemarks.back().swap( m_readPlacemarks.front() );
+    m_readPlacemarks.pop_front();
+    ++numTaken;
+  }
+  return numTaken;
+}
+
+int KMLFeatureReader::progress() const
+{
+  QMutexLocker lock( &m_mutex );
+  return m_progress;
+}
+
+bool KMLFeatureReader::done() const
+{
+  QMutexLocker lock( &m_mutex );
+  return m_finished && m_readFolders.empty() && m_readPlacemarks.empty();
+}
+
+QString KMLFeatureReader::errorString() const
+{
+  QMutexLocker lock( &m_mutex );
+  return m_error;
+}
+
+bool KMLFeatureReader::readFromCache() const
+{
+  QMutexLocker lock( &m_mutex );
+  return m_fromCache;
+}
+
+void KMLFeatureReader::stop()
+{
+  {
+    QMutexLocker lock( &m_mutex );
+    m_stop = true;
+    m_readFolders.clear();
+    m_readPlacemarks.clear();
+  }
+  wait();
+}
+
+bool KMLFeatureReader::stopping() const
+{
+  return m_stop;
+}
+
+void KMLFeatureReader::run()
+{
+  QFile file( m_filename );
+  if( !file.open( QIODevice::ReadOnly ) )
+  {
+    QMutexLocker lock( &m_mutex );
+    m_error = file.errorString();
+    m_finished = true;
+    return;
+  }
+
+  // The cache is checked first. Finding it by the file's stamp doesn't read the file, and hashing
+  // the file when that fails is still much quicker than parsing it.
+  QByteArray sourceStamp, sourceHash;
+  if( !m_cacheDirectory.isEmpty() )
+  {
+    sourceStamp = stampKMLFile( QFileInfo( file ) );
+    KMLFeatureCacheReader cache;
+    if( cache.open( m_cacheDirectory, sourceStamp ) )
+    {
+      readCache( cache );
+      return;
+    }
+
+    sourceHash = hashKMLFile( file );
+    KMLFeatureCacheReader matchingCache;
+    if( !stopping() && matchingCache.openMatching( m_cacheDirectory, sourceStamp, sourceHash ) )
+    {
+      readCache( matchingCache );
+      return;
+    }
+    file.seek( 0 );
+  }
+  KMLFeatureCacheWriter cacheWriter;
+  bool writeCache = !sourceHash.isEmpty() && cacheWriter.open( m_cacheDirectory, sourceStamp, sourceHash );
+
+  qint64 fileSize = file.size();
+  QXmlStreamReader reader( &file );
+
+  // The folders the reader is in, and the element depth each started at, so that only
+  // a folder's own name is taken as its name
+  std::vector< int > openFolders;
+  std::vector< int > openFolderDepths;
+  int depth = 0;
+
+  while( !reader.atEnd() && !stopping() )
+  {
+    QXmlStreamReader::TokenType token = reader.readNext();
+    if( token == QXmlStreamReader::StartElement )
+    {
+      ++depth;
+      QStringRef name = reader.name();
+      if( name == QLatin1String( "Document" ) || name == QLatin1String( "Folder" ) )
+      {
+        KMLFolder folder;
+        folder.m_parent = openFolders.empty() ? -1 : openFolders.back();
+        m_folders.push_back( folder );
+        openFolders.push_back( (int)m_folders.size() - 1 );
+        openFolderDepths.push_back( depth );
+      }
+      else if( name == QLatin1String( "name" ) && !openFolders.empty() && depth == openFolderDepths.back() + 1 )
+      {
+        m_folders[openFolders.back()].m_name = reader.readElementText();
+        --depth;
+      }
+      else if( name == QLatin1String( "Placemark" ) )
+      {
+        m_unpublished.push_back( KMLPlacemark() );
+        m_unpublished.back().m_folder = openFolders.empty() ? -1 : openFolders.back();
+        readPlacemark( reader, m_unpublished.back() );
+        --depth;
+
+        if( writeCache )
+        {
+          cacheWriter.writePlacemark( m_unpublished.back() );
+        }
+
+        if( m_unpublished.size() >= publishBatch )
+        {
+          publish( (int)(fileSize > 0 ? file.pos() * 100 / fileSize : 0) );
+        }
+      }
+    }
+    else if( token == QXmlStreamReader::EndElement )
+    {
+      if( !openFolders.empty() && depth == openFolderDepths.back() )
+      {
+        // Hand over a completed folder straight away
+        openFolders.pop_back();
+        openFolderDepths.pop_back();
+        publish( (int)(fileSize > 0 ? file.pos() * 100 / fileSize : 0) );
+      }
+      --depth;
+    }
+  }
+
+  publish( 100 );
+
+  // Only a document that was read completely is cached
+  if( writeCache && !reader.hasError() && !stopping() )
+  {
+    cacheWriter.commit( m_folders );
+  }
+
+  QMutexLocker lock( &m_mutex );
+  if( reader.hasError() )
+  {
+    m_error = QString( "Error at line %1, column %2: %3" )
+      .arg( reader.lineNumber() ).arg( reader.columnNumber() ).arg( reader.errorString() );
+  }
+  m_finished = true;
+}
+
+void KMLFeatureReader::readCache(KMLFeatureCacheReader& cache)
+{
+  m_folders = cache.folders();
+  while( !cache.atEnd() && !stopping() )
+  {
+    m_unpublished.push_back( KMLPlacemark() );
+    if( !cache.readPlacemark( m_unpublished.back() ) )
+    {
+      // Some of the features may already have been shown, so the file isn't parsed instead.
+      // The damaged cache file is replaced the next time the file is read.
+      m_unpublished.pop_back();
+      cache.remove();
+      publish( 100 );
+
+      QMutexLocker lock( &m_mutex );
+      m_error = "The feature cache of the file is damaged";
+      m_finished = true;
+      return;
+    }
+
+    if( m_unpublished.size() >= publishBatch )
+    {
+      publish( cache.progress() );
+    }
+  }
+  publish( 100 );
+
+  QMutexLocker lock( &m_mutex );
+  m_fromCache = true;
+  m_finished = true;
+}
+
+void KMLFeatureReader::readPlacemark(QXmlStreamReader& reader, KMLPlacemark& placemark)
+{
+  // A placemark can hold a great deal of geometry, so a stopped read leaves it unfinished
+  while( !stopping() && reader.readNextStartElement() )
+  {
+    QStringRef name = reader.name();
+    if( name == QLatin1String( "name" ) )
+    {
+      placemark.m_name = reader.readElementText();
+    }
+    else if( name == QLatin1String( "Point" ) || name == QLatin1String( "LineString" ) ||
+             name == QLatin1String( "LinearRing" ) || name == QLatin1String( "Polygon" ) ||
+             name == QLatin1String( "MultiGeometry" ) )
+    {
+      readGeometry( reader, placemark );
+    }
+    else if( name == QLatin1String( "description" ) )
+    {
+      placemark.m_attributes.push_back( std::make_pair( name.toString(), reader.readElementText() ) );
+    }
+    else if( name == QLatin1String( "ExtendedData" ) )
+    {
+      readExtendedData( reader, placemark );
+    }
+    else
+    {
+      reader.skipCurrentElement();
+    }
+  }
+}
+
+void KMLFeatureReader::readExtendedData(QXmlStreamReader& reader, KMLPlacemark& placemark)
+{
+  while( reader.readNextStartElement() )
+  {
+    QStringRef name = reader.name();
+    if( name == QLatin1String( "Data" ) )
+    {
+      // <Data name="..."><value>...</value></Data>
+      QString dataName = reader.attributes().value( QLatin1String( "name" ) ).toString();
+      QString value;
+      while( reader.readNextStartElement() )
+      {
+        if( reader.name() == QLatin1String( "value" ) )
+        {
+          value = reader.readElementText();
+        }
+        else
+        {
+          reader.skipCurrentElement();
+        }
+      }
+      placemark.m_attributes.push_back( std::make_pair( dataName, value ) );
+    }
+    else if( name == QLatin1String( "SchemaData" ) )
+    {
+      readExtendedData( reader, placemark );
+    }
+    else if( name == QLatin1String( "SimpleData" ) )
+    {
+      QString dataName = reader.attributes().value( QLatin1String( "name" ) ).toString();
+      placemark.m_attributes.push_back( std::make_pair( dataName, reader.readElementText() ) );
+    }
+    else
+    {
+      reader.skipCurrentElement();
+    }
+  }
+}
+
+void KMLFeatureReader::readGeometry(QXmlStreamReader& reader, KMLPlacemark& placemark)
+{
+  QStringRef name = reader.name();
+  if( name == QLatin1String( "MultiGeometry" ) )
+  {
+    while( !stopping() && reader.readNextStartElement() )
+    {
+      readGeometry( reader, placemark );
+    }
+    return;
+  }
+
+  KMLPlacemark::Geometry geometry;
+  if( name == QLatin1String( "Point" ) )
+  {
+    geometry.m_type = KMLPlacemark::Point;
+  }
+  else if( name == QLatin1String( "LineString" ) || name == QLatin1String( "LinearRing" ) )
+  {
+    geometry.m_type = KMLPlacemark::LineString;
+  }
+  else if( name == QLatin1String( "Polygon" ) )
+  {
+    geometry.m_type = KMLPlacemark::Polygon;
+  }
+  else
+  {
+    // Models, tracks and other geometry aren't shown while the document loads
+    reader.skipCurrentElement();
+    return;
+  }
+
+  readCoordinates( reader, geometry );
+
+  size_t minimumSize = geometry.m_type == KMLPlacemark::Point ? 2 : (geometry.m_type == KMLPlacemark::LineString ? 4 : 6);
+  if( geometry.m_coordinates.size() >= minimumSize )
+  {
+    placemark.m_geometries.push_back( KMLPlacemark::Geometry() );
+    placemark.m_geometries.back().m_type = geometry.m_type;
+    placemark.m_geometries.back().m_coordinates.swap( geometry.m_coordinates );
+  }
+}
+
+void KMLFeatureReader::readCoordinates(QXmlStreamReader& reader, KMLPlacemark::Geometry& geometry)
+{
+  while( reader.readNextStartElement() )
+  {
+    QStringRef name = reader.name();
+    if( name == QLatin1String( "coordinates" ) )
+    {
+      // Tuples of longitude, latitude and an optional altitude, separated by white space
+      QStringList tuples = reader.readElementText().simplified().split( ' ', QString::SkipEmptyParts );
+      geometry.m_coordinates.reserve( tuples.size() * 2 );
+      for( int i = 0; i < tuples.size(); ++i )
+      {
+        QStringList values = tuples[i].split( ',' );
+        bool validLongitude = false, validLatitude = false;
+        double longitude = values[0].toDouble( &validLongitude );
+        double latitude = values.size() > 1 ? values[1].toDouble( &validLatitude ) : 0.0;
+        if( validLongitude && validLatitude )
+        {
+          geometry.m_coordinates.push_back( longitude );
+          geometry.m_coordinates.push_back( latitude );
+        }
+      }
+    }
+    else if( name == QLatin1String( "outerBoundaryIs" ) || name == QLatin1String( "LinearRing" ) )
+    {
+      readCoordinates( reader, geometry );
+    }
+    else
+    {
+      // Holes in polygons are left out
+      reader.skipCurrentElement();
+    }
+  }
+}
+
+void KMLFeatureReader::publish(int progress)
+{
+  QMutexLocker lock( &m_mutex );
+  if( m_stop )
+  {
+    m_unpublished.clear();
+    return;
+  }
+
+  m_readFolders.insert( m_readFolders.end(), m_folders.begin() + m_numFoldersPublished, m_folders.end() );
+  m_numFoldersPublished = m_folders.size();
+
+  for( size_t i = 0; i < m_unpublished.size(); ++i )
+  {
+    m_readPlacemarks.push_back( KMLPlacemark() );
+    m_readPlacemarks.back().swap( m_unpublished[i] );
+  }
+  m_unpublished.clear();
+  m_progress = progress;
+}
@@ -0,0 +1,159 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef KMLFEATUREREADER_H
+#define KMLFEATUREREADER_H
+
+#include <atomic>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+class KMLFeatureCacheReader;
+class QXmlStreamReader;
+
+// A folder or document of a KML file. Folders are numbered in the order they start in the file.
+struct KMLFolder
+{
+  QString m_name;
+
+  // The folder holding this one, or -1 for a top level folder
+  int m_parent;
+};
+
+// A placemark of a KML file, with its geometry in longitude and latitude
+struct KMLPlacemark
+{
+  enum GeometryType
+  {
+    Point,
+    LineString,
+    Polygon
+  };
+
+  struct Geometry
+  {
+    GeometryType m_type;
+
+    // Longitude and latitude pairs. Polygons hold their outer boundary.
+    std::vector< double > m_coordinates;
+  };
+
+  KMLPlacemark();
+
+  // Exchange the contents of two placemarks without copying their geometry
+  void swap(KMLPlacemark& other);
+
+  QString m_name;
+
+  // The folder holding the placemark, or -1 if it is not in a folder
+  int m_folder;
+
+  // The parts of the placemark's geometry - more than one if it is a MultiGeometry
+  std::vector< Geometry > m_geometries;
+
+  // The description and extended data of the placemark as name and value pairs, in document order
+  std::vector< std::pair< QString, QString > > m_attributes;
+};
+
+inline KMLPlacemark::KMLPlacemark()
+  : m_folder( -1 )
+{
+}
+
+inline void KMLPlacemark::swap(KMLPlacemark& other)
+{
+  m_name.swap( other.m_name );
+  std::swap( m_folder, other.m_folder );
+  m_geometries.swap( other.m_geometries );
+  m_attributes.swap( other.m_attributes );
+}
+
+// Reads the folders and placemarks of a KML file in a background thread.
+//
+// The TSLKMLDataLayer reads the whole document before any of it can be drawn, so while it loads
+// the application shows the placemarks read here. The data layer parses the file itself whether or
+// not the placemarks come from the cache. Placemarks are handed over in batches, and when
+// a folder ends, so that the application can show them as they are read without waiting for the
+// rest of the file. Only uncompressed KML can be read - KMZ files are zip archives.
+//
+// If a cache directory is given, the features of a file that has been read before are read from
+// its cache file instead of parsing the KML, and the cache file is written when a file is parsed.
+// The cache file is looked for by the file's size and modification time first, and only if that
+// finds nothing is the file hashed to look for one written from the same contents.
+class KMLFeatureReader : public QThread
+{
+public:
+  KMLFeatureReader();
+  ~KMLFeatureReader();
+
+  // The directory of the feature cache, or an empty string to always parse the KML.
+  // Must be set before reading starts.
+  void setCacheDirectory(const QString& directory);
+
+  // Start reading the file
+  void read(const QString& filename);
+
+  // Move the folders read since the last call to the end of folders, and up to maxPlacemarks placemarks
+  // to the end of placemarks, in the order they were read. Returns the number of placemarks moved.
+  size_t takeRead(size_t maxPlacemarks, std::vector< KMLFolder >& folders, std::vector< KMLPlacemark >& placemarks);
+
+  // The percentage of the file read so far
+  int progress() const;
+
+  // Returns true once the whole file has been read and taken, or reading failed
+  bool done() const;
+
+  // A description of the problem if the file could not be read
+  QString errorString() const;
+
+  // Returns true if the features were read from the cache rather than the KML file
+  bool readFromCache() const;
+
+  // Stop the thread, dropping anything not yet taken. The reader checks between elements, so a
+  // superseded read stops without parsing the rest of the file.
+  void stop();
+
+protected:
+  virtual void run();
+
+private:
+  void readPlacemark(QXmlStreamReader& reader, KMLPlacemark& placemark);
+  void readGeometry(QXmlStreamReader& reader, KMLPlacemark& placemark);
+  void readCoordinates(QXmlStreamReader& reader, KMLPlacemark::Geometry& geometry);
+  void readExtendedData(QXmlStreamReader& reader, KMLPlacemark& placemark);
+
+  // Read the features from an open cache file
+  void readCache(KMLFeatureCacheReader& cache);
+
+  // Hand the folders and placemarks read since the last call to the application
+  void publish(int progress);
+  bool stopping() const;
+
+  QString m_filename;
+  QString m_cacheDirectory;
+
+  // Only used by the reader thread
+  std::vector< KMLFolder > m_folders;
+  size_t m_numFoldersPublished;
+  std::vector< KMLPlacemark > m_unpublished;
+
+  // Guards the members below
+  mutable QMutex m_mutex;
+  std::vector< KMLFolder > m_readFolders;
+  std::deque< KMLPlacemark > m_readPlacemarks;
+  int m_progress;
+  bool m_finished;
+  bool m_fromCache;
+  QString m_error;
+
+  // Checked by the reader thread between elements, so it isn't guarded by the mutex
+  std::atomic< bool > m_stop;
+};
+
+#endif
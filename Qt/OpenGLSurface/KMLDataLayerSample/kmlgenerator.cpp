@@ -0,0 +1,113 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include "kmlgenerator.h"
+
+#include <QFile>
+#include <QTextStream>
+
+// The number of placemarks in each folder
+static const int placemarksPerFolder = 1000;
+
+// Every tenth placemark is a line and every twentieth a polygon, the rest are points
+static const int lineInterval = 10;
+static const int polygonInterval = 20;
+
+static void writeCoordinate(QTextStream& stream, double longitude, double latitude)
+{
+  stream << longitude << ',' << latitude << ",0 ";
+}
+
+bool generateKML(const QString& filename, int numPlacemarks, QString& error)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+  {
+    error = file.errorString();
+    return false;
+  }
+
+  QTextStream stream(&file);
+  stream.setCodec("UTF-8");
+  stream.setRealNumberNotation(QTextStream::FixedNotation);
+  stream.setRealNumberPrecision(5);
+
+  stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n"
+            "<Document>\n"
+            "<name>Generated placemarks</name>\n"
+            "<Style id=\"generated\"><LineStyle><color>ff00ffff</color><width>2</width></LineStyle>"
+            "<PolyStyle><color>8000ffff</color></PolyStyle></Style>\n";
+
+  // Lay the placemarks out on a grid covering the world between 80 degrees north and south
+  int columns = 1;
+  while (columns * columns / 2 < numPlacemarks)
+  {
+    ++columns;
+  }
+  int rows = (numPlacemarks + columns - 1) / columns;
+  double cellWidth = 360.0 / columns;
+  double cellHeight = 160.0 / (rows > 0 ? rows : 1);
+
+  for (int i = 0; i < numPlacemarks; ++i)
+  {
+    if (i % placemarksPerFolder == 0)
+    {
+      if (i > 0)
+      {
+        stream << "</Folder>\n";
+      }
+      stream << "<Folder><name>Folder " << i / placemarksPerFolder << "</name>\n";
+    }
+
+    double longitude = -180.0 + (i % columns + 0.5) * cellWidth;
+    double latitude = -80.0 + (i / columns + 0.5) * cellHeight;
+    double halfWidth = cellWidth * 0.4, halfHeight = cellHeight * 0.4;
+
+    stream << "<Placemark><name>Placemark " << i << "</name><styleUrl>#generated</styleUrl>"
+           << "<description>Generated placemark " << i << "</description>"
+           << "<ExtendedData><Data name=\"index\"><value>" << i << "</value></Data></ExtendedData>";
+    if (i % polygonInterval == 0)
+    {
+      stream << "<Polygon><outerBoundaryIs><LinearRing><coordinates>";
+      writeCoordinate(stream, longitude - halfWidth, latitude - halfHeight);
+      writeCoordinate(stream, longitude + halfWidth, latitude - halfHeight);
+      writeCoordinate(stream, longitude + halfWidth, latitude + halfHeight);
+      writeCoordinate(stream, longitude - halfWidth, latitude + halfHeight);
+      writeCoordinate(stream, longitude - halfWidth, latitude - halfHeight);
+      stream << "</coordinates></LinearRing></outerBoundaryIs></Polygon>";
+    }
+    else if (i % lineInterval == 0)
+    {
+      stream << "<LineString><coordinates>";
+      for (int j = 0; j < 5; ++j)
+      {
+        writeCoordinate(stream, longitude - halfWidth + j * halfWidth / 2.0, latitude + ((j % 2) ? halfHeight : -halfHeight));
+      }
+      stream << "</coordinates></LineString>";
+    }
+    else
+    {
+      stream << "<Point><coordinates>";
+      writeCoordinate(stream, longitude, latitude);
+      stream << "</coordinates></Point>";
+    }
+    stream << "</Placemark>\n";
+  }
+
+  if (numPlacemarks > 0)
+  {
+    stream << "</Folder>\n";
+  }
+  stream << "</Document>\n"
+            "</kml>\n";
+
+  stream.flush();
+  if (file.error() != QFile::NoError)
+  {
+    error = file.errorString();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,17 @@
+/****************************************************************************
+                Copyright (c) 2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef KMLGENERATOR_H
+#define KMLGENERATOR_H
+
+#include <QString>
+
+// Writes a KML document for measuring how long large files take to load. The placemarks are
+// spread evenly over the world in folders of 1000, and are mostly points with some lines and
+// polygons. The same number of placemarks always gives the same document.
+//
+// Returns false, with a description of the problem in error, if the file can't be written.
+bool generateKML(const QString& filename, int numPlacemarks, QString& error);
+
+#endif
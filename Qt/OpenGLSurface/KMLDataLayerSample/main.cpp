@@ -6,12 +6,15 @@ Copyright (c) 2017 by Envitia Group PLC.
 #include <QGLFormat>
 #include <QMessageBox>
 #include <stdlib.h>
+#include <iostream>
 #ifdef WIN32
 # include <direct.h>
 #else
 # include <unistd.h>
 #endif
 #include "mainwindow.h"
+#include "kmlgenerator.h"
+#include "kmlfeaturecache.h"
 #include "MapLink.h"
 
 
@@ -76,10 +79,21 @@ int main(int argc, char *argv[])
 
   QApplication application(argc, argv);
 
+  // Used for the location of the KML cache
+  application.setApplicationName( "KML Data Layer Sample" );
+  application.setOrganizationName( "Envitia" );
+
   // Parse the application's command line arguments
   QStringList argumentList = application.arguments();
   QString mapFilename;
   QString kmlFilename;
+  QString generateFilename;
+  int generateCount = 0;
+  bool benchmark = false;
+  bool preview = true;
+  bool cache = true;
+  bool clearCache = false;
+  QString verifyFilename;
   for( int i = 1; i < argumentList.size(); ++i )
   {
     if( argumentList[i].compare( "/help", Qt::CaseInsensitive ) == 0 ||
@@ -88,7 +102,13 @@ int main(int argc, char *argv[])
       QMessageBox::information( NULL, "Help",
                                 "Help:\n  KMLDataLayerSample /home path_to_install\t(The directory containing the config directory)"
                                 "     \n                     /map  filename\t(The base map to load)"
-                                "     \n                     /kml  filename\t(The .kml or .kmz file to load as an overlay)" );
+                                "     \n                     /kml  filename\t(The .kml or .kmz file to load as an overlay)"
+                                "     \n                     /nopreview\t(Don't show placemarks while the kml file loads)"
+                                "     \n                     /benchmark\t(Print the kml loading times and exit once loaded)"
+                                "     \n                     /generatekml filename count\t(Write a kml file with count placemarks and exit)"
+                                "     \n                     /nokmlcache\t(Don't cache what is read from kml files)"
+                                "     \n                     /clearkmlcache\t(Remove everything cached before loading the kml file)"
+                                "     \n                     /verifykmlcache filename\t(Check that the cached features of a .kml file match the file and exit)" );
       return 0;
     }
     else if( (argumentList[i].compare( "/home", Qt::CaseInsensitive ) == 0 ||
@@ -117,6 +137,62 @@ int main(int argc, char *argv[])
       kmlFilename = argumentList[i+1];
       ++i;
     }
+    else if( (argumentList[i].compare( "/generatekml", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-generatekml", Qt::CaseInsensitive ) == 0)
+             && i+2 < argumentList.size() )
+    {
+      generateFilename = argumentList[i+1];
+      generateCount = argumentList[i+2].toInt();
+      i += 2;
+    }
+    else if( argumentList[i].compare( "/benchmark", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-benchmark", Qt::CaseInsensitive ) == 0 )
+    {
+      benchmark = true;
+    }
+    else if( argumentList[i].compare( "/nopreview", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-nopreview", Qt::CaseInsensitive ) == 0 )
+    {
+      preview = false;
+    }
+    else if( argumentList[i].compare( "/nokmlcache", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-nokmlcache", Qt::CaseInsensitive ) == 0 )
+    {
+      cache = false;
+    }
+    else if( argumentList[i].compare( "/clearkmlcache", Qt::CaseInsensitive ) == 0 ||
+             argumentList[i].compare( "-clearkmlcache", Qt::CaseInsensitive ) == 0 )
+    {
+      clearCache = true;
+    }
+    else if( (argumentList[i].compare( "/verifykmlcache", Qt::CaseInsensitive ) == 0 ||
+              argumentList[i].compare( "-verifykmlcache", Qt::CaseInsensitive ) == 0)
+             && i+1 < argumentList.size() )
+    {
+      verifyFilename = argumentList[i+1];
+      ++i;
+    }
+  }
+
+  // Write a kml file for measuring load times, rather than showing the map
+  if( !generateFilename.isEmpty() )
+  {
+    QString error;
+    if( generateCount <= 0 || !generateKML( generateFilename, generateCount, error ) )
+    {
+      QMessageBox::critical( NULL, "Failed to generate kml file", generateCount <= 0 ? "The placemark count must be positive." : error );
+      return 1;
+    }
+    return 0;
+  }
+
+  // Compare the features read from a kml file with those read from its cache, rather than showing the map
+  if( !verifyFilename.isEmpty() )
+  {
+    QString report;
+    bool identical = verifyKMLCache( verifyFilename, report );
+    std::cout << report.toLocal8Bit().constData() << std::endl;
+    return identical ? 0 : 1;
   }
   
   // Qt will be creating the OpenGL context for us. In order for the drawing surface to
@@ -141,6 +217,13 @@ int main(int argc, char *argv[])
 
   // Show the application window
   MainWindow window;
+  window.setKMLPreview( preview );
+  window.setKMLBenchmark( benchmark );
+  window.setKMLCache( cache );
+  if( clearCache )
+  {
+    window.clearKMLCache();
+  }
   window.show();
 
   // if a map has been passed on the command line open it.
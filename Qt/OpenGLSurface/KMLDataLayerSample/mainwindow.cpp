@@ -7,9 +7,12 @@
 #include <QWidget>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QStatusBar>
 
 #include "mainwindow.h"
+#include "application.h"
 
+#include <iostream>
 #include <string>
 using namespace std;
 
@@ -18,6 +21,7 @@ using namespace std;
 
 MainWindow::MainWindow(QWidget *parent)
   : QMainWindow(parent)
+  , m_kmlBenchmark(false)
 {
   // Construct the window
   setupUi(this);
@@ -40,6 +44,14 @@ MainWindow::MainWindow(QWidget *parent)
   m_interactionModesGroup->addAction(actionZoom_Mode);
   m_interactionModesGroup->addAction(actionPan_Mode);
   m_interactionModesGroup->addAction(actionGrab_Mode);
+
+  // Show the progress of KML files loading in the background in the status bar
+  m_kmlProgress = new QProgressBar();
+  m_kmlProgress->setMaximumWidth(200);
+  m_kmlProgress->hide();
+  statusBar()->addPermanentWidget(m_kmlProgress);
+  connect(mapLinkWidget, SIGNAL(kmlLoadProgress(int)), this, SLOT(showKMLProgress(int)));
+  connect(mapLinkWidget, SIGNAL(kmlLoadFinished()), this, SLOT(kmlLoadFinished()));
 }
 
 MainWindow::~MainWindow()
@@ -58,6 +70,68 @@ void MainWindow::loadKML( const char *kmlToLoad)
   mapLinkWidget->loadKML( kmlToLoad, kmlAttributeTreeWidget );
 }
 
+void MainWindow::setKMLBenchmark( bool benchmark )
+{
+  m_kmlBenchmark = benchmark;
+}
+
+void MainWindow::setKMLPreview( bool preview )
+{
+  mapLinkWidget->setKMLPreview( preview );
+}
+
+void MainWindow::setKMLCache( bool cache )
+{
+  mapLinkWidget->setKMLCache( cache );
+}
+
+void MainWindow::clearKMLCache()
+{
+  mapLinkWidget->clearKMLCache();
+}
+
+void MainWindow::showKMLProgress( int percent )
+{
+  if( percent < 0 )
+  {
+    // The KML data layer gives no progress, so show that it is busy
+    m_kmlProgress->setRange(0, 0);
+  }
+  else
+  {
+    m_kmlProgress->setRange(0, 100);
+    m_kmlProgress->setValue(percent);
+  }
+  m_kmlProgress->show();
+  statusBar()->showMessage(tr("Loading KML"));
+}
+
+void MainWindow::kmlLoadFinished()
+{
+  m_kmlProgress->hide();
+
+  const KMLLoadStatistics &statistics = mapLinkWidget->kmlLoadStatistics();
+  if( statistics.m_loadTime >= 0 )
+  {
+    statusBar()->showMessage(tr("KML loaded in %1 ms").arg(statistics.m_loadTime));
+  }
+  else
+  {
+    statusBar()->clearMessage();
+  }
+
+  if( m_kmlBenchmark )
+  {
+    cout << "Placemarks shown while loading: " << statistics.m_numPlacemarks
+         << (statistics.m_placemarksFromCache ? " (from the feature cache)" : "") << endl
+         << "Time to first feature: " << statistics.m_timeToFirstFeature << " ms" << endl
+         << "All placemarks shown: " << statistics.m_previewTime << " ms" << endl
+         << "KML data layer shown: " << statistics.m_loadTime << " ms" << endl
+         << "Longest user interface stall: " << statistics.m_longestStall << " ms" << endl;
+    QCoreApplication::exit( statistics.m_loadTime >= 0 ? 0 : 1 );
+  }
+}
+
 void MainWindow::loadMap()
 {
   // Show a file open dialog to let the user choose the map to load - 
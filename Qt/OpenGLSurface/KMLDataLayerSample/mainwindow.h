@@ -8,6 +8,7 @@
 #include <QMainWindow>
 #include <QActionGroup>
 #include <QLabel>
+#include <QProgressBar>
 #include "ui_kmldatalayersample.h"
 
 class MainWindow : public QMainWindow, private Ui_MainWindow
@@ -18,6 +19,12 @@ public:
     ~MainWindow();
     void loadMap( const char *mapToLoad );
     void loadKML( const char *kmlToLoad );
+
+    // Report the timings of the next KML file loaded on standard output, then close the window
+    void setKMLBenchmark( bool benchmark );
+    void setKMLPreview( bool preview );
+    void setKMLCache( bool cache );
+    void clearKMLCache();
 private slots:
     void loadMap();
     void loadKML();
@@ -29,9 +36,13 @@ private slots:
     void activateZoomMode();
     void showAboutBox();
     void exit();
+    void showKMLProgress( int percent );
+    void kmlLoadFinished();
 
 private:
     QActionGroup *m_interactionModesGroup;
+    QProgressBar *m_kmlProgress;
+    bool m_kmlBenchmark;
 };
 
 #endif // MAINWINDOW_H
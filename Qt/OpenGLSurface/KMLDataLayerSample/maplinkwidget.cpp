@@ -61,6 +61,9 @@ WId getHWNDForWidget(const QWidget* widget)
 # endif
 #endif
 
+// How often a KML file being loaded is checked for more placemarks to show, in milliseconds
+static const int kmlLoadInterval = 50;
+
 // These are defined by X11 which interfere with the Qt definitions
 #ifdef KeyPress
 #  undef KeyPress
@@ -104,6 +107,8 @@ MapLinkWidget::MapLinkWidget( QWidget * parent, const QGLWidget * shareWidget, Q
 
   // Set the mouse tracking in the designer.
   setMouseTracking( true );
+
+  connect( &m_kmlLoadTimer, SIGNAL(timeout()), this, SLOT(updateKMLLoad()) );
 }
 
 MapLinkWidget::~MapLinkWidget()
@@ -129,11 +134,54 @@ void MapLinkWidget::loadKML(const char* filename, AttributeTreeWidget* attribute
 {
   if( m_application )
   {
-    m_application->loadKML( filename, attributeTree );
+    if( m_application->loadKML( filename, attributeTree ) )
+    {
+      m_kmlLoadTimer.start( kmlLoadInterval );
+      emit kmlLoadProgress( 0 );
+    }
     update();
   }
 }
 
+void MapLinkWidget::setKMLPreview(bool preview)
+{
+  m_application->setKMLPreview( preview );
+}
+
+void MapLinkWidget::setKMLCache(bool cache)
+{
+  m_application->setKMLCache( cache );
+}
+
+void MapLinkWidget::clearKMLCache()
+{
+  m_application->clearKMLCache();
+}
+
+const KMLLoadStatistics& MapLinkWidget::kmlLoadStatistics() const
+{
+  return m_application->kmlLoadStatistics();
+}
+
+void MapLinkWidget::updateKMLLoad()
+{
+  int progress = -1;
+  if( m_application->updateKMLLoad( progress ) )
+  {
+    update();
+  }
+
+  if( m_application->kmlLoading() )
+  {
+    emit kmlLoadProgress( progress );
+  }
+  else
+  {
+    m_kmlLoadTimer.stop();
+    emit kmlLoadFinished();
+  }
+}
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Mouse & Keyboard handling
 //
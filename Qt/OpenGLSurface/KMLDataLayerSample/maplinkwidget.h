@@ -7,6 +7,7 @@
 
 #include <QGLWidget>
 #include <QLabel>
+#include <QTimer>
 
 #include <string>
 #include "attributetreewidget.h"
@@ -17,6 +18,7 @@
 #define ML_QT_BUFFER_SWAP true
 
 class Application;
+struct KMLLoadStatistics;
 
 ////////////////////////////////////////////////////////////////
 // A very simple MapLink Pro 'Qt Widget'
@@ -30,9 +32,19 @@ public:
 
   // Loads a map
   void loadMap( const char *filename);
-  // Loads a KML file
+  // Starts loading a KML file in the background
   void loadKML(const char* filename, AttributeTreeWidget* attributeTree);
 
+  // Whether placemarks are shown while a KML file loads
+  void setKMLPreview(bool preview);
+
+  // Whether what is read from KML files is cached on disk, and removing what has been cached
+  void setKMLCache(bool cache);
+  void clearKMLCache();
+
+  // Timings of the last KML file loaded
+  const KMLLoadStatistics& kmlLoadStatistics() const;
+
   // Event handlers invoked by the main window
   void resetView();
   void zoomInOnce();
@@ -41,6 +53,16 @@ public:
   void activateGrabMode();
   void activateZoomMode();
 
+signals:
+  // Emitted while a KML file loads with the percentage of the file read, or -1 if that isn't known
+  void kmlLoadProgress(int percent);
+
+  // Emitted once a KML file has loaded and been drawn, or failed to load
+  void kmlLoadFinished();
+
+private slots:
+  void updateKMLLoad();
+
 protected:
   // Qt OpenGL drawing overrides
   void initializeGL();
@@ -61,6 +83,9 @@ protected:
 private:
   // Application instance - this contains all the MapLink related code.
   Application *m_application;
+
+  // Drives the loading of KML files in the background
+  QTimer m_kmlLoadTimer;
 };
 
 
@@ -68,6 +68,7 @@ ClientManager::ClientManager(QWidget *parent, TSLNTSurface *drawingSurface)
   m_drawingSurface(drawingSurface),
 
   m_trackManager(NULL),
+  m_recordTracksHistory(false),
   m_currentTime(0)
 {
 }
@@ -361,6 +362,11 @@ void ClientManager::setRecordTracks(bool recordTracksHistory, int historicDataEx
 {
   m_recordTracksHistory = recordTracksHistory;
   m_trackManager->historicDataExpiry(historicDataExpiryTime);
+  m_historyStore.historicDataExpiry(historicDataExpiryTime);
+  if (!m_recordTracksHistory)
+  {
+    m_historyStore.clear();
+  }
 }
 
 //! get current time when recording history.
@@ -395,6 +401,39 @@ void ClientManager::clearHistoryPoints()
   m_selectedTrackId = "";
 }
 
+//! get the recorded positions of a track within [fromTime, toTime], oldest first.
+size_t ClientManager::getTrackHistory(const string &trackId, int fromTime, int toTime, std::vector<TrackHistoryStore::Fix> &fixes) const
+{
+  auto it = m_displayingTracks.find(trackId);
+  if (it == m_displayingTracks.end())
+  {
+    return 0;
+  }
+  return m_historyStore.query(it->second.m_trackNumber, fromTime, toTime, fixes);
+}
+
+//! give a re-created track the history recorded for it, at the times it was recorded.
+//!
+//! Removing a track from the track manager drops its history points, so they are moved
+//! through again once. Setting the manager's current time to each fix's time keeps the
+//! points subject to historicDataExpiry.
+void ClientManager::restoreTrackHistory(const string &trackId)
+{
+  std::vector<TrackHistoryStore::Fix> fixes;
+  if (getTrackHistory(trackId, 0, m_currentTime - 1, fixes) == 0)
+  {
+    return;
+  }
+
+  TSLTrack* track = m_displayingTracks[trackId].m_track;
+  for (const auto& fix : fixes)
+  {
+    m_trackManager->currentTime(fix.m_time);
+    track->move(fix.m_lat, fix.m_lon);
+  }
+  m_trackManager->currentTime(m_currentTime);
+}
+
 //////////////////////////////////////// Client connection Thread ////////////////////////////////////////
 
 //! set client connection Thread
@@ -413,6 +452,9 @@ void ClientManager::onTracksUpdated(std::vector<std::pair<string, string>> &meta
   if (m_recordTracksHistory)
   {
     m_trackManager->currentTime(++m_currentTime);
+
+    //! drop the recorded history that has passed its expiry.
+    m_historyStore.expire(m_currentTime);
   }
 
   //! Process and update the track manager with the updated tracks.
@@ -553,6 +595,10 @@ void ClientManager::processUpdatedTracks(const TracksDelivery &updatedtracksDeli
         m_trackManager->removeTrack(m_displayingTracks[trackId].m_trackNumber);
         //! clone symbol template, create a display track, and add the track to the track manager.
         bool validtrack = createDisplayTrack(tempSymbol, trackId, m_displayingTracks[trackId].m_trackNumber);
+        if (m_recordTracksHistory)
+        {
+          restoreTrackHistory(trackId);
+        }
 
         symbol = reinterpret_cast<TSLTrackMilitarySymbol*>(m_displayingTracks[trackId].m_symbol);
         isSymbolChanged = true;
@@ -586,6 +632,12 @@ void ClientManager::processUpdatedTracks(const TracksDelivery &updatedtracksDeli
 
     //! move the track to its current lat/lon position
     m_displayingTracks[trackId].m_track->move(updatedTrackIndo.m_y, updatedTrackIndo.m_x);
+
+    //! record the position in the history store.
+    if (m_recordTracksHistory)
+    {
+      m_historyStore.record(m_displayingTracks[trackId].m_trackNumber, m_currentTime, updatedTrackIndo.m_y, updatedTrackIndo.m_x);
+    }
   }
 
   //! update the selected metadata table if any is selected
@@ -39,6 +39,7 @@
 #include "tsltrackdisplaymanager.h"
 #include "tsltrackselectionsymbol.h"
 #include "clientconnectionthread.h"
+#include "trackhistorystore.h"
 
 ////////////////////////////////////////////////////////////////
 //! Main Application class.
@@ -165,6 +166,12 @@ private:
   //! current time when recording history.
   int  m_currentTime;
 
+  //! bounded store of the recorded track positions.
+  TrackHistoryStore m_historyStore;
+
+  //! give a re-created track the history recorded for it, at the times it was recorded.
+  void restoreTrackHistory(const string &trackId);
+
 public:
   //! set the record tracks history and set The maximum period to store historic Track data for. 
   //!
@@ -180,6 +187,9 @@ public:
   //! Clear all history points if not in tracks mode.
   void clearHistoryPoints();
 
+  //! get the recorded positions of a track within [fromTime, toTime], oldest first.
+  size_t getTrackHistory(const string &trackId, int fromTime, int toTime, std::vector<TrackHistoryStore::Fix> &fixes) const;
+
   //////////////////////////////////////// Client connection Thread ////////////////////////////////////////
 private:
   //! tracks thread.
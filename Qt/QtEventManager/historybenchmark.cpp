@@ -0,0 +1,83 @@
+/****************************************************************************
+                Copyright (c) 2008-2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "historybenchmark.h"
+#include "trackhistorystore.h"
+
+//! the trail window queried, in seconds.
+static const int queryWindow = 10 * 60;
+
+//! number of trail queries timed.
+static const int numQueries = 1000;
+
+int runHistoryBenchmark(int numTracks, int numFixes)
+{
+  if (numTracks <= 0 || numFixes <= 0)
+  {
+    std::cerr << "The number of tracks and fixes must be positive" << std::endl;
+    return 1;
+  }
+
+  //! keep everything recorded, so the memory reported is for exactly numFixes fixes.
+  TrackHistoryStore store(10, static_cast<size_t>(numFixes));
+
+  //! a deterministic random walk for each track.
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<double> step(-0.001, 0.001);
+  std::vector<double> lats(numTracks), lons(numTracks);
+  for (int i = 0; i < numTracks; ++i)
+  {
+    lats[i] = -60.0 + 120.0 * i / numTracks;
+    lons[i] = -180.0 + 360.0 * ((i * 7919) % numTracks) / numTracks;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  int time = 0;
+  for (int fix = 0; fix < numFixes; ++time)
+  {
+    for (int track = 0; track < numTracks && fix < numFixes; ++track, ++fix)
+    {
+      lats[track] += step(generator);
+      lons[track] += step(generator);
+      store.record(track, time, lats[track], lons[track]);
+    }
+  }
+  qint64 recordTime = timer.nsecsElapsed();
+
+  size_t memory = store.memoryUsage();
+  double bytesPerMillion = static_cast<double>(memory) * 1000000.0 / store.numFixes();
+
+  //! query the trails of randomly chosen tracks over the last 10 minutes recorded.
+  std::uniform_int_distribution<int> trackChoice(0, numTracks - 1);
+  std::vector<TrackHistoryStore::Fix> fixes;
+  qint64 totalQueryTime = 0, longestQueryTime = 0;
+  size_t totalFixesReturned = 0;
+  for (int i = 0; i < numQueries; ++i)
+  {
+    fixes.clear();
+    int track = trackChoice(generator);
+    timer.restart();
+    totalFixesReturned += store.query(track, time - queryWindow, time, fixes);
+    qint64 queryTime = timer.nsecsElapsed();
+    totalQueryTime += queryTime;
+    longestQueryTime = std::max(longestQueryTime, queryTime);
+  }
+
+  std::cout << "Tracks: " << numTracks << std::endl
+            << "Fixes recorded: " << store.numFixes() << " over " << time << " s" << std::endl
+            << "Record time per fix: " << static_cast<double>(recordTime) / numFixes << " ns" << std::endl
+            << "Memory used: " << memory / (1024.0 * 1024.0) << " MB" << std::endl
+            << "Memory per million fixes: " << bytesPerMillion / (1024.0 * 1024.0) << " MB" << std::endl
+            << "10 minute trail query, mean: " << totalQueryTime / (1000.0 * numQueries) << " us"
+            << ", longest: " << longestQueryTime / 1000.0 << " us"
+            << ", fixes returned on average: " << static_cast<double>(totalFixesReturned) / numQueries << std::endl;
+  return 0;
+}
@@ -0,0 +1,16 @@
+/****************************************************************************
+                Copyright (c) 2008-2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef _HISTORYBENCHMARK_H_
+#define _HISTORYBENCHMARK_H_
+
+//! Measure the track history store without a server or drawing surface.
+//!
+//! Records numFixes fixes spread over numTracks tracks, one fix per track each second,
+//! then reports the memory used per million fixes and the latency of querying a single
+//! track's trail over the last 10 minutes. The results are written to standard output.
+//! Returns the process exit code.
+int runHistoryBenchmark(int numTracks, int numFixes);
+
+#endif
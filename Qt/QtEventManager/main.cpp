@@ -7,6 +7,7 @@
 #include <QMessageBox>
 #include <string>
 #include "mainwindow.h"
+#include "historybenchmark.h"
 
 
 int main(int argc, char *argv[])
@@ -25,7 +26,8 @@ int main(int argc, char *argv[])
       argumentList[i].compare("-help", Qt::CaseInsensitive) == 0)
     {
       QMessageBox::information(NULL, "Help",
-        "Help:\n  SimpleGLSample /home path_to_install\t(The directory containing the config directory)");
+        "Help:\n  SimpleGLSample /home path_to_install\t(The directory containing the config directory)"
+        "\n  SimpleGLSample /benchmarkhistory [tracks] [fixes]\t(Measure the track history store and exit)");
       return 0;
     }
     else if ((argumentList[i].compare("/home", Qt::CaseInsensitive) == 0 ||
@@ -35,6 +37,14 @@ int main(int argc, char *argv[])
       TSLUtilityFunctions::setMapLinkHome(argumentList[i + 1].toUtf8(), true);
       ++i;
     }
+    else if (argumentList[i].compare("/benchmarkhistory", Qt::CaseInsensitive) == 0 ||
+      argumentList[i].compare("-benchmarkhistory", Qt::CaseInsensitive) == 0)
+    {
+      //! defaults to a million fixes from 1000 tracks.
+      int numTracks = i + 1 < argumentList.size() ? argumentList[i + 1].toInt() : 1000;
+      int numFixes = i + 2 < argumentList.size() ? argumentList[i + 2].toInt() : 1000000;
+      return runHistoryBenchmark(numTracks, numFixes);
+    }
     else
     {
       mapFilename = argumentList[i];
@@ -79,9 +79,13 @@ FORMS = qteventmanager.ui
 HEADERS = maplinkwidget.h mainwindow.h application.h \
     interactionmodetracks.h \
     clientmanager.h \
-    clientconnectionthread.h
+    clientconnectionthread.h \
+    trackhistorystore.h \
+    historybenchmark.h
 SOURCES = main.cpp mainwindow.cpp maplinkwidget.cpp application.cpp \
     interactionmodetracks.cpp \
     clientmanager.cpp \
-    clientconnectionthread.cpp
+    clientconnectionthread.cpp \
+    trackhistorystore.cpp \
+    historybenchmark.cpp
 RESOURCES = MapLink.qrc
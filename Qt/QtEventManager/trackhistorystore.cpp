@@ -0,0 +1,284 @@
+/****************************************************************************
+                Copyright (c) 2008-2017 by Envitia Group PLC.
+****************************************************************************/
+
+#include <algorithm>
+#include <math.h>
+
+#include "trackhistorystore.h"
+
+const uint32_t TrackHistoryStore::m_endOfChain;
+
+//! fixed-point scale applied to latitudes and longitudes (1e-7 degree resolution).
+const double TrackHistoryStore::m_positionScale = 1e7;
+
+//! round a fixed-point value to the nearest integer.
+static int32_t toFixedPoint(double value, double scale)
+{
+  return static_cast<int32_t>(floor(value * scale + 0.5));
+}
+
+TrackHistoryStore::TrackHistoryStore(int bucketSpan, size_t maxFixes)
+  : m_bucketSpan(bucketSpan > 0 ? bucketSpan : 1),
+  m_maxFixes(maxFixes),
+  m_historicDataExpiry(0),
+  m_numFixes(0)
+{
+  m_spare.m_startTime = 0;
+}
+
+TrackHistoryStore::~TrackHistoryStore()
+{
+}
+
+//! set the maximum period to store history for. Data older than (currentTime - historicDataExpiry) is dropped.
+void TrackHistoryStore::historicDataExpiry(int historicDataExpiry)
+{
+  m_historicDataExpiry = historicDataExpiry;
+}
+
+//! set the maximum number of fixes to store. The oldest buckets are dropped to stay within it.
+void TrackHistoryStore::maxFixes(size_t maxFixes)
+{
+  m_maxFixes = maxFixes;
+  while (m_numFixes > m_maxFixes && m_buckets.size() > 1)
+  {
+    popFront();
+  }
+  if (m_numFixes > m_maxFixes)
+  {
+    dropOldestFixes(m_buckets.front(), m_numFixes - m_maxFixes);
+  }
+}
+
+//! record the position of a track at the given time. Times are expected to be non-decreasing.
+void TrackHistoryStore::record(int trackNumber, int time, double lat, double lon)
+{
+  if (m_maxFixes == 0)
+  {
+    return;
+  }
+
+  Bucket* bucket = bucketForTime(time);
+
+  //! keep within the fixes cap by dropping whole buckets, but never the one being written to.
+  //! Once that is the oldest bucket, its own oldest fixes make room. A quarter of the cap is
+  //! dropped at a time, so the bucket is rebuilt once per many fixes rather than on every one.
+  while (m_numFixes >= m_maxFixes)
+  {
+    if (bucket != &m_buckets.front())
+    {
+      popFront();
+    }
+    else if (!bucket->m_times.empty())
+    {
+      dropOldestFixes(*bucket, std::max(m_maxFixes / 4, m_numFixes - m_maxFixes + 1));
+    }
+    else
+    {
+      //! the fix is older than all of the stored history, so it would be the first to go.
+      popFront();
+      return;
+    }
+  }
+
+  uint32_t index = static_cast<uint32_t>(bucket->m_times.size());
+
+  bucket->m_times.push_back(time);
+  bucket->m_lats.push_back(toFixedPoint(lat, m_positionScale));
+  bucket->m_lons.push_back(toFixedPoint(lon, m_positionScale));
+  bucket->m_next.push_back(m_endOfChain);
+
+  //! link the fix onto the end of the track's chain within the bucket.
+  auto it = bucket->m_chains.find(trackNumber);
+  if (it == bucket->m_chains.end())
+  {
+    Chain chain = { index, index };
+    bucket->m_chains.insert(std::make_pair(trackNumber, chain));
+  }
+  else
+  {
+    bucket->m_next[it->second.m_last] = index;
+    it->second.m_last = index;
+  }
+
+  ++m_numFixes;
+}
+
+//! drop all buckets that are entirely older than (currentTime - historicDataExpiry).
+void TrackHistoryStore::expire(int currentTime)
+{
+  if (m_historicDataExpiry <= 0)
+  {
+    return;
+  }
+
+  int cutoff = currentTime - m_historicDataExpiry;
+  while (!m_buckets.empty() && m_buckets.front().m_startTime + m_bucketSpan <= cutoff)
+  {
+    popFront();
+  }
+}
+
+//! append the fixes of a track recorded within [fromTime, toTime] to fixes, oldest first.
+size_t TrackHistoryStore::query(int trackNumber, int fromTime, int toTime, std::vector<Fix> &fixes) const
+{
+  size_t numAppended = 0;
+
+  //! skip buckets that end before the start of the window.
+  auto bucketEndsBefore = [this](const Bucket &bucket, int time) { return bucket.m_startTime + m_bucketSpan <= time; };
+  auto bucketIt = std::lower_bound(m_buckets.begin(), m_buckets.end(), fromTime, bucketEndsBefore);
+
+  for (; bucketIt != m_buckets.end() && bucketIt->m_startTime <= toTime; ++bucketIt)
+  {
+    const Bucket& bucket = *bucketIt;
+    auto chainIt = bucket.m_chains.find(trackNumber);
+    if (chainIt == bucket.m_chains.end())
+    {
+      continue;
+    }
+
+    for (uint32_t index = chainIt->second.m_first; index != m_endOfChain; index = bucket.m_next[index])
+    {
+      int time = bucket.m_times[index];
+      if (time < fromTime || time > toTime)
+      {
+        continue;
+      }
+
+      Fix fix;
+      fix.m_trackNumber = trackNumber;
+      fix.m_time = time;
+      fix.m_lat = bucket.m_lats[index] / m_positionScale;
+      fix.m_lon = bucket.m_lons[index] / m_positionScale;
+      fixes.push_back(fix);
+      ++numAppended;
+    }
+  }
+
+  return numAppended;
+}
+
+//! remove all recorded history.
+void TrackHistoryStore::clear()
+{
+  m_buckets.clear();
+  m_spare.clear();
+  m_numFixes = 0;
+}
+
+//! number of fixes currently stored.
+size_t TrackHistoryStore::numFixes() const
+{
+  return m_numFixes;
+}
+
+//! approximate number of bytes used by the stored history.
+size_t TrackHistoryStore::memoryUsage() const
+{
+  size_t bytes = sizeof(*this) + m_spare.memoryUsage();
+  for (const auto& bucket : m_buckets)
+  {
+    bytes += sizeof(Bucket) + bucket.memoryUsage();
+  }
+  return bytes;
+}
+
+//! find the bucket that a fix recorded at time belongs to, creating it if needed.
+TrackHistoryStore::Bucket* TrackHistoryStore::bucketForTime(int time)
+{
+  int remainder = time % m_bucketSpan;
+  int startTime = time - (remainder < 0 ? remainder + m_bucketSpan : remainder);
+
+  //! the common case: recording into the newest bucket.
+  if (!m_buckets.empty() && m_buckets.back().m_startTime == startTime)
+  {
+    return &m_buckets.back();
+  }
+
+  auto bucketIt = m_buckets.end();
+  if (!m_buckets.empty() && startTime < m_buckets.back().m_startTime)
+  {
+    //! late fix for an older bucket.
+    auto startsBefore = [](const Bucket &bucket, int time) { return bucket.m_startTime < time; };
+    bucketIt = std::lower_bound(m_buckets.begin(), m_buckets.end(), startTime, startsBefore);
+    if (bucketIt->m_startTime == startTime)
+    {
+      return &*bucketIt;
+    }
+  }
+
+  //! reuse the storage of the last dropped bucket.
+  bucketIt = m_buckets.insert(bucketIt, Bucket());
+  std::swap(*bucketIt, m_spare);
+  bucketIt->m_startTime = startTime;
+  return &*bucketIt;
+}
+
+//! drop the oldest bucket, keeping its storage for reuse.
+void TrackHistoryStore::popFront()
+{
+  Bucket& front = m_buckets.front();
+  m_numFixes -= front.m_times.size();
+  std::swap(front, m_spare);
+  m_spare.clear();
+  m_buckets.pop_front();
+}
+
+//! drop the first numToDrop fixes recorded into a bucket, relinking the chains of the rest.
+void TrackHistoryStore::dropOldestFixes(Bucket &bucket, size_t numToDrop)
+{
+  size_t numBucketFixes = bucket.m_times.size();
+  numToDrop = std::min(numToDrop, numBucketFixes);
+
+  //! the columns don't hold the track of each fix, so recover it from the chains.
+  std::vector<int32_t> trackNumbers(numBucketFixes);
+  for (const auto& chain : bucket.m_chains)
+  {
+    for (uint32_t index = chain.second.m_first; index != m_endOfChain; index = bucket.m_next[index])
+    {
+      trackNumbers[index] = chain.first;
+    }
+  }
+
+  bucket.m_times.erase(bucket.m_times.begin(), bucket.m_times.begin() + numToDrop);
+  bucket.m_lats.erase(bucket.m_lats.begin(), bucket.m_lats.begin() + numToDrop);
+  bucket.m_lons.erase(bucket.m_lons.begin(), bucket.m_lons.begin() + numToDrop);
+  bucket.m_next.assign(bucket.m_times.size(), m_endOfChain);
+  bucket.m_chains.clear();
+
+  for (uint32_t index = 0; index < bucket.m_times.size(); ++index)
+  {
+    auto it = bucket.m_chains.find(trackNumbers[index + numToDrop]);
+    if (it == bucket.m_chains.end())
+    {
+      Chain chain = { index, index };
+      bucket.m_chains.insert(std::make_pair(trackNumbers[index + numToDrop], chain));
+    }
+    else
+    {
+      bucket.m_next[it->second.m_last] = index;
+      it->second.m_last = index;
+    }
+  }
+
+  m_numFixes -= numToDrop;
+}
+
+void TrackHistoryStore::Bucket::clear()
+{
+  m_times.clear();
+  m_lats.clear();
+  m_lons.clear();
+  m_next.clear();
+  m_chains.clear();
+}
+
+size_t TrackHistoryStore::Bucket::memoryUsage() const
+{
+  size_t bytes = (m_times.capacity() + m_lats.capacity() + m_lons.capacity()) * sizeof(int32_t);
+  bytes += m_next.capacity() * sizeof(uint32_t);
+  bytes += m_chains.bucket_count() * sizeof(void*);
+  bytes += m_chains.size() * (sizeof(std::pair<const int32_t, Chain>) + 2 * sizeof(void*));
+  return bytes;
+}
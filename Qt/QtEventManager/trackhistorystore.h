@@ -0,0 +1,123 @@
+/****************************************************************************
+                Copyright (c) 2008-2017 by Envitia Group PLC.
+****************************************************************************/
+
+#ifndef _TRACKHISTORYSTORE_H_
+#define _TRACKHISTORYSTORE_H_
+
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////
+//! Bounded store of recorded track history.
+//
+//! Fixes are partitioned into buckets covering a fixed span of
+//! recording time. Each bucket keeps its fixes in columns, with
+//! positions held as fixed-point integers, so expiring old history
+//! is a matter of dropping whole buckets from the front of the
+//! store. A cap on the total number of fixes bounds the memory
+//! used regardless of the expiry period.
+////////////////////////////////////////////////////////////////
+class TrackHistoryStore
+{
+public:
+  //! A single recorded position of a track.
+  struct Fix
+  {
+    int m_trackNumber;
+    int m_time;
+    double m_lat;
+    double m_lon;
+  };
+
+  //! bucketSpan is the recording time covered by each bucket, maxFixes the upper bound on stored fixes.
+  TrackHistoryStore(int bucketSpan = 10, size_t maxFixes = 1000000);
+  ~TrackHistoryStore();
+
+  //! set the maximum period to store history for. Data older than (currentTime - historicDataExpiry) is dropped.
+  void historicDataExpiry(int historicDataExpiry);
+
+  //! set the maximum number of fixes to store. The oldest buckets, then the oldest fixes of the last one,
+  //! are dropped to stay within it.
+  void maxFixes(size_t maxFixes);
+
+  //! record the position of a track at the given time. Times are expected to be non-decreasing.
+  void record(int trackNumber, int time, double lat, double lon);
+
+  //! drop all buckets that are entirely older than (currentTime - historicDataExpiry).
+  void expire(int currentTime);
+
+  //! append the fixes of a track recorded within [fromTime, toTime] to fixes, oldest first.
+  //! Returns the number of fixes appended.
+  size_t query(int trackNumber, int fromTime, int toTime, std::vector<Fix> &fixes) const;
+
+  //! remove all recorded history.
+  void clear();
+
+  //! number of fixes currently stored.
+  size_t numFixes() const;
+
+  //! approximate number of bytes used by the stored history.
+  size_t memoryUsage() const;
+
+private:
+  //! sentinel marking the end of a track's chain of fixes within a bucket.
+  static const uint32_t m_endOfChain = 0xffffffff;
+
+  //! fixed-point scale applied to latitudes and longitudes (1e-7 degree resolution).
+  static const double m_positionScale;
+
+  //! first and last fix of a track within a bucket.
+  struct Chain
+  {
+    uint32_t m_first;
+    uint32_t m_last;
+  };
+
+  //! fixes recorded in [m_startTime, m_startTime + bucketSpan), stored as columns.
+  struct Bucket
+  {
+    int m_startTime;
+    std::vector<int32_t> m_times;
+    std::vector<int32_t> m_lats;
+    std::vector<int32_t> m_lons;
+    //! index of the next fix of the same track in this bucket.
+    std::vector<uint32_t> m_next;
+    std::unordered_map<int32_t, Chain> m_chains;
+
+    void clear();
+    size_t memoryUsage() const;
+  };
+
+  //! find the bucket that a fix recorded at time belongs to, creating it if needed.
+  Bucket* bucketForTime(int time);
+
+  //! drop the oldest bucket, keeping its storage for reuse.
+  void popFront();
+
+  //! drop the first numToDrop fixes recorded into a bucket, when no older bucket is left to drop.
+  void dropOldestFixes(Bucket &bucket, size_t numToDrop);
+
+  //! time covered by each bucket.
+  int m_bucketSpan;
+
+  //! maximum number of fixes to keep.
+  size_t m_maxFixes;
+
+  //! maximum period to store history for.
+  int m_historicDataExpiry;
+
+  //! number of fixes over all buckets.
+  size_t m_numFixes;
+
+  //! buckets ordered by start time, oldest first.
+  std::deque<Bucket> m_buckets;
+
+  //! storage of the last dropped bucket, reused for the next new bucket.
+  Bucket m_spare;
+};
+
+#endif
@@ -20,6 +20,7 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 #include <stdlib.h>
 #include <ctype.h>
 #include <time.h>
+#include <algorithm>
 #include <QtGui>
 #include <QMessageBox>
 
@@ -37,6 +38,7 @@ const char * Application::m_mapLayerName = "map";
 
 //! The name of our track manager
 const char * Application::m_trackManagerName = "TDM1MC1";
+const char * Application::m_trailLayerName = "trails";
 
 //! Controls how far the drawing surface rotates in one key press - this value is in radians
 static const double rotationIncrement = M_PI / 360.0;
@@ -60,6 +62,10 @@ Application::Application(QWidget *parent) :
   m_surfaceRotation(0.0),
   m_tobeCreated(true),
   m_parentWidget(parent),
+  m_updatePass(0),
+  m_useSelectionSets(false),
+  m_trailLayer(NULL),
+  m_trailClient(NULL),
   m_trackManager(NULL)
 {
   //! ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -98,6 +104,16 @@ Application::~Application()
     m_mapDataLayer->destroy();
     m_mapDataLayer = 0;
   }
+  if (m_trailLayer)
+  {
+    m_trailLayer->destroy();
+    m_trailLayer = NULL;
+  }
+  if (m_trailClient)
+  {
+    delete m_trailClient;
+    m_trailClient = NULL;
+  }
   if (m_modeManager)
   {
     delete m_modeManager;
@@ -116,10 +132,13 @@ Application::~Application()
 
   for (auto it = m_displayTracks.begin(); it != m_displayTracks.end(); ++it)
   {
-    delete it->second;
+    delete *it;
   }
   m_displayTracks.clear();
 
+  //! the symbol templates must be destroyed while MapLink is still available.
+  m_symbolCache.clear();
+
   // Beyond this point MapLink will no longer be used - clear up all static data.
   // Once this is done no MapLink functions or classes can be used.
   TSLDrawingSurface::cleanup();
@@ -201,6 +220,15 @@ void Application::create()
     m_drawingSurface->addDataLayer(m_mapDataLayer, m_mapLayerName);
   }
 
+  //! Create the layer drawing the history trails, above the map
+  if (m_trailLayer == NULL)
+  {
+    m_trailClient = new TrackTrailLayer(&m_trails);
+    m_trailLayer = new TSLCustomDataLayer();
+    m_trailLayer->setClientCustomDataLayer(m_trailClient, false);
+    m_drawingSurface->addDataLayer(m_trailLayer, m_trailLayerName);
+  }
+
   //
   if (m_modeManager == NULL)
   {
@@ -216,20 +244,7 @@ void Application::create()
   }
 
   // create track manager and attach the drawing surface to it.
-  if (m_trackManager == NULL)
-  {
-    m_trackManager = TSLTrackDisplayManager::create();
-    uint32_t trackId = m_trackManager->addDrawingSurface(m_drawingSurface, m_trackManagerName);
-    int surfaceId = m_drawingSurface ? m_drawingSurface->id() : 0;
-    if (trackId != surfaceId)
-    {
-      QMessageBox::critical(m_parentWidget, "Track Manager Error", "Failed to create track manager");
-    }
-
-    //! set the history points (number of history points, history points type).
-    m_trackManager->numHistoryPoints(2);
-    m_trackManager->historyPointType(TSLTrackDisplayManager::HistoryPointType::HistoryPointTypeSquare);
-  }
+  createTrackManager();
 
   //! and reset the current view to display the entire map.
   m_drawingSurface->reset();
@@ -244,6 +259,30 @@ void Application::create()
   m_tobeCreated = false;
 }
 
+void Application::createTrackManager()
+{
+  if (m_trackManager)
+  {
+    return;
+  }
+
+  m_trackManager = TSLTrackDisplayManager::create();
+  if (m_drawingSurface)
+  {
+    uint32_t trackId = m_trackManager->addDrawingSurface(m_drawingSurface, m_trackManagerName);
+    int surfaceId = m_drawingSurface->id();
+    if (trackId != surfaceId)
+    {
+      QMessageBox::critical(m_parentWidget, "Track Manager Error", "Failed to create track manager");
+    }
+  }
+
+  //! set the history points (number of history points, history points type). The history
+  //! is drawn by the trail layer, which decimates long trails to the scale of the view.
+  m_trackManager->numHistoryPoints(0);
+  m_trackManager->historyPointType(TSLTrackDisplayManager::HistoryPointType::HistoryPointTypeSquare);
+}
+
 void Application::redraw()
 {
   if (m_drawingSurface)
@@ -354,7 +393,7 @@ bool Application::OnRButtonUp(bool shiftPressed, bool controlPressed, int mx, in
   return true;
 }
 
-bool Application::OnKeyPress(bool, bool, int keySym)
+bool Application::OnKeyPress(bool shiftPressed, bool controlPressed, int keySym)
 {
   //! The left and right arrow keys allow the drawing surface to be rotated
   switch (keySym)
@@ -369,6 +408,17 @@ bool Application::OnKeyPress(bool, bool, int keySym)
     m_drawingSurface->rotate(m_surfaceRotation);
     return true;
 
+  //! S selects the tracks in view, adding to the selection with shift and removing from it with control
+  case Qt::Key_S:
+    selectTracksInView(shiftPressed ? TrackSelection::SelectionAdd :
+      (controlPressed ? TrackSelection::SelectionRemove : TrackSelection::SelectionReplace));
+    return true;
+
+  //! Escape goes back to the selection sets of the configuration file
+  case Qt::Key_Escape:
+    setSelectionSets(m_selectionSets);
+    return true;
+
   default:
     break;
   }
@@ -532,68 +582,274 @@ void Application::ResetInteractionModesCallBack(resetInteractionModesCallBack fu
 ///////////////////////////////////////////////////////////////////////////
 //! Tracks Simulator Thread
 ///////////////////////////////////////////////////////////////////////////
-//! Process and update the track manager with the updated tracks.
-void Application::processUpdatedTracks(const std::map<int, TrackInformation> &updatedTracksInformation)
+//! Collect the changes between the updated tracks and the display tracks into the update batch.
+void Application::collectTrackUpdates(const std::vector<TrackInformation> &updatedTracksInformation)
 {
-  bool selectionFlip = false;
+  m_updateBatch.clear();
+  m_updateBatch.reserve(updatedTracksInformation.size());
+  m_trackHandles.reserve(updatedTracksInformation.size());
+  ++m_updatePass;
 
-  //! Check if some tracks are removed from the existing tracks.
-  std::vector<int> removedTracks;
-  for (auto it = m_displayTracks.begin(); it != m_displayTracks.end(); ++it)
+  //! If some update tracks are new or their symbol has changed, queue the symbol change,
+  //! then queue the position of every track.
+  for (auto it = updatedTracksInformation.begin(); it != updatedTracksInformation.end(); ++it)
   {
-    int trackId = it->first;
-    if (updatedTracksInformation.count(trackId) == 0)
+    const TrackInformation& trackInfo = *it;
+    int32_t handle = displayTrackHandle(trackInfo.id);
+    if (handle < 0)
     {
-      //! add the track id to removed tracks vector.
-      removedTracks.push_back(trackId);
+      m_updateBatch.m_symbolChanges.push_back(trackInfo);
     }
+    else
+    {
+      m_handleLastSeen[handle] = m_updatePass;
+      if (m_displayTracks[handle]->isInformationChanged(trackInfo))
+      {
+        m_updateBatch.m_symbolChanges.push_back(trackInfo);
+      }
+      if (m_displayTracks[handle]->isClassificationChanged(trackInfo))
+      {
+        m_updateBatch.m_classificationChanges.push_back(trackInfo);
+      }
+    }
+
+    m_updateBatch.m_positionIds.push_back(trackInfo.id);
+    m_updateBatch.m_lats.push_back(trackInfo.lat);
+    m_updateBatch.m_lons.push_back(trackInfo.lon);
+    m_updateBatch.m_headings.push_back(trackInfo.heading);
   }
 
-  //! erase the removed tracks[If any] from the track manager and the display tracks.
-  for (auto it = removedTracks.begin(); it != removedTracks.end(); ++it)
+  //! Any display track not seen in this pass has been removed from the simulator.
+  for (size_t handle = 0; handle < m_displayTracks.size(); ++handle)
   {
-    int trackId = *it;
-    // check if the track id is being displayed
-    if (m_displayTracks.count(trackId) > 0)
+    if (m_displayTracks[handle] && m_handleLastSeen[handle] != m_updatePass)
     {
-      //! remove track from track manager and erase it from display tracks.
-      m_displayTracks[trackId]->removeDisplayTrack();
-      delete m_displayTracks[trackId];
-      m_displayTracks.erase(trackId);
+      m_updateBatch.m_removedIds.push_back(m_displayTracks[handle]->trackId());
     }
   }
+}
 
-  //! If some update tracks are new, create them, then modify the existing display tracks.
-  for (auto it = updatedTracksInformation.begin(); it != updatedTracksInformation.end(); ++it)
+//! Apply the collected update batch to the track manager in one pass.
+void Application::applyTrackUpdates()
+{
+  //! erase the removed tracks[If any] from the track manager and the display tracks.
+  for (uint32_t trackId : m_updateBatch.m_removedIds)
   {
-    int trackId = it->first;
+    removeDisplayTrack(displayTrackHandle(trackId));
+  }
 
-    //! If this track does not exist, create it.
-    if (m_displayTracks.count(trackId) == 0)
+  //! create the new tracks and update the symbols of the changed ones.
+  for (const TrackInformation& trackInfo : m_updateBatch.m_symbolChanges)
+  {
+    int32_t handle = displayTrackHandle(trackInfo.id);
+    if (handle < 0)
+    {
+      addDisplayTrack(trackInfo);
+    }
+    else
     {
-      //! clone symbol template, create a display track, and add the track to the track manager.
-      int trackId = it->second.id;
-      m_displayTracks[trackId] = new DisplayTrack(m_trackManager);
-      m_displayTracks[trackId]->updateDisplayTrack(it->second);
+      m_displayTracks[handle]->updateDisplayTrack(trackInfo);
+      m_trails.setColour(handle, trackInfo.colour);
     }
+  }
 
-    //! if track's symbol has changed, update the symbol.
-    if ( m_displayTracks[trackId]->isInformationChanged(it->second) )
+  //! the selection sets match tracks by type and hostility, so refresh the tracks whose classification changed.
+  for (const TrackInformation& trackInfo : m_updateBatch.m_classificationChanges)
+  {
+    int32_t handle = displayTrackHandle(trackInfo.id);
+    if (handle >= 0)
     {
-      //! clone symbol template, update display track, and add the track to the track manager.
-      int trackId = it->second.id;
-      m_displayTracks[trackId]->updateDisplayTrack(it->second);
+      m_displayTracks[handle]->updateClassification(trackInfo);
+      m_selection.setTrack(handle, trackInfo.id, trackInfo.type, trackInfo.hostility, trackInfo.lat, trackInfo.lon);
+    }
+  }
+
+  //! update the tracks' positions and headings.
+  const size_t numPositions = m_updateBatch.m_positionIds.size();
+  for (size_t i = 0; i < numPositions; ++i)
+  {
+    int32_t handle = displayTrackHandle(m_updateBatch.m_positionIds[i]);
+    if (handle >= 0)
+    {
+      m_displayTracks[handle]->moveTrack(m_updateBatch.m_lats[i], m_updateBatch.m_lons[i], m_updateBatch.m_headings[i]);
+      m_selection.moveTrack(handle, m_updateBatch.m_lats[i], m_updateBatch.m_lons[i]);
+      addTrailPoint(handle, m_updateBatch.m_lats[i], m_updateBatch.m_lons[i]);
+    }
+  }
+
+  //! the tracks have moved, so select the tracks matching the selection sets again.
+  if (m_useSelectionSets)
+  {
+    applySelectionSets();
+  }
+  applySelectionChanges();
+}
+
+//! get the display track handle for a track id, or -1 if the track is not displayed.
+int32_t Application::displayTrackHandle(uint32_t trackId) const
+{
+  auto it = m_trackHandles.find(trackId);
+  return (it != m_trackHandles.end()) ? it->second : -1;
+}
+
+//! create a display track for the track and assign it a handle.
+void Application::addDisplayTrack(const TrackInformation &trackInfo)
+{
+  int32_t handle;
+  if (!m_freeHandles.empty())
+  {
+    handle = m_freeHandles.back();
+    m_freeHandles.pop_back();
+  }
+  else
+  {
+    handle = static_cast<int32_t>(m_displayTracks.size());
+    m_displayTracks.push_back(NULL);
+    m_handleLastSeen.push_back(0);
+  }
 
+  m_trackHandles[trackInfo.id] = handle;
+  m_handleLastSeen[handle] = m_updatePass;
+
+  //! clone symbol template, create a display track, and add the track to the track manager.
+  m_displayTracks[handle] = new DisplayTrack(m_trackManager, &m_symbolCache);
+  m_displayTracks[handle]->updateDisplayTrack(trackInfo);
+  m_selection.setTrack(handle, trackInfo.id, trackInfo.type, trackInfo.hostility, trackInfo.lat, trackInfo.lon);
+  m_trails.setColour(handle, trackInfo.colour);
+  addTrailPoint(handle, trackInfo.lat, trackInfo.lon);
+}
+
+//! remove the display track of the given handle from the track manager and release the handle.
+void Application::removeDisplayTrack(int32_t handle)
+{
+  if (handle < 0 || !m_displayTracks[handle])
+  {
+    return;
+  }
+
+  //! remove track from track manager and erase it from display tracks.
+  DisplayTrack* displayTrack = m_displayTracks[handle];
+  m_trackHandles.erase(displayTrack->trackId());
+  displayTrack->removeDisplayTrack();
+  delete displayTrack;
+
+  m_displayTracks[handle] = NULL;
+  m_freeHandles.push_back(handle);
+  m_selection.removeTrack(handle);
+  m_trails.removeTrail(handle);
+}
+
+//! add the position of a track to its history trail.
+void Application::addTrailPoint(int32_t handle, double lat, double lon)
+{
+  const TSLCoordinateSystem* coordinateSystem = m_mapDataLayer ? m_mapDataLayer->queryMapCoordinateSystem() : NULL;
+  TSLTMC x, y;
+  if (coordinateSystem && coordinateSystem->latLongToTMC(lat, lon, &x, &y))
+  {
+    m_trails.addPoint(handle, x, y);
+  }
+}
+
+//! set the track selection sets.
+void Application::setSelectionSets(const std::vector<TrackSelectionCriteria> &selectionSets)
+{
+  m_selectionSets = selectionSets;
+  m_useSelectionSets = true;
+  applySelectionSets();
+  applySelectionChanges();
+}
+
+//! select the tracks matching the criteria, replacing the selection sets.
+size_t Application::selectTracks(const TrackSelectionCriteria &criteria, TrackSelection::SelectionMode mode)
+{
+  m_useSelectionSets = false;
+  size_t numMatches = m_selection.select(criteria, mode);
+  applySelectionChanges();
+  return numMatches;
+}
+
+//! select the tracks in the current view.
+size_t Application::selectTracksInView(TrackSelection::SelectionMode mode)
+{
+  if (!m_drawingSurface)
+  {
+    return 0;
+  }
+
+  //! the region is the latitude/longitude bounds of the corners of the view:
+  //! top left, top right, bottom left and bottom right.
+  const TSLDeviceUnits cornersX[4] = { 0, m_widgetWidth, 0, m_widgetWidth };
+  const TSLDeviceUnits cornersY[4] = { 0, 0, m_widgetHeight, m_widgetHeight };
+  double lats[4], lons[4];
+  bool valid[4];
+
+  TrackSelectionCriteria criteria;
+  criteria.m_useRegion = true;
+  criteria.m_minLat = 90.0;
+  criteria.m_maxLat = -90.0;
+  criteria.m_minLon = 180.0;
+  criteria.m_maxLon = -180.0;
+  for (int i = 0; i < 4; ++i)
+  {
+    valid[i] = m_drawingSurface->DUToLatLong(cornersX[i], cornersY[i], &lats[i], &lons[i]);
+    if (valid[i])
+    {
+      criteria.m_minLat = std::min(criteria.m_minLat, lats[i]);
+      criteria.m_maxLat = std::max(criteria.m_maxLat, lats[i]);
+      criteria.m_minLon = std::min(criteria.m_minLon, lons[i]);
+      criteria.m_maxLon = std::max(criteria.m_maxLon, lons[i]);
     }
+  }
+  if (criteria.m_minLat > criteria.m_maxLat)
+  {
+    //! no corner of the view is on the map.
+    return 0;
+  }
+
+  //! the view crosses the antimeridian when its left side is east of its right side.
+  if (valid[0] && valid[1] && valid[2] && valid[3] && lons[0] > lons[1] && lons[2] > lons[3])
+  {
+    criteria.m_minLon = std::min(lons[0], lons[2]);
+    criteria.m_maxLon = std::max(lons[1], lons[3]);
+  }
+
+  return selectTracks(criteria, mode);
+}
+
+//! get the track selection.
+const TrackSelection& Application::trackSelection() const
+{
+  return m_selection;
+}
 
-    //! update symbol's position
-    m_displayTracks[trackId]->moveTrack(it->second.lat, it->second.lon);
+//! get the statistics of the symbol templates shared by the display tracks.
+SymbolTemplateCache::Statistics Application::symbolCacheStatistics() const
+{
+  return m_symbolCache.statistics();
+}
+
+//! select the tracks matching the selection sets.
+void Application::applySelectionSets()
+{
+  m_selection.clear();
+  for (const TrackSelectionCriteria& criteria : m_selectionSets)
+  {
+    m_selection.select(criteria, TrackSelection::SelectionAdd);
   }
+}
 
-  bool selections[10] = { 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
-  uint32_t trackIDs[10] = { 0, 10, 20, 30, 40, 50, 60, 70, 80, 90 };
+//! send the tracks whose selection changed to the track manager.
+void Application::applySelectionChanges()
+{
+  size_t numChanges = m_selection.collectChanges();
+  if (numChanges == 0 || !m_trackManager || !m_drawingSurface)
+  {
+    return;
+  }
 
-  bool success = m_trackManager->selectTracks( m_drawingSurface->id(), 10, trackIDs, selections );
+  //! one call for all the changes, rather than one per track.
+  m_trackManager->selectTracks(m_drawingSurface->id(), static_cast<uint32_t>(numChanges),
+    m_selection.changedTrackIds(), m_selection.changedSelections());
 }
 
 //! redraw the drawing surface.
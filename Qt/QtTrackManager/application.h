@@ -46,12 +46,19 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 # include <windows.h>
 #endif
 
+#include <unordered_map>
+
 #include "MapLink.h"
 #include "MapLinkIMode.h"
 
 #include "tsltrackdisplaymanager.h"
 #include "trackinformation.h"
+#include "trackupdatebatch.h"
 #include "displaytrack.h"
+#include "symboltemplatecache.h"
+#include "trackselection.h"
+#include "tracktrails.h"
+#include "tracktraillayer.h"
 
 typedef void(*resetInteractionModesCallBack)();
 
@@ -70,6 +77,10 @@ public:
   //! Creates the MapLink drawing surface and associated map data layer
   void create();
 
+  //! Creates the track manager, attached to the drawing surface if there is one. Without a
+  //! drawing surface the tracks are updated but not drawn, which is used by the benchmarks.
+  void createTrackManager();
+
   //! Called when the size of the window has changed
   void resize(int width, int height);
 
@@ -112,12 +123,31 @@ public:
   //! set the call back to update the GUI for reseting interaction modes.
   void ResetInteractionModesCallBack(resetInteractionModesCallBack func);
 
-  //! Process and update the track manager with the updated tracks.
-  void processUpdatedTracks(const std::map<int, TrackInformation>& updatedTracksInformation);
+  //! Collect the changes between the updated tracks and the display tracks into the update batch.
+  void collectTrackUpdates(const std::vector<TrackInformation>& updatedTracksInformation);
+
+  //! Apply the collected update batch to the track manager in one pass.
+  void applyTrackUpdates();
 
   //! redraw the drawing surface.
   void redrawSurface();
 
+  //! set the track selection sets. The tracks matching any of the sets are selected, and are
+  //! selected again on every update as they move, until the selection is changed by selectTracks().
+  void setSelectionSets(const std::vector<TrackSelectionCriteria>& selectionSets);
+
+  //! select the tracks matching the criteria, replacing the selection sets. Returns the number of matching tracks.
+  size_t selectTracks(const TrackSelectionCriteria& criteria, TrackSelection::SelectionMode mode);
+
+  //! select the tracks in the current view. Returns the number of tracks in the view.
+  size_t selectTracksInView(TrackSelection::SelectionMode mode);
+
+  //! get the track selection.
+  const TrackSelection& trackSelection() const;
+
+  //! get the statistics of the symbol templates shared by the display tracks.
+  SymbolTemplateCache::Statistics symbolCacheStatistics() const;
+
 protected:
   void setMapBackgroundColour();
 
@@ -167,8 +197,64 @@ private:
   //! parent widget
   QWidget *m_parentWidget;
 
-  //! map of display tracks in the drawing surface.
-  std::map<int, DisplayTrack*> m_displayTracks;
+  //! get the display track handle for a track id, or -1 if the track is not displayed.
+  int32_t displayTrackHandle(uint32_t trackId) const;
+
+  //! create a display track for the track and assign it a handle.
+  void addDisplayTrack(const TrackInformation& trackInfo);
+
+  //! remove the display track of the given handle from the track manager and release the handle.
+  void removeDisplayTrack(int32_t handle);
+
+  //! add the position of a track to its history trail.
+  void addTrailPoint(int32_t handle, double lat, double lon);
+
+  //! select the tracks matching the selection sets.
+  void applySelectionSets();
+
+  //! send the tracks whose selection changed to the track manager.
+  void applySelectionChanges();
+
+  //! display tracks in the drawing surface, indexed by handle. Released handles hold NULL.
+  std::vector<DisplayTrack*> m_displayTracks;
+
+  //! handles released by removed tracks, to be reused by new tracks.
+  std::vector<int32_t> m_freeHandles;
+
+  //! display track handle of each displayed track id. A hash map rather than an array indexed
+  //! by id, so sparse or large track ids don't allocate memory for the ids in between.
+  std::unordered_map<uint32_t, int32_t> m_trackHandles;
+
+  //! update pass in which each handle was last seen, used to detect removed tracks.
+  std::vector<uint32_t> m_handleLastSeen;
+
+  //! counter of the update passes.
+  uint32_t m_updatePass;
+
+  //! changes collected from the simulator waiting to be applied.
+  TrackUpdateBatch m_updateBatch;
+
+  //! symbol templates shared by all the display tracks.
+  SymbolTemplateCache m_symbolCache;
+
+  //! selection of the display tracks, by handle.
+  TrackSelection m_selection;
+
+  //! track selection sets.
+  std::vector<TrackSelectionCriteria> m_selectionSets;
+
+  //! true while the selection is given by the selection sets.
+  bool m_useSelectionSets;
+
+  //! history trails of the display tracks, by handle.
+  TrackTrails m_trails;
+
+  //! custom data layer drawing the history trails, and its client.
+  TSLCustomDataLayer* m_trailLayer;
+  TrackTrailLayer* m_trailClient;
+
+  //! Name of my history trail layer
+  static const char * m_trailLayerName;
 
   //! track manager
   TSLTrackDisplayManager*  m_trackManager;
@@ -19,43 +19,78 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 #include "configurationsettings.h"
 
 #include <algorithm>
+#include <initializer_list>
+#include <math.h>
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+//! mean radius of the Earth in metres.
+static const double earthRadius = 6371008.8;
 
 //! parse the configuration file and extract the tracks 
-bool ConfigurationSettings::parseConfigFile(const QString &filename, std::map<int, TrackInformation> &tracksInformation, QString &msgError)
+bool ConfigurationSettings::parseConfigFile(const QString &filename, std::vector<TrackInformation> &tracksInformation, QString &msgError)
 {
-  QDomDocument doc;
   QFile file(filename);
-  if (!file.open(QIODevice::ReadOnly) || !doc.setContent(&file))
+  if (!file.open(QIODevice::ReadOnly))
   {
     msgError = "Failed to open the configuration file.";
     return false;
   }
 
-  //! read the symbol sets
-  QDomNodeList symbolSetNode = doc.elementsByTagName("SymbolSet");
-  if (!parseSymbolSets(symbolSetNode, m_symbolSets, msgError))
+  m_symbolSets.clear();
+  m_defaultSymbolSet.clear();
+  m_scenario = ScenarioSettings();
+  m_typeNames.clear();
+  m_hostilityNames.clear();
+  m_selectionSets.clear();
+  m_typeLines.clear();
+  m_hostilityLines.clear();
+
+  //! read the whole file in one pass, appending the tracks as they are read.
+  const size_t firstTrack = tracksInformation.size();
+  QXmlStreamReader reader(&file);
+  if (reader.readNextStartElement())
+  {
+    if (reader.name() == QLatin1String("Configurations"))
+    {
+      readConfigurations(reader, tracksInformation);
+    }
+    else
+    {
+      reader.raiseError("The root element must be Configurations.");
+    }
+  }
+  if (reader.hasError())
   {
+    msgError = QString("Error at line %1, column %2 of the configuration file: %3")
+      .arg(reader.lineNumber()).arg(reader.columnNumber()).arg(reader.errorString());
+    tracksInformation.resize(firstTrack);
     return false;
   }
 
-  // read the tracks
-  QDomNodeList tracksNode = doc.elementsByTagName("Track");
-  if (!parseTrackNodes(tracksNode, tracksInformation, msgError))
+  //! the symbol sets may follow the elements referring to them, so the references are checked once everything is read.
+  if (!validateSymbolSetReferences(msgError))
   {
+    tracksInformation.resize(firstTrack);
     return false;
   }
-  if (tracksInformation.empty())
+  addSymbolSetNames();
+
+  //! the track speeds were read per simulator update, as the update rate may follow the tracks.
+  for (size_t i = firstTrack; i < tracksInformation.size(); ++i)
   {
-    msgError = "No track nodes found in the configuration file.";
-    return false;
+    tracksInformation[i].speed *= m_scenario.m_updateRate;
   }
 
-  //! read the default symbol set and update the tracks colours and types
-  QDomNodeList defSymbolSetNode = doc.elementsByTagName("DefaultSymbolSet");
-  if (!parseDefaultSymbolSet(defSymbolSetNode, msgError))
+  if (tracksInformation.size() == firstTrack && m_scenario.m_trackCount == 0)
   {
+    msgError = "No track nodes found in the configuration file.";
     return false;
   }
+
+  //! update the tracks colours and types from the default symbol set
   if (!updateTracks(tracksInformation, m_defaultSymbolSet, msgError))
   {
     return false;
@@ -65,8 +100,8 @@ bool ConfigurationSettings::parseConfigFile(const QString &filename, std::map<in
   return true;
 }
 
-//! update the types and hostility for each track based on the symbol set
-bool ConfigurationSettings::updateTracks(std::map<int, TrackInformation> &tracks, const QString &symbolSetStr, QString &msgError)
+//! update the symbol, colour and size of each track from its type and hostility, based on the symbol set
+bool ConfigurationSettings::updateTracks(std::vector<TrackInformation> &tracks, const QString &symbolSetStr, QString &msgError)
 {
   if (m_symbolSets.find(symbolSetStr) == m_symbolSets.end())
   {
@@ -74,64 +109,68 @@ bool ConfigurationSettings::updateTracks(std::map<int, TrackInformation> &tracks
     return false;
   }
 
-  // update types for each track
-  auto& types = m_symbolSets[symbolSetStr].m_types;
-  for (auto& track : tracks)
+  //! resolve each type and hostility code once, then look the codes up for each track.
+  const SymbolSet& symbolSet = m_symbolSets[symbolSetStr];
+  std::vector<uint32_t> symbolIds(m_typeNames.size());
+  std::vector<uint32_t> sizes(m_typeNames.size());
+  std::vector<uint32_t> colours(m_hostilityNames.size());
+
+  // update types
+  for (size_t code = 0; code < m_typeNames.size(); ++code)
   {
-    const auto& typeStr = track.second.type;
-    if (types.find(typeStr) != types.end())
-    {
-      track.second.symbolId = types[typeStr];
-    }
-    else if (types.find("*") != types.end())
+    const QString& typeStr = m_typeNames[code];
+    auto type = symbolSet.m_types.find(typeStr);
+    if (type == symbolSet.m_types.end())
     {
-      track.second.symbolId = types["*"];
+      type = symbolSet.m_types.find("*");
     }
-    else
+    if (type == symbolSet.m_types.end())
     {
-      msgError = "Invalid type (" + typeStr + ") for track id = " + QString::number(track.second.id) + " found in the configuration file.";
+      msgError = "Invalid type (" + typeStr + ") found in the configuration file.";
       return false;
     }
+    symbolIds[code] = type->second;
   }
 
-  // update hostilities for each track
-  auto& hostilities = m_symbolSets[symbolSetStr].m_hostilities;
-  for (auto& track : tracks)
+  // update hostilities
+  for (size_t code = 0; code < m_hostilityNames.size(); ++code)
   {
-    const auto& hostilityStr = track.second.hostility;
-    if (hostilities.find(hostilityStr) != hostilities.end())
+    const QString& hostilityStr = m_hostilityNames[code];
+    auto hostility = symbolSet.m_hostilities.find(hostilityStr);
+    if (hostility == symbolSet.m_hostilities.end())
     {
-      track.second.colour = hostilities[hostilityStr];
+      hostility = symbolSet.m_hostilities.find("*");
     }
-    else if (hostilities.find("*") != hostilities.end())
+    if (hostility == symbolSet.m_hostilities.end())
     {
-      track.second.colour = hostilities["*"];
-    }
-    else
-    {
-      msgError = "Invalid hostility (" + hostilityStr + ") for track id = " + QString::number(track.second.id) + " found in the configuration file.";
+      msgError = "Invalid hostility (" + hostilityStr + ") found in the configuration file.";
       return false;
     }
+    colours[code] = hostility->second;
   }
 
-  // update sizes for each track
-  auto& sizes = m_symbolSets[symbolSetStr].m_sizes;
-  for (auto& track : tracks)
+  // update sizes
+  for (size_t code = 0; code < m_typeNames.size(); ++code)
   {
-    const auto& typeStr = track.second.type;
-    if (sizes.find(typeStr) != sizes.end())
+    const QString& typeStr = m_typeNames[code];
+    auto size = symbolSet.m_sizes.find(typeStr);
+    if (size == symbolSet.m_sizes.end())
     {
-      track.second.size = sizes[typeStr];
+      size = symbolSet.m_sizes.find("*");
     }
-    else if (sizes.find("*") != sizes.end())
+    if (size == symbolSet.m_sizes.end())
     {
-      track.second.size = sizes["*"];
-    }
-    else
-    {
-      msgError = "Invalid size (" + typeStr + ") for track id = " + QString::number(track.second.id) + " found in the configuration file.";
+      msgError = "Invalid size (" + typeStr + ") found in the configuration file.";
       return false;
     }
+    sizes[code] = size->second;
+  }
+
+  for (auto& track : tracks)
+  {
+    track.symbolId = symbolIds[track.type];
+    track.colour = colours[track.hostility];
+    track.size = sizes[track.type];
   }
 
   return true;
@@ -149,6 +188,74 @@ const QString& ConfigurationSettings::defaultSymbolSet() const
   return m_defaultSymbolSet;
 }
 
+//! settings of the generated scenario.
+const ScenarioSettings& ConfigurationSettings::scenario() const
+{
+  return m_scenario;
+}
+
+//! names of the track types, indexed by the track type codes.
+const std::vector<QString>& ConfigurationSettings::typeNames() const
+{
+  return m_typeNames;
+}
+
+//! names of the track hostilities, indexed by the track hostility codes.
+const std::vector<QString>& ConfigurationSettings::hostilityNames() const
+{
+  return m_hostilityNames;
+}
+
+//! track selection sets, selected while the tracks are displayed.
+const std::vector<TrackSelectionCriteria>& ConfigurationSettings::selectionSets() const
+{
+  return m_selectionSets;
+}
+
+//! get the code of a name, adding it to the names if it is new.
+uint16_t ConfigurationSettings::nameCode(std::vector<QString> &names, const QString &name)
+{
+  auto it = std::find(names.begin(), names.end(), name);
+  if (it != names.end())
+  {
+    return static_cast<uint16_t>(it - names.begin());
+  }
+  names.push_back(name);
+  return static_cast<uint16_t>(names.size() - 1);
+}
+
+//! add the types and hostilities named in every symbol set to the type and hostility names.
+void ConfigurationSettings::addSymbolSetNames()
+{
+  for (const auto& symbolSet : m_symbolSets)
+  {
+    for (const auto& type : symbolSet.second.m_types)
+    {
+      if (type.first != "*" && isTrackTypeValid(type.first))
+      {
+        nameCode(m_typeNames, type.first);
+      }
+    }
+    for (const auto& hostility : symbolSet.second.m_hostilities)
+    {
+      if (hostility.first != "*" && isTrackHostilityValid(hostility.first))
+      {
+        nameCode(m_hostilityNames, hostility.first);
+      }
+    }
+  }
+
+  //! symbol sets which only use wildcards still need one code for the generated tracks.
+  if (m_typeNames.empty())
+  {
+    m_typeNames.push_back("*");
+  }
+  if (m_hostilityNames.empty())
+  {
+    m_hostilityNames.push_back("*");
+  }
+}
+
 //! check if the track hostility is valid for all the symbol sets
 bool ConfigurationSettings::isTrackHostilityValid(const QString &hostilityStr)
 {
@@ -175,259 +282,464 @@ bool ConfigurationSettings::isTrackTypeValid(const QString &typeStr)
   return validType;
 }
 
-//! parse xml node to extract the default symbol set.
-bool ConfigurationSettings::parseDefaultSymbolSet(const QDomNodeList &configNode, QString &msgError)
+///////////////////////////////////////////////////////////////////////////
+//! Configuration file reading
+///////////////////////////////////////////////////////////////////////////
+//! stop reading at an element which is not allowed where it is.
+static void unexpectedElement(QXmlStreamReader &reader)
 {
-  for (int i = 0; i < configNode.size(); i++)
+  reader.raiseError("Unexpected element " + reader.name().toString() + ".");
+}
+
+//! stop reading if the current element has an attribute which is not allowed.
+static bool checkAttributes(QXmlStreamReader &reader, std::initializer_list<const char*> allowed)
+{
+  for (const QXmlStreamAttribute& attribute : reader.attributes())
   {
-    auto node = configNode.at(i);
-    auto map = node.attributes();
-    for (int i = 0; i < map.length(); ++i)
+    bool isAllowed = std::any_of(allowed.begin(), allowed.end(),
+      [&attribute](const char* name) { return attribute.name() == QLatin1String(name); });
+    if (!isAllowed)
     {
-      auto inode = map.item(i);
-      auto attr = inode.toAttr();
-      QString val = attr.value();
-      if (!val.isEmpty())
-      {
-        m_defaultSymbolSet = val;
-        break;
-      }
+      reader.raiseError("Unexpected attribute " + attribute.name().toString() + " of the " + reader.name().toString() + " element.");
+      return false;
     }
   }
+  return true;
+}
 
-  if (m_defaultSymbolSet.isEmpty())
+//! stop reading if the current element has child elements, leaving the reader at its end.
+static void readEmptyElement(QXmlStreamReader &reader)
+{
+  if (reader.readNextStartElement())
   {
-    msgError = "No value found for the default symbol set in the configuration file.";
-    return false;
+    unexpectedElement(reader);
   }
+}
 
-  // check if valid default symbol set.
-  if (m_symbolSets.find(m_defaultSymbolSet) == m_symbolSets.end())
+//! read a text attribute of the current element, stopping reading if it is required and missing or empty.
+static QString readText(QXmlStreamReader &reader, const char* name, bool required)
+{
+  QString value = reader.attributes().value(QLatin1String(name)).toString();
+  if (required && value.isEmpty())
   {
-    msgError = "Invalid Symbol set (" + m_defaultSymbolSet + ").";
-    return false;
+    reader.raiseError("Missing attribute " + QString(name) + " of the " + reader.name().toString() + " element.");
   }
+  return value;
+}
 
-  return true;
+//! read a numeric attribute of the current element, leaving value unchanged if the attribute is optional and missing.
+//! Stops reading if the attribute is required and missing, or is not a number.
+static void readDouble(QXmlStreamReader &reader, const char* name, bool required, double& value)
+{
+  QString text = readText(reader, name, required);
+  if (text.isEmpty())
+  {
+    return;
+  }
+  bool ok;
+  value = text.toDouble(&ok);
+  if (!ok)
+  {
+    reader.raiseError("Invalid number " + text + " in the attribute " + QString(name) + " of the " + reader.name().toString() + " element.");
+  }
 }
 
-//! parse xml node to extract symbol sets key values.
-bool ConfigurationSettings::parseSymbolSets(const QDomNodeList &configNode, std::map<QString, SymbolSet> &symbolSets, QString &msgError)
+//! read an unsigned integer attribute of the current element, as readDouble().
+static void readUInt64(QXmlStreamReader &reader, const char* name, bool required, uint64_t& value)
 {
-  for (int i = 0; i < configNode.size(); i++)
+  QString text = readText(reader, name, required);
+  if (text.isEmpty())
   {
-    auto node = configNode.at(i);
-    auto map = node.attributes();
-    for (int i = 0; i < map.length(); ++i)
-    {
-      auto inode = map.item(i);
-      auto attr = inode.toAttr();
-      QString key = attr.value();
-      if (key.isEmpty())
-      {
-        msgError = "Invalid empty key for the node(" + node.nodeName() + ") in the configuration file.";
-        return false;
-      }
+    return;
+  }
+  bool ok;
+  value = text.toULongLong(&ok);
+  if (!ok)
+  {
+    reader.raiseError("Invalid integer " + text + " in the attribute " + QString(name) + " of the " + reader.name().toString() + " element.");
+  }
+}
 
-      SymbolSet temSymbolSet;
+//! read the Configurations element.
+void ConfigurationSettings::readConfigurations(QXmlStreamReader &reader, std::vector<TrackInformation> &tracks)
+{
+  while (reader.readNextStartElement())
+  {
+    if (reader.name() == QLatin1String("SymbolSets"))
+    {
+      readSymbolSets(reader);
+    }
+    else if (reader.name() == QLatin1String("Scenario"))
+    {
+      readScenario(reader);
+    }
+    else if (reader.name() == QLatin1String("SelectionSets"))
+    {
+      readSelectionSets(reader);
+    }
+    else if (reader.name() == QLatin1String("Tracks"))
+    {
+      readTracks(reader, tracks);
+    }
+    else
+    {
+      unexpectedElement(reader);
+    }
+  }
+}
 
-      auto element = node.toElement();
-      QDomNodeList typesNode = element.elementsByTagName("Type");
-      if (!parseKeyValueNodes(typesNode, temSymbolSet.m_types, msgError))
+//! read the SymbolSets element.
+void ConfigurationSettings::readSymbolSets(QXmlStreamReader &reader)
+{
+  while (reader.readNextStartElement())
+  {
+    if (reader.name() == QLatin1String("DefaultSymbolSet"))
+    {
+      if (checkAttributes(reader, { "key" }))
       {
-        return false;
+        m_defaultSymbolSet = readText(reader, "key", true);
+        readEmptyElement(reader);
       }
+    }
+    else if (reader.name() == QLatin1String("SymbolSet"))
+    {
+      readSymbolSet(reader);
+    }
+    else
+    {
+      unexpectedElement(reader);
+    }
+  }
+}
 
-      QDomNodeList hostilityNode = element.elementsByTagName("Hostility");
-      if (!parseKeyValueNodes(hostilityNode, temSymbolSet.m_hostilities, msgError))
-      {
-        return false;
-      }
+//! read a SymbolSet element.
+void ConfigurationSettings::readSymbolSet(QXmlStreamReader &reader)
+{
+  if (!checkAttributes(reader, { "key" }))
+  {
+    return;
+  }
+  QString key = readText(reader, "key", true);
 
-      QDomNodeList sizeNode = element.elementsByTagName("Size");
-      if (!parseKeyValueNodes(sizeNode, temSymbolSet.m_sizes, msgError))
-      {
-        return false;
-      }
-      // check if valid sizes ["*" or for types in the symbol set]
-      for (auto& size : temSymbolSet.m_sizes)
-      {
-        if (size.first == "*")
-        {
-          continue;
-        }
-        else
-        {
-          if (temSymbolSet.m_types.find(size.first) == temSymbolSet.m_types.end())
-          {
-            msgError = "Invalid Size = " + size.first + " defined in the symbol set: " + key;
-            return false;
-          }
-        }
-      }
+  SymbolSet temSymbolSet;
+  while (reader.readNextStartElement())
+  {
+    if (reader.name() == QLatin1String("Types"))
+    {
+      readKeyValues(reader, "Type", temSymbolSet.m_types);
+    }
+    else if (reader.name() == QLatin1String("Hostilities"))
+    {
+      readKeyValues(reader, "Hostility", temSymbolSet.m_hostilities);
+    }
+    else if (reader.name() == QLatin1String("Sizes_Pixels"))
+    {
+      readKeyValues(reader, "Size", temSymbolSet.m_sizes);
+    }
+    else
+    {
+      unexpectedElement(reader);
+    }
+  }
+  if (reader.hasError())
+  {
+    return;
+  }
 
-      symbolSets[key] = std::move(temSymbolSet);
+  // check if valid sizes ["*" or for types in the symbol set]
+  for (auto& size : temSymbolSet.m_sizes)
+  {
+    if (size.first != "*" && temSymbolSet.m_types.find(size.first) == temSymbolSet.m_types.end())
+    {
+      reader.raiseError("Invalid Size = " + size.first + " defined in the symbol set: " + key);
+      return;
     }
   }
-  return true;
+
+  m_symbolSets[key] = std::move(temSymbolSet);
 }
 
-//! parse track nodes to extract tracks information.
-bool ConfigurationSettings::parseTrackNodes(const QDomNodeList &configNode, std::map<int, TrackInformation> &keyValues, QString &msgError)
+//! read the key values of the Type, Hostility or Size elements of a symbol set.
+void ConfigurationSettings::readKeyValues(QXmlStreamReader &reader, const char* elementName, std::map<QString, uint32_t> &keyValues)
 {
-  for (int i = 0; i < configNode.size(); i++)
+  while (reader.readNextStartElement())
   {
-    auto node = configNode.at(i);
-    auto map = node.attributes();
-
-    QString idStr, hostilityStr, typeStr, latStr, lonStr, latOffsetStr, lonOffsetStr;
-    for (int i = 0; i < map.length(); ++i)
+    if (reader.name() != QLatin1String(elementName))
     {
-      auto inode = map.item(i);
-      auto attr = inode.toAttr();
-      if (attr.name() == "id")
-      {
-        idStr = attr.value();
-      }
-      else if (attr.name() == "Hostility")
-      {
-        hostilityStr = attr.value();
-      }
-      else if (attr.name() == "Type")
-      {
-        typeStr = attr.value();
-      }
-      else if (attr.name() == "lat")
-      {
-        latStr = attr.value();
-      }
-      else if (attr.name() == "lon")
-      {
-        lonStr = attr.value();
-      }
-      else if (attr.name() == "latOffset")
-      {
-        latOffsetStr = attr.value();
-      }
-      else if (attr.name() == "lonOffset")
-      {
-        lonOffsetStr = attr.value();
-      }
+      unexpectedElement(reader);
+      return;
     }
-
-    //! check attributes
-    if (idStr.isEmpty())
+    if (!checkAttributes(reader, { "key" }))
     {
-      msgError = "Invalid empty id in the configuration file.";
-      return false;
+      return;
     }
-    if (hostilityStr.isEmpty())
+    QString key = readText(reader, "key", true);
+    if (reader.hasError())
     {
-      msgError = "Invalid empty Hostility in the configuration file.";
-      return false;
+      return;
     }
-    if (typeStr.isEmpty())
+
+    QString val = reader.readElementText().trimmed();
+    if (reader.hasError())
     {
-      msgError = "Invalid empty Type in the configuration file.";
-      return false;
+      return;
     }
-    if (latStr.isEmpty())
+    if (val.isEmpty())
     {
-      msgError = "Invalid empty lat in the configuration file.";
-      return false;
+      reader.raiseError("No value found for the key (" + key + ") in the configuration file.");
+      return;
     }
-    if (lonStr.isEmpty())
+
+    //! values starting with 0x are RGBA colours.
+    bool ok;
+    if (val.startsWith("0x"))
     {
-      msgError = "Invalid empty lon in the configuration file.";
-      return false;
+      uint32_t parsedValue = val.toUInt(&ok, 16);
+      keyValues[key] = rgbaToMapLinkColour(parsedValue);
     }
-    if (latOffsetStr.isEmpty())
+    else
     {
-      msgError = "Invalid empty latOffset in the configuration file.";
-      return false;
+      keyValues[key] = val.toUInt(&ok);
     }
-    if (lonOffsetStr.isEmpty())
+    if (!ok)
     {
-      msgError = "Invalid empty lonOffset in the configuration file.";
-      return false;
+      reader.raiseError("Invalid value (" + val + ") for the key (" + key + ") in the configuration file.");
+      return;
     }
+  }
+}
+
+//! read the Scenario element.
+void ConfigurationSettings::readScenario(QXmlStreamReader &reader)
+{
+  if (!checkAttributes(reader, { "trackCount", "seed", "updateRate", "speedDistribution", "minSpeed", "maxSpeed",
+    "minLat", "maxLat", "minLon", "maxLon" }))
+  {
+    return;
+  }
+
+  uint64_t trackCount = m_scenario.m_trackCount;
+  readUInt64(reader, "trackCount", false, trackCount);
+  readUInt64(reader, "seed", false, m_scenario.m_seed);
+  readDouble(reader, "updateRate", false, m_scenario.m_updateRate);
+  readDouble(reader, "minSpeed", false, m_scenario.m_minSpeed);
+  readDouble(reader, "maxSpeed", false, m_scenario.m_maxSpeed);
+  readDouble(reader, "minLat", false, m_scenario.m_minLat);
+  readDouble(reader, "maxLat", false, m_scenario.m_maxLat);
+  readDouble(reader, "minLon", false, m_scenario.m_minLon);
+  readDouble(reader, "maxLon", false, m_scenario.m_maxLon);
+  if (reader.hasError())
+  {
+    return;
+  }
+  m_scenario.m_trackCount = static_cast<uint32_t>(trackCount);
 
-    //! check if valid hostility and types
-    if (!isTrackHostilityValid(hostilityStr))
+  QString distribution = readText(reader, "speedDistribution", false);
+  if (distribution.isEmpty() || distribution.compare("uniform", Qt::CaseInsensitive) == 0)
+  {
+    m_scenario.m_speedDistribution = ScenarioSettings::SpeedDistributionUniform;
+  }
+  else if (distribution.compare("normal", Qt::CaseInsensitive) == 0)
+  {
+    m_scenario.m_speedDistribution = ScenarioSettings::SpeedDistributionNormal;
+  }
+  else
+  {
+    reader.raiseError("Invalid speedDistribution (" + distribution + ") in the configuration file.");
+    return;
+  }
+
+  if (trackCount > 0xffffffffULL || m_scenario.m_updateRate <= 0.0 || m_scenario.m_minSpeed > m_scenario.m_maxSpeed ||
+    m_scenario.m_minLat > m_scenario.m_maxLat || m_scenario.m_minLon > m_scenario.m_maxLon)
+  {
+    reader.raiseError("Invalid Scenario settings in the configuration file.");
+    return;
+  }
+
+  readEmptyElement(reader);
+}
+
+//! read the SelectionSets element.
+void ConfigurationSettings::readSelectionSets(QXmlStreamReader &reader)
+{
+  while (reader.readNextStartElement())
+  {
+    if (reader.name() == QLatin1String("SelectionSet"))
     {
-      msgError = "Invalid Hostility in the configuration file does not have reference in all symbol sets. " + hostilityStr;
-      return false;
+      readSelectionSet(reader);
     }
-    if (!isTrackTypeValid(typeStr))
+    else
     {
-      msgError = "Invalid Type in the configuration file does not have reference in all symbol sets. " + typeStr;
-      return false;
+      unexpectedElement(reader);
     }
+  }
+}
 
-    //! create the track information
-    uint32_t id = idStr.toUInt();
-    keyValues[id] = (TrackInformation{
-      id,
-      latStr.toDouble(),
-      latOffsetStr.toDouble(),
-      lonStr.toDouble(),
-      lonOffsetStr.toDouble(),
-      typeStr,
-      hostilityStr
-    });
+//! read a SelectionSet element.
+void ConfigurationSettings::readSelectionSet(QXmlStreamReader &reader)
+{
+  if (!checkAttributes(reader, { "key", "minLat", "maxLat", "minLon", "maxLon", "types", "hostilities" }))
+  {
+    return;
+  }
+  QString key = readText(reader, "key", false);
+  TrackSelectionCriteria criteria;
+
+  //! the region is optional, but must be complete if given.
+  const QXmlStreamAttributes& attributes = reader.attributes();
+  int numRegionAttributes = attributes.hasAttribute(QLatin1String("minLat")) + attributes.hasAttribute(QLatin1String("maxLat")) +
+    attributes.hasAttribute(QLatin1String("minLon")) + attributes.hasAttribute(QLatin1String("maxLon"));
+  criteria.m_useRegion = (numRegionAttributes == 4);
+  readDouble(reader, "minLat", criteria.m_useRegion, criteria.m_minLat);
+  readDouble(reader, "maxLat", criteria.m_useRegion, criteria.m_maxLat);
+  readDouble(reader, "minLon", criteria.m_useRegion, criteria.m_minLon);
+  readDouble(reader, "maxLon", criteria.m_useRegion, criteria.m_maxLon);
+  if (reader.hasError())
+  {
+    return;
+  }
+  if ((numRegionAttributes != 0 && numRegionAttributes != 4) || criteria.m_minLat > criteria.m_maxLat)
+  {
+    reader.raiseError("Invalid region of the SelectionSet (" + key + ") in the configuration file.");
+    return;
   }
 
-  return true;
+  //! comma separated type and hostility names, checked against the symbol sets once they have all been read.
+  const qint64 line = reader.lineNumber();
+  QStringList typeList = readText(reader, "types", false).split(',');
+  for (const QString& name : typeList)
+  {
+    QString typeStr = name.trimmed();
+    if (!typeStr.isEmpty())
+    {
+      criteria.m_types.push_back(usedNameCode(m_typeNames, m_typeLines, typeStr, line));
+    }
+  }
+  QStringList hostilityList = readText(reader, "hostilities", false).split(',');
+  for (const QString& name : hostilityList)
+  {
+    QString hostilityStr = name.trimmed();
+    if (!hostilityStr.isEmpty())
+    {
+      criteria.m_hostilities.push_back(usedNameCode(m_hostilityNames, m_hostilityLines, hostilityStr, line));
+    }
+  }
+
+  m_selectionSets.push_back(criteria);
+  readEmptyElement(reader);
 }
 
-//! parse xml node to extract key values used for hostility and type nodes.
-bool ConfigurationSettings::parseKeyValueNodes(const QDomNodeList &configNode, std::map<QString, uint32_t> &keyValues, QString &msgError)
+//! read the Tracks element, appending its tracks to tracks.
+void ConfigurationSettings::readTracks(QXmlStreamReader &reader, std::vector<TrackInformation> &tracks)
 {
-  for (int i = 0; i < configNode.size(); i++)
+  while (reader.readNextStartElement())
   {
-    auto node = configNode.at(i);
-    auto map = node.attributes();
-    for (int i = 0; i < map.length(); ++i)
+    if (reader.name() != QLatin1String("Track"))
     {
-      auto inode = map.item(i);
-      auto attr = inode.toAttr();
-      QString key = attr.value();
-      if (key.isEmpty())
-      {
-        msgError = "Invalid empty key for the node(" + node.nodeName() + ") in the configuration file.";
-        return false;
-      }
+      unexpectedElement(reader);
+      return;
+    }
 
-      if (node.hasAttributes())
-      {
-        QString val = node.toElement().text();
-        if (val.isEmpty())
-        {
-          msgError = "No value found for the key (" + key + ") in the configuration file.";
-          return false;
-        }
-        if (val.startsWith("0x"))
-        {
-          const QString str = QLatin1String(val.toLatin1().data());
-          bool ok;
-          const unsigned int parsedValue = str.toUInt(&ok, 16);
-          if (ok)
-          {
-            keyValues[key] = rgbaToMapLinkColour(parsedValue);
-          }
-        }
-        else
-        {
-          const unsigned int parsedValue = val.toUInt();
-          keyValues[key] = parsedValue;
-        }
+    TrackInformation track = TrackInformation();
+    readTrack(reader, track);
+    if (reader.hasError())
+    {
+      return;
+    }
+    tracks.push_back(track);
+  }
+}
 
-      }
+//! read a Track element.
+void ConfigurationSettings::readTrack(QXmlStreamReader &reader, TrackInformation &track)
+{
+  if (!checkAttributes(reader, { "id", "Hostility", "Type", "lat", "lon", "latOffset", "lonOffset" }))
+  {
+    return;
+  }
+
+  uint64_t id = 0;
+  double latOffset = 0.0, lonOffset = 0.0;
+  readUInt64(reader, "id", true, id);
+  readDouble(reader, "lat", true, track.lat);
+  readDouble(reader, "lon", true, track.lon);
+  readDouble(reader, "latOffset", true, latOffset);
+  readDouble(reader, "lonOffset", true, lonOffset);
+  QString hostilityStr = readText(reader, "Hostility", true);
+  QString typeStr = readText(reader, "Type", true);
+  if (reader.hasError())
+  {
+    return;
+  }
+  if (id > 0xffffffffULL)
+  {
+    reader.raiseError("Invalid id in the configuration file.");
+    return;
+  }
+
+  //! the offsets are the degrees moved on each simulator update, which give the heading
+  //! and the speed of the track. The speed is per update until the update rate is known.
+  //! A degree of longitude spans cos(lat) of a degree of latitude.
+  track.id = static_cast<uint32_t>(id);
+  double eastOffset = lonOffset * cos(track.lat * M_PI / 180.0);
+  track.heading = atan2(eastOffset, latOffset) * 180.0 / M_PI;
+  track.speed = sqrt(latOffset * latOffset + eastOffset * eastOffset) * M_PI / 180.0 * earthRadius;
+
+  //! the type and hostility are checked against the symbol sets once they have all been read.
+  const qint64 line = reader.lineNumber();
+  track.type = usedNameCode(m_typeNames, m_typeLines, typeStr, line);
+  track.hostility = usedNameCode(m_hostilityNames, m_hostilityLines, hostilityStr, line);
+
+  readEmptyElement(reader);
+}
+
+//! check the default symbol set, and that the types and hostilities used are in all the symbol sets.
+bool ConfigurationSettings::validateSymbolSetReferences(QString &msgError)
+{
+  if (m_defaultSymbolSet.isEmpty())
+  {
+    msgError = "No value found for the default symbol set in the configuration file.";
+    return false;
+  }
+  if (m_symbolSets.find(m_defaultSymbolSet) == m_symbolSets.end())
+  {
+    msgError = "Invalid Symbol set (" + m_defaultSymbolSet + ").";
+    return false;
+  }
+
+  //! only the names used so far have a line, as the symbol set names are added afterwards.
+  for (size_t code = 0; code < m_hostilityLines.size(); ++code)
+  {
+    if (!isTrackHostilityValid(m_hostilityNames[code]))
+    {
+      msgError = QString("Invalid Hostility at line %1 of the configuration file does not have reference in all symbol sets. %2")
+        .arg(m_hostilityLines[code]).arg(m_hostilityNames[code]);
+      return false;
+    }
+  }
+  for (size_t code = 0; code < m_typeLines.size(); ++code)
+  {
+    if (!isTrackTypeValid(m_typeNames[code]))
+    {
+      msgError = QString("Invalid Type at line %1 of the configuration file does not have reference in all symbol sets. %2")
+        .arg(m_typeLines[code]).arg(m_typeNames[code]);
+      return false;
     }
   }
   return true;
 }
 
+//! get the code of a name used in the configuration file, recording the line it is first used on.
+uint16_t ConfigurationSettings::usedNameCode(std::vector<QString> &names, std::vector<qint64> &lines, const QString &name, qint64 line)
+{
+  uint16_t code = nameCode(names, name);
+  if (code >= lines.size())
+  {
+    lines.push_back(line);
+  }
+  return code;
+}
+
 //! convert hex colours into maplink colours.
 uint32_t ConfigurationSettings::rgbaToMapLinkColour(uint32_t rgba)
 {
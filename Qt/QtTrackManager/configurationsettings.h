@@ -18,24 +18,75 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 
 #ifndef CONFIGURATIONSETTINGS_H
 #define CONFIGURATIONSETTINGS_H
-#include <QDomDocument>
+#include <QXmlStreamReader>
 #include <QFile>
 #include <QVector>
+#include <vector>
 #include "trackinformation.h"
 #include "symbolset.h"
+#include "trackselection.h"
+
+//!
+//! Settings of the generated simulation scenario, read from the Scenario node of the
+//! configuration file. Tracks defined in the configuration file are simulated as well.
+//!
+struct ScenarioSettings
+{
+  //! distribution of the speeds of the generated tracks.
+  enum SpeedDistribution
+  {
+    SpeedDistributionUniform,
+    SpeedDistributionNormal
+  };
+
+  ScenarioSettings()
+    : m_trackCount(0)
+    , m_seed(1)
+    , m_updateRate(20.0)
+    , m_speedDistribution(SpeedDistributionUniform)
+    , m_minSpeed(5.0)
+    , m_maxSpeed(300.0)
+    , m_minLat(-70.0)
+    , m_maxLat(70.0)
+    , m_minLon(-180.0)
+    , m_maxLon(180.0)
+  {
+  }
+
+  //! number of tracks to generate.
+  uint32_t m_trackCount;
+  //! seed of the random numbers, so the same scenario is generated every time.
+  uint64_t m_seed;
+  //! simulator updates per second.
+  double m_updateRate;
+  //! distribution of the generated speeds between the minimum and maximum.
+  SpeedDistribution m_speedDistribution;
+  //! speed range of the generated tracks in metres per second.
+  double m_minSpeed;
+  double m_maxSpeed;
+  //! area the generated tracks start in, in degrees.
+  double m_minLat;
+  double m_maxLat;
+  double m_minLon;
+  double m_maxLon;
+};
 
 //!
 //! Class to parse the xml configuration tracks and form the tracks information
 //! which will be used by the simulator to create and move the tracks.
 //!
+//! The configuration file is read in a single pass with a stream reader, the tracks being
+//! appended to the simulator's tracks as they are read. The structure of the file is checked
+//! as it is read, and errors are reported with the line they were found on.
+//!
 class ConfigurationSettings
 {
 public:
   //! parse the configuration file and extract the tracks 
-  bool parseConfigFile(const QString& filename, std::map<int, TrackInformation>& tracksInformation, QString& msgError);
+  bool parseConfigFile(const QString& filename, std::vector<TrackInformation>& tracksInformation, QString& msgError);
 
-  //! update the types and hostility for each track based on the symbol set
-  bool updateTracks(std::map<int, TrackInformation>& tracks, const QString& symbolSetStr, QString& msgError);
+  //! update the symbol, colour and size of each track from its type and hostility, based on the symbol set
+  bool updateTracks(std::vector<TrackInformation>& tracks, const QString& symbolSetStr, QString& msgError);
 
   //! get available symbol sets to be used in the menu.
   const std::map<QString, SymbolSet>& symbolSets() const;
@@ -43,6 +94,18 @@ public:
   //! default symbol set
   const QString& defaultSymbolSet() const;
 
+  //! settings of the generated scenario.
+  const ScenarioSettings& scenario() const;
+
+  //! names of the track types, indexed by the track type codes.
+  const std::vector<QString>& typeNames() const;
+
+  //! names of the track hostilities, indexed by the track hostility codes.
+  const std::vector<QString>& hostilityNames() const;
+
+  //! track selection sets, selected while the tracks are displayed.
+  const std::vector<TrackSelectionCriteria>& selectionSets() const;
+
 private:
   //! check if the track hostility is valid for all the symbol sets
   bool isTrackHostilityValid(const QString& hostilityStr);
@@ -50,17 +113,44 @@ private:
   //! check if the track type is valid for all the symbol sets
   bool isTrackTypeValid(const QString& typeStr);
 
-  //! parse xml node to extract the default symbol set.
-  bool parseDefaultSymbolSet(const QDomNodeList& configNode, QString& msgError);
+  //! read the Configurations element.
+  void readConfigurations(QXmlStreamReader& reader, std::vector<TrackInformation>& tracks);
+
+  //! read the SymbolSets element.
+  void readSymbolSets(QXmlStreamReader& reader);
+
+  //! read a SymbolSet element.
+  void readSymbolSet(QXmlStreamReader& reader);
+
+  //! read the key values of the Type, Hostility or Size elements of a symbol set.
+  static void readKeyValues(QXmlStreamReader& reader, const char* elementName, std::map<QString, uint32_t>& keyValues);
+
+  //! read the Scenario element.
+  void readScenario(QXmlStreamReader& reader);
+
+  //! read the SelectionSets element.
+  void readSelectionSets(QXmlStreamReader& reader);
+
+  //! read a SelectionSet element.
+  void readSelectionSet(QXmlStreamReader& reader);
+
+  //! read the Tracks element, appending its tracks to tracks.
+  void readTracks(QXmlStreamReader& reader, std::vector<TrackInformation>& tracks);
+
+  //! read a Track element.
+  void readTrack(QXmlStreamReader& reader, TrackInformation& track);
+
+  //! check the default symbol set, and that the types and hostilities used are in all the symbol sets.
+  bool validateSymbolSetReferences(QString& msgError);
 
-  //! parse xml node to extract symbol sets key values.
-  bool parseSymbolSets(const QDomNodeList& configNode, std::map<QString, SymbolSet>& symbolSets, QString& msgError);
+  //! get the code of a name used in the configuration file, recording the line it is first used on.
+  static uint16_t usedNameCode(std::vector<QString>& names, std::vector<qint64>& lines, const QString& name, qint64 line);
 
-  //! parse track nodes to extract tracks information.
-  bool parseTrackNodes(const QDomNodeList& configNode, std::map<int, TrackInformation>& keyValues, QString& msgError);
+  //! get the code of a name, adding it to the names if it is new.
+  static uint16_t nameCode(std::vector<QString>& names, const QString& name);
 
-  //! parse xml node to extract key values used for hostility and type nodes.
-  static bool parseKeyValueNodes(const QDomNodeList& configNode, std::map<QString, uint32_t>& keyValues, QString& msgError);
+  //! add the types and hostilities named in every symbol set to the type and hostility names.
+  void addSymbolSetNames();
 
   //! convert hex colours into maplink colours.
   static uint32_t rgbaToMapLinkColour(uint32_t rgba);
@@ -72,6 +162,17 @@ private:
   QString m_defaultSymbolSet;
   //! configuration file name.
   QString m_filename;
+  //! settings of the generated scenario.
+  ScenarioSettings m_scenario;
+  //! names of the track types, indexed by the track type codes.
+  std::vector<QString> m_typeNames;
+  //! names of the track hostilities, indexed by the track hostility codes.
+  std::vector<QString> m_hostilityNames;
+  //! track selection sets.
+  std::vector<TrackSelectionCriteria> m_selectionSets;
+  //! line of the configuration file each used type and hostility code is first used on, while loading.
+  std::vector<qint64> m_typeLines;
+  std::vector<qint64> m_hostilityLines;
 
 };
 #endif // CONFIGURATIONSETTINGS_H
@@ -18,18 +18,18 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 
 #include "trackinformation.h"
 #include "displaytrack.h"
-#include "tslsymbol.h"
-#include "tslrenderingattributes.h"
 
-TSLTrackPointSymbol* DisplayTrack::m_templateSelectionSymbol = nullptr;
-
-DisplayTrack::DisplayTrack(TSLTrackDisplayManager*  trackManager)
+DisplayTrack::DisplayTrack(TSLTrackDisplayManager*  trackManager, SymbolTemplateCache* symbolCache)
   : m_track(nullptr)
+  , m_symbolCache(symbolCache)
+  , m_hasSymbol(false)
 {
   m_trackManager = trackManager;
+}
 
-  //! create selection symbol (symbol around the track when it is selected).
-  createDefaultSelectionSymbol();
+DisplayTrack::~DisplayTrack()
+{
+  releaseSymbol();
 }
 
 void DisplayTrack::removeDisplayTrack()
@@ -39,59 +39,28 @@ void DisplayTrack::removeDisplayTrack()
   {
     m_trackManager->removeTrack(m_trackInfo.id);
   }
+  releaseSymbol();
 }
 
-void DisplayTrack::addEntityToPointSymbol(TSLTrackPointSymbol * symbol, int symbolIDVal, int colour, uint32_t size)
-{
-  TSLSymbol* sym = TSLSymbol::create(0, 0, 0);
-  TSLRenderingAttributes attribs;
-  attribs.m_symbolStyle = symbolIDVal;
-  attribs.m_symbolColour = colour;
-  attribs.m_symbolSizeFactor = size;
-  attribs.m_symbolSizeFactorUnits = TSLDimensionUnitsPixels;
-  attribs.m_symbolOpacity = 32767;
-  attribs.m_symbolScalable = TSLRasterSymbolScalableEnabled;
-  attribs.m_symbolRotatable = TSLSymbolRotationDisabled;
-  sym->setRendering(attribs);
-  symbol->addSymbolEntity(sym, false);
-  sym->destroy();
-}
-
-void DisplayTrack::createDefaultSelectionSymbol()
+//! release the symbol template used by the track, if any.
+void DisplayTrack::releaseSymbol()
 {
-  if (!m_templateSelectionSymbol)
+  if (m_hasSymbol)
   {
-    m_templateSelectionSymbol = (TSLTrackPointSymbol::create());
-    
-    TSLSymbol* symbol = TSLSymbol::create(0, 0, 0);
-    symbol->setRendering(TSLRenderingAttributeSymbolStyle, 3);
-    symbol->setRendering(TSLRenderingAttributeSymbolColour, 0x0000ffff);
-    symbol->setRendering(TSLRenderingAttributeSymbolSizeFactor, 70);
-    symbol->setRendering(TSLRenderingAttributeSymbolSizeFactorUnits, TSLDimensionUnitsPixels);
-    m_templateSelectionSymbol->addSymbolEntity(symbol, false);
-    symbol->destroy();
+    m_symbolCache->release(m_trackInfo.symbolId, m_trackInfo.colour, m_trackInfo.size);
+    m_hasSymbol = false;
   }
 }
 
-TSLTrackSymbol* DisplayTrack::createCustomTrackSymbol(uint32_t symbolId, uint32_t color, uint32_t size)
-{
-  //! create track symbol (point symbol)
-  TSLTrackPointSymbol* pointSymbol(TSLTrackPointSymbol::create());
-  addEntityToPointSymbol(pointSymbol, symbolId, color, size);
-
-  //! set the selection symbol to the track symbol.
-  pointSymbol->selectionSymbol(m_templateSelectionSymbol, TSLTrackSymbol::SelectionBehaviourAdditional);
-
-  return pointSymbol;
-}
-
-//! clone symbol template, create a display track, and add the track to the track manager.
+//! get the symbol template, create a display track or update existing track, and add the track to the track manager.
 bool DisplayTrack::updateDisplayTrack(const TrackInformation& trackInfo)
 {
+  //! get the new template before releasing the old one, so a template shared with other
+  //! tracks is not evicted and recreated in between.
+  TSLTrackSymbol* symbolTemplate = m_symbolCache->acquire(trackInfo.symbolId, trackInfo.colour, trackInfo.size);
+  releaseSymbol();
   m_trackInfo = trackInfo;
-
-  TSLTrackSymbol* symbolTemplate = nullptr;
-  symbolTemplate = createCustomTrackSymbol(m_trackInfo.symbolId, m_trackInfo.colour, m_trackInfo.size);
+  m_hasSymbol = true;
 
   //!
   //! if the track is not created, create it.
@@ -100,32 +69,53 @@ bool DisplayTrack::updateDisplayTrack(const TrackInformation& trackInfo)
   bool result = false;
   if (!m_track)
   {
-    //! create track using the cloned symbol template.
-    m_track = TSLTrack::create(symbolTemplate);
+    //! create track using its own copy of the symbol template, as the cache destroys the template
+    //! once it is evicted.
+    m_track = TSLTrack::create(symbolTemplate->clone());
 
     //! add track to track manager.
     result = (m_trackManager) ? m_trackManager->addTrack(m_trackInfo.id, m_track) : false;
   }
   else
   {
-    //! update the symbol of the track.
-    result = m_track->updateSymbol(0, symbolTemplate);
+    //! update the symbol of the track with its own copy of the template.
+    result = m_track->updateSymbol(0, symbolTemplate->clone());
   }
 
   return result;
 }
 
-//! move the track
-void DisplayTrack::moveTrack(double latitude, double longitude)
+//! move the track and set its heading
+void DisplayTrack::moveTrack(double latitude, double longitude, double heading)
 {
   if (m_track)
   {
+    m_track->heading(heading);
     m_track->move(latitude, longitude);
   }
 }
 
+//! get the id of the track
+uint32_t DisplayTrack::trackId() const
+{
+  return m_trackInfo.id;
+}
+
 //! check if track information has changed
 bool DisplayTrack::isInformationChanged(const TrackInformation& trackInfo)
 {
   return (m_trackInfo != trackInfo);
+}
+
+//! check if the type or hostility of the track has changed, which the symbol doesn't always show.
+bool DisplayTrack::isClassificationChanged(const TrackInformation& trackInfo) const
+{
+  return m_trackInfo.type != trackInfo.type || m_trackInfo.hostility != trackInfo.hostility;
+}
+
+//! record the type and hostility of the track.
+void DisplayTrack::updateClassification(const TrackInformation& trackInfo)
+{
+  m_trackInfo.type = trackInfo.type;
+  m_trackInfo.hostility = trackInfo.hostility;
 }
\ No newline at end of file
@@ -21,38 +21,45 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 
 #include "MapLink.h"
 #include "tsltrackdisplaymanager.h"
+#include "symboltemplatecache.h"
 
 
 struct TrackInformation;
 //!
 //! Display track class contains the track object and symbol and track creation methods.
 //!
+//! The track symbols come from a symbol template cache shared by all the display tracks.
+//!
 class DisplayTrack
 {
 public:
-  DisplayTrack(TSLTrackDisplayManager*  trackManager);
+  DisplayTrack(TSLTrackDisplayManager*  trackManager, SymbolTemplateCache* symbolCache);
+  ~DisplayTrack();
 
-  //! clone symbol template, create a display track or update existing track, and add the track to the track manager.
+  //! get the symbol template, create a display track or update existing track, and add the track to the track manager.
   bool updateDisplayTrack(const TrackInformation& trackInfo);
 
-  //! move the track
-  void moveTrack(double latitude, double longitude);
+  //! move the track and set its heading
+  void moveTrack(double latitude, double longitude, double heading);
+
+  //! get the id of the track
+  uint32_t trackId() const;
 
   //! check if track information has changed
   bool isInformationChanged(const TrackInformation& trackInfo);
 
+  //! check if the type or hostility of the track has changed, which the symbol doesn't always show.
+  bool isClassificationChanged(const TrackInformation& trackInfo) const;
+
+  //! record the type and hostility of the track.
+  void updateClassification(const TrackInformation& trackInfo);
+
   //! remove the track from the track manager
   void removeDisplayTrack();
 
 private:
-  //! create selection symbol (symbol around the track when it is selected).
-  void createDefaultSelectionSymbol();
-
-  //! create a track based on its symbol id and colour.
-  TSLTrackSymbol* createCustomTrackSymbol(uint32_t symbolId, uint32_t color, uint32_t size);
-
-  //! Add entity to the point symbol
-  static void addEntityToPointSymbol(TSLTrackPointSymbol * symbol, int symbolIDVal, int colour, uint32_t size);
+  //! release the symbol template used by the track, if any.
+  void releaseSymbol();
 
   //! display track
   TSLTrack* m_track;
@@ -63,8 +70,11 @@ private:
   //! reference to the track manager
   TSLTrackDisplayManager*  m_trackManager;
 
-  //! default selection symbol template to be re-used for all symbols.
-  static TSLTrackPointSymbol* m_templateSelectionSymbol;
+  //! symbol templates shared by all the display tracks.
+  SymbolTemplateCache* m_symbolCache;
+
+  //! set while the track holds a symbol template of the cache.
+  bool m_hasSymbol;
 };
 
 #endif // DISPLAYTRACKS_H
\ No newline at end of file
@@ -23,6 +23,7 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 #include <QFileInfo>
 #include <QFileDialog>
 #include "mainwindow.h"
+#include "trackbenchmark.h"
 
 int main(int argc, char *argv[])
 {
@@ -35,13 +36,22 @@ int main(int argc, char *argv[])
   QStringList argumentList = app.arguments();
   QString mapFilename;
   QString configFilePath;
+  QString benchmarkName;
   for (int i = 1; i < argumentList.size(); ++i)
   {
     if (argumentList[i].compare("/help", Qt::CaseInsensitive) == 0 ||
       argumentList[i].compare("-help", Qt::CaseInsensitive) == 0)
     {
       QMessageBox::information(NULL, "Help",
-        "Help:\n  SimpleGLSample /home path_to_install\t(The directory containing the config directory)");
+        "Help:\n  SimpleGLSample /home path_to_install\t(The directory containing the config directory)"
+        "\n  SimpleGLSample /benchmark name\t(Run a benchmark with the tracks of the configuration file and exit)"
+        "\n    updates\t(Update time of 10k, 50k and 100k tracks and the snapshot handover time)"
+        "\n    jitter\t(Simulator tick lateness while drawing is slowed down)"
+        "\n    simulation\t(Tracks simulated per second without the display)"
+        "\n    reclassify\t(Symbol templates created and time per change as 50k tracks change type and hostility)"
+        "\n    selection\t(Time to select the tracks in a viewport out of 100k)"
+        "\n    startup\t(Time to load a generated configuration file of 100k tracks)"
+        "\n    trails\t(Vertices drawn and update time of the history trails of 10k tracks against the raw history)");
       return 0;
     }
     else if ((argumentList[i].compare("/home", Qt::CaseInsensitive) == 0 ||
@@ -58,6 +68,13 @@ int main(int argc, char *argv[])
       configFilePath = argumentList[i+1];
       ++i;
     }
+    else if ((argumentList[i].compare("/benchmark", Qt::CaseInsensitive) == 0 ||
+      argumentList[i].compare("-benchmark", Qt::CaseInsensitive) == 0)
+      && i + 1 < argumentList.size())
+    {
+      benchmarkName = argumentList[i + 1];
+      ++i;
+    }
     else
     {
       mapFilename = argumentList[i];
@@ -71,6 +88,12 @@ int main(int argc, char *argv[])
     configFilePath = defaultConfingFileName;
   }
 
+  //! benchmarks run without the main window.
+  if (!benchmarkName.isEmpty())
+  {
+    return runTrackBenchmark(benchmarkName, configFilePath);
+  }
+
   //! If the configurations file does not exist, show a message box.
   bool isConfigFileExists = false;
   do
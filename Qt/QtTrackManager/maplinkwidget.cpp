@@ -101,7 +101,15 @@ bool MapLinkWidget::parseConfigurationFile(const QString &configFilePath, QStrin
   {
     return false;
   }
-  return tracksSimulatorThread->parseConfigurationFile(configFilePath, msgError);
+  if (!tracksSimulatorThread->parseConfigurationFile(configFilePath, msgError))
+  {
+    return false;
+  }
+  if (m_application)
+  {
+    m_application->setSelectionSets(tracksSimulatorThread->getConfigurationSettings().selectionSets());
+  }
+  return true;
 }
 
 //! get configuration settings.
@@ -402,13 +410,9 @@ void MapLinkWidget::ResetInteractionModesCallBack(resetInteractionModesCallBack
 //! handles start thread button click
 bool MapLinkWidget::activateUse_symbolSetsChanged(const QString &symbolSet, QString& msgError)
 {
-  tracksSimulatorThread->m_mutexTracks.lock();
-
   //! change tracks information.
   bool isChanged = tracksSimulatorThread->changeTracksSymbol(symbolSet, msgError);
 
-  tracksSimulatorThread->m_mutexTracks.unlock();
-
   //! update the tracks
   onTracksUpdated();
 
@@ -427,27 +431,26 @@ void MapLinkWidget::activateStopTracks()
 //! handles tracks updated slot sent by the thread
 void MapLinkWidget::onTracksUpdated()
 {
-  tracksSimulatorThread->m_mutexTracks.lock();
+  //! take the latest snapshot of the tracks, if the simulator has published a new one.
+  if (!tracksSimulatorThread->m_snapshots.consume())
+  {
+    return;
+  }
 
-  //! Process and update the track manager with the updated tracks.
-  m_application->processUpdatedTracks(tracksSimulatorThread->m_tracksInformation);
+  //! Collect the changes between the snapshot and the displayed tracks.
+  m_application->collectTrackUpdates(tracksSimulatorThread->m_snapshots.readBuffer().m_tracks);
+
+  //! Apply the collected changes to the track manager.
+  m_application->applyTrackUpdates();
 
   //! redraw the drawing surface.
   m_application->redrawSurface();
-
-  tracksSimulatorThread->m_mutexTracks.unlock();
 }
 
 
 //! handles changing the tracks symbols [config xml/ default]
 void MapLinkWidget::activateStartTracks()
 {
-  //! check if thread is already running.
-  if (tracksSimulatorThread->isRunning())
-  {
-    return;
-  }
-
-  //! start the thread.
-  tracksSimulatorThread->start();
+  //! start the thread, unless it is already running.
+  tracksSimulatorThread->startSimulation();
 }
\ No newline at end of file
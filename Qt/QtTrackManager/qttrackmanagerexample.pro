@@ -73,11 +73,25 @@ FORMS = qttrackmanager.ui
 HEADERS = maplinkwidget.h mainwindow.h application.h \
     configurationsettings.h \
     trackinformation.h \
+    trackupdatebatch.h \
+    tracksnapshotqueue.h \
     displaytrack.h \
+    symboltemplatecache.h \
+    trackselection.h \
+    tracktrails.h \
+    tracktraillayer.h \
     trackssimulator.h \
+    simulationmodel.h \
+    trackbenchmark.h \
     symbolset.h
 SOURCES = main.cpp mainwindow.cpp maplinkwidget.cpp application.cpp \
 	configurationsettings.cpp \
     displaytrack.cpp \
-    trackssimulator.cpp
+    symboltemplatecache.cpp \
+    trackselection.cpp \
+    tracktrails.cpp \
+    tracktraillayer.cpp \
+    trackssimulator.cpp \
+    simulationmodel.cpp \
+    trackbenchmark.cpp
 RESOURCES = MapLink.qrc
@@ -0,0 +1,323 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#include <math.h>
+#include "simulationmodel.h"
+#include "configurationsettings.h"
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+//! mean radius of the Earth in metres.
+static const double earthRadius = 6371008.8;
+
+//! degrees to radians.
+static const double degToRad = M_PI / 180.0;
+
+//! turn rate range of the manoeuvres in radians per second.
+static const double minTurnRate = 0.5 * degToRad;
+static const double maxTurnRate = 3.0 * degToRad;
+
+//! length range of the manoeuvre legs in seconds.
+static const double minLegTime = 10.0;
+static const double maxLegTime = 60.0;
+
+//! leg length of the zigzag manoeuvre in seconds.
+static const double zigzagLegTime = 20.0;
+
+//! normalise a 3D vector.
+static void normalise(double v[3])
+{
+  double length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (length > 0.0)
+  {
+    v[0] /= length;
+    v[1] /= length;
+    v[2] /= length;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! Random numbers
+///////////////////////////////////////////////////////////////////////////
+SimulationRandom::SimulationRandom(uint64_t seed)
+{
+  this->seed(seed);
+}
+
+//! restart the sequence from the given seed.
+void SimulationRandom::seed(uint64_t seed)
+{
+  //! scramble the seed (splitmix64) so that nearby seeds give unrelated sequences; the state must not be zero.
+  uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z = z ^ (z >> 31);
+  m_state = z ? z : 0x9e3779b97f4a7c15ULL;
+}
+
+//! next raw 64 bit value.
+uint64_t SimulationRandom::next()
+{
+  m_state ^= m_state >> 12;
+  m_state ^= m_state << 25;
+  m_state ^= m_state >> 27;
+  return m_state * 0x2545f4914f6cdd1dULL;
+}
+
+//! uniform value in [0, 1).
+double SimulationRandom::uniform()
+{
+  return (next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//! uniform value in [min, max).
+double SimulationRandom::uniform(double min, double max)
+{
+  return min + (max - min) * uniform();
+}
+
+//! normally distributed value.
+double SimulationRandom::normal(double mean, double stddev)
+{
+  //! Box-Muller transform.
+  double u1 = 1.0 - uniform();
+  double u2 = uniform();
+  return mean + stddev * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+//! uniform integer in [0, n).
+uint32_t SimulationRandom::below(uint32_t n)
+{
+  return n ? static_cast<uint32_t>(uniform() * n) : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! Motion model
+///////////////////////////////////////////////////////////////////////////
+SimulationModel::SimulationModel()
+  : m_stepSeconds(0.0)
+{
+}
+
+//! remove all the tracks and restart the random sequence from the given seed.
+void SimulationModel::reset(uint64_t seed)
+{
+  m_motion.clear();
+  m_stepSeconds = 0.0;
+  m_random.seed(seed);
+}
+
+//! add the motion of a track, using its position, heading and speed.
+void SimulationModel::addTrack(const TrackInformation &track, ManoeuvreProfile profile)
+{
+  double lat = track.lat * degToRad;
+  double lon = track.lon * degToRad;
+  double heading = track.heading * degToRad;
+
+  double sinLat = sin(lat), cosLat = cos(lat);
+  double sinLon = sin(lon), cosLon = cos(lon);
+
+  //! local north and east directions at the position.
+  double north[3] = { -sinLat * cosLon, -sinLat * sinLon, cosLat };
+  double east[3] = { -sinLon, cosLon, 0.0 };
+
+  TrackMotion motion;
+  motion.m_p[0] = cosLat * cosLon;
+  motion.m_p[1] = cosLat * sinLon;
+  motion.m_p[2] = sinLat;
+  for (int i = 0; i < 3; ++i)
+  {
+    motion.m_t[i] = north[i] * cos(heading) + east[i] * sin(heading);
+  }
+  motion.m_angularSpeed = track.speed / earthRadius;
+  motion.m_turnRate = 0.0;
+  motion.m_legTime = 0.0;
+  motion.m_profile = profile;
+
+  startLeg(motion);
+  updateStep(motion);
+  m_motion.push_back(motion);
+}
+
+//! generate the tracks described by the scenario, appending them to tracks.
+void SimulationModel::generateTracks(const ScenarioSettings &scenario, uint32_t firstId, uint16_t numTypes, uint16_t numHostilities,
+  std::vector<TrackInformation> &tracks)
+{
+  tracks.reserve(tracks.size() + scenario.m_trackCount);
+  m_motion.reserve(m_motion.size() + scenario.m_trackCount);
+
+  //! pick latitudes uniformly by area rather than by angle.
+  double minSinLat = sin(scenario.m_minLat * degToRad);
+  double maxSinLat = sin(scenario.m_maxLat * degToRad);
+
+  double meanSpeed = (scenario.m_minSpeed + scenario.m_maxSpeed) / 2.0;
+  double speedStddev = (scenario.m_maxSpeed - scenario.m_minSpeed) / 6.0;
+
+  for (uint32_t i = 0; i < scenario.m_trackCount; ++i)
+  {
+    TrackInformation track = TrackInformation();
+    track.id = firstId + i;
+    track.lat = asin(m_random.uniform(minSinLat, maxSinLat)) / degToRad;
+    track.lon = m_random.uniform(scenario.m_minLon, scenario.m_maxLon);
+    track.heading = m_random.uniform(0.0, 360.0);
+
+    if (scenario.m_speedDistribution == ScenarioSettings::SpeedDistributionNormal)
+    {
+      track.speed = m_random.normal(meanSpeed, speedStddev);
+      track.speed = track.speed < scenario.m_minSpeed ? scenario.m_minSpeed : track.speed;
+      track.speed = track.speed > scenario.m_maxSpeed ? scenario.m_maxSpeed : track.speed;
+    }
+    else
+    {
+      track.speed = m_random.uniform(scenario.m_minSpeed, scenario.m_maxSpeed);
+    }
+
+    track.type = static_cast<uint16_t>(m_random.below(numTypes));
+    track.hostility = static_cast<uint16_t>(m_random.below(numHostilities));
+
+    ManoeuvreProfile profile = static_cast<ManoeuvreProfile>(m_random.below(ManoeuvreProfileCount));
+    addTrack(track, profile);
+    tracks.push_back(track);
+  }
+}
+
+//! advance all the tracks by the given number of seconds.
+void SimulationModel::step(double seconds, std::vector<TrackInformation> &tracks)
+{
+  //! the rotations only need recomputing when the step length changes.
+  const bool stepChanged = (seconds != m_stepSeconds);
+  m_stepSeconds = seconds;
+
+  const size_t numTracks = tracks.size() < m_motion.size() ? tracks.size() : m_motion.size();
+  for (size_t i = 0; i < numTracks; ++i)
+  {
+    TrackMotion& motion = m_motion[i];
+    double* p = motion.m_p;
+    double* t = motion.m_t;
+
+    //! manoeuvre. Starting a new leg changes the turn rate of this track only.
+    bool motionChanged = stepChanged;
+    if (motion.m_profile != ManoeuvreStraight && motion.m_profile != ManoeuvreTurn)
+    {
+      motion.m_legTime -= seconds;
+      if (motion.m_legTime <= 0.0)
+      {
+        startLeg(motion);
+        motionChanged = true;
+      }
+    }
+    if (motionChanged)
+    {
+      updateStep(motion);
+    }
+
+    //! move along the great circle: rotate p and t in their common plane.
+    double cm = motion.m_cosMove, sm = motion.m_sinMove;
+    double np[3] = { p[0] * cm + t[0] * sm, p[1] * cm + t[1] * sm, p[2] * cm + t[2] * sm };
+    double nt[3] = { t[0] * cm - p[0] * sm, t[1] * cm - p[1] * sm, t[2] * cm - p[2] * sm };
+
+    //! turn: rotate t about p. (p x t) points to the left of the direction of travel.
+    if (motion.m_turnRate != 0.0)
+    {
+      double left[3] = {
+        np[1] * nt[2] - np[2] * nt[1],
+        np[2] * nt[0] - np[0] * nt[2],
+        np[0] * nt[1] - np[1] * nt[0] };
+      double ct = motion.m_cosTurn, st = motion.m_sinTurn;
+      for (int k = 0; k < 3; ++k)
+      {
+        nt[k] = nt[k] * ct - left[k] * st;
+      }
+    }
+
+    //! keep the vectors unit length and orthogonal against rounding drift.
+    normalise(np);
+    double dot = np[0] * nt[0] + np[1] * nt[1] + np[2] * nt[2];
+    for (int k = 0; k < 3; ++k)
+    {
+      nt[k] -= np[k] * dot;
+    }
+    normalise(nt);
+
+    for (int k = 0; k < 3; ++k)
+    {
+      p[k] = np[k];
+      t[k] = nt[k];
+    }
+
+    //! convert back to latitude, longitude and heading.
+    double cosLat = sqrt(p[0] * p[0] + p[1] * p[1]);
+    double sinLat = p[2];
+    TrackInformation& track = tracks[i];
+    track.lat = atan2(sinLat, cosLat) / degToRad;
+    if (cosLat > 1e-12)
+    {
+      double cosLon = p[0] / cosLat;
+      double sinLon = p[1] / cosLat;
+      track.lon = atan2(sinLon, cosLon) / degToRad;
+
+      double northComponent = -sinLat * cosLon * t[0] - sinLat * sinLon * t[1] + cosLat * t[2];
+      double eastComponent = -sinLon * t[0] + cosLon * t[1];
+      double heading = atan2(eastComponent, northComponent) / degToRad;
+      track.heading = (heading < 0.0) ? heading + 360.0 : heading;
+    }
+  }
+}
+
+//! start a new leg of the track's manoeuvre.
+void SimulationModel::startLeg(TrackMotion &motion)
+{
+  switch (motion.m_profile)
+  {
+  case ManoeuvreTurn:
+    //! a constant turn, either way
+    motion.m_turnRate = m_random.uniform(minTurnRate, maxTurnRate) * (m_random.below(2) ? 1.0 : -1.0);
+    motion.m_legTime = 0.0;
+    break;
+
+  case ManoeuvreZigzag:
+    //! reverse the turn of the previous leg
+    motion.m_turnRate = (motion.m_turnRate > 0.0) ? -maxTurnRate : maxTurnRate;
+    motion.m_legTime += zigzagLegTime;
+    break;
+
+  case ManoeuvreRandomWalk:
+    motion.m_turnRate = m_random.uniform(-maxTurnRate, maxTurnRate);
+    motion.m_legTime += m_random.uniform(minLegTime, maxLegTime);
+    break;
+
+  case ManoeuvreStraight:
+  default:
+    motion.m_turnRate = 0.0;
+    motion.m_legTime = 0.0;
+    break;
+  }
+}
+
+//! recompute the cached rotations of the track for the current step length.
+void SimulationModel::updateStep(TrackMotion &motion)
+{
+  double move = motion.m_angularSpeed * m_stepSeconds;
+  double turn = motion.m_turnRate * m_stepSeconds;
+  motion.m_cosMove = cos(move);
+  motion.m_sinMove = sin(move);
+  motion.m_cosTurn = cos(turn);
+  motion.m_sinTurn = sin(turn);
+}
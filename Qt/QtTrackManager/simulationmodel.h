@@ -0,0 +1,143 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#ifndef SIMULATIONMODEL_H
+#define SIMULATIONMODEL_H
+
+#include <vector>
+#include "trackinformation.h"
+
+struct ScenarioSettings;
+
+//!
+//! Seeded pseudo random number generator (xorshift64*).
+//!
+//! The standard library distributions are implementation defined, so the generator and
+//! its distributions are implemented here to replay a scenario identically for the same
+//! seed on every platform.
+//!
+class SimulationRandom
+{
+public:
+  explicit SimulationRandom(uint64_t seed = 1);
+
+  //! restart the sequence from the given seed.
+  void seed(uint64_t seed);
+
+  //! next raw 64 bit value.
+  uint64_t next();
+
+  //! uniform value in [0, 1).
+  double uniform();
+
+  //! uniform value in [min, max).
+  double uniform(double min, double max);
+
+  //! normally distributed value.
+  double normal(double mean, double stddev);
+
+  //! uniform integer in [0, n).
+  uint32_t below(uint32_t n);
+
+private:
+  uint64_t m_state;
+};
+
+//! How a track changes its heading over time.
+enum ManoeuvreProfile
+{
+  //! keep flying along the same great circle.
+  ManoeuvreStraight,
+  //! turn at a constant rate.
+  ManoeuvreTurn,
+  //! alternate between turning left and right at fixed intervals.
+  ManoeuvreZigzag,
+  //! pick a new random turn rate at random intervals.
+  ManoeuvreRandomWalk,
+
+  ManoeuvreProfileCount
+};
+
+//!
+//! Motion model of the simulated tracks.
+//!
+//! Each track's position and direction of travel are held as unit vectors on the sphere, so
+//! moving along a great circle and turning are rotations which need no trigonometry beyond
+//! converting the result back to latitude, longitude and heading. The motion state is kept
+//! in an array parallel to the simulator's tracks.
+//!
+class SimulationModel
+{
+public:
+  SimulationModel();
+
+  //! remove all the tracks and restart the random sequence from the given seed.
+  void reset(uint64_t seed);
+
+  //! add the motion of a track, using its position, heading and speed.
+  void addTrack(const TrackInformation& track, ManoeuvreProfile profile);
+
+  //! generate the tracks described by the scenario, appending them to tracks.
+  //! Track ids start at firstId, types and hostilities are chosen from the given number of codes.
+  void generateTracks(const ScenarioSettings& scenario, uint32_t firstId, uint16_t numTypes, uint16_t numHostilities,
+    std::vector<TrackInformation>& tracks);
+
+  //! advance all the tracks by the given number of seconds.
+  void step(double seconds, std::vector<TrackInformation>& tracks);
+
+private:
+  //! motion state of one track.
+  struct TrackMotion
+  {
+    //! position as a unit vector.
+    double m_p[3];
+    //! direction of travel as a unit vector tangent to the sphere at the position.
+    double m_t[3];
+    //! speed in radians per second.
+    double m_angularSpeed;
+    //! turn rate in radians per second, positive to the right.
+    double m_turnRate;
+    //! seconds left in the current leg of the manoeuvre.
+    double m_legTime;
+    //! cosine and sine of the distance moved in one step.
+    double m_cosMove;
+    double m_sinMove;
+    //! cosine and sine of the angle turned in one step.
+    double m_cosTurn;
+    double m_sinTurn;
+    //! manoeuvre profile.
+    ManoeuvreProfile m_profile;
+  };
+
+  //! start a new leg of the track's manoeuvre.
+  void startLeg(TrackMotion& motion);
+
+  //! recompute the cached rotations of the track for the current step length.
+  void updateStep(TrackMotion& motion);
+
+  //! motion of each track, in the same order as the simulator's tracks.
+  std::vector<TrackMotion> m_motion;
+
+  //! length of the step the cached rotations were computed for.
+  double m_stepSeconds;
+
+  //! random numbers for the scenario generation and manoeuvres.
+  SimulationRandom m_random;
+};
+
+#endif // SIMULATIONMODEL_H
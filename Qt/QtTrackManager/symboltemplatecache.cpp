@@ -0,0 +1,179 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#include "symboltemplatecache.h"
+#include "tslsymbol.h"
+#include "tslrenderingattributes.h"
+
+SymbolTemplateCache::SymbolTemplateCache(size_t maxTemplates)
+  : m_maxTemplates(maxTemplates)
+  , m_selectionSymbol(nullptr)
+{
+  m_statistics.m_hits = 0;
+  m_statistics.m_misses = 0;
+  m_statistics.m_evictions = 0;
+  m_statistics.m_templates = 0;
+  m_statistics.m_templatesInUse = 0;
+}
+
+SymbolTemplateCache::~SymbolTemplateCache()
+{
+  clear();
+}
+
+//! get the template for the symbol, creating it if needed. Each acquire must be matched by a release.
+TSLTrackSymbol* SymbolTemplateCache::acquire(uint32_t symbolId, uint32_t colour, uint32_t size)
+{
+  Key key = { symbolId, colour, size };
+  auto it = m_entries.find(key);
+  if (it != m_entries.end())
+  {
+    ++m_statistics.m_hits;
+    Entry& entry = it->second;
+    if (entry.m_refCount++ == 0)
+    {
+      m_unused.erase(entry.m_unusedPosition);
+      ++m_statistics.m_templatesInUse;
+    }
+    return entry.m_symbol;
+  }
+
+  ++m_statistics.m_misses;
+  Entry entry;
+  entry.m_symbol = createTemplate(key);
+  entry.m_refCount = 1;
+  entry.m_unusedPosition = m_unused.end();
+  m_entries.insert(std::make_pair(key, entry));
+  ++m_statistics.m_templatesInUse;
+
+  evict();
+  return entry.m_symbol;
+}
+
+//! stop using the template for the symbol.
+void SymbolTemplateCache::release(uint32_t symbolId, uint32_t colour, uint32_t size)
+{
+  Key key = { symbolId, colour, size };
+  auto it = m_entries.find(key);
+  if (it == m_entries.end() || it->second.m_refCount == 0)
+  {
+    return;
+  }
+
+  Entry& entry = it->second;
+  if (--entry.m_refCount == 0)
+  {
+    entry.m_unusedPosition = m_unused.insert(m_unused.end(), key);
+    --m_statistics.m_templatesInUse;
+    evict();
+  }
+}
+
+//! set the number of templates above which unused templates are destroyed.
+void SymbolTemplateCache::setMaxTemplates(size_t maxTemplates)
+{
+  m_maxTemplates = maxTemplates;
+  evict();
+}
+
+//! get the cache statistics.
+SymbolTemplateCache::Statistics SymbolTemplateCache::statistics() const
+{
+  Statistics statistics = m_statistics;
+  statistics.m_templates = m_entries.size();
+  return statistics;
+}
+
+//! destroy all the templates. Tracks keep their copies, but must release the templates they acquired.
+void SymbolTemplateCache::clear()
+{
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    it->second.m_symbol->destroy();
+  }
+  m_entries.clear();
+  m_unused.clear();
+  m_statistics.m_templatesInUse = 0;
+
+  if (m_selectionSymbol)
+  {
+    m_selectionSymbol->destroy();
+    m_selectionSymbol = nullptr;
+  }
+}
+
+//! create the symbol of a template.
+TSLTrackSymbol* SymbolTemplateCache::createTemplate(const Key &key)
+{
+  //! create selection symbol (symbol around the track when it is selected).
+  createSelectionSymbol();
+
+  //! create track symbol (point symbol)
+  TSLTrackPointSymbol* pointSymbol(TSLTrackPointSymbol::create());
+  addEntityToPointSymbol(pointSymbol, key.m_symbolId, key.m_colour, key.m_size);
+
+  //! set a copy of the selection symbol to the track symbol, so the template owns all of its parts.
+  pointSymbol->selectionSymbol((TSLTrackPointSymbol*)m_selectionSymbol->clone(), TSLTrackSymbol::SelectionBehaviourAdditional);
+
+  return pointSymbol;
+}
+
+//! destroy unused templates, least recently used first, until within the cap.
+void SymbolTemplateCache::evict()
+{
+  while (m_entries.size() > m_maxTemplates && !m_unused.empty())
+  {
+    auto it = m_entries.find(m_unused.front());
+    it->second.m_symbol->destroy();
+    m_entries.erase(it);
+    m_unused.pop_front();
+    ++m_statistics.m_evictions;
+  }
+}
+
+void SymbolTemplateCache::createSelectionSymbol()
+{
+  if (!m_selectionSymbol)
+  {
+    m_selectionSymbol = (TSLTrackPointSymbol::create());
+
+    TSLSymbol* symbol = TSLSymbol::create(0, 0, 0);
+    symbol->setRendering(TSLRenderingAttributeSymbolStyle, 3);
+    symbol->setRendering(TSLRenderingAttributeSymbolColour, 0x0000ffff);
+    symbol->setRendering(TSLRenderingAttributeSymbolSizeFactor, 70);
+    symbol->setRendering(TSLRenderingAttributeSymbolSizeFactorUnits, TSLDimensionUnitsPixels);
+    m_selectionSymbol->addSymbolEntity(symbol, false);
+    symbol->destroy();
+  }
+}
+
+void SymbolTemplateCache::addEntityToPointSymbol(TSLTrackPointSymbol * symbol, int symbolIDVal, int colour, uint32_t size)
+{
+  TSLSymbol* sym = TSLSymbol::create(0, 0, 0);
+  TSLRenderingAttributes attribs;
+  attribs.m_symbolStyle = symbolIDVal;
+  attribs.m_symbolColour = colour;
+  attribs.m_symbolSizeFactor = size;
+  attribs.m_symbolSizeFactorUnits = TSLDimensionUnitsPixels;
+  attribs.m_symbolOpacity = 32767;
+  attribs.m_symbolScalable = TSLRasterSymbolScalableEnabled;
+  attribs.m_symbolRotatable = TSLSymbolRotationDisabled;
+  sym->setRendering(attribs);
+  symbol->addSymbolEntity(sym, false);
+  sym->destroy();
+}
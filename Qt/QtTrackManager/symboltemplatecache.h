@@ -0,0 +1,138 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#ifndef SYMBOLTEMPLATECACHE_H
+#define SYMBOLTEMPLATECACHE_H
+
+#include <list>
+#include <unordered_map>
+#include "MapLink.h"
+#include "tsltrackdisplaymanager.h"
+
+//!
+//! Cache of the track symbol templates shared by all the display tracks.
+//!
+//! Tracks with the same symbol id, colour and size are given copies of the same template,
+//! so a track changing to a combination already in use clones it rather than building a
+//! new symbol. The templates are owned by the cache and never by a track, so destroying one
+//! leaves the tracks' copies alone. Templates are reference counted by the display tracks
+//! using them; templates no longer in use stay cached, least recently used first, until
+//! the number of templates exceeds the cap.
+//!
+class SymbolTemplateCache
+{
+public:
+  //! cache statistics.
+  struct Statistics
+  {
+    //! requests served by an existing template.
+    uint64_t m_hits;
+    //! requests which created a new template.
+    uint64_t m_misses;
+    //! templates destroyed to keep within the cap.
+    uint64_t m_evictions;
+    //! templates currently cached.
+    size_t m_templates;
+    //! templates currently used by at least one track.
+    size_t m_templatesInUse;
+  };
+
+  //! maxTemplates is the number of templates above which unused templates are destroyed.
+  explicit SymbolTemplateCache(size_t maxTemplates = 256);
+  ~SymbolTemplateCache();
+
+  //! get the template for the symbol, creating it if needed. Each acquire must be matched by a release.
+  //! The template remains owned by the cache, so tracks are given a clone of it.
+  TSLTrackSymbol* acquire(uint32_t symbolId, uint32_t colour, uint32_t size);
+
+  //! stop using the template for the symbol.
+  void release(uint32_t symbolId, uint32_t colour, uint32_t size);
+
+  //! set the number of templates above which unused templates are destroyed.
+  void setMaxTemplates(size_t maxTemplates);
+
+  //! get the cache statistics.
+  Statistics statistics() const;
+
+  //! destroy all the templates. Tracks keep their copies, but must release the templates they acquired.
+  void clear();
+
+private:
+  //! key of a template.
+  struct Key
+  {
+    uint32_t m_symbolId;
+    uint32_t m_colour;
+    uint32_t m_size;
+
+    bool operator==(const Key& other) const
+    {
+      return m_symbolId == other.m_symbolId && m_colour == other.m_colour && m_size == other.m_size;
+    }
+  };
+
+  //! hash of a template key.
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const
+    {
+      uint64_t hash = key.m_symbolId;
+      hash = hash * 0x9e3779b97f4a7c15ULL ^ key.m_colour;
+      hash = hash * 0x9e3779b97f4a7c15ULL ^ key.m_size;
+      return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+  };
+
+  //! cached template.
+  struct Entry
+  {
+    TSLTrackSymbol* m_symbol;
+    uint32_t m_refCount;
+    //! position in the unused list while the reference count is zero.
+    std::list<Key>::iterator m_unusedPosition;
+  };
+
+  //! create the symbol of a template.
+  TSLTrackSymbol* createTemplate(const Key& key);
+
+  //! destroy unused templates, least recently used first, until within the cap.
+  void evict();
+
+  //! create selection symbol (symbol around the track when it is selected).
+  void createSelectionSymbol();
+
+  //! Add entity to the point symbol
+  static void addEntityToPointSymbol(TSLTrackPointSymbol * symbol, int symbolIDVal, int colour, uint32_t size);
+
+  //! cached templates.
+  std::unordered_map<Key, Entry, KeyHash> m_entries;
+
+  //! keys of the unused templates, least recently used first.
+  std::list<Key> m_unused;
+
+  //! number of templates above which unused templates are destroyed.
+  size_t m_maxTemplates;
+
+  //! cache statistics.
+  Statistics m_statistics;
+
+  //! default selection symbol template to be re-used for all symbols.
+  TSLTrackPointSymbol* m_selectionSymbol;
+};
+
+#endif // SYMBOLTEMPLATECACHE_H
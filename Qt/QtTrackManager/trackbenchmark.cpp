@@ -0,0 +1,651 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free 
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT 
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more 
+details.
+
+You should have received a copy of the GNU Lesser General Public License 
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QThread>
+#include <math.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "trackbenchmark.h"
+#include "application.h"
+#include "configurationsettings.h"
+#include "simulationmodel.h"
+#include "tracksnapshotqueue.h"
+#include "trackssimulator.h"
+#include "trackselection.h"
+#include "tracktrails.h"
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+//! mean radius of the Earth in metres.
+static const double earthRadius = 6371008.8;
+
+//! length of a simulated tick in seconds.
+static const double tickSeconds = 0.05;
+
+//! mean and longest of a series of timings.
+struct TimingStatistics
+{
+  TimingStatistics()
+    : m_total(0)
+    , m_longest(0)
+    , m_count(0)
+  {
+  }
+
+  //! add a timing in nanoseconds.
+  void add(qint64 nsecs)
+  {
+    m_total += nsecs;
+    m_longest = std::max(m_longest, nsecs);
+    ++m_count;
+  }
+
+  //! mean in milliseconds.
+  double mean() const
+  {
+    return m_count ? m_total / (1000000.0 * m_count) : 0.0;
+  }
+
+  //! longest in milliseconds.
+  double longest() const
+  {
+    return m_longest / 1000000.0;
+  }
+
+  qint64 m_total;
+  qint64 m_longest;
+  int m_count;
+};
+
+//! write a timing line.
+static void printTiming(const char* name, const TimingStatistics& timing)
+{
+  std::cout << "  " << name << ": mean " << timing.mean() << " ms, longest " << timing.longest() << " ms" << std::endl;
+}
+
+//! read the configuration file and generate numTracks tracks from its scenario, with the
+//! symbols of its default symbol set. The track ids start at 0.
+static bool generateTracks(const QString& configFilePath, uint32_t numTracks, ConfigurationSettings& config,
+  SimulationModel& model, std::vector<TrackInformation>& tracks)
+{
+  QString msgError;
+  std::vector<TrackInformation> configTracks;
+  if (!config.parseConfigFile(configFilePath, configTracks, msgError))
+  {
+    std::cerr << "Configuration file not parsed: " << msgError.toStdString() << std::endl;
+    return false;
+  }
+
+  ScenarioSettings scenario = config.scenario();
+  scenario.m_trackCount = numTracks;
+  model.reset(scenario.m_seed);
+  tracks.clear();
+  model.generateTracks(scenario, 0,
+    static_cast<uint16_t>(config.typeNames().size()), static_cast<uint16_t>(config.hostilityNames().size()), tracks);
+  if (!config.updateTracks(tracks, config.defaultSymbolSet(), msgError))
+  {
+    std::cerr << msgError.toStdString() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! updates
+///////////////////////////////////////////////////////////////////////////
+static int runUpdateBenchmark(const QString& configFilePath)
+{
+  static const uint32_t trackCounts[] = { 10000, 50000, 100000 };
+  static const int numTicks = 50;
+
+  //! the track manager is not attached to a drawing surface, so the time measured is
+  //! the time taken to update the tracks without drawing them.
+  Application application(NULL);
+  application.createTrackManager();
+
+  ConfigurationSettings config;
+  SimulationModel model;
+  std::vector<TrackInformation> tracks;
+  TrackSnapshotQueue snapshots;
+  QElapsedTimer timer;
+  uint64_t tick = 0;
+
+  for (uint32_t numTracks : trackCounts)
+  {
+    if (!generateTracks(configFilePath, numTracks, config, model, tracks))
+    {
+      return 1;
+    }
+
+    //! the first tick creates the tracks added since the previous track count.
+    TimingStatistics publish, consume, collect, apply, create;
+    for (int i = 0; i <= numTicks; ++i)
+    {
+      model.step(tickSeconds, tracks);
+
+      //! simulator thread: copy the tracks into the snapshot and publish it. The threads hand
+      //! the snapshots over without a lock, so this and taking the snapshot are the only
+      //! time either thread spends on the handover.
+      timer.start();
+      TracksSnapshot& snapshot = snapshots.writeBuffer();
+      snapshot.m_tick = ++tick;
+      snapshot.m_tracks.assign(tracks.begin(), tracks.end());
+      snapshots.publish();
+      qint64 publishTime = timer.nsecsElapsed();
+
+      //! display thread: take the snapshot and update the track manager from it.
+      timer.restart();
+      snapshots.consume();
+      qint64 consumeTime = timer.nsecsElapsed();
+
+      timer.restart();
+      application.collectTrackUpdates(snapshots.readBuffer().m_tracks);
+      qint64 collectTime = timer.nsecsElapsed();
+
+      timer.restart();
+      application.applyTrackUpdates();
+      qint64 applyTime = timer.nsecsElapsed();
+
+      if (i == 0)
+      {
+        create.add(collectTime + applyTime);
+        continue;
+      }
+      publish.add(publishTime);
+      consume.add(consumeTime);
+      collect.add(collectTime);
+      apply.add(applyTime);
+    }
+
+    std::cout << numTracks << " tracks, " << numTicks << " ticks" << std::endl;
+    printTiming("first update, creating the tracks", create);
+    printTiming("collect the changes", collect);
+    printTiming("apply to the track manager", apply);
+    printTiming("simulator: copy and publish the snapshot", publish);
+    printTiming("display: take the snapshot", consume);
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! jitter
+///////////////////////////////////////////////////////////////////////////
+static int runJitterBenchmark(const QString& configFilePath)
+{
+  //! time each display takes to draw a snapshot, from not drawing at all to far slower than the ticks.
+  static const int drawTimes[] = { 0, 100, 500 };
+  static const int runTime = 5000;
+
+  for (int drawTime : drawTimes)
+  {
+    TracksSimulator simulator;
+    QString msgError;
+    if (!simulator.parseConfigurationFile(configFilePath, msgError))
+    {
+      std::cerr << "Configuration file not parsed: " << msgError.toStdString() << std::endl;
+      return 1;
+    }
+
+    //! this thread stands in for the display: it takes each snapshot and then sleeps for the draw time.
+    QElapsedTimer clock;
+    clock.start();
+    simulator.startSimulation();
+    int numDrawn = 0;
+    while (clock.elapsed() < runTime)
+    {
+      if (simulator.m_snapshots.consume())
+      {
+        ++numDrawn;
+        QThread::msleep(drawTime);
+      }
+      else
+      {
+        QThread::msleep(1);
+      }
+    }
+
+    simulator.m_mutexAbort.lock();
+    simulator.m_abort = true;
+    simulator.m_mutexAbort.unlock();
+    simulator.wait();
+    qint64 elapsed = clock.elapsed();
+
+    std::cout << "Draw time " << drawTime << " ms, " << simulator.getConfigurationSettings().scenario().m_trackCount
+              << " generated tracks, tick interval " << simulator.tickInterval() << " ms" << std::endl
+              << "  ticks: " << simulator.numTicks() << " of " << elapsed / simulator.tickInterval() << " scheduled"
+              << ", snapshots drawn: " << numDrawn << std::endl
+              << "  longest tick lateness: " << simulator.maxTickLateness() / 1000.0 << " ms" << std::endl;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! simulation
+///////////////////////////////////////////////////////////////////////////
+static int runSimulationBenchmark(const QString& configFilePath)
+{
+  static const uint32_t trackCounts[] = { 10000, 100000, 200000 };
+  static const int numTicks = 200;
+
+  ConfigurationSettings config;
+  SimulationModel model;
+  std::vector<TrackInformation> tracks;
+  QElapsedTimer timer;
+
+  for (uint32_t numTracks : trackCounts)
+  {
+    if (!generateTracks(configFilePath, numTracks, config, model, tracks))
+    {
+      return 1;
+    }
+
+    timer.start();
+    for (int i = 0; i < numTicks; ++i)
+    {
+      model.step(tickSeconds, tracks);
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+
+    double tracksPerSecond = static_cast<double>(numTracks) * numTicks * 1000000000.0 / elapsed;
+    std::cout << numTracks << " tracks, " << numTicks << " ticks" << std::endl
+              << "  time per tick: " << elapsed / (1000000.0 * numTicks) << " ms" << std::endl
+              << "  tracks simulated per second: " << tracksPerSecond << std::endl;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! reclassify
+///////////////////////////////////////////////////////////////////////////
+static int runReclassifyBenchmark(const QString& configFilePath)
+{
+  static const uint32_t numTracks = 50000;
+  static const int numRounds = 20;
+  static const uint32_t changesPerRound = 5000;
+
+  Application application(NULL);
+  application.createTrackManager();
+
+  ConfigurationSettings config;
+  SimulationModel model;
+  std::vector<TrackInformation> tracks;
+  if (!generateTracks(configFilePath, numTracks, config, model, tracks))
+  {
+    return 1;
+  }
+  const uint32_t numTypes = static_cast<uint32_t>(config.typeNames().size());
+  const uint32_t numHostilities = static_cast<uint32_t>(config.hostilityNames().size());
+
+  //! create the tracks, then time updates with no change to find the cost of the rest of an update.
+  application.collectTrackUpdates(tracks);
+  application.applyTrackUpdates();
+  QElapsedTimer timer;
+  TimingStatistics unchanged;
+  for (int i = 0; i < numRounds; ++i)
+  {
+    timer.start();
+    application.collectTrackUpdates(tracks);
+    application.applyTrackUpdates();
+    unchanged.add(timer.nsecsElapsed());
+  }
+
+  //! each round gives random tracks a random type and hostility.
+  SimulationRandom random(1);
+  QString msgError;
+  SymbolTemplateCache::Statistics before = application.symbolCacheStatistics();
+  TimingStatistics changed;
+  for (int i = 0; i < numRounds; ++i)
+  {
+    for (uint32_t change = 0; change < changesPerRound; ++change)
+    {
+      TrackInformation& track = tracks[random.below(numTracks)];
+      track.type = static_cast<uint16_t>(random.below(numTypes));
+      track.hostility = static_cast<uint16_t>(random.below(numHostilities));
+    }
+    config.updateTracks(tracks, config.defaultSymbolSet(), msgError);
+
+    timer.start();
+    application.collectTrackUpdates(tracks);
+    application.applyTrackUpdates();
+    changed.add(timer.nsecsElapsed());
+  }
+  SymbolTemplateCache::Statistics after = application.symbolCacheStatistics();
+
+  //! a change may give a track the symbol it already had, which is not counted as a change by the update.
+  const double numChanges = static_cast<double>(numRounds) * changesPerRound;
+  const double timePerChange = (changed.m_total - unchanged.m_total) / numChanges;
+  std::cout << numTracks << " tracks, " << changesPerRound << " reclassifications per update, " << numRounds << " updates" << std::endl;
+  printTiming("update with no change", unchanged);
+  printTiming("update with reclassifications", changed);
+  std::cout << "  time per reclassification: " << timePerChange / 1000.0 << " us" << std::endl
+            << "  templates created: " << after.m_misses - before.m_misses
+            << " (" << (after.m_misses - before.m_misses) / numChanges << " per reclassification)" << std::endl
+            << "  templates reused: " << after.m_hits - before.m_hits << std::endl
+            << "  templates destroyed by the cap: " << after.m_evictions - before.m_evictions << std::endl
+            << "  templates cached: " << after.m_templates << ", in use: " << after.m_templatesInUse << std::endl;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! selection
+///////////////////////////////////////////////////////////////////////////
+static int runSelectionBenchmark(const QString& configFilePath)
+{
+  static const uint32_t numTracks = 100000;
+  static const int numSelections = 100;
+
+  ConfigurationSettings config;
+  SimulationModel model;
+  std::vector<TrackInformation> tracks;
+  if (!generateTracks(configFilePath, numTracks, config, model, tracks))
+  {
+    return 1;
+  }
+
+  //! the handles are the track indexes, as they are for the first tracks added to the application.
+  TrackSelection selection;
+  for (uint32_t i = 0; i < numTracks; ++i)
+  {
+    const TrackInformation& track = tracks[i];
+    selection.setTrack(static_cast<int32_t>(i), track.id, track.type, track.hostility, track.lat, track.lon);
+  }
+
+  //! a viewport over a quarter of the scenario's area, centred in it.
+  const ScenarioSettings& scenario = config.scenario();
+  TrackSelectionCriteria viewport;
+  viewport.m_useRegion = true;
+  viewport.m_minLat = scenario.m_minLat + (scenario.m_maxLat - scenario.m_minLat) / 4.0;
+  viewport.m_maxLat = scenario.m_maxLat - (scenario.m_maxLat - scenario.m_minLat) / 4.0;
+  viewport.m_minLon = scenario.m_minLon + (scenario.m_maxLon - scenario.m_minLon) / 4.0;
+  viewport.m_maxLon = scenario.m_maxLon - (scenario.m_maxLon - scenario.m_minLon) / 4.0;
+
+  //! select the viewport after every tick, so the spatial index is rebuilt each time, and
+  //! again without moving the tracks, so the index is reused.
+  QElapsedTimer timer;
+  TimingStatistics moved, unmoved, changes;
+  size_t numMatches = 0, numChanges = 0;
+  for (int i = 0; i < numSelections; ++i)
+  {
+    model.step(tickSeconds, tracks);
+    for (uint32_t track = 0; track < numTracks; ++track)
+    {
+      selection.moveTrack(static_cast<int32_t>(track), tracks[track].lat, tracks[track].lon);
+    }
+
+    timer.start();
+    numMatches = selection.select(viewport, TrackSelection::SelectionReplace);
+    moved.add(timer.nsecsElapsed());
+
+    timer.restart();
+    selection.select(viewport, TrackSelection::SelectionReplace);
+    unmoved.add(timer.nsecsElapsed());
+
+    timer.restart();
+    numChanges = selection.collectChanges();
+    changes.add(timer.nsecsElapsed());
+  }
+
+  std::cout << numTracks << " tracks, viewport latitude " << viewport.m_minLat << " to " << viewport.m_maxLat
+            << ", longitude " << viewport.m_minLon << " to " << viewport.m_maxLon << std::endl
+            << "  tracks selected: " << numMatches << ", selection changes sent after the last tick: " << numChanges << std::endl;
+  printTiming("select after the tracks moved, rebuilding the index", moved);
+  printTiming("select again with the index built", unmoved);
+  printTiming("collect the changes for the track manager", changes);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! startup
+///////////////////////////////////////////////////////////////////////////
+static int runStartupBenchmark(const QString& configFilePath)
+{
+  static const uint32_t numTracks = 100000;
+  static const int numLoads = 5;
+
+  ConfigurationSettings config;
+  SimulationModel model;
+  std::vector<TrackInformation> tracks;
+  if (!generateTracks(configFilePath, numTracks, config, model, tracks))
+  {
+    return 1;
+  }
+
+  QFile file(configFilePath);
+  if (!file.open(QIODevice::ReadOnly))
+  {
+    std::cerr << "Failed to open the configuration file." << std::endl;
+    return 1;
+  }
+  QString text = QString::fromUtf8(file.readAll());
+  file.close();
+
+  //! the generated tracks are written as Track elements, replacing the tracks of the configuration
+  //! file, and the scenario generates no tracks, so all the tracks are read from the file.
+  const double updateRate = config.scenario().m_updateRate;
+  const double radiansToDegrees = 180.0 / M_PI;
+  QString trackElements = "<Tracks>\n";
+  trackElements.reserve(numTracks * 128);
+  for (const TrackInformation& track : tracks)
+  {
+    double offset = track.speed / updateRate / earthRadius * radiansToDegrees;
+    double heading = track.heading / radiansToDegrees;
+    trackElements += QString("\t\t<Track id=\"%1\" Hostility=\"%2\" Type=\"%3\" lat=\"%4\" lon=\"%5\" latOffset=\"%6\" lonOffset=\"%7\"/>\n")
+      .arg(track.id).arg(config.hostilityNames()[track.hostility]).arg(config.typeNames()[track.type])
+      .arg(track.lat, 0, 'f', 6).arg(track.lon, 0, 'f', 6)
+      .arg(offset * cos(heading), 0, 'g', 8).arg(offset * sin(heading), 0, 'g', 8);
+  }
+  trackElements += "\t</Tracks>";
+
+  int tracksStart = text.indexOf("<Tracks>");
+  int tracksEnd = text.indexOf("</Tracks>");
+  if (tracksStart >= 0 && tracksEnd > tracksStart)
+  {
+    text.replace(tracksStart, tracksEnd + 9 - tracksStart, trackElements);
+  }
+  else
+  {
+    text.replace("</Configurations>", trackElements + "\n</Configurations>");
+  }
+  text.replace(QRegularExpression("trackCount=\"[0-9]*\""), "trackCount=\"0\"");
+
+  QTemporaryDir directory;
+  QString generatedPath = directory.path() + "/generatedconfig.xml";
+  QFile generated(generatedPath);
+  if (!directory.isValid() || !generated.open(QIODevice::WriteOnly))
+  {
+    std::cerr << "Failed to write the generated configuration file." << std::endl;
+    return 1;
+  }
+  generated.write(text.toUtf8());
+  generated.close();
+
+  //! time reading the file alone, then the whole start up of the simulator from it.
+  QElapsedTimer timer;
+  TimingStatistics parse, startup;
+  size_t numRead = 0;
+  for (int i = 0; i < numLoads; ++i)
+  {
+    ConfigurationSettings settings;
+    std::vector<TrackInformation> read;
+    QString msgError;
+    timer.start();
+    if (!settings.parseConfigFile(generatedPath, read, msgError))
+    {
+      std::cerr << "Generated configuration file not parsed: " << msgError.toStdString() << std::endl;
+      return 1;
+    }
+    parse.add(timer.nsecsElapsed());
+    numRead = read.size();
+
+    TracksSimulator simulator;
+    timer.restart();
+    simulator.parseConfigurationFile(generatedPath, msgError);
+    startup.add(timer.nsecsElapsed());
+  }
+
+  std::cout << "Generated configuration file: " << numRead << " tracks, "
+            << generated.size() / (1024.0 * 1024.0) << " MB" << std::endl;
+  printTiming("read the configuration file", parse);
+  printTiming("start the simulator from the configuration file", startup);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//! trails
+///////////////////////////////////////////////////////////////////////////
+//! renderer copying the trails as the trail layer does, without drawing them.
+class TrailCopyRenderer : public TrackTrails::Renderer
+{
+public:
+  virtual void drawTrail(uint32_t, const int32_t* xy, size_t numPoints)
+  {
+    m_xy.assign(xy, xy + 2 * numPoints);
+  }
+
+  std::vector<int32_t> m_xy;
+};
+
+static int runTrailBenchmark(const QString& configFilePath)
+{
+  static const uint32_t numTracks = 10000;
+  static const size_t historyPoints = 500;
+  static const int numTicks = 100;
+
+  //! map units per degree, on a plain latitude/longitude grid rather than a map's projection.
+  static const double unitsPerDegree = 1.0e7;
+
+  ConfigurationSettings config;
+  SimulationModel model;
+  std::vector<TrackInformation> tracks;
+  if (!generateTracks(configFilePath, numTracks, config, model, tracks))
+  {
+    return 1;
+  }
+
+  //! fill the histories, then time further ticks, against keeping the raw points of each track
+  //! in a ring of the same length.
+  TrackTrails trails(historyPoints, numTracks * historyPoints);
+  std::vector<int32_t> raw(numTracks * historyPoints * 2);
+  size_t rawNext = 0;
+  QElapsedTimer timer;
+  TimingStatistics update, rawUpdate;
+  for (size_t i = 0; i < historyPoints + numTicks; ++i)
+  {
+    model.step(tickSeconds, tracks);
+
+    timer.start();
+    for (uint32_t track = 0; track < numTracks; ++track)
+    {
+      trails.addPoint(static_cast<int32_t>(track), static_cast<int32_t>(tracks[track].lon * unitsPerDegree),
+        static_cast<int32_t>(tracks[track].lat * unitsPerDegree));
+    }
+    qint64 updateTime = timer.nsecsElapsed();
+
+    timer.restart();
+    for (uint32_t track = 0; track < numTracks; ++track)
+    {
+      int32_t* point = &raw[(track * historyPoints + rawNext) * 2];
+      point[0] = static_cast<int32_t>(tracks[track].lon * unitsPerDegree);
+      point[1] = static_cast<int32_t>(tracks[track].lat * unitsPerDegree);
+    }
+    rawNext = (rawNext + 1) % historyPoints;
+    qint64 rawUpdateTime = timer.nsecsElapsed();
+
+    if (i >= historyPoints)
+    {
+      update.add(updateTime);
+      rawUpdate.add(rawUpdateTime);
+    }
+  }
+
+  std::cout << numTracks << " tracks, " << historyPoints << " points per history, "
+            << trails.numPoints() << " points kept" << std::endl;
+  printTiming("update the trails", update);
+  printTiming("update the raw histories", rawUpdate);
+
+  //! draw the whole scenario area, then a tenth of it, on a 1920 pixel wide view. Each view is
+  //! drawn twice: the first draw decimates the sealed chunks, the second reuses them.
+  const ScenarioSettings& scenario = config.scenario();
+  TrailCopyRenderer renderer;
+  for (int zoom = 1; zoom <= 10; zoom += 9)
+  {
+    double centreX = (scenario.m_minLon + scenario.m_maxLon) / 2.0 * unitsPerDegree;
+    double centreY = (scenario.m_minLat + scenario.m_maxLat) / 2.0 * unitsPerDegree;
+    double halfWidth = (scenario.m_maxLon - scenario.m_minLon) / 2.0 * unitsPerDegree / zoom;
+    double halfHeight = (scenario.m_maxLat - scenario.m_minLat) / 2.0 * unitsPerDegree / zoom;
+    double unitsPerPixel = 2.0 * halfWidth / 1920.0;
+
+    std::cout << "View of 1/" << zoom << " of the scenario width" << std::endl;
+    for (int draw = 0; draw < 2; ++draw)
+    {
+      timer.start();
+      trails.draw(unitsPerPixel, static_cast<int32_t>(centreX - halfWidth), static_cast<int32_t>(centreY - halfHeight),
+        static_cast<int32_t>(centreX + halfWidth), static_cast<int32_t>(centreY + halfHeight), renderer);
+      qint64 drawTime = timer.nsecsElapsed();
+
+      const TrackTrails::Statistics& statistics = trails.statistics();
+      std::cout << (draw ? "  cached draw: " : "  first draw: ") << drawTime / 1000000.0 << " ms, vertices drawn "
+                << statistics.m_drawnPoints << " of " << statistics.m_rawPoints << " raw, chunks decimated "
+                << statistics.m_chunksDecimated << ", reused " << statistics.m_chunksCached << std::endl;
+    }
+  }
+  return 0;
+}
+
+int runTrackBenchmark(const QString& name, const QString& configFilePath)
+{
+  if (name.compare("updates", Qt::CaseInsensitive) == 0)
+  {
+    return runUpdateBenchmark(configFilePath);
+  }
+  if (name.compare("jitter", Qt::CaseInsensitive) == 0)
+  {
+    return runJitterBenchmark(configFilePath);
+  }
+  if (name.compare("simulation", Qt::CaseInsensitive) == 0)
+  {
+    return runSimulationBenchmark(configFilePath);
+  }
+  if (name.compare("reclassify", Qt::CaseInsensitive) == 0)
+  {
+    return runReclassifyBenchmark(configFilePath);
+  }
+  if (name.compare("selection", Qt::CaseInsensitive) == 0)
+  {
+    return runSelectionBenchmark(configFilePath);
+  }
+  if (name.compare("startup", Qt::CaseInsensitive) == 0)
+  {
+    return runStartupBenchmark(configFilePath);
+  }
+  if (name.compare("trails", Qt::CaseInsensitive) == 0)
+  {
+    return runTrailBenchmark(configFilePath);
+  }
+
+  std::cerr << "Unknown benchmark: " << name.toStdString() << std::endl;
+  return 1;
+}
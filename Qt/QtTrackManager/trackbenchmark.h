@@ -0,0 +1,47 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free 
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT 
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more 
+details.
+
+You should have received a copy of the GNU Lesser General Public License 
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#ifndef TRACKBENCHMARK_H
+#define TRACKBENCHMARK_H
+
+#include <QString>
+
+//!
+//! Benchmarks of the sample, run from the command line without showing the main window.
+//!
+//! The tracks are generated from the scenario of the configuration file, with the track
+//! counts set by each benchmark, and the results are written to standard output.
+//!
+//! updates: time to collect and apply a tick of 10k, 50k and 100k tracks to the track
+//!          manager, and the time the simulator and display threads share the snapshot.
+//! jitter:  tick lateness of the running simulator while the display takes 0, 100 and
+//!          500 ms to draw each snapshot.
+//! simulation: tracks moved per second by the motion model for 10k, 100k and 200k tracks,
+//!          without the display.
+//! reclassify: time per change and symbol templates created while 50k tracks are given
+//!          random types and hostilities.
+//! selection: time to select the tracks in a viewport region out of 100k moving tracks.
+//! startup: time to load a configuration file of 100k tracks, generated from the
+//!          configuration file's symbol sets.
+//! trails:  vertices drawn and update time of the decimated history trails of 10k tracks
+//!          with 500 point histories, against the raw histories.
+//!
+//! Returns the process exit code.
+int runTrackBenchmark(const QString& name, const QString& configFilePath);
+
+#endif // TRACKBENCHMARK_H
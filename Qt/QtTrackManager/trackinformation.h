@@ -19,9 +19,13 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 #ifndef TRACKINFORMATION_H
 #define TRACKINFORMATION_H
 
-#include <qstring.h>
+#include <stdint.h>
 
 //! Struct which contains the track information to be used for each track creation.
+//!
+//! The struct only holds plain values so that the simulator can keep its tracks in one
+//! contiguous array and copy them cheaply. The type and hostility are codes which index
+//! the type and hostility names of the configuration settings.
 struct TrackInformation
 {
   //! track id
@@ -30,20 +34,20 @@ struct TrackInformation
   //! track latitude
   double lat;
 
-  //! track latitude moving offset
-  double lat_move_offset;
-
   //! track longitude
   double lon;
 
-  //! track longitude moving offset
-  double lon_move_offset;
+  //! track heading in degrees clockwise from north
+  double heading;
+
+  //! track speed in metres per second
+  double speed;
 
-  //! track type
-  QString type;
+  //! track type code
+  uint16_t type;
 
-  //! track hostility
-  QString hostility;
+  //! track hostility code
+  uint16_t hostility;
 
   //! track symbol id
   uint32_t symbolId;
@@ -0,0 +1,376 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#include <math.h>
+#include "trackselection.h"
+
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
+//! number of bits set in a word.
+static inline size_t countBits(uint64_t word)
+{
+#ifdef _MSC_VER
+  return static_cast<size_t>(__popcnt64(word));
+#else
+  return static_cast<size_t>(__builtin_popcountll(word));
+#endif
+}
+
+//! index of the lowest bit set in a non zero word.
+static inline size_t lowestBit(uint64_t word)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, word);
+  return static_cast<size_t>(index);
+#else
+  return static_cast<size_t>(__builtin_ctzll(word));
+#endif
+}
+
+//! build the table of the codes to match, left empty to match any code.
+static void buildCodeTable(const std::vector<uint16_t>& codes, std::vector<char>& table)
+{
+  table.clear();
+  for (uint16_t code : codes)
+  {
+    if (code >= table.size())
+    {
+      table.resize(code + 1, 0);
+    }
+    table[code] = 1;
+  }
+}
+
+//! check if a code is in the table of the codes to match.
+static inline bool matchesCode(const std::vector<char>& table, uint16_t code)
+{
+  return table.empty() || (code < table.size() && table[code]);
+}
+
+TrackSelection::TrackSelection(double cellSize)
+  : m_cellSize(cellSize > 0.0 ? cellSize : 1.0)
+  , m_indexDirty(true)
+  , m_changedCapacity(0)
+{
+  m_rows = static_cast<int32_t>(ceil(180.0 / m_cellSize));
+  m_columns = static_cast<int32_t>(ceil(360.0 / m_cellSize));
+}
+
+//! set the track of a handle, or update its type and hostility.
+void TrackSelection::setTrack(int32_t handle, uint32_t trackId, uint16_t type, uint16_t hostility, double lat, double lon)
+{
+  size_t index = static_cast<size_t>(handle);
+  if (index >= m_trackIds.size())
+  {
+    size_t size = index + 1;
+    m_trackIds.resize(size, 0);
+    m_lats.resize(size, 0.0);
+    m_lons.resize(size, 0.0);
+    m_types.resize(size, 0);
+    m_hostilities.resize(size, 0);
+
+    size_t words = (size + 63) / 64;
+    m_present.resize(words, 0);
+    m_selected.resize(words, 0);
+    m_applied.resize(words, 0);
+  }
+
+  m_trackIds[index] = trackId;
+  m_lats[index] = lat;
+  m_lons[index] = lon;
+  m_types[index] = type;
+  m_hostilities[index] = hostility;
+  setBit(m_present, index, true);
+  m_indexDirty = true;
+}
+
+//! move the track of a handle.
+void TrackSelection::moveTrack(int32_t handle, double lat, double lon)
+{
+  m_lats[handle] = lat;
+  m_lons[handle] = lon;
+  m_indexDirty = true;
+}
+
+//! forget the track of a handle. The track is no longer selected in the track manager either.
+void TrackSelection::removeTrack(int32_t handle)
+{
+  size_t index = static_cast<size_t>(handle);
+  if (index >= m_trackIds.size())
+  {
+    return;
+  }
+  setBit(m_present, index, false);
+  setBit(m_selected, index, false);
+  setBit(m_applied, index, false);
+  m_indexDirty = true;
+}
+
+//! select the tracks matching the criteria. Returns the number of matching tracks.
+size_t TrackSelection::select(const TrackSelectionCriteria &criteria, SelectionMode mode)
+{
+  std::vector<char> types, hostilities;
+  buildCodeTable(criteria.m_types, types);
+  buildCodeTable(criteria.m_hostilities, hostilities);
+
+  m_matches.assign(m_present.size(), 0);
+  if (criteria.m_useRegion)
+  {
+    if (m_indexDirty)
+    {
+      rebuildIndex();
+    }
+    if (criteria.m_minLon <= criteria.m_maxLon)
+    {
+      selectRegion(criteria.m_minLat, criteria.m_maxLat, criteria.m_minLon, criteria.m_maxLon, types, hostilities, m_matches);
+    }
+    else
+    {
+      //! the region crosses the antimeridian: select each side of it.
+      selectRegion(criteria.m_minLat, criteria.m_maxLat, criteria.m_minLon, 180.0, types, hostilities, m_matches);
+      selectRegion(criteria.m_minLat, criteria.m_maxLat, -180.0, criteria.m_maxLon, types, hostilities, m_matches);
+    }
+  }
+  else
+  {
+    //! attributes only: scan the type and hostility columns.
+    for (size_t word = 0; word < m_present.size(); ++word)
+    {
+      uint64_t present = m_present[word];
+      uint64_t matches = 0;
+      while (present)
+      {
+        size_t bitIndex = lowestBit(present);
+        present &= present - 1;
+        size_t index = word * 64 + bitIndex;
+        if (matchesCode(types, m_types[index]) && matchesCode(hostilities, m_hostilities[index]))
+        {
+          matches |= uint64_t(1) << bitIndex;
+        }
+      }
+      m_matches[word] = matches;
+    }
+  }
+
+  size_t numMatches = 0;
+  for (size_t word = 0; word < m_matches.size(); ++word)
+  {
+    uint64_t matches = m_matches[word];
+    numMatches += countBits(matches);
+    switch (mode)
+    {
+    case SelectionAdd:
+      m_selected[word] |= matches;
+      break;
+    case SelectionRemove:
+      m_selected[word] &= ~matches;
+      break;
+    case SelectionReplace:
+    default:
+      m_selected[word] = matches;
+      break;
+    }
+  }
+  return numMatches;
+}
+
+//! deselect all the tracks.
+void TrackSelection::clear()
+{
+  m_selected.assign(m_selected.size(), 0);
+}
+
+//! check if the track of a handle is selected.
+bool TrackSelection::isSelected(int32_t handle) const
+{
+  return static_cast<size_t>(handle) < m_trackIds.size() && bit(m_selected, handle);
+}
+
+//! number of selected tracks.
+size_t TrackSelection::numSelected() const
+{
+  size_t count = 0;
+  for (uint64_t word : m_selected)
+  {
+    count += countBits(word);
+  }
+  return count;
+}
+
+//! collect the tracks whose selection differs from the one last applied to the track
+//! manager, and mark the selection as applied.
+size_t TrackSelection::collectChanges()
+{
+  m_changedTrackIds.clear();
+  for (size_t word = 0; word < m_selected.size(); ++word)
+  {
+    uint64_t changed = m_selected[word] ^ m_applied[word];
+    while (changed)
+    {
+      size_t index = word * 64 + lowestBit(changed);
+      changed &= changed - 1;
+      m_changedTrackIds.push_back(m_trackIds[index]);
+    }
+  }
+
+  const size_t numChanges = m_changedTrackIds.size();
+  if (numChanges > m_changedCapacity)
+  {
+    m_changedCapacity = numChanges;
+    m_changedSelections.reset(new bool[m_changedCapacity]);
+  }
+
+  //! the states are written in a second pass so the flag buffer is only resized once.
+  size_t change = 0;
+  for (size_t word = 0; word < m_selected.size(); ++word)
+  {
+    uint64_t changed = m_selected[word] ^ m_applied[word];
+    while (changed)
+    {
+      size_t bitIndex = lowestBit(changed);
+      changed &= changed - 1;
+      m_changedSelections[change++] = (m_selected[word] >> bitIndex) & 1;
+    }
+    m_applied[word] = m_selected[word];
+  }
+  return numChanges;
+}
+
+//! ids of the tracks collected by the last collectChanges().
+uint32_t* TrackSelection::changedTrackIds()
+{
+  return m_changedTrackIds.data();
+}
+
+//! new selection states of the tracks collected by the last collectChanges().
+bool* TrackSelection::changedSelections()
+{
+  return m_changedSelections.get();
+}
+
+//! set or clear a bit of a bitset.
+void TrackSelection::setBit(std::vector<uint64_t> &bits, size_t index, bool value)
+{
+  uint64_t mask = uint64_t(1) << (index % 64);
+  if (value)
+  {
+    bits[index / 64] |= mask;
+  }
+  else
+  {
+    bits[index / 64] &= ~mask;
+  }
+}
+
+//! get a bit of a bitset.
+bool TrackSelection::bit(const std::vector<uint64_t> &bits, size_t index)
+{
+  return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+//! grid row of a latitude.
+int32_t TrackSelection::row(double lat) const
+{
+  int32_t row = static_cast<int32_t>(floor((lat + 90.0) / m_cellSize));
+  return row < 0 ? 0 : (row >= m_rows ? m_rows - 1 : row);
+}
+
+//! grid column of a longitude.
+int32_t TrackSelection::column(double lon) const
+{
+  int32_t column = static_cast<int32_t>(floor((lon + 180.0) / m_cellSize));
+  return column < 0 ? 0 : (column >= m_columns ? m_columns - 1 : column);
+}
+
+//! rebuild the spatial index from the current positions of the tracks.
+void TrackSelection::rebuildIndex()
+{
+  //! counting sort of the handles by cell: count each cell, turn the counts into the cell
+  //! starts, then place the handles.
+  const size_t numCells = static_cast<size_t>(m_rows) * m_columns;
+  m_cellStarts.assign(numCells + 1, 0);
+
+  size_t numTracks = 0;
+  for (size_t word = 0; word < m_present.size(); ++word)
+  {
+    uint64_t present = m_present[word];
+    while (present)
+    {
+      size_t index = word * 64 + lowestBit(present);
+      present &= present - 1;
+      ++m_cellStarts[row(m_lats[index]) * m_columns + column(m_lons[index]) + 1];
+      ++numTracks;
+    }
+  }
+  for (size_t cell = 1; cell <= numCells; ++cell)
+  {
+    m_cellStarts[cell] += m_cellStarts[cell - 1];
+  }
+
+  //! placing a handle advances its cell start to the start of the next cell...
+  m_cellHandles.resize(numTracks);
+  for (size_t word = 0; word < m_present.size(); ++word)
+  {
+    uint64_t present = m_present[word];
+    while (present)
+    {
+      size_t index = word * 64 + lowestBit(present);
+      present &= present - 1;
+      size_t cell = row(m_lats[index]) * m_columns + column(m_lons[index]);
+      m_cellHandles[m_cellStarts[cell]++] = static_cast<int32_t>(index);
+    }
+  }
+
+  //! ...so shift the starts back by one cell.
+  for (size_t cell = numCells; cell > 0; --cell)
+  {
+    m_cellStarts[cell] = m_cellStarts[cell - 1];
+  }
+  m_cellStarts[0] = 0;
+
+  m_indexDirty = false;
+}
+
+//! mark the tracks in the region matching the attribute tables in matches.
+void TrackSelection::selectRegion(double minLat, double maxLat, double minLon, double maxLon,
+  const std::vector<char> &types, const std::vector<char> &hostilities, std::vector<uint64_t> &matches)
+{
+  const int32_t firstColumn = column(minLon);
+  const int32_t lastColumn = column(maxLon);
+  const int32_t lastRow = row(maxLat);
+  for (int32_t r = row(minLat); r <= lastRow; ++r)
+  {
+    //! the cells of a row are contiguous in the index, so the columns are one range of handles.
+    uint32_t begin = m_cellStarts[r * m_columns + firstColumn];
+    uint32_t end = m_cellStarts[r * m_columns + lastColumn + 1];
+    for (uint32_t i = begin; i < end; ++i)
+    {
+      int32_t handle = m_cellHandles[i];
+      double lat = m_lats[handle];
+      double lon = m_lons[handle];
+      if (lat >= minLat && lat <= maxLat && lon >= minLon && lon <= maxLon &&
+        matchesCode(types, m_types[handle]) && matchesCode(hostilities, m_hostilities[handle]))
+      {
+        setBit(matches, handle, true);
+      }
+    }
+  }
+}
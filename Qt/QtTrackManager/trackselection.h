@@ -0,0 +1,174 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#ifndef TRACKSELECTION_H
+#define TRACKSELECTION_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+//!
+//! Criteria choosing a set of tracks: an optional latitude/longitude region and optional
+//! lists of track type and hostility codes. A track matches when it is inside the region
+//! and its type and hostility are in the lists; an empty list matches any code.
+//!
+struct TrackSelectionCriteria
+{
+  TrackSelectionCriteria()
+    : m_useRegion(false)
+    , m_minLat(-90.0)
+    , m_maxLat(90.0)
+    , m_minLon(-180.0)
+    , m_maxLon(180.0)
+  {
+  }
+
+  //! true to only match the tracks inside the region.
+  bool m_useRegion;
+  //! region in degrees. The region crosses the antimeridian when m_minLon > m_maxLon.
+  double m_minLat;
+  double m_maxLat;
+  double m_minLon;
+  double m_maxLon;
+  //! type codes to match, any type if empty.
+  std::vector<uint16_t> m_types;
+  //! hostility codes to match, any hostility if empty.
+  std::vector<uint16_t> m_hostilities;
+};
+
+//!
+//! Selection state of the display tracks.
+//!
+//! The selection is kept as a bitset indexed by display track handle, alongside a second
+//! bitset holding the selection last applied to the track manager, so only the tracks whose
+//! selection changed are sent to the track manager. The position, type and hostility of each
+//! track are held in columns by handle; region selections use a uniform latitude/longitude
+//! grid over the tracks, rebuilt on demand when tracks have moved since the last region query.
+//!
+class TrackSelection
+{
+public:
+  //! how a selection combines with the current selection.
+  enum SelectionMode
+  {
+    //! the matching tracks become the selection.
+    SelectionReplace,
+    //! the matching tracks are added to the selection.
+    SelectionAdd,
+    //! the matching tracks are removed from the selection.
+    SelectionRemove
+  };
+
+  //! cellSize is the size in degrees of the cells of the spatial index.
+  explicit TrackSelection(double cellSize = 1.0);
+
+  //! set the track of a handle, or update its type and hostility.
+  void setTrack(int32_t handle, uint32_t trackId, uint16_t type, uint16_t hostility, double lat, double lon);
+
+  //! move the track of a handle.
+  void moveTrack(int32_t handle, double lat, double lon);
+
+  //! forget the track of a handle. The track is no longer selected in the track manager either.
+  void removeTrack(int32_t handle);
+
+  //! select the tracks matching the criteria. Returns the number of matching tracks.
+  size_t select(const TrackSelectionCriteria& criteria, SelectionMode mode);
+
+  //! deselect all the tracks.
+  void clear();
+
+  //! check if the track of a handle is selected.
+  bool isSelected(int32_t handle) const;
+
+  //! number of selected tracks.
+  size_t numSelected() const;
+
+  //! collect the tracks whose selection differs from the one last applied to the track
+  //! manager, and mark the selection as applied. Returns the number of changed tracks,
+  //! whose ids and new selection states are given by changedTrackIds() and changedSelections().
+  size_t collectChanges();
+
+  //! ids of the tracks collected by the last collectChanges().
+  uint32_t* changedTrackIds();
+
+  //! new selection states of the tracks collected by the last collectChanges().
+  bool* changedSelections();
+
+private:
+  //! set or clear a bit of a bitset.
+  static void setBit(std::vector<uint64_t>& bits, size_t index, bool value);
+
+  //! get a bit of a bitset.
+  static bool bit(const std::vector<uint64_t>& bits, size_t index);
+
+  //! grid row of a latitude.
+  int32_t row(double lat) const;
+
+  //! grid column of a longitude.
+  int32_t column(double lon) const;
+
+  //! rebuild the spatial index from the current positions of the tracks.
+  void rebuildIndex();
+
+  //! mark the tracks in the region matching the attribute tables in matches.
+  void selectRegion(double minLat, double maxLat, double minLon, double maxLon,
+    const std::vector<char>& types, const std::vector<char>& hostilities, std::vector<uint64_t>& matches);
+
+  //! size in degrees of the grid cells.
+  double m_cellSize;
+
+  //! number of grid rows and columns.
+  int32_t m_rows;
+  int32_t m_columns;
+
+  //! tracks by handle.
+  std::vector<uint32_t> m_trackIds;
+  std::vector<double> m_lats;
+  std::vector<double> m_lons;
+  std::vector<uint16_t> m_types;
+  std::vector<uint16_t> m_hostilities;
+
+  //! handles holding a track.
+  std::vector<uint64_t> m_present;
+
+  //! handles selected.
+  std::vector<uint64_t> m_selected;
+
+  //! handles selected in the track manager.
+  std::vector<uint64_t> m_applied;
+
+  //! start of each grid cell in m_cellHandles, plus one past the end.
+  std::vector<uint32_t> m_cellStarts;
+
+  //! handles sorted by grid cell.
+  std::vector<int32_t> m_cellHandles;
+
+  //! set when tracks have been moved, added or removed since the index was built.
+  bool m_indexDirty;
+
+  //! buffer of the matches of a selection.
+  std::vector<uint64_t> m_matches;
+
+  //! tracks collected by the last collectChanges().
+  std::vector<uint32_t> m_changedTrackIds;
+  std::unique_ptr<bool[]> m_changedSelections;
+  size_t m_changedCapacity;
+};
+
+#endif // TRACKSELECTION_H
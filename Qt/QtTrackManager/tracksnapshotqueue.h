@@ -0,0 +1,120 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#ifndef TRACKSNAPSHOTQUEUE_H
+#define TRACKSNAPSHOTQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include "trackinformation.h"
+
+//! Snapshot of all the simulated tracks at one simulator tick.
+struct TracksSnapshot
+{
+  //! simulator tick the snapshot was taken at.
+  uint64_t m_tick;
+
+  //! information of every track.
+  std::vector<TrackInformation> m_tracks;
+};
+
+//!
+//! Single-producer/single-consumer handoff of track snapshots between the simulator
+//! thread and the GUI thread.
+//!
+//! Three snapshot buffers are rotated between the producer, the consumer and a shared
+//! slot, so neither side ever waits for the other: the producer always has a buffer to
+//! fill, and the consumer always reads the most recently published snapshot. Snapshots
+//! the consumer did not get to in time are overwritten. The buffers are reused, so once
+//! they have grown to the number of tracks no further allocation takes place.
+//!
+class TrackSnapshotQueue
+{
+public:
+  TrackSnapshotQueue()
+    : m_writeIndex(0)
+    , m_shared(1)
+    , m_readIndex(2)
+    , m_notifyPending(false)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      m_buffers[i].m_tick = 0;
+    }
+  }
+
+  //! Producer: the buffer to fill with the next snapshot.
+  TracksSnapshot& writeBuffer()
+  {
+    return m_buffers[m_writeIndex];
+  }
+
+  //! Producer: publish the filled write buffer, replacing any snapshot not yet consumed.
+  //! Returns true if the consumer should be notified, i.e. it has no notification pending.
+  bool publish()
+  {
+    //! sequentially consistent, as is consume(): each side stores one flag then loads the other's,
+    //! and acquire/release alone would let both loads miss the other side's store, losing a wakeup.
+    int previous = m_shared.exchange(m_writeIndex | m_freshFlag, std::memory_order_seq_cst);
+    m_writeIndex = previous & m_indexMask;
+    return !m_notifyPending.exchange(true, std::memory_order_seq_cst);
+  }
+
+  //! Consumer: take the most recently published snapshot.
+  //! Returns false if nothing has been published since the last call.
+  bool consume()
+  {
+    m_notifyPending.store(false, std::memory_order_seq_cst);
+    if ((m_shared.load(std::memory_order_seq_cst) & m_freshFlag) == 0)
+    {
+      return false;
+    }
+    int previous = m_shared.exchange(m_readIndex, std::memory_order_acq_rel);
+    m_readIndex = previous & m_indexMask;
+    return true;
+  }
+
+  //! Consumer: the snapshot taken by the last successful consume().
+  const TracksSnapshot& readBuffer() const
+  {
+    return m_buffers[m_readIndex];
+  }
+
+private:
+  //! flag set on the shared slot when it holds a snapshot not yet consumed.
+  static const int m_freshFlag = 0x4;
+  //! mask of the buffer index within the shared slot.
+  static const int m_indexMask = 0x3;
+
+  //! snapshot buffers.
+  TracksSnapshot m_buffers[3];
+
+  //! buffer owned by the producer.
+  int m_writeIndex;
+
+  //! buffer in the shared slot, with the fresh flag.
+  std::atomic<int> m_shared;
+
+  //! buffer owned by the consumer.
+  int m_readIndex;
+
+  //! set while a notification has been sent to the consumer and not yet acted on.
+  std::atomic<bool> m_notifyPending;
+};
+
+#endif // TRACKSNAPSHOTQUEUE_H
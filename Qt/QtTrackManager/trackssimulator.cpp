@@ -16,12 +16,20 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 
 ****************************************************************************/
 
+#include <QElapsedTimer>
 #include "trackssimulator.h"
 
+//! default interval between simulator ticks in milliseconds.
+static const int defaultTickInterval = 50;
+
 //! constructor to initialize the tracks positions.
 TracksSimulator::TracksSimulator(QObject *parent)
   : QThread(parent)
   , m_abort(false)
+  , m_tick(0)
+  , m_tickInterval(defaultTickInterval)
+  , m_maxTickLateness(0)
+  , m_publishOnly(false)
 {
 }
 
@@ -30,6 +38,22 @@ void TracksSimulator::run()
 {
   m_abort = false;
 
+  //! started to hand a change over to the display while the simulation is stopped.
+  if (m_publishOnly)
+  {
+    applyPendingSymbolSet();
+    publishSnapshot();
+    return;
+  }
+
+  m_maxTickLateness = 0;
+
+  //! ticks are scheduled at fixed times rather than after a fixed sleep, so the
+  //! time spent updating the tracks does not lower the tick rate.
+  QElapsedTimer clock;
+  clock.start();
+  qint64 nextTick = 0;
+
   while (true)
   {
     //! Check if thread stop is triggered
@@ -41,24 +65,120 @@ void TracksSimulator::run()
     }
     m_mutexAbort.unlock();
 
-    //! update tracks
-    m_mutexTracks.lock();
+    //! record how late this tick started
+    qint64 lateness = (clock.nsecsElapsed() - nextTick) / 1000;
+    if (lateness > m_maxTickLateness)
+    {
+      m_maxTickLateness = lateness;
+    }
+
+    //! update tracks and hand them over to the display
+    applyPendingSymbolSet();
     updateTracksPositions();
-    m_mutexTracks.unlock();
+    publishSnapshot();
 
-    //! send tracks updated signal
-    emit tracksUpdated();
+    //! sleep until the next tick
+    qint64 interval = qint64(m_tickInterval) * 1000000;
+    nextTick += interval;
+    qint64 remaining = nextTick - clock.nsecsElapsed();
+    if (remaining > 0)
+    {
+      this->usleep(static_cast<unsigned long>(remaining / 1000));
+    }
+    else if (-remaining > interval)
+    {
+      //! more than a tick behind, so restart the schedule rather than bursting to catch up.
+      nextTick = clock.nsecsElapsed();
+    }
+  }
+}
 
-    //! sleep
-    this->msleep(50);
+//! set the interval between simulator ticks in milliseconds.
+void TracksSimulator::setTickInterval(int msec)
+{
+  m_tickInterval = (msec > 0) ? msec : 1;
+}
+
+//! get the interval between simulator ticks in milliseconds.
+int TracksSimulator::tickInterval() const
+{
+  return m_tickInterval;
+}
+
+//! get the largest delay in microseconds of a tick after its scheduled time since the simulator started.
+qint64 TracksSimulator::maxTickLateness() const
+{
+  return m_maxTickLateness;
+}
+
+//! get the number of ticks published. Only valid while the simulator is stopped.
+uint64_t TracksSimulator::numTicks() const
+{
+  return m_tick;
+}
+
+//! copy the tracks into the snapshot queue and notify the display if it is waiting for one.
+void TracksSimulator::publishSnapshot()
+{
+  TracksSnapshot& snapshot = m_snapshots.writeBuffer();
+  snapshot.m_tick = ++m_tick;
+  snapshot.m_tracks.assign(m_tracksInformation.begin(), m_tracksInformation.end());
+
+  //! send tracks updated signal
+  if (m_snapshots.publish())
+  {
+    emit tracksUpdated();
   }
 }
 
+//! apply a symbol set change requested while the simulator is running.
+void TracksSimulator::applyPendingSymbolSet()
+{
+  QString symbolSet;
+  m_mutexRequests.lock();
+  symbolSet.swap(m_pendingSymbolSet);
+  m_mutexRequests.unlock();
+
+  if (!symbolSet.isEmpty())
+  {
+    //! the symbol set was validated when requested.
+    QString msgError;
+    m_config.updateTracks(m_tracksInformation, symbolSet, msgError);
+  }
+}
 
 bool TracksSimulator::parseConfigurationFile(const QString &configFilePath, QString &msgError)
 {
+  //! the tracks belong to the simulator thread while it publishes a change.
+  if (m_publishOnly)
+  {
+    wait();
+  }
+
   //! parse the configuration file
-  return m_config.parseConfigFile(configFilePath, m_tracksInformation, msgError);
+  m_tracksInformation.clear();
+  if (!m_config.parseConfigFile(configFilePath, m_tracksInformation, msgError))
+  {
+    return false;
+  }
+
+  //! the tracks defined in the configuration file keep their heading, then the scenario tracks are generated.
+  const ScenarioSettings& scenario = m_config.scenario();
+  m_model.reset(scenario.m_seed);
+  uint32_t nextId = 0;
+  for (const auto& track : m_tracksInformation)
+  {
+    m_model.addTrack(track, ManoeuvreStraight);
+    nextId = (track.id >= nextId) ? track.id + 1 : nextId;
+  }
+  m_model.generateTracks(scenario, nextId,
+    static_cast<uint16_t>(m_config.typeNames().size()), static_cast<uint16_t>(m_config.hostilityNames().size()),
+    m_tracksInformation);
+
+  setTickInterval(static_cast<int>(1000.0 / scenario.m_updateRate + 0.5));
+
+  //! set the symbols of the generated tracks.
+  return m_config.updateTracks(m_tracksInformation, m_config.defaultSymbolSet(), msgError);
 }
 
 //! get configuration settings.
@@ -67,44 +187,46 @@ const ConfigurationSettings& TracksSimulator::getConfigurationSettings()
   return m_config;
 }
 
-//! Update Tracks Positions.
+//! Update Tracks Positions, moving them by one tick.
 void TracksSimulator::updateTracksPositions()
 {
-  //! move each track by its defined lat/lon offset.
-  for (auto it = m_tracksInformation.begin(); it != m_tracksInformation.end(); ++it)
+  m_model.step(m_tickInterval / 1000.0, m_tracksInformation);
+}
+
+//! change Tracks symbols. While the simulator is running the change is applied on its next tick.
+bool TracksSimulator::changeTracksSymbol(QString newSymbolSet, QString &msgError)
+{
+  if (m_config.symbolSets().find(newSymbolSet) == m_config.symbolSets().end())
   {
-    int i = it->first;
-    double lon_shift = m_tracksInformation[i].lon_move_offset;// getRandom(10);
-    double lat_shift = m_tracksInformation[i].lat_move_offset;// getRandom(10);
+    msgError = "Invalid Symbol set (" + newSymbolSet + ").";
+    return false;
+  }
 
-    m_tracksInformation[i].lon += lon_shift;
-    m_tracksInformation[i].lat += lat_shift;
+  m_mutexRequests.lock();
+  m_pendingSymbolSet = newSymbolSet;
+  m_mutexRequests.unlock();
 
-    // Check to see if the track has fallen off the bottom of the Earth
-    if (m_tracksInformation[i].lat < -90.0)
-    {
-      // Direct the track to start moving back up north
-      m_tracksInformation[i].lat = -90.0;
-      m_tracksInformation[i].lat_move_offset = -m_tracksInformation[i].lat_move_offset;
-    }
-    // Check to see if the track has fallen off the top of the Earth
-    else if (m_tracksInformation[i].lat > 90.0)
-    {
-      // Direct the track to start moving back down south
-      m_tracksInformation[i].lat = 90.0;
-      m_tracksInformation[i].lat_move_offset = -m_tracksInformation[i].lat_move_offset;
-    }
-
-    // Longitude bounds - this is OK to wrap round the Earth
-    if (m_tracksInformation[i].lon < -180.0)
-      m_tracksInformation[i].lon = 180.0;
-    else if (m_tracksInformation[i].lon > 180.0)
-      m_tracksInformation[i].lon = -180.0;
+  //! the snapshot queue has a single producer, so while the simulation is stopped the simulator
+  //! thread is run just to apply the change and publish the tracks.
+  if (m_publishOnly || !isRunning())
+  {
+    wait();
+    m_publishOnly = true;
+    start();
   }
+  return true;
 }
 
-//! change Tracks symbols
-bool TracksSimulator::changeTracksSymbol(QString newSymbolSet, QString &msgError)
+//! start simulating, unless the simulation is already running.
+void TracksSimulator::startSimulation()
 {
-  return m_config.updateTracks(m_tracksInformation, newSymbolSet, msgError);
+  if (isRunning() && !m_publishOnly)
+  {
+    return;
+  }
+
+  //! let the thread finish publishing any change made while the simulation was stopped.
+  wait();
+  m_publishOnly = false;
+  start();
 }
\ No newline at end of file
@@ -21,13 +21,20 @@ along with this program. If not, see <https://www.gnu.org/licenses/>.
 
 #include <QThread>
 #include <qmutex.h>
+#include <atomic>
 #include "trackinformation.h"
+#include "tracksnapshotqueue.h"
+#include "simulationmodel.h"
 #include "configurationsettings.h"
 
 //!
 //! Tracks simulator which parses the xml configuration file to read the tracks information, then
 //! create and move the tracks using a timer.
 //!
+//! The tracks are owned by the simulator thread. After each tick a snapshot of them is published
+//! through a snapshot queue, so the simulator never waits for the display to process the tracks
+//! and the display never waits for the simulator to finish a tick.
+//!
 class TracksSimulator : public QThread
 {
   Q_OBJECT
@@ -40,7 +47,7 @@ public:
 
 public:// Tracks positions
 
-  //! Update Tracks Positions.
+  //! Update Tracks Positions, moving them by one tick.
   void updateTracksPositions();
 
   //! parse configuration file to read the hostility and type mapping.
@@ -49,19 +56,32 @@ public:// Tracks positions
   //! get configuration settings.
   const ConfigurationSettings& getConfigurationSettings();
 
-  //! change Tracks symbols
+  //! change Tracks symbols. The change is applied by the simulator thread, on its next tick while the
+  //! simulation is running, or straight away by running the thread once to publish it.
   bool changeTracksSymbol(QString newSymbolSet, QString &msgError);
 
+  //! start simulating, unless the simulation is already running.
+  void startSimulation();
+
+  //! set the interval between simulator ticks in milliseconds.
+  void setTickInterval(int msec);
+
+  //! get the interval between simulator ticks in milliseconds.
+  int tickInterval() const;
+
+  //! get the largest delay in microseconds of a tick after its scheduled time since the simulator started.
+  qint64 maxTickLateness() const;
+
+  //! get the number of ticks published. Only valid while the simulator is stopped.
+  uint64_t numTicks() const;
+
 signals:
   //! Signal to be sent by the thread when tracks are updated.
   void tracksUpdated();
 
 public:
-  //! map of tracks information
-  std::map<int, TrackInformation> m_tracksInformation;
-
-  //! mutex to protect the map of tracks.
-  QMutex m_mutexTracks;
+  //! snapshots of the tracks published to the display.
+  TrackSnapshotQueue m_snapshots;
 
   //! flag to be sent to quit the thread.
   bool m_abort;
@@ -71,8 +91,39 @@ public:
 
 
 private:
+  //! copy the tracks into the snapshot queue and notify the display if it is waiting for one.
+  void publishSnapshot();
+
+  //! apply a symbol set change requested while the simulator is running.
+  void applyPendingSymbolSet();
+
+  //! tracks information, only accessed by the simulator thread while it is running.
+  std::vector<TrackInformation> m_tracksInformation;
+
+  //! motion model moving the tracks.
+  SimulationModel m_model;
+
   //! configurations file object.
   ConfigurationSettings m_config;
+
+  //! number of ticks published.
+  uint64_t m_tick;
+
+  //! interval between ticks in milliseconds.
+  std::atomic<int> m_tickInterval;
+
+  //! largest delay of a tick after its scheduled time, in microseconds.
+  std::atomic<qint64> m_maxTickLateness;
+
+  //! symbol set change requested, to be applied by the simulator thread.
+  QString m_pendingSymbolSet;
+
+  //! mutex to protect the requested symbol set change.
+  QMutex m_mutexRequests;
+
+  //! set if the thread was last started to publish a change rather than to simulate. Only changed
+  //! by the thread starting the simulator, while the simulator thread is not running.
+  std::atomic<bool> m_publishOnly;
 };
 
 #endif // TRACKSSIMULATORTHREAD_H
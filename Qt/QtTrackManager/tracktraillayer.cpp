@@ -0,0 +1,64 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#include "tracktraillayer.h"
+#include "tslrenderingattributes.h"
+
+TrackTrailLayer::TrackTrailLayer(TrackTrails *trails)
+  : m_trails(trails)
+  , m_renderingInterface(NULL)
+  , m_coords(new TSLCoordSet())
+{
+}
+
+TrackTrailLayer::~TrackTrailLayer()
+{
+  delete m_coords;
+}
+
+//! draw the trails overlapping the extent.
+bool TrackTrailLayer::drawLayer(TSLRenderingInterface *renderingInterface, const TSLEnvelope *extent, TSLCustomDataLayerHandler &layerHandler)
+{
+  if (!extent || !layerHandler.drawingSurface())
+  {
+    return false;
+  }
+
+  //! the tolerance of the decimation follows the size of a pixel in map units.
+  double tmcPerDUX, tmcPerDUY;
+  layerHandler.drawingSurface()->TMCperDU(tmcPerDUX, tmcPerDUY);
+  double unitsPerPixel = (tmcPerDUX < tmcPerDUY) ? tmcPerDUX : tmcPerDUY;
+
+  m_renderingInterface = renderingInterface;
+  m_trails->draw(unitsPerPixel, extent->xMin(), extent->yMin(), extent->xMax(), extent->yMax(), *this);
+  m_renderingInterface = NULL;
+  return true;
+}
+
+//! draw a decimated trail.
+void TrackTrailLayer::drawTrail(uint32_t colour, const int32_t *xy, size_t numPoints)
+{
+  m_coords->clear();
+  for (size_t i = 0; i < numPoints; ++i)
+  {
+    m_coords->add(xy[2 * i], xy[2 * i + 1]);
+  }
+
+  m_renderingInterface->setupLineAttributes(1, static_cast<int>(colour), 1, TSLDimensionUnitsPixels);
+  m_renderingInterface->drawPolyline(*m_coords);
+}
@@ -0,0 +1,56 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#ifndef TRACKTRAILLAYER_H
+#define TRACKTRAILLAYER_H
+
+#include "MapLink.h"
+#include "tslclientcustomdatalayer.h"
+#include "tracktrails.h"
+
+//!
+//! Custom data layer drawing the history trails of the display tracks.
+//!
+//! The trails are decimated to the scale of the drawing surface by TrackTrails, and each
+//! decimated polyline is drawn straight through the rendering interface from a coordinate set
+//! reused for every trail and draw, so drawing the trails doesn't create any entity.
+//!
+class TrackTrailLayer : public TSLClientCustomDataLayer, public TrackTrails::Renderer
+{
+public:
+  explicit TrackTrailLayer(TrackTrails* trails);
+  virtual ~TrackTrailLayer();
+
+  //! draw the trails overlapping the extent.
+  virtual bool drawLayer(TSLRenderingInterface* renderingInterface, const TSLEnvelope* extent, TSLCustomDataLayerHandler& layerHandler);
+
+  //! draw a decimated trail.
+  virtual void drawTrail(uint32_t colour, const int32_t* xy, size_t numPoints);
+
+private:
+  //! trails to draw.
+  TrackTrails* m_trails;
+
+  //! rendering interface of the draw in progress.
+  TSLRenderingInterface* m_renderingInterface;
+
+  //! coordinates of the trail being drawn.
+  TSLCoordSet* m_coords;
+};
+
+#endif // TRACKTRAILLAYER_H
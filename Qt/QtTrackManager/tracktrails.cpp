@@ -0,0 +1,394 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#include <math.h>
+#include "tracktrails.h"
+
+TrackTrails::TrackTrails(size_t maxPoints, size_t maxTotalPoints, size_t chunkPoints, double pixelTolerance)
+  : m_maxPoints(maxPoints)
+  , m_maxTotalPoints(maxTotalPoints)
+  , m_chunkPoints(chunkPoints < 2 ? 2 : chunkPoints)
+  , m_numTrails(0)
+  , m_numPoints(0)
+  , m_pixelTolerance(pixelTolerance)
+{
+  m_statistics.m_rawPoints = 0;
+  m_statistics.m_drawnPoints = 0;
+  m_statistics.m_chunksDecimated = 0;
+  m_statistics.m_chunksCached = 0;
+}
+
+//! set the largest number of points kept per trail. Trails are shortened a whole chunk at a time.
+void TrackTrails::setMaxPoints(size_t maxPoints)
+{
+  m_maxPoints = maxPoints;
+  const size_t points = trailPoints();
+  for (Trail& trail : m_trails)
+  {
+    trimTrail(trail, points);
+  }
+}
+
+//! get the largest number of points kept per trail.
+size_t TrackTrails::maxPoints() const
+{
+  return m_maxPoints;
+}
+
+//! set the largest number of points kept over all the trails.
+void TrackTrails::setMaxTotalPoints(size_t maxTotalPoints)
+{
+  m_maxTotalPoints = maxTotalPoints;
+  const size_t points = trailPoints();
+  for (Trail& trail : m_trails)
+  {
+    trimTrail(trail, points);
+  }
+}
+
+//! get the number of points each trail keeps at most, given the number of trails.
+size_t TrackTrails::trailPoints() const
+{
+  size_t share = m_numTrails ? m_maxTotalPoints / m_numTrails : m_maxTotalPoints;
+  if (share >= m_maxPoints)
+  {
+    return m_maxPoints;
+  }
+  return (share >= minTrailPoints) ? share : 0;
+}
+
+//! get the number of points kept over all the trails.
+size_t TrackTrails::numPoints() const
+{
+  return m_numPoints;
+}
+
+//! set the largest distance in pixels between a trail and its decimated polyline.
+void TrackTrails::setPixelTolerance(double pixelTolerance)
+{
+  m_pixelTolerance = pixelTolerance;
+
+  //! the cached polylines were built for the old tolerance.
+  for (Trail& trail : m_trails)
+  {
+    for (Chunk& chunk : trail.m_chunks)
+    {
+      chunk.m_level = noLevel;
+    }
+  }
+}
+
+//! add a point to the trail of a handle.
+void TrackTrails::addPoint(int32_t handle, int32_t x, int32_t y)
+{
+  Trail& trail = useTrail(handle);
+  const size_t points = trailPoints();
+  if (points < 2)
+  {
+    //! no trails are kept, or they are too short to draw.
+    trimTrail(trail, points);
+    return;
+  }
+  const size_t chunkSize = chunkPoints(points);
+  if (trail.m_chunks.empty())
+  {
+    trail.m_chunks.push_back(Chunk());
+    startChunk(trail.m_chunks.back(), x, y);
+    trail.m_chunks.back().m_points.reserve(2 * chunkSize);
+    trail.m_numPoints = 1;
+    ++m_numPoints;
+    return;
+  }
+
+  Chunk* head = &trail.m_chunks.back();
+  const size_t numPoints = head->m_points.size() / 2;
+  if (head->m_points[2 * numPoints - 2] == x && head->m_points[2 * numPoints - 1] == y)
+  {
+    //! the track has not moved far enough to change its position in map units.
+    return;
+  }
+
+  if (numPoints >= chunkSize)
+  {
+    //! seal the full chunk; the new chunk starts at its last point so the trail stays joined.
+    int32_t lastX = head->m_points[2 * numPoints - 2];
+    int32_t lastY = head->m_points[2 * numPoints - 1];
+    trail.m_chunks.push_back(Chunk());
+    head = &trail.m_chunks.back();
+    startChunk(*head, lastX, lastY);
+    head->m_points.reserve(2 * chunkSize);
+  }
+
+  head->m_points.push_back(x);
+  head->m_points.push_back(y);
+  head->m_minX = (x < head->m_minX) ? x : head->m_minX;
+  head->m_minY = (y < head->m_minY) ? y : head->m_minY;
+  head->m_maxX = (x > head->m_maxX) ? x : head->m_maxX;
+  head->m_maxY = (y > head->m_maxY) ? y : head->m_maxY;
+  ++trail.m_numPoints;
+  ++m_numPoints;
+
+  trimTrail(trail, points);
+}
+
+//! set the colour of the trail of a handle.
+void TrackTrails::setColour(int32_t handle, uint32_t colour)
+{
+  useTrail(handle).m_colour = colour;
+}
+
+//! remove the trail of a handle.
+void TrackTrails::removeTrail(int32_t handle)
+{
+  if (static_cast<size_t>(handle) < m_trails.size())
+  {
+    Trail& trail = m_trails[handle];
+    m_numPoints -= trail.m_numPoints;
+    m_numTrails -= trail.m_inUse ? 1 : 0;
+    trail = Trail();
+  }
+}
+
+//! remove all the trails.
+void TrackTrails::clear()
+{
+  m_trails.clear();
+  m_numTrails = 0;
+  m_numPoints = 0;
+}
+
+//! draw the trails overlapping the extent, at the given number of map units per pixel.
+void TrackTrails::draw(double unitsPerPixel, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, Renderer &renderer)
+{
+  m_statistics.m_rawPoints = 0;
+  m_statistics.m_drawnPoints = 0;
+  m_statistics.m_chunksDecimated = 0;
+  m_statistics.m_chunksCached = 0;
+
+  //! round the tolerance down to a power of two map units, so the cached polylines stay valid
+  //! until the scale halves or doubles, and are never further than the tolerance from the trail.
+  //! The points are whole map units, so the tolerance is at least one map unit: when a pixel spans
+  //! less than that, the polylines may be up to one map unit from the trail.
+  double tolerance = m_pixelTolerance * unitsPerPixel;
+  int level = (tolerance >= 1.0) ? static_cast<int>(floor(log2(tolerance))) : 0;
+  double levelTolerance = ldexp(1.0, level);
+
+  for (Trail& trail : m_trails)
+  {
+    m_polyline.clear();
+    const size_t numChunks = trail.m_chunks.size();
+    for (size_t i = 0; i < numChunks; ++i)
+    {
+      Chunk& chunk = trail.m_chunks[i];
+      if (chunk.m_maxX < minX || chunk.m_minX > maxX || chunk.m_maxY < minY || chunk.m_minY > maxY)
+      {
+        //! the chunk is off screen, so the polyline is broken here.
+        flushPolyline(trail.m_colour, renderer);
+        continue;
+      }
+      m_statistics.m_rawPoints += chunk.m_points.size() / 2;
+
+      if (i + 1 < numChunks)
+      {
+        //! sealed chunk: use the cached polyline if it was built for this tolerance.
+        if (chunk.m_level != level)
+        {
+          decimate(chunk.m_points, levelTolerance, chunk.m_decimated);
+          chunk.m_level = level;
+          ++m_statistics.m_chunksDecimated;
+        }
+        else
+        {
+          ++m_statistics.m_chunksCached;
+        }
+        appendPolyline(chunk.m_decimated);
+      }
+      else
+      {
+        //! the chunk being filled changes on every update, so it is decimated on every draw.
+        decimate(chunk.m_points, levelTolerance, m_headPolyline);
+        appendPolyline(m_headPolyline);
+      }
+    }
+    flushPolyline(trail.m_colour, renderer);
+  }
+}
+
+//! get the statistics of the last draw.
+const TrackTrails::Statistics& TrackTrails::statistics() const
+{
+  return m_statistics;
+}
+
+//! start a chunk at the given point.
+void TrackTrails::startChunk(Chunk &chunk, int32_t x, int32_t y)
+{
+  chunk.m_points.clear();
+  chunk.m_points.push_back(x);
+  chunk.m_points.push_back(y);
+  chunk.m_decimated.clear();
+  chunk.m_level = noLevel;
+  chunk.m_minX = chunk.m_maxX = x;
+  chunk.m_minY = chunk.m_maxY = y;
+}
+
+//! start using the trail of a handle, creating it if needed.
+TrackTrails::Trail& TrackTrails::useTrail(int32_t handle)
+{
+  if (static_cast<size_t>(handle) >= m_trails.size())
+  {
+    m_trails.resize(handle + 1);
+  }
+  Trail& trail = m_trails[handle];
+  if (!trail.m_inUse)
+  {
+    trail.m_inUse = true;
+    ++m_numTrails;
+  }
+  return trail;
+}
+
+//! number of points per chunk, given the number of points per trail.
+size_t TrackTrails::chunkPoints(size_t trailPoints) const
+{
+  //! at least two chunks per trail, so dropping the oldest chunk keeps most of the trail.
+  size_t points = trailPoints / 2;
+  points = (points < 2) ? 2 : points;
+  return (points < m_chunkPoints) ? points : m_chunkPoints;
+}
+
+//! drop the oldest chunks of a trail while it has more than the given number of points.
+void TrackTrails::trimTrail(Trail &trail, size_t trailPoints)
+{
+  if (trailPoints < 2)
+  {
+    m_numPoints -= trail.m_numPoints;
+    trail.m_chunks.clear();
+    trail.m_numPoints = 0;
+    return;
+  }
+
+  while (trail.m_chunks.size() > 1 && trail.m_numPoints > trailPoints)
+  {
+    //! the last point of the oldest chunk is shared with the next chunk.
+    size_t chunkPoints = trail.m_chunks.front().m_points.size() / 2 - 1;
+    trail.m_chunks.erase(trail.m_chunks.begin());
+    trail.m_numPoints -= chunkPoints;
+    m_numPoints -= chunkPoints;
+  }
+}
+
+//! decimate the points of a chunk with the given tolerance into output.
+void TrackTrails::decimate(const std::vector<int32_t> &points, double tolerance, std::vector<int32_t> &output)
+{
+  output.clear();
+  const size_t numPoints = points.size() / 2;
+  if (numPoints <= 2)
+  {
+    output = points;
+    return;
+  }
+
+  //! Douglas-Peucker: keep the point of each range furthest from the segment joining its
+  //! ends, while it is further than the tolerance, and split the range at that point.
+  const double toleranceSquared = tolerance * tolerance;
+  m_keep.assign(numPoints, 0);
+  m_keep[0] = 1;
+  m_keep[numPoints - 1] = 1;
+  m_ranges.clear();
+  m_ranges.push_back(std::make_pair(size_t(0), numPoints - 1));
+  while (!m_ranges.empty())
+  {
+    size_t first = m_ranges.back().first;
+    size_t last = m_ranges.back().second;
+    m_ranges.pop_back();
+    if (last - first < 2)
+    {
+      continue;
+    }
+
+    double ax = points[2 * first], ay = points[2 * first + 1];
+    double dx = points[2 * last] - ax, dy = points[2 * last + 1] - ay;
+    double lengthSquared = dx * dx + dy * dy;
+
+    double furthestSquared = -1.0;
+    size_t furthest = first;
+    for (size_t i = first + 1; i < last; ++i)
+    {
+      double px = points[2 * i] - ax, py = points[2 * i + 1] - ay;
+      double distanceSquared;
+      if (lengthSquared == 0.0)
+      {
+        distanceSquared = px * px + py * py;
+      }
+      else
+      {
+        //! distance to the segment rather than to the line, as trails can turn back on themselves.
+        double t = (px * dx + py * dy) / lengthSquared;
+        t = (t < 0.0) ? 0.0 : ((t > 1.0) ? 1.0 : t);
+        double ex = px - t * dx, ey = py - t * dy;
+        distanceSquared = ex * ex + ey * ey;
+      }
+      if (distanceSquared > furthestSquared)
+      {
+        furthestSquared = distanceSquared;
+        furthest = i;
+      }
+    }
+
+    if (furthestSquared > toleranceSquared)
+    {
+      m_keep[furthest] = 1;
+      m_ranges.push_back(std::make_pair(first, furthest));
+      m_ranges.push_back(std::make_pair(furthest, last));
+    }
+  }
+
+  for (size_t i = 0; i < numPoints; ++i)
+  {
+    if (m_keep[i])
+    {
+      output.push_back(points[2 * i]);
+      output.push_back(points[2 * i + 1]);
+    }
+  }
+}
+
+//! append a polyline to the polyline being drawn, joining them if they share an end point.
+void TrackTrails::appendPolyline(const std::vector<int32_t> &xy)
+{
+  size_t start = 0;
+  const size_t size = m_polyline.size();
+  if (size >= 2 && xy.size() >= 2 && m_polyline[size - 2] == xy[0] && m_polyline[size - 1] == xy[1])
+  {
+    start = 2;
+  }
+  m_polyline.insert(m_polyline.end(), xy.begin() + start, xy.end());
+}
+
+//! draw the polyline being drawn, if any, and start a new one.
+void TrackTrails::flushPolyline(uint32_t colour, Renderer &renderer)
+{
+  const size_t numPoints = m_polyline.size() / 2;
+  if (numPoints >= 2)
+  {
+    renderer.drawTrail(colour, m_polyline.data(), numPoints);
+    m_statistics.m_drawnPoints += numPoints;
+  }
+  m_polyline.clear();
+}
@@ -0,0 +1,217 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#ifndef TRACKTRAILS_H
+#define TRACKTRAILS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+//!
+//! History trails of the display tracks, drawn as polylines decimated to the current scale.
+//!
+//! Each trail is split into chunks of a fixed number of points. A chunk is sealed once it is
+//! full, after which its points never change, so its decimated polyline is cached and only
+//! rebuilt when the scale changes enough to need a different tolerance. Decimation uses the
+//! Douglas-Peucker algorithm with a tolerance given in pixels, so a trail keeps as many points
+//! as are visible on screen whatever its length. Tolerances are rounded down to a power of two
+//! map units, so zooming only invalidates the cached polylines every halving or doubling of
+//! the scale.
+//!
+//! The points kept over all the trails are bounded as well as the points per trail: when there
+//! are more trails than the total allows at the full length, every trail is shortened to an
+//! equal share of the total, and its chunks are made smaller to match. A share too short to be
+//! worth drawing is not kept at all, so every chunk holds enough points to keep its overhead
+//! small. A point takes 8 bytes, plus at most 8 for its cached decimated copy and up to about 20
+//! of chunk overhead when the chunks are at their smallest, so the default of 1M points keeps
+//! the trails within about 36MB. That is 500
+//! points per trail up to 2000 tracks, 100 at 10k tracks, and no trails beyond 62.5k tracks.
+//!
+//! Trails are indexed by display track handle, and points are in map units (TMC).
+//!
+class TrackTrails
+{
+public:
+  //! Receives the decimated trails to draw.
+  class Renderer
+  {
+  public:
+    virtual ~Renderer() {}
+
+    //! draw a polyline of the given colour. xy holds numPoints interleaved x, y coordinates.
+    virtual void drawTrail(uint32_t colour, const int32_t* xy, size_t numPoints) = 0;
+  };
+
+  //! statistics of the last draw.
+  struct Statistics
+  {
+    //! points of the trails drawn, before decimation.
+    size_t m_rawPoints;
+    //! points drawn after decimation.
+    size_t m_drawnPoints;
+    //! sealed chunks decimated, i.e. not found in the cache.
+    size_t m_chunksDecimated;
+    //! sealed chunks whose cached polyline was reused.
+    size_t m_chunksCached;
+  };
+
+  //! maxPoints is the largest number of points kept per trail, in chunks of up to chunkPoints
+  //! points, and maxTotalPoints the largest number of points kept over all the trails.
+  //! pixelTolerance is the largest distance in pixels between a trail and its decimated polyline.
+  explicit TrackTrails(size_t maxPoints = 500, size_t maxTotalPoints = 1000000, size_t chunkPoints = 64,
+    double pixelTolerance = 1.0);
+
+  //! set the largest number of points kept per trail. Trails are shortened a whole chunk at a time.
+  void setMaxPoints(size_t maxPoints);
+
+  //! get the largest number of points kept per trail.
+  size_t maxPoints() const;
+
+  //! set the largest number of points kept over all the trails.
+  void setMaxTotalPoints(size_t maxTotalPoints);
+
+  //! get the number of points each trail keeps at most, given the number of trails, or 0 if
+  //! there are too many trails to keep any.
+  size_t trailPoints() const;
+
+  //! get the number of points kept over all the trails.
+  size_t numPoints() const;
+
+  //! set the largest distance in pixels between a trail and its decimated polyline.
+  void setPixelTolerance(double pixelTolerance);
+
+  //! add a point to the trail of a handle.
+  void addPoint(int32_t handle, int32_t x, int32_t y);
+
+  //! set the colour of the trail of a handle.
+  void setColour(int32_t handle, uint32_t colour);
+
+  //! remove the trail of a handle.
+  void removeTrail(int32_t handle);
+
+  //! remove all the trails.
+  void clear();
+
+  //! draw the trails overlapping the extent, at the given number of map units per pixel.
+  void draw(double unitsPerPixel, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, Renderer& renderer);
+
+  //! get the statistics of the last draw.
+  const Statistics& statistics() const;
+
+private:
+  //! part of a trail. Consecutive chunks share their end and start points.
+  struct Chunk
+  {
+    //! points, as interleaved x, y.
+    std::vector<int32_t> m_points;
+    //! cached decimated polyline of a sealed chunk, as interleaved x, y.
+    std::vector<int32_t> m_decimated;
+    //! tolerance level the cached polyline was built for, or noLevel.
+    int m_level;
+    //! bounds of the points.
+    int32_t m_minX;
+    int32_t m_minY;
+    int32_t m_maxX;
+    int32_t m_maxY;
+  };
+
+  //! trail of one display track.
+  struct Trail
+  {
+    Trail()
+      : m_colour(0)
+      , m_numPoints(0)
+      , m_inUse(false)
+    {
+    }
+
+    //! chunks, oldest first. All the chunks but the last are sealed.
+    std::vector<Chunk> m_chunks;
+    //! colour of the trail.
+    uint32_t m_colour;
+    //! number of distinct points in the chunks.
+    size_t m_numPoints;
+    //! set while the handle has a track, so the trail has a share of the total points.
+    bool m_inUse;
+  };
+
+  //! level of a chunk without a cached polyline.
+  static const int noLevel = -1;
+
+  //! shortest share of the total points a trail is kept with.
+  static const size_t minTrailPoints = 16;
+
+  //! start a chunk at the given point.
+  static void startChunk(Chunk& chunk, int32_t x, int32_t y);
+
+  //! start using the trail of a handle, creating it if needed.
+  Trail& useTrail(int32_t handle);
+
+  //! number of points per chunk, given the number of points per trail.
+  size_t chunkPoints(size_t trailPoints) const;
+
+  //! drop the oldest chunks of a trail while it has more than the given number of points.
+  void trimTrail(Trail& trail, size_t trailPoints);
+
+  //! decimate the points of a chunk with the given tolerance into output.
+  void decimate(const std::vector<int32_t>& points, double tolerance, std::vector<int32_t>& output);
+
+  //! append a polyline to the polyline being drawn, joining them if they share an end point.
+  void appendPolyline(const std::vector<int32_t>& xy);
+
+  //! draw the polyline being drawn, if any, and start a new one.
+  void flushPolyline(uint32_t colour, Renderer& renderer);
+
+  //! largest number of points kept per trail.
+  size_t m_maxPoints;
+
+  //! largest number of points kept over all the trails.
+  size_t m_maxTotalPoints;
+
+  //! largest number of points per chunk.
+  size_t m_chunkPoints;
+
+  //! number of trails in use.
+  size_t m_numTrails;
+
+  //! number of points kept over all the trails.
+  size_t m_numPoints;
+
+  //! largest distance in pixels between a trail and its decimated polyline.
+  double m_pixelTolerance;
+
+  //! trails by handle.
+  std::vector<Trail> m_trails;
+
+  //! statistics of the last draw.
+  Statistics m_statistics;
+
+  //! polyline being drawn, as interleaved x, y.
+  std::vector<int32_t> m_polyline;
+
+  //! decimated polyline of the chunk being filled, rebuilt on every draw.
+  std::vector<int32_t> m_headPolyline;
+
+  //! scratch buffers of the decimation.
+  std::vector<char> m_keep;
+  std::vector<std::pair<size_t, size_t> > m_ranges;
+};
+
+#endif // TRACKTRAILS_H
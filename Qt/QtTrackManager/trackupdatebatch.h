@@ -0,0 +1,71 @@
+/****************************************************************************
+Copyright (c) 2008-2022 by Envitia Group PLC.
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation, either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+****************************************************************************/
+
+#ifndef TRACKUPDATEBATCH_H
+#define TRACKUPDATEBATCH_H
+
+#include <vector>
+#include "trackinformation.h"
+
+//!
+//! Batch of track changes collected from the simulator, held in contiguous arrays
+//! so that they can be applied to the track manager in a single pass.
+//!
+//! The arrays are cleared, not released, between updates so the same batch can be
+//! reused without reallocating.
+//!
+struct TrackUpdateBatch
+{
+  //! ids of the tracks to remove from the track manager.
+  std::vector<uint32_t> m_removedIds;
+
+  //! tracks which are new or whose symbol has changed.
+  std::vector<TrackInformation> m_symbolChanges;
+
+  //! displayed tracks whose type or hostility has changed, which the selection sets depend on.
+  std::vector<TrackInformation> m_classificationChanges;
+
+  //! ids of the tracks to move, with their positions and headings at the same index.
+  std::vector<uint32_t> m_positionIds;
+  std::vector<double> m_lats;
+  std::vector<double> m_lons;
+  std::vector<double> m_headings;
+
+  //! empty the batch, keeping the allocated capacity.
+  void clear()
+  {
+    m_removedIds.clear();
+    m_symbolChanges.clear();
+    m_classificationChanges.clear();
+    m_positionIds.clear();
+    m_lats.clear();
+    m_lons.clear();
+    m_headings.clear();
+  }
+
+  //! reserve space for a batch of the given number of tracks.
+  void reserve(size_t numTracks)
+  {
+    m_positionIds.reserve(numTracks);
+    m_lats.reserve(numTracks);
+    m_lons.reserve(numTracks);
+    m_headings.reserve(numTracks);
+  }
+};
+
+#endif // TRACKUPDATEBATCH_H